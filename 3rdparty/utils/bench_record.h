@@ -0,0 +1,403 @@
+#pragma once
+// Machine-readable result records shared by the bench_* drivers.
+// Each run emits one flat record (problem spec, dtype, stream count, timing
+// statistics, per-phase utility timings, host info and git revision) as a
+// JSON line or a CSV row so that sweeps do not need to scrape printf output.
+// The record itself is host-only; device info is added only when the CUDA
+// runtime header was included before this one.
+#include <unistd.h>  // gethostname
+#include <utils/bench_timing.h>
+#include <utils/helper_string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Passed by the build system, e.g., -DBENCH_GIT_REVISION=\"$(git rev-parse
+// --short HEAD)\". The BENCH_GIT_REVISION environment variable overrides it.
+#ifndef BENCH_GIT_REVISION
+#define BENCH_GIT_REVISION "unknown"
+#endif
+
+namespace BenchRecord {
+enum class OutputFormat { kText, kJsonl, kCsv };
+
+struct OutputOptions {
+  OutputFormat format;
+  // Records are appended to this file. Empty means stdout.
+  std::string path;
+};
+
+void print_output_usage() {
+  printf(
+      "Output options: [--output=text|jsonl|csv] [--record_path=...]\n"
+      "--output=jsonl|csv emits one machine-readable record per run, appended\n"
+      "to --record_path if specified and printed to stdout otherwise\n");
+}
+
+OutputOptions parse_output_options(const int argc, const char **argv) {
+  OutputOptions options{.format = OutputFormat::kText, .path = ""};
+  char *format_str = nullptr;
+  if (getCmdLineArgumentString(argc, argv, "output", &format_str)) {
+    std::string format(format_str);
+    if (format == "jsonl" || format == "json") {
+      options.format = OutputFormat::kJsonl;
+    } else if (format == "csv") {
+      options.format = OutputFormat::kCsv;
+    } else if (format != "text") {
+      printf("Unknown --output=%s, falling back to text\n", format_str);
+    }
+  }
+  char *path_str = nullptr;
+  if (getCmdLineArgumentString(argc, argv, "record_path", &path_str)) {
+    options.path = path_str;
+  }
+  return options;
+}
+
+std::string escape_json(const std::string &str) {
+  std::string result;
+  result.reserve(str.size() + 2);
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      case '\n':
+        result += "\\n";
+        break;
+      case '\t':
+        result += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", c);
+          result += buf;
+        } else {
+          result += c;
+        }
+    }
+  }
+  return result;
+}
+
+std::string escape_csv(const std::string &str) {
+  if (str.find_first_of(",\"\n") == std::string::npos) return str;
+  std::string result = "\"";
+  for (char c : str) {
+    if (c == '"') result += '"';
+    result += c;
+  }
+  return result + "\"";
+}
+
+// A flat, ordered list of key/value fields. Nested information uses dotted
+// keys, e.g., "phase_ms.handle_creation", so that the JSON and the CSV layouts
+// carry the same columns.
+class Record {
+ public:
+  Record &add(const std::string &key, const std::string &value) {
+    return set(key, "\"" + escape_json(value) + "\"", escape_csv(value));
+  }
+  Record &add(const std::string &key, const char *value) {
+    return add(key, std::string(value));
+  }
+  Record &add(const std::string &key, bool value) {
+    return set(key, value ? "true" : "false", value ? "1" : "0");
+  }
+  Record &add(const std::string &key, int value) {
+    return add(key, static_cast<long long>(value));
+  }
+  Record &add(const std::string &key, long value) {
+    return add(key, static_cast<long long>(value));
+  }
+  Record &add(const std::string &key, long long value) {
+    std::string str = std::to_string(value);
+    return set(key, str, str);
+  }
+  Record &add(const std::string &key, unsigned long value) {
+    std::string str = std::to_string(value);
+    return set(key, str, str);
+  }
+  Record &add(const std::string &key, double value) {
+    if (!std::isfinite(value)) return set(key, "null", "");
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g", value);
+    return set(key, buf, buf);
+  }
+  Record &add(const std::string &key, float value) {
+    return add(key, static_cast<double>(value));
+  }
+
+  void add_timing_summary(const BenchTiming::Summary &summary) {
+    add("time_ms.warmup", summary.num_warmup);
+    add("time_ms.samples", summary.num_samples);
+    add("time_ms.min", summary.min);
+    add("time_ms.median", summary.median);
+    add("time_ms.p90", summary.p90);
+    add("time_ms.p99", summary.p99);
+    add("time_ms.max", summary.max);
+    add("time_ms.mean", summary.mean);
+    add("time_ms.stddev", summary.stddev);
+    add("time_ms.rel_ci", summary.rel_ci);
+    add("time_ms.converged", summary.converged);
+  }
+
+  // Elapsed time of each utility phase, i.e., the utility_timestamps event
+  // pairs after they were consumed
+  void add_phase_times(const std::map<std::string, float> &phase_ms) {
+    for (const auto &keyval : phase_ms) {
+      add("phase_ms." + keyval.first, keyval.second);
+    }
+  }
+
+  void add_host_info() {
+    char hostname[256] = "unknown";
+    gethostname(hostname, sizeof(hostname) - 1);
+    add("host.name", hostname);
+    add("host.nproc", static_cast<int>(std::thread::hardware_concurrency()));
+    const char *git_revision = std::getenv("BENCH_GIT_REVISION");
+    add("git_revision", git_revision ? git_revision : BENCH_GIT_REVISION);
+    std::time_t t = std::time(nullptr);
+    char time_str[64];
+    std::strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%SZ",
+                  std::gmtime(&t));
+    add("timestamp", time_str);
+  }
+
+#ifdef CUDART_VERSION
+  void add_device_info() {
+    int device = 0;
+    cudaDeviceProp prop;
+    if (cudaGetDevice(&device) != cudaSuccess ||
+        cudaGetDeviceProperties(&prop, device) != cudaSuccess) {
+      return;
+    }
+    add("device.name", prop.name);
+    add("device.cc", std::to_string(prop.major) + "." +
+                         std::to_string(prop.minor));
+    add("device.cudart_version", CUDART_VERSION);
+  }
+#endif
+
+  std::string to_jsonl() const {
+    std::string line = "{";
+    for (size_t idx = 0; idx < fields_.size(); idx++) {
+      if (idx > 0) line += ",";
+      line += "\"" + escape_json(fields_[idx].key) + "\":" + fields_[idx].json;
+    }
+    return line + "}";
+  }
+
+  // Escaped column names, in the order the fields were added
+  std::vector<std::string> get_csv_columns() const {
+    std::vector<std::string> columns;
+    for (const auto &field : fields_) columns.push_back(escape_csv(field.key));
+    return columns;
+  }
+
+  std::string to_csv_header() const {
+    std::string line;
+    for (size_t idx = 0; idx < fields_.size(); idx++) {
+      if (idx > 0) line += ",";
+      line += escape_csv(fields_[idx].key);
+    }
+    return line;
+  }
+
+  std::string to_csv_row() const {
+    std::string line;
+    for (size_t idx = 0; idx < fields_.size(); idx++) {
+      if (idx > 0) line += ",";
+      line += fields_[idx].csv;
+    }
+    return line;
+  }
+
+  // Row laid out by the given escaped column names; columns the record does
+  // not have are left empty
+  std::vector<std::string> to_csv_fields(
+      const std::vector<std::string> &columns) const {
+    std::vector<std::string> row(columns.size());
+    for (const auto &field : fields_) {
+      for (size_t idx = 0; idx < columns.size(); idx++) {
+        if (columns[idx] == escape_csv(field.key)) row[idx] = field.csv;
+      }
+    }
+    return row;
+  }
+
+ private:
+  struct Field {
+    std::string key;
+    std::string json;
+    std::string csv;
+  };
+
+  // Re-adding a key overwrites its value in place to keep the column order
+  Record &set(const std::string &key, const std::string &json,
+              const std::string &csv) {
+    for (auto &field : fields_) {
+      if (field.key == key) {
+        field.json = json;
+        field.csv = csv;
+        return *this;
+      }
+    }
+    fields_.push_back(Field{key, json, csv});
+    return *this;
+  }
+
+  std::vector<Field> fields_;
+};
+
+// Splits CSV text into rows of fields. The fields are kept escaped, so that
+// they can be written back unchanged.
+std::vector<std::vector<std::string>> split_csv(const std::string &text) {
+  std::vector<std::vector<std::string>> rows;
+  std::vector<std::string> row;
+  std::string field;
+  bool quoted = false;
+  for (char c : text) {
+    // An escaped quote ("") toggles twice
+    if (c == '"') quoted = !quoted;
+    if (!quoted && (c == ',' || c == '\n')) {
+      row.push_back(field);
+      field.clear();
+      if (c == '\n') {
+        rows.push_back(row);
+        row.clear();
+      }
+      continue;
+    }
+    field += c;
+  }
+  if (!field.empty() || !row.empty()) {
+    row.push_back(field);
+    rows.push_back(row);
+  }
+  return rows;
+}
+
+std::string join_csv(const std::vector<std::string> &fields) {
+  std::string line;
+  for (size_t idx = 0; idx < fields.size(); idx++) {
+    if (idx > 0) line += ",";
+    line += fields[idx];
+  }
+  return line;
+}
+
+// Reads the header of the CSV file at path, i.e., the text up to the first
+// newline outside quotes, split into escaped column names. Empty if the file
+// does not exist or is empty.
+std::vector<std::string> read_csv_header(const std::string &path) {
+  std::ifstream input(path, std::ios::binary);
+  std::string line;
+  bool quoted = false;
+  char c;
+  while (input.get(c)) {
+    if (c == '"') quoted = !quoted;
+    if (c == '\n' && !quoted) break;
+    line += c;
+  }
+  if (line.empty()) return {};
+  return split_csv(line).front();
+}
+
+// Appends the record to the CSV file at path, keyed by the header on its
+// first line. Only the header is read, so that appending stays cheap as the
+// file grows. When the record has columns the header lacks, they are added
+// at the end and the file is rewritten with the earlier rows padded, so that
+// every row stays aligned with the single header. Returns false if the file
+// cannot be written.
+bool append_csv(const std::string &path, const Record &record) {
+  std::vector<std::string> header = read_csv_header(path);
+  bool empty = header.empty();
+  if (empty) header = record.get_csv_columns();
+  bool rewrite = false;
+  for (const auto &column : record.get_csv_columns()) {
+    if (std::find(header.begin(), header.end(), column) == header.end()) {
+      header.push_back(column);
+      rewrite = true;
+    }
+  }
+  std::string row = join_csv(record.to_csv_fields(header));
+  if (!rewrite) {
+    FILE *fp = fopen(path.c_str(), "a");
+    if (fp == nullptr) return false;
+    if (empty) fprintf(fp, "%s\n", join_csv(header).c_str());
+    fprintf(fp, "%s\n", row.c_str());
+    return fclose(fp) == 0;
+  }
+  std::ifstream input(path, std::ios::binary);
+  std::stringstream text;
+  text << input.rdbuf();
+  input.close();
+  std::vector<std::vector<std::string>> rows = split_csv(text.str());
+  // Written next to the file and renamed, so that a failure leaves the old
+  // file intact
+  std::string tmp_path = path + ".tmp";
+  FILE *fp = fopen(tmp_path.c_str(), "w");
+  if (fp == nullptr) return false;
+  fprintf(fp, "%s\n", join_csv(header).c_str());
+  for (size_t idx = 1; idx < rows.size(); idx++) {
+    rows[idx].resize(header.size());
+    fprintf(fp, "%s\n", join_csv(rows[idx]).c_str());
+  }
+  fprintf(fp, "%s\n", row.c_str());
+  bool written = fclose(fp) == 0;
+  if (!written || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Writes the record in the requested format. On stdout, the CSV header is
+// written before the first record and again only when the columns change;
+// CSV files keep a single header, see append_csv().
+void emit(const OutputOptions &options, const Record &record) {
+  static std::string stdout_csv_header;
+  if (options.format == OutputFormat::kText) return;
+  if (!options.path.empty()) {
+    bool written = false;
+    if (options.format == OutputFormat::kCsv) {
+      written = append_csv(options.path, record);
+    } else {
+      FILE *fp = fopen(options.path.c_str(), "a");
+      if (fp != nullptr) {
+        fprintf(fp, "%s\n", record.to_jsonl().c_str());
+        written = fclose(fp) == 0;
+      }
+    }
+    if (written) return;
+    printf("Failed to write %s, emitting the record to stdout\n",
+           options.path.c_str());
+  }
+  if (options.format == OutputFormat::kJsonl) {
+    printf("%s\n", record.to_jsonl().c_str());
+  } else {
+    std::string header = record.to_csv_header();
+    if (header != stdout_csv_header) {
+      printf("%s\n", header.c_str());
+      stdout_csv_header = header;
+    }
+    printf("%s\n", record.to_csv_row().c_str());
+  }
+  fflush(stdout);
+}
+}  // namespace BenchRecord
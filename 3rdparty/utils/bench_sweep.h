@@ -0,0 +1,210 @@
+#pragma once
+// Sweep specification parsing for the single-process sweep mode of the
+// bench_* drivers. Host-only.
+//
+// A dimension spec is one of
+//   64            a single value
+//   32:1024       32 doubled until it passes 1024, i.e., 32, 64, ..., 1024
+//                 (24:100 is 24, 48, 96)
+//   32:1024:*4    geometric progression from 32 with factor 4
+//   128:512:128   arithmetic progression with step 128
+// A shape spec is MxNxK where each of M, N, K is a dimension spec; the shape
+// spec expands to the Cartesian product of the three dimensions. Several
+// shape specs are separated by commas. Every dimension must fit in an int,
+// which is what cuBLAS takes.
+#include <utils/helper_string.h>
+
+#include <array>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace BenchSweep {
+constexpr long kMaxValue = std::numeric_limits<int>::max();
+
+struct GemmPoint {
+  long m;
+  long n;
+  long k;
+  // 'N' or 'T'
+  char transa;
+  char transb;
+  std::string dtype;
+};
+
+std::vector<std::string> split(const std::string &str, char delimiter) {
+  std::vector<std::string> tokens;
+  std::string token;
+  std::istringstream stream(str);
+  while (std::getline(stream, token, delimiter)) {
+    if (!token.empty()) tokens.push_back(token);
+  }
+  return tokens;
+}
+
+// Also rejects values that do not fit in an int
+long parse_positive(const std::string &str) {
+  size_t pos = 0;
+  long value = 0;
+  try {
+    value = std::stol(str, &pos);
+  } catch (const std::out_of_range &) {
+    pos = 0;
+  }
+  if (pos != str.size() || value <= 0 || value > kMaxValue) {
+    throw std::invalid_argument("expected a positive integer up to " +
+                                std::to_string(kMaxValue) + ", got \"" + str +
+                                "\"");
+  }
+  return value;
+}
+
+bool is_transpose(char trans) { return trans == 'N' || trans == 'T'; }
+
+std::vector<long> parse_dim_spec(const std::string &spec) {
+  std::vector<std::string> fields = split(spec, ':');
+  if (fields.size() == 1) return {parse_positive(fields[0])};
+  if (fields.size() != 2 && fields.size() != 3) {
+    throw std::invalid_argument("malformed dimension spec \"" + spec + "\"");
+  }
+  long lo = parse_positive(fields[0]);
+  long hi = parse_positive(fields[1]);
+  bool geometric = true;
+  long step = 2;
+  if (fields.size() == 3) {
+    geometric = fields[2][0] == '*';
+    step = parse_positive(geometric ? fields[2].substr(1) : fields[2]);
+  }
+  if (lo > hi || (geometric && step < 2)) {
+    throw std::invalid_argument("empty or infinite dimension spec \"" + spec +
+                                "\"");
+  }
+  std::vector<long> values;
+  for (long value = lo;;) {
+    values.push_back(value);
+    // Stop before the next value passes hi, so that it cannot overflow
+    if (geometric ? value > hi / step : value > hi - step) break;
+    value = geometric ? value * step : value + step;
+  }
+  return values;
+}
+
+std::vector<std::array<long, 3>> parse_shape_spec(const std::string &spec) {
+  std::vector<std::array<long, 3>> shapes;
+  for (const auto &entry : split(spec, ',')) {
+    std::vector<std::string> dims = split(entry, 'x');
+    if (dims.size() != 3) {
+      throw std::invalid_argument("shape spec \"" + entry +
+                                  "\" is not of the form MxNxK");
+    }
+    std::vector<long> ms = parse_dim_spec(dims[0]);
+    std::vector<long> ns = parse_dim_spec(dims[1]);
+    std::vector<long> ks = parse_dim_spec(dims[2]);
+    for (long m : ms)
+      for (long n : ns)
+        for (long k : ks) shapes.push_back({m, n, k});
+  }
+  return shapes;
+}
+
+// Each non-empty line that does not start with '#' is "m n k [transa transb
+// [dtype]]", with transa and transb each N or T. A line without transposes
+// expands over the transposes pairs, one without a dtype over dtypes, in the
+// same order as a --sweep shape.
+std::vector<GemmPoint> parse_sweep_file(
+    const std::string &path, const std::vector<std::string> &transposes,
+    const std::vector<std::string> &dtypes) {
+  std::ifstream file(path);
+  if (!file) throw std::invalid_argument("cannot open sweep file " + path);
+  std::vector<GemmPoint> points;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream stream(line);
+    std::vector<std::string> fields;
+    for (std::string field; stream >> field;) fields.push_back(field);
+    if (fields.empty()) continue;
+    if (fields.size() != 3 && fields.size() != 5 && fields.size() != 6) {
+      throw std::invalid_argument("malformed sweep file line \"" + line + "\"");
+    }
+    long m = parse_positive(fields[0]);
+    long n = parse_positive(fields[1]);
+    long k = parse_positive(fields[2]);
+    std::vector<std::string> line_transposes = transposes;
+    if (fields.size() >= 5) {
+      if (fields[3].size() != 1 || fields[4].size() != 1 ||
+          !is_transpose(fields[3][0]) || !is_transpose(fields[4][0])) {
+        throw std::invalid_argument(
+            "malformed transposes in sweep file line \"" + line + "\"");
+      }
+      line_transposes = {fields[3] + fields[4]};
+    }
+    std::vector<std::string> line_dtypes = dtypes;
+    if (fields.size() == 6) line_dtypes = {fields[5]};
+    for (const auto &trans : line_transposes) {
+      for (const auto &dtype : line_dtypes) {
+        points.push_back(GemmPoint{m, n, k, trans[0], trans[1], dtype});
+      }
+    }
+  }
+  return points;
+}
+
+void print_sweep_usage() {
+  printf(
+      "Sweep options: --sweep=MxNxK[,MxNxK...] | --sweep_file=... "
+      "[--transposes=NN[,NT,TN,TT]] [--dtypes=fp32[,tf32,fp16,bf16,fp64]]\n"
+      "Each of M, N, K is a value, lo:hi (lo doubled up to hi), lo:hi:*factor\n"
+      "or lo:hi:step. --sweep_file takes one line per point,\n"
+      "\"m n k [transa transb [dtype]]\"; lines without transposes or dtype\n"
+      "expand over --transposes and --dtypes. All points run in one process\n"
+      "and share the handle, the stream and the device arena; one record is\n"
+      "emitted per point.\n");
+}
+
+bool is_sweep(const int argc, const char **argv) {
+  return checkCmdLineFlag(argc, argv, "sweep") ||
+         checkCmdLineFlag(argc, argv, "sweep_file");
+}
+
+// Expands the command line into the ordered list of points. Shapes vary
+// slowest, then transposes, then dtypes.
+std::vector<GemmPoint> parse_gemm_sweep(const int argc, const char **argv) {
+  char *str = nullptr;
+  std::vector<std::string> dtypes = {"fp32"};
+  if (getCmdLineArgumentString(argc, argv, "dtypes", &str)) {
+    dtypes = split(str, ',');
+  }
+  std::vector<std::string> transposes = {"NN"};
+  if (getCmdLineArgumentString(argc, argv, "transposes", &str)) {
+    transposes = split(str, ',');
+  }
+  for (const auto &trans : transposes) {
+    if (trans.size() != 2 || !is_transpose(trans[0]) ||
+        !is_transpose(trans[1])) {
+      throw std::invalid_argument("malformed transpose pair \"" + trans +
+                                  "\"");
+    }
+  }
+
+  std::vector<GemmPoint> points;
+  // Checked first because helper_string matches "sweep" against
+  // "--sweep_file=..." as well
+  if (getCmdLineArgumentString(argc, argv, "sweep_file", &str)) {
+    points = parse_sweep_file(str, transposes, dtypes);
+  } else if (getCmdLineArgumentString(argc, argv, "sweep", &str)) {
+    for (const auto &shape : parse_shape_spec(str)) {
+      for (const auto &trans : transposes) {
+        for (const auto &dtype : dtypes) {
+          points.push_back(
+              GemmPoint{shape[0], shape[1], shape[2], trans[0], trans[1], dtype});
+        }
+      }
+    }
+  }
+  return points;
+}
+}  // namespace BenchSweep
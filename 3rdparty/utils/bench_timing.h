@@ -0,0 +1,234 @@
+#pragma once
+// Multi-iteration timing engine shared by the bench_* drivers.
+// This header is host-only: the driver passes a callable that runs one
+// measured iteration and returns its elapsed time in milliseconds (usually
+// from a cudaEvent pair), so the stop rule and the statistics can be driven
+// by synthetic timings without a GPU.
+#include <utils/helper_string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace BenchTiming {
+struct Config {
+  // Untimed iterations executed before sampling starts
+  int warmup_iters;
+  // Sampling never stops before min_iters samples are collected
+  int min_iters;
+  // Hard cap on the number of samples
+  int max_iters;
+  // Stop once the 95% confidence interval half-width relative to the mean is
+  // below this value. 0 disables the rule.
+  double target_rel_ci;
+  // Stop once the accumulated sample time exceeds this value. 0 disables the
+  // rule.
+  double max_time_ms;
+};
+
+struct Summary {
+  int num_warmup;
+  int num_samples;
+  double min;
+  double median;
+  double p90;
+  double p99;
+  double max;
+  double mean;
+  double stddev;
+  // Half-width of the 95% confidence interval of the mean, divided by the
+  // mean
+  double rel_ci;
+  // True if sampling stopped because target_rel_ci was reached
+  bool converged;
+};
+
+Config get_default_config() {
+  return Config{.warmup_iters = 5,
+                .min_iters = 10,
+                .max_iters = 1000,
+                .target_rel_ci = 0.01,
+                .max_time_ms = 2000.0};
+}
+
+// Config that reproduces the legacy single cold sample behavior
+Config get_single_shot_config() {
+  return Config{.warmup_iters = 0,
+                .min_iters = 1,
+                .max_iters = 1,
+                .target_rel_ci = 0.0,
+                .max_time_ms = 0.0};
+}
+
+void print_timing_usage() {
+  printf(
+      "Timing options: [--warmup_iters=##] [--min_iters=##] [--max_iters=##] "
+      "[--target_rel_ci=0.##] [--max_time_ms=##] [--single_shot]\n");
+  printf(
+      "--warmup_iters runs untimed iterations before sampling\n"
+      "Sampling stops after --max_iters samples, or after --min_iters samples\n"
+      "once the relative 95%% confidence interval of the mean drops below\n"
+      "--target_rel_ci or the accumulated time exceeds --max_time_ms\n"
+      "--single_shot times exactly one cold iteration (the legacy behavior)\n");
+}
+
+Config parse_config(const int argc, const char **argv) {
+  Config config = checkCmdLineFlag(argc, argv, "single_shot")
+                      ? get_single_shot_config()
+                      : get_default_config();
+  if (checkCmdLineFlag(argc, argv, "warmup_iters")) {
+    config.warmup_iters = getCmdLineArgumentInt(argc, argv, "warmup_iters");
+  }
+  if (checkCmdLineFlag(argc, argv, "min_iters")) {
+    config.min_iters = getCmdLineArgumentInt(argc, argv, "min_iters");
+  }
+  if (checkCmdLineFlag(argc, argv, "max_iters")) {
+    config.max_iters = getCmdLineArgumentInt(argc, argv, "max_iters");
+  }
+  if (checkCmdLineFlag(argc, argv, "target_rel_ci")) {
+    config.target_rel_ci = getCmdLineArgumentFloat(argc, argv, "target_rel_ci");
+  }
+  if (checkCmdLineFlag(argc, argv, "max_time_ms")) {
+    config.max_time_ms = getCmdLineArgumentFloat(argc, argv, "max_time_ms");
+  }
+  config.warmup_iters = std::max(config.warmup_iters, 0);
+  config.max_iters = std::max(config.max_iters, 1);
+  config.min_iters = std::min(std::max(config.min_iters, 1), config.max_iters);
+  return config;
+}
+
+// Two-sided 97.5% quantile of Student's t distribution. Exact table up to 30
+// degrees of freedom, normal approximation afterwards.
+double student_t_975(int degrees_of_freedom) {
+  static const double table[30] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if (degrees_of_freedom < 1) return INFINITY;
+  if (degrees_of_freedom <= 30) return table[degrees_of_freedom - 1];
+  return 1.96;
+}
+
+// Percentile with linear interpolation between closest ranks. sorted_samples
+// must be non-empty and sorted in ascending order.
+double get_percentile(const std::vector<double> &sorted_samples, double q) {
+  double rank = q * (sorted_samples.size() - 1);
+  size_t lo = static_cast<size_t>(std::floor(rank));
+  size_t hi = static_cast<size_t>(std::ceil(rank));
+  double frac = rank - lo;
+  return sorted_samples[lo] + (sorted_samples[hi] - sorted_samples[lo]) * frac;
+}
+
+Summary summarize(std::vector<double> samples, int num_warmup = 0,
+                  bool converged = false) {
+  Summary summary{};
+  summary.num_warmup = num_warmup;
+  summary.num_samples = samples.size();
+  summary.converged = converged;
+  if (samples.empty()) return summary;
+  std::sort(samples.begin(), samples.end());
+  double sum = 0.0;
+  for (double sample : samples) sum += sample;
+  summary.mean = sum / samples.size();
+  double sq_sum = 0.0;
+  for (double sample : samples) {
+    sq_sum += (sample - summary.mean) * (sample - summary.mean);
+  }
+  summary.stddev =
+      samples.size() > 1 ? std::sqrt(sq_sum / (samples.size() - 1)) : 0.0;
+  summary.min = samples.front();
+  summary.max = samples.back();
+  summary.median = get_percentile(samples, 0.5);
+  summary.p90 = get_percentile(samples, 0.9);
+  summary.p99 = get_percentile(samples, 0.99);
+  summary.rel_ci =
+      (samples.size() > 1 && summary.mean > 0.0)
+          ? student_t_975(samples.size() - 1) * summary.stddev /
+                std::sqrt(static_cast<double>(samples.size())) / summary.mean
+          : INFINITY;
+  return summary;
+}
+
+// Accumulates samples and applies the stop rule. The running mean and variance
+// are maintained with Welford's algorithm so that done() is O(1).
+class Sampler {
+ public:
+  explicit Sampler(const Config &config) : config_(config) {}
+
+  void add(double elapsed_ms) {
+    samples_.push_back(elapsed_ms);
+    total_ms_ += elapsed_ms;
+    double delta = elapsed_ms - mean_;
+    mean_ += delta / samples_.size();
+    m2_ += delta * (elapsed_ms - mean_);
+  }
+
+  double get_rel_ci() const {
+    int n = samples_.size();
+    if (n < 2 || mean_ <= 0.0) return INFINITY;
+    double stddev = std::sqrt(m2_ / (n - 1));
+    return student_t_975(n - 1) * stddev / std::sqrt(static_cast<double>(n)) /
+           mean_;
+  }
+
+  bool converged() const {
+    return config_.target_rel_ci > 0.0 &&
+           static_cast<int>(samples_.size()) >= config_.min_iters &&
+           get_rel_ci() <= config_.target_rel_ci;
+  }
+
+  bool done() const {
+    int n = samples_.size();
+    if (n >= config_.max_iters) return true;
+    if (n < config_.min_iters) return false;
+    if (config_.max_time_ms > 0.0 && total_ms_ >= config_.max_time_ms)
+      return true;
+    return converged();
+  }
+
+  const std::vector<double> &get_samples() const { return samples_; }
+
+  Summary get_summary() const {
+    return summarize(samples_, config_.warmup_iters, converged());
+  }
+
+ private:
+  Config config_;
+  std::vector<double> samples_;
+  double total_ms_ = 0.0;
+  double mean_ = 0.0;
+  double m2_ = 0.0;
+};
+
+// Runs config.warmup_iters untimed iterations, then samples run_iteration()
+// until the stop rule fires. run_iteration must return the elapsed time of one
+// iteration in milliseconds.
+template <typename IterationFunc>
+Summary measure(const Config &config, IterationFunc &&run_iteration) {
+  for (int idx = 0; idx < config.warmup_iters; idx++) {
+    run_iteration();
+  }
+  Sampler sampler(config);
+  while (!sampler.done()) {
+    sampler.add(run_iteration());
+  }
+  return sampler.get_summary();
+}
+
+// Prints the summary. The first line keeps the legacy "<name> elapsed time
+// (ms):" keyword (now the median) so that existing scrapers keep working.
+void print_summary(const char *name, const Summary &summary, double flop) {
+  printf("%s elapsed time (ms): %f\n", name, summary.median);
+  if (flop > 0.0 && summary.median > 0.0) {
+    printf("%s throughput (GFLOPS): %f\n", name,
+           flop / (summary.median / 1000.0) / 1e9);
+  }
+  printf(
+      "%s timing stats (ms): warmup=%d samples=%d min=%f median=%f p90=%f "
+      "p99=%f max=%f mean=%f stddev=%f rel_ci=%f converged=%d\n",
+      name, summary.num_warmup, summary.num_samples, summary.min,
+      summary.median, summary.p90, summary.p99, summary.max, summary.mean,
+      summary.stddev, summary.rel_ci, summary.converged);
+}
+}  // namespace BenchTiming
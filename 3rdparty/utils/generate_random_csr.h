@@ -0,0 +1,609 @@
+#pragma once
+// Multi-threaded random CSR generator. Host-only, no cusp dependency.
+//
+// Patterns
+//   uniform    distinct coordinates drawn uniformly over the whole m x n space
+//   power_law  row degrees proportional to rank^-alpha over a random row
+//              permutation, columns uniform within each row
+//   banded     coordinates drawn uniformly within |row - col| <= bandwidth
+//   block      block_rows x block_cols dense blocks placed uniformly over the
+//              block grid; nnz is rounded up to whole blocks
+//   2:4        exactly two nonzeros in every group of four columns of every
+//              row; the requested nnz is ignored (it is always ~m * n / 2)
+//
+// Rows are processed in fixed-size chunks, each with its own random stream
+// derived from the seed, so the output depends on the seed only and not on
+// the number of threads. Column indices of every row are sorted and distinct.
+#include <utils/helper_string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace RandomCSR {
+enum class Pattern { kUniform, kPowerLaw, kBanded, kBlock, kTwoFour };
+
+struct Options {
+  Pattern pattern;
+  uint64_t seed;
+  // 0 means std::thread::hardware_concurrency()
+  int num_threads;
+  // Exponent of the power_law pattern
+  double power_law_alpha;
+  // Half-width of the banded pattern
+  long bandwidth;
+  // Block shape of the block pattern
+  int block_rows;
+  int block_cols;
+};
+
+template <typename IndexType, typename ValueType>
+struct CSR {
+  long num_rows;
+  long num_cols;
+  std::vector<IndexType> row_offsets;
+  std::vector<IndexType> column_indices;
+  std::vector<ValueType> values;
+};
+
+struct RowStats {
+  long min;
+  long max;
+  double mean;
+  double stddev;
+  long empty_rows;
+};
+
+constexpr long kRowsPerChunk = 1024;
+
+Options get_default_options() {
+  return Options{.pattern = Pattern::kUniform,
+                 .seed = 0,
+                 .num_threads = 0,
+                 .power_law_alpha = 1.0,
+                 .bandwidth = 16,
+                 .block_rows = 4,
+                 .block_cols = 4};
+}
+
+Pattern parse_pattern(const std::string &str) {
+  if (str == "uniform") return Pattern::kUniform;
+  if (str == "power_law") return Pattern::kPowerLaw;
+  if (str == "banded") return Pattern::kBanded;
+  if (str == "block") return Pattern::kBlock;
+  if (str == "2:4") return Pattern::kTwoFour;
+  throw std::invalid_argument("unknown sparsity pattern \"" + str + "\"");
+}
+
+const char *get_pattern_name(Pattern pattern) {
+  switch (pattern) {
+    case Pattern::kPowerLaw:
+      return "power_law";
+    case Pattern::kBanded:
+      return "banded";
+    case Pattern::kBlock:
+      return "block";
+    case Pattern::kTwoFour:
+      return "2:4";
+    default:
+      return "uniform";
+  }
+}
+
+void print_pattern_usage() {
+  printf(
+      "Sparsity options: [--pattern=uniform|power_law|banded|block|2:4] "
+      "[--seed=##] [--power_law_alpha=#.#] [--bandwidth=##] "
+      "[--block_rows=##] [--block_cols=##] [--gen_threads=##]\n");
+}
+
+// The seed defaults to rand() so that callers seeding rand() keep their
+// behavior
+Options parse_options(const int argc, const char **argv) {
+  Options options = get_default_options();
+  options.seed = static_cast<uint64_t>(rand());
+  char *pattern_str = nullptr;
+  if (getCmdLineArgumentString(argc, argv, "pattern", &pattern_str)) {
+    options.pattern = parse_pattern(pattern_str);
+  }
+  if (checkCmdLineFlag(argc, argv, "seed")) {
+    options.seed = getCmdLineArgumentInt(argc, argv, "seed");
+  }
+  if (checkCmdLineFlag(argc, argv, "gen_threads")) {
+    options.num_threads = getCmdLineArgumentInt(argc, argv, "gen_threads");
+  }
+  if (checkCmdLineFlag(argc, argv, "power_law_alpha")) {
+    options.power_law_alpha =
+        getCmdLineArgumentFloat(argc, argv, "power_law_alpha");
+  }
+  if (checkCmdLineFlag(argc, argv, "bandwidth")) {
+    options.bandwidth = getCmdLineArgumentInt(argc, argv, "bandwidth");
+  }
+  if (checkCmdLineFlag(argc, argv, "block_rows")) {
+    options.block_rows = getCmdLineArgumentInt(argc, argv, "block_rows");
+  }
+  if (checkCmdLineFlag(argc, argv, "block_cols")) {
+    options.block_cols = getCmdLineArgumentInt(argc, argv, "block_cols");
+  }
+  return options;
+}
+
+// SplitMix64 finalizer, used to derive independent per-chunk seeds
+uint64_t mix_seed(uint64_t seed, uint64_t stream_id) {
+  uint64_t z = seed + 0x9e3779b97f4a7c15ULL * (stream_id + 1);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+int get_num_threads(const Options &options) {
+  if (options.num_threads > 0) return options.num_threads;
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Runs func(task) for task in [0, num_tasks) on num_threads threads
+template <typename TaskFunc>
+void parallel_for(long num_tasks, int num_threads, TaskFunc &&func) {
+  num_threads = static_cast<int>(std::min<long>(num_threads, num_tasks));
+  if (num_threads <= 1) {
+    for (long task = 0; task < num_tasks; task++) func(task);
+    return;
+  }
+  std::atomic<long> next_task(0);
+  std::vector<std::thread> workers;
+  for (int idx = 0; idx < num_threads; idx++) {
+    workers.emplace_back([&]() {
+      for (long task = next_task++; task < num_tasks; task = next_task++) {
+        func(task);
+      }
+    });
+  }
+  for (auto &worker : workers) worker.join();
+}
+
+// Number of the num_draws cells that fall into the first num_left of
+// num_cells cells, when num_draws distinct cells are drawn uniformly. This is
+// hypergeometric; it is approximated by a binomial on the smaller of the
+// chosen and the unchosen cells and clamped to the feasible range.
+long long split_draws(long long num_cells, long long num_left,
+                      long long num_draws, std::mt19937_64 &rng) {
+  long long lo = std::max(0LL, num_draws - (num_cells - num_left));
+  long long hi = std::min(num_draws, num_left);
+  if (lo >= hi) return lo;
+  double p = static_cast<double>(num_left) / num_cells;
+  long long left;
+  if (2 * num_draws <= num_cells) {
+    left = std::binomial_distribution<long long>(num_draws, p)(rng);
+  } else {
+    left = num_left - std::binomial_distribution<long long>(
+                          num_cells - num_draws, p)(rng);
+  }
+  return std::min(std::max(left, lo), hi);
+}
+
+// Distributes num_draws over rows [lo, hi) so that each draw lands on a
+// uniformly chosen free cell. capacity_prefix[r] is the number of cells in
+// the first r rows.
+void split_rows(const std::vector<long long> &capacity_prefix, long lo,
+                long hi, long long num_draws, long long *counts,
+                std::mt19937_64 &rng) {
+  if (num_draws == 0) return;
+  if (hi - lo == 1) {
+    counts[lo] = num_draws;
+    return;
+  }
+  long mid = lo + (hi - lo) / 2;
+  long long num_left = split_draws(
+      capacity_prefix[hi] - capacity_prefix[lo],
+      capacity_prefix[mid] - capacity_prefix[lo], num_draws, rng);
+  split_rows(capacity_prefix, lo, mid, num_left, counts, rng);
+  split_rows(capacity_prefix, mid, hi, num_draws - num_left, counts, rng);
+}
+
+// Writes count distinct sorted columns of [col_lo, col_hi) to out
+template <typename IndexType>
+void sample_columns(long col_lo, long col_hi, long count, IndexType *out,
+                    std::mt19937_64 &rng) {
+  long width = col_hi - col_lo;
+  if (count == width) {
+    for (long idx = 0; idx < count; idx++) out[idx] = col_lo + idx;
+    return;
+  }
+  if (count * 16 >= width) {
+    // Selection sampling (Knuth's Algorithm S): one pass, output is sorted
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    long needed = count;
+    for (long col = 0; col < width && needed > 0; col++) {
+      if (uniform(rng) * (width - col) < needed) {
+        *out++ = col_lo + col;
+        needed--;
+      }
+    }
+    return;
+  }
+  // Sparse rows: draw, sort, drop duplicates and redraw the missing ones
+  std::uniform_int_distribution<long> column(col_lo, col_hi - 1);
+  long filled = 0;
+  while (filled < count) {
+    for (long idx = filled; idx < count; idx++) out[idx] = column(rng);
+    std::sort(out, out + count);
+    filled = std::unique(out, out + count) - out;
+  }
+}
+
+template <typename IndexType>
+void exclusive_scan_counts(const std::vector<long long> &counts,
+                           std::vector<IndexType> &row_offsets) {
+  row_offsets.assign(counts.size() + 1, 0);
+  long long sum = 0;
+  for (size_t row = 0; row < counts.size(); row++) {
+    sum += counts[row];
+    row_offsets[row + 1] = static_cast<IndexType>(sum);
+  }
+  if (static_cast<long long>(row_offsets.back()) != sum) {
+    throw std::overflow_error("nnz does not fit in the CSR index type");
+  }
+}
+
+// Rows whose nonzeros lie in the column window [col_lo(row), col_hi(row)).
+// Row counts are drawn so that the nnz coordinates are distinct and uniform
+// over all cells of all windows.
+template <typename IndexType, typename ValueType, typename WindowFunc>
+CSR<IndexType, ValueType> generate_windowed(long m, long n, long long nnz,
+                                            const Options &options,
+                                            WindowFunc &&get_window) {
+  long num_chunks = (m + kRowsPerChunk - 1) / kRowsPerChunk;
+  int num_threads = get_num_threads(options);
+  auto get_capacity = [&](long row) {
+    auto window = get_window(row);
+    return static_cast<long long>(window.second - window.first);
+  };
+
+  // Split nnz over chunks serially, then over the rows of each chunk
+  std::vector<long long> chunk_capacity(num_chunks + 1, 0);
+  parallel_for(num_chunks, num_threads, [&](long chunk) {
+    long long capacity = 0;
+    long row_end = std::min(m, (chunk + 1) * kRowsPerChunk);
+    for (long row = chunk * kRowsPerChunk; row < row_end; row++) {
+      capacity += get_capacity(row);
+    }
+    chunk_capacity[chunk + 1] = capacity;
+  });
+  std::partial_sum(chunk_capacity.begin(), chunk_capacity.end(),
+                   chunk_capacity.begin());
+  if (nnz > chunk_capacity.back()) {
+    throw std::invalid_argument("nnz exceeds the number of available cells");
+  }
+  std::vector<long long> chunk_nnz(num_chunks, 0);
+  std::mt19937_64 rng(mix_seed(options.seed, 0));
+  split_rows(chunk_capacity, 0, num_chunks, nnz, chunk_nnz.data(), rng);
+
+  std::vector<long long> counts(m, 0);
+  parallel_for(num_chunks, num_threads, [&](long chunk) {
+    long row_begin = chunk * kRowsPerChunk;
+    long row_end = std::min(m, row_begin + kRowsPerChunk);
+    std::vector<long long> capacity_prefix(row_end - row_begin + 1, 0);
+    for (long row = row_begin; row < row_end; row++) {
+      capacity_prefix[row - row_begin + 1] =
+          capacity_prefix[row - row_begin] + get_capacity(row);
+    }
+    std::mt19937_64 chunk_rng(mix_seed(options.seed, 2 * chunk + 1));
+    split_rows(capacity_prefix, 0, row_end - row_begin, chunk_nnz[chunk],
+               counts.data() + row_begin, chunk_rng);
+  });
+
+  CSR<IndexType, ValueType> csr{.num_rows = m,
+                                .num_cols = n,
+                                .row_offsets = {},
+                                .column_indices = {},
+                                .values = {}};
+  exclusive_scan_counts(counts, csr.row_offsets);
+  csr.column_indices.resize(nnz);
+  csr.values.resize(nnz);
+  parallel_for(num_chunks, num_threads, [&](long chunk) {
+    std::mt19937_64 chunk_rng(mix_seed(options.seed, 2 * chunk + 2));
+    std::uniform_real_distribution<double> value(0.0, 1.0);
+    long row_end = std::min(m, (chunk + 1) * kRowsPerChunk);
+    for (long row = chunk * kRowsPerChunk; row < row_end; row++) {
+      auto window = get_window(row);
+      long long begin = csr.row_offsets[row];
+      long long end = csr.row_offsets[row + 1];
+      sample_columns(window.first, window.second, end - begin,
+                     csr.column_indices.data() + begin, chunk_rng);
+      for (long long idx = begin; idx < end; idx++) {
+        csr.values[idx] = static_cast<ValueType>(value(chunk_rng));
+      }
+    }
+  });
+  return csr;
+}
+
+// Fills the columns and values of a CSR whose row_offsets are already set,
+// with columns uniform within each row
+template <typename IndexType, typename ValueType>
+void fill_rows_uniform(CSR<IndexType, ValueType> &csr, const Options &options) {
+  long num_chunks = (csr.num_rows + kRowsPerChunk - 1) / kRowsPerChunk;
+  csr.column_indices.resize(csr.row_offsets.back());
+  csr.values.resize(csr.row_offsets.back());
+  parallel_for(num_chunks, get_num_threads(options), [&](long chunk) {
+    std::mt19937_64 chunk_rng(mix_seed(options.seed, 2 * chunk + 2));
+    std::uniform_real_distribution<double> value(0.0, 1.0);
+    long row_end = std::min(csr.num_rows, (chunk + 1) * kRowsPerChunk);
+    for (long row = chunk * kRowsPerChunk; row < row_end; row++) {
+      long long begin = csr.row_offsets[row];
+      long long end = csr.row_offsets[row + 1];
+      sample_columns(0, csr.num_cols, end - begin,
+                     csr.column_indices.data() + begin, chunk_rng);
+      for (long long idx = begin; idx < end; idx++) {
+        csr.values[idx] = static_cast<ValueType>(value(chunk_rng));
+      }
+    }
+  });
+}
+
+template <typename IndexType, typename ValueType>
+CSR<IndexType, ValueType> generate_power_law(long m, long n, long long nnz,
+                                             const Options &options) {
+  if (nnz > static_cast<long long>(m) * n) {
+    throw std::invalid_argument("nnz exceeds the number of available cells");
+  }
+  // rank[row] is the position of row in the degree ordering
+  std::vector<long> rank(m);
+  std::iota(rank.begin(), rank.end(), 0);
+  std::mt19937_64 rng(mix_seed(options.seed, 0));
+  std::shuffle(rank.begin(), rank.end(), rng);
+  std::vector<double> weight(m);
+  double weight_sum = 0.0;
+  for (long row = 0; row < m; row++) {
+    weight[row] = std::pow(rank[row] + 1.0, -options.power_law_alpha);
+    weight_sum += weight[row];
+  }
+  std::vector<long long> counts(m);
+  long long remaining = nnz;
+  for (long row = 0; row < m; row++) {
+    counts[row] = std::min<long long>(
+        n, static_cast<long long>(nnz * (weight[row] / weight_sum)));
+    remaining -= counts[row];
+  }
+  // Hand out the rounding remainder and the excess of saturated rows,
+  // heaviest rows first
+  std::vector<long> by_rank(m);
+  for (long row = 0; row < m; row++) by_rank[rank[row]] = row;
+  while (remaining > 0) {
+    double free_weight = 0.0;
+    for (long row : by_rank) {
+      if (counts[row] < n) free_weight += weight[row];
+    }
+    long long to_distribute = remaining;
+    for (long row : by_rank) {
+      if (remaining == 0) break;
+      if (counts[row] == n) continue;
+      long long share = std::max<long long>(
+          1, static_cast<long long>(to_distribute * weight[row] / free_weight));
+      share = std::min({share, remaining, n - counts[row]});
+      counts[row] += share;
+      remaining -= share;
+    }
+  }
+
+  CSR<IndexType, ValueType> csr{.num_rows = m,
+                                .num_cols = n,
+                                .row_offsets = {},
+                                .column_indices = {},
+                                .values = {}};
+  exclusive_scan_counts(counts, csr.row_offsets);
+  fill_rows_uniform(csr, options);
+  return csr;
+}
+
+template <typename IndexType, typename ValueType>
+CSR<IndexType, ValueType> generate_block(long m, long n, long long nnz,
+                                         const Options &options) {
+  long block_rows = std::max(options.block_rows, 1);
+  long block_cols = std::max(options.block_cols, 1);
+  long grid_rows = (m + block_rows - 1) / block_rows;
+  long grid_cols = (n + block_cols - 1) / block_cols;
+  long long num_blocks =
+      std::min<long long>((nnz + block_rows * block_cols - 1) /
+                              (block_rows * block_cols),
+                          static_cast<long long>(grid_rows) * grid_cols);
+  // Uniform pattern on the block grid, then expanded row by row
+  auto grid = generate_windowed<long long, char>(
+      grid_rows, grid_cols, num_blocks, options,
+      [&](long) { return std::make_pair(0L, grid_cols); });
+  auto get_block_width = [&](long long block_col) {
+    return std::min<long>(block_cols, n - block_col * block_cols);
+  };
+
+  std::vector<long long> counts(m, 0);
+  for (long row = 0; row < m; row++) {
+    long grid_row = row / block_rows;
+    for (long long idx = grid.row_offsets[grid_row];
+         idx < grid.row_offsets[grid_row + 1]; idx++) {
+      counts[row] += get_block_width(grid.column_indices[idx]);
+    }
+  }
+  CSR<IndexType, ValueType> csr{.num_rows = m,
+                                .num_cols = n,
+                                .row_offsets = {},
+                                .column_indices = {},
+                                .values = {}};
+  exclusive_scan_counts(counts, csr.row_offsets);
+  csr.column_indices.resize(csr.row_offsets.back());
+  csr.values.resize(csr.row_offsets.back());
+  long num_chunks = (m + kRowsPerChunk - 1) / kRowsPerChunk;
+  parallel_for(num_chunks, get_num_threads(options), [&](long chunk) {
+    std::mt19937_64 chunk_rng(mix_seed(options.seed, 2 * chunk + 2));
+    std::uniform_real_distribution<double> value(0.0, 1.0);
+    long row_end = std::min(m, (chunk + 1) * kRowsPerChunk);
+    for (long row = chunk * kRowsPerChunk; row < row_end; row++) {
+      long grid_row = row / block_rows;
+      long long out = csr.row_offsets[row];
+      for (long long idx = grid.row_offsets[grid_row];
+           idx < grid.row_offsets[grid_row + 1]; idx++) {
+        long long block_col = grid.column_indices[idx];
+        for (long col = 0; col < get_block_width(block_col); col++) {
+          csr.column_indices[out] = block_col * block_cols + col;
+          csr.values[out++] = static_cast<ValueType>(value(chunk_rng));
+        }
+      }
+    }
+  });
+  return csr;
+}
+
+template <typename IndexType, typename ValueType>
+CSR<IndexType, ValueType> generate_two_four(long m, long n,
+                                            const Options &options) {
+  // Column pairs of the 6 valid 2:4 masks
+  static const int kMasks[6][2] = {{0, 1}, {0, 2}, {0, 3},
+                                   {1, 2}, {1, 3}, {2, 3}};
+  long row_nnz = 2 * (n / 4) + std::min(2L, n % 4);
+  std::vector<long long> counts(m, row_nnz);
+  CSR<IndexType, ValueType> csr{.num_rows = m,
+                                .num_cols = n,
+                                .row_offsets = {},
+                                .column_indices = {},
+                                .values = {}};
+  exclusive_scan_counts(counts, csr.row_offsets);
+  csr.column_indices.resize(csr.row_offsets.back());
+  csr.values.resize(csr.row_offsets.back());
+  long num_chunks = (m + kRowsPerChunk - 1) / kRowsPerChunk;
+  parallel_for(num_chunks, get_num_threads(options), [&](long chunk) {
+    std::mt19937_64 chunk_rng(mix_seed(options.seed, 2 * chunk + 2));
+    std::uniform_int_distribution<int> mask(0, 5);
+    std::uniform_real_distribution<double> value(0.0, 1.0);
+    long row_end = std::min(m, (chunk + 1) * kRowsPerChunk);
+    for (long row = chunk * kRowsPerChunk; row < row_end; row++) {
+      long long out = csr.row_offsets[row];
+      for (long group = 0; group < n; group += 4) {
+        if (n - group < 4) {
+          // Partial trailing group: keep its first min(2, width) columns
+          for (long col = group; col < n && col < group + 2; col++) {
+            csr.column_indices[out++] = col;
+          }
+          continue;
+        }
+        int selected = mask(chunk_rng);
+        csr.column_indices[out++] = group + kMasks[selected][0];
+        csr.column_indices[out++] = group + kMasks[selected][1];
+      }
+      for (long long idx = csr.row_offsets[row]; idx < out; idx++) {
+        csr.values[idx] = static_cast<ValueType>(value(chunk_rng));
+      }
+    }
+  });
+  return csr;
+}
+
+// Largest nnz that generate() accepts for an m x n matrix: the cells within
+// the band for the banded pattern, m * n otherwise. The block pattern caps
+// its nnz at the block grid and 2:4 ignores it, so they accept any nnz.
+long long get_max_nnz(long m, long n, const Options &options) {
+  if (m <= 0 || n <= 0) return 0;
+  switch (options.pattern) {
+    case Pattern::kBanded: {
+      long bandwidth = std::max(options.bandwidth, 0L);
+      long long cells = 0;
+      for (long row = 0; row < m; row++) {
+        cells += std::min(n, row + bandwidth + 1) -
+                 std::min(n, std::max(0L, row - bandwidth));
+      }
+      return cells;
+    }
+    case Pattern::kBlock:
+    case Pattern::kTwoFour:
+      return std::numeric_limits<long long>::max();
+    default:
+      return static_cast<long long>(m) * n;
+  }
+}
+
+// Generates an m x n CSR matrix with nnz distinct nonzeros following
+// options.pattern. Throws std::invalid_argument if nnz does not fit, i.e.,
+// exceeds get_max_nnz().
+template <typename IndexType, typename ValueType>
+CSR<IndexType, ValueType> generate(long m, long n, long long nnz,
+                                   const Options &options) {
+  if (m <= 0 || n <= 0 || nnz < 0) {
+    throw std::invalid_argument("invalid matrix shape or nnz");
+  }
+  switch (options.pattern) {
+    case Pattern::kPowerLaw:
+      return generate_power_law<IndexType, ValueType>(m, n, nnz, options);
+    case Pattern::kBanded: {
+      long bandwidth = std::max(options.bandwidth, 0L);
+      return generate_windowed<IndexType, ValueType>(
+          m, n, nnz, options, [&](long row) {
+            return std::make_pair(std::min(n, std::max(0L, row - bandwidth)),
+                                  std::min(n, row + bandwidth + 1));
+          });
+    }
+    case Pattern::kBlock:
+      return generate_block<IndexType, ValueType>(m, n, nnz, options);
+    case Pattern::kTwoFour:
+      return generate_two_four<IndexType, ValueType>(m, n, options);
+    default:
+      return generate_windowed<IndexType, ValueType>(
+          m, n, nnz, options, [&](long) { return std::make_pair(0L, n); });
+  }
+}
+
+// Returns an empty string if csr is well formed, i.e., monotonic row offsets
+// and strictly increasing in-range column indices in every row, and a
+// description of the first violation otherwise
+template <typename IndexType, typename ValueType>
+std::string validate(const CSR<IndexType, ValueType> &csr) {
+  if (static_cast<long>(csr.row_offsets.size()) != csr.num_rows + 1 ||
+      csr.row_offsets.front() != 0 ||
+      static_cast<size_t>(csr.row_offsets.back()) !=
+          csr.column_indices.size() ||
+      csr.column_indices.size() != csr.values.size()) {
+    return "inconsistent array sizes";
+  }
+  for (long row = 0; row < csr.num_rows; row++) {
+    if (csr.row_offsets[row] > csr.row_offsets[row + 1]) {
+      return "decreasing row offset at row " + std::to_string(row);
+    }
+    for (auto idx = csr.row_offsets[row]; idx < csr.row_offsets[row + 1];
+         idx++) {
+      if (csr.column_indices[idx] < 0 ||
+          csr.column_indices[idx] >= csr.num_cols) {
+        return "column out of range at row " + std::to_string(row);
+      }
+      if (idx > csr.row_offsets[row] &&
+          csr.column_indices[idx] <= csr.column_indices[idx - 1]) {
+        return "unsorted or duplicate column at row " + std::to_string(row);
+      }
+    }
+  }
+  return "";
+}
+
+template <typename IndexType, typename ValueType>
+RowStats get_row_stats(const CSR<IndexType, ValueType> &csr) {
+  RowStats stats{.min = csr.num_cols, .max = 0, .mean = 0.0, .stddev = 0.0,
+                 .empty_rows = 0};
+  double sum = 0.0, sq_sum = 0.0;
+  for (long row = 0; row < csr.num_rows; row++) {
+    long degree = csr.row_offsets[row + 1] - csr.row_offsets[row];
+    stats.min = std::min(stats.min, degree);
+    stats.max = std::max(stats.max, degree);
+    stats.empty_rows += degree == 0;
+    sum += degree;
+    sq_sum += static_cast<double>(degree) * degree;
+  }
+  stats.mean = sum / csr.num_rows;
+  stats.stddev =
+      std::sqrt(std::max(0.0, sq_sum / csr.num_rows - stats.mean * stats.mean));
+  return stats;
+}
+}  // namespace RandomCSR
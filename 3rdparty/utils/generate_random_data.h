@@ -2,6 +2,9 @@
 #include <cusp/coo_matrix.h>
 #include <cusp/csr_matrix.h>
 #include <cusp/gallery/random.h>
+#include <utils/generate_random_csr.h>
+
+#include <algorithm>
 
 template <typename MatrixType>
 MatrixType generate_random_sparse_matrix(int num_rows, int num_cols,
@@ -16,51 +19,60 @@ MatrixType generate_random_sparse_matrix(int num_rows, int num_cols,
 }
 
 // This function generates a random sparse matrix with no duplicate entries.
-// It is based on cusp::gallery::random from 3rdparty/CUDALibrarySamples/3rdparty/cusplibrary/cusp/gallery/detail/random.inl
+// The coordinates are drawn uniformly over the whole m x n space (or follow
+// options.pattern) by the multi-threaded CSR generator in
+// generate_random_csr.h, and are then copied into the cusp container.
 template <typename MatrixType>
 void random_nodup(MatrixType& matrix,
             const size_t m,
             const size_t n,
-            const size_t num_samples)
+            const size_t num_samples,
+            const RandomCSR::Options& options)
 {
     typedef typename MatrixType::index_type IndexType;
     typedef typename MatrixType::value_type ValueType;
 
-    cusp::coo_matrix<IndexType,ValueType,cusp::host_memory> coo(m, n, num_samples);
+    RandomCSR::CSR<IndexType, ValueType> generated =
+        RandomCSR::generate<IndexType, ValueType>(m, n, num_samples, options);
 
-    std::vector<size_t> coordinates;
-    coordinates.reserve(num_samples);
-    for(size_t k = 0; k < num_samples; k++)
-    {
-        coordinates.push_back(k);
-    }
-    std::random_shuffle(coordinates.begin(), coordinates.end());
+    cusp::csr_matrix<IndexType,ValueType,cusp::host_memory> csr(m, n, generated.values.size());
+    std::copy(generated.row_offsets.begin(), generated.row_offsets.end(), csr.row_offsets.begin());
+    std::copy(generated.column_indices.begin(), generated.column_indices.end(), csr.column_indices.begin());
+    std::copy(generated.values.begin(), generated.values.end(), csr.values.begin());
 
-    for(size_t k = 0; k < num_samples; k++)
-    {
-        coo.row_indices[k]    = coordinates[k] / n;
-        coo.column_indices[k] = coordinates[k] % n;
-        coo.values[k]         = ValueType(1);
-    }
+    matrix = csr;
+}
 
-    // sort indices by (row,column)
-    coo.sort_by_row_and_column();
+template <typename MatrixType>
+void random_nodup(MatrixType& matrix,
+            const size_t m,
+            const size_t n,
+            const size_t num_samples)
+{
+    RandomCSR::Options options = RandomCSR::get_default_options();
+    options.seed = rand();
+    random_nodup(matrix, m, n, num_samples, options);
+}
 
-    matrix = coo;
+// This function generates a random sparse matrix with no duplicate entries
+// and random values in [0, 1). The number of nonzeros of the result may
+// differ from num_nonzeros for the block and 2:4 patterns.
+template <typename MatrixType>
+MatrixType generate_random_sparse_matrix_nodup(int num_rows, int num_cols,
+                                         int num_nonzeros,
+                                         const RandomCSR::Options& options) {
+  MatrixType A;
+  random_nodup(A, num_rows, num_cols, num_nonzeros, options);
+  return A;
 }
 
-// This function generates a random sparse matrix with no duplicate entries.
-// It is based on cusp::gallery::random from 3rdparty/CUDALibrarySamples/3rdparty/cusplibrary/cusp/gallery/detail/random.inl
 template <typename MatrixType>
 MatrixType generate_random_sparse_matrix_nodup(int num_rows, int num_cols,
                                          int num_nonzeros) {
-  MatrixType A(num_rows, num_cols, num_nonzeros);
-  random_nodup(A, num_rows, num_cols, num_nonzeros);
-  // Generate random values
-  for (int i = 0; i < num_nonzeros; i++) {
-    A.values[i] = (rand() + 0.0f) / RAND_MAX;
-  }
-  return A;
+  RandomCSR::Options options = RandomCSR::get_default_options();
+  options.seed = rand();
+  return generate_random_sparse_matrix_nodup<MatrixType>(num_rows, num_cols,
+                                                         num_nonzeros, options);
 }
 
 void generate_random_matrix(float *data, int len) {
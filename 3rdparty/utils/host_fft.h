@@ -0,0 +1,621 @@
+#pragma once
+// Host reference FFT for verifying cuFFT and cuFFTDx results. Host-only.
+//
+// Complex-to-complex, real-to-complex and complex-to-real transforms of any
+// rank and any size, batched, on float or double data, with the cuFFT
+// conventions: row major dimensions (the last one contiguous), forward
+// exponent sign -1, unnormalized inverse, and a last dimension of n / 2 + 1
+// on the complex side of real transforms.
+//
+// Plan1D is a mixed-radix Stockham FFT on split real and imaginary arrays:
+// radix 4, 2, 3 and 5 butterflies, plain DFT butterflies for other primes up
+// to kMaxPrimeRadix, and Bluestein's algorithm (a cyclic convolution of a
+// 2, 3, 5-smooth size) for lengths with a larger prime factor. Butterflies
+// run on GCC vector extensions across the Stockham stride (AVX2 when the
+// CPU has it, SSE or NEON otherwise, scalar on other compilers and nvcc).
+//
+// The rank-N helpers compute in double by default, whatever the data type,
+// and run the 1D transforms of every axis in parallel on a ThreadPool.
+#include <utils/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__GNUC__) && !defined(__CUDACC__)
+#define HOST_FFT_VECTOR_EXT
+#if defined(__x86_64__) || defined(__i386__)
+#define HOST_FFT_AVX2
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define HOST_FFT_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define HOST_FFT_ALWAYS_INLINE inline
+#endif
+
+namespace HostFFT {
+enum class Direction { kForward, kInverse };
+
+struct Options {
+  int num_threads = 0;  // 0 uses every hardware thread
+};
+
+namespace Kernel {
+constexpr size_t kMaxPrimeRadix = 61;
+constexpr double kPi = 3.14159265358979323846;
+
+#if defined(HOST_FFT_VECTOR_EXT)
+template <typename T>
+struct Lanes {
+  typedef T Vec __attribute__((vector_size(32)));
+  static constexpr size_t kWidth = 32 / sizeof(T);
+};
+#else
+template <typename T>
+struct Lanes {
+  typedef T Vec;
+  static constexpr size_t kWidth = 1;
+};
+#endif
+
+// One Stockham stage: n = radix * m is the length still to split and s the
+// stride; twiddles[p * (radix - 1) + k - 1] = exp(-2 pi i p k / n)
+template <typename T>
+struct Stage {
+  size_t radix;
+  size_t m;
+  size_t s;
+  std::vector<T> twiddle_re, twiddle_im;
+  std::vector<T> root_re, root_im;  // exp(-2 pi i j / radix), generic radices
+};
+
+// a_j = x[q + s * (p + j * m)] for lanes q, ..., q + sizeof(V) / sizeof(T) - 1
+template <typename T, typename V>
+HOST_FFT_ALWAYS_INLINE void load_lanes(const T *x, V &v) {
+  memcpy(&v, x, sizeof(V));
+}
+
+template <typename T, typename V>
+HOST_FFT_ALWAYS_INLINE void store_lanes(T *x, const V &v) {
+  memcpy(x, &v, sizeof(V));
+}
+
+// Butterfly of stage at (p, q): radix-point DFT of the inputs, then
+// twiddles; kRadix is 0 for the generic radices
+template <typename T, typename V, size_t kRadix>
+HOST_FFT_ALWAYS_INLINE void butterfly(
+    const Stage<T> &stage, const T *xr, const T *xi, T *yr, T *yi, size_t p,
+    size_t q, V *ar, V *ai, V *br, V *bi) {
+  const size_t radix = kRadix ? kRadix : stage.radix, m = stage.m, s = stage.s;
+  for (size_t j = 0; j < radix; j++) {
+    load_lanes(xr + q + s * (p + j * m), ar[j]);
+    load_lanes(xi + q + s * (p + j * m), ai[j]);
+  }
+  switch (radix) {
+    case 2:
+      br[0] = ar[0] + ar[1];
+      bi[0] = ai[0] + ai[1];
+      br[1] = ar[0] - ar[1];
+      bi[1] = ai[0] - ai[1];
+      break;
+    case 3: {
+      const T c = T(-0.5), d = T(-0.86602540378443864676);
+      V sr = ar[1] + ar[2], si = ai[1] + ai[2];
+      V tr = ar[0] + c * sr, ti = ai[0] + c * si;
+      V ur = d * (ai[1] - ai[2]), ui = d * (ar[1] - ar[2]);
+      br[0] = ar[0] + sr;
+      bi[0] = ai[0] + si;
+      br[1] = tr - ur;
+      bi[1] = ti + ui;
+      br[2] = tr + ur;
+      bi[2] = ti - ui;
+      break;
+    }
+    case 4: {
+      V t0r = ar[0] + ar[2], t0i = ai[0] + ai[2];
+      V t1r = ar[0] - ar[2], t1i = ai[0] - ai[2];
+      V t2r = ar[1] + ar[3], t2i = ai[1] + ai[3];
+      V t3r = ar[1] - ar[3], t3i = ai[1] - ai[3];
+      br[0] = t0r + t2r;
+      bi[0] = t0i + t2i;
+      br[2] = t0r - t2r;
+      bi[2] = t0i - t2i;
+      // -i * t3
+      br[1] = t1r + t3i;
+      bi[1] = t1i - t3r;
+      br[3] = t1r - t3i;
+      bi[3] = t1i + t3r;
+      break;
+    }
+    case 5: {
+      const T c1 = T(0.30901699437494742410), c2 = T(-0.80901699437494742410);
+      const T d1 = T(-0.95105651629515357212), d2 = T(-0.58778525229247312917);
+      V s1r = ar[1] + ar[4], s1i = ai[1] + ai[4];
+      V s2r = ar[2] + ar[3], s2i = ai[2] + ai[3];
+      V t1r = ar[1] - ar[4], t1i = ai[1] - ai[4];
+      V t2r = ar[2] - ar[3], t2i = ai[2] - ai[3];
+      V u1r = ar[0] + c1 * s1r + c2 * s2r, u1i = ai[0] + c1 * s1i + c2 * s2i;
+      V u2r = ar[0] + c2 * s1r + c1 * s2r, u2i = ai[0] + c2 * s1i + c1 * s2i;
+      // i * (d1 * t1 + d2 * t2) and i * (d2 * t1 - d1 * t2)
+      V v1r = -(d1 * t1i + d2 * t2i), v1i = d1 * t1r + d2 * t2r;
+      V v2r = -(d2 * t1i - d1 * t2i), v2i = d2 * t1r - d1 * t2r;
+      br[0] = ar[0] + s1r + s2r;
+      bi[0] = ai[0] + s1i + s2i;
+      br[1] = u1r + v1r;
+      bi[1] = u1i + v1i;
+      br[4] = u1r - v1r;
+      bi[4] = u1i - v1i;
+      br[2] = u2r + v2r;
+      bi[2] = u2i + v2i;
+      br[3] = u2r - v2r;
+      bi[3] = u2i - v2i;
+      break;
+    }
+    default:
+      for (size_t k = 0; k < radix; k++) {
+        V sr = ar[0], si = ai[0];
+        for (size_t j = 1, jk = k; j < radix; j++, jk = (jk + k) % radix) {
+          sr += ar[j] * stage.root_re[jk] - ai[j] * stage.root_im[jk];
+          si += ar[j] * stage.root_im[jk] + ai[j] * stage.root_re[jk];
+        }
+        br[k] = sr;
+        bi[k] = si;
+      }
+  }
+  store_lanes<T, V>(yr + q + s * radix * p, br[0]);
+  store_lanes<T, V>(yi + q + s * radix * p, bi[0]);
+  const T *wr = stage.twiddle_re.data() + p * (radix - 1) - 1;
+  const T *wi = stage.twiddle_im.data() + p * (radix - 1) - 1;
+  for (size_t k = 1; k < radix; k++) {
+    store_lanes<T, V>(yr + q + s * (radix * p + k), br[k] * wr[k] - bi[k] * wi[k]);
+    store_lanes<T, V>(yi + q + s * (radix * p + k), br[k] * wi[k] + bi[k] * wr[k]);
+  }
+}
+
+template <typename T, size_t kRadix>
+HOST_FFT_ALWAYS_INLINE void run_stage_radix(
+    const Stage<T> &stage, const T *xr, const T *xi, T *yr, T *yi) {
+  typedef typename Lanes<T>::Vec Vec;
+  const size_t width = Lanes<T>::kWidth;
+  const size_t size = kRadix ? kRadix : kMaxPrimeRadix;
+  Vec ar[size], ai[size], br[size], bi[size];
+  T sar[size], sai[size], sbr[size], sbi[size];
+  const size_t vector_end = width > 1 ? stage.s / width * width : 0;
+  for (size_t p = 0; p < stage.m; p++) {
+    size_t q = 0;
+    for (; q < vector_end; q += width) {
+      butterfly<T, Vec, kRadix>(stage, xr, xi, yr, yi, p, q, ar, ai, br, bi);
+    }
+    for (; q < stage.s; q++) {
+      butterfly<T, T, kRadix>(stage, xr, xi, yr, yi, p, q, sar, sai, sbr, sbi);
+    }
+  }
+}
+
+template <typename T>
+HOST_FFT_ALWAYS_INLINE void run_stage_body(
+    const Stage<T> &stage, const T *xr, const T *xi, T *yr, T *yi) {
+  switch (stage.radix) {
+    case 2: return run_stage_radix<T, 2>(stage, xr, xi, yr, yi);
+    case 3: return run_stage_radix<T, 3>(stage, xr, xi, yr, yi);
+    case 4: return run_stage_radix<T, 4>(stage, xr, xi, yr, yi);
+    case 5: return run_stage_radix<T, 5>(stage, xr, xi, yr, yi);
+    default: return run_stage_radix<T, 0>(stage, xr, xi, yr, yi);
+  }
+}
+
+template <typename T>
+void run_stage_generic(const Stage<T> &stage, const T *xr, const T *xi, T *yr,
+                       T *yi) {
+  run_stage_body(stage, xr, xi, yr, yi);
+}
+
+#if defined(HOST_FFT_AVX2)
+template <typename T>
+__attribute__((target("avx2,fma"))) void run_stage_avx2(
+    const Stage<T> &stage, const T *xr, const T *xi, T *yr, T *yi) {
+  run_stage_body(stage, xr, xi, yr, yi);
+}
+
+inline bool has_avx2() {
+  static const bool result =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return result;
+}
+#endif
+
+template <typename T>
+void run_stage(const Stage<T> &stage, const T *xr, const T *xi, T *yr,
+               T *yi) {
+#if defined(HOST_FFT_AVX2)
+  if (has_avx2()) return run_stage_avx2(stage, xr, xi, yr, yi);
+#endif
+  run_stage_generic(stage, xr, xi, yr, yi);
+}
+
+// Prime factors of n, radix 4 first, or an empty list if one exceeds
+// kMaxPrimeRadix
+inline std::vector<size_t> factorize(size_t n) {
+  std::vector<size_t> factors;
+  while (n % 4 == 0) {
+    factors.push_back(4);
+    n /= 4;
+  }
+  for (size_t p = 2; p <= kMaxPrimeRadix && n > 1; p++) {
+    while (n % p == 0) {
+      factors.push_back(p);
+      n /= p;
+    }
+  }
+  if (n > 1) factors.clear();
+  return factors;
+}
+
+// Smallest 2, 3, 5-smooth number >= n
+inline size_t good_size(size_t n) {
+  size_t best = 1;
+  while (best < n) best *= 2;
+  for (size_t f5 = 1; f5 < best; f5 *= 5) {
+    for (size_t f35 = f5; f35 < best; f35 *= 3) {
+      size_t f = f35;
+      while (f < n) f *= 2;
+      best = std::min(best, f);
+    }
+  }
+  return best;
+}
+}  // namespace Kernel
+
+// 1D complex FFT of a fixed length on split real and imaginary arrays
+template <typename T>
+class Plan1D {
+ public:
+  explicit Plan1D(size_t n) : n_(n) {
+    if (n == 0) throw std::invalid_argument("HostFFT::Plan1D: empty transform");
+    std::vector<size_t> factors = Kernel::factorize(n);
+    if (n == 1 || !factors.empty()) {
+      // the twiddles of every stage are powers of exp(-2 pi i / n), of which
+      // only a quarter turn (multiples of 4) or a half turn needs cos and sin
+      std::vector<double> root_re(n), root_im(n);
+      const size_t computed = n % 4 == 0 ? n / 4 : n / 2 + 1;
+      for (size_t j = 0; j < computed; j++) {
+        double angle = -2.0 * Kernel::kPi * static_cast<double>(j) / static_cast<double>(n);
+        root_re[j] = std::cos(angle);
+        root_im[j] = std::sin(angle);
+      }
+      for (size_t j = computed; j < n; j++) {
+        if (n % 4 == 0) {
+          // w^j = -i w^(j - n / 4)
+          root_re[j] = root_im[j - n / 4];
+          root_im[j] = -root_re[j - n / 4];
+        } else {
+          // w^j = conj(w^(n - j))
+          root_re[j] = root_re[n - j];
+          root_im[j] = -root_im[n - j];
+        }
+      }
+      size_t length = n, s = 1;
+      for (size_t radix : factors) {
+        Kernel::Stage<T> stage;
+        stage.radix = radix;
+        stage.m = length / radix;
+        stage.s = s;
+        stage.twiddle_re.resize(stage.m * (radix - 1));
+        stage.twiddle_im.resize(stage.m * (radix - 1));
+        for (size_t p = 0; p < stage.m; p++) {
+          for (size_t k = 1; k < radix; k++) {
+            size_t j = p * k % length * s;
+            stage.twiddle_re[p * (radix - 1) + k - 1] = static_cast<T>(root_re[j]);
+            stage.twiddle_im[p * (radix - 1) + k - 1] = static_cast<T>(root_im[j]);
+          }
+        }
+        if (radix > 5) {
+          for (size_t j = 0; j < radix; j++) {
+            stage.root_re.push_back(static_cast<T>(root_re[j * (n / radix)]));
+            stage.root_im.push_back(static_cast<T>(root_im[j * (n / radix)]));
+          }
+        }
+        stages_.push_back(std::move(stage));
+        length /= radix;
+        s *= radix;
+      }
+      return;
+    }
+
+    // Bluestein: X_k = c_k sum_j (x_j c_j) conj(c_{k - j}) with the chirp
+    // c_k = exp(-pi i k^2 / n), a cyclic convolution of length m >= 2n - 1
+    size_t m = Kernel::good_size(2 * n - 1);
+    inner_.reset(new Plan1D<T>(m));
+    chirp_re_.resize(n);
+    chirp_im_.resize(n);
+    for (size_t k = 0; k < n; k++) {
+      // k^2 mod 2n keeps the angle exact for large k
+      uint64_t k2 = static_cast<uint64_t>(k) * k % (2 * static_cast<uint64_t>(n));
+      double angle = -Kernel::kPi * static_cast<double>(k2) / static_cast<double>(n);
+      chirp_re_[k] = static_cast<T>(std::cos(angle));
+      chirp_im_[k] = static_cast<T>(std::sin(angle));
+    }
+    filter_re_.assign(m, T(0));
+    filter_im_.assign(m, T(0));
+    for (size_t k = 0; k < n; k++) {
+      // conj(c_k) at k and m - k, scaled by the 1 / m of the inverse transform
+      T re = chirp_re_[k] / static_cast<T>(m), im = -chirp_im_[k] / static_cast<T>(m);
+      filter_re_[k] = re;
+      filter_im_[k] = im;
+      if (k > 0) {
+        filter_re_[m - k] = re;
+        filter_im_[m - k] = im;
+      }
+    }
+    std::vector<T> scratch(inner_->scratch_size());
+    inner_->execute(filter_re_.data(), filter_im_.data(), Direction::kForward,
+                    scratch.data());
+  }
+
+  size_t size() const { return n_; }
+
+  // Elements of T that execute needs as scratch
+  size_t scratch_size() const {
+    if (!inner_) return 2 * n_;
+    return 2 * inner_->size() + inner_->scratch_size();
+  }
+
+  // In-place transform of re[0, n) + i im[0, n); the inverse is unnormalized
+  void execute(T *re, T *im, Direction direction, T *scratch) const {
+    // inverse(x) = conj(forward(conj(x)))
+    if (direction == Direction::kInverse) {
+      for (size_t i = 0; i < n_; i++) im[i] = -im[i];
+    }
+    if (inner_) {
+      execute_bluestein(re, im, scratch);
+    } else {
+      T *xr = re, *xi = im, *yr = scratch, *yi = scratch + n_;
+      for (const Kernel::Stage<T> &stage : stages_) {
+        Kernel::run_stage(stage, xr, xi, yr, yi);
+        std::swap(xr, yr);
+        std::swap(xi, yi);
+      }
+      if (xr != re) {
+        memcpy(re, xr, n_ * sizeof(T));
+        memcpy(im, xi, n_ * sizeof(T));
+      }
+    }
+    if (direction == Direction::kInverse) {
+      for (size_t i = 0; i < n_; i++) im[i] = -im[i];
+    }
+  }
+
+ private:
+  void execute_bluestein(T *re, T *im, T *scratch) const {
+    const size_t m = inner_->size();
+    T *ar = scratch, *ai = scratch + m, *inner_scratch = scratch + 2 * m;
+    for (size_t k = 0; k < n_; k++) {
+      ar[k] = re[k] * chirp_re_[k] - im[k] * chirp_im_[k];
+      ai[k] = re[k] * chirp_im_[k] + im[k] * chirp_re_[k];
+    }
+    std::fill(ar + n_, ar + m, T(0));
+    std::fill(ai + n_, ai + m, T(0));
+    inner_->execute(ar, ai, Direction::kForward, inner_scratch);
+    for (size_t k = 0; k < m; k++) {
+      T r = ar[k] * filter_re_[k] - ai[k] * filter_im_[k];
+      ai[k] = ar[k] * filter_im_[k] + ai[k] * filter_re_[k];
+      ar[k] = r;
+    }
+    inner_->execute(ar, ai, Direction::kInverse, inner_scratch);
+    for (size_t k = 0; k < n_; k++) {
+      re[k] = ar[k] * chirp_re_[k] - ai[k] * chirp_im_[k];
+      im[k] = ar[k] * chirp_im_[k] + ai[k] * chirp_re_[k];
+    }
+  }
+
+  size_t n_;
+  std::vector<Kernel::Stage<T>> stages_;
+  std::unique_ptr<Plan1D<T>> inner_;  // Bluestein only
+  std::vector<T> chirp_re_, chirp_im_;
+  std::vector<T> filter_re_, filter_im_;
+};
+
+namespace Kernel {
+// Pool shared by the transforms of one call, or null for a single thread
+inline std::unique_ptr<ThreadPool> make_pool(const Options &options) {
+  const size_t threads = options.num_threads > 0
+                             ? options.num_threads
+                             : std::max(1u, std::thread::hardware_concurrency());
+  if (threads == 1) return nullptr;
+  return std::unique_ptr<ThreadPool>(new ThreadPool(threads));
+}
+
+// Split complex batch of transforms of shape dims, with the 1D transforms of
+// each axis run in parallel on pool (serially when it is null)
+template <typename C>
+class Transform {
+ public:
+  Transform(const std::vector<size_t> &dims, size_t batch, ThreadPool *pool)
+      : dims_(dims), pool_(pool) {
+    if (dims.empty() || batch == 0)
+      throw std::invalid_argument("HostFFT: invalid dimensions");
+    size_t volume = batch;
+    for (size_t n : dims) {
+      if (n == 0) throw std::invalid_argument("HostFFT: invalid dimensions");
+      volume *= n;
+    }
+    re_.resize(volume);
+    im_.resize(volume);
+  }
+
+  C *re() { return re_.data(); }
+  C *im() { return im_.data(); }
+
+  // 1D transforms along axis, or along every axis in [first, last)
+  void run(size_t first, size_t last, Direction direction) {
+    for (size_t axis = first; axis < last; axis++) run_axis(axis, direction);
+  }
+
+ private:
+  // 1D transforms of contiguous rows of plan.size() elements
+  void run_rows(const Plan1D<C> &plan, Direction direction) {
+    const size_t row = plan.size();
+    const size_t rows = re_.size() / row;
+    for_lines(rows, plan.scratch_size(), [&](size_t line, C *scratch) {
+      plan.execute(&re_[line * row], &im_[line * row], direction, scratch);
+    });
+  }
+
+  void run_axis(size_t axis, Direction direction) {
+    const size_t n = dims_[axis];
+    if (n == 1) return;
+    Plan1D<C> plan(n);
+    size_t stride = 1;
+    for (size_t i = axis + 1; i < dims_.size(); i++) stride *= dims_[i];
+    if (stride == 1) return run_rows(plan, direction);
+    // gather each strided line into the scratch, transform and scatter
+    const size_t lines = re_.size() / n;
+    for_lines(lines, 2 * n + plan.scratch_size(), [&](size_t line, C *scratch) {
+      const size_t base = line / stride * stride * n + line % stride;
+      C *lr = scratch, *li = scratch + n;
+      for (size_t i = 0; i < n; i++) {
+        lr[i] = re_[base + i * stride];
+        li[i] = im_[base + i * stride];
+      }
+      plan.execute(lr, li, direction, scratch + 2 * n);
+      for (size_t i = 0; i < n; i++) {
+        re_[base + i * stride] = lr[i];
+        im_[base + i * stride] = li[i];
+      }
+    });
+  }
+
+  template <typename F>
+  void for_lines(size_t lines, size_t scratch_size, const F &f) {
+    // enough tasks to balance, few enough to amortize the scheduling
+    const size_t threads = std::min<size_t>(pool_ ? pool_->size() : 1, lines);
+    const size_t tasks = std::min(lines, 8 * threads);
+    // allocated by the worker that uses it, since fewer may run than exist
+    std::vector<std::vector<C>> scratch(pool_ ? pool_->size() : 1);
+    auto run = [&](int tid, size_t task) {
+      if (scratch[tid].empty()) scratch[tid].resize(scratch_size);
+      for (size_t line = lines * task / tasks; line < lines * (task + 1) / tasks; line++)
+        f(line, scratch[tid].data());
+    };
+    if (threads == 1) {
+      for (size_t task = 0; task < tasks; task++) run(0, task);
+      return;
+    }
+    pool_->enqueue_batch(tasks, run);
+    pool_->wait();
+  }
+
+  std::vector<size_t> dims_;
+  std::vector<C> re_, im_;
+  ThreadPool *pool_;
+};
+
+inline size_t get_volume(const std::vector<size_t> &dims) {
+  size_t volume = 1;
+  for (size_t n : dims) volume *= n;
+  return volume;
+}
+}  // namespace Kernel
+
+// Complex-to-complex transform of batch contiguous arrays of shape dims;
+// in and out may alias
+template <typename T, typename Compute = double>
+void c2c(const std::vector<size_t> &dims, size_t batch,
+         const std::complex<T> *in, std::complex<T> *out, Direction direction,
+         const Options &options = Options()) {
+  std::unique_ptr<ThreadPool> pool = Kernel::make_pool(options);
+  Kernel::Transform<Compute> transform(dims, batch, pool.get());
+  const size_t volume = batch * Kernel::get_volume(dims);
+  for (size_t i = 0; i < volume; i++) {
+    transform.re()[i] = static_cast<Compute>(in[i].real());
+    transform.im()[i] = static_cast<Compute>(in[i].imag());
+  }
+  transform.run(0, dims.size(), direction);
+  for (size_t i = 0; i < volume; i++) {
+    out[i] = std::complex<T>(static_cast<T>(transform.re()[i]),
+                             static_cast<T>(transform.im()[i]));
+  }
+}
+
+// Real-to-complex forward transform of batch real arrays of shape dims into
+// complex arrays of shape dims with a last dimension of dims.back() / 2 + 1.
+// The real rows are real_pitch elements apart (dims.back() when 0, and
+// 2 * (dims.back() / 2 + 1) for cuFFT in-place data); in and out may alias
+template <typename T, typename Compute = double>
+void r2c(const std::vector<size_t> &dims, size_t batch, const T *in,
+         std::complex<T> *out, size_t real_pitch = 0,
+         const Options &options = Options()) {
+  if (dims.empty()) throw std::invalid_argument("HostFFT: invalid dimensions");
+  const size_t n = dims.back(), half = n / 2 + 1;
+  if (real_pitch == 0) real_pitch = n;
+  const size_t rows = batch * Kernel::get_volume(dims) / std::max<size_t>(n, 1);
+  // full length rows for the last axis, then the half spectrum for the others
+  std::unique_ptr<ThreadPool> pool = Kernel::make_pool(options);
+  Kernel::Transform<Compute> full(dims, batch, pool.get());
+  for (size_t r = 0; r < rows; r++) {
+    for (size_t i = 0; i < n; i++) {
+      full.re()[r * n + i] = static_cast<Compute>(in[r * real_pitch + i]);
+      full.im()[r * n + i] = 0;
+    }
+  }
+  full.run(dims.size() - 1, dims.size(), Direction::kForward);
+  std::vector<size_t> half_dims = dims;
+  half_dims.back() = half;
+  Kernel::Transform<Compute> spectrum(half_dims, batch, pool.get());
+  for (size_t r = 0; r < rows; r++) {
+    memcpy(spectrum.re() + r * half, full.re() + r * n, half * sizeof(Compute));
+    memcpy(spectrum.im() + r * half, full.im() + r * n, half * sizeof(Compute));
+  }
+  spectrum.run(0, dims.size() - 1, Direction::kForward);
+  for (size_t i = 0; i < rows * half; i++) {
+    out[i] = std::complex<T>(static_cast<T>(spectrum.re()[i]),
+                             static_cast<T>(spectrum.im()[i]));
+  }
+}
+
+// Complex-to-real inverse transform, the reverse of r2c: the imaginary parts
+// that Hermitian symmetry leaves undefined are ignored, as by cuFFT
+template <typename T, typename Compute = double>
+void c2r(const std::vector<size_t> &dims, size_t batch,
+         const std::complex<T> *in, T *out, size_t real_pitch = 0,
+         const Options &options = Options()) {
+  if (dims.empty()) throw std::invalid_argument("HostFFT: invalid dimensions");
+  const size_t n = dims.back(), half = n / 2 + 1;
+  if (real_pitch == 0) real_pitch = n;
+  std::vector<size_t> half_dims = dims;
+  half_dims.back() = half;
+  std::unique_ptr<ThreadPool> pool = Kernel::make_pool(options);
+  Kernel::Transform<Compute> spectrum(half_dims, batch, pool.get());
+  const size_t rows = batch * Kernel::get_volume(half_dims) / half;
+  for (size_t i = 0; i < rows * half; i++) {
+    spectrum.re()[i] = static_cast<Compute>(in[i].real());
+    spectrum.im()[i] = static_cast<Compute>(in[i].imag());
+  }
+  spectrum.run(0, dims.size() - 1, Direction::kInverse);
+  // Hermitian extension of every row: X[n - k] = conj(X[k])
+  Kernel::Transform<Compute> full(dims, batch, pool.get());
+  for (size_t r = 0; r < rows; r++) {
+    Compute *re = full.re() + r * n, *im = full.im() + r * n;
+    memcpy(re, spectrum.re() + r * half, half * sizeof(Compute));
+    memcpy(im, spectrum.im() + r * half, half * sizeof(Compute));
+    for (size_t k = half; k < n; k++) {
+      re[k] = re[n - k];
+      im[k] = -im[n - k];
+    }
+  }
+  full.run(dims.size() - 1, dims.size(), Direction::kInverse);
+  for (size_t r = 0; r < rows; r++) {
+    for (size_t i = 0; i < n; i++) {
+      out[r * real_pitch + i] = static_cast<T>(full.re()[r * n + i]);
+    }
+  }
+}
+}  // namespace HostFFT
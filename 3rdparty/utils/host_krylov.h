@@ -0,0 +1,566 @@
+#pragma once
+// Host reference of the preconditioned Krylov solvers of the cuSPARSE
+// samples: CG with IC0 (cuSPARSE/cg) and BiCGStab with ILU0
+// (cuSPARSE/bicgstab). Host-only, no CUDA dependency.
+//
+// cg() and bicgstab() follow gpu_CG and gpu_BiCGStab step by step, with the
+// same stopping tests, the same order of the triangular solves and the same
+// update of the search direction P, even where the listings differ from the
+// textbook methods, so that their residual histories can be compared line by
+// line with the GPU runs. print_history() prints them in the format of the
+// samples.
+//
+// ic0() and ilu0() compute the factors of csric02 and csrilu02: the pattern
+// of A is kept and the rows are factored in the level order of the lower
+// triangle. Triangular solves are level-scheduled (SparseReorder::row_levels):
+// the rows of one level are solved in parallel, levels with few rows on the
+// calling thread. SpMV splits the rows into nnz-balanced ranges. Dot products
+// sum fixed-size blocks in a fixed order, so the results do not depend on the
+// number of threads.
+#include <utils/sparse_reorder.h>
+#include <utils/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace HostKrylov {
+// Square CSR matrix with sorted columns, 0-based
+struct CsrView {
+  int32_t num_rows;
+  const int32_t *row_offsets;
+  const int32_t *columns;
+  const double *values;
+};
+
+// Triangle of a factor with the diagonal stored apart, and its level schedule
+struct Triangular {
+  SparseReorder::Triangle triangle;
+  std::vector<int32_t> row_offsets;  // off-diagonal entries only
+  std::vector<int32_t> columns;
+  std::vector<double> values;
+  std::vector<double> diagonal;  // all ones for a unit triangle
+  // Rows of level l are level_rows[level_offsets[l], level_offsets[l + 1])
+  std::vector<int32_t> level_offsets;
+  std::vector<int32_t> level_rows;
+
+  int32_t num_rows() const {
+    return static_cast<int32_t>(diagonal.size());
+  }
+  int32_t num_levels() const {
+    return static_cast<int32_t>(level_offsets.size()) - 1;
+  }
+};
+
+// M = lower * upper: L * L^T for IC0, L * U with a unit L for ILU0
+struct Factors {
+  Triangular lower;
+  Triangular upper;
+  // First row with a zero pivot (non-positive for IC0), -1 if none, as
+  // reported by cusparseXcsric02_zeroPivot / cusparseXcsrilu02_zeroPivot
+  int32_t zero_pivot = -1;
+};
+
+// Residual norms in the order the samples print them
+struct History {
+  double initial_norm;
+  double threshold;
+  int first_iteration;         // 0 for CG, 1 for BiCGStab
+  std::vector<double> norms;   // "Error Norm" at the start of every iteration
+  double final_norm;           // ||b - A * x|| of the returned x
+};
+
+namespace Kernel {
+// Rows or elements per task
+constexpr int32_t kGrain = 1 << 14;
+// Rows of a level below which the level is solved on the calling thread
+constexpr int32_t kSerialLevel = 2048;
+
+// Runs func(begin, end) over [0, count) in ranges of about grain items
+template <typename Func>
+void parallel_for(ThreadPool *pool, int64_t count, int64_t grain, Func &&func) {
+  if (!pool || pool->size() == 1 || count <= grain) {
+    if (count > 0) func(int64_t(0), count);
+    return;
+  }
+  int64_t num_tasks = std::min<int64_t>((count + grain - 1) / grain,
+                                        int64_t(pool->size()) * 4);
+  pool->enqueue_batch(size_t(num_tasks), [&](int, size_t task) {
+    func(count * int64_t(task) / num_tasks,
+         count * int64_t(task + 1) / num_tasks);
+  });
+  pool->wait();
+}
+
+// Sum of func(begin, end) over fixed blocks of kGrain items, added in block
+// order whatever the number of threads
+template <typename Func>
+double reduce(ThreadPool *pool, int64_t count, Func &&func) {
+  int64_t num_blocks = (count + kGrain - 1) / kGrain;
+  std::vector<double> partial(num_blocks);
+  parallel_for(pool, num_blocks, 1, [&](int64_t first, int64_t last) {
+    for (int64_t block = first; block < last; block++) {
+      partial[block] =
+          func(block * kGrain, std::min(count, (block + 1) * kGrain));
+    }
+  });
+  double sum = 0.0;
+  for (double value : partial) sum += value;
+  return sum;
+}
+
+inline double dot(ThreadPool *pool, int32_t n, const double *x,
+                  const double *y) {
+  return reduce(pool, n, [&](int64_t begin, int64_t end) {
+    double sum = 0.0;
+    for (int64_t idx = begin; idx < end; idx++) sum += x[idx] * y[idx];
+    return sum;
+  });
+}
+
+inline double nrm2(ThreadPool *pool, int32_t n, const double *x) {
+  return std::sqrt(dot(pool, n, x, x));
+}
+
+// y = alpha * x + y
+inline void axpy(ThreadPool *pool, int32_t n, double alpha, const double *x,
+                 double *y) {
+  parallel_for(pool, n, kGrain, [&](int64_t begin, int64_t end) {
+    for (int64_t idx = begin; idx < end; idx++) y[idx] += alpha * x[idx];
+  });
+}
+
+inline void copy(ThreadPool *pool, int32_t n, const double *x, double *y) {
+  parallel_for(pool, n, kGrain, [&](int64_t begin, int64_t end) {
+    std::copy(x + begin, x + end, y + begin);
+  });
+}
+
+// Position of the diagonal in every row; throws if a row has none
+inline std::vector<int32_t> diagonal_positions(const CsrView &A) {
+  std::vector<int32_t> positions(A.num_rows);
+  for (int32_t row = 0; row < A.num_rows; row++) {
+    const int32_t *first = A.columns + A.row_offsets[row];
+    const int32_t *last = A.columns + A.row_offsets[row + 1];
+    const int32_t *diagonal = std::lower_bound(first, last, row);
+    if (diagonal == last || *diagonal != row) {
+      throw std::invalid_argument("row " + std::to_string(row) +
+                                  " has no diagonal entry");
+    }
+    positions[row] = static_cast<int32_t>(diagonal - A.columns);
+  }
+  return positions;
+}
+
+// Rows grouped by level, levels in increasing order
+inline void schedule(const std::vector<int32_t> &level,
+                     std::vector<int32_t> &level_offsets,
+                     std::vector<int32_t> &level_rows) {
+  int32_t num_levels = 0;
+  for (int32_t row_level : level) num_levels = std::max(num_levels, row_level + 1);
+  level_offsets.assign(num_levels + 1, 0);
+  for (int32_t row_level : level) level_offsets[row_level + 1]++;
+  for (int32_t idx = 0; idx < num_levels; idx++) {
+    level_offsets[idx + 1] += level_offsets[idx];
+  }
+  level_rows.resize(level.size());
+  std::vector<int32_t> cursor(level_offsets.begin(), level_offsets.end() - 1);
+  for (int32_t row = 0; row < int32_t(level.size()); row++) {
+    level_rows[cursor[level[row]]++] = row;
+  }
+}
+
+// Runs factor_row(row, position) over the rows of A in the level order of its
+// lower triangle; position is a per-worker array of num_rows entries set to
+// -1, which factor_row must restore
+template <typename Func>
+void for_rows_by_level(const CsrView &A, ThreadPool *pool, Func &&factor_row) {
+  std::vector<int32_t> level_offsets, level_rows;
+  schedule(SparseReorder::row_levels(A.num_rows, A.row_offsets, A.columns,
+                                     SparseReorder::Triangle::kLower),
+           level_offsets, level_rows);
+  size_t num_workers = pool ? pool->size() : 1;
+  std::vector<std::vector<int32_t>> positions(num_workers);
+  for (int32_t level = 0; level + 1 < int32_t(level_offsets.size()); level++) {
+    const int32_t begin = level_offsets[level];
+    const int32_t count = level_offsets[level + 1] - begin;
+    if (!pool || pool->size() == 1 || count < kSerialLevel) {
+      std::vector<int32_t> &position = positions[0];
+      if (position.empty()) position.assign(A.num_rows, -1);
+      for (int32_t idx = 0; idx < count; idx++) {
+        factor_row(level_rows[begin + idx], position.data());
+      }
+      continue;
+    }
+    size_t num_tasks = std::min<size_t>(num_workers, (count + 255) / 256);
+    pool->enqueue_batch(num_tasks, [&](int worker, size_t task) {
+      std::vector<int32_t> &position = positions[worker];
+      if (position.empty()) position.assign(A.num_rows, -1);
+      int32_t first = int32_t(int64_t(count) * task / num_tasks);
+      int32_t last = int32_t(int64_t(count) * (task + 1) / num_tasks);
+      for (int32_t idx = first; idx < last; idx++) {
+        factor_row(level_rows[begin + idx], position.data());
+      }
+    });
+    pool->wait();
+  }
+}
+
+// Keeps the smallest row in pivot
+inline void record_pivot(std::atomic<int32_t> &pivot, int32_t row) {
+  int32_t current = pivot.load();
+  while ((current < 0 || row < current) &&
+         !pivot.compare_exchange_weak(current, row)) {
+  }
+}
+
+// Triangle of the factored values; entries of the other triangle are dropped
+inline Triangular extract(const CsrView &A, const std::vector<double> &values,
+                          const std::vector<int32_t> &diagonal_position,
+                          SparseReorder::Triangle triangle, bool unit_diagonal) {
+  const bool lower = triangle == SparseReorder::Triangle::kLower;
+  Triangular result;
+  result.triangle = triangle;
+  result.row_offsets.assign(A.num_rows + 1, 0);
+  result.diagonal.resize(A.num_rows);
+  for (int32_t row = 0; row < A.num_rows; row++) {
+    int32_t first = lower ? A.row_offsets[row] : diagonal_position[row] + 1;
+    int32_t last = lower ? diagonal_position[row] : A.row_offsets[row + 1];
+    result.row_offsets[row + 1] = result.row_offsets[row] + (last - first);
+    result.columns.insert(result.columns.end(), A.columns + first,
+                          A.columns + last);
+    result.values.insert(result.values.end(), values.begin() + first,
+                         values.begin() + last);
+    result.diagonal[row] =
+        unit_diagonal ? 1.0 : values[diagonal_position[row]];
+  }
+  return result;
+}
+
+// L^T of a lower triangle
+inline Triangular transpose(const Triangular &lower) {
+  const int32_t n = lower.num_rows();
+  Triangular upper;
+  upper.triangle = SparseReorder::Triangle::kUpper;
+  upper.diagonal = lower.diagonal;
+  upper.row_offsets.assign(n + 1, 0);
+  for (int32_t col : lower.columns) upper.row_offsets[col + 1]++;
+  for (int32_t row = 0; row < n; row++) {
+    upper.row_offsets[row + 1] += upper.row_offsets[row];
+  }
+  upper.columns.resize(lower.columns.size());
+  upper.values.resize(lower.values.size());
+  std::vector<int32_t> cursor(upper.row_offsets.begin(),
+                              upper.row_offsets.end() - 1);
+  // Rows of L in increasing order keep the columns of L^T sorted
+  for (int32_t row = 0; row < n; row++) {
+    for (int32_t idx = lower.row_offsets[row]; idx < lower.row_offsets[row + 1];
+         idx++) {
+      int32_t dst = cursor[lower.columns[idx]]++;
+      upper.columns[dst] = row;
+      upper.values[dst] = lower.values[idx];
+    }
+  }
+  return upper;
+}
+
+inline void schedule(Triangular &factor) {
+  schedule(SparseReorder::row_levels(factor.num_rows(),
+                                     factor.row_offsets.data(),
+                                     factor.columns.data(), factor.triangle),
+           factor.level_offsets, factor.level_rows);
+}
+}  // namespace Kernel
+
+// y = alpha * A * x + beta * y
+inline void spmv(const CsrView &A, double alpha, const double *x, double beta,
+                 double *y, ThreadPool *pool = nullptr) {
+  auto multiply = [&](int32_t first, int32_t last) {
+    for (int32_t row = first; row < last; row++) {
+      double sum = 0.0;
+      for (int32_t idx = A.row_offsets[row]; idx < A.row_offsets[row + 1];
+           idx++) {
+        sum += A.values[idx] * x[A.columns[idx]];
+      }
+      y[row] = beta == 0.0 ? alpha * sum : alpha * sum + beta * y[row];
+    }
+  };
+  const int64_t nnz = A.row_offsets[A.num_rows] - A.row_offsets[0];
+  if (!pool || pool->size() == 1 || nnz <= Kernel::kGrain) {
+    multiply(0, A.num_rows);
+    return;
+  }
+  // Row ranges of about the same nnz
+  const int64_t num_tasks = std::min<int64_t>(
+      std::min<int64_t>(nnz / Kernel::kGrain, int64_t(pool->size()) * 4),
+      A.num_rows);
+  pool->enqueue_batch(size_t(num_tasks), [&](int, size_t task) {
+    auto cut = [&](size_t part) {
+      const int64_t target = A.row_offsets[0] + nnz * int64_t(part) / num_tasks;
+      return int32_t(std::lower_bound(A.row_offsets,
+                                      A.row_offsets + A.num_rows, target) -
+                     A.row_offsets);
+    };
+    multiply(task == 0 ? 0 : cut(task),
+             task + 1 == size_t(num_tasks) ? A.num_rows : cut(task + 1));
+  });
+  pool->wait();
+}
+
+// Solves factor * x = b; x and b must not overlap
+inline void solve(const Triangular &factor, const double *b, double *x,
+                  ThreadPool *pool = nullptr) {
+  auto solve_rows = [&](int32_t first, int32_t last) {
+    for (int32_t idx = first; idx < last; idx++) {
+      const int32_t row = factor.level_rows[idx];
+      double sum = b[row];
+      for (int32_t k = factor.row_offsets[row]; k < factor.row_offsets[row + 1];
+           k++) {
+        sum -= factor.values[k] * x[factor.columns[k]];
+      }
+      x[row] = sum / factor.diagonal[row];
+    }
+  };
+  for (int32_t level = 0; level < factor.num_levels(); level++) {
+    const int32_t begin = factor.level_offsets[level];
+    const int32_t count = factor.level_offsets[level + 1] - begin;
+    if (count < Kernel::kSerialLevel) {
+      solve_rows(begin, begin + count);
+    } else {
+      Kernel::parallel_for(pool, count, Kernel::kSerialLevel / 2,
+                           [&](int64_t first, int64_t last) {
+                             solve_rows(begin + int32_t(first),
+                                        begin + int32_t(last));
+                           });
+    }
+  }
+}
+
+// Incomplete Cholesky with zero fill of the lower triangle of A, as csric02:
+// lower = L, upper = L^T
+inline Factors ic0(const CsrView &A, ThreadPool *pool = nullptr) {
+  const std::vector<int32_t> diagonal = Kernel::diagonal_positions(A);
+  std::vector<double> values(A.values, A.values + A.row_offsets[A.num_rows]);
+  std::atomic<int32_t> pivot(-1);
+  Kernel::for_rows_by_level(A, pool, [&](int32_t row, int32_t *position) {
+    const int32_t first = A.row_offsets[row];
+    for (int32_t idx = first; idx <= diagonal[row]; idx++) {
+      position[A.columns[idx]] = idx;
+    }
+    // L(row, col) = (A(row, col) - L(row, :col) . L(col, :col)) / L(col, col)
+    double square_sum = 0.0;
+    for (int32_t idx = first; idx < diagonal[row]; idx++) {
+      const int32_t col = A.columns[idx];
+      double sum = values[idx];
+      for (int32_t k = A.row_offsets[col]; k < diagonal[col]; k++) {
+        const int32_t at = position[A.columns[k]];
+        if (at >= 0) sum -= values[at] * values[k];
+      }
+      values[idx] = sum / values[diagonal[col]];
+      square_sum += values[idx] * values[idx];
+    }
+    const double pivot_value = values[diagonal[row]] - square_sum;
+    if (!(pivot_value > 0.0)) Kernel::record_pivot(pivot, row);
+    values[diagonal[row]] = std::sqrt(pivot_value);
+    for (int32_t idx = first; idx <= diagonal[row]; idx++) {
+      position[A.columns[idx]] = -1;
+    }
+  });
+  Factors factors;
+  factors.lower = Kernel::extract(A, values, diagonal,
+                                  SparseReorder::Triangle::kLower, false);
+  factors.upper = Kernel::transpose(factors.lower);
+  factors.zero_pivot = pivot.load();
+  Kernel::schedule(factors.lower);
+  Kernel::schedule(factors.upper);
+  return factors;
+}
+
+// Incomplete LU with zero fill of A, as csrilu02: lower = L with a unit
+// diagonal, upper = U
+inline Factors ilu0(const CsrView &A, ThreadPool *pool = nullptr) {
+  const std::vector<int32_t> diagonal = Kernel::diagonal_positions(A);
+  std::vector<double> values(A.values, A.values + A.row_offsets[A.num_rows]);
+  std::atomic<int32_t> pivot(-1);
+  Kernel::for_rows_by_level(A, pool, [&](int32_t row, int32_t *position) {
+    const int32_t first = A.row_offsets[row];
+    const int32_t last = A.row_offsets[row + 1];
+    for (int32_t idx = first; idx < last; idx++) {
+      position[A.columns[idx]] = idx;
+    }
+    // Row-wise IKJ elimination with the rows above, restricted to the pattern
+    for (int32_t idx = first; idx < diagonal[row]; idx++) {
+      const int32_t col = A.columns[idx];
+      values[idx] /= values[diagonal[col]];
+      const double multiplier = values[idx];
+      for (int32_t k = diagonal[col] + 1; k < A.row_offsets[col + 1]; k++) {
+        const int32_t at = position[A.columns[k]];
+        if (at >= 0) values[at] -= multiplier * values[k];
+      }
+    }
+    if (values[diagonal[row]] == 0.0) Kernel::record_pivot(pivot, row);
+    for (int32_t idx = first; idx < last; idx++) {
+      position[A.columns[idx]] = -1;
+    }
+  });
+  Factors factors;
+  factors.lower = Kernel::extract(A, values, diagonal,
+                                  SparseReorder::Triangle::kLower, true);
+  factors.upper = Kernel::extract(A, values, diagonal,
+                                  SparseReorder::Triangle::kUpper, false);
+  factors.zero_pivot = pivot.load();
+  Kernel::schedule(factors.lower);
+  Kernel::schedule(factors.upper);
+  return factors;
+}
+
+// Preconditioned CG of gpu_CG (cuSPARSE/cg) with M = L * L^T from ic0(),
+// starting from the initial guess in x. Two steps deliberately copy quirks of
+// the sample rather than the textbook method: step 2 solves with L^T before L,
+// the reverse of the order of step 9, and step 11 computes P = (1 + beta) *
+// R_aux, as the sample's cublasDaxpy with aliased x and y does, instead of
+// R_aux + beta * P. Fixing either would make the histories differ from the
+// GPU runs.
+inline History cg(const CsrView &A, const Factors &M, const double *b,
+                  double *x, int max_iterations, double tolerance,
+                  ThreadPool *pool = nullptr) {
+  using namespace Kernel;
+  const int32_t m = A.num_rows;
+  std::vector<double> R(m), R_aux(m), P(m), T(m), tmp(m);
+  History history;
+  history.first_iteration = 0;
+  // ### 1 ### R0 = b - A * X0
+  copy(pool, m, b, R.data());
+  spmv(A, -1.0, x, 1.0, R.data(), pool);
+  // ### 2 ### R_aux = L^-1 L^-T R0, in the order of the sample
+  solve(M.upper, R.data(), tmp.data(), pool);
+  solve(M.lower, tmp.data(), R_aux.data(), pool);
+  // ### 3 ### P0 = R0_aux
+  copy(pool, m, R_aux.data(), P.data());
+  double nrm_R = nrm2(pool, m, R.data());
+  history.initial_norm = nrm_R;
+  history.threshold = tolerance * nrm_R;
+  double delta = dot(pool, m, R.data(), R.data());
+  // ### 4 ### repeat until convergence
+  for (int i = 0; i < max_iterations; i++) {
+    history.norms.push_back(nrm_R);
+    // ### 5 ### alpha = delta / (A * P_i, P_i)
+    spmv(A, 1.0, P.data(), 0.0, T.data(), pool);
+    const double alpha = delta / dot(pool, m, T.data(), P.data());
+    // ### 6 ### X_i+1 = X_i + alpha * P
+    axpy(pool, m, alpha, P.data(), x);
+    // ### 7 ### R_i+1 = R_i - alpha * (A * P)
+    axpy(pool, m, -alpha, T.data(), R.data());
+    // ### 8 ### check ||R_i+1|| < threshold
+    nrm_R = nrm2(pool, m, R.data());
+    if (nrm_R < history.threshold) break;
+    // ### 9 ### R_aux_i+1 = L^-T L^-1 R_i+1
+    solve(M.lower, R.data(), tmp.data(), pool);
+    solve(M.upper, tmp.data(), R_aux.data(), pool);
+    // ### 10 ### beta = (R_i+1, R_aux_i+1) / delta
+    const double delta_new = dot(pool, m, R.data(), R_aux.data());
+    const double beta = delta_new / delta;
+    delta = delta_new;
+    // ### 11 ### P = R_aux_i+1, then P = beta * P + P as the sample's
+    //            cublasDaxpy with aliased arguments does
+    copy(pool, m, R_aux.data(), P.data());
+    axpy(pool, m, beta, R_aux.data(), P.data());
+  }
+  // Check Solution: ||b - A * X||
+  copy(pool, m, b, R.data());
+  spmv(A, -1.0, x, 1.0, R.data(), pool);
+  history.final_norm = nrm2(pool, m, R.data());
+  return history;
+}
+
+// Preconditioned BiCGStab of gpu_BiCGStab (cuSPARSE/bicgstab) with
+// M = L * U from ilu0(), starting from the initial guess in x
+inline History bicgstab(const CsrView &A, const Factors &M, const double *b,
+                        double *x, int max_iterations, double tolerance,
+                        ThreadPool *pool = nullptr) {
+  using namespace Kernel;
+  const int32_t m = A.num_rows;
+  std::vector<double> R0(m), R(m), P(m), P_aux(m), S(m), S_aux(m), V(m),
+      T(m), tmp(m);
+  History history;
+  history.first_iteration = 1;
+  // ### 1 ### R0 = b - A * X0
+  copy(pool, m, b, R0.data());
+  spmv(A, -1.0, x, 1.0, R0.data(), pool);
+  double alpha = 0.0, omega = 0.0;
+  double delta = dot(pool, m, R0.data(), R0.data());
+  double delta_prev = delta;
+  copy(pool, m, R0.data(), R.data());
+  double nrm_R = nrm2(pool, m, R0.data());
+  history.initial_norm = nrm_R;
+  history.threshold = tolerance * nrm_R;
+  // ### 2 ### repeat until convergence
+  for (int i = 1; i <= max_iterations; i++) {
+    history.norms.push_back(nrm_R);
+    // ### 4, 7 ### P_i = R_i
+    copy(pool, m, R.data(), P.data());
+    if (i > 1) {
+      // ### 6 ### beta = (delta_i / delta_i-1) * (alpha / omega_i-1)
+      delta = dot(pool, m, R0.data(), R.data());
+      const double beta = (delta / delta_prev) * (alpha / omega);
+      delta_prev = delta;
+      // ### 7 ### P = R + beta * (P - omega * V), with P = R as above
+      parallel_for(pool, m, kGrain, [&](int64_t begin, int64_t end) {
+        for (int64_t idx = begin; idx < end; idx++) {
+          P[idx] = R[idx] + beta * (P[idx] - omega * V[idx]);
+        }
+      });
+    }
+    // ### 9 ### P_aux = M_U^-1 M_L^-1 P_i
+    solve(M.lower, P.data(), tmp.data(), pool);
+    solve(M.upper, tmp.data(), P_aux.data(), pool);
+    // ### 10 ### alpha = (R'0, R_i-1) / (R'0, A * P_aux)
+    spmv(A, 1.0, P_aux.data(), 0.0, V.data(), pool);
+    alpha = delta / dot(pool, m, R0.data(), V.data());
+    // ### 11 ### X_i = X_i-1 + alpha * P_aux
+    axpy(pool, m, alpha, P_aux.data(), x);
+    // ### 12 ### S = R_i-1 - alpha * (A * P_aux)
+    copy(pool, m, R.data(), S.data());
+    axpy(pool, m, -alpha, V.data(), S.data());
+    // ### 13 ### check ||S|| < threshold
+    if (nrm2(pool, m, S.data()) < history.threshold) break;
+    // ### 14 ### S_aux = M_U^-1 M_L^-1 S
+    solve(M.lower, S.data(), tmp.data(), pool);
+    solve(M.upper, tmp.data(), S_aux.data(), pool);
+    // ### 15 ### omega = (A * S_aux, s) / (A * S_aux, A * S_aux)
+    spmv(A, 1.0, S_aux.data(), 0.0, T.data(), pool);
+    omega = dot(pool, m, T.data(), S.data()) /
+            dot(pool, m, T.data(), T.data());
+    // ### 16 ### X_i = X_i-1 + alpha * P_aux + omega * S_aux
+    axpy(pool, m, omega, S_aux.data(), x);
+    // ### 17 ### R_i+1 = S - omega * (A * S_aux)
+    copy(pool, m, S.data(), R.data());
+    axpy(pool, m, -omega, T.data(), R.data());
+    // ### 18 ### check ||R_i|| < threshold
+    nrm_R = nrm2(pool, m, R.data());
+    if (nrm_R < history.threshold) break;
+  }
+  // Check Solution: ||b - A * X||
+  copy(pool, m, b, R.data());
+  spmv(A, -1.0, x, 1.0, R.data(), pool);
+  history.final_norm = nrm2(pool, m, R.data());
+  return history;
+}
+
+// Prints the history as gpu_CG and gpu_BiCGStab print theirs
+inline void print_history(const History &history, FILE *stream = stdout) {
+  fprintf(stream, "  Initial Residual: Norm %e' threshold %e\n",
+          history.initial_norm, history.threshold);
+  for (size_t idx = 0; idx < history.norms.size(); idx++) {
+    fprintf(stream, "  Iteration = %d; Error Norm = %e\n",
+            history.first_iteration + int(idx), history.norms[idx]);
+  }
+  fprintf(stream, "Check Solution\n");
+  fprintf(stream, "Final error norm = %e\n", history.final_norm);
+}
+}  // namespace HostKrylov
@@ -0,0 +1,537 @@
+#pragma once
+// Host reference matmul for verifying GPU results. Host-only.
+//
+// C = alpha * op(A) * op(B) + beta * C with fp32, fp16, bf16, int8, int32 or
+// fp8 (e4m3, e5m2) inputs, fp32 accumulation and an fp32 result, for row or
+// column major operands of any leading dimension, optionally batched.
+//
+// C is cut into tiles that run in parallel on a ThreadPool. For every slice
+// of k, a tile packs its blocks of op(A) and op(B), converted to fp32, into
+// panels read contiguously by a 6x16 register-blocked micro-kernel written
+// with GCC vector extensions (AVX2 when the CPU has it, SSE or NEON
+// otherwise, scalar on other compilers).
+//
+// compare() checks a GPU result against the reference with a relative and
+// absolute tolerance or a distance in units in the last place of the GPU
+// output type, instead of exact equality.
+#include <utils/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__GNUC__)
+#define HOST_MATMUL_VECTOR_EXT
+#if defined(__x86_64__) || defined(__i386__)
+#define HOST_MATMUL_AVX2
+#endif
+#endif
+
+namespace HostMatmul {
+enum class ElementType {
+  kFloat,
+  kHalf,
+  kBFloat16,
+  kInt8,
+  kInt32,
+  kE4M3,
+  kE5M2
+};
+
+enum class Order { kRow, kCol };
+
+enum class Op { kN, kT };
+
+// Operand as stored in memory: element (r, c) of the stored matrix is at
+// r * ld + c in row major order and r + c * ld in column major order. op
+// applies on top of the storage, as in BLAS.
+struct MatrixDesc {
+  const void *data;
+  ElementType type;
+  Order order;
+  Op op;
+  int64_t ld;
+  int64_t batch_stride;  // in elements
+};
+
+struct Options {
+  float alpha = 1.0f;
+  float beta = 0.0f;
+  int batch_count = 1;
+  // 0 uses every hardware thread
+  int num_threads = 0;
+};
+
+// Tolerance of compare(). An element passes if it is within max_ulps units
+// in the last place of the expected value rounded to the output type, or
+// if |actual - expected| <= atol + rtol * |expected|.
+struct Tolerance {
+  float rtol;
+  float atol;
+  int max_ulps;
+};
+
+struct Comparison {
+  int64_t num_mismatches;
+  float max_abs_error;
+  float max_rel_error;
+  // First mismatch, -1 if none
+  int64_t first_row;
+  int64_t first_col;
+  int first_batch;
+  float first_expected;
+  float first_actual;
+};
+
+size_t get_element_size(ElementType type) {
+  switch (type) {
+    case ElementType::kFloat:
+    case ElementType::kInt32:
+      return 4;
+    case ElementType::kHalf:
+    case ElementType::kBFloat16:
+      return 2;
+    default:
+      return 1;
+  }
+}
+
+namespace Convert {
+float from_bits(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+uint32_t to_bits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float half_to_float(uint16_t h) {
+  uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+  if (exponent == 0x1f) return from_bits(sign | 0x7f800000 | (mantissa << 13));
+  if (exponent == 0) {
+    // Zero or subnormal: mantissa * 2^-24
+    float value = mantissa * 5.9604644775390625e-8f;
+    return sign ? -value : value;
+  }
+  return from_bits(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+// Round to nearest even
+uint16_t float_to_half(float value) {
+  uint32_t bits = to_bits(value);
+  uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  uint32_t abs_bits = bits & 0x7fffffff;
+  if (abs_bits >= 0x7f800000) {
+    return sign | 0x7c00 | (abs_bits > 0x7f800000 ? 0x200 : 0);
+  }
+  if (abs_bits >= 0x477ff000) return sign | 0x7c00;  // rounds past 65504
+  if (abs_bits < 0x38800000) {
+    // Subnormal half: the value in units of 2^-24, rounded
+    float scaled = from_bits(abs_bits) * 16777216.0f;
+    return sign | static_cast<uint16_t>(std::nearbyint(scaled));
+  }
+  uint32_t rounded = abs_bits + 0xfff + ((abs_bits >> 13) & 1);
+  return sign | static_cast<uint16_t>((rounded - 0x38000000) >> 13);
+}
+
+float bfloat16_to_float(uint16_t b) {
+  return from_bits(static_cast<uint32_t>(b) << 16);
+}
+
+uint16_t float_to_bfloat16(float value) {
+  uint32_t bits = to_bits(value);
+  if ((bits & 0x7fffffff) > 0x7f800000) {
+    return static_cast<uint16_t>((bits >> 16) | 0x40);
+  }
+  return static_cast<uint16_t>((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+}
+
+// e4m3 has no infinities and S.1111.111 is NaN; e5m2 follows IEEE
+float fp8_to_float(uint8_t v, int exponent_bits) {
+  int mantissa_bits = 7 - exponent_bits;
+  int bias = (1 << (exponent_bits - 1)) - 1;
+  int exponent = (v >> mantissa_bits) & ((1 << exponent_bits) - 1);
+  int mantissa = v & ((1 << mantissa_bits) - 1);
+  float sign = (v & 0x80) ? -1.0f : 1.0f;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  if (exponent_bits == 4 && exponent == 15 && mantissa == 7) return nan;
+  if (exponent_bits == 5 && exponent == 31) {
+    return mantissa ? nan : sign * std::numeric_limits<float>::infinity();
+  }
+  if (exponent == 0) {
+    return sign * std::ldexp(static_cast<float>(mantissa),
+                             1 - bias - mantissa_bits);
+  }
+  return sign * std::ldexp(static_cast<float>(mantissa | (1 << mantissa_bits)),
+                           exponent - bias - mantissa_bits);
+}
+
+std::vector<float> make_fp8_table(int exponent_bits) {
+  std::vector<float> table(256);
+  for (int v = 0; v < 256; v++) {
+    table[v] = fp8_to_float(static_cast<uint8_t>(v), exponent_bits);
+  }
+  return table;
+}
+
+const float *get_fp8_table(ElementType type) {
+  static const std::vector<float> e4m3 = make_fp8_table(4);
+  static const std::vector<float> e5m2 = make_fp8_table(5);
+  return type == ElementType::kE4M3 ? e4m3.data() : e5m2.data();
+}
+
+float load(const void *data, ElementType type, int64_t idx) {
+  switch (type) {
+    case ElementType::kFloat:
+      return static_cast<const float *>(data)[idx];
+    case ElementType::kHalf:
+      return half_to_float(static_cast<const uint16_t *>(data)[idx]);
+    case ElementType::kBFloat16:
+      return bfloat16_to_float(static_cast<const uint16_t *>(data)[idx]);
+    case ElementType::kInt8:
+      return static_cast<const int8_t *>(data)[idx];
+    case ElementType::kInt32:
+      return static_cast<float>(static_cast<const int32_t *>(data)[idx]);
+    default:
+      return get_fp8_table(type)[static_cast<const uint8_t *>(data)[idx]];
+  }
+}
+
+// Position of value, rounded to type, on the integer line of the values
+// representable in type; ULP distances are differences of these
+int64_t get_ordinal(float value, ElementType type) {
+  int64_t bits, sign_bit;
+  switch (type) {
+    case ElementType::kHalf:
+      bits = float_to_half(value);
+      sign_bit = 0x8000;
+      break;
+    case ElementType::kBFloat16:
+      bits = float_to_bfloat16(value);
+      sign_bit = 0x8000;
+      break;
+    case ElementType::kInt8:
+    case ElementType::kInt32:
+      return static_cast<int64_t>(std::nearbyint(value));
+    default:
+      // fp32 spacing; fp8 outputs rely on the relative tolerance
+      bits = to_bits(value);
+      sign_bit = 0x80000000;
+      break;
+  }
+  return (bits & sign_bit) ? -(bits & (sign_bit - 1)) : bits;
+}
+}  // namespace Convert
+
+namespace Kernel {
+const int kMR = 6;
+const int kNR = 16;
+const int64_t kKC = 256;
+const int64_t kMC = 96;   // multiple of kMR
+const int64_t kNC = 256;  // multiple of kNR
+
+// Element offsets between rows and between columns of op(M)
+struct Strides {
+  int64_t row;
+  int64_t col;
+};
+
+Strides get_strides(const MatrixDesc &desc) {
+  bool row_major = desc.order == Order::kRow;
+  bool transposed = desc.op == Op::kT;
+  if (row_major != transposed) return {desc.ld, 1};
+  return {1, desc.ld};
+}
+
+// Packs rows [row0, row0 + rows) x columns [col0, col0 + cols) of op(M),
+// or of its transpose, as fp32 panels of width rows: panel p holds, for
+// every column, the values of its rows, zero padded to width.
+void pack(const MatrixDesc &desc, const void *data, bool transpose,
+          int64_t row0, int64_t rows, int64_t col0, int64_t cols, int width,
+          float *out) {
+  Strides strides = get_strides(desc);
+  if (transpose) std::swap(strides.row, strides.col);
+  bool contiguous = desc.type == ElementType::kFloat && strides.row == 1;
+  for (int64_t p = 0; p < rows; p += width) {
+    int64_t height = std::min<int64_t>(width, rows - p);
+    float *panel = out + p * cols;
+    for (int64_t c = 0; c < cols; c++) {
+      float *dst = panel + c * width;
+      int64_t base = (row0 + p) * strides.row + (col0 + c) * strides.col;
+      int64_t r = 0;
+      if (contiguous) {
+        memcpy(dst, static_cast<const float *>(data) + base,
+               height * sizeof(float));
+        r = height;
+      }
+      for (; r < height; r++) {
+        dst[r] = Convert::load(data, desc.type, base + r * strides.row);
+      }
+      for (; r < width; r++) dst[r] = 0.0f;
+    }
+  }
+}
+
+// c[kMR][kNR] at leading dimension ldc (+)= A panel * B panel over kc
+#if defined(HOST_MATMUL_VECTOR_EXT)
+typedef float Vec8 __attribute__((vector_size(32)));
+
+inline __attribute__((always_inline)) void micro_kernel_body(
+    int64_t kc, const float *a, const float *b, float *c, int64_t ldc,
+    bool accumulate) {
+  Vec8 acc[kMR][2];
+  for (int r = 0; r < kMR; r++) {
+    for (int v = 0; v < 2; v++) {
+      if (accumulate) {
+        memcpy(&acc[r][v], c + r * ldc + 8 * v, sizeof(Vec8));
+      } else {
+        acc[r][v] = Vec8{};
+      }
+    }
+  }
+  for (int64_t p = 0; p < kc; p++) {
+    Vec8 b0, b1;
+    memcpy(&b0, b + p * kNR, sizeof(Vec8));
+    memcpy(&b1, b + p * kNR + 8, sizeof(Vec8));
+    for (int r = 0; r < kMR; r++) {
+      Vec8 broadcast = Vec8{} + a[p * kMR + r];
+      acc[r][0] += broadcast * b0;
+      acc[r][1] += broadcast * b1;
+    }
+  }
+  for (int r = 0; r < kMR; r++) {
+    for (int v = 0; v < 2; v++) {
+      memcpy(c + r * ldc + 8 * v, &acc[r][v], sizeof(Vec8));
+    }
+  }
+}
+#else
+inline void micro_kernel_body(int64_t kc, const float *a, const float *b,
+                              float *c, int64_t ldc, bool accumulate) {
+  float acc[kMR][kNR];
+  for (int r = 0; r < kMR; r++) {
+    for (int j = 0; j < kNR; j++) acc[r][j] = accumulate ? c[r * ldc + j] : 0;
+  }
+  for (int64_t p = 0; p < kc; p++) {
+    for (int r = 0; r < kMR; r++) {
+      float value = a[p * kMR + r];
+      for (int j = 0; j < kNR; j++) acc[r][j] += value * b[p * kNR + j];
+    }
+  }
+  for (int r = 0; r < kMR; r++) {
+    for (int j = 0; j < kNR; j++) c[r * ldc + j] = acc[r][j];
+  }
+}
+#endif
+
+#if defined(HOST_MATMUL_AVX2)
+__attribute__((target("avx2,fma"))) void micro_kernel_avx2(
+    int64_t kc, const float *a, const float *b, float *c, int64_t ldc,
+    bool accumulate) {
+  micro_kernel_body(kc, a, b, c, ldc, accumulate);
+}
+
+bool has_avx2() {
+  static const bool result =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return result;
+}
+#endif
+
+void micro_kernel(int64_t kc, const float *a, const float *b, float *c,
+                  int64_t ldc, bool accumulate) {
+#if defined(HOST_MATMUL_AVX2)
+  if (has_avx2()) return micro_kernel_avx2(kc, a, b, c, ldc, accumulate);
+#endif
+  micro_kernel_body(kc, a, b, c, ldc, accumulate);
+}
+
+// Per-worker packing and accumulation buffers
+struct Workspace {
+  std::vector<float> a;
+  std::vector<float> b;
+  std::vector<float> c;
+};
+
+struct Problem {
+  int64_t m, n, k;
+  MatrixDesc a, b;
+  float *c;
+  Order c_order;
+  int64_t ldc;
+  int64_t c_batch_stride;
+  Options options;
+};
+
+// Computes the kMC x kNC tile of C at (row0, col0) of one batch
+void run_tile(const Problem &problem, int batch, int64_t row0, int64_t col0,
+              Workspace &ws) {
+  const MatrixDesc &a = problem.a;
+  const MatrixDesc &b = problem.b;
+  int64_t rows = std::min(kMC, problem.m - row0);
+  int64_t cols = std::min(kNC, problem.n - col0);
+  int64_t padded_rows = (rows + kMR - 1) / kMR * kMR;
+  int64_t padded_cols = (cols + kNR - 1) / kNR * kNR;
+  ws.a.resize(padded_rows * kKC);
+  ws.b.resize(padded_cols * kKC);
+  ws.c.assign(padded_rows * padded_cols, 0.0f);
+  const void *a_data = static_cast<const char *>(a.data) +
+                       batch * a.batch_stride * get_element_size(a.type);
+  const void *b_data = static_cast<const char *>(b.data) +
+                       batch * b.batch_stride * get_element_size(b.type);
+  for (int64_t p0 = 0; p0 < problem.k; p0 += kKC) {
+    int64_t kc = std::min(kKC, problem.k - p0);
+    pack(a, a_data, false, row0, rows, p0, kc, kMR, ws.a.data());
+    pack(b, b_data, true, col0, cols, p0, kc, kNR, ws.b.data());
+    for (int64_t jr = 0; jr < padded_cols; jr += kNR) {
+      for (int64_t ir = 0; ir < padded_rows; ir += kMR) {
+        micro_kernel(kc, ws.a.data() + ir * kc, ws.b.data() + jr * kc,
+                     ws.c.data() + ir * padded_cols + jr, padded_cols, p0 > 0);
+      }
+    }
+  }
+  const Options &options = problem.options;
+  float *c = problem.c + batch * problem.c_batch_stride;
+  for (int64_t i = 0; i < rows; i++) {
+    for (int64_t j = 0; j < cols; j++) {
+      int64_t pos = problem.c_order == Order::kRow
+                        ? (row0 + i) * problem.ldc + col0 + j
+                        : (row0 + i) + (col0 + j) * problem.ldc;
+      float value = options.alpha * ws.c[i * padded_cols + j];
+      // beta == 0 must not read C, which may be uninitialized
+      c[pos] = options.beta == 0.0f ? value : value + options.beta * c[pos];
+    }
+  }
+}
+}  // namespace Kernel
+
+// C = alpha * op(A) * op(B) + beta * C, where C is fp32, m x n in c_order
+// with leading dimension ldc and c_batch_stride elements between batches
+void matmul(int64_t m, int64_t n, int64_t k, const MatrixDesc &a,
+            const MatrixDesc &b, float *c, Order c_order, int64_t ldc,
+            int64_t c_batch_stride, const Options &options = Options()) {
+  if (m < 0 || n < 0 || k < 0 || options.batch_count < 1) {
+    throw std::invalid_argument("HostMatmul::matmul: invalid dimensions");
+  }
+  if (m == 0 || n == 0) return;
+  Kernel::Problem problem = {m, n, k, a, b, c, c_order, ldc, c_batch_stride,
+                             options};
+  int64_t row_tiles = (m + Kernel::kMC - 1) / Kernel::kMC;
+  int64_t col_tiles = (n + Kernel::kNC - 1) / Kernel::kNC;
+  int64_t num_tiles = row_tiles * col_tiles;
+  size_t num_tasks = static_cast<size_t>(num_tiles * options.batch_count);
+  size_t num_threads = options.num_threads > 0
+                           ? options.num_threads
+                           : std::max(1u, std::thread::hardware_concurrency());
+  num_threads = std::min(num_threads, num_tasks);
+  std::vector<Kernel::Workspace> workspaces(num_threads);
+  auto run = [&](int tid, size_t task) {
+    int batch = static_cast<int>(task / num_tiles);
+    int64_t tile = task % num_tiles;
+    Kernel::run_tile(problem, batch, (tile / col_tiles) * Kernel::kMC,
+                     (tile % col_tiles) * Kernel::kNC, workspaces[tid]);
+  };
+  if (num_threads == 1) {
+    for (size_t task = 0; task < num_tasks; task++) run(0, task);
+    return;
+  }
+  ThreadPool pool(num_threads);
+  pool.enqueue_batch(num_tasks, run);
+  pool.wait();
+}
+
+// Same, returning a heap-allocated C (beta is ignored) whose batches are
+// contiguous: (c_order == kRow ? m : n) * ldc elements each
+std::vector<float> matmul(int64_t m, int64_t n, int64_t k, const MatrixDesc &a,
+                          const MatrixDesc &b, Order c_order, int64_t ldc,
+                          const Options &options = Options()) {
+  // Checked before sizing C
+  if (m < 0 || n < 0 || k < 0 || options.batch_count < 1) {
+    throw std::invalid_argument("HostMatmul::matmul: invalid dimensions");
+  }
+  int64_t c_batch_stride = (c_order == Order::kRow ? m : n) * ldc;
+  std::vector<float> c(
+      static_cast<size_t>(c_batch_stride * std::max(1, options.batch_count)));
+  Options overwrite = options;
+  overwrite.beta = 0.0f;
+  matmul(m, n, k, a, b, c.data(), c_order, ldc, c_batch_stride, overwrite);
+  return c;
+}
+
+Tolerance get_default_tolerance(ElementType output_type) {
+  switch (output_type) {
+    case ElementType::kHalf:
+      return {1e-2f, 1e-3f, 2};
+    case ElementType::kBFloat16:
+      return {2e-2f, 1e-2f, 2};
+    case ElementType::kInt8:
+    case ElementType::kInt32:
+      return {0.0f, 0.0f, 0};
+    case ElementType::kE4M3:
+    case ElementType::kE5M2:
+      return {0.25f, 1e-2f, 0};
+    default:
+      return {1e-4f, 1e-5f, 4};
+  }
+}
+
+// Compares the GPU result, actual in actual_type, with the fp32 reference;
+// both are m x n in c_order with leading dimension ldc and batch_stride
+// elements between batches
+Comparison compare(int64_t m, int64_t n, const void *actual,
+                   ElementType actual_type, const float *expected,
+                   Order c_order, int64_t ldc, int64_t batch_stride,
+                   int batch_count, const Tolerance &tolerance) {
+  Comparison result = {0, 0.0f, 0.0f, -1, -1, -1, 0.0f, 0.0f};
+  for (int batch = 0; batch < batch_count; batch++) {
+    for (int64_t i = 0; i < m; i++) {
+      for (int64_t j = 0; j < n; j++) {
+        int64_t pos = batch * batch_stride +
+                      (c_order == Order::kRow ? i * ldc + j : i + j * ldc);
+        float value = Convert::load(actual, actual_type, pos);
+        float reference = expected[pos];
+        if (value == reference || (std::isnan(value) && std::isnan(reference)))
+          continue;
+        float abs_error = std::fabs(value - reference);
+        float rel_error = reference != 0.0f ? abs_error / std::fabs(reference)
+                                            : abs_error;
+        if (!std::isnan(abs_error)) {
+          result.max_abs_error = std::max(result.max_abs_error, abs_error);
+          result.max_rel_error = std::max(result.max_rel_error, rel_error);
+        }
+        // An overflow or a NaN against a finite reference is never within
+        // tolerance, even though, e.g., +Inf is one ULP above 65504 in fp16
+        bool overflow = std::isfinite(reference) && !std::isfinite(value);
+        int64_t ulps =
+            std::llabs(Convert::get_ordinal(value, actual_type) -
+                       Convert::get_ordinal(reference, actual_type));
+        if (!overflow &&
+            (ulps <= tolerance.max_ulps ||
+             abs_error <=
+                 tolerance.atol + tolerance.rtol * std::fabs(reference)))
+          continue;
+        if (result.num_mismatches++ == 0) {
+          result.first_row = i;
+          result.first_col = j;
+          result.first_batch = batch;
+          result.first_expected = reference;
+          result.first_actual = value;
+        }
+      }
+    }
+  }
+  return result;
+}
+}  // namespace HostMatmul
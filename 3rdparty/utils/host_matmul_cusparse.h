@@ -0,0 +1,49 @@
+#pragma once
+// cuSPARSE / cuSPARSELt adapters of utils/host_matmul.h: describes a host
+// copy of a matmul operand with the data type, order and operation passed
+// to the library.
+#include <cuda_runtime_api.h>
+#include <cusparse.h>
+#include <utils/host_matmul.h>
+
+#include <stdexcept>
+
+namespace HostMatmul {
+ElementType get_element_type(cudaDataType_t type) {
+  switch (type) {
+    case CUDA_R_32F:
+      return ElementType::kFloat;
+    case CUDA_R_16F:
+      return ElementType::kHalf;
+    case CUDA_R_16BF:
+      return ElementType::kBFloat16;
+    case CUDA_R_8I:
+      return ElementType::kInt8;
+    case CUDA_R_32I:
+      return ElementType::kInt32;
+#if CUDART_VERSION >= 11080
+    case CUDA_R_8F_E4M3:
+      return ElementType::kE4M3;
+    case CUDA_R_8F_E5M2:
+      return ElementType::kE5M2;
+#endif
+    default:
+      throw std::invalid_argument("HostMatmul: unsupported data type");
+  }
+}
+
+Order get_order(cusparseOrder_t order) {
+  return order == CUSPARSE_ORDER_ROW ? Order::kRow : Order::kCol;
+}
+
+Op get_op(cusparseOperation_t op) {
+  return op == CUSPARSE_OPERATION_NON_TRANSPOSE ? Op::kN : Op::kT;
+}
+
+MatrixDesc make_desc(const void *data, cudaDataType_t type,
+                     cusparseOrder_t order, cusparseOperation_t op, int64_t ld,
+                     int64_t batch_stride = 0) {
+  return {data, get_element_type(type), get_order(order), get_op(op), ld,
+          batch_stride};
+}
+}  // namespace HostMatmul
@@ -0,0 +1,537 @@
+#pragma once
+// Encoding of decoded 8-bit RGB images to BMP, PPM or uncompressed PNG, and a
+// background writer pool. Host-only.
+//
+// Each output row is packed from the planar or interleaved source in one go
+// (SSSE3 on x86 when the CPU has it, NEON on ARM, scalar otherwise) into a
+// row buffer and written with a single fwrite. PNG rows are gathered into
+// stored deflate blocks of up to 64 KiB, one IDAT chunk per block.
+//
+// AsyncWriter owns a fixed set of jobs. A caller takes a free job, copies the
+// image into the job storage and submits it; writer threads encode and write
+// it and return the job to the free list. With every job in flight,
+// acquire_job() blocks, which bounds both memory and the write backlog.
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IMAGE_WRITER_SSSE3
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace ImageWriter {
+enum class Format { kBMP, kPPM, kPNG };
+
+enum class ChannelOrder { kRGB, kBGR };
+
+// 8-bit three-channel image in host memory. Planar images use channel[0..2]
+// and pitch[0..2]; interleaved images use channel[0] and pitch[0].
+struct ImageView {
+  int width;
+  int height;
+  ChannelOrder order;
+  bool interleaved;
+  const unsigned char *channel[3];
+  size_t pitch[3];
+};
+
+const char *get_format_name(Format format) {
+  switch (format) {
+    case Format::kPPM:
+      return "ppm";
+    case Format::kPNG:
+      return "png";
+    default:
+      return "bmp";
+  }
+}
+
+// Returns false for an unknown format
+bool parse_format(const std::string &str, Format &format) {
+  if (str == "bmp") {
+    format = Format::kBMP;
+  } else if (str == "ppm") {
+    format = Format::kPPM;
+  } else if (str == "png") {
+    format = Format::kPNG;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// output_dir/<input file name without directory and extension>.<format>
+std::string get_output_name(const std::string &output_dir,
+                            const std::string &input_name, Format format) {
+  size_t position = input_name.rfind("/");
+  std::string name = (std::string::npos == position)
+                         ? input_name
+                         : input_name.substr(position + 1);
+  position = name.rfind(".");
+  if (std::string::npos != position) name = name.substr(0, position);
+  return output_dir + "/" + name + "." + get_format_name(format);
+}
+
+// Row packing kernels. Both produce width interleaved pixels in out.
+namespace Pack {
+void interleave_scalar(const unsigned char *c0, const unsigned char *c1,
+                       const unsigned char *c2, int width,
+                       unsigned char *out) {
+  for (int x = 0; x < width; x++) {
+    out[3 * x] = c0[x];
+    out[3 * x + 1] = c1[x];
+    out[3 * x + 2] = c2[x];
+  }
+}
+
+void swap_scalar(const unsigned char *in, int width, unsigned char *out) {
+  for (int x = 0; x < width; x++) {
+    unsigned char first = in[3 * x];
+    out[3 * x + 1] = in[3 * x + 1];
+    out[3 * x] = in[3 * x + 2];
+    out[3 * x + 2] = first;
+  }
+}
+
+#if defined(IMAGE_WRITER_SSSE3)
+// pshufb masks for 16 pixels (48 bytes). Output vector v takes from input
+// vector s the bytes given by masks[v][s]; 0x80 zeroes a byte.
+struct Masks {
+  alignas(16) signed char masks[3][3][16];
+};
+
+// Output byte k of the interleaved layout is component k % 3 of pixel k / 3
+Masks get_interleave_masks() {
+  Masks result;
+  for (int v = 0; v < 3; v++) {
+    for (int j = 0; j < 16; j++) {
+      int k = 16 * v + j;
+      for (int s = 0; s < 3; s++) {
+        result.masks[v][s][j] =
+            k % 3 == s ? static_cast<signed char>(k / 3) : -128;
+      }
+    }
+  }
+  return result;
+}
+
+// Output byte k comes from the mirrored component of the same pixel
+Masks get_swap_masks() {
+  Masks result;
+  for (int v = 0; v < 3; v++) {
+    for (int j = 0; j < 16; j++) {
+      int k = 16 * v + j;
+      int src = k / 3 * 3 + 2 - k % 3;
+      for (int s = 0; s < 3; s++) {
+        result.masks[v][s][j] =
+            src / 16 == s ? static_cast<signed char>(src % 16) : -128;
+      }
+    }
+  }
+  return result;
+}
+
+__attribute__((target("ssse3"))) void shuffle_48(const Masks &masks,
+                                                   const __m128i in[3],
+                                                   unsigned char *out) {
+  for (int v = 0; v < 3; v++) {
+    __m128i result = _mm_setzero_si128();
+    for (int s = 0; s < 3; s++) {
+      __m128i mask = _mm_load_si128(
+          reinterpret_cast<const __m128i *>(masks.masks[v][s]));
+      result = _mm_or_si128(result, _mm_shuffle_epi8(in[s], mask));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16 * v), result);
+  }
+}
+
+__attribute__((target("ssse3"))) void interleave_ssse3(
+    const unsigned char *c0, const unsigned char *c1, const unsigned char *c2,
+    int width, unsigned char *out) {
+  static const Masks masks = get_interleave_masks();
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i in[3] = {
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(c0 + x)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(c1 + x)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(c2 + x))};
+    shuffle_48(masks, in, out + 3 * x);
+  }
+  interleave_scalar(c0 + x, c1 + x, c2 + x, width - x, out + 3 * x);
+}
+
+__attribute__((target("ssse3"))) void swap_ssse3(const unsigned char *in,
+                                                   int width,
+                                                   unsigned char *out) {
+  static const Masks masks = get_swap_masks();
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const unsigned char *src = in + 3 * x;
+    __m128i vin[3] = {
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32))};
+    shuffle_48(masks, vin, out + 3 * x);
+  }
+  swap_scalar(in + 3 * x, width - x, out + 3 * x);
+}
+
+bool has_ssse3() {
+  static const bool result = __builtin_cpu_supports("ssse3");
+  return result;
+}
+#endif
+
+// out[3x + c] = plane c at x
+void interleave(const unsigned char *c0, const unsigned char *c1,
+                const unsigned char *c2, int width, unsigned char *out) {
+#if defined(IMAGE_WRITER_SSSE3)
+  if (has_ssse3()) return interleave_ssse3(c0, c1, c2, width, out);
+#elif defined(__ARM_NEON)
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x3_t pixels = {{vld1q_u8(c0 + x), vld1q_u8(c1 + x),
+                            vld1q_u8(c2 + x)}};
+    vst3q_u8(out + 3 * x, pixels);
+  }
+  c0 += x;
+  c1 += x;
+  c2 += x;
+  out += 3 * x;
+  width -= x;
+#endif
+  interleave_scalar(c0, c1, c2, width, out);
+}
+
+// Swaps the first and third component of every pixel; in may equal out
+void swap(const unsigned char *in, int width, unsigned char *out) {
+#if defined(IMAGE_WRITER_SSSE3)
+  if (has_ssse3()) return swap_ssse3(in, width, out);
+#elif defined(__ARM_NEON)
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x3_t pixels = vld3q_u8(in + 3 * x);
+    uint8x16_t first = pixels.val[0];
+    pixels.val[0] = pixels.val[2];
+    pixels.val[2] = first;
+    vst3q_u8(out + 3 * x, pixels);
+  }
+  in += 3 * x;
+  out += 3 * x;
+  width -= x;
+#endif
+  swap_scalar(in, width, out);
+}
+}  // namespace Pack
+
+// Packs row y of the image as interleaved pixels in the given channel order
+void pack_row(const ImageView &image, int y, ChannelOrder order,
+              unsigned char *out) {
+  if (image.interleaved) {
+    const unsigned char *row = image.channel[0] + y * image.pitch[0];
+    if (image.order == order) {
+      memcpy(out, row, 3 * static_cast<size_t>(image.width));
+    } else {
+      Pack::swap(row, image.width, out);
+    }
+    return;
+  }
+  const unsigned char *rows[3];
+  for (int c = 0; c < 3; c++) rows[c] = image.channel[c] + y * image.pitch[c];
+  if (image.order == order) {
+    Pack::interleave(rows[0], rows[1], rows[2], image.width, out);
+  } else {
+    Pack::interleave(rows[2], rows[1], rows[0], image.width, out);
+  }
+}
+
+void put_le(std::vector<unsigned char> &out, uint32_t value, int bytes) {
+  for (int idx = 0; idx < bytes; idx++) out.push_back(value >> (8 * idx));
+}
+
+void put_be(std::vector<unsigned char> &out, uint32_t value) {
+  for (int idx = 3; idx >= 0; idx--) out.push_back(value >> (8 * idx));
+}
+
+uint32_t crc32(uint32_t crc, const unsigned char *data, size_t size) {
+  static const std::vector<uint32_t> table = []() {
+    std::vector<uint32_t> result(256);
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      result[n] = c;
+    }
+    return result;
+  }();
+  crc = ~crc;
+  for (size_t idx = 0; idx < size; idx++) {
+    crc = table[(crc ^ data[idx]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+uint32_t adler32(uint32_t adler, const unsigned char *data, size_t size) {
+  // 5552 is the largest run for which the sums cannot overflow 32 bits
+  uint32_t a = adler & 0xFFFF, b = adler >> 16;
+  while (size > 0) {
+    size_t run = std::min<size_t>(size, 5552);
+    for (size_t idx = 0; idx < run; idx++) {
+      a += data[idx];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+    data += run;
+    size -= run;
+  }
+  return (b << 16) | a;
+}
+
+// Encodes the image and hands the bytes to sink(const unsigned char *, size_t)
+// in pieces of at most one row or one PNG chunk. Returns false if the sink
+// fails.
+template <typename Sink>
+bool encode(const ImageView &image, Format format, Sink &&sink) {
+  size_t row_bytes = 3 * static_cast<size_t>(image.width);
+  std::vector<unsigned char> header;
+  std::vector<unsigned char> row;
+
+  if (format == Format::kBMP) {
+    // Rows are stored bottom-up in BGR order, padded to 4 bytes
+    size_t padded_row = (row_bytes + 3) / 4 * 4;
+    uint32_t image_size = static_cast<uint32_t>(padded_row * image.height);
+    header = {'B', 'M'};
+    put_le(header, image_size + 54, 4);  // bfSize
+    put_le(header, 0, 4);                // bfReserved
+    put_le(header, 54, 4);               // bfOffBits
+    put_le(header, 40, 4);               // biSize
+    put_le(header, image.width, 4);
+    put_le(header, image.height, 4);
+    put_le(header, 1, 2);   // biPlanes
+    put_le(header, 24, 2);  // biBitCount
+    put_le(header, 0, 4);   // biCompression
+    put_le(header, image_size, 4);
+    for (int idx = 0; idx < 4; idx++) put_le(header, 0, 4);
+    if (!sink(header.data(), header.size())) return false;
+    row.assign(padded_row, 0);
+    for (int y = image.height - 1; y >= 0; y--) {
+      pack_row(image, y, ChannelOrder::kBGR, row.data());
+      if (!sink(row.data(), row.size())) return false;
+    }
+    return true;
+  }
+
+  if (format == Format::kPPM) {
+    std::string ppm_header = "P6\n" + std::to_string(image.width) + " " +
+                             std::to_string(image.height) + "\n255\n";
+    if (!sink(reinterpret_cast<const unsigned char *>(ppm_header.data()),
+              ppm_header.size())) {
+      return false;
+    }
+    row.resize(row_bytes);
+    for (int y = 0; y < image.height; y++) {
+      pack_row(image, y, ChannelOrder::kRGB, row.data());
+      if (!sink(row.data(), row.size())) return false;
+    }
+    return true;
+  }
+
+  // PNG: 8-bit truecolor, every row with filter type 0, zlib stream of
+  // stored deflate blocks
+  const size_t kMaxBlock = 65535;
+  auto put_chunk = [&](const char *type, std::vector<unsigned char> &data) {
+    std::vector<unsigned char> chunk;
+    chunk.reserve(data.size() + 12);
+    put_be(chunk, static_cast<uint32_t>(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    put_be(chunk, crc32(0, chunk.data() + 4, data.size() + 4));
+    return sink(chunk.data(), chunk.size());
+  };
+  const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A,
+                                      '\n'};
+  if (!sink(signature, sizeof(signature))) return false;
+  std::vector<unsigned char> ihdr;
+  put_be(ihdr, image.width);
+  put_be(ihdr, image.height);
+  ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0});
+  if (!put_chunk("IHDR", ihdr)) return false;
+
+  // One IDAT chunk per stored block; the first one starts with the zlib
+  // header and the last one ends with the Adler-32 of the raw data
+  std::vector<unsigned char> block;
+  block.reserve(kMaxBlock);
+  std::vector<unsigned char> idat;
+  bool first_block = true;
+  uint32_t adler = 1;
+  auto flush_block = [&](bool last) {
+    idat.clear();
+    if (first_block) idat.insert(idat.end(), {0x78, 0x01});
+    first_block = false;
+    idat.push_back(last ? 1 : 0);
+    put_le(idat, static_cast<uint32_t>(block.size()), 2);
+    put_le(idat, static_cast<uint32_t>(~block.size()) & 0xFFFF, 2);
+    idat.insert(idat.end(), block.begin(), block.end());
+    adler = adler32(adler, block.data(), block.size());
+    if (last) put_be(idat, adler);
+    block.clear();
+    return put_chunk("IDAT", idat);
+  };
+  row.resize(row_bytes + 1);
+  row[0] = 0;
+  for (int y = 0; y < image.height; y++) {
+    pack_row(image, y, ChannelOrder::kRGB, row.data() + 1);
+    size_t done = 0;
+    while (done < row.size()) {
+      size_t bytes = std::min(row.size() - done, kMaxBlock - block.size());
+      block.insert(block.end(), row.begin() + done,
+                   row.begin() + done + bytes);
+      done += bytes;
+      if (block.size() == kMaxBlock && !flush_block(false)) return false;
+    }
+  }
+  if (!flush_block(true)) return false;
+  std::vector<unsigned char> iend;
+  return put_chunk("IEND", iend);
+}
+
+// Returns 0 on success, 1 if the file cannot be written
+int write_image(const std::string &filename, const ImageView &image,
+                Format format) {
+  FILE *outfile = fopen(filename.c_str(), "wb");
+  if (outfile == nullptr) return 1;
+  bool ok = encode(image, format, [&](const unsigned char *data, size_t size) {
+    return fwrite(data, 1, size, outfile) == size;
+  });
+  if (fclose(outfile) != 0) ok = false;
+  return ok ? 0 : 1;
+}
+
+struct Job {
+  std::string filename;
+  Format format;
+  // view points into storage, which the caller sizes and fills
+  ImageView view;
+  std::vector<unsigned char> storage;
+};
+
+class AsyncWriter {
+ public:
+  // With num_threads == 0 submit() writes on the calling thread
+  AsyncWriter(int num_threads, int max_pending) {
+    max_pending = std::max(1, max_pending);
+    for (int idx = 0; idx < max_pending; idx++) {
+      jobs_.emplace_back(new Job());
+      free_.push_back(jobs_.back().get());
+    }
+    for (int idx = 0; idx < num_threads; idx++) {
+      workers_.emplace_back(&AsyncWriter::worker, this);
+    }
+  }
+
+  AsyncWriter(const AsyncWriter &) = delete;
+  AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+  ~AsyncWriter() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    queued_.notify_all();
+    for (auto &worker : workers_) worker.join();
+  }
+
+  // Blocks until a job is free
+  Job *acquire_job() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    freed_.wait(lock, [this]() { return !free_.empty(); });
+    Job *job = free_.back();
+    free_.pop_back();
+    return job;
+  }
+
+  // Returns an acquired job without writing it
+  void release_job(Job *job) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      free_.push_back(job);
+    }
+    freed_.notify_all();
+  }
+
+  void submit(Job *job) {
+    if (workers_.empty()) {
+      run(job);
+      return;
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queue_.push_back(job);
+    }
+    queued_.notify_one();
+  }
+
+  // Blocks until every submitted job is written
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    freed_.wait(lock, [this]() { return free_.size() == jobs_.size(); });
+  }
+
+  int get_num_failed() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return num_failed_;
+  }
+
+ private:
+  void run(Job *job) {
+    int err = write_image(job->filename, job->view, job->format);
+    if (err) {
+      printf("Cannot write output file: %s\n", job->filename.c_str());
+    } else {
+      printf("Done writing decoded image to file: %s\n",
+             job->filename.c_str());
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      num_failed_ += err;
+      free_.push_back(job);
+    }
+    freed_.notify_all();
+  }
+
+  void worker() {
+    for (;;) {
+      Job *job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queued_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) return;
+        job = queue_.front();
+        queue_.pop_front();
+      }
+      run(job);
+    }
+  }
+
+  std::vector<std::unique_ptr<Job>> jobs_;
+  std::vector<Job *> free_;
+  std::deque<Job *> queue_;
+  int num_failed_ = 0;
+  bool stop_ = false;
+  std::mutex mutex_;
+  std::condition_variable queued_;
+  std::condition_variable freed_;
+  std::vector<std::thread> workers_;
+};
+}  // namespace ImageWriter
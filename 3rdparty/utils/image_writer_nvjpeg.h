@@ -0,0 +1,63 @@
+#pragma once
+// nvJPEG adapters of utils/image_writer.h: copies a decoded device image to a
+// writer job and queues it, so that only the device-to-host copy stays on the
+// decoding thread.
+#include <cuda_runtime_api.h>
+#include <nvjpeg.h>
+#include <utils/image_writer.h>
+
+namespace ImageWriter {
+// Output formats that can be written: RGB/BGR, planar or interleaved
+bool is_writable(nvjpegOutputFormat_t fmt) {
+  return fmt == NVJPEG_OUTPUT_RGB || fmt == NVJPEG_OUTPUT_BGR ||
+         fmt == NVJPEG_OUTPUT_RGBI || fmt == NVJPEG_OUTPUT_BGRI;
+}
+
+// Copies the device image into job->storage and points job->view at it.
+// Returns 0 on success, 1 on a CUDA error.
+int copy_to_job(const nvjpegImage_t &image, nvjpegOutputFormat_t fmt,
+                int width, int height, Job *job) {
+  ImageView &view = job->view;
+  view.width = width;
+  view.height = height;
+  view.order = fmt == NVJPEG_OUTPUT_BGR || fmt == NVJPEG_OUTPUT_BGRI
+                   ? ChannelOrder::kBGR
+                   : ChannelOrder::kRGB;
+  view.interleaved = fmt == NVJPEG_OUTPUT_RGBI || fmt == NVJPEG_OUTPUT_BGRI;
+  size_t row_bytes = view.interleaved ? 3 * static_cast<size_t>(width) : width;
+  int num_planes = view.interleaved ? 1 : 3;
+  size_t plane_bytes = row_bytes * height;
+  job->storage.resize(plane_bytes * num_planes);
+  for (int c = 0; c < 3; c++) {
+    view.channel[c] = nullptr;
+    view.pitch[c] = 0;
+  }
+  for (int c = 0; c < num_planes; c++) {
+    unsigned char *plane = job->storage.data() + c * plane_bytes;
+    if (cudaMemcpy2D(plane, row_bytes, image.channel[c], image.pitch[c],
+                     row_bytes, height,
+                     cudaMemcpyDeviceToHost) != cudaSuccess) {
+      return 1;
+    }
+    view.channel[c] = plane;
+    view.pitch[c] = row_bytes;
+  }
+  return 0;
+}
+
+// Queues the decoded image for writing. The device image may be reused as
+// soon as this returns. Returns 0 on success, 1 on a CUDA error.
+int write_image(AsyncWriter &writer, const std::string &filename,
+                Format format, const nvjpegImage_t &image,
+                nvjpegOutputFormat_t fmt, int width, int height) {
+  Job *job = writer.acquire_job();
+  job->filename = filename;
+  job->format = format;
+  if (copy_to_job(image, fmt, width, height, job)) {
+    writer.release_job(job);
+    return 1;
+  }
+  writer.submit(job);
+  return 0;
+}
+}  // namespace ImageWriter
@@ -0,0 +1,826 @@
+#pragma once
+// Parallel Matrix Market reader with a binary CSR cache. Host-only, no CUDA
+// dependency.
+//
+// load() maps a coordinate Matrix Market file, cuts its entries into chunks
+// at line boundaries and parses the chunks on a ThreadPool: a first pass
+// counts the entries of every chunk, so that the second pass writes each one
+// straight to its place in the COO arrays. The CSR matrix is then built in
+// parallel: rows are counted, entries scattered to their row and every row
+// sorted by column, with duplicates summed in file order. Matrices stored as
+// one triangle (symmetric, skew-symmetric, hermitian) are expanded to both.
+//
+// Fields real, integer, complex and pattern are supported. Values are
+// doubles, two per nonzero (real, imaginary) for complex matrices; pattern
+// matrices get ones.
+//
+// The CSR arrays are written to a sidecar file (path + ".csr" by default)
+// that records the size and modification time of the source. Later loads of
+// an unchanged source map the sidecar and use its arrays in place, without
+// parsing. Indices are 32-bit and 0-based.
+#include <utils/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace MtxReader {
+enum class Field : uint32_t { kReal, kInteger, kComplex, kPattern };
+enum class Symmetry : uint32_t {
+  kGeneral,
+  kSymmetric,
+  kSkewSymmetric,
+  kHermitian
+};
+
+inline const char *field_name(Field field) {
+  switch (field) {
+    case Field::kReal: return "real";
+    case Field::kInteger: return "integer";
+    case Field::kComplex: return "complex";
+    case Field::kPattern: return "pattern";
+  }
+  return "unknown";
+}
+
+inline const char *symmetry_name(Symmetry symmetry) {
+  switch (symmetry) {
+    case Symmetry::kGeneral: return "general";
+    case Symmetry::kSymmetric: return "symmetric";
+    case Symmetry::kSkewSymmetric: return "skew-symmetric";
+    case Symmetry::kHermitian: return "hermitian";
+  }
+  return "unknown";
+}
+
+struct Options {
+  size_t num_threads = 0;  // 0: one per hardware thread
+  bool use_cache = true;   // read and write the sidecar
+  std::string cache_path;  // empty: path + ".csr"
+};
+
+// Read-only view of a whole file: a mapping on POSIX, an owned buffer on
+// Windows
+class MappedFile {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+      close();
+      data_ = other.data_;
+      size_ = other.size_;
+      buffer_.swap(other.buffer_);
+      other.data_ = nullptr;
+      other.size_ = 0;
+    }
+    return *this;
+  }
+  ~MappedFile() { close(); }
+
+  // Returns false if the file cannot be opened, is empty or is not regular
+  bool open(const std::string &name) {
+    close();
+#ifdef _WIN32
+    std::ifstream input(name, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!input.is_open()) return false;
+    std::streamsize file_size = input.tellg();
+    if (file_size <= 0) return false;
+    buffer_.resize(file_size);
+    input.seekg(0);
+    if (!input.read(reinterpret_cast<char *>(buffer_.data()), file_size)) {
+      return false;
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+#else
+    int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0) {
+      ::close(fd);
+      return false;
+    }
+    size_t file_size = info.st_size;
+    void *mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+    madvise(mapping, file_size, MADV_WILLNEED);
+    data_ = static_cast<const unsigned char *>(mapping);
+    size_ = file_size;
+    return true;
+#endif
+  }
+
+  void close() {
+#ifndef _WIN32
+    if (data_) munmap(const_cast<unsigned char *>(data_), size_);
+#endif
+    std::vector<unsigned char>().swap(buffer_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  const unsigned char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const unsigned char *data_ = nullptr;
+  size_t size_ = 0;
+  std::vector<unsigned char> buffer_;
+};
+
+// CSR matrix, either owning its arrays or pointing into a mapped sidecar
+class Matrix {
+ public:
+  int32_t num_rows() const { return num_rows_; }
+  int32_t num_cols() const { return num_cols_; }
+  int32_t nnz() const { return nnz_; }
+  // Of the file: a symmetric file gives a CSR matrix with both triangles
+  Field field() const { return field_; }
+  Symmetry symmetry() const { return symmetry_; }
+  // 1 or 2 (complex) doubles per nonzero
+  int value_size() const { return field_ == Field::kComplex ? 2 : 1; }
+  bool from_cache() const { return cache_.data() != nullptr; }
+
+  const int32_t *row_offsets() const { return row_offsets_; }  // num_rows + 1
+  const int32_t *columns() const { return columns_; }          // nnz
+  const double *values() const { return values_; }  // nnz * value_size()
+
+ private:
+  friend class Builder;
+  friend bool read_cache(const std::string &, const struct stat &, Matrix &);
+
+  void point_to_storage() {
+    row_offsets_ = row_offsets_storage_.data();
+    columns_ = columns_storage_.data();
+    values_ = values_storage_.data();
+  }
+
+  int32_t num_rows_ = 0;
+  int32_t num_cols_ = 0;
+  int32_t nnz_ = 0;
+  Field field_ = Field::kReal;
+  Symmetry symmetry_ = Symmetry::kGeneral;
+  const int32_t *row_offsets_ = nullptr;
+  const int32_t *columns_ = nullptr;
+  const double *values_ = nullptr;
+  std::vector<int32_t> row_offsets_storage_;
+  std::vector<int32_t> columns_storage_;
+  std::vector<double> values_storage_;
+  MappedFile cache_;
+};
+
+// Sidecar layout: CacheHeader, row offsets, columns and values, each array
+// starting at a multiple of 8 bytes
+struct CacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t source_size;
+  int64_t source_mtime;  // ns
+  int64_t num_rows;
+  int64_t num_cols;
+  int64_t nnz;
+  uint32_t field;
+  uint32_t symmetry;
+  uint64_t reserved[2];
+};
+
+static_assert(sizeof(CacheHeader) == 80, "CacheHeader is part of the file format");
+
+const char kCacheMagic[8] = {'M', 'T', 'X', 'C', 'S', 'R', '\0', '\0'};
+const uint32_t kCacheVersion = 1;
+
+namespace Kernel {
+inline size_t align8(size_t bytes) { return (bytes + 7) & ~size_t(7); }
+
+inline int64_t mtime_ns(const struct stat &info) {
+#if defined(__linux__)
+  return int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+  return int64_t(info.st_mtimespec.tv_sec) * 1000000000 +
+         info.st_mtimespec.tv_nsec;
+#else
+  return int64_t(info.st_mtime) * 1000000000;
+#endif
+}
+
+// Byte offsets of the arrays in a sidecar
+struct CacheLayout {
+  size_t columns;
+  size_t values;
+  size_t size;
+};
+
+inline CacheLayout cache_layout(int64_t num_rows, int64_t nnz, int value_size) {
+  CacheLayout layout;
+  layout.columns = align8(sizeof(CacheHeader) + (num_rows + 1) * sizeof(int32_t));
+  layout.values = align8(layout.columns + nnz * sizeof(int32_t));
+  layout.size = layout.values + nnz * value_size * sizeof(double);
+  return layout;
+}
+
+inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// First character of the next entry line at or after p, or end. Entry lines
+// are the lines that are neither empty nor comments.
+inline const char *next_entry(const char *p, const char *end) {
+  while (p < end) {
+    while (p < end && is_blank(*p)) p++;
+    if (p == end) return end;
+    if (*p != '\n' && *p != '%') return p;
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    p = eol ? eol + 1 : end;
+  }
+  return end;
+}
+
+inline const char *line_end(const char *p, const char *end) {
+  const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+  return eol ? eol : end;
+}
+
+// Unsigned decimal integer of at most 18 digits; advances p past it
+inline bool parse_index(const char *&p, const char *end, int64_t &value) {
+  while (p < end && is_blank(*p)) p++;
+  if (p < end && *p == '+') p++;
+  const char *first = p;
+  int64_t result = 0;
+  while (p < end && *p >= '0' && *p <= '9' && p - first < 18) {
+    result = result * 10 + (*p - '0');
+    p++;
+  }
+  if (p == first || (p < end && !is_blank(*p) && *p != '\n')) return false;
+  value = result;
+  return true;
+}
+
+// Floating-point token; advances p past it. std::from_chars is used where the
+// library has it for doubles; strtod needs a terminator, which the file has
+// unless the token ends the file.
+inline bool parse_value(const char *&p, const char *end, double &value) {
+  while (p < end && is_blank(*p)) p++;
+  const char *first = p;
+  while (p < end && !is_blank(*p) && *p != '\n') p++;
+  size_t length = p - first;
+  if (length == 0) return false;
+#ifdef __cpp_lib_to_chars
+  // from_chars does not take a leading plus sign
+  if (*first == '+' && length > 1 && first[1] != '-') first++;
+  std::from_chars_result result = std::from_chars(first, p, value);
+  return result.ec == std::errc() && result.ptr == p;
+#else
+  char *stop;
+  if (p < end) {
+    value = strtod(first, &stop);
+    return stop == p;
+  }
+  char token[64];
+  if (length >= sizeof(token)) return false;
+  memcpy(token, first, length);
+  token[length] = '\0';
+  value = strtod(token, &stop);
+  return stop == token + length;
+#endif
+}
+
+inline bool parse_integer_value(const char *&p, const char *end, double &value) {
+  while (p < end && is_blank(*p)) p++;
+  bool negative = p < end && *p == '-';
+  if (negative) p++;
+  int64_t magnitude;
+  if (p == end || is_blank(*p) || !parse_index(p, end, magnitude)) return false;
+  value = negative ? -double(magnitude) : double(magnitude);
+  return true;
+}
+
+inline std::string lowercase(std::string text) {
+  for (char &c : text) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  return text;
+}
+
+template <class F>
+void parallel_for(ThreadPool &pool, size_t count, F &&f) {
+  if (count == 0) return;
+  pool.enqueue_batch(count, [&](int, size_t idx) { f(idx); });
+  pool.wait();
+}
+
+// Banner and size line of a coordinate Matrix Market file
+struct Header {
+  Field field;
+  Symmetry symmetry;
+  int64_t num_rows;
+  int64_t num_cols;
+  int64_t num_entries;
+  size_t data_offset;  // first byte after the size line
+};
+
+inline Header parse_header(const char *data, size_t size,
+                           const std::string &path) {
+  const char *end = data + size;
+  const char *eol = line_end(data, end);
+  std::vector<std::string> words;
+  for (const char *p = data; p < eol;) {
+    while (p < eol && is_blank(*p)) p++;
+    const char *first = p;
+    while (p < eol && !is_blank(*p)) p++;
+    if (p > first) words.emplace_back(first, p);
+  }
+  if (words.size() < 5 || lowercase(words[0]) != "%%matrixmarket") {
+    throw std::runtime_error(path + ": not a Matrix Market file");
+  }
+  if (lowercase(words[1]) != "matrix" || lowercase(words[2]) != "coordinate") {
+    throw std::runtime_error(path + ": only coordinate matrices are supported");
+  }
+  Header header;
+  std::string field = lowercase(words[3]);
+  if (field == "real" || field == "double") {
+    header.field = Field::kReal;
+  } else if (field == "integer") {
+    header.field = Field::kInteger;
+  } else if (field == "complex") {
+    header.field = Field::kComplex;
+  } else if (field == "pattern") {
+    header.field = Field::kPattern;
+  } else {
+    throw std::runtime_error(path + ": unknown field " + words[3]);
+  }
+  std::string symmetry = lowercase(words[4]);
+  if (symmetry == "general") {
+    header.symmetry = Symmetry::kGeneral;
+  } else if (symmetry == "symmetric") {
+    header.symmetry = Symmetry::kSymmetric;
+  } else if (symmetry == "skew-symmetric") {
+    header.symmetry = Symmetry::kSkewSymmetric;
+  } else if (symmetry == "hermitian") {
+    header.symmetry = Symmetry::kHermitian;
+  } else {
+    throw std::runtime_error(path + ": unknown symmetry " + words[4]);
+  }
+  const char *p = next_entry(eol, end);
+  const char *size_end = line_end(p, end);
+  if (p == end || !parse_index(p, size_end, header.num_rows) ||
+      !parse_index(p, size_end, header.num_cols) ||
+      !parse_index(p, size_end, header.num_entries)) {
+    throw std::runtime_error(path + ": invalid size line");
+  }
+  const int64_t kMaxIndex = std::numeric_limits<int32_t>::max();
+  if (header.num_rows > kMaxIndex || header.num_cols > kMaxIndex ||
+      header.num_entries > kMaxIndex) {
+    throw std::runtime_error(path + ": too large for 32-bit indices");
+  }
+  if (header.symmetry != Symmetry::kGeneral &&
+      header.num_rows != header.num_cols) {
+    throw std::runtime_error(path + ": " + words[4] + " matrix is not square");
+  }
+  header.data_offset = size_end - data;
+  return header;
+}
+}  // namespace Kernel
+
+// COO entries of the file, 0-based, in file order
+struct Coordinates {
+  std::vector<int32_t> rows;
+  std::vector<int32_t> columns;
+  std::vector<double> values;  // empty for pattern matrices
+};
+
+// Parses the entries of a mapped file into coo, in parallel over chunks
+inline void parse_entries(const char *data, size_t size,
+                          const Kernel::Header &header, const std::string &path,
+                          ThreadPool &pool, Coordinates &coo) {
+  const char *begin = data + header.data_offset;
+  const char *end = data + size;
+  // Chunk boundaries at line starts
+  const size_t kMinChunkBytes = size_t(1) << 16;
+  size_t num_chunks = std::min<size_t>(
+      pool.size() * 8, (end - begin) / kMinChunkBytes + 1);
+  std::vector<const char *> cuts(num_chunks + 1);
+  cuts[0] = begin;
+  cuts[num_chunks] = end;
+  for (size_t k = 1; k < num_chunks; k++) {
+    const char *p = begin + (end - begin) * k / num_chunks;
+    if (p[-1] != '\n') {
+      const char *eol = Kernel::line_end(p, end);
+      p = eol == end ? end : eol + 1;
+    }
+    cuts[k] = std::max(p, cuts[k - 1]);
+  }
+
+  std::vector<int64_t> first_entry(num_chunks + 1, 0);
+  Kernel::parallel_for(pool, num_chunks, [&](size_t k) {
+    int64_t count = 0;
+    for (const char *p = Kernel::next_entry(cuts[k], cuts[k + 1]);
+         p < cuts[k + 1];
+         p = Kernel::next_entry(Kernel::line_end(p, end), cuts[k + 1])) {
+      count++;
+    }
+    first_entry[k + 1] = count;
+  });
+  for (size_t k = 0; k < num_chunks; k++) first_entry[k + 1] += first_entry[k];
+  if (first_entry[num_chunks] != header.num_entries) {
+    throw std::runtime_error(path + ": expected " +
+                             std::to_string(header.num_entries) +
+                             " entries, found " +
+                             std::to_string(first_entry[num_chunks]));
+  }
+
+  const int value_size = header.field == Field::kComplex ? 2 : 1;
+  coo.rows.resize(header.num_entries);
+  coo.columns.resize(header.num_entries);
+  coo.values.resize(header.field == Field::kPattern
+                        ? 0
+                        : header.num_entries * value_size);
+  // Position of the first invalid line of every chunk, if any
+  std::vector<const char *> errors(num_chunks, nullptr);
+  Kernel::parallel_for(pool, num_chunks, [&](size_t k) {
+    int64_t entry = first_entry[k];
+    for (const char *p = Kernel::next_entry(cuts[k], cuts[k + 1]);
+         p < cuts[k + 1]; entry++) {
+      const char *line = p;
+      const char *eol = Kernel::line_end(p, end);
+      int64_t row = 0, col = 0;
+      bool ok = Kernel::parse_index(p, eol, row) &&
+                Kernel::parse_index(p, eol, col) && row >= 1 &&
+                row <= header.num_rows && col >= 1 && col <= header.num_cols;
+      double *value = ok && header.field != Field::kPattern
+                          ? &coo.values[entry * value_size]
+                          : nullptr;
+      switch (header.field) {
+        case Field::kReal:
+          ok = ok && Kernel::parse_value(p, eol, value[0]);
+          break;
+        case Field::kInteger:
+          ok = ok && Kernel::parse_integer_value(p, eol, value[0]);
+          break;
+        case Field::kComplex:
+          ok = ok && Kernel::parse_value(p, eol, value[0]) &&
+               Kernel::parse_value(p, eol, value[1]);
+          break;
+        case Field::kPattern:
+          break;
+      }
+      while (p < eol && Kernel::is_blank(*p)) p++;
+      if (!ok || p != eol) {
+        errors[k] = line;
+        return;
+      }
+      coo.rows[entry] = static_cast<int32_t>(row - 1);
+      coo.columns[entry] = static_cast<int32_t>(col - 1);
+      p = Kernel::next_entry(eol, cuts[k + 1]);
+    }
+  });
+  for (const char *error : errors) {
+    if (error) {
+      size_t line = 1 + std::count(data, error, '\n');
+      throw std::runtime_error(path + ":" + std::to_string(line) +
+                               ": invalid entry");
+    }
+  }
+}
+
+// Builds the CSR arrays of matrix from coo, expanding the stored triangle of
+// symmetric storage and summing duplicates. coo is released on the way.
+//
+// Entries are bucketed by blocks of consecutive rows: every task counts, then
+// scatters, its slice of the entries into the blocks, with their values, in
+// task order so that the result does not depend on scheduling. Each block is
+// then sorted and merged on its own, within a range small enough to stay in
+// cache, and finally copied to the CSR arrays.
+class Builder {
+ public:
+  static void build(Coordinates &coo, const Kernel::Header &header,
+                    ThreadPool &pool, Matrix &matrix) {
+    const int64_t num_rows = header.num_rows;
+    const int value_size = header.field == Field::kComplex ? 2 : 1;
+    const bool has_values = header.field != Field::kPattern;
+    const size_t num_tasks = pool.size() * 4;
+    const int64_t kMaxBlocks = 1024;
+    int block_shift = 0;
+    while ((num_rows >> block_shift) >= kMaxBlocks) block_shift++;
+    const int64_t num_blocks = (num_rows >> block_shift) + 1;
+
+    std::vector<int64_t> offsets(num_tasks * num_blocks, 0);
+    Kernel::parallel_for(pool, num_tasks, [&](size_t task) {
+      int64_t *counts = &offsets[task * num_blocks];
+      for_each_entry(coo, header.symmetry, task, num_tasks,
+                     [&](int32_t row, int32_t, int64_t, bool) {
+                       counts[row >> block_shift]++;
+                     });
+    });
+    std::vector<int64_t> block_start(num_blocks + 1, 0);
+    for (int64_t block = 0; block < num_blocks; block++) {
+      int64_t total = block_start[block];
+      for (size_t task = 0; task < num_tasks; task++) {
+        int64_t count = offsets[task * num_blocks + block];
+        offsets[task * num_blocks + block] = total;
+        total += count;
+      }
+      block_start[block + 1] = total;
+    }
+    const int64_t num_keys = block_start[num_blocks];
+
+    std::vector<int32_t> rows(num_keys);
+    std::vector<int32_t> columns(num_keys);
+    std::vector<double> values(has_values ? num_keys * value_size : 0);
+    Kernel::parallel_for(pool, num_tasks, [&](size_t task) {
+      int64_t *cursor = &offsets[task * num_blocks];
+      for_each_entry(
+          coo, header.symmetry, task, num_tasks,
+          [&](int32_t row, int32_t col, int64_t entry, bool mirrored) {
+            int64_t pos = cursor[row >> block_shift]++;
+            rows[pos] = row;
+            columns[pos] = col;
+            if (!has_values) return;
+            const double *source = &coo.values[entry * value_size];
+            double *value = &values[pos * value_size];
+            value[0] = source[0];
+            if (value_size == 2) value[1] = source[1];
+            if (mirrored && header.symmetry == Symmetry::kSkewSymmetric) {
+              for (int v = 0; v < value_size; v++) value[v] = -value[v];
+            } else if (mirrored && header.symmetry == Symmetry::kHermitian &&
+                       value_size == 2) {
+              value[1] = -value[1];
+            }
+          });
+    });
+    coo = Coordinates();
+
+    // Sort every block by row with a counting sort, then every row by
+    // (column, position), which keeps duplicates in file order. The merged
+    // rows are written back to the front of their range.
+    std::vector<int64_t> row_start(num_rows + 1, 0);
+    std::vector<int64_t> distinct(num_rows + 1, 0);
+    Kernel::parallel_for(pool, num_blocks, [&](size_t block) {
+      const int64_t first_row = int64_t(block) << block_shift;
+      const int64_t last_row =
+          std::min(first_row + (int64_t(1) << block_shift), num_rows);
+      const int64_t first = block_start[block];
+      const int64_t last = block_start[block + 1];
+      if (first_row >= last_row) return;
+      std::vector<int64_t> cursor(last_row - first_row + 1, 0);
+      for (int64_t idx = first; idx < last; idx++) {
+        cursor[rows[idx] - first_row + 1]++;
+      }
+      for (int64_t row = first_row; row < last_row; row++) {
+        cursor[row - first_row + 1] += cursor[row - first_row];
+        row_start[row] = first + cursor[row - first_row];
+      }
+      std::vector<uint64_t> keys(last - first);
+      std::vector<double> sorted(has_values ? (last - first) * value_size : 0);
+      for (int64_t idx = first; idx < last; idx++) {
+        int64_t pos = cursor[rows[idx] - first_row]++;
+        keys[pos] = uint64_t(columns[idx]) << 32 | uint64_t(pos);
+        for (int v = 0; v < value_size && has_values; v++) {
+          sorted[pos * value_size + v] = values[idx * value_size + v];
+        }
+      }
+      int64_t begin = 0;
+      for (int64_t row = first_row; row < last_row; row++) {
+        const int64_t end = cursor[row - first_row];
+        std::sort(keys.begin() + begin, keys.begin() + end);
+        int64_t out = row_start[row] - 1;
+        for (int64_t idx = begin; idx < end; idx++) {
+          int32_t col = static_cast<int32_t>(keys[idx] >> 32);
+          if (idx == begin || col != columns[out]) {
+            out++;
+            columns[out] = col;
+            for (int v = 0; v < value_size && has_values; v++) {
+              values[out * value_size + v] = 0.0;
+            }
+          }
+          if (!has_values) continue;
+          const double *source =
+              sorted.data() + (keys[idx] & 0xffffffffu) * value_size;
+          for (int v = 0; v < value_size; v++) {
+            values[out * value_size + v] += source[v];
+          }
+        }
+        distinct[row + 1] = out + 1 - row_start[row];
+        begin = end;
+      }
+    });
+    std::vector<int32_t>().swap(rows);
+    for (int64_t row = 0; row < num_rows; row++) {
+      distinct[row + 1] += distinct[row];
+    }
+    if (distinct[num_rows] > std::numeric_limits<int32_t>::max()) {
+      throw std::runtime_error("too many nonzeros for 32-bit indices");
+    }
+
+    const int64_t nnz = distinct[num_rows];
+    matrix.row_offsets_storage_.resize(num_rows + 1);
+    matrix.columns_storage_.resize(nnz);
+    // Duplicates of a pattern matrix are a single nonzero
+    matrix.values_storage_.assign(nnz * value_size, 1.0);
+    Kernel::parallel_for(pool, num_blocks, [&](size_t block) {
+      const int64_t first_row = int64_t(block) << block_shift;
+      const int64_t last_row =
+          std::min(first_row + (int64_t(1) << block_shift), num_rows);
+      for (int64_t row = first_row; row < last_row; row++) {
+        const int64_t count = distinct[row + 1] - distinct[row];
+        matrix.row_offsets_storage_[row] = static_cast<int32_t>(distinct[row]);
+        std::copy(columns.begin() + row_start[row],
+                  columns.begin() + row_start[row] + count,
+                  matrix.columns_storage_.begin() + distinct[row]);
+        if (!has_values) continue;
+        std::copy(values.begin() + row_start[row] * value_size,
+                  values.begin() + (row_start[row] + count) * value_size,
+                  matrix.values_storage_.begin() + distinct[row] * value_size);
+      }
+    });
+    matrix.row_offsets_storage_[num_rows] = static_cast<int32_t>(nnz);
+    matrix.num_rows_ = static_cast<int32_t>(num_rows);
+    matrix.num_cols_ = static_cast<int32_t>(header.num_cols);
+    matrix.nnz_ = static_cast<int32_t>(nnz);
+    matrix.field_ = header.field;
+    matrix.symmetry_ = header.symmetry;
+    matrix.point_to_storage();
+  }
+
+ private:
+  // Calls f(row, column, entry, mirrored) for the entries of a task, in file
+  // order, mirrors included
+  template <class F>
+  static void for_each_entry(const Coordinates &coo, Symmetry symmetry,
+                             size_t task, size_t num_tasks, F &&f) {
+    const int64_t num_entries = coo.rows.size();
+    const int64_t first = num_entries * task / num_tasks;
+    const int64_t last = num_entries * (task + 1) / num_tasks;
+    for (int64_t idx = first; idx < last; idx++) {
+      int32_t row = coo.rows[idx];
+      int32_t col = coo.columns[idx];
+      f(row, col, idx, false);
+      if (symmetry != Symmetry::kGeneral && row != col) f(col, row, idx, true);
+    }
+  }
+};
+
+// Maps the sidecar of a source with the given stat into matrix. Returns false
+// if it is missing, stale or invalid.
+inline bool read_cache(const std::string &cache_path, const struct stat &source,
+                       Matrix &matrix) {
+  MappedFile file;
+  if (!file.open(cache_path) || file.size() < sizeof(CacheHeader)) return false;
+  CacheHeader header;
+  memcpy(&header, file.data(), sizeof(header));
+  if (memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 ||
+      header.version != kCacheVersion ||
+      header.header_size != sizeof(CacheHeader) ||
+      header.source_size != uint64_t(source.st_size) ||
+      header.source_mtime != Kernel::mtime_ns(source) ||
+      header.field > uint32_t(Field::kPattern) ||
+      header.symmetry > uint32_t(Symmetry::kHermitian) || header.num_rows < 0 ||
+      header.num_cols < 0 || header.nnz < 0 ||
+      header.num_rows > std::numeric_limits<int32_t>::max() ||
+      header.num_cols > std::numeric_limits<int32_t>::max() ||
+      header.nnz > std::numeric_limits<int32_t>::max()) {
+    return false;
+  }
+  int value_size = header.field == uint32_t(Field::kComplex) ? 2 : 1;
+  Kernel::CacheLayout layout =
+      Kernel::cache_layout(header.num_rows, header.nnz, value_size);
+  if (file.size() != layout.size) return false;
+  const unsigned char *data = file.data();
+  const int32_t *row_offsets =
+      reinterpret_cast<const int32_t *>(data + sizeof(CacheHeader));
+  if (row_offsets[0] != 0 || row_offsets[header.num_rows] != header.nnz) {
+    return false;
+  }
+  // A corrupt sidecar must not index out of range later
+  for (int64_t row = 0; row < header.num_rows; row++) {
+    if (row_offsets[row + 1] < row_offsets[row]) return false;
+  }
+  const int32_t *columns =
+      reinterpret_cast<const int32_t *>(data + layout.columns);
+  for (int64_t idx = 0; idx < header.nnz; idx++) {
+    if (columns[idx] < 0 || columns[idx] >= header.num_cols) return false;
+  }
+  matrix.num_rows_ = static_cast<int32_t>(header.num_rows);
+  matrix.num_cols_ = static_cast<int32_t>(header.num_cols);
+  matrix.nnz_ = static_cast<int32_t>(header.nnz);
+  matrix.field_ = static_cast<Field>(header.field);
+  matrix.symmetry_ = static_cast<Symmetry>(header.symmetry);
+  matrix.row_offsets_ = row_offsets;
+  matrix.columns_ = columns;
+  matrix.values_ = reinterpret_cast<const double *>(data + layout.values);
+  matrix.cache_ = std::move(file);
+  return true;
+}
+
+// Writes a temporary file renamed over cache_path, so that readers never see
+// a partial sidecar. Returns false on failure, leaving no file behind.
+inline bool write_cache(const std::string &cache_path, const struct stat &source,
+                        const Matrix &matrix) {
+#ifdef _WIN32
+  std::string tmp_path = cache_path + ".tmp." + std::to_string(_getpid());
+#else
+  std::string tmp_path = cache_path + ".tmp." + std::to_string(getpid());
+#endif
+  FILE *file = fopen(tmp_path.c_str(), "wb");
+  if (!file) return false;
+  CacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+  header.version = kCacheVersion;
+  header.header_size = sizeof(CacheHeader);
+  header.source_size = source.st_size;
+  header.source_mtime = Kernel::mtime_ns(source);
+  header.num_rows = matrix.num_rows();
+  header.num_cols = matrix.num_cols();
+  header.nnz = matrix.nnz();
+  header.field = uint32_t(matrix.field());
+  header.symmetry = uint32_t(matrix.symmetry());
+  Kernel::CacheLayout layout =
+      Kernel::cache_layout(matrix.num_rows(), matrix.nnz(), matrix.value_size());
+  const char padding[8] = {};
+  size_t offsets_bytes = (size_t(matrix.num_rows()) + 1) * sizeof(int32_t);
+  size_t columns_bytes = size_t(matrix.nnz()) * sizeof(int32_t);
+  size_t values_bytes =
+      size_t(matrix.nnz()) * matrix.value_size() * sizeof(double);
+  auto write = [&](const void *data, size_t bytes) {
+    return bytes == 0 || fwrite(data, 1, bytes, file) == bytes;
+  };
+  bool ok =
+      write(&header, sizeof(header)) &&
+      write(matrix.row_offsets(), offsets_bytes) &&
+      write(padding, layout.columns - sizeof(header) - offsets_bytes) &&
+      write(matrix.columns(), columns_bytes) &&
+      write(padding, layout.values - layout.columns - columns_bytes) &&
+      write(matrix.values(), values_bytes);
+  ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+  // rename does not replace existing files on Windows
+  if (ok) remove(cache_path.c_str());
+#endif
+  ok = ok && rename(tmp_path.c_str(), cache_path.c_str()) == 0;
+  if (!ok) remove(tmp_path.c_str());
+  return ok;
+}
+
+// Loads the matrix at path, from its sidecar when that is up to date. Throws
+// std::runtime_error if the file cannot be read or is not a valid coordinate
+// Matrix Market file. A sidecar that cannot be written is skipped silently.
+inline Matrix load(const std::string &path, const Options &options = Options()) {
+  struct stat source;
+  if (stat(path.c_str(), &source) != 0) {
+    throw std::runtime_error(path + ": unable to open the file");
+  }
+  std::string cache_path =
+      options.cache_path.empty() ? path + ".csr" : options.cache_path;
+  Matrix matrix;
+  if (options.use_cache && read_cache(cache_path, source, matrix)) {
+    return matrix;
+  }
+
+  MappedFile file;
+  if (!file.open(path)) {
+    throw std::runtime_error(path + ": unable to open the file");
+  }
+  const char *data = reinterpret_cast<const char *>(file.data());
+  Kernel::Header header = Kernel::parse_header(data, file.size(), path);
+  size_t num_threads = options.num_threads;
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  ThreadPool pool(num_threads);
+  {
+    Coordinates coo;
+    parse_entries(data, file.size(), header, path, pool, coo);
+    file.close();
+    Builder::build(coo, header, pool, matrix);
+  }
+  if (options.use_cache) write_cache(cache_path, source, matrix);
+  return matrix;
+}
+}  // namespace MtxReader
@@ -0,0 +1,197 @@
+#pragma once
+// Host-side 2D tiling of a CSR matrix. Host-only, no cusp dependency.
+//
+// The matrix is cut into a grid of row strips and column strips. Each row
+// strip is tiled by one task in a single sweep over its rows: a count pass
+// builds the row offsets of every tile of the strip, a fill pass scatters the
+// column indices and values. Every nonzero is visited twice in total,
+// independent of the number of tiles.
+//
+// Cut points are either uniform (every tile has the same shape) or balanced
+// by nnz: row cuts split the row nnz prefix sum evenly and column cuts split
+// the column histogram evenly, so that each tile gets roughly the same work
+// when the nonzeros are not concentrated in a few tiles.
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace PartitionCSR {
+struct Cuts {
+  // Tile (i, j) covers rows [row_cuts[i], row_cuts[i + 1]) and columns
+  // [col_cuts[j], col_cuts[j + 1])
+  std::vector<int> row_cuts;
+  std::vector<int> col_cuts;
+};
+
+template <typename IndexType, typename ValueType>
+struct Tile {
+  int row_begin;
+  int row_end;
+  int col_begin;
+  int col_end;
+  // Column indices are relative to col_begin
+  std::vector<IndexType> row_offsets;
+  std::vector<IndexType> column_indices;
+  std::vector<ValueType> values;
+};
+
+// Runs func(task) for task in [0, num_tasks) on up to hardware_concurrency
+// threads
+template <typename TaskFunc>
+void parallel_for(int num_tasks, TaskFunc &&func) {
+  int num_threads = std::min<int>(
+      num_tasks, std::max(1u, std::thread::hardware_concurrency()));
+  if (num_threads <= 1) {
+    for (int task = 0; task < num_tasks; task++) func(task);
+    return;
+  }
+  std::atomic<int> next_task(0);
+  std::vector<std::thread> workers;
+  for (int idx = 0; idx < num_threads; idx++) {
+    workers.emplace_back([&]() {
+      for (int task = next_task++; task < num_tasks; task = next_task++) {
+        func(task);
+      }
+    });
+  }
+  for (auto &worker : workers) worker.join();
+}
+
+std::vector<int> get_uniform_cuts(int extent, int num_tiles) {
+  std::vector<int> cuts(num_tiles + 1);
+  for (int idx = 0; idx <= num_tiles; idx++) {
+    cuts[idx] = static_cast<int>(static_cast<long long>(extent) * idx /
+                                 num_tiles);
+  }
+  return cuts;
+}
+
+// Cuts [0, prefix.size() - 1) into num_tiles non-empty ranges so that the
+// weight of each range, prefix[end] - prefix[begin], is as close as possible
+// to total / num_tiles. num_tiles is clamped to [1, extent], so asking for
+// more tiles than rows or columns gives one range per row or column; the
+// number of ranges is cuts.size() - 1.
+template <typename PrefixType>
+std::vector<int> get_balanced_cuts(const std::vector<PrefixType> &prefix,
+                                   int num_tiles) {
+  int extent = static_cast<int>(prefix.size()) - 1;
+  if (extent < 1) throw std::invalid_argument("empty prefix sum");
+  num_tiles = std::min(std::max(num_tiles, 1), extent);
+  std::vector<int> cuts(num_tiles + 1);
+  cuts[0] = 0;
+  cuts[num_tiles] = extent;
+  double total = static_cast<double>(prefix.back());
+  for (int idx = 1; idx < num_tiles; idx++) {
+    double target = total * idx / num_tiles;
+    int cut = std::lower_bound(prefix.begin(), prefix.end(), target) -
+              prefix.begin();
+    // Keep every range non-empty and leave room for the remaining ranges
+    cuts[idx] = std::min(std::max(cut, cuts[idx - 1] + 1),
+                         extent - (num_tiles - idx));
+  }
+  return cuts;
+}
+
+template <typename IndexType>
+Cuts get_balanced_cuts(int num_rows, int num_cols,
+                       const IndexType *row_offsets,
+                       const IndexType *column_indices, int num_row_tiles,
+                       int num_col_tiles) {
+  std::vector<long long> row_prefix(row_offsets, row_offsets + num_rows + 1);
+  // Per-thread column histograms would cost num_threads * num_cols memory;
+  // a single pass is cheap compared with the tiling itself
+  std::vector<long long> col_prefix(num_cols + 1, 0);
+  for (IndexType idx = row_offsets[0]; idx < row_offsets[num_rows]; idx++) {
+    col_prefix[column_indices[idx] + 1]++;
+  }
+  for (int col = 0; col < num_cols; col++) {
+    col_prefix[col + 1] += col_prefix[col];
+  }
+  return Cuts{.row_cuts = get_balanced_cuts(row_prefix, num_row_tiles),
+              .col_cuts = get_balanced_cuts(col_prefix, num_col_tiles)};
+}
+
+// Splits the CSR matrix into (row_cuts.size() - 1) x (col_cuts.size() - 1)
+// tiles. Tiles are returned in column-major tile order, i.e., tile (i, j) is
+// at index i + j * num_row_tiles.
+template <typename IndexType, typename ValueType>
+std::vector<Tile<IndexType, ValueType>> partition(
+    int num_rows, int num_cols, const IndexType *row_offsets,
+    const IndexType *column_indices, const ValueType *values,
+    const Cuts &cuts) {
+  int num_row_tiles = static_cast<int>(cuts.row_cuts.size()) - 1;
+  int num_col_tiles = static_cast<int>(cuts.col_cuts.size()) - 1;
+  if (num_row_tiles < 1 || num_col_tiles < 1 ||
+      cuts.row_cuts.back() != num_rows || cuts.col_cuts.back() != num_cols) {
+    throw std::invalid_argument("cuts do not cover the matrix");
+  }
+  // Column strip of every column, so that each nonzero is binned in O(1)
+  std::vector<int> col_tile(num_cols);
+  for (int tile = 0; tile < num_col_tiles; tile++) {
+    std::fill(col_tile.begin() + cuts.col_cuts[tile],
+              col_tile.begin() + cuts.col_cuts[tile + 1], tile);
+  }
+
+  std::vector<Tile<IndexType, ValueType>> tiles(num_row_tiles * num_col_tiles);
+  parallel_for(num_row_tiles, [&](int row_tile) {
+    int row_begin = cuts.row_cuts[row_tile];
+    int row_end = cuts.row_cuts[row_tile + 1];
+    auto get_tile = [&](int col_tile_idx) -> Tile<IndexType, ValueType> & {
+      return tiles[row_tile + col_tile_idx * num_row_tiles];
+    };
+    for (int col_tile_idx = 0; col_tile_idx < num_col_tiles; col_tile_idx++) {
+      auto &tile = get_tile(col_tile_idx);
+      tile.row_begin = row_begin;
+      tile.row_end = row_end;
+      tile.col_begin = cuts.col_cuts[col_tile_idx];
+      tile.col_end = cuts.col_cuts[col_tile_idx + 1];
+      tile.row_offsets.assign(row_end - row_begin + 1, 0);
+    }
+    // Count pass: row_offsets[r + 1] holds the nnz of local row r
+    for (int row = row_begin; row < row_end; row++) {
+      for (IndexType idx = row_offsets[row]; idx < row_offsets[row + 1];
+           idx++) {
+        get_tile(col_tile[column_indices[idx]])
+            .row_offsets[row - row_begin + 1]++;
+      }
+    }
+    for (int col_tile_idx = 0; col_tile_idx < num_col_tiles; col_tile_idx++) {
+      auto &tile = get_tile(col_tile_idx);
+      for (int row = 0; row < row_end - row_begin; row++) {
+        tile.row_offsets[row + 1] += tile.row_offsets[row];
+      }
+      tile.column_indices.resize(tile.row_offsets.back());
+      tile.values.resize(tile.row_offsets.back());
+    }
+    // Fill pass: rows are visited in order, so each tile cursor is always at
+    // the start of the current row of that tile and the column order within
+    // each row is preserved
+    std::vector<IndexType> cursor(num_col_tiles, 0);
+    for (int row = row_begin; row < row_end; row++) {
+      for (IndexType idx = row_offsets[row]; idx < row_offsets[row + 1];
+           idx++) {
+        int col_tile_idx = col_tile[column_indices[idx]];
+        auto &tile = get_tile(col_tile_idx);
+        IndexType out = cursor[col_tile_idx]++;
+        tile.column_indices[out] = column_indices[idx] - tile.col_begin;
+        tile.values[out] = values[idx];
+      }
+    }
+  });
+  return tiles;
+}
+
+// Largest tile nnz divided by the mean tile nnz; 1 is perfectly balanced
+template <typename CountType>
+double get_imbalance(const std::vector<CountType> &tile_nnz) {
+  double max_nnz = 0.0, total_nnz = 0.0;
+  for (CountType nnz : tile_nnz) {
+    max_nnz = std::max(max_nnz, static_cast<double>(nnz));
+    total_nnz += nnz;
+  }
+  if (total_nnz == 0.0) return 1.0;
+  return max_nnz * tile_nnz.size() / total_nnz;
+}
+}  // namespace PartitionCSR
@@ -0,0 +1,568 @@
+#pragma once
+// Symmetric reorderings of square CSR matrices and their effect on
+// incomplete factorizations. Host-only, no CUDA dependency.
+//
+// Orderings are computed on the pattern of A + A^T without the diagonal and
+// returned as perm[new] = old, so that the reordered matrix is A(perm, perm)
+//   rcm    reverse Cuthill-McKee from a pseudo-peripheral node of every
+//          connected component: small bandwidth and profile
+//   amd    minimum degree on the quotient graph with the approximate degrees
+//          and element absorption of AMD, without supervariables: low fill
+//   color  greedy distance-1 colouring, rows grouped by colour: rows of one
+//          colour do not depend on each other in a triangular solve, so the
+//          solve has at most as many levels as there are colours
+//
+// analyze() predicts the cost of a matrix in its current order: the number
+// of levels of the lower and upper triangular solves (the sequential steps
+// of a level-scheduled solve with the factors of IC0/ILU0, which keep the
+// pattern of A) and the fill, the nonzeros of a complete Cholesky factor of
+// the symmetrized pattern. row_levels() gives the level of every row, from
+// which a level-scheduled solve is built.
+#include <utils/thread_pool.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace SparseReorder {
+enum class Ordering { kNone, kRcm, kAmd, kColor };
+
+inline const char *ordering_name(Ordering ordering) {
+  switch (ordering) {
+    case Ordering::kNone: return "none";
+    case Ordering::kRcm: return "rcm";
+    case Ordering::kAmd: return "amd";
+    case Ordering::kColor: return "color";
+  }
+  return "unknown";
+}
+
+// Returns false for an unknown name
+inline bool parse_ordering(const std::string &name, Ordering &ordering) {
+  for (Ordering candidate : {Ordering::kNone, Ordering::kRcm, Ordering::kAmd,
+                             Ordering::kColor}) {
+    if (name == ordering_name(candidate)) {
+      ordering = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Adjacency lists of an undirected graph, sorted and without self loops
+struct Graph {
+  std::vector<int32_t> offsets;  // num_nodes + 1
+  std::vector<int32_t> neighbors;
+
+  int32_t num_nodes() const { return static_cast<int32_t>(offsets.size()) - 1; }
+  int32_t degree(int32_t node) const {
+    return offsets[node + 1] - offsets[node];
+  }
+};
+
+struct Stats {
+  int64_t lower_levels;  // levels of the solve with the lower triangle
+  int64_t upper_levels;  // levels of the solve with the upper triangle
+  int64_t bandwidth;     // max |row - column|
+  int64_t fill;          // nnz of the Cholesky factor, diagonal included
+};
+
+// CSR matrix with double values
+struct Csr {
+  std::vector<int32_t> row_offsets;
+  std::vector<int32_t> columns;
+  std::vector<double> values;
+};
+
+// Graph of A + A^T without the diagonal, for a num_rows x num_rows matrix
+inline Graph symmetric_graph(int32_t num_rows, const int32_t *row_offsets,
+                             const int32_t *columns) {
+  std::vector<int32_t> counts(num_rows + 1, 0);
+  for (int32_t row = 0; row < num_rows; row++) {
+    for (int32_t idx = row_offsets[row]; idx < row_offsets[row + 1]; idx++) {
+      int32_t col = columns[idx];
+      if (col < 0 || col >= num_rows) {
+        throw std::invalid_argument("column index out of range");
+      }
+      if (col == row) continue;
+      counts[row + 1]++;
+      counts[col + 1]++;
+    }
+  }
+  for (int32_t row = 0; row < num_rows; row++) counts[row + 1] += counts[row];
+  std::vector<int32_t> both(counts[num_rows]);
+  std::vector<int32_t> cursor(counts.begin(), counts.end() - 1);
+  for (int32_t row = 0; row < num_rows; row++) {
+    for (int32_t idx = row_offsets[row]; idx < row_offsets[row + 1]; idx++) {
+      int32_t col = columns[idx];
+      if (col == row) continue;
+      both[cursor[row]++] = col;
+      both[cursor[col]++] = row;
+    }
+  }
+  Graph graph;
+  graph.offsets.resize(num_rows + 1, 0);
+  graph.neighbors.reserve(both.size());
+  for (int32_t row = 0; row < num_rows; row++) {
+    auto first = both.begin() + counts[row];
+    auto last = both.begin() + counts[row + 1];
+    std::sort(first, last);
+    graph.neighbors.insert(graph.neighbors.end(), first,
+                           std::unique(first, last));
+    graph.offsets[row + 1] = static_cast<int32_t>(graph.neighbors.size());
+  }
+  return graph;
+}
+
+namespace Kernel {
+// Breadth-first level structure of the component of root, visiting the
+// neighbors of every node by increasing degree. Fills order with the nodes
+// by level and returns the number of levels. mark[node] == stamp flags the
+// visited nodes.
+inline int32_t level_structure(const Graph &graph, int32_t root,
+                               std::vector<int32_t> &mark, int32_t stamp,
+                               std::vector<int32_t> &order,
+                               std::vector<int32_t> *last_level = nullptr) {
+  order.clear();
+  order.push_back(root);
+  mark[root] = stamp;
+  int32_t num_levels = 0;
+  size_t level_begin = 0;
+  while (level_begin < order.size()) {
+    size_t level_end = order.size();
+    if (last_level) last_level->assign(order.begin() + level_begin, order.end());
+    for (size_t idx = level_begin; idx < level_end; idx++) {
+      int32_t node = order[idx];
+      size_t first = order.size();
+      for (int32_t k = graph.offsets[node]; k < graph.offsets[node + 1]; k++) {
+        int32_t next = graph.neighbors[k];
+        if (mark[next] == stamp) continue;
+        mark[next] = stamp;
+        order.push_back(next);
+      }
+      std::stable_sort(order.begin() + first, order.end(),
+                       [&](int32_t a, int32_t b) {
+                         return graph.degree(a) < graph.degree(b);
+                       });
+    }
+    level_begin = level_end;
+    num_levels++;
+  }
+  return num_levels;
+}
+}  // namespace Kernel
+
+// Reverse Cuthill-McKee. Every component starts from a pseudo-peripheral
+// node found with the George-Liu heuristic.
+inline std::vector<int32_t> rcm(const Graph &graph) {
+  const int32_t n = graph.num_nodes();
+  std::vector<int32_t> perm;
+  perm.reserve(n);
+  std::vector<int32_t> mark(n, -1);
+  std::vector<char> done(n, 0);
+  std::vector<int32_t> order, last_level;
+  int32_t stamp = 0;
+  for (int32_t start = 0; start < n; start++) {
+    if (done[start]) continue;
+    int32_t root = start;
+    int32_t eccentricity =
+        Kernel::level_structure(graph, root, mark, stamp++, order, &last_level);
+    for (;;) {
+      int32_t candidate = *std::min_element(
+          last_level.begin(), last_level.end(), [&](int32_t a, int32_t b) {
+            return graph.degree(a) < graph.degree(b);
+          });
+      std::vector<int32_t> candidate_last;
+      int32_t candidate_eccentricity = Kernel::level_structure(
+          graph, candidate, mark, stamp++, order, &candidate_last);
+      if (candidate_eccentricity <= eccentricity) break;
+      root = candidate;
+      eccentricity = candidate_eccentricity;
+      last_level.swap(candidate_last);
+    }
+    Kernel::level_structure(graph, root, mark, stamp++, order);
+    for (int32_t node : order) done[node] = 1;
+    perm.insert(perm.end(), order.begin(), order.end());
+  }
+  std::reverse(perm.begin(), perm.end());
+  return perm;
+}
+
+// Approximate minimum degree. Eliminated nodes become elements (cliques of
+// their remaining neighbors), elements adjacent to a pivot are absorbed into
+// it, and the external degree of every neighbor of the pivot is bounded as
+// in AMD: min(remaining nodes, previous degree + |Lp|, |Ai| + |Lp| +
+// sum |Le \ Lp|).
+inline std::vector<int32_t> amd(const Graph &graph) {
+  const int32_t n = graph.num_nodes();
+  enum : char { kVariable, kElement, kAbsorbed };
+  std::vector<char> status(n, kVariable);
+  std::vector<std::vector<int32_t>> variables(n);  // adjacent variables
+  std::vector<std::vector<int32_t>> elements(n);   // adjacent elements
+  std::vector<std::vector<int32_t>> members(n);    // variables of an element
+  std::vector<int64_t> degree(n);
+  for (int32_t node = 0; node < n; node++) {
+    variables[node].assign(graph.neighbors.begin() + graph.offsets[node],
+                           graph.neighbors.begin() + graph.offsets[node + 1]);
+    degree[node] = graph.degree(node);
+  }
+
+  // Doubly linked lists of the variables of every degree
+  std::vector<int32_t> head(n + 1, -1), next(n, -1), prev(n, -1);
+  auto insert = [&](int32_t node) {
+    int64_t d = degree[node];
+    next[node] = head[d];
+    prev[node] = -1;
+    if (head[d] >= 0) prev[head[d]] = node;
+    head[d] = node;
+  };
+  auto remove = [&](int32_t node) {
+    if (prev[node] >= 0) {
+      next[prev[node]] = next[node];
+    } else {
+      head[degree[node]] = next[node];
+    }
+    if (next[node] >= 0) prev[next[node]] = prev[node];
+  };
+  for (int32_t node = n - 1; node >= 0; node--) insert(node);
+
+  std::vector<int32_t> perm;
+  perm.reserve(n);
+  std::vector<int32_t> in_pivot(n, -1);  // == pivot for the members of Lp
+  std::vector<int32_t> touched(n, -1);   // == pivot once w[e] is set
+  std::vector<int64_t> w(n, 0);          // |Le \ Lp|
+  int64_t min_degree = 0;
+  for (int32_t k = 0; k < n; k++) {
+    while (head[min_degree] < 0) min_degree++;
+    const int32_t pivot = head[min_degree];
+    remove(pivot);
+    perm.push_back(pivot);
+    status[pivot] = kElement;
+
+    // Lp: variables adjacent to the pivot, directly or through an element
+    std::vector<int32_t> &lp = members[pivot];
+    in_pivot[pivot] = pivot;
+    for (int32_t node : variables[pivot]) {
+      if (status[node] == kVariable && in_pivot[node] != pivot) {
+        in_pivot[node] = pivot;
+        lp.push_back(node);
+      }
+    }
+    for (int32_t element : elements[pivot]) {
+      if (status[element] != kElement) continue;
+      for (int32_t node : members[element]) {
+        if (status[node] == kVariable && in_pivot[node] != pivot) {
+          in_pivot[node] = pivot;
+          lp.push_back(node);
+        }
+      }
+      status[element] = kAbsorbed;
+      std::vector<int32_t>().swap(members[element]);
+    }
+    std::vector<int32_t>().swap(variables[pivot]);
+    std::vector<int32_t>().swap(elements[pivot]);
+
+    // Prune the lists of the members of Lp: absorbed elements go, and so do
+    // variables that the pivot element now connects
+    for (int32_t node : lp) {
+      remove(node);
+      std::vector<int32_t> &adjacent = elements[node];
+      adjacent.erase(std::remove_if(adjacent.begin(), adjacent.end(),
+                                    [&](int32_t element) {
+                                      return status[element] != kElement;
+                                    }),
+                     adjacent.end());
+      for (int32_t element : adjacent) {
+        if (touched[element] != pivot) {
+          touched[element] = pivot;
+          w[element] = static_cast<int64_t>(members[element].size());
+        }
+        w[element]--;
+      }
+      adjacent.push_back(pivot);
+      std::vector<int32_t> &neighbors = variables[node];
+      neighbors.erase(std::remove_if(neighbors.begin(), neighbors.end(),
+                                     [&](int32_t other) {
+                                       return status[other] != kVariable ||
+                                              in_pivot[other] == pivot;
+                                     }),
+                      neighbors.end());
+    }
+
+    // Approximate external degrees. Elements inside Lp (w == 0) are absorbed
+    // into the pivot element.
+    const int64_t lp_size = static_cast<int64_t>(lp.size());
+    const int64_t remaining = n - k - 1;
+    for (int32_t node : lp) {
+      std::vector<int32_t> &adjacent = elements[node];
+      int64_t bound = static_cast<int64_t>(variables[node].size()) + lp_size - 1;
+      size_t kept = 0;
+      for (int32_t element : adjacent) {
+        if (element != pivot && w[element] == 0) {
+          status[element] = kAbsorbed;
+          continue;
+        }
+        adjacent[kept++] = element;
+        if (element != pivot) bound += w[element];
+      }
+      adjacent.resize(kept);
+      degree[node] = std::max<int64_t>(
+          0, std::min({remaining - 1, degree[node] + lp_size - 1, bound}));
+      insert(node);
+      min_degree = std::min(min_degree, degree[node]);
+    }
+  }
+  return perm;
+}
+
+// Greedy distance-1 colouring in node order; perm lists the nodes colour by
+// colour, in node order within a colour
+inline std::vector<int32_t> color(const Graph &graph,
+                                  int32_t *num_colors = nullptr) {
+  const int32_t n = graph.num_nodes();
+  std::vector<int32_t> colors(n, -1);
+  std::vector<int32_t> forbidden(n + 1, -1);
+  int32_t count = 0;
+  for (int32_t node = 0; node < n; node++) {
+    for (int32_t k = graph.offsets[node]; k < graph.offsets[node + 1]; k++) {
+      int32_t other = graph.neighbors[k];
+      if (colors[other] >= 0) forbidden[colors[other]] = node;
+    }
+    int32_t c = 0;
+    while (forbidden[c] == node) c++;
+    colors[node] = c;
+    count = std::max(count, c + 1);
+  }
+  std::vector<int32_t> first(count + 1, 0);
+  for (int32_t node = 0; node < n; node++) first[colors[node] + 1]++;
+  for (int32_t c = 0; c < count; c++) first[c + 1] += first[c];
+  std::vector<int32_t> perm(n);
+  for (int32_t node = 0; node < n; node++) perm[first[colors[node]]++] = node;
+  if (num_colors) *num_colors = count;
+  return perm;
+}
+
+// perm[new] = old for the given ordering of a num_rows x num_rows matrix
+inline std::vector<int32_t> order(Ordering ordering, int32_t num_rows,
+                                  const int32_t *row_offsets,
+                                  const int32_t *columns) {
+  if (ordering == Ordering::kNone) {
+    std::vector<int32_t> perm(num_rows);
+    std::iota(perm.begin(), perm.end(), 0);
+    return perm;
+  }
+  Graph graph = symmetric_graph(num_rows, row_offsets, columns);
+  switch (ordering) {
+    case Ordering::kRcm: return rcm(graph);
+    case Ordering::kAmd: return amd(graph);
+    default: return color(graph);
+  }
+}
+
+inline std::vector<int32_t> inverse(const std::vector<int32_t> &perm) {
+  std::vector<int32_t> result(perm.size(), -1);
+  for (size_t idx = 0; idx < perm.size(); idx++) {
+    int32_t old = perm[idx];
+    if (old < 0 || size_t(old) >= perm.size() || result[old] >= 0) {
+      throw std::invalid_argument("not a permutation");
+    }
+    result[old] = static_cast<int32_t>(idx);
+  }
+  return result;
+}
+
+// Which triangle of a matrix a triangular solve uses
+enum class Triangle { kLower, kUpper };
+
+// Level of every row in the solve with one triangle, from 0: a row only
+// depends on rows of lower levels, so the rows of one level can be solved
+// in parallel. Entries of the other triangle and the diagonal are ignored.
+inline std::vector<int32_t> row_levels(int32_t num_rows,
+                                       const int32_t *row_offsets,
+                                       const int32_t *columns,
+                                       Triangle triangle) {
+  std::vector<int32_t> level(num_rows, 0);
+  const bool lower = triangle == Triangle::kLower;
+  for (int32_t step = 0; step < num_rows; step++) {
+    const int32_t row = lower ? step : num_rows - 1 - step;
+    int32_t next = 0;
+    for (int32_t idx = row_offsets[row]; idx < row_offsets[row + 1]; idx++) {
+      const int32_t col = columns[idx];
+      if (lower ? col < row : col > row) next = std::max(next, level[col] + 1);
+    }
+    level[row] = next;
+  }
+  return level;
+}
+
+// Level counts, bandwidth and fill of a num_rows x num_rows matrix
+inline Stats analyze(int32_t num_rows, const int32_t *row_offsets,
+                     const int32_t *columns) {
+  Stats stats = {0, 0, 0, 0};
+  for (int32_t row = 0; row < num_rows; row++) {
+    for (int32_t idx = row_offsets[row]; idx < row_offsets[row + 1]; idx++) {
+      stats.bandwidth =
+          std::max<int64_t>(stats.bandwidth, std::abs(row - columns[idx]));
+    }
+  }
+  for (Triangle triangle : {Triangle::kLower, Triangle::kUpper}) {
+    std::vector<int32_t> level =
+        row_levels(num_rows, row_offsets, columns, triangle);
+    int64_t &levels = triangle == Triangle::kLower ? stats.lower_levels
+                                                   : stats.upper_levels;
+    for (int32_t row_level : level) {
+      levels = std::max<int64_t>(levels, row_level + 1);
+    }
+  }
+
+  // Column counts of L from the elimination tree (Gilbert, Ng and Peyton, as
+  // in CSparse): near-linear in nnz(A), whatever the fill
+  Graph graph = symmetric_graph(num_rows, row_offsets, columns);
+  std::vector<int32_t> parent(num_rows, -1), ancestor(num_rows, -1);
+  for (int32_t row = 0; row < num_rows; row++) {
+    for (int32_t k = graph.offsets[row]; k < graph.offsets[row + 1]; k++) {
+      int32_t node = graph.neighbors[k];
+      while (node >= 0 && node < row) {
+        int32_t next = ancestor[node];
+        ancestor[node] = row;
+        if (next < 0) parent[node] = row;
+        node = next;
+      }
+    }
+  }
+  // Postorder of the tree
+  std::vector<int32_t> head(num_rows, -1), sibling(num_rows, -1), post;
+  post.reserve(num_rows);
+  for (int32_t node = num_rows - 1; node >= 0; node--) {
+    if (parent[node] < 0) continue;
+    sibling[node] = head[parent[node]];
+    head[parent[node]] = node;
+  }
+  std::vector<int32_t> stack;
+  for (int32_t root = 0; root < num_rows; root++) {
+    if (parent[root] >= 0) continue;
+    stack.push_back(root);
+    while (!stack.empty()) {
+      int32_t node = stack.back();
+      int32_t child = head[node];
+      if (child < 0) {
+        stack.pop_back();
+        post.push_back(node);
+      } else {
+        head[node] = sibling[child];
+        stack.push_back(child);
+      }
+    }
+  }
+  // first[j]: postorder index of the first descendant of j. delta becomes
+  // the column counts once accumulated up the tree.
+  std::vector<int32_t> first(num_rows, -1), max_first(num_rows, -1),
+      prev_leaf(num_rows, -1);
+  std::vector<int64_t> delta(num_rows, 0);
+  for (int32_t k = 0; k < num_rows; k++) {
+    int32_t node = post[k];
+    delta[node] = first[node] == -1 ? 1 : 0;
+    for (; node >= 0 && first[node] == -1; node = parent[node]) first[node] = k;
+  }
+  for (int32_t node = 0; node < num_rows; node++) ancestor[node] = node;
+  for (int32_t k = 0; k < num_rows; k++) {
+    const int32_t j = post[k];
+    if (parent[j] >= 0) delta[parent[j]]--;
+    for (int32_t p = graph.offsets[j]; p < graph.offsets[j + 1]; p++) {
+      const int32_t i = graph.neighbors[p];
+      // Is j a leaf of the row subtree of i, and which one?
+      if (i <= j || first[j] <= max_first[i]) continue;
+      max_first[i] = first[j];
+      const int32_t previous = prev_leaf[i];
+      prev_leaf[i] = j;
+      delta[j]++;
+      if (previous == -1) continue;
+      int32_t q = previous;
+      while (q != ancestor[q]) q = ancestor[q];
+      for (int32_t node = previous; node != q;) {
+        int32_t next = ancestor[node];
+        ancestor[node] = q;
+        node = next;
+      }
+      delta[q]--;
+    }
+    if (parent[j] >= 0) ancestor[j] = parent[j];
+  }
+  for (int32_t k = 0; k < num_rows; k++) {
+    int32_t node = post[k];
+    if (parent[node] >= 0) delta[parent[node]] += delta[node];
+    stats.fill += delta[node];
+  }
+  return stats;
+}
+
+// A(perm, perm), with sorted columns. The rows are split across pool, if
+// given.
+inline Csr permute(int32_t num_rows, const int32_t *row_offsets,
+                   const int32_t *columns, const double *values,
+                   const std::vector<int32_t> &perm,
+                   ThreadPool *pool = nullptr) {
+  if (perm.size() != size_t(num_rows)) {
+    throw std::invalid_argument("permutation size differs from the matrix");
+  }
+  std::vector<int32_t> position = inverse(perm);
+  Csr result;
+  result.row_offsets.resize(num_rows + 1, 0);
+  for (int32_t row = 0; row < num_rows; row++) {
+    result.row_offsets[row + 1] = result.row_offsets[row] +
+                                  row_offsets[perm[row] + 1] -
+                                  row_offsets[perm[row]];
+  }
+  result.columns.resize(result.row_offsets[num_rows]);
+  result.values.resize(result.row_offsets[num_rows]);
+  auto permute_rows = [&](int32_t first, int32_t last) {
+    std::vector<std::pair<int32_t, double>> entries;
+    for (int32_t row = first; row < last; row++) {
+      const int32_t old = perm[row];
+      entries.clear();
+      for (int32_t idx = row_offsets[old]; idx < row_offsets[old + 1]; idx++) {
+        entries.emplace_back(position[columns[idx]], values[idx]);
+      }
+      std::sort(entries.begin(), entries.end(),
+                [](const std::pair<int32_t, double> &a,
+                   const std::pair<int32_t, double> &b) {
+                  return a.first < b.first;
+                });
+      int32_t out = result.row_offsets[row];
+      for (const auto &entry : entries) {
+        result.columns[out] = entry.first;
+        result.values[out] = entry.second;
+        out++;
+      }
+    }
+  };
+  if (!pool) {
+    permute_rows(0, num_rows);
+    return result;
+  }
+  const size_t num_tasks = pool->size() * 4;
+  pool->enqueue_batch(num_tasks, [&](int, size_t task) {
+    permute_rows(static_cast<int32_t>(int64_t(num_rows) * task / num_tasks),
+                 static_cast<int32_t>(int64_t(num_rows) * (task + 1) / num_tasks));
+  });
+  pool->wait();
+  return result;
+}
+
+// y[new] = x[perm[new]]
+template <typename T>
+void permute_vector(const std::vector<int32_t> &perm, const T *x, T *y) {
+  for (size_t idx = 0; idx < perm.size(); idx++) y[idx] = x[perm[idx]];
+}
+
+// x[perm[new]] = y[new]
+template <typename T>
+void unpermute_vector(const std::vector<int32_t> &perm, const T *y, T *x) {
+  for (size_t idx = 0; idx < perm.size(); idx++) x[perm[idx]] = y[idx];
+}
+}  // namespace SparseReorder
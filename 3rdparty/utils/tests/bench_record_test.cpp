@@ -0,0 +1,136 @@
+// Checks that CSV records with differing column sets appended to one file
+// stay aligned with a single header, that JSON lines are appended as is, and
+// that the stdout CSV header is not repeated.
+#include <unistd.h>  // dup, dup2, getpid
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <utils/bench_record.h>
+
+#include "test_check.h"
+
+namespace {
+
+std::string read_file(const std::string &path) {
+  std::ifstream input(path, std::ios::binary);
+  std::stringstream text;
+  text << input.rdbuf();
+  return text.str();
+}
+
+std::string get_temp_path(const char *name) {
+  const char *tmpdir = std::getenv("TMPDIR");
+  return std::string(tmpdir ? tmpdir : "/tmp") + "/" + name + "." +
+         std::to_string(getpid());
+}
+
+void test_csv_columns() {
+  std::string path = get_temp_path("bench_record_test.csv");
+  std::remove(path.c_str());
+  BenchRecord::OutputOptions options{BenchRecord::OutputFormat::kCsv, path};
+
+  BenchRecord::Record first;
+  first.add("m", 4).add("n", 8);
+  BenchRecord::emit(options, first);
+  CHECK(read_file(path) == "m,n\n4,8\n");
+
+  // Same columns in another order: appended by the file header
+  BenchRecord::Record reordered;
+  reordered.add("n", 16).add("m", 2);
+  BenchRecord::emit(options, reordered);
+  CHECK(read_file(path) == "m,n\n4,8\n2,16\n");
+
+  // A missing column is left empty
+  BenchRecord::Record subset;
+  subset.add("n", 32);
+  BenchRecord::emit(options, subset);
+  CHECK(read_file(path) == "m,n\n4,8\n2,16\n,32\n");
+
+  // A new column, with a value that needs quoting: the header is rewritten
+  // and the earlier rows are padded
+  BenchRecord::Record extended;
+  extended.add("m", 1).add("name", "a,\"b\"").add("n", 64);
+  BenchRecord::emit(options, extended);
+  CHECK(read_file(path) ==
+        "m,n,name\n4,8,\n2,16,\n,32,\n1,64,\"a,\"\"b\"\"\"\n");
+
+  // The quoted field is parsed back as one column
+  BenchRecord::Record last;
+  last.add("name", "c").add("m", 0).add("n", 0);
+  BenchRecord::emit(options, last);
+  CHECK(read_file(path) ==
+        "m,n,name\n4,8,\n2,16,\n,32,\n1,64,\"a,\"\"b\"\"\"\n0,0,c\n");
+  std::remove(path.c_str());
+}
+
+void test_csv_quoted_header() {
+  std::string path = get_temp_path("bench_record_test_quoted.csv");
+  std::remove(path.c_str());
+  BenchRecord::OutputOptions options{BenchRecord::OutputFormat::kCsv, path};
+
+  // The header ends at the first newline outside quotes
+  BenchRecord::Record first;
+  first.add("a\nb", 1).add("c", 2);
+  BenchRecord::emit(options, first);
+  CHECK(BenchRecord::read_csv_header(path) ==
+        (std::vector<std::string>{"\"a\nb\"", "c"}));
+  BenchRecord::Record second;
+  second.add("c", 4).add("a\nb", 3);
+  BenchRecord::emit(options, second);
+  CHECK(read_file(path) == "\"a\nb\",c\n1,2\n3,4\n");
+  std::remove(path.c_str());
+  CHECK(BenchRecord::read_csv_header(path).empty());
+}
+
+void test_csv_stdout() {
+  std::string path = get_temp_path("bench_record_test_stdout.csv");
+  BenchRecord::OutputOptions options{BenchRecord::OutputFormat::kCsv, ""};
+  fflush(stdout);
+  int saved_stdout = dup(fileno(stdout));
+  CHECK(freopen(path.c_str(), "w", stdout) != nullptr);
+
+  BenchRecord::Record record;
+  record.add("m", 4).add("n", 8);
+  BenchRecord::emit(options, record);
+  record.add("n", 16);
+  BenchRecord::emit(options, record);
+  // Other columns need their own header
+  BenchRecord::Record other;
+  other.add("k", 1);
+  BenchRecord::emit(options, other);
+
+  fflush(stdout);
+  dup2(saved_stdout, fileno(stdout));
+  close(saved_stdout);
+  CHECK(read_file(path) == "m,n\n4,8\n4,16\nk\n1\n");
+  std::remove(path.c_str());
+}
+
+void test_jsonl() {
+  std::string path = get_temp_path("bench_record_test.jsonl");
+  std::remove(path.c_str());
+  BenchRecord::OutputOptions options{BenchRecord::OutputFormat::kJsonl, path};
+  BenchRecord::Record first;
+  first.add("m", 4);
+  BenchRecord::emit(options, first);
+  BenchRecord::Record second;
+  second.add("name", "x").add("ok", true);
+  BenchRecord::emit(options, second);
+  CHECK(read_file(path) == "{\"m\":4}\n{\"name\":\"x\",\"ok\":true}\n");
+  std::remove(path.c_str());
+}
+
+}  // namespace
+
+int main() {
+  test_csv_columns();
+  test_csv_quoted_header();
+  test_csv_stdout();
+  test_jsonl();
+  return test_result("bench_record_test");
+}
@@ -0,0 +1,142 @@
+// Checks the dimension specs and the sweep file parsing of bench_sweep.h,
+// including the rejection of malformed transposes and out-of-range sizes.
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <utils/bench_sweep.h>
+
+#include "test_check.h"
+
+namespace {
+
+using BenchSweep::GemmPoint;
+
+template <typename Func>
+bool throws(Func &&func) {
+  try {
+    func();
+  } catch (const std::invalid_argument &) {
+    return true;
+  }
+  return false;
+}
+
+void test_dim_spec() {
+  CHECK(BenchSweep::parse_dim_spec("64") == std::vector<long>({64}));
+  CHECK(BenchSweep::parse_dim_spec("32:256") ==
+        std::vector<long>({32, 64, 128, 256}));
+  // Doubling starts from lo, which need not be a power of two
+  CHECK(BenchSweep::parse_dim_spec("24:100") ==
+        std::vector<long>({24, 48, 96}));
+  CHECK(BenchSweep::parse_dim_spec("2:200:*10") ==
+        std::vector<long>({2, 20, 200}));
+  CHECK(BenchSweep::parse_dim_spec("128:512:128") ==
+        std::vector<long>({128, 256, 384, 512}));
+  // The progression stops at the largest int instead of overflowing
+  std::vector<long> values =
+      BenchSweep::parse_dim_spec("1073741824:2147483647");
+  CHECK(values == std::vector<long>({1073741824}));
+  values = BenchSweep::parse_dim_spec("2147483600:2147483647:40");
+  CHECK(values == std::vector<long>({2147483600, 2147483640}));
+
+  CHECK(throws([] { BenchSweep::parse_dim_spec("0"); }));
+  CHECK(throws([] { BenchSweep::parse_dim_spec("-4"); }));
+  CHECK(throws([] { BenchSweep::parse_dim_spec("2147483648"); }));
+  CHECK(throws([] { BenchSweep::parse_dim_spec("99999999999999999999999"); }));
+  CHECK(throws([] { BenchSweep::parse_dim_spec("64:32"); }));
+  CHECK(throws([] { BenchSweep::parse_dim_spec("1:8:*1"); }));
+  CHECK(throws([] { BenchSweep::parse_dim_spec("1:2:3:4"); }));
+}
+
+void test_shape_spec() {
+  auto shapes = BenchSweep::parse_shape_spec("16:32x8x4,1x2x3");
+  CHECK(shapes.size() == 3);
+  CHECK((shapes[0] == std::array<long, 3>{16, 8, 4}));
+  CHECK((shapes[1] == std::array<long, 3>{32, 8, 4}));
+  CHECK((shapes[2] == std::array<long, 3>{1, 2, 3}));
+  CHECK(throws([] { BenchSweep::parse_shape_spec("16x8"); }));
+}
+
+std::string write_file(const std::string &content) {
+  std::string path = "bench_sweep_test.txt";
+  std::ofstream(path) << content;
+  return path;
+}
+
+bool same_point(const GemmPoint &point, long m, long n, long k, char transa,
+                char transb, const std::string &dtype) {
+  return point.m == m && point.n == n && point.k == k &&
+         point.transa == transa && point.transb == transb &&
+         point.dtype == dtype;
+}
+
+void test_sweep_file() {
+  std::string path = write_file(
+      "# m n k [transa transb [dtype]]\n"
+      "64 32 16\n"
+      "\n"
+      "8 8 8 T N\n"
+      "4 4 4 N T fp64\n");
+  std::vector<GemmPoint> points =
+      BenchSweep::parse_sweep_file(path, {"NN", "TT"}, {"fp32", "fp16"});
+  // Lines expand over what they do not specify: transposes, then dtypes
+  CHECK(points.size() == 4 + 2 + 1);
+  CHECK(same_point(points[0], 64, 32, 16, 'N', 'N', "fp32"));
+  CHECK(same_point(points[1], 64, 32, 16, 'N', 'N', "fp16"));
+  CHECK(same_point(points[2], 64, 32, 16, 'T', 'T', "fp32"));
+  CHECK(same_point(points[3], 64, 32, 16, 'T', 'T', "fp16"));
+  CHECK(same_point(points[4], 8, 8, 8, 'T', 'N', "fp32"));
+  CHECK(same_point(points[5], 8, 8, 8, 'T', 'N', "fp16"));
+  CHECK(same_point(points[6], 4, 4, 4, 'N', 'T', "fp64"));
+
+  const char *malformed[] = {"8 8 8 X N\n",
+                             "8 8 8 t n\n",
+                             "8 8 8 NT N\n",
+                             "8 8 8 N\n",
+                             "8 8 8 N T fp32 extra\n",
+                             "8 8\n",
+                             "8 8 0\n",
+                             "8 -8 8\n",
+                             "3000000000 8 8\n",
+                             "8 8 8.5\n"};
+  for (const char *content : malformed) {
+    path = write_file(content);
+    bool threw = throws(
+        [&] { BenchSweep::parse_sweep_file(path, {"NN"}, {"fp32"}); });
+    if (!threw) std::fprintf(stderr, "accepted \"%s\"\n", content);
+    CHECK(threw);
+  }
+  std::remove(path.c_str());
+  CHECK(throws([] {
+    BenchSweep::parse_sweep_file("/nonexistent/sweep.txt", {"NN"}, {"fp32"});
+  }));
+}
+
+void test_command_line() {
+  std::string path = write_file("16 16 16\n");
+  std::string sweep_file = "--sweep_file=" + path;
+  const char *argv[] = {"bench_gemm", sweep_file.c_str(), "--transposes=NT,TN",
+                        "--dtypes=bf16"};
+  std::vector<GemmPoint> points = BenchSweep::parse_gemm_sweep(4, argv);
+  CHECK(points.size() == 2);
+  CHECK(same_point(points[0], 16, 16, 16, 'N', 'T', "bf16"));
+  CHECK(same_point(points[1], 16, 16, 16, 'T', 'N', "bf16"));
+  std::remove(path.c_str());
+
+  const char *bad_transposes[] = {"bench_gemm", "--sweep=8x8x8",
+                                  "--transposes=NX"};
+  CHECK(throws([&] { BenchSweep::parse_gemm_sweep(3, bad_transposes); }));
+}
+
+}  // namespace
+
+int main() {
+  test_dim_spec();
+  test_shape_spec();
+  test_sweep_file();
+  test_command_line();
+  return test_result("bench_sweep_test");
+}
@@ -0,0 +1,181 @@
+// Drives the warmup, the stop rules and the statistics of bench_timing.h
+// with synthetic timings.
+#include <cmath>
+#include <vector>
+
+#include <utils/bench_timing.h>
+
+#include "test_check.h"
+
+namespace {
+
+using BenchTiming::Config;
+using BenchTiming::Summary;
+
+bool near(double lhs, double rhs) {
+  return std::fabs(lhs - rhs) <= 1e-9 * std::max(1.0, std::fabs(rhs));
+}
+
+Config make_config(int warmup_iters, int min_iters, int max_iters,
+                   double target_rel_ci, double max_time_ms) {
+  return Config{.warmup_iters = warmup_iters,
+                .min_iters = min_iters,
+                .max_iters = max_iters,
+                .target_rel_ci = target_rel_ci,
+                .max_time_ms = max_time_ms};
+}
+
+// Warmup iterations run first and are not sampled
+void test_warmup() {
+  std::vector<double> timings = {100.0, 100.0, 100.0, 1.0, 2.0, 3.0, 4.0, 5.0};
+  int calls = 0;
+  Summary summary = BenchTiming::measure(make_config(3, 5, 5, 0.0, 0.0), [&]() {
+    return timings[calls++];
+  });
+  CHECK(calls == 8);
+  CHECK(summary.num_warmup == 3);
+  CHECK(summary.num_samples == 5);
+  CHECK(summary.max == 5.0);
+  CHECK(!summary.converged);
+}
+
+// Identical samples have a zero confidence interval, so sampling stops at
+// min_iters
+void test_converged_at_min_iters() {
+  int calls = 0;
+  Summary summary =
+      BenchTiming::measure(make_config(0, 10, 1000, 0.01, 0.0), [&]() {
+        calls++;
+        return 2.0;
+      });
+  CHECK(calls == 10);
+  CHECK(summary.num_samples == 10);
+  CHECK(summary.converged);
+  CHECK(summary.rel_ci == 0.0);
+}
+
+// Alternating samples never reach a 1e-6 target before max_iters
+void test_max_iters() {
+  int calls = 0;
+  Summary summary =
+      BenchTiming::measure(make_config(1, 2, 50, 1e-6, 0.0), [&]() {
+        return (calls++ % 2) ? 1.0 : 3.0;
+      });
+  CHECK(calls == 51);
+  CHECK(summary.num_samples == 50);
+  CHECK(!summary.converged);
+}
+
+// The time budget counts sampled time only and stops once exceeded, but not
+// before min_iters
+void test_max_time() {
+  int calls = 0;
+  Summary summary =
+      BenchTiming::measure(make_config(2, 1, 1000, 0.0, 35.0), [&]() {
+        calls++;
+        return 10.0;
+      });
+  CHECK(summary.num_samples == 4);
+  CHECK(calls == 6);
+
+  summary = BenchTiming::measure(make_config(0, 6, 1000, 0.0, 35.0),
+                                 []() { return 10.0; });
+  CHECK(summary.num_samples == 6);
+}
+
+void test_single_shot() {
+  int calls = 0;
+  Summary summary =
+      BenchTiming::measure(BenchTiming::get_single_shot_config(), [&]() {
+        calls++;
+        return 7.0;
+      });
+  CHECK(calls == 1);
+  CHECK(summary.num_samples == 1);
+  CHECK(summary.median == 7.0);
+  CHECK(summary.stddev == 0.0);
+  CHECK(std::isinf(summary.rel_ci));
+}
+
+void test_summarize() {
+  std::vector<double> samples = {7, 3, 10, 1, 5, 9, 2, 8, 4, 6};
+  Summary summary = BenchTiming::summarize(samples, 4, true);
+  CHECK(summary.num_warmup == 4);
+  CHECK(summary.num_samples == 10);
+  CHECK(summary.converged);
+  CHECK(summary.min == 1.0);
+  CHECK(summary.max == 10.0);
+  CHECK(near(summary.median, 5.5));
+  CHECK(near(summary.p90, 9.1));
+  CHECK(near(summary.p99, 9.91));
+  CHECK(near(summary.mean, 5.5));
+  double stddev = std::sqrt(82.5 / 9);
+  CHECK(near(summary.stddev, stddev));
+  CHECK(near(summary.rel_ci, 2.262 * stddev / std::sqrt(10.0) / 5.5));
+
+  CHECK(near(BenchTiming::summarize({4.0, 1.0, 2.0}).median, 2.0));
+  CHECK(BenchTiming::summarize({}).num_samples == 0);
+}
+
+// The running (Welford) interval of the sampler matches the two-pass one
+void test_sampler_rel_ci() {
+  BenchTiming::Sampler sampler(make_config(0, 1, 1000, 0.0, 0.0));
+  std::vector<double> samples;
+  for (int idx = 0; idx < 40; idx++) {
+    double sample = 1000.0 + std::sin(idx) * 3.0;
+    samples.push_back(sample);
+    sampler.add(sample);
+  }
+  CHECK(near(sampler.get_rel_ci(), BenchTiming::summarize(samples).rel_ci));
+  CHECK(sampler.get_samples().size() == 40);
+}
+
+void test_student_t() {
+  CHECK(std::isinf(BenchTiming::student_t_975(0)));
+  CHECK(BenchTiming::student_t_975(1) == 12.706);
+  CHECK(BenchTiming::student_t_975(30) == 2.042);
+  CHECK(BenchTiming::student_t_975(31) == 1.96);
+}
+
+void test_parse_config() {
+  const char *defaults[] = {"bench"};
+  Config config = BenchTiming::parse_config(1, defaults);
+  CHECK(config.warmup_iters == 5 && config.min_iters == 10 &&
+        config.max_iters == 1000);
+
+  const char *single_shot[] = {"bench", "--single_shot"};
+  config = BenchTiming::parse_config(2, single_shot);
+  CHECK(config.warmup_iters == 0 && config.min_iters == 1 &&
+        config.max_iters == 1 && config.target_rel_ci == 0.0);
+
+  // min_iters is clamped to [1, max_iters] and max_iters to at least 1
+  const char *clamped[] = {"bench", "--max_iters=0", "--min_iters=5",
+                           "--warmup_iters=-2"};
+  config = BenchTiming::parse_config(4, clamped);
+  CHECK(config.warmup_iters == 0);
+  CHECK(config.max_iters == 1);
+  CHECK(config.min_iters == 1);
+
+  const char *overrides[] = {"bench", "--single_shot", "--max_iters=20",
+                             "--min_iters=3", "--target_rel_ci=0.05",
+                             "--max_time_ms=100"};
+  config = BenchTiming::parse_config(6, overrides);
+  CHECK(config.min_iters == 3 && config.max_iters == 20);
+  CHECK(near(config.target_rel_ci, 0.05));
+  CHECK(config.max_time_ms == 100.0);
+}
+
+}  // namespace
+
+int main() {
+  test_warmup();
+  test_converged_at_min_iters();
+  test_max_iters();
+  test_max_time();
+  test_single_shot();
+  test_summarize();
+  test_sampler_rel_ci();
+  test_student_t();
+  test_parse_config();
+  return test_result("bench_timing_test");
+}
@@ -0,0 +1,224 @@
+// Checks that get_max_nnz() is the exact capacity of the banded pattern:
+// generate() fills the whole band and throws for one more nonzero. Also
+// checks that every pattern passes validate() and follows its structure, and
+// the row-length distribution of the uniform pattern.
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include <utils/generate_random_csr.h>
+
+#include "test_check.h"
+
+namespace {
+
+bool generate_throws(long m, long n, long long nnz,
+                     const RandomCSR::Options &options) {
+  try {
+    RandomCSR::generate<int, float>(m, n, nnz, options);
+  } catch (const std::invalid_argument &) {
+    return true;
+  }
+  return false;
+}
+
+void test_banded(long m, long n, long bandwidth) {
+  RandomCSR::Options options = RandomCSR::get_default_options();
+  options.pattern = RandomCSR::Pattern::kBanded;
+  options.bandwidth = bandwidth;
+  options.num_threads = 2;
+  long long max_nnz = RandomCSR::get_max_nnz(m, n, options);
+  RandomCSR::CSR<int, float> csr =
+      RandomCSR::generate<int, float>(m, n, max_nnz, options);
+  CHECK(static_cast<long long>(csr.column_indices.size()) == max_nnz);
+  for (long row = 0; row < m; row++) {
+    for (int idx = csr.row_offsets[row]; idx < csr.row_offsets[row + 1];
+         idx++) {
+      long col = csr.column_indices[idx];
+      CHECK(col >= row - bandwidth && col <= row + bandwidth);
+    }
+  }
+  CHECK(generate_throws(m, n, max_nnz + 1, options));
+}
+
+RandomCSR::Options get_options(RandomCSR::Pattern pattern) {
+  RandomCSR::Options options = RandomCSR::get_default_options();
+  options.pattern = pattern;
+  options.seed = 7;
+  options.num_threads = 3;
+  return options;
+}
+
+std::vector<long> get_row_lengths(const RandomCSR::CSR<int, float> &csr) {
+  std::vector<long> lengths(csr.num_rows);
+  for (long row = 0; row < csr.num_rows; row++) {
+    lengths[row] = csr.row_offsets[row + 1] - csr.row_offsets[row];
+  }
+  return lengths;
+}
+
+void test_validate_all_patterns() {
+  const RandomCSR::Pattern patterns[] = {
+      RandomCSR::Pattern::kUniform, RandomCSR::Pattern::kPowerLaw,
+      RandomCSR::Pattern::kBanded, RandomCSR::Pattern::kBlock,
+      RandomCSR::Pattern::kTwoFour};
+  for (RandomCSR::Pattern pattern : patterns) {
+    RandomCSR::Options options = get_options(pattern);
+    // More rows than one chunk, and dense enough that the sparse and the
+    // selection sampling paths are both taken
+    RandomCSR::CSR<int, float> sparse = RandomCSR::generate<int, float>(
+        3000, 517,
+        std::min(20000LL, RandomCSR::get_max_nnz(3000, 517, options)),
+        options);
+    CHECK(RandomCSR::validate(sparse).empty());
+    RandomCSR::CSR<int, float> dense = RandomCSR::generate<int, float>(
+        300, 64, std::min(9000LL, RandomCSR::get_max_nnz(300, 64, options)),
+        options);
+    CHECK(RandomCSR::validate(dense).empty());
+  }
+
+  // validate() reports the violations it claims to
+  RandomCSR::CSR<int, float> csr = RandomCSR::generate<int, float>(
+      20, 20, 100, get_options(RandomCSR::Pattern::kUniform));
+  int row = 0;
+  while (csr.row_offsets[row + 1] - csr.row_offsets[row] < 2) row++;
+  int first = csr.row_offsets[row];
+  RandomCSR::CSR<int, float> duplicate = csr;
+  duplicate.column_indices[first + 1] = duplicate.column_indices[first];
+  CHECK(RandomCSR::validate(duplicate) ==
+        "unsorted or duplicate column at row " + std::to_string(row));
+  RandomCSR::CSR<int, float> unsorted = csr;
+  std::swap(unsorted.column_indices[first],
+            unsorted.column_indices[first + 1]);
+  CHECK(!RandomCSR::validate(unsorted).empty());
+  RandomCSR::CSR<int, float> out_of_range = csr;
+  out_of_range.column_indices[first] = 20;
+  CHECK(!RandomCSR::validate(out_of_range).empty());
+}
+
+// Row lengths of the uniform pattern are hypergeometric, nnz draws from the
+// m n cells of which n are in the row: mean nnz / m and variance
+// (nnz / m) (1 - 1 / m) (m n - nnz) / (m n - 1)
+void test_uniform_row_stats() {
+  long m = 4000, n = 1000;
+  long long nnz = 400000;
+  RandomCSR::CSR<int, float> csr = RandomCSR::generate<int, float>(
+      m, n, nnz, get_options(RandomCSR::Pattern::kUniform));
+  RandomCSR::RowStats stats = RandomCSR::get_row_stats(csr);
+  double cells = static_cast<double>(m) * n;
+  double expected_stddev = std::sqrt(static_cast<double>(nnz) / m *
+                                     (1.0 - 1.0 / m) * (cells - nnz) /
+                                     (cells - 1));
+  CHECK(std::fabs(stats.mean - 100.0) < 1e-9);
+  CHECK(std::fabs(stats.stddev - expected_stddev) < 0.1 * expected_stddev);
+  CHECK(stats.min > 100 - 6 * expected_stddev);
+  CHECK(stats.max < 100 + 6 * expected_stddev);
+  CHECK(stats.empty_rows == 0);
+}
+
+// The k-th heaviest row holds about nnz * k^-alpha / sum_j j^-alpha nonzeros
+void test_power_law() {
+  long m = 1000, n = 100000;
+  long long nnz = 200000;
+  RandomCSR::Options options = get_options(RandomCSR::Pattern::kPowerLaw);
+  options.power_law_alpha = 1.0;
+  RandomCSR::CSR<int, float> csr =
+      RandomCSR::generate<int, float>(m, n, nnz, options);
+  CHECK(static_cast<long long>(csr.column_indices.size()) == nnz);
+  std::vector<long> lengths = get_row_lengths(csr);
+  std::sort(lengths.begin(), lengths.end(), std::greater<long>());
+  double harmonic = 0.0;
+  for (long rank = 1; rank <= m; rank++) harmonic += 1.0 / rank;
+  for (long rank : {1L, 2L, 10L, 100L}) {
+    double expected = nnz / (rank * harmonic);
+    CHECK(std::fabs(lengths[rank - 1] - expected) <= 0.01 * expected + 2);
+  }
+  RandomCSR::RowStats stats = RandomCSR::get_row_stats(csr);
+  CHECK(stats.max == lengths.front());
+  CHECK(stats.stddev > stats.mean);
+}
+
+// Nonzeros come in whole block_rows x block_cols blocks aligned to the block
+// grid, truncated at the matrix edge
+void test_block(long m, long n, long long nnz) {
+  RandomCSR::Options options = get_options(RandomCSR::Pattern::kBlock);
+  options.block_rows = 4;
+  options.block_cols = 8;
+  RandomCSR::CSR<int, float> csr =
+      RandomCSR::generate<int, float>(m, n, nnz, options);
+  CHECK(RandomCSR::validate(csr).empty());
+  long long num_blocks = 0;
+  for (long row = 0; row < m; row++) {
+    int begin = csr.row_offsets[row];
+    int end = csr.row_offsets[row + 1];
+    // Every row of a block row has the same columns as its first row
+    long first_row = row / options.block_rows * options.block_rows;
+    int first_begin = csr.row_offsets[first_row];
+    bool same_length =
+        end - begin == csr.row_offsets[first_row + 1] - first_begin;
+    CHECK(same_length);
+    for (int idx = begin; same_length && idx < end; idx++) {
+      CHECK(csr.column_indices[idx] ==
+            csr.column_indices[first_begin + idx - begin]);
+    }
+    // Columns form runs that start on a block boundary and span the block
+    for (int idx = begin; idx < end;) {
+      long col = csr.column_indices[idx];
+      CHECK(col % options.block_cols == 0);
+      long width = std::min<long>(options.block_cols, n - col);
+      for (long offset = 0; offset < width; offset++) {
+        CHECK(idx + offset < end &&
+              csr.column_indices[idx + offset] == col + offset);
+      }
+      idx += width;
+      if (row == first_row) num_blocks++;
+    }
+  }
+  long long block_size = options.block_rows * options.block_cols;
+  CHECK(num_blocks == (nnz + block_size - 1) / block_size);
+}
+
+// Exactly two nonzeros in every full group of four columns
+void test_two_four(long m, long n) {
+  RandomCSR::CSR<int, float> csr = RandomCSR::generate<int, float>(
+      m, n, 0, get_options(RandomCSR::Pattern::kTwoFour));
+  CHECK(RandomCSR::validate(csr).empty());
+  for (long row = 0; row < m; row++) {
+    std::vector<int> group_counts((n + 3) / 4, 0);
+    for (int idx = csr.row_offsets[row]; idx < csr.row_offsets[row + 1];
+         idx++) {
+      group_counts[csr.column_indices[idx] / 4]++;
+    }
+    for (long group = 0; group < n / 4; group++) {
+      CHECK(group_counts[group] == 2);
+    }
+    if (n % 4 != 0) {
+      CHECK(group_counts.back() == std::min(2L, n % 4));
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  test_banded(100, 100, 3);
+  test_banded(50, 200, 7);
+  test_banded(300, 20, 5);
+  test_banded(10, 10, 0);
+  test_banded(16, 16, 100);
+
+  RandomCSR::Options options = RandomCSR::get_default_options();
+  CHECK(RandomCSR::get_max_nnz(30, 40, options) == 1200);
+  CHECK(generate_throws(30, 40, 1201, options));
+
+  test_validate_all_patterns();
+  test_uniform_row_stats();
+  test_power_law();
+  test_block(64, 128, 1000);
+  test_block(1030, 61, 5000);
+  test_two_four(1100, 64);
+  test_two_four(10, 7);
+  return test_result("generate_random_csr_test");
+}
@@ -0,0 +1,271 @@
+// Checks host_fft.h against a naive DFT for powers of two, odd, generic prime
+// and Bluestein lengths, rank-N c2c, r2c and c2r transforms on one and several
+// threads, and forward/inverse round trips.
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <utils/host_fft.h>
+
+#include "test_check.h"
+
+namespace {
+
+using HostFFT::Direction;
+typedef std::complex<double> Complex;
+
+std::vector<Complex> random_signal(size_t size, std::mt19937 &rng) {
+  std::uniform_real_distribution<double> value(-1.0, 1.0);
+  std::vector<Complex> x(size);
+  for (Complex &v : x) v = Complex(value(rng), value(rng));
+  return x;
+}
+
+// Naive DFT along every axis of batch arrays of shape dims, the angle
+// reduced modulo n so that it is exact for large j * k
+std::vector<Complex> naive_dft(const std::vector<size_t> &dims, size_t batch,
+                               std::vector<Complex> x, Direction direction) {
+  const double sign = direction == Direction::kForward ? -1.0 : 1.0;
+  const double pi = 3.14159265358979323846;
+  size_t volume = 1;
+  for (size_t n : dims) volume *= n;
+  for (size_t axis = 0; axis < dims.size(); axis++) {
+    const size_t n = dims[axis];
+    size_t stride = 1;
+    for (size_t i = axis + 1; i < dims.size(); i++) stride *= dims[i];
+    std::vector<Complex> y(x.size());
+    for (size_t b = 0; b < batch * volume / n; b++) {
+      const size_t base = b / stride * stride * n + b % stride;
+      for (size_t k = 0; k < n; k++) {
+        Complex sum = 0;
+        for (size_t j = 0; j < n; j++) {
+          double angle = sign * 2.0 * pi * static_cast<double>(j * k % n) / n;
+          sum += x[base + j * stride] * Complex(std::cos(angle), std::sin(angle));
+        }
+        y[base + k * stride] = sum;
+      }
+    }
+    x.swap(y);
+  }
+  return x;
+}
+
+// Largest error relative to the largest magnitude of expected
+template <typename T>
+double relative_error(const std::vector<std::complex<T>> &actual,
+                      const std::vector<Complex> &expected) {
+  double error = 0, scale = 0;
+  for (size_t i = 0; i < expected.size(); i++) {
+    Complex a(actual[i].real(), actual[i].imag());
+    error = std::max(error, std::abs(a - expected[i]));
+    scale = std::max(scale, std::abs(expected[i]));
+  }
+  return error / std::max(scale, 1e-300);
+}
+
+template <typename T>
+double plan_error(size_t n, Direction direction, std::mt19937 &rng) {
+  std::vector<Complex> x = random_signal(n, rng);
+  std::vector<T> re(n), im(n);
+  for (size_t i = 0; i < n; i++) {
+    re[i] = static_cast<T>(x[i].real());
+    im[i] = static_cast<T>(x[i].imag());
+    x[i] = Complex(re[i], im[i]);
+  }
+  HostFFT::Plan1D<T> plan(n);
+  CHECK(plan.size() == n);
+  std::vector<T> scratch(plan.scratch_size());
+  plan.execute(re.data(), im.data(), direction, scratch.data());
+  std::vector<std::complex<T>> y(n);
+  for (size_t i = 0; i < n; i++) y[i] = std::complex<T>(re[i], im[i]);
+  return relative_error(y, naive_dft({n}, 1, x, direction));
+}
+
+void test_plan1d() {
+  std::mt19937 rng(19);
+  // Powers of two (radix 4 and 2), odd 3, 5-smooth lengths, generic prime
+  // radices up to 61, and Bluestein for larger prime factors
+  const size_t lengths[] = {1,   2,   4,   8,   16,  32,  64,  256, 1024, 2048,
+                            3,   5,   9,   15,  25,  27,  45,  75,  105,  243,
+                            6,   12,  60,  7,   11,  13,  49,  61,  77,   122,
+                            67,  97,  101, 127, 257, 1009, 134, 201, 2 * 1009, 4093};
+  for (size_t n : lengths) {
+    for (Direction direction : {Direction::kForward, Direction::kInverse}) {
+      double error = plan_error<double>(n, direction, rng);
+      CHECK(error < 1e-12);
+      if (!(error < 1e-12)) std::fprintf(stderr, "  double n = %zu: %g\n", n, error);
+    }
+  }
+  // Single precision, through the vector lanes and their scalar tails
+  for (size_t n : {8, 12, 16, 30, 64, 97, 256, 360, 1000}) {
+    double error = plan_error<float>(n, Direction::kForward, rng);
+    CHECK(error < 1e-5);
+    if (!(error < 1e-5)) std::fprintf(stderr, "  float n = %zu: %g\n", n, error);
+  }
+
+  bool thrown = false;
+  try {
+    HostFFT::Plan1D<double> plan(0);
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+}
+
+void test_c2c(int num_threads) {
+  std::mt19937 rng(7);
+  HostFFT::Options options;
+  options.num_threads = num_threads;
+  // Contiguous rows, strided middle axes, unit axes and a Bluestein axis
+  const std::vector<std::vector<size_t>> shapes = {
+      {6, 5, 8}, {16, 1, 9}, {67, 4}, {3, 2, 2, 5}, {1000}};
+  for (const std::vector<size_t> &dims : shapes) {
+    const size_t batch = 3;
+    size_t volume = batch;
+    for (size_t n : dims) volume *= n;
+    std::vector<Complex> x = random_signal(volume, rng);
+    for (Direction direction : {Direction::kForward, Direction::kInverse}) {
+      std::vector<Complex> y(volume);
+      HostFFT::c2c(dims, batch, x.data(), y.data(), direction, options);
+      CHECK(relative_error(y, naive_dft(dims, batch, x, direction)) < 1e-12);
+    }
+
+    // Forward then inverse scales by the volume of one transform; in and
+    // out may alias
+    std::vector<Complex> y = x;
+    HostFFT::c2c(dims, batch, y.data(), y.data(), Direction::kForward, options);
+    HostFFT::c2c(dims, batch, y.data(), y.data(), Direction::kInverse, options);
+    for (Complex &v : y) v /= static_cast<double>(volume / batch);
+    CHECK(relative_error(y, x) < 1e-13);
+
+    // Float data, computed in double
+    std::vector<std::complex<float>> xf(volume), yf(volume);
+    for (size_t i = 0; i < volume; i++) {
+      xf[i] = std::complex<float>(x[i].real(), x[i].imag());
+      x[i] = Complex(xf[i].real(), xf[i].imag());
+    }
+    HostFFT::c2c(dims, batch, xf.data(), yf.data(), Direction::kForward, options);
+    CHECK(relative_error(yf, naive_dft(dims, batch, x, Direction::kForward)) < 1e-6);
+  }
+}
+
+void test_threads_agree() {
+  // Every line is transformed by the same code whichever worker runs it, so
+  // the shared pool gives bitwise the serial result
+  std::mt19937 rng(3);
+  const std::vector<size_t> dims = {12, 10, 14};
+  const size_t batch = 2, volume = batch * 12 * 10 * 14;
+  std::vector<Complex> x = random_signal(volume, rng);
+  std::vector<Complex> serial(volume);
+  HostFFT::Options options;
+  options.num_threads = 1;
+  HostFFT::c2c(dims, batch, x.data(), serial.data(), Direction::kForward, options);
+  for (int num_threads : {2, 3, 8}) {
+    options.num_threads = num_threads;
+    std::vector<Complex> parallel(volume);
+    HostFFT::c2c(dims, batch, x.data(), parallel.data(), Direction::kForward, options);
+    CHECK(parallel == serial);
+  }
+}
+
+void test_real(int num_threads) {
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<double> value(-1.0, 1.0);
+  HostFFT::Options options;
+  options.num_threads = num_threads;
+  const std::vector<std::vector<size_t>> shapes = {{16}, {15}, {4, 6}, {3, 5, 7}, {5, 67}};
+  for (const std::vector<size_t> &dims : shapes) {
+    const size_t batch = 2, n = dims.back(), half = n / 2 + 1;
+    const size_t rows = batch * HostFFT::Kernel::get_volume(dims) / n;
+    // cuFFT in-place padding of the real rows
+    const size_t pitch = 2 * half;
+    std::vector<double> x(rows * pitch, 99.0);
+    std::vector<Complex> full(rows * n);
+    for (size_t r = 0; r < rows; r++) {
+      for (size_t i = 0; i < n; i++) {
+        x[r * pitch + i] = value(rng);
+        full[r * n + i] = x[r * pitch + i];
+      }
+    }
+
+    // r2c is the first half of the last axis of the full c2c spectrum
+    std::vector<Complex> spectrum(rows * half);
+    HostFFT::r2c(dims, batch, x.data(), spectrum.data(), pitch, options);
+    std::vector<Complex> expected = naive_dft(dims, batch, full, Direction::kForward);
+    std::vector<Complex> expected_half(rows * half);
+    for (size_t r = 0; r < rows; r++) {
+      for (size_t k = 0; k < half; k++) expected_half[r * half + k] = expected[r * n + k];
+    }
+    CHECK(relative_error(spectrum, expected_half) < 1e-12);
+
+    // c2r inverts it up to the volume, and leaves the padding alone
+    std::vector<double> y(rows * pitch, -5.0);
+    HostFFT::c2r(dims, batch, spectrum.data(), y.data(), pitch, options);
+    const double volume = static_cast<double>(HostFFT::Kernel::get_volume(dims));
+    double error = 0;
+    for (size_t r = 0; r < rows; r++) {
+      for (size_t i = 0; i < n; i++) {
+        error = std::max(error, std::fabs(y[r * pitch + i] / volume - x[r * pitch + i]));
+      }
+      for (size_t i = n; i < pitch; i++) CHECK(y[r * pitch + i] == -5.0);
+    }
+    CHECK(error < 1e-13);
+
+    // c2r ignores the imaginary parts of the self-conjugate bins of rows
+    // which are real on their own
+    if (dims.size() == 1) {
+      std::vector<Complex> perturbed = spectrum;
+      for (size_t r = 0; r < rows; r++) {
+        perturbed[r * half] += Complex(0, 1);
+        if (n % 2 == 0) perturbed[r * half + half - 1] += Complex(0, 1);
+      }
+      std::vector<double> z(rows * pitch, -5.0);
+      HostFFT::c2r(dims, batch, perturbed.data(), z.data(), pitch, options);
+      for (size_t i = 0; i < z.size(); i++) CHECK(std::fabs(z[i] - y[i]) < 1e-12);
+    }
+
+    // Dense rows by default
+    std::vector<double> dense(rows * n);
+    for (size_t r = 0; r < rows; r++) {
+      for (size_t i = 0; i < n; i++) dense[r * n + i] = x[r * pitch + i];
+    }
+    std::vector<Complex> dense_spectrum(rows * half);
+    HostFFT::r2c(dims, batch, dense.data(), dense_spectrum.data(), 0, options);
+    CHECK(dense_spectrum == spectrum);
+  }
+}
+
+void test_invalid() {
+  std::vector<Complex> x(4);
+  bool thrown = false;
+  try {
+    HostFFT::c2c<double>({}, 1, x.data(), x.data(), Direction::kForward);
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  thrown = false;
+  try {
+    HostFFT::c2c<double>({4, 0}, 1, x.data(), x.data(), Direction::kForward);
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+}
+
+}  // namespace
+
+int main() {
+  test_plan1d();
+  test_c2c(1);
+  test_c2c(4);
+  test_threads_agree();
+  test_real(1);
+  test_real(3);
+  test_invalid();
+  return test_result("host_fft_test");
+}
@@ -0,0 +1,449 @@
+// Checks host_krylov.h: the IC0 and ILU0 factors reproduce A on its pattern,
+// zero pivots are reported, triangular solves invert their factor, CG with
+// IC0 and BiCGStab with ILU0 converge on small stencils, and every result is
+// bitwise the same with and without a thread pool.
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <utils/host_krylov.h>
+#include <utils/sparse_reorder.h>
+#include <utils/thread_pool.h>
+
+#include "test_check.h"
+
+namespace {
+
+using HostKrylov::CsrView;
+using HostKrylov::Factors;
+using HostKrylov::History;
+using HostKrylov::Triangular;
+using SparseReorder::Csr;
+
+CsrView view(const Csr &matrix) {
+  CsrView result;
+  result.num_rows = static_cast<int32_t>(matrix.row_offsets.size()) - 1;
+  result.row_offsets = matrix.row_offsets.data();
+  result.columns = matrix.columns.data();
+  result.values = matrix.values.data();
+  return result;
+}
+
+// 5-point stencil on a side x side grid: 4 on the diagonal, -1 - wind to the
+// west and north neighbours and -1 + wind to the east and south ones. wind = 0
+// gives the SPD Laplacian, wind != 0 a nonsymmetric convection-diffusion
+// operator.
+Csr stencil(int32_t side, double wind) {
+  Csr matrix;
+  matrix.row_offsets.assign(1, 0);
+  for (int32_t i = 0; i < side; i++) {
+    for (int32_t j = 0; j < side; j++) {
+      const int32_t row = i * side + j;
+      if (i > 0) {
+        matrix.columns.push_back(row - side);
+        matrix.values.push_back(-1.0 - wind);
+      }
+      if (j > 0) {
+        matrix.columns.push_back(row - 1);
+        matrix.values.push_back(-1.0 - wind);
+      }
+      matrix.columns.push_back(row);
+      matrix.values.push_back(4.0);
+      if (j + 1 < side) {
+        matrix.columns.push_back(row + 1);
+        matrix.values.push_back(-1.0 + wind);
+      }
+      if (i + 1 < side) {
+        matrix.columns.push_back(row + side);
+        matrix.values.push_back(-1.0 + wind);
+      }
+      matrix.row_offsets.push_back(static_cast<int32_t>(matrix.columns.size()));
+    }
+  }
+  return matrix;
+}
+
+// The matrix in a red-black order, so that the solves have a few wide levels
+// and take the parallel paths
+Csr colored(const Csr &matrix) {
+  const int32_t n = static_cast<int32_t>(matrix.row_offsets.size()) - 1;
+  std::vector<int32_t> perm =
+      SparseReorder::order(SparseReorder::Ordering::kColor, n,
+                           matrix.row_offsets.data(), matrix.columns.data());
+  return SparseReorder::permute(n, matrix.row_offsets.data(),
+                                matrix.columns.data(), matrix.values.data(),
+                                perm);
+}
+
+// Dense row-major copy of a triangle, its diagonal included
+std::vector<double> dense(const Triangular &factor) {
+  const int32_t n = factor.num_rows();
+  std::vector<double> result(size_t(n) * n, 0.0);
+  for (int32_t row = 0; row < n; row++) {
+    result[size_t(row) * n + row] = factor.diagonal[row];
+    for (int32_t idx = factor.row_offsets[row];
+         idx < factor.row_offsets[row + 1]; idx++) {
+      result[size_t(row) * n + factor.columns[idx]] = factor.values[idx];
+    }
+  }
+  return result;
+}
+
+// Transpose of a dense row-major n x n matrix
+std::vector<double> transposed(const std::vector<double> &matrix, int32_t n) {
+  std::vector<double> result(matrix.size());
+  for (int32_t row = 0; row < n; row++) {
+    for (int32_t col = 0; col < n; col++) {
+      result[size_t(col) * n + row] = matrix[size_t(row) * n + col];
+    }
+  }
+  return result;
+}
+
+// Largest |(lower * upper - A)(i, j)| over the pattern of A
+double product_error(const Csr &matrix, const Factors &factors) {
+  const int32_t n = static_cast<int32_t>(matrix.row_offsets.size()) - 1;
+  std::vector<double> lower = dense(factors.lower), upper = dense(factors.upper);
+  double error = 0.0;
+  for (int32_t row = 0; row < n; row++) {
+    for (int32_t idx = matrix.row_offsets[row];
+         idx < matrix.row_offsets[row + 1]; idx++) {
+      const int32_t col = matrix.columns[idx];
+      double sum = 0.0;
+      for (int32_t k = 0; k < n; k++) {
+        sum += lower[size_t(row) * n + k] * upper[size_t(k) * n + col];
+      }
+      error = std::max(error, std::fabs(sum - matrix.values[idx]));
+    }
+  }
+  return error;
+}
+
+bool is_triangle(const Triangular &factor, bool lower) {
+  for (int32_t row = 0; row < factor.num_rows(); row++) {
+    for (int32_t idx = factor.row_offsets[row];
+         idx < factor.row_offsets[row + 1]; idx++) {
+      const int32_t col = factor.columns[idx];
+      if (lower ? col >= row : col <= row) return false;
+    }
+  }
+  return true;
+}
+
+// Largest |factor * x - b| for x = solve(factor, b)
+double solve_error(const Triangular &factor, ThreadPool *pool) {
+  const int32_t n = factor.num_rows();
+  std::vector<double> b(n), x(n);
+  for (int32_t row = 0; row < n; row++) b[row] = std::sin(row + 1.0);
+  HostKrylov::solve(factor, b.data(), x.data(), pool);
+  std::vector<double> matrix = dense(factor);
+  double error = 0.0;
+  for (int32_t row = 0; row < n; row++) {
+    double sum = 0.0;
+    for (int32_t col = 0; col < n; col++) {
+      sum += matrix[size_t(row) * n + col] * x[col];
+    }
+    error = std::max(error, std::fabs(sum - b[row]));
+  }
+  return error;
+}
+
+Csr from_dense(int32_t n, const std::vector<double> &values) {
+  Csr matrix;
+  matrix.row_offsets.assign(1, 0);
+  for (int32_t row = 0; row < n; row++) {
+    for (int32_t col = 0; col < n; col++) {
+      if (values[size_t(row) * n + col] == 0.0) continue;
+      matrix.columns.push_back(col);
+      matrix.values.push_back(values[size_t(row) * n + col]);
+    }
+    matrix.row_offsets.push_back(static_cast<int32_t>(matrix.columns.size()));
+  }
+  return matrix;
+}
+
+// Random pattern with about density * n off-diagonal entries per row, values
+// in [-1, 0) and a diagonal dominant enough for the factorizations to exist;
+// symmetric if asked
+Csr random_dominant(int32_t n, double density, bool symmetric,
+                    std::mt19937 &rng) {
+  std::uniform_real_distribution<double> coin(0.0, 1.0);
+  std::vector<double> values(size_t(n) * n, 0.0);
+  for (int32_t row = 0; row < n; row++) {
+    for (int32_t col = symmetric ? row + 1 : 0; col < n; col++) {
+      if (col == row || coin(rng) >= density) continue;
+      values[size_t(row) * n + col] = coin(rng) - 1.0;
+      if (symmetric) values[size_t(col) * n + row] = values[size_t(row) * n + col];
+    }
+  }
+  for (int32_t row = 0; row < n; row++) {
+    double sum = 1.0;
+    for (int32_t col = 0; col < n; col++) {
+      sum += std::fabs(values[size_t(row) * n + col]);
+    }
+    values[size_t(row) * n + row] = sum;
+  }
+  return from_dense(n, values);
+}
+
+void test_factors() {
+  // IC0: L L^T matches A on the lower pattern, and by symmetry on all of it
+  Csr laplacian = stencil(9, 0.0);
+  Factors ic = HostKrylov::ic0(view(laplacian));
+  CHECK(ic.zero_pivot == -1);
+  CHECK(is_triangle(ic.lower, true) && is_triangle(ic.upper, false));
+  CHECK(dense(ic.upper) == transposed(dense(ic.lower), ic.lower.num_rows()));
+  CHECK(product_error(laplacian, ic) < 1e-12);
+  CHECK(solve_error(ic.lower, nullptr) < 1e-12);
+  CHECK(solve_error(ic.upper, nullptr) < 1e-12);
+
+  // ILU0: unit L, L U matches A on its pattern
+  Csr convection = stencil(9, 0.4);
+  Factors ilu = HostKrylov::ilu0(view(convection));
+  CHECK(ilu.zero_pivot == -1);
+  CHECK(is_triangle(ilu.lower, true) && is_triangle(ilu.upper, false));
+  bool unit = true;
+  for (double value : ilu.lower.diagonal) unit &= value == 1.0;
+  CHECK(unit);
+  CHECK(product_error(convection, ilu) < 1e-12);
+  CHECK(solve_error(ilu.lower, nullptr) < 1e-12);
+  CHECK(solve_error(ilu.upper, nullptr) < 1e-12);
+
+  // Rows that share columns, so that the updates from earlier rows are
+  // exercised
+  std::mt19937 rng(23);
+  for (int trial = 0; trial < 10; trial++) {
+    Csr spd = random_dominant(40, 0.15, true, rng);
+    Factors factors = HostKrylov::ic0(view(spd));
+    CHECK(factors.zero_pivot == -1);
+    CHECK(product_error(spd, factors) < 1e-12);
+    Csr general = random_dominant(40, 0.15, false, rng);
+    factors = HostKrylov::ilu0(view(general));
+    CHECK(factors.zero_pivot == -1);
+    CHECK(product_error(general, factors) < 1e-12);
+  }
+
+  // The levels of a factor hold every row once, after the rows it needs
+  for (const Triangular *factor : {&ilu.lower, &ilu.upper}) {
+    const int32_t n = factor->num_rows();
+    std::vector<int32_t> level_of(n, -1);
+    for (int32_t level = 0; level < factor->num_levels(); level++) {
+      for (int32_t idx = factor->level_offsets[level];
+           idx < factor->level_offsets[level + 1]; idx++) {
+        level_of[factor->level_rows[idx]] = level;
+      }
+    }
+    bool ordered = factor->level_offsets.back() == n;
+    for (int32_t row = 0; row < n; row++) {
+      for (int32_t idx = factor->row_offsets[row];
+           idx < factor->row_offsets[row + 1]; idx++) {
+        ordered &= level_of[factor->columns[idx]] < level_of[row];
+      }
+    }
+    CHECK(ordered);
+  }
+}
+
+void test_zero_pivot() {
+  // IC0: 1 - 2^2 < 0 in row 1, and a negative first pivot
+  Factors factors = HostKrylov::ic0(view(from_dense(2, {1.0, 2.0, 2.0, 1.0})));
+  CHECK(factors.zero_pivot == 1);
+  factors = HostKrylov::ic0(
+      view(from_dense(3, {-1.0, 0.0, 0.0, 0.0, 2.0, 0.0, 0.0, 0.0, -3.0})));
+  CHECK(factors.zero_pivot == 0);
+  // An exact zero counts too
+  factors = HostKrylov::ic0(view(from_dense(2, {1.0, 1.0, 1.0, 1.0})));
+  CHECK(factors.zero_pivot == 1);
+  // The first of several, with and without a pool
+  Csr indefinite = stencil(4, 0.0);
+  for (int32_t row : {5, 11}) {
+    for (int32_t idx = indefinite.row_offsets[row];
+         idx < indefinite.row_offsets[row + 1]; idx++) {
+      if (indefinite.columns[idx] == row) indefinite.values[idx] = -4.0;
+    }
+  }
+  ThreadPool pool(3);
+  CHECK(HostKrylov::ic0(view(indefinite)).zero_pivot == 5);
+  CHECK(HostKrylov::ic0(view(indefinite), &pool).zero_pivot == 5);
+
+  // ILU0: U(1, 1) = 1 - 1 * 1 = 0
+  factors = HostKrylov::ilu0(view(from_dense(2, {1.0, 1.0, 1.0, 1.0})));
+  CHECK(factors.zero_pivot == 1);
+  factors = HostKrylov::ilu0(view(from_dense(2, {2.0, 1.0, 1.0, 3.0})));
+  CHECK(factors.zero_pivot == -1);
+
+  // A row without a diagonal entry
+  bool thrown = false;
+  try {
+    HostKrylov::ilu0(view(from_dense(2, {1.0, 1.0, 1.0, 0.0})));
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+}
+
+// b = A * ones, x0 = 0; returns max |x - 1|
+template <typename Solver>
+double run(const Csr &matrix, const Factors &factors, Solver solver,
+           int max_iterations, History &history, std::vector<double> &x,
+           ThreadPool *pool) {
+  const CsrView A = view(matrix);
+  std::vector<double> ones(A.num_rows, 1.0), b(A.num_rows);
+  HostKrylov::spmv(A, 1.0, ones.data(), 0.0, b.data(), pool);
+  x.assign(A.num_rows, 0.0);
+  history = solver(A, factors, b.data(), x.data(), max_iterations, 1e-10, pool);
+  double error = 0.0;
+  for (double value : x) error = std::max(error, std::fabs(value - 1.0));
+  return error;
+}
+
+void test_convergence() {
+  Csr laplacian = stencil(20, 0.0);
+  History history;
+  std::vector<double> x;
+  double error = run(laplacian, HostKrylov::ic0(view(laplacian)),
+                     HostKrylov::cg, 1000, history, x, nullptr);
+  CHECK(history.first_iteration == 0);
+  CHECK(!history.norms.empty() && history.norms.size() < 1000);
+  CHECK(history.norms.front() == history.initial_norm);
+  CHECK(history.threshold == 1e-10 * history.initial_norm);
+  CHECK(history.final_norm < 1e-9 * history.initial_norm);
+  CHECK(error < 1e-8);
+
+  Csr convection = stencil(20, 0.4);
+  error = run(convection, HostKrylov::ilu0(view(convection)),
+              HostKrylov::bicgstab, 1000, history, x, nullptr);
+  CHECK(history.first_iteration == 1);
+  CHECK(!history.norms.empty() && history.norms.size() < 1000);
+  CHECK(history.norms.front() == history.initial_norm);
+  CHECK(history.final_norm < 1e-9 * history.initial_norm);
+  CHECK(error < 1e-8);
+
+  // The sample's output format
+  FILE *stream = std::tmpfile();
+  CHECK(stream != nullptr);
+  if (!stream) return;
+  History printed;
+  printed.initial_norm = 2.0;
+  printed.threshold = 2e-10;
+  printed.first_iteration = 1;
+  printed.norms = {2.0, 0.5};
+  printed.final_norm = 1e-11;
+  HostKrylov::print_history(printed, stream);
+  std::rewind(stream);
+  std::string text;
+  for (int c = std::fgetc(stream); c != EOF; c = std::fgetc(stream)) {
+    text += static_cast<char>(c);
+  }
+  std::fclose(stream);
+  CHECK(text ==
+        "  Initial Residual: Norm 2.000000e+00' threshold 2.000000e-10\n"
+        "  Iteration = 1; Error Norm = 2.000000e+00\n"
+        "  Iteration = 2; Error Norm = 5.000000e-01\n"
+        "Check Solution\n"
+        "Final error norm = 1.000000e-11\n");
+}
+
+void test_cg_steps() {
+  // The first two iterations of cg() written out with the same kernels, so
+  // that the order of the solves of step 2 and the update of P in step 11
+  // are pinned to those of gpu_CG
+  using namespace HostKrylov::Kernel;
+  Csr laplacian = stencil(6, 0.0);
+  const CsrView A = view(laplacian);
+  const int32_t m = A.num_rows;
+  Factors M = HostKrylov::ic0(A);
+  std::vector<double> b(m);
+  for (int32_t row = 0; row < m; row++) b[row] = 1.0 + row % 5;
+
+  std::vector<double> x(m, 0.0), R = b, R_aux(m), P(m), T(m), tmp(m);
+  HostKrylov::solve(M.upper, R.data(), tmp.data());
+  HostKrylov::solve(M.lower, tmp.data(), R_aux.data());
+  P = R_aux;
+  double delta = dot(nullptr, m, R.data(), R.data());
+  for (int i = 0; i < 2; i++) {
+    HostKrylov::spmv(A, 1.0, P.data(), 0.0, T.data());
+    const double alpha = delta / dot(nullptr, m, T.data(), P.data());
+    axpy(nullptr, m, alpha, P.data(), x.data());
+    axpy(nullptr, m, -alpha, T.data(), R.data());
+    HostKrylov::solve(M.lower, R.data(), tmp.data());
+    HostKrylov::solve(M.upper, tmp.data(), R_aux.data());
+    const double delta_new = dot(nullptr, m, R.data(), R_aux.data());
+    const double beta = delta_new / delta;
+    delta = delta_new;
+    for (int32_t row = 0; row < m; row++) P[row] = R_aux[row] + beta * R_aux[row];
+  }
+
+  std::vector<double> y(m, 0.0);
+  History history = HostKrylov::cg(A, M, b.data(), y.data(), 3, 0.0);
+  CHECK(history.norms.size() == 3);
+  CHECK(history.norms[1] < history.norms[0]);
+  // The third iteration moves x once more: compare after two
+  std::vector<double> z(m, 0.0);
+  HostKrylov::cg(A, M, b.data(), z.data(), 2, 0.0);
+  CHECK(z == x);
+  CHECK(y != x);
+}
+
+void test_pool() {
+  // Large enough for the parallel SpMV, reductions, factorizations and
+  // level solves: every result must be bitwise the serial one
+  ThreadPool pool(4);
+  const int max_iterations = 25;
+  for (double wind : {0.0, 0.3}) {
+    Csr matrix = colored(stencil(150, wind));
+    const CsrView A = view(matrix);
+    const bool symmetric = wind == 0.0;
+    Factors serial = symmetric ? HostKrylov::ic0(A) : HostKrylov::ilu0(A);
+    Factors parallel =
+        symmetric ? HostKrylov::ic0(A, &pool) : HostKrylov::ilu0(A, &pool);
+    CHECK(serial.lower.num_levels() <= 2 && serial.upper.num_levels() <= 2);
+    CHECK(serial.zero_pivot == parallel.zero_pivot);
+    CHECK(serial.lower.values == parallel.lower.values);
+    CHECK(serial.lower.diagonal == parallel.lower.diagonal);
+    CHECK(serial.upper.values == parallel.upper.values);
+    CHECK(serial.upper.diagonal == parallel.upper.diagonal);
+
+    std::vector<double> b(A.num_rows), y_serial(A.num_rows),
+        y_parallel(A.num_rows);
+    for (int32_t row = 0; row < A.num_rows; row++) b[row] = std::cos(row * 0.1);
+    HostKrylov::solve(serial.lower, b.data(), y_serial.data());
+    HostKrylov::solve(serial.lower, b.data(), y_parallel.data(), &pool);
+    CHECK(y_serial == y_parallel);
+    CHECK(HostKrylov::Kernel::dot(nullptr, A.num_rows, b.data(), b.data()) ==
+          HostKrylov::Kernel::dot(&pool, A.num_rows, b.data(), b.data()));
+
+    History history_serial, history_parallel;
+    std::vector<double> x_serial, x_parallel;
+    if (symmetric) {
+      run(matrix, serial, HostKrylov::cg, max_iterations, history_serial,
+          x_serial, nullptr);
+      run(matrix, serial, HostKrylov::cg, max_iterations, history_parallel,
+          x_parallel, &pool);
+    } else {
+      run(matrix, serial, HostKrylov::bicgstab, max_iterations, history_serial,
+          x_serial, nullptr);
+      run(matrix, serial, HostKrylov::bicgstab, max_iterations,
+          history_parallel, x_parallel, &pool);
+    }
+    CHECK(history_serial.norms.size() > 1);
+    CHECK(history_serial.norms == history_parallel.norms);
+    CHECK(history_serial.final_norm == history_parallel.final_norm);
+    CHECK(x_serial == x_parallel);
+  }
+}
+
+}  // namespace
+
+int main() {
+  test_factors();
+  test_zero_pivot();
+  test_convergence();
+  test_cg_steps();
+  test_pool();
+  return test_result("host_krylov_test");
+}
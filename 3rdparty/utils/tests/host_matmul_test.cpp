@@ -0,0 +1,359 @@
+// Checks compare() of host_matmul.h on fp16 and fp32 outputs, in particular
+// that an overflow against a finite reference is a mismatch, the type
+// conversions, and the blocked matmul against a naive loop for every
+// combination of input types, orders and ops, with padded leading
+// dimensions, batches, alpha, beta and thread counts.
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <utils/host_matmul.h>
+
+#include "test_check.h"
+
+namespace {
+
+using HostMatmul::ElementType;
+using HostMatmul::Order;
+
+HostMatmul::Comparison compare_half(const std::vector<float> &actual,
+                                    const std::vector<float> &expected) {
+  std::vector<uint16_t> half(actual.size());
+  for (size_t idx = 0; idx < actual.size(); idx++) {
+    half[idx] = HostMatmul::Convert::float_to_half(actual[idx]);
+  }
+  return HostMatmul::compare(
+      1, actual.size(), half.data(), ElementType::kHalf, expected.data(),
+      Order::kRow, actual.size(), actual.size(), 1,
+      HostMatmul::get_default_tolerance(ElementType::kHalf));
+}
+
+void test_compare() {
+  const float kInf = std::numeric_limits<float>::infinity();
+  const float kNaN = std::numeric_limits<float>::quiet_NaN();
+
+  // Within 2 ULPs, equal and NaN against NaN
+  HostMatmul::Comparison result =
+      compare_half({1.0f, 1.0f + 2 * 0x1p-10f, kNaN, -kInf},
+                   {1.0f, 1.0f, kNaN, -kInf});
+  CHECK(result.num_mismatches == 0);
+
+  // +Inf is one ULP above the largest finite fp16 value
+  result = compare_half({kInf}, {65504.0f});
+  CHECK(result.num_mismatches == 1);
+  CHECK(result.first_col == 0 && std::isinf(result.first_actual));
+  result = compare_half({-kInf}, {-65504.0f});
+  CHECK(result.num_mismatches == 1);
+
+  // A NaN against a finite reference
+  result = compare_half({1.0f, kNaN}, {1.0f, 1.0f});
+  CHECK(result.num_mismatches == 1 && result.first_col == 1);
+
+  // Too far off
+  result = compare_half({1.5f}, {1.0f});
+  CHECK(result.num_mismatches == 1);
+
+  // fp32 output with the same overflow
+  std::vector<float> actual = {kInf, 2.0f};
+  std::vector<float> expected = {std::numeric_limits<float>::max(), 2.0f};
+  result = HostMatmul::compare(
+      1, 2, actual.data(), ElementType::kFloat, expected.data(), Order::kRow,
+      2, 2, 1, HostMatmul::get_default_tolerance(ElementType::kFloat));
+  CHECK(result.num_mismatches == 1);
+}
+
+void test_matmul() {
+  const int64_t m = 13, n = 21, k = 17;
+  std::vector<float> a(m * k), b(k * n);
+  for (size_t idx = 0; idx < a.size(); idx++) a[idx] = (idx % 7) - 3.0f;
+  for (size_t idx = 0; idx < b.size(); idx++) b[idx] = (idx % 5) * 0.5f;
+  // A row major, B column major
+  HostMatmul::MatrixDesc desc_a = {a.data(), ElementType::kFloat, Order::kRow,
+                                   HostMatmul::Op::kN, k, m * k};
+  HostMatmul::MatrixDesc desc_b = {b.data(), ElementType::kFloat, Order::kCol,
+                                   HostMatmul::Op::kN, k, k * n};
+  std::vector<float> c(m * n, 0.0f);
+  HostMatmul::matmul(m, n, k, desc_a, desc_b, c.data(), Order::kRow, n, m * n);
+  std::vector<float> expected(m * n, 0.0f);
+  for (int64_t i = 0; i < m; i++) {
+    for (int64_t j = 0; j < n; j++) {
+      for (int64_t l = 0; l < k; l++) {
+        expected[i * n + j] += a[i * k + l] * b[l + j * k];
+      }
+    }
+  }
+  HostMatmul::Comparison result = HostMatmul::compare(
+      m, n, c.data(), ElementType::kFloat, expected.data(), Order::kRow, n,
+      m * n, 1, HostMatmul::get_default_tolerance(ElementType::kFloat));
+  CHECK(result.num_mismatches == 0);
+}
+
+void test_conversions() {
+  // Every finite fp16 and bf16 value converts to fp32 and back unchanged
+  bool round_trip = true;
+  for (uint32_t bits = 0; bits < 0x10000; bits++) {
+    uint16_t h = static_cast<uint16_t>(bits);
+    if ((h & 0x7c00) != 0x7c00) {
+      round_trip &= HostMatmul::Convert::float_to_half(
+                        HostMatmul::Convert::half_to_float(h)) == h;
+    }
+    if ((h & 0x7f80) != 0x7f80) {
+      round_trip &= HostMatmul::Convert::float_to_bfloat16(
+                        HostMatmul::Convert::bfloat16_to_float(h)) == h;
+    }
+  }
+  CHECK(round_trip);
+  // Ties round to even, and values past the largest fp16 to infinity
+  CHECK(HostMatmul::Convert::float_to_half(1.0f + 0x1p-11f) == 0x3c00);
+  CHECK(HostMatmul::Convert::float_to_half(1.0f + 3 * 0x1p-11f) == 0x3c02);
+  CHECK(HostMatmul::Convert::float_to_half(65520.0f) == 0x7c00);
+  CHECK(HostMatmul::Convert::float_to_half(65519.0f) == 0x7bff);
+  CHECK(HostMatmul::Convert::float_to_half(0x1p-25f) == 0);
+  CHECK(HostMatmul::Convert::float_to_half(0x1.8p-24f) == 2);
+
+  // fp8 extremes: e4m3 has no infinity and tops out at 448
+  CHECK(HostMatmul::Convert::fp8_to_float(0x7e, 4) == 448.0f);
+  CHECK(std::isnan(HostMatmul::Convert::fp8_to_float(0x7f, 4)));
+  CHECK(HostMatmul::Convert::fp8_to_float(0x01, 4) == 0x1p-9f);
+  CHECK(HostMatmul::Convert::fp8_to_float(0xb8, 4) == -1.0f);
+  CHECK(HostMatmul::Convert::fp8_to_float(0x7b, 5) == 57344.0f);
+  CHECK(std::isinf(HostMatmul::Convert::fp8_to_float(0x7c, 5)));
+  CHECK(std::isnan(HostMatmul::Convert::fp8_to_float(0x7d, 5)));
+  CHECK(HostMatmul::Convert::fp8_to_float(0x01, 5) == 0x1p-16f);
+}
+
+const ElementType kTypes[] = {ElementType::kFloat, ElementType::kHalf,
+                              ElementType::kBFloat16, ElementType::kInt8,
+                              ElementType::kInt32, ElementType::kE4M3,
+                              ElementType::kE5M2};
+
+// Stores value, an integer in [-3, 3], which every type holds exactly
+void store(std::vector<unsigned char> &data, ElementType type, int64_t idx,
+           float value) {
+  size_t size = HostMatmul::get_element_size(type);
+  unsigned char *dst = data.data() + idx * size;
+  switch (type) {
+    case ElementType::kFloat:
+      memcpy(dst, &value, size);
+      break;
+    case ElementType::kHalf: {
+      uint16_t h = HostMatmul::Convert::float_to_half(value);
+      memcpy(dst, &h, size);
+      break;
+    }
+    case ElementType::kBFloat16: {
+      uint16_t b = HostMatmul::Convert::float_to_bfloat16(value);
+      memcpy(dst, &b, size);
+      break;
+    }
+    case ElementType::kInt8:
+      *reinterpret_cast<int8_t *>(dst) = static_cast<int8_t>(value);
+      break;
+    case ElementType::kInt32: {
+      int32_t i = static_cast<int32_t>(value);
+      memcpy(dst, &i, size);
+      break;
+    }
+    default: {
+      int exponent_bits = type == ElementType::kE4M3 ? 4 : 5;
+      int v = 0;
+      while (HostMatmul::Convert::fp8_to_float(static_cast<uint8_t>(v),
+                                               exponent_bits) != value) {
+        v++;
+      }
+      *dst = static_cast<unsigned char>(v);
+      break;
+    }
+  }
+}
+
+// op(M) is rows x cols; returns the stored matrix, padded and batched,
+// filled with random integers in [-3, 3], and the values of op(M) per batch
+struct Operand {
+  std::vector<unsigned char> data;
+  std::vector<float> values;  // batch, then row major op(M)
+  HostMatmul::MatrixDesc desc;
+};
+
+Operand make_operand(std::mt19937 &rng, int64_t rows, int64_t cols,
+                     ElementType type, Order order, HostMatmul::Op op,
+                     int batch_count) {
+  auto uniform = [&](int lo, int hi) {
+    return std::uniform_int_distribution<int>(lo, hi)(rng);
+  };
+  bool transposed = op == HostMatmul::Op::kT;
+  int64_t stored_rows = transposed ? cols : rows;
+  int64_t stored_cols = transposed ? rows : cols;
+  int64_t ld = (order == Order::kRow ? stored_cols : stored_rows) +
+               uniform(0, 3);
+  int64_t batch_stride =
+      (order == Order::kRow ? stored_rows : stored_cols) * ld + uniform(0, 5);
+  Operand operand;
+  operand.data.assign(batch_stride * batch_count *
+                          HostMatmul::get_element_size(type),
+                      0);
+  operand.values.resize(rows * cols * batch_count);
+  for (int batch = 0; batch < batch_count; batch++) {
+    for (int64_t r = 0; r < rows; r++) {
+      for (int64_t c = 0; c < cols; c++) {
+        int64_t sr = transposed ? c : r;
+        int64_t sc = transposed ? r : c;
+        int64_t pos = batch * batch_stride +
+                      (order == Order::kRow ? sr * ld + sc : sr + sc * ld);
+        float value = static_cast<float>(uniform(-3, 3));
+        store(operand.data, type, pos, value);
+        operand.values[(batch * rows + r) * cols + c] = value;
+      }
+    }
+  }
+  operand.desc = {operand.data.data(), type, order, op, ld, batch_stride};
+  return operand;
+}
+
+// C = alpha * op(A) * op(B) + beta * C against a naive loop. Products and
+// sums of the small integers are exact in fp32 in any order, and so are the
+// scalings, so the result must match exactly; C outside the m x n matrices
+// must be left alone, and beta == 0 must not read C.
+bool check_matmul(std::mt19937 &rng, int64_t m, int64_t n, int64_t k,
+                  ElementType type_a, ElementType type_b, Order order_a,
+                  Order order_b, HostMatmul::Op op_a, HostMatmul::Op op_b) {
+  auto uniform = [&](int lo, int hi) {
+    return std::uniform_int_distribution<int>(lo, hi)(rng);
+  };
+  HostMatmul::Options options;
+  options.batch_count = uniform(1, 3);
+  options.num_threads = uniform(1, 4);
+  const float alphas[] = {1.0f, 0.5f, -2.0f};
+  const float betas[] = {0.0f, 1.0f, 0.25f};
+  options.alpha = alphas[uniform(0, 2)];
+  options.beta = betas[uniform(0, 2)];
+  Operand a = make_operand(rng, m, k, type_a, order_a, op_a,
+                           options.batch_count);
+  Operand b = make_operand(rng, k, n, type_b, order_b, op_b,
+                           options.batch_count);
+
+  Order c_order = uniform(0, 1) ? Order::kRow : Order::kCol;
+  int64_t ldc = (c_order == Order::kRow ? n : m) + uniform(0, 3);
+  int64_t c_batch_stride = (c_order == Order::kRow ? m : n) * ldc + uniform(0, 5);
+  const float kOutside = 12345.0f;
+  std::vector<float> c(c_batch_stride * options.batch_count, kOutside);
+  std::vector<float> expected = c;
+  for (int batch = 0; batch < options.batch_count; batch++) {
+    for (int64_t i = 0; i < m; i++) {
+      for (int64_t j = 0; j < n; j++) {
+        int64_t pos = batch * c_batch_stride +
+                      (c_order == Order::kRow ? i * ldc + j : i + j * ldc);
+        double sum = 0.0;
+        for (int64_t l = 0; l < k; l++) {
+          sum += static_cast<double>(a.values[(batch * m + i) * k + l]) *
+                 b.values[(batch * k + l) * n + j];
+        }
+        float initial = static_cast<float>(uniform(-3, 3));
+        c[pos] = options.beta == 0.0f
+                     ? std::numeric_limits<float>::quiet_NaN()
+                     : initial;
+        expected[pos] = static_cast<float>(
+            options.alpha * sum +
+            (options.beta == 0.0f ? 0.0 : options.beta * initial));
+      }
+    }
+  }
+  HostMatmul::matmul(m, n, k, a.desc, b.desc, c.data(), c_order, ldc,
+                     c_batch_stride, options);
+  return c == expected;
+}
+
+void test_combinations() {
+  std::mt19937 rng(13);
+  auto uniform = [&](int lo, int hi) {
+    return std::uniform_int_distribution<int>(lo, hi)(rng);
+  };
+  const Order orders[] = {Order::kRow, Order::kCol};
+  const HostMatmul::Op ops[] = {HostMatmul::Op::kN, HostMatmul::Op::kT};
+  int failures = 0;
+  for (ElementType type_a : kTypes) {
+    for (ElementType type_b : kTypes) {
+      for (Order order_a : orders) {
+        for (Order order_b : orders) {
+          for (HostMatmul::Op op_a : ops) {
+            for (HostMatmul::Op op_b : ops) {
+              failures += !check_matmul(rng, uniform(1, 20), uniform(1, 40),
+                                        uniform(1, 20), type_a, type_b,
+                                        order_a, order_b, op_a, op_b);
+            }
+          }
+        }
+      }
+    }
+  }
+  CHECK(failures == 0);
+
+  // Several tiles in m, n and k, partial micro-kernel blocks at the edges,
+  // and an empty k, which gives beta * C
+  failures = 0;
+  for (int idx = 0; idx < 8; idx++) {
+    failures += !check_matmul(rng, 101, 263, 300, kTypes[idx % 7],
+                              kTypes[(idx + 3) % 7], orders[idx % 2],
+                              orders[idx / 2 % 2], ops[idx / 4 % 2],
+                              ops[(idx + 1) % 2]);
+    failures += !check_matmul(rng, uniform(1, 30), uniform(1, 30), 0,
+                              kTypes[idx % 7], kTypes[idx % 7],
+                              orders[idx % 2], orders[idx % 2], ops[0],
+                              ops[1]);
+  }
+  CHECK(failures == 0);
+
+  // The overload returning C ignores beta and makes batches contiguous
+  Operand a = make_operand(rng, 7, 9, ElementType::kHalf, Order::kCol,
+                           HostMatmul::Op::kT, 2);
+  Operand b = make_operand(rng, 9, 5, ElementType::kInt8, Order::kRow,
+                           HostMatmul::Op::kN, 2);
+  HostMatmul::Options options;
+  options.batch_count = 2;
+  options.beta = 1.0f;
+  std::vector<float> c =
+      HostMatmul::matmul(7, 5, 9, a.desc, b.desc, Order::kRow, 6, options);
+  CHECK(c.size() == 2 * 7 * 6);
+  bool matches = true;
+  for (int batch = 0; batch < 2; batch++) {
+    for (int64_t i = 0; i < 7; i++) {
+      for (int64_t j = 0; j < 5; j++) {
+        float sum = 0.0f;
+        for (int64_t l = 0; l < 9; l++) {
+          sum += a.values[(batch * 7 + i) * 9 + l] *
+                 b.values[(batch * 9 + l) * 5 + j];
+        }
+        matches &= c[batch * 42 + i * 6 + j] == sum;
+      }
+    }
+  }
+  CHECK(matches);
+
+  // Negative sizes are rejected before either overload sizes or writes C
+  int thrown = 0;
+  try {
+    HostMatmul::matmul(-1, 5, 9, a.desc, b.desc, c.data(), Order::kRow, 6, 42);
+  } catch (const std::invalid_argument &) {
+    thrown++;
+  }
+  try {
+    HostMatmul::matmul(-1, 5, 9, a.desc, b.desc, Order::kRow, 6);
+  } catch (const std::invalid_argument &) {
+    thrown++;
+  }
+  CHECK(thrown == 2);
+}
+
+}  // namespace
+
+int main() {
+  test_compare();
+  test_conversions();
+  test_matmul();
+  test_combinations();
+  return test_result("host_matmul_test");
+}
@@ -0,0 +1,373 @@
+// Checks image_writer.h: byte-exact BMP, PPM and PNG files of a tiny known
+// image, the packing kernels against a per-pixel reference for planar and
+// interleaved sources in both channel orders, multi-block PNG streams, and the
+// asynchronous writer.
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <utils/image_writer.h>
+
+#include "test_check.h"
+
+namespace {
+
+using ImageWriter::ChannelOrder;
+using ImageWriter::Format;
+using ImageWriter::ImageView;
+
+typedef std::vector<unsigned char> Bytes;
+
+Bytes encode(const ImageView &image, Format format) {
+  Bytes result;
+  CHECK(ImageWriter::encode(image, format,
+                            [&](const unsigned char *data, size_t size) {
+                              result.insert(result.end(), data, data + size);
+                              return true;
+                            }));
+  return result;
+}
+
+Bytes read_file(const std::string &path) {
+  Bytes result;
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) return result;
+  unsigned char buffer[4096];
+  for (size_t size; (size = fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+    result.insert(result.end(), buffer, buffer + size);
+  }
+  fclose(file);
+  return result;
+}
+
+std::string make_temp_dir() {
+  const char *tmpdir = getenv("TMPDIR");
+  std::string pattern =
+      std::string(tmpdir ? tmpdir : "/tmp") + "/image_writer_test.XXXXXX";
+  std::vector<char> buffer(pattern.begin(), pattern.end());
+  buffer.push_back('\0');
+  return mkdtemp(buffer.data()) ? std::string(buffer.data()) : std::string();
+}
+
+// 3 x 2 image, RGB:
+//   (255, 0, 0) (0, 255, 0) (0, 0, 255)
+//   (1, 2, 3)   (4, 5, 6)   (7, 8, 9)
+// as planes with a pitch of 4, and interleaved with a pitch of 10
+const unsigned char kPlanes[3][8] = {{255, 0, 0, 99, 1, 4, 7, 99},
+                                     {0, 255, 0, 99, 2, 5, 8, 99},
+                                     {0, 0, 255, 99, 3, 6, 9, 99}};
+const unsigned char kInterleaved[20] = {255, 0, 0, 0, 255, 0, 0, 0, 255, 99,
+                                        1,   2, 3, 4, 5,   6, 7, 8, 9,   99};
+
+ImageView planar_view(ChannelOrder order) {
+  ImageView image;
+  image.width = 3;
+  image.height = 2;
+  image.order = order;
+  image.interleaved = false;
+  for (int c = 0; c < 3; c++) {
+    // BGR planes are the RGB planes listed in reverse
+    image.channel[c] = kPlanes[order == ChannelOrder::kRGB ? c : 2 - c];
+    image.pitch[c] = 4;
+  }
+  return image;
+}
+
+ImageView interleaved_view() {
+  ImageView image;
+  image.width = 3;
+  image.height = 2;
+  image.order = ChannelOrder::kRGB;
+  image.interleaved = true;
+  image.channel[0] = kInterleaved;
+  image.channel[1] = image.channel[2] = nullptr;
+  image.pitch[0] = 10;
+  image.pitch[1] = image.pitch[2] = 0;
+  return image;
+}
+
+void test_known_image() {
+  // Bottom-up BGR rows padded to 12 bytes after the 54-byte headers
+  const Bytes bmp = {
+      'B', 'M', 78, 0, 0, 0, 0, 0, 0, 0, 54, 0, 0, 0,  // file header
+      40, 0, 0, 0, 3, 0, 0, 0, 2, 0, 0, 0, 1, 0, 24, 0,
+      0, 0, 0, 0, 24, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0,                          // info header
+      3, 2, 1, 6, 5, 4, 9, 8, 7, 0, 0, 0,              // row 1
+      0, 0, 255, 0, 255, 0, 255, 0, 0, 0, 0, 0};       // row 0
+  std::string ppm_text = "P6\n3 2\n255\n";
+  Bytes ppm(ppm_text.begin(), ppm_text.end());
+  const unsigned char ppm_pixels[18] = {255, 0, 0, 0, 255, 0, 0, 0, 255,
+                                        1,   2, 3, 4, 5,   6, 7, 8, 9};
+  ppm.insert(ppm.end(), ppm_pixels, ppm_pixels + 18);
+  // Signature, IHDR, one IDAT with the zlib header, a final stored block of
+  // 20 bytes, the Adler-32 of the rows, and IEND; checked with zlib
+  const Bytes png = {
+      0x89, 'P',  'N',  'G',  '\r', '\n', 0x1A, '\n',
+      0,    0,    0,    13,   'I',  'H',  'D',  'R',  0,    0,    0,    3,
+      0,    0,    0,    2,    8,    2,    0,    0,    0,    0x12, 0x16, 0xF1,
+      0x4D,
+      0,    0,    0,    31,   'I',  'D',  'A',  'T',  0x78, 0x01, 0x01, 0x14,
+      0x00, 0xEB, 0xFF, 0,    255,  0,    0,    0,    255,  0,    0,    0,
+      255,  0,    1,    2,    3,    4,    5,    6,    7,    8,    9,    0x2D,
+      0x8C, 0x03, 0x2B, 0x91, 0x8F, 0x5A, 0x09,
+      0,    0,    0,    0,    'I',  'E',  'N',  'D',  0xAE, 0x42, 0x60, 0x82};
+
+  for (const ImageView &image :
+       {planar_view(ChannelOrder::kRGB), planar_view(ChannelOrder::kBGR),
+        interleaved_view()}) {
+    CHECK(encode(image, Format::kBMP) == bmp);
+    CHECK(encode(image, Format::kPPM) == ppm);
+    CHECK(encode(image, Format::kPNG) == png);
+  }
+
+  // The same bytes through a file
+  std::string dir = make_temp_dir();
+  CHECK(!dir.empty());
+  for (Format format : {Format::kBMP, Format::kPPM, Format::kPNG}) {
+    std::string path = ImageWriter::get_output_name(dir, "in/known.jpg", format);
+    CHECK(ImageWriter::write_image(path, interleaved_view(), format) == 0);
+    CHECK(read_file(path) == encode(interleaved_view(), format));
+    unlink(path.c_str());
+  }
+  rmdir(dir.c_str());
+  CHECK(ImageWriter::write_image("/nonexistent/dir/x.bmp", interleaved_view(),
+                                 Format::kBMP) == 1);
+
+  // A failing sink stops the encoder
+  for (Format format : {Format::kBMP, Format::kPPM, Format::kPNG}) {
+    int calls = 0;
+    CHECK(!ImageWriter::encode(interleaved_view(), format,
+                               [&](const unsigned char *, size_t) {
+                                 return ++calls < 2;
+                               }));
+    CHECK(calls == 2);
+  }
+}
+
+void test_checksums() {
+  const std::string check = "123456789";
+  const unsigned char *data =
+      reinterpret_cast<const unsigned char *>(check.data());
+  CHECK(ImageWriter::crc32(0, data, check.size()) == 0xCBF43926u);
+  // Chained over pieces
+  CHECK(ImageWriter::crc32(ImageWriter::crc32(0, data, 4), data + 4, 5) ==
+        0xCBF43926u);
+  const std::string wiki = "Wikipedia";
+  CHECK(ImageWriter::adler32(
+            1, reinterpret_cast<const unsigned char *>(wiki.data()),
+            wiki.size()) == 0x11E60398u);
+  // Past the 5552-byte runs, against the definition
+  std::vector<unsigned char> full(20000, 0xFF);
+  uint64_t a = 1, b = 0;
+  for (unsigned char byte : full) {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+  CHECK(ImageWriter::adler32(1, full.data(), full.size()) ==
+        uint32_t(b << 16 | a));
+}
+
+void test_packing() {
+  // Widths around the 16-pixel vector steps, rows with padding
+  std::mt19937 rng(8);
+  for (int width = 1; width <= 70; width++) {
+    const int height = 3;
+    const size_t pitch = 3 * width + 5;
+    std::vector<unsigned char> planes[3], interleaved(pitch * height);
+    for (int c = 0; c < 3; c++) {
+      planes[c].resize((width + 7) * height);
+      for (unsigned char &value : planes[c]) value = rng() & 0xFF;
+    }
+    for (unsigned char &value : interleaved) value = rng() & 0xFF;
+
+    for (ChannelOrder source : {ChannelOrder::kRGB, ChannelOrder::kBGR}) {
+      for (ChannelOrder target : {ChannelOrder::kRGB, ChannelOrder::kBGR}) {
+        ImageView planar = {width, height, source, false,
+                            {planes[0].data(), planes[1].data(),
+                             planes[2].data()},
+                            {size_t(width + 7), size_t(width + 7),
+                             size_t(width + 7)}};
+        ImageView packed = {width, height, source, true,
+                            {interleaved.data(), nullptr, nullptr},
+                            {pitch, 0, 0}};
+        const bool same = source == target;
+        for (int y = 0; y < height; y++) {
+          std::vector<unsigned char> out(3 * width + 1, 0xAB);
+          ImageWriter::pack_row(planar, y, target, out.data());
+          bool match = out.back() == 0xAB;
+          for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+              match &= out[3 * x + c] ==
+                       planes[same ? c : 2 - c][y * (width + 7) + x];
+            }
+          }
+          CHECK(match);
+
+          out.assign(3 * width + 1, 0xAB);
+          ImageWriter::pack_row(packed, y, target, out.data());
+          match = out.back() == 0xAB;
+          for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+              match &= out[3 * x + c] ==
+                       interleaved[y * pitch + 3 * x + (same ? c : 2 - c)];
+            }
+          }
+          CHECK(match);
+        }
+      }
+    }
+
+    // swap() works in place
+    std::vector<unsigned char> row(interleaved.begin(),
+                                   interleaved.begin() + 3 * width);
+    ImageWriter::Pack::swap(row.data(), width, row.data());
+    bool match = true;
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < 3; c++) match &= row[3 * x + c] == interleaved[3 * x + 2 - c];
+    }
+    CHECK(match);
+  }
+}
+
+uint32_t get_be(const Bytes &bytes, size_t at) {
+  return uint32_t(bytes[at]) << 24 | uint32_t(bytes[at + 1]) << 16 |
+         uint32_t(bytes[at + 2]) << 8 | bytes[at + 3];
+}
+
+void test_png_blocks() {
+  // 200 x 150: 90150 bytes of rows, two stored blocks in two IDAT chunks
+  const int width = 200, height = 150;
+  std::vector<unsigned char> pixels(3 * width * height);
+  for (size_t idx = 0; idx < pixels.size(); idx++) pixels[idx] = idx * 31 % 251;
+  ImageView image = {width, height, ChannelOrder::kRGB, true,
+                     {pixels.data(), nullptr, nullptr},
+                     {size_t(3 * width), 0, 0}};
+  Bytes png = encode(image, Format::kPNG);
+
+  // Walk the chunks, checking their CRCs, and unpack the stored blocks
+  Bytes zlib, raw;
+  std::vector<std::string> types;
+  size_t at = 8;
+  bool crc_ok = true;
+  while (at + 12 <= png.size()) {
+    uint32_t length = get_be(png, at);
+    types.push_back(std::string(png.begin() + at + 4, png.begin() + at + 8));
+    crc_ok &= ImageWriter::crc32(0, png.data() + at + 4, length + 4) ==
+              get_be(png, at + 8 + length);
+    if (types.back() == "IDAT") {
+      zlib.insert(zlib.end(), png.begin() + at + 8,
+                  png.begin() + at + 8 + length);
+    }
+    at += 12 + length;
+  }
+  CHECK(at == png.size());
+  CHECK(crc_ok);
+  CHECK(types == std::vector<std::string>({"IHDR", "IDAT", "IDAT", "IEND"}));
+  CHECK(zlib.size() > 6 && zlib[0] == 0x78 && zlib[1] == 0x01);
+  size_t pos = 2;
+  int blocks = 0;
+  for (bool last = false; !last && pos + 5 <= zlib.size(); blocks++) {
+    last = zlib[pos] == 1;
+    size_t length = zlib[pos + 1] | zlib[pos + 2] << 8;
+    size_t complement = zlib[pos + 3] | zlib[pos + 4] << 8;
+    CHECK(length == (~complement & 0xFFFF));
+    CHECK(last || length == 65535);
+    raw.insert(raw.end(), zlib.begin() + pos + 5,
+               zlib.begin() + pos + 5 + length);
+    pos += 5 + length;
+  }
+  CHECK(blocks == 2);
+  CHECK(pos + 4 == zlib.size());
+  CHECK(get_be(zlib, pos) == ImageWriter::adler32(1, raw.data(), raw.size()));
+  Bytes expected;
+  for (int y = 0; y < height; y++) {
+    expected.push_back(0);
+    expected.insert(expected.end(), pixels.begin() + 3 * width * y,
+                    pixels.begin() + 3 * width * (y + 1));
+  }
+  CHECK(raw == expected);
+
+  // A sink failing at any piece stops the encoder there
+  const int num_pieces = static_cast<int>(types.size()) + 1;
+  for (int fail = 1; fail <= num_pieces; fail++) {
+    int calls = 0;
+    CHECK(!ImageWriter::encode(image, Format::kPNG,
+                               [&](const unsigned char *, size_t) {
+                                 return ++calls < fail;
+                               }));
+    CHECK(calls == fail);
+  }
+}
+
+void test_async_writer() {
+  std::string dir = make_temp_dir();
+  CHECK(!dir.empty());
+  for (int num_threads : {0, 2}) {
+    ImageWriter::AsyncWriter writer(num_threads, 2);
+    std::vector<std::string> paths;
+    for (int idx = 0; idx < 6; idx++) {
+      ImageWriter::Job *job = writer.acquire_job();
+      job->format = idx % 2 ? Format::kPPM : Format::kBMP;
+      job->filename = ImageWriter::get_output_name(
+          dir, "image" + std::to_string(idx) + ".jpg", job->format);
+      job->storage.assign(kInterleaved, kInterleaved + sizeof(kInterleaved));
+      job->view = interleaved_view();
+      job->view.channel[0] = job->storage.data();
+      writer.submit(job);
+      paths.push_back(job->filename);
+    }
+    // An unwritable file counts as failed
+    ImageWriter::Job *job = writer.acquire_job();
+    job->format = Format::kBMP;
+    job->filename = dir + "/missing/x.bmp";
+    job->view = interleaved_view();
+    writer.submit(job);
+    // A released job is not written
+    job = writer.acquire_job();
+    job->filename = dir + "/released.bmp";
+    writer.release_job(job);
+    writer.wait();
+    CHECK(writer.get_num_failed() == 1);
+    for (int idx = 0; idx < 6; idx++) {
+      CHECK(read_file(paths[idx]) ==
+            encode(interleaved_view(), idx % 2 ? Format::kPPM : Format::kBMP));
+      unlink(paths[idx].c_str());
+    }
+    CHECK(access((dir + "/released.bmp").c_str(), F_OK) != 0);
+  }
+  rmdir(dir.c_str());
+}
+
+void test_names() {
+  for (Format format : {Format::kBMP, Format::kPPM, Format::kPNG}) {
+    Format parsed = Format::kBMP;
+    CHECK(ImageWriter::parse_format(ImageWriter::get_format_name(format),
+                                    parsed));
+    CHECK(parsed == format);
+  }
+  Format parsed = Format::kPNG;
+  CHECK(!ImageWriter::parse_format("jpg", parsed));
+  CHECK(parsed == Format::kPNG);
+  CHECK(ImageWriter::get_output_name("out", "a/b.c/img.jpg", Format::kPNG) ==
+        "out/img.png");
+  CHECK(ImageWriter::get_output_name("out", "img", Format::kPPM) ==
+        "out/img.ppm");
+}
+
+}  // namespace
+
+int main() {
+  test_known_image();
+  test_checksums();
+  test_packing();
+  test_png_blocks();
+  test_async_writer();
+  test_names();
+  return test_result("image_writer_test");
+}
@@ -0,0 +1,144 @@
+// Tests MtxReader::load on small files: pattern and real matrices with
+// duplicates and mirrored entries, the sidecar round trip, and sidecars
+// corrupted so that their arrays would index out of range.
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <utils/mtx_reader.h>
+
+#include "test_check.h"
+
+namespace {
+
+void write_file(const std::string &path, const std::string &text) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << text;
+}
+
+std::vector<int32_t> to_vector(const int32_t *data, size_t count) {
+  return std::vector<int32_t>(data, data + count);
+}
+
+// Overwrites the int32_t at byte offset in the sidecar
+void patch_cache(const std::string &path, size_t offset, int32_t value) {
+  FILE *file = fopen(path.c_str(), "r+b");
+  CHECK(file != nullptr);
+  if (!file) return;
+  fseek(file, static_cast<long>(offset), SEEK_SET);
+  fwrite(&value, sizeof(value), 1, file);
+  fclose(file);
+}
+
+void test_pattern() {
+  const std::string path = "mtx_reader_test_pattern.mtx";
+  std::remove((path + ".csr").c_str());
+  // The duplicate (1, 2) is a single nonzero
+  write_file(path,
+             "%%MatrixMarket matrix coordinate pattern general\n"
+             "3 4 3\n"
+             "1 2\n"
+             "3 1\n"
+             "1 2\n");
+  for (int pass = 0; pass < 2; pass++) {
+    MtxReader::Matrix matrix = MtxReader::load(path);
+    CHECK(matrix.from_cache() == (pass == 1));
+    CHECK(matrix.field() == MtxReader::Field::kPattern);
+    CHECK(matrix.num_rows() == 3 && matrix.num_cols() == 4);
+    CHECK(matrix.nnz() == 2);
+    CHECK(to_vector(matrix.row_offsets(), 4) == std::vector<int32_t>({0, 1, 1, 2}));
+    CHECK(to_vector(matrix.columns(), 2) == std::vector<int32_t>({1, 0}));
+    CHECK(matrix.values()[0] == 1.0 && matrix.values()[1] == 1.0);
+  }
+
+  // Two entries, without a cache, on several threads
+  write_file(path,
+             "%%MatrixMarket matrix coordinate pattern symmetric\n"
+             "2 2 2\n"
+             "2 1\n"
+             "2 2\n");
+  MtxReader::Options options;
+  options.use_cache = false;
+  options.num_threads = 3;
+  MtxReader::Matrix matrix = MtxReader::load(path, options);
+  CHECK(!matrix.from_cache());
+  CHECK(matrix.nnz() == 3);
+  CHECK(to_vector(matrix.row_offsets(), 3) == std::vector<int32_t>({0, 1, 3}));
+  CHECK(to_vector(matrix.columns(), 3) == std::vector<int32_t>({1, 0, 1}));
+  std::remove(path.c_str());
+}
+
+void test_real() {
+  const std::string path = "mtx_reader_test_real.mtx";
+  std::remove((path + ".csr").c_str());
+  write_file(path,
+             "%%MatrixMarket matrix coordinate real skew-symmetric\n"
+             "% comment\n"
+             "3 3 3\n"
+             "2 1 1.5\n"
+             "3 2 -2\n"
+             "2 1 0.5\n");
+  MtxReader::Matrix matrix = MtxReader::load(path);
+  CHECK(matrix.nnz() == 4);
+  CHECK(to_vector(matrix.row_offsets(), 4) == std::vector<int32_t>({0, 1, 3, 4}));
+  CHECK(to_vector(matrix.columns(), 4) == std::vector<int32_t>({1, 0, 2, 1}));
+  std::vector<double> values(matrix.values(), matrix.values() + 4);
+  CHECK(values == std::vector<double>({-2.0, 2.0, 2.0, -2.0}));
+  std::remove(path.c_str());
+  std::remove((path + ".csr").c_str());
+}
+
+// A sidecar whose header matches the source but whose arrays are corrupt is
+// ignored, and the source is parsed again
+void test_corrupt_cache() {
+  const std::string path = "mtx_reader_test_corrupt.mtx";
+  const std::string cache = path + ".csr";
+  write_file(path,
+             "%%MatrixMarket matrix coordinate real general\n"
+             "3 3 4\n"
+             "1 1 1\n"
+             "2 3 2\n"
+             "3 2 3\n"
+             "3 3 4\n");
+  std::remove(cache.c_str());
+  const std::vector<int32_t> offsets = {0, 1, 2, 4};
+  const std::vector<int32_t> columns = {0, 2, 1, 2};
+  MtxReader::Kernel::CacheLayout layout = MtxReader::Kernel::cache_layout(3, 4, 1);
+  const size_t offsets_at = sizeof(MtxReader::CacheHeader);
+
+  struct Corruption {
+    size_t offset;
+    int32_t value;
+  };
+  const Corruption corruptions[] = {
+      {offsets_at + 1 * sizeof(int32_t), 3},          // offsets go down
+      {offsets_at + 2 * sizeof(int32_t), -5},         // negative offset
+      {layout.columns + 1 * sizeof(int32_t), 3},      // column == num_cols
+      {layout.columns + 3 * sizeof(int32_t), -1},     // negative column
+      {layout.columns + 0 * sizeof(int32_t), 1 << 30}  // far out of range
+  };
+  for (const Corruption &corruption : corruptions) {
+    MtxReader::Matrix fresh = MtxReader::load(path);
+    CHECK(!fresh.from_cache());
+    CHECK(MtxReader::load(path).from_cache());
+    patch_cache(cache, corruption.offset, corruption.value);
+    MtxReader::Matrix matrix = MtxReader::load(path);
+    CHECK(!matrix.from_cache());
+    CHECK(to_vector(matrix.row_offsets(), 4) == offsets);
+    CHECK(to_vector(matrix.columns(), 4) == columns);
+    std::remove(cache.c_str());
+  }
+  std::remove(path.c_str());
+}
+
+}  // namespace
+
+int main() {
+  test_pattern();
+  test_real();
+  test_corrupt_cache();
+  return test_result("mtx_reader_test");
+}
@@ -0,0 +1,89 @@
+// Checks the cut points and the tiles of partition_csr.h against the input
+// matrix, including tile counts larger than the matrix extent.
+#include <vector>
+
+#include <utils/partition_csr.h>
+
+#include "test_check.h"
+
+namespace {
+
+// Every cut vector starts at 0, ends at extent and has non-empty ranges
+bool valid_cuts(const std::vector<int> &cuts, int extent) {
+  if (cuts.size() < 2 || cuts.front() != 0 || cuts.back() != extent) {
+    return false;
+  }
+  for (size_t idx = 1; idx < cuts.size(); idx++) {
+    if (cuts[idx] <= cuts[idx - 1]) return false;
+  }
+  return true;
+}
+
+void test_balanced_cuts() {
+  // Row weights 1, 1, 1, 1, 8, 8: the heavy rows get their own ranges
+  std::vector<long long> prefix = {0, 1, 2, 3, 4, 12, 20};
+  std::vector<int> cuts = PartitionCSR::get_balanced_cuts(prefix, 3);
+  CHECK(valid_cuts(cuts, 6));
+  CHECK(cuts == std::vector<int>({0, 4, 5, 6}));
+
+  // More tiles than rows: one range per row instead of an exception
+  cuts = PartitionCSR::get_balanced_cuts(prefix, 10);
+  CHECK(cuts == std::vector<int>({0, 1, 2, 3, 4, 5, 6}));
+  cuts = PartitionCSR::get_balanced_cuts(prefix, 0);
+  CHECK(cuts == std::vector<int>({0, 6}));
+
+  // An all-zero prefix still gives non-empty ranges
+  cuts = PartitionCSR::get_balanced_cuts(std::vector<long long>(9, 0), 4);
+  CHECK(valid_cuts(cuts, 8) && cuts.size() == 5);
+}
+
+void test_partition() {
+  // 4 x 5 matrix
+  //   1 . 2 . .
+  //   . . . 3 .
+  //   4 5 . . 6
+  //   . . . . 7
+  const int num_rows = 4, num_cols = 5;
+  std::vector<int> row_offsets = {0, 2, 3, 6, 7};
+  std::vector<int> column_indices = {0, 2, 3, 0, 1, 4, 4};
+  std::vector<float> values = {1, 2, 3, 4, 5, 6, 7};
+  PartitionCSR::Cuts cuts = PartitionCSR::get_balanced_cuts(
+      num_rows, num_cols, row_offsets.data(), column_indices.data(), 8, 8);
+  CHECK(valid_cuts(cuts.row_cuts, num_rows) && cuts.row_cuts.size() == 5);
+  CHECK(valid_cuts(cuts.col_cuts, num_cols) && cuts.col_cuts.size() == 6);
+
+  cuts = PartitionCSR::Cuts{.row_cuts = {0, 2, 4}, .col_cuts = {0, 2, 5}};
+  auto tiles = PartitionCSR::partition(num_rows, num_cols, row_offsets.data(),
+                                       column_indices.data(), values.data(),
+                                       cuts);
+  CHECK(tiles.size() == 4);
+  // Re-assemble the dense matrix from the tiles
+  std::vector<float> dense(num_rows * num_cols, 0.0f);
+  for (const auto &tile : tiles) {
+    for (int row = 0; row < tile.row_end - tile.row_begin; row++) {
+      for (int idx = tile.row_offsets[row]; idx < tile.row_offsets[row + 1];
+           idx++) {
+        int col = tile.col_begin + tile.column_indices[idx];
+        CHECK(col < tile.col_end);
+        dense[(tile.row_begin + row) * num_cols + col] = tile.values[idx];
+      }
+    }
+  }
+  std::vector<float> expected(num_rows * num_cols, 0.0f);
+  for (int row = 0; row < num_rows; row++) {
+    for (int idx = row_offsets[row]; idx < row_offsets[row + 1]; idx++) {
+      expected[row * num_cols + column_indices[idx]] = values[idx];
+    }
+  }
+  CHECK(dense == expected);
+  // Tile (1, 1) holds 6 and 7, at index i + j * num_row_tiles
+  CHECK(tiles[3].values == std::vector<float>({6, 7}));
+}
+
+}  // namespace
+
+int main() {
+  test_balanced_cuts();
+  test_partition();
+  return test_result("partition_csr_test");
+}
@@ -0,0 +1,349 @@
+// Checks sparse_reorder.h on small random matrices: inverse() and the
+// permutation of matrices and vectors, the levels of colour orderings, the
+// statistics of analyze() against brute-force references, and the bandwidth
+// RCM recovers from a shuffled banded matrix.
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <utils/sparse_reorder.h>
+#include <utils/thread_pool.h>
+
+#include "test_check.h"
+
+namespace {
+
+using SparseReorder::Csr;
+using SparseReorder::Ordering;
+
+// Dense pattern of an n x n matrix, row-major
+typedef std::vector<char> Pattern;
+
+Csr from_pattern(int32_t n, const Pattern &dense) {
+  Csr matrix;
+  matrix.row_offsets.assign(1, 0);
+  for (int32_t row = 0; row < n; row++) {
+    for (int32_t col = 0; col < n; col++) {
+      if (!dense[size_t(row) * n + col]) continue;
+      matrix.columns.push_back(col);
+      matrix.values.push_back(row * 1000.0 + col);
+    }
+    matrix.row_offsets.push_back(static_cast<int32_t>(matrix.columns.size()));
+  }
+  return matrix;
+}
+
+// Full diagonal and about density * n * n other entries, not symmetric
+Pattern random_pattern(int32_t n, double density, std::mt19937 &rng) {
+  std::uniform_real_distribution<double> coin(0.0, 1.0);
+  Pattern dense(size_t(n) * n, 0);
+  for (int32_t row = 0; row < n; row++) {
+    for (int32_t col = 0; col < n; col++) {
+      dense[size_t(row) * n + col] = row == col || coin(rng) < density;
+    }
+  }
+  return dense;
+}
+
+Pattern shuffle_pattern(int32_t n, const Pattern &dense,
+                        const std::vector<int32_t> &perm) {
+  Pattern result(dense.size());
+  for (int32_t row = 0; row < n; row++) {
+    for (int32_t col = 0; col < n; col++) {
+      result[size_t(row) * n + col] = dense[size_t(perm[row]) * n + perm[col]];
+    }
+  }
+  return result;
+}
+
+std::vector<int32_t> random_perm(int32_t n, std::mt19937 &rng) {
+  std::vector<int32_t> perm(n);
+  std::iota(perm.begin(), perm.end(), 0);
+  std::shuffle(perm.begin(), perm.end(), rng);
+  return perm;
+}
+
+bool valid_permutation(const std::vector<int32_t> &perm, int32_t n) {
+  std::vector<int32_t> sorted = perm;
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<int32_t> identity(n);
+  std::iota(identity.begin(), identity.end(), 0);
+  return sorted == identity;
+}
+
+// Nonzeros of the Cholesky factor by dense symbolic elimination of the
+// pattern of A + A^T
+int64_t brute_force_fill(int32_t n, const Pattern &dense) {
+  Pattern sym(dense.size());
+  for (int32_t row = 0; row < n; row++) {
+    for (int32_t col = 0; col < n; col++) {
+      sym[size_t(row) * n + col] =
+          dense[size_t(row) * n + col] || dense[size_t(col) * n + row];
+    }
+  }
+  int64_t fill = n;
+  for (int32_t k = 0; k < n; k++) {
+    std::vector<int32_t> below;
+    for (int32_t row = k + 1; row < n; row++) {
+      if (sym[size_t(row) * n + k]) below.push_back(row);
+    }
+    fill += static_cast<int64_t>(below.size());
+    for (int32_t i : below) {
+      for (int32_t j : below) sym[size_t(i) * n + j] = 1;
+    }
+  }
+  return fill;
+}
+
+// Levels of a triangular solve by repeated sweeps until nothing changes
+int64_t brute_force_levels(int32_t n, const Pattern &dense, bool lower) {
+  std::vector<int64_t> level(n, 0);
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (int32_t row = 0; row < n; row++) {
+      for (int32_t col = 0; col < n; col++) {
+        if (!dense[size_t(row) * n + col] || (lower ? col >= row : col <= row)) {
+          continue;
+        }
+        if (level[row] < level[col] + 1) {
+          level[row] = level[col] + 1;
+          changed = true;
+        }
+      }
+    }
+  }
+  return n ? *std::max_element(level.begin(), level.end()) + 1 : 0;
+}
+
+int64_t brute_force_bandwidth(int32_t n, const Pattern &dense) {
+  int64_t bandwidth = 0;
+  for (int32_t row = 0; row < n; row++) {
+    for (int32_t col = 0; col < n; col++) {
+      if (dense[size_t(row) * n + col]) {
+        bandwidth = std::max<int64_t>(bandwidth, std::abs(row - col));
+      }
+    }
+  }
+  return bandwidth;
+}
+
+SparseReorder::Stats analyze(int32_t n, const Csr &matrix) {
+  return SparseReorder::analyze(n, matrix.row_offsets.data(),
+                                matrix.columns.data());
+}
+
+std::vector<int32_t> order(Ordering ordering, int32_t n, const Csr &matrix) {
+  return SparseReorder::order(ordering, n, matrix.row_offsets.data(),
+                              matrix.columns.data());
+}
+
+void test_names() {
+  for (Ordering ordering :
+       {Ordering::kNone, Ordering::kRcm, Ordering::kAmd, Ordering::kColor}) {
+    Ordering parsed = Ordering::kNone;
+    CHECK(SparseReorder::parse_ordering(
+        SparseReorder::ordering_name(ordering), parsed));
+    CHECK(parsed == ordering);
+  }
+  Ordering parsed = Ordering::kRcm;
+  CHECK(!SparseReorder::parse_ordering("metis", parsed));
+  CHECK(parsed == Ordering::kRcm);
+}
+
+void test_inverse() {
+  std::mt19937 rng(22);
+  for (int32_t n : {0, 1, 7, 100}) {
+    std::vector<int32_t> perm = random_perm(n, rng);
+    std::vector<int32_t> position = SparseReorder::inverse(perm);
+    CHECK(position.size() == perm.size());
+    for (int32_t idx = 0; idx < n; idx++) {
+      CHECK(position[perm[idx]] == idx);
+      CHECK(perm[position[idx]] == idx);
+    }
+  }
+  // A repeated entry, and entries out of range
+  const std::vector<std::vector<int32_t>> invalid = {
+      {0, 1, 1}, {0, 3, 1}, {-1, 0, 1}};
+  for (const std::vector<int32_t> &perm : invalid) {
+    bool thrown = false;
+    try {
+      SparseReorder::inverse(perm);
+    } catch (const std::invalid_argument &) {
+      thrown = true;
+    }
+    CHECK(thrown);
+  }
+}
+
+void test_permute(ThreadPool *pool) {
+  std::mt19937 rng(5);
+  for (int32_t n : {1, 9, 60, 300}) {
+    Pattern dense = random_pattern(n, 0.05, rng);
+    Csr matrix = from_pattern(n, dense);
+    std::vector<int32_t> perm = random_perm(n, rng);
+    Csr result = SparseReorder::permute(n, matrix.row_offsets.data(),
+                                        matrix.columns.data(),
+                                        matrix.values.data(), perm, pool);
+
+    // A(perm, perm), entry by entry, with sorted columns
+    Csr expected = from_pattern(n, shuffle_pattern(n, dense, perm));
+    CHECK(result.row_offsets == expected.row_offsets);
+    CHECK(result.columns == expected.columns);
+    bool values_match = result.values.size() == expected.values.size();
+    for (int32_t row = 0; values_match && row < n; row++) {
+      for (int32_t idx = result.row_offsets[row];
+           idx < result.row_offsets[row + 1]; idx++) {
+        const int32_t col = result.columns[idx];
+        values_match &= result.values[idx] == perm[row] * 1000.0 + perm[col];
+      }
+    }
+    CHECK(values_match);
+
+    // Vectors go to the new order and back
+    std::vector<double> x(n), y(n), z(n, -1.0);
+    for (int32_t idx = 0; idx < n; idx++) x[idx] = idx * 0.5 + 1.0;
+    SparseReorder::permute_vector(perm, x.data(), y.data());
+    for (int32_t idx = 0; idx < n; idx++) CHECK(y[idx] == x[perm[idx]]);
+    SparseReorder::unpermute_vector(perm, y.data(), z.data());
+    CHECK(z == x);
+  }
+
+  std::vector<int32_t> row_offsets = {0, 1, 2};
+  std::vector<int32_t> columns = {0, 1};
+  std::vector<double> values = {1.0, 1.0};
+  bool thrown = false;
+  try {
+    SparseReorder::permute(2, row_offsets.data(), columns.data(),
+                           values.data(), std::vector<int32_t>(3, 0), pool);
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+}
+
+void test_analyze() {
+  std::mt19937 rng(11);
+  for (int trial = 0; trial < 40; trial++) {
+    const int32_t n = 1 + trial * 3;
+    Pattern dense = random_pattern(n, trial % 2 ? 0.03 : 0.12, rng);
+    SparseReorder::Stats stats = analyze(n, from_pattern(n, dense));
+    CHECK(stats.fill == brute_force_fill(n, dense));
+    CHECK(stats.lower_levels == brute_force_levels(n, dense, true));
+    CHECK(stats.upper_levels == brute_force_levels(n, dense, false));
+    CHECK(stats.bandwidth == brute_force_bandwidth(n, dense));
+  }
+
+  // Tridiagonal: no fill, one level per row. Arrow pointing up: the first
+  // elimination fills everything.
+  const int32_t n = 12;
+  Pattern tridiagonal(size_t(n) * n, 0), arrow(size_t(n) * n, 0);
+  for (int32_t row = 0; row < n; row++) {
+    for (int32_t col = std::max(0, row - 1); col <= std::min(n - 1, row + 1);
+         col++) {
+      tridiagonal[size_t(row) * n + col] = 1;
+    }
+    arrow[size_t(row) * n + row] = 1;
+    arrow[size_t(row) * n] = 1;
+    arrow[row] = 1;
+  }
+  SparseReorder::Stats stats = analyze(n, from_pattern(n, tridiagonal));
+  CHECK(stats.fill == 2 * n - 1);
+  CHECK(stats.lower_levels == n && stats.upper_levels == n);
+  CHECK(stats.bandwidth == 1);
+  stats = analyze(n, from_pattern(n, arrow));
+  CHECK(stats.fill == int64_t(n) * (n + 1) / 2);
+  CHECK(stats.lower_levels == 2 && stats.upper_levels == 2);
+}
+
+void test_orderings() {
+  std::mt19937 rng(3);
+  for (int trial = 0; trial < 20; trial++) {
+    const int32_t n = 10 + trial * 7;
+    Pattern dense = random_pattern(n, 0.04, rng);
+    Csr matrix = from_pattern(n, dense);
+    for (Ordering ordering :
+         {Ordering::kNone, Ordering::kRcm, Ordering::kAmd, Ordering::kColor}) {
+      CHECK(valid_permutation(order(ordering, n, matrix), n));
+    }
+
+    // Rows of one colour never touch each other, so every solve has at most
+    // one level per colour
+    SparseReorder::Graph graph = SparseReorder::symmetric_graph(
+        n, matrix.row_offsets.data(), matrix.columns.data());
+    int32_t num_colors = 0;
+    std::vector<int32_t> perm = SparseReorder::color(graph, &num_colors);
+    CHECK(perm == order(Ordering::kColor, n, matrix));
+    CHECK(num_colors >= 1 && num_colors <= n);
+    Pattern colored = shuffle_pattern(n, dense, perm);
+    SparseReorder::Stats stats = analyze(n, from_pattern(n, colored));
+    CHECK(stats.lower_levels <= num_colors);
+    CHECK(stats.upper_levels <= num_colors);
+  }
+}
+
+void test_rcm_band() {
+  // Every entry within half_band of the diagonal, rows shuffled: RCM starts
+  // from one end of the band and gets the band back
+  std::mt19937 rng(8);
+  const int32_t n = 200;
+  for (int32_t half_band : {1, 2, 5}) {
+    Pattern band(size_t(n) * n, 0);
+    for (int32_t row = 0; row < n; row++) {
+      for (int32_t col = std::max(0, row - half_band);
+           col <= std::min(n - 1, row + half_band); col++) {
+        band[size_t(row) * n + col] = 1;
+      }
+    }
+    Pattern shuffled = shuffle_pattern(n, band, random_perm(n, rng));
+    Csr matrix = from_pattern(n, shuffled);
+    CHECK(analyze(n, matrix).bandwidth > 10 * half_band);
+    std::vector<int32_t> perm = order(Ordering::kRcm, n, matrix);
+    CHECK(valid_permutation(perm, n));
+    Csr reordered = from_pattern(n, shuffle_pattern(n, shuffled, perm));
+    SparseReorder::Stats stats = analyze(n, reordered);
+    CHECK(stats.bandwidth == half_band);
+    // No fill outside the band either
+    CHECK(stats.fill == brute_force_fill(n, band));
+
+    // The graph of a full band is chordal: minimum degree always finds a
+    // node whose neighbours form a clique, and eliminates without fill
+    std::vector<int32_t> amd = order(Ordering::kAmd, n, matrix);
+    CHECK(analyze(n, matrix).fill > stats.fill);
+    CHECK(analyze(n, from_pattern(n, shuffle_pattern(n, shuffled, amd))).fill ==
+          stats.fill);
+  }
+
+  // Two components: each one is ordered on its own
+  Pattern two(size_t(n) * n, 0);
+  for (int32_t row = 0; row < n; row++) {
+    two[size_t(row) * n + row] = 1;
+    if (row + 2 < n) {
+      two[size_t(row) * n + row + 2] = 1;
+      two[size_t(row + 2) * n + row] = 1;
+    }
+  }
+  Csr matrix = from_pattern(n, two);
+  CHECK(analyze(n, matrix).bandwidth == 2);
+  std::vector<int32_t> perm = order(Ordering::kRcm, n, matrix);
+  CHECK(valid_permutation(perm, n));
+  CHECK(analyze(n, from_pattern(n, shuffle_pattern(n, two, perm))).bandwidth ==
+        1);
+}
+
+}  // namespace
+
+int main() {
+  test_names();
+  test_inverse();
+  test_permute(nullptr);
+  ThreadPool pool(4);
+  test_permute(&pool);
+  test_analyze();
+  test_orderings();
+  test_rcm_band();
+  return test_result("sparse_reorder_test");
+}
@@ -0,0 +1,28 @@
+#pragma once
+// Minimal checks for the host-only utils tests. A failed CHECK prints the
+// location and counts the failure; test_result() turns the count into the
+// exit code.
+#include <cstdio>
+
+inline int &test_failures() {
+  static int failures = 0;
+  return failures;
+}
+
+#define CHECK(cond)                                                      \
+  do {                                                                   \
+    if (!(cond)) {                                                       \
+      std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__,        \
+                   __LINE__, #cond);                                     \
+      test_failures()++;                                                 \
+    }                                                                    \
+  } while (0)
+
+inline int test_result(const char *name) {
+  if (test_failures() == 0) {
+    std::printf("%s: passed\n", name);
+    return 0;
+  }
+  std::printf("%s: %d check(s) failed\n", name, test_failures());
+  return 1;
+}
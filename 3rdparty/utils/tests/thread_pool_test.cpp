@@ -0,0 +1,108 @@
+// Stress test for ThreadPool: many more tasks than workers, repeated wait()
+// calls and tasks that submit tasks. Ends with a barrier that only passes
+// when every worker is still alive to take a task.
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <utils/thread_pool.h>
+
+#include "test_check.h"
+
+namespace {
+
+const size_t kWorkers = 8;
+
+// Single tasks with wait() in between: the pattern where a woken worker
+// finds its task already taken by another one
+void test_single_tasks(ThreadPool &pool) {
+  std::atomic<int> count{0};
+  for (int round = 0; round < 20000; round++) {
+    pool.enqueue([&count](int) { count.fetch_add(1); });
+    if (round % 3 == 0) pool.wait();
+  }
+  pool.wait();
+  CHECK(count.load() == 20000);
+}
+
+// Lets the workers fall asleep, then wakes all of them for fewer tasks than
+// workers, so most of them find nothing left to run
+void test_wake_all(ThreadPool &pool) {
+  std::atomic<int> count{0};
+  for (int round = 0; round < 50; round++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    pool.enqueue_batch(2, [&count](int, size_t) { count.fetch_add(1); });
+    pool.wait();
+  }
+  CHECK(count.load() == 100);
+}
+
+void test_batches(ThreadPool &pool) {
+  std::vector<std::atomic<int>> hits(1000);
+  for (int round = 0; round < 200; round++) {
+    size_t count = 1 + (round * 37) % hits.size();
+    for (size_t idx = 0; idx < count; idx++) hits[idx].store(0);
+    pool.enqueue_batch(count, [&hits](int worker, size_t idx) {
+      if (worker >= 0 && worker < static_cast<int>(kWorkers)) hits[idx]++;
+    });
+    pool.wait();
+    bool once = true;
+    for (size_t idx = 0; idx < count; idx++) once &= hits[idx].load() == 1;
+    CHECK(once);
+  }
+}
+
+void test_nested(ThreadPool &pool) {
+  std::atomic<int> count{0};
+  for (int round = 0; round < 100; round++) {
+    pool.enqueue_batch(16, [&pool, &count](int, size_t) {
+      pool.enqueue_batch(8, [&count](int, size_t) { count.fetch_add(1); });
+    });
+    pool.wait();
+  }
+  CHECK(count.load() == 100 * 16 * 8);
+}
+
+void test_futures(ThreadPool &pool) {
+  std::vector<std::future<size_t>> results;
+  for (size_t idx = 0; idx < 500; idx++) {
+    results.push_back(pool.enqueue([](int, size_t value) { return 2 * value; }, idx));
+  }
+  bool correct = true;
+  for (size_t idx = 0; idx < results.size(); idx++) correct &= results[idx].get() == 2 * idx;
+  CHECK(correct);
+  pool.wait();
+}
+
+// kWorkers tasks that each wait for all the others to start. Only passes
+// when no worker has left the pool.
+void test_all_workers_alive(ThreadPool &pool) {
+  std::atomic<size_t> arrived{0};
+  std::atomic<size_t> met{0};
+  pool.enqueue_batch(kWorkers, [&arrived, &met](int, size_t) {
+    arrived.fetch_add(1);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (arrived.load() < kWorkers && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+    if (arrived.load() == kWorkers) met.fetch_add(1);
+  });
+  pool.wait();
+  CHECK(met.load() == kWorkers);
+}
+
+}  // namespace
+
+int main() {
+  ThreadPool pool(kWorkers);
+  for (int repeat = 0; repeat < 3; repeat++) {
+    test_single_tasks(pool);
+    test_wake_all(pool);
+    test_batches(pool);
+    test_nested(pool);
+    test_futures(pool);
+    test_all_workers_alive(pool);
+  }
+  return test_result("thread_pool_test");
+}
@@ -0,0 +1,272 @@
+// Tests the TileScheduler policies on small task sets and replays each
+// assignment through issue_tasks() the way the partitioned drivers issue
+// it, with one clock per stream and one event per task.
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <utils/tile_scheduler.h>
+
+#include "test_check.h"
+
+using TileScheduler::Assignment;
+using TileScheduler::Policy;
+using TileScheduler::Task;
+
+namespace {
+
+const Policy kPolicies[] = {Policy::kRoundRobin, Policy::kLPT,
+                            Policy::kAffinity, Policy::kDependency};
+
+std::vector<Task> make_tasks(const std::vector<double> &costs,
+                             const std::vector<int> &blocks,
+                             bool accumulates = true) {
+  std::vector<Task> tasks;
+  for (size_t task = 0; task < costs.size(); task++) {
+    tasks.push_back(Task{.idx = {static_cast<int>(task), 0, 0},
+                         .cost = costs[task],
+                         .output_block = blocks[task],
+                         .accumulates = accumulates});
+  }
+  return tasks;
+}
+
+// Random-looking but fixed task set: nblocks chains of uneven length
+std::vector<Task> make_mixed_tasks(int ntasks, int nblocks) {
+  std::vector<double> costs;
+  std::vector<int> blocks;
+  for (int task = 0; task < ntasks; task++) {
+    costs.push_back(1 + (task * 7919) % 13);
+    blocks.push_back((task * task + 3 * task) % nblocks);
+  }
+  return make_tasks(costs, blocks);
+}
+
+struct Replay {
+  double makespan = 0.0;
+  int num_records = 0;
+  int num_waits = 0;
+  bool ordered = true;
+};
+
+// Issues the assignment on simulated streams: a stream runs its tasks in
+// issue order, and a wait delays the next task on the stream until the
+// recorded task has finished. Checks that every task starts after its
+// predecessor has finished.
+Replay replay(const std::vector<Task> &tasks, const Assignment &assignment) {
+  Replay result;
+  std::vector<double> stream_clock(assignment.nstreams, 0.0);
+  std::vector<double> finish(tasks.size(), -1.0);
+  std::vector<double> event_time(tasks.size(), -1.0);
+  TileScheduler::issue_tasks(
+      assignment,
+      [&](int task, int stream) {
+        int pred = assignment.predecessor[task];
+        if (pred >= 0 && (finish[pred] < 0 || finish[pred] > stream_clock[stream])) {
+          result.ordered = false;
+        }
+        finish[task] = stream_clock[stream] + tasks[task].cost;
+        stream_clock[stream] = finish[task];
+      },
+      [&](int task, int) {
+        result.num_records++;
+        event_time[task] = finish[task];
+      },
+      [&](int stream, int task) {
+        result.num_waits++;
+        // Waiting on an event that was never recorded would not order anything
+        if (event_time[task] < 0) result.ordered = false;
+        stream_clock[stream] = std::max(stream_clock[stream], event_time[task]);
+      });
+  for (double value : finish) {
+    if (value < 0) result.ordered = false;
+  }
+  result.makespan =
+      *std::max_element(stream_clock.begin(), stream_clock.end());
+  return result;
+}
+
+// Structural invariants every policy must satisfy
+void check_assignment(const std::vector<Task> &tasks,
+                      const Assignment &assignment) {
+  size_t ntasks = tasks.size();
+  CHECK(assignment.stream_of_task.size() == ntasks);
+  CHECK(assignment.issue_order.size() == ntasks);
+  std::vector<int> seen(ntasks, 0);
+  std::vector<int> position(ntasks, -1);
+  for (size_t pos = 0; pos < assignment.issue_order.size(); pos++) {
+    int task = assignment.issue_order[pos];
+    seen[task]++;
+    position[task] = pos;
+  }
+  bool permutation = true;
+  for (int count : seen) permutation &= count == 1;
+  CHECK(permutation);
+
+  size_t listed = 0;
+  bool lists_match = true;
+  for (int stream = 0; stream < assignment.nstreams; stream++) {
+    double load = 0.0;
+    for (int task : assignment.tasks_of_stream[stream]) {
+      lists_match &= assignment.stream_of_task[task] == stream;
+      load += tasks[task].cost;
+    }
+    listed += assignment.tasks_of_stream[stream].size();
+    lists_match &= std::fabs(load - assignment.stream_load[stream]) < 1e-9;
+  }
+  CHECK(lists_match);
+  CHECK(listed == ntasks);
+
+  // Chains follow the accumulating tasks of each block in canonical order
+  int cross_stream_edges = 0;
+  bool chains = true;
+  for (size_t task = 0; task < ntasks; task++) {
+    int pred = assignment.predecessor[task];
+    if (pred < 0) continue;
+    chains &= pred < static_cast<int>(task) && tasks[pred].accumulates &&
+              tasks[task].accumulates &&
+              tasks[pred].output_block == tasks[task].output_block &&
+              assignment.successor[pred] == static_cast<int>(task) &&
+              position[pred] < position[task];
+    for (int other = pred + 1; other < static_cast<int>(task); other++) {
+      chains &= !(tasks[other].accumulates &&
+                  tasks[other].output_block == tasks[task].output_block);
+    }
+    cross_stream_edges +=
+        assignment.stream_of_task[pred] != assignment.stream_of_task[task];
+  }
+  CHECK(chains);
+  CHECK(cross_stream_edges == assignment.cross_stream_edges);
+
+  Replay result = replay(tasks, assignment);
+  CHECK(result.ordered);
+  CHECK(result.num_records == assignment.cross_stream_edges);
+  CHECK(result.num_waits == assignment.cross_stream_edges);
+  double max_load = *std::max_element(assignment.stream_load.begin(),
+                                      assignment.stream_load.end());
+  if (assignment.policy == Policy::kDependency) {
+    // The drivers reproduce the simulated schedule exactly
+    CHECK(std::fabs(result.makespan - assignment.makespan) < 1e-9);
+  } else {
+    CHECK(assignment.makespan == max_load);
+    CHECK(result.makespan >= max_load);
+  }
+}
+
+void test_round_robin() {
+  std::vector<Task> tasks = make_mixed_tasks(23, 4);
+  Assignment assignment = TileScheduler::schedule(tasks, 3, Policy::kRoundRobin);
+  bool legacy = true;
+  for (size_t task = 0; task < tasks.size(); task++) {
+    legacy &= assignment.stream_of_task[task] == static_cast<int>(task % 3);
+    legacy &= assignment.issue_order[task] == static_cast<int>(task);
+  }
+  CHECK(legacy);
+  check_assignment(tasks, assignment);
+}
+
+void test_lpt() {
+  // LPT places 3, 3 on separate streams, then 2, 2 and the last 2: 7 vs 5
+  std::vector<Task> tasks =
+      make_tasks({2, 3, 2, 3, 2}, {0, 1, 2, 3, 4});
+  Assignment assignment = TileScheduler::schedule(tasks, 2, Policy::kLPT);
+  CHECK(assignment.makespan == 7.0);
+  CHECK(assignment.stream_of_task[1] != assignment.stream_of_task[3]);
+  check_assignment(tasks, assignment);
+
+  // Equal costs spread evenly
+  tasks = make_tasks(std::vector<double>(12, 1.0), std::vector<int>(12, 0),
+                     false);
+  assignment = TileScheduler::schedule(tasks, 4, Policy::kLPT);
+  CHECK(assignment.makespan == 3.0);
+  CHECK(TileScheduler::get_imbalance(assignment) == 1.0);
+  check_assignment(tasks, assignment);
+}
+
+void test_affinity() {
+  std::vector<Task> tasks = make_mixed_tasks(40, 6);
+  Assignment assignment = TileScheduler::schedule(tasks, 3, Policy::kAffinity);
+  CHECK(assignment.cross_stream_edges == 0);
+  bool same_stream = true;
+  for (size_t lhs = 0; lhs < tasks.size(); lhs++) {
+    for (size_t rhs = 0; rhs < tasks.size(); rhs++) {
+      if (tasks[lhs].output_block == tasks[rhs].output_block) {
+        same_stream &= assignment.stream_of_task[lhs] ==
+                       assignment.stream_of_task[rhs];
+      }
+    }
+  }
+  CHECK(same_stream);
+  check_assignment(tasks, assignment);
+}
+
+void test_dependency() {
+  // One chain of four unit tasks and four independent unit tasks on two
+  // streams: the chain bounds the makespan at 4, which list scheduling on
+  // the critical path reaches
+  std::vector<Task> tasks = make_tasks(std::vector<double>(8, 1.0),
+                                       {0, 1, 0, 2, 0, 3, 0, 4});
+  Assignment assignment = TileScheduler::schedule(tasks, 2, Policy::kDependency);
+  CHECK(assignment.makespan == 4.0);
+  check_assignment(tasks, assignment);
+
+  // A single chain cannot run faster than its total cost
+  tasks = make_tasks({1, 2, 3, 4}, {7, 7, 7, 7});
+  assignment = TileScheduler::schedule(tasks, 3, Policy::kDependency);
+  CHECK(assignment.makespan == 10.0);
+  check_assignment(tasks, assignment);
+}
+
+// Tasks writing private slices have no chains, so nothing is recorded or
+// waited on whatever the policy
+void test_private_outputs() {
+  std::vector<Task> tasks = make_mixed_tasks(30, 5);
+  for (auto &task : tasks) task.accumulates = false;
+  for (Policy policy : kPolicies) {
+    Assignment assignment = TileScheduler::schedule(tasks, 4, policy);
+    bool independent = true;
+    for (size_t task = 0; task < tasks.size(); task++) {
+      independent &= assignment.predecessor[task] < 0 &&
+                     assignment.successor[task] < 0;
+    }
+    CHECK(independent);
+    CHECK(assignment.cross_stream_edges == 0);
+    check_assignment(tasks, assignment);
+  }
+}
+
+void test_all_policies() {
+  for (int nstreams : {1, 2, 3, 5, 8}) {
+    for (int nblocks : {1, 3, 10, 40}) {
+      std::vector<Task> tasks = make_mixed_tasks(60, nblocks);
+      for (Policy policy : kPolicies) {
+        Assignment assignment = TileScheduler::schedule(tasks, nstreams, policy);
+        CHECK(assignment.policy == policy);
+        check_assignment(tasks, assignment);
+        if (nstreams == 1) CHECK(assignment.cross_stream_edges == 0);
+      }
+    }
+  }
+  std::vector<Task> empty;
+  Assignment assignment = TileScheduler::schedule(empty, 2, Policy::kDependency);
+  CHECK(assignment.issue_order.empty());
+}
+
+}  // namespace
+
+int main() {
+  test_round_robin();
+  test_lpt();
+  test_affinity();
+  test_dependency();
+  test_private_outputs();
+  test_all_policies();
+  bool threw = false;
+  try {
+    TileScheduler::schedule(make_mixed_tasks(4, 2), 0, Policy::kLPT);
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  CHECK(threw);
+  return test_result("tile_scheduler_test");
+}
@@ -0,0 +1,248 @@
+#pragma once
+// Work-stealing thread pool. Host-only.
+//
+// Every worker owns a deque: it pops its own tasks from the back and, once
+// that is empty, steals from the front of the other deques. Tasks submitted
+// from outside the pool are spread round-robin over the deques, so
+// submitters and workers rarely contend on the same lock. enqueue_batch()
+// pushes a whole index range with one lock per deque and one wake-up.
+//
+// Idle workers spin briefly, then sleep on a condition variable. Completion
+// is tracked by an atomic counter; wait() polls it and only blocks when the
+// pool is still busy after a short spin.
+//
+// Tasks receive the index of the worker that runs them, in [0, size()), so
+// that they can use per-worker state.
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+class ThreadPool {
+ public:
+  // With pin_threads, worker i is bound to the i-th CPU (modulo the CPU
+  // count) of the process affinity mask. Pinning is Linux only and ignored
+  // elsewhere.
+  explicit ThreadPool(size_t threads, bool pin_threads = false) {
+    if (threads == 0) throw std::invalid_argument("ThreadPool needs a thread");
+    for (size_t idx = 0; idx < threads; idx++) {
+      queues_.emplace_back(new Queue());
+    }
+    for (size_t idx = 0; idx < threads; idx++) {
+      workers_.emplace_back(&ThreadPool::worker, this, static_cast<int>(idx));
+    }
+    if (pin_threads) pin_workers();
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Runs the remaining tasks, then joins the workers
+  ~ThreadPool() {
+    {
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_) worker.join();
+  }
+
+  size_t size() const { return workers_.size(); }
+
+  // Queues f(worker_index, args...) and returns its future
+  template <class F, class... Args>
+  auto enqueue(F &&f, Args &&...args)
+      -> std::future<typename std::result_of<F(int, Args...)>::type> {
+    using return_type = typename std::result_of<F(int, Args...)>::type;
+    auto task = std::make_shared<std::packaged_task<return_type(int)>>(
+        std::bind(std::forward<F>(f), std::placeholders::_1,
+                  std::forward<Args>(args)...));
+    std::future<return_type> result = task->get_future();
+    unfinished_.fetch_add(1);
+    size_t queue = get_submit_queue();
+    {
+      std::unique_lock<std::mutex> lock(queues_[queue]->mutex);
+      queues_[queue]->tasks.emplace_back([task](int tid) { (*task)(tid); });
+    }
+    publish(1);
+    return result;
+  }
+
+  // Queues f(worker_index, idx) for idx in [0, count). Results are dropped
+  // and exceptions are not caught; use enqueue() when either matters.
+  template <class F>
+  void enqueue_batch(size_t count, F &&f) {
+    if (count == 0) return;
+    auto shared = std::make_shared<typename std::decay<F>::type>(
+        std::forward<F>(f));
+    unfinished_.fetch_add(count);
+    // Contiguous chunks, one per deque, starting at the round-robin cursor
+    size_t num_queues = queues_.size();
+    size_t first = get_submit_queue();
+    for (size_t chunk = 0; chunk < num_queues; chunk++) {
+      size_t begin = count * chunk / num_queues;
+      size_t end = count * (chunk + 1) / num_queues;
+      if (begin == end) continue;
+      Queue &queue = *queues_[(first + chunk) % num_queues];
+      std::unique_lock<std::mutex> lock(queue.mutex);
+      for (size_t idx = begin; idx < end; idx++) {
+        queue.tasks.emplace_back([shared, idx](int tid) { (*shared)(tid, idx); });
+      }
+    }
+    publish(count);
+  }
+
+  // Blocks until every queued task has finished
+  void wait() {
+    for (int spin = 0; spin < kSpinRounds; spin++) {
+      if (unfinished_.load() == 0) return;
+      std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(done_mutex_);
+    num_waiters_.fetch_add(1);
+    done_.wait(lock, [this]() { return unfinished_.load() == 0; });
+    num_waiters_.fetch_sub(1);
+  }
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void(int)>> tasks;
+    // Keeps neighboring queues on separate cache lines
+    char padding[64];
+  };
+
+  static const int kSpinRounds = 64;
+
+  // Own deque for submissions from a worker of this pool, round-robin
+  // otherwise
+  size_t get_submit_queue() {
+    if (current_pool() == this) return current_worker();
+    return next_queue_.fetch_add(1) % queues_.size();
+  }
+
+  // Makes count pushed tasks visible to sleeping workers
+  void publish(size_t count) {
+    pending_.fetch_add(count);
+    if (num_sleeping_.load() > 0) {
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      if (count == 1) {
+        wake_.notify_one();
+      } else {
+        wake_.notify_all();
+      }
+    }
+  }
+
+  bool pop(int self, std::function<void(int)> &task) {
+    {
+      Queue &own = *queues_[self];
+      std::unique_lock<std::mutex> lock(own.mutex);
+      if (!own.tasks.empty()) {
+        task = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        return true;
+      }
+    }
+    size_t num_queues = queues_.size();
+    for (size_t offset = 1; offset < num_queues; offset++) {
+      Queue &victim = *queues_[(self + offset) % num_queues];
+      std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+      if (lock.owns_lock() && !victim.tasks.empty()) {
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void worker(int self) {
+    current_pool() = this;
+    current_worker() = self;
+    std::function<void(int)> task;
+    for (;;) {
+      bool found = false;
+      for (int spin = 0; spin < kSpinRounds && !found; spin++) {
+        // try_to_lock may skip a busy victim; only trust an empty pass when
+        // nothing is pending
+        found = pending_.load() > 0 && pop(self, task);
+        if (!found) std::this_thread::yield();
+      }
+      if (!found) {
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        num_sleeping_.fetch_add(1);
+        wake_.wait(lock, [this]() { return stop_ || pending_.load() > 0; });
+        num_sleeping_.fetch_sub(1);
+        // Another worker may have taken the task that woke this one; only
+        // leave once the pool is stopping and drained
+        if (stop_ && pending_.load() == 0) return;
+        continue;
+      }
+      pending_.fetch_sub(1);
+      task(self);
+      task = nullptr;
+      if (unfinished_.fetch_sub(1) == 1 && num_waiters_.load() > 0) {
+        std::unique_lock<std::mutex> lock(done_mutex_);
+        done_.notify_all();
+      }
+    }
+  }
+
+  void pin_workers() {
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+    }
+    if (cpus.empty()) return;
+    for (size_t idx = 0; idx < workers_.size(); idx++) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpus[idx % cpus.size()], &set);
+      pthread_setaffinity_np(workers_[idx].native_handle(), sizeof(set), &set);
+    }
+#endif
+  }
+
+  static const ThreadPool *&current_pool() {
+    static thread_local const ThreadPool *pool = nullptr;
+    return pool;
+  }
+
+  static int &current_worker() {
+    static thread_local int worker = -1;
+    return worker;
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+  std::atomic<size_t> next_queue_{0};
+  // Tasks pushed but not yet popped
+  std::atomic<size_t> pending_{0};
+  // Tasks pushed but not yet finished
+  std::atomic<size_t> unfinished_{0};
+  std::atomic<int> num_sleeping_{0};
+  std::atomic<int> num_waiters_{0};
+  bool stop_ = false;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  std::mutex done_mutex_;
+  std::condition_variable done_;
+};
@@ -0,0 +1,318 @@
+#pragma once
+// Tile-to-stream scheduling for the partitioned bench_* drivers. Host-only.
+//
+// A driver describes every tile product as a Task (its loop indices, an
+// estimated cost such as flop or nnz, and the output block it contributes
+// to) in its canonical issue order, and asks a policy for an Assignment.
+// Tasks that accumulate into a shared output block in place form a chain in
+// canonical order: each one must run after its predecessor. The driver
+// issues the tasks in issue_order and, when a predecessor ran on another
+// stream, makes the task's stream wait on an event recorded after it.
+// Policies
+//   round_robin  canonical task index modulo nstreams (the legacy mapping)
+//   lpt          longest-processing-time-first: tasks sorted by decreasing
+//                cost, each placed on the currently least loaded stream
+//   affinity     all tasks of one output block on the same stream, blocks
+//                placed by LPT on their total cost, so that no output block
+//                needs a cross-stream event
+//   dependency   list scheduling on the chain critical path, where a task
+//                starts after its predecessor finishes, possibly on another
+//                stream
+#include <utils/helper_string.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace TileScheduler {
+enum class Policy { kRoundRobin, kLPT, kAffinity, kDependency };
+
+struct Task {
+  // Loop indices of the tile product, e.g., {i, j, l}
+  std::array<int, 3> idx;
+  // Estimated cost in arbitrary but consistent units
+  double cost;
+  // Tasks with the same output_block contribute to the same output tile
+  int output_block;
+  // The task adds into its output tile in place, so it depends on the
+  // previous task of the block. False when every task writes a private
+  // slice that is reduced afterwards.
+  bool accumulates = true;
+};
+
+struct Assignment {
+  Policy policy;
+  int nstreams;
+  // Stream of each task, indexed like the task vector
+  std::vector<int> stream_of_task;
+  // Tasks of each stream, in canonical order except for the dependency
+  // policy, which lists them in simulated start order
+  std::vector<std::vector<int>> tasks_of_stream;
+  // Previous accumulating task of the same output block, or -1 for the first
+  // one and for tasks that do not accumulate
+  std::vector<int> predecessor;
+  // Next task of the chain, or -1
+  std::vector<int> successor;
+  // Order in which the driver issues the tasks: canonical order except for
+  // the dependency policy, which issues them in simulated start order. Every
+  // task comes after its predecessor.
+  std::vector<int> issue_order;
+  std::vector<double> stream_load;
+  // Estimated completion time of the slowest stream, from the task costs.
+  // For the dependency policy it includes the waits on predecessors; for the
+  // others it is the largest stream load.
+  double makespan;
+  // Chain edges whose two tasks run on different streams. The driver makes
+  // the successor wait on an event for each of them.
+  int cross_stream_edges;
+};
+
+const char *get_policy_name(Policy policy) {
+  switch (policy) {
+    case Policy::kLPT:
+      return "lpt";
+    case Policy::kAffinity:
+      return "affinity";
+    case Policy::kDependency:
+      return "dependency";
+    default:
+      return "round_robin";
+  }
+}
+
+Policy parse_policy(const std::string &str) {
+  if (str == "round_robin") return Policy::kRoundRobin;
+  if (str == "lpt") return Policy::kLPT;
+  if (str == "affinity") return Policy::kAffinity;
+  if (str == "dependency") return Policy::kDependency;
+  throw std::invalid_argument("unknown schedule policy \"" + str + "\"");
+}
+
+void print_schedule_usage() {
+  printf(
+      "Schedule options: [--schedule=round_robin|lpt|affinity|dependency] "
+      "[--print_schedule]\n"
+      "--schedule picks how tiles are mapped to streams (default "
+      "round_robin)\n"
+      "--print_schedule prints the tile-to-stream assignment\n");
+}
+
+Policy parse_policy(const int argc, const char **argv) {
+  char *policy_str = nullptr;
+  if (getCmdLineArgumentString(argc, argv, "schedule", &policy_str)) {
+    return parse_policy(policy_str);
+  }
+  return Policy::kRoundRobin;
+}
+
+// Index of the smallest element; ties go to the lowest index so that the
+// assignment is deterministic
+int get_argmin(const std::vector<double> &values) {
+  return std::min_element(values.begin(), values.end()) - values.begin();
+}
+
+void assign_round_robin(const std::vector<Task> &tasks,
+                        Assignment &assignment) {
+  for (size_t task = 0; task < tasks.size(); task++) {
+    assignment.stream_of_task[task] = task % assignment.nstreams;
+  }
+}
+
+// Places groups of tasks, largest total cost first, on the least loaded stream
+void assign_groups_lpt(const std::vector<Task> &tasks,
+                       const std::vector<std::vector<int>> &groups,
+                       Assignment &assignment) {
+  std::vector<double> group_cost(groups.size(), 0.0);
+  for (size_t group = 0; group < groups.size(); group++) {
+    for (int task : groups[group]) group_cost[group] += tasks[task].cost;
+  }
+  std::vector<int> order(groups.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int lhs, int rhs) {
+    return group_cost[lhs] > group_cost[rhs];
+  });
+  std::vector<double> load(assignment.nstreams, 0.0);
+  for (int group : order) {
+    int stream = get_argmin(load);
+    load[stream] += group_cost[group];
+    for (int task : groups[group]) assignment.stream_of_task[task] = stream;
+  }
+}
+
+// Critical-path list scheduling of the output block chains
+void assign_dependency(const std::vector<Task> &tasks,
+                       Assignment &assignment) {
+  // Remaining chain cost from each task to the end of its chain
+  std::vector<double> tail(tasks.size(), 0.0);
+  const std::vector<int> &successor = assignment.successor;
+  for (int task = static_cast<int>(tasks.size()) - 1; task >= 0; task--) {
+    tail[task] = tasks[task].cost +
+                 (successor[task] >= 0 ? tail[successor[task]] : 0.0);
+  }
+  // Ready tasks ordered by longest tail, then by canonical index
+  auto lower_priority = [&](int lhs, int rhs) {
+    if (tail[lhs] != tail[rhs]) return tail[lhs] < tail[rhs];
+    return lhs > rhs;
+  };
+  std::priority_queue<int, std::vector<int>, decltype(lower_priority)> ready(
+      lower_priority);
+  for (size_t task = 0; task < tasks.size(); task++) {
+    if (assignment.predecessor[task] < 0) ready.push(task);
+  }
+  std::vector<double> stream_free(assignment.nstreams, 0.0);
+  std::vector<double> finish(tasks.size(), 0.0);
+  while (!ready.empty()) {
+    int task = ready.top();
+    ready.pop();
+    double release = assignment.predecessor[task] >= 0
+                         ? finish[assignment.predecessor[task]]
+                         : 0.0;
+    // Earliest start; prefer the predecessor stream on ties to save an event
+    int best_stream = 0;
+    double best_start = INFINITY;
+    for (int stream = 0; stream < assignment.nstreams; stream++) {
+      double start = std::max(stream_free[stream], release);
+      bool is_pred_stream =
+          assignment.predecessor[task] >= 0 &&
+          assignment.stream_of_task[assignment.predecessor[task]] == stream;
+      if (start < best_start || (start == best_start && is_pred_stream)) {
+        best_start = start;
+        best_stream = stream;
+      }
+    }
+    assignment.stream_of_task[task] = best_stream;
+    finish[task] = best_start + tasks[task].cost;
+    stream_free[best_stream] = finish[task];
+    assignment.tasks_of_stream[best_stream].push_back(task);
+    assignment.issue_order.push_back(task);
+    if (successor[task] >= 0) ready.push(successor[task]);
+  }
+  assignment.makespan =
+      *std::max_element(stream_free.begin(), stream_free.end());
+}
+
+Assignment schedule(const std::vector<Task> &tasks, int nstreams,
+                    Policy policy) {
+  if (nstreams < 1) throw std::invalid_argument("nstreams must be positive");
+  Assignment assignment{.policy = policy,
+                        .nstreams = nstreams,
+                        .stream_of_task = std::vector<int>(tasks.size(), 0),
+                        .tasks_of_stream =
+                            std::vector<std::vector<int>>(nstreams),
+                        .predecessor = std::vector<int>(tasks.size(), -1),
+                        .successor = std::vector<int>(tasks.size(), -1),
+                        .issue_order = std::vector<int>(),
+                        .stream_load = std::vector<double>(nstreams, 0.0),
+                        .makespan = 0.0,
+                        .cross_stream_edges = 0};
+  std::map<int, std::vector<int>> tasks_of_block;
+  std::map<int, int> last_of_block;
+  for (size_t task = 0; task < tasks.size(); task++) {
+    tasks_of_block[tasks[task].output_block].push_back(task);
+    if (!tasks[task].accumulates) continue;
+    auto last = last_of_block.find(tasks[task].output_block);
+    if (last != last_of_block.end()) {
+      assignment.predecessor[task] = last->second;
+      assignment.successor[last->second] = task;
+    }
+    last_of_block[tasks[task].output_block] = task;
+  }
+
+  switch (policy) {
+    case Policy::kLPT: {
+      std::vector<std::vector<int>> singletons(tasks.size());
+      for (size_t task = 0; task < tasks.size(); task++) {
+        singletons[task] = {static_cast<int>(task)};
+      }
+      assign_groups_lpt(tasks, singletons, assignment);
+      break;
+    }
+    case Policy::kAffinity: {
+      std::vector<std::vector<int>> blocks;
+      for (auto &keyval : tasks_of_block) blocks.push_back(keyval.second);
+      assign_groups_lpt(tasks, blocks, assignment);
+      break;
+    }
+    case Policy::kDependency:
+      assign_dependency(tasks, assignment);
+      break;
+    default:
+      assign_round_robin(tasks, assignment);
+  }
+
+  for (size_t task = 0; task < tasks.size(); task++) {
+    int stream = assignment.stream_of_task[task];
+    assignment.stream_load[stream] += tasks[task].cost;
+    if (policy != Policy::kDependency) {
+      assignment.tasks_of_stream[stream].push_back(task);
+      assignment.issue_order.push_back(task);
+    }
+    int pred = assignment.predecessor[task];
+    if (pred >= 0 && assignment.stream_of_task[pred] != stream) {
+      assignment.cross_stream_edges++;
+    }
+  }
+  if (policy != Policy::kDependency) {
+    assignment.makespan = *std::max_element(assignment.stream_load.begin(),
+                                            assignment.stream_load.end());
+  }
+  return assignment;
+}
+
+// Walks the tasks in issue order. issue(task, stream) launches a task. When
+// the successor of a task runs on another stream, record(task, stream) is
+// called right after the task is issued, and wait(stream, task) right before
+// the successor is issued on its stream. With CUDA streams, record and wait
+// map to cudaEventRecord and cudaStreamWaitEvent on a per-task event.
+template <class Issue, class Record, class Wait>
+void issue_tasks(const Assignment &assignment, Issue &&issue, Record &&record,
+                 Wait &&wait) {
+  for (int task : assignment.issue_order) {
+    int stream = assignment.stream_of_task[task];
+    int pred = assignment.predecessor[task];
+    if (pred >= 0 && assignment.stream_of_task[pred] != stream) {
+      wait(stream, pred);
+    }
+    issue(task, stream);
+    int succ = assignment.successor[task];
+    if (succ >= 0 && assignment.stream_of_task[succ] != stream) {
+      record(task, stream);
+    }
+  }
+}
+
+// Makespan divided by the ideal makespan total_cost / nstreams; 1 is perfectly
+// balanced
+double get_imbalance(const Assignment &assignment) {
+  double total = std::accumulate(assignment.stream_load.begin(),
+                                 assignment.stream_load.end(), 0.0);
+  if (total == 0.0) return 1.0;
+  return assignment.makespan * assignment.nstreams / total;
+}
+
+void print_assignment(const std::vector<Task> &tasks,
+                      const Assignment &assignment) {
+  printf(
+      "schedule(%s) nstreams(%d) estimated_makespan(%f) imbalance(%f) "
+      "cross_stream_edges(%d)\n",
+      get_policy_name(assignment.policy), assignment.nstreams,
+      assignment.makespan, get_imbalance(assignment),
+      assignment.cross_stream_edges);
+  for (int stream = 0; stream < assignment.nstreams; stream++) {
+    printf("stream %d load(%f):", stream, assignment.stream_load[stream]);
+    for (int task : assignment.tasks_of_stream[stream]) {
+      printf(" (%d,%d,%d)", tasks[task].idx[0], tasks[task].idx[1],
+             tasks[task].idx[2]);
+    }
+    printf("\n");
+  }
+}
+}  // namespace TileScheduler
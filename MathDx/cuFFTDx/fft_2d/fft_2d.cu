@@ -10,6 +10,7 @@
 #include "block_io.hpp"
 #include "block_io_strided.hpp"
 #include "common.hpp"
+#include "host_reference.hpp"
 #include "random.hpp"
 
 // #define CUFFTDX_EXAMPLE_DETAIL_DEBUG_FFT_2D
@@ -330,6 +331,22 @@ void fft_2d() {
             success = (fft_error.l2_relative_error < 0.001);
         }
     }
+    // Check cuFFT and cuFFTDx against the host reference, computed without the GPU
+    {
+        const auto host_reference = example::get_host_fft_c2c_reference(input_host, {fft_size_x, fft_size_y});
+        auto check_host_reference = [&](const char* name, const std::vector<complex_type>& output) {
+            auto fft_error = example::fft_signal_error::calculate_for_complex_values(output, host_reference);
+            std::cout << name << " vs host reference\n";
+            std::cout << "L2 error: " << fft_error.l2_relative_error << "\n";
+            std::cout << "Peak error (index: " << fft_error.peak_error_index << "): " << fft_error.peak_error << "\n";
+            if(success) {
+                success = (fft_error.l2_relative_error < 0.001);
+            }
+        };
+        check_host_reference("cuFFT", cufft_results.output);
+        check_host_reference("cuFFTDx", cufftdx_results.output);
+        check_host_reference("cuFFTDx (shared memory IO)", cufftdx_smemio_results.output);
+    }
 
     // Print performance results
     if(success) {
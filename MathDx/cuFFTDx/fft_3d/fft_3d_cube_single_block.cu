@@ -7,6 +7,7 @@
 
 #include "block_io.hpp"
 #include "common.hpp"
+#include "host_reference.hpp"
 #include "random.hpp"
 
 // #define CUFFTDX_EXAMPLE_DETAIL_DEBUG_FFT_3D
@@ -201,6 +202,11 @@ int main(int, char**) {
     // Check if cuFFTDx results are correct
     auto fft_error = example::fft_signal_error::calculate_for_complex_values(cufftdx_output, cufft_output);
 
+    // Check cuFFT and cuFFTDx against the host reference, computed without the GPU
+    auto host_reference = example::get_host_fft_c2c_reference(host_input, {fft_size, fft_size, fft_size});
+    auto cufft_host_error = example::fft_signal_error::calculate_for_complex_values(cufft_output, host_reference);
+    auto cufftdx_host_error = example::fft_signal_error::calculate_for_complex_values(cufftdx_output, host_reference);
+
 #ifdef CUFFTDX_EXAMPLE_DETAIL_DEBUG_FFT_3D
     std::cout << "cuFFT, cuFFTDx\n";
     for (size_t i = 0; i < 8; i++) {
@@ -215,8 +221,11 @@ int main(int, char**) {
     std::cout << "Correctness results:\n";
     std::cout << "L2 error: " << fft_error.l2_relative_error << "\n";
     std::cout << "Peak error (index: " << fft_error.peak_error_index << "): " << fft_error.peak_error << "\n";
+    std::cout << "cuFFT vs host reference L2 error: " << cufft_host_error.l2_relative_error << "\n";
+    std::cout << "cuFFTDx vs host reference L2 error: " << cufftdx_host_error.l2_relative_error << "\n";
 
-    if(fft_error.l2_relative_error < 0.001) {
+    if(fft_error.l2_relative_error < 0.001 && cufft_host_error.l2_relative_error < 0.001 &&
+       cufftdx_host_error.l2_relative_error < 0.001) {
         std::cout << "Success\n";
         return 0;
     } else {
@@ -0,0 +1,56 @@
+#ifndef MATHDX_CUFFTDX_EXAMPLE_HOST_REFERENCE_HPP
+#define MATHDX_CUFFTDX_EXAMPLE_HOST_REFERENCE_HPP
+
+#include <complex>
+#include <vector>
+#include <type_traits>
+
+#include <utils/host_fft.h>
+
+namespace example {
+    // Host references computed in double precision by HostFFT, independently of cuFFT and of the GPU, with the cuFFT
+    // conventions: row major dimensions (the last one contiguous) and unnormalized inverse transforms. Complex values
+    // are of any type with x and y members, such as float2 or cufftdx::complex<float>.
+
+    // C2C transform of batch arrays of shape dims
+    template<class T>
+    inline std::vector<T> get_host_fft_c2c_reference(const std::vector<T>&      input,
+                                                     const std::vector<size_t>& dims,
+                                                     bool                       inverse = false,
+                                                     size_t                     batch   = 1) {
+        using value_type = typename std::remove_cv<decltype(T::x)>::type;
+        std::vector<std::complex<double>> values(input.size());
+        for (size_t i = 0; i < input.size(); i++) {
+            values[i] = std::complex<double>(input[i].x, input[i].y);
+        }
+        HostFFT::c2c(dims,
+                     batch,
+                     values.data(),
+                     values.data(),
+                     inverse ? HostFFT::Direction::kInverse : HostFFT::Direction::kForward);
+        std::vector<T> output(input.size());
+        for (size_t i = 0; i < output.size(); i++) {
+            output[i].x = static_cast<value_type>(values[i].real());
+            output[i].y = static_cast<value_type>(values[i].imag());
+        }
+        return output;
+    }
+
+    // R2C transform followed by the C2R transform of its result, of batch real arrays of shape dims
+    template<class T>
+    inline std::vector<T> get_host_fft_r2c_c2r_reference(const std::vector<T>&      input,
+                                                         const std::vector<size_t>& dims,
+                                                         size_t                     batch = 1) {
+        std::vector<double> values(input.begin(), input.end());
+        std::vector<std::complex<double>> spectrum(values.size() / dims.back() * (dims.back() / 2 + 1));
+        HostFFT::r2c(dims, batch, values.data(), spectrum.data());
+        HostFFT::c2r(dims, batch, spectrum.data(), values.data());
+        std::vector<T> output(input.size());
+        for (size_t i = 0; i < output.size(); i++) {
+            output[i] = static_cast<T>(values[i]);
+        }
+        return output;
+    }
+} // namespace example
+
+#endif // MATHDX_CUFFTDX_EXAMPLE_HOST_REFERENCE_HPP
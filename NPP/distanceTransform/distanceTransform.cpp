@@ -49,13 +49,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 
 #include <nppdefs.h>
 #include <nppcore.h>
 #include <nppi_filtering_functions.h>
 
+#include "distance_transform_host.h"
+
 // Set path to whereever your source image files are located.
 // In this sample output files are output at the same path location.
 const std::string & Path = std::string("../images/");
@@ -259,6 +266,52 @@ void shutDown()
     }
 }
 
+// Transforms image pInput on the host and compares the device results with it. The device may pick another site at
+// the same distance, so a Voronoi site only mismatches when it is not a site or lies farther away.
+bool checkWithHost(DistanceTransformHost::Engine & oHostEngine, const char * szName, const Npp8u * pInput, NppiSize oSize,
+                   Npp8u nMinSiteValue, Npp8u nMaxSiteValue, const Npp16s * pVoronoi, const Npp32f * pTransform,
+                   const Npp16u * pTruncated)
+{
+    size_t nPixels = static_cast<size_t>(oSize.width) * oSize.height;
+    std::vector<Npp16s> aVoronoi(2 * nPixels);
+    std::vector<Npp32f> aTransform(nPixels);
+    std::vector<Npp16u> aTruncated(nPixels);
+
+    auto oStart = std::chrono::steady_clock::now();
+    oHostEngine.transform(pInput, oSize.width * sizeof(Npp8u), oSize.width, oSize.height, nMinSiteValue, nMaxSiteValue,
+                          aVoronoi.data(), oSize.width * 2 * sizeof(Npp16s),
+                          aTransform.data(), oSize.width * sizeof(Npp32f),
+                          aTruncated.data(), oSize.width * sizeof(Npp16u));
+    std::chrono::duration<double, std::milli> oHostTime = std::chrono::steady_clock::now() - oStart;
+
+    float nMaxError = 0.0f;
+    size_t nTruncatedMismatches = 0;
+    size_t nVoronoiMismatches = 0;
+    for (int y = 0; y < oSize.height; y++)
+    {
+        for (int x = 0; x < oSize.width; x++)
+        {
+            size_t i = static_cast<size_t>(y) * oSize.width + x;
+            nMaxError = std::max(nMaxError, std::fabs(pTransform[i] - aTransform[i]));
+            nTruncatedMismatches += pTruncated[i] != aTruncated[i];
+
+            int nSiteX = pVoronoi[2 * i];
+            int nSiteY = pVoronoi[2 * i + 1];
+            int nHostDx = x - aVoronoi[2 * i];
+            int nHostDy = y - aVoronoi[2 * i + 1];
+            bool bSite = nSiteX >= 0 && nSiteY >= 0 && nSiteX < oSize.width && nSiteY < oSize.height &&
+                         pInput[nSiteY * oSize.width + nSiteX] >= nMinSiteValue &&
+                         pInput[nSiteY * oSize.width + nSiteX] <= nMaxSiteValue;
+            if (!bSite || (x - nSiteX) * (x - nSiteX) + (y - nSiteY) * (y - nSiteY) !=
+                          nHostDx * nHostDx + nHostDy * nHostDy)
+                nVoronoiMismatches++;
+        }
+    }
+    printf("%s host check: %.3f ms on %zu threads, max 32f error %g, 16u mismatches %zu, Voronoi mismatches %zu.\n",
+           szName, oHostTime.count(), oHostEngine.threadCount(), nMaxError, nTruncatedMismatches, nVoronoiMismatches);
+    return nMaxError <= 1e-3f && nTruncatedMismatches == 0 && nVoronoiMismatches == 0;
+}
+
 // Since NPP is a very large library you should statically link to it whenever possible and only to the NPP libraries that
 // contain functions that you use along with nppcore (nppc).  This will eliminate what can be significant library load times when using dynamic libraries.
 
@@ -436,8 +489,8 @@ int main(int argc,char **argv)
     }
 
     if (nppiDistanceTransformPBA_8u32f_C1R_Ctx(pInputImage1_8u_Device, oImageSizeROI[1].width * sizeof(Npp8u), nMinSiteValue, nMaxSiteValue,
-                                               0, 0, 0, 0, 
                                                pOutputVoronoiDiagram1_16s_Device, oImageSizeROI[1].width * 2 * sizeof(Npp16s),
+                                               0, 0, 0, 0, 
                                                pOutputTransformImage1_32f_Device, oImageSizeROI[1].width * sizeof(Npp32f),
                                                oImageSizeROI[1], pScratchDeviceBuffer[3], nppStreamCtx) != NPP_SUCCESS)
     {
@@ -517,10 +570,10 @@ int main(int argc,char **argv)
                                   oImageSizeROI[0].width * 2 * sizeof(Npp16s), oImageSizeROI[0].height, 
                                   cudaMemcpyDeviceToHost, nppStreamCtx.hStream); 
 
-    // Copy back image1 true transform result
+    // Copy back image0 true transform result
     cudaError = cudaMemcpy2DAsync(pOutputTransformImage0_32f_Host, oImageSizeROI[0].width * sizeof(Npp32f),
-                                  pOutputTransformImage0_32f_Device, oImageSizeROI[1].width * sizeof(Npp32f), 
-                                  oImageSizeROI[1].width * sizeof(Npp32f), oImageSizeROI[1].height, 
+                                  pOutputTransformImage0_32f_Device, oImageSizeROI[0].width * sizeof(Npp32f), 
+                                  oImageSizeROI[0].width * sizeof(Npp32f), oImageSizeROI[0].height, 
                                   cudaMemcpyDeviceToHost, nppStreamCtx.hStream); 
 
     // Copy back image1 true truncated transform result
@@ -537,6 +590,25 @@ int main(int argc,char **argv)
         return -1;
     }
 
+    // Check the device results against the host transform, which also shows what the same transforms cost on the CPU
+    bool bHostCheckPassed = true;
+    try
+    {
+        DistanceTransformHost::Engine oHostEngine;
+        bHostCheckPassed &= checkWithHost(oHostEngine, "Dolphin1", pInputImage0_8u_Host, oImageSizeROI[0],
+                                          nMinSiteValue, nMaxSiteValue, pOutputVoronoiDiagram0_16s_Host,
+                                          pOutputTransformImage0_32f_Host, pOutputTruncatedImage0_16u_Host);
+        bHostCheckPassed &= checkWithHost(oHostEngine, "TestImage3", pInputImage1_8u_Host, oImageSizeROI[1],
+                                          nMinSiteValue, nMaxSiteValue, pOutputVoronoiDiagram1_16s_Host,
+                                          pOutputTransformImage1_32f_Host, pOutputTruncatedImage1_16u_Host);
+    }
+    catch (const std::exception & oError)
+    {
+        printf("Host distance transform failed: %s\n", oError.what());
+        shutDown();
+        return -1;
+    }
+
     FILE * rawOutputFile;
     size_t nSize = 0;
 
@@ -567,7 +639,7 @@ int main(int argc,char **argv)
     nSize = 0;
     for (int j = 0; j < oImageSizeROI[1].height; j++)
     {
-        nSize += fwrite(&pOutputVoronoiDiagram1_16s_Host[j * oImageSizeROI[1].width * 2], 2 * sizeof(Npp16s), 2 * oImageSizeROI[1].width, rawOutputFile);
+        nSize += fwrite(&pOutputVoronoiDiagram1_16s_Host[j * oImageSizeROI[1].width * 2], sizeof(Npp16s), 2 * oImageSizeROI[1].width, rawOutputFile);
     }
     fclose(rawOutputFile);
 
@@ -638,6 +710,6 @@ int main(int argc,char **argv)
     std::cout << "Done!" << std::endl;
     shutDown();
 
-    return 0;
+    return bHostCheckPassed ? 0 : -1;
 }
 
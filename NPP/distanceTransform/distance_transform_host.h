@@ -0,0 +1,299 @@
+#pragma once
+
+// Host exact Euclidean distance transform engine for the distanceTransform sample.
+//
+// Computes what nppiDistanceTransformPBA computes: for every pixel, the nearest site, a site being a pixel whose value
+// lies in [nMinSiteValue, nMaxSiteValue]. The transform is separable (Felzenszwalb and Huttenlocher):
+//
+// * The column pass finds the nearest site of every pixel within its column. It sweeps the rows down and then up,
+//   carrying the last site row of each column, so each sweep reads whole rows and vectorizes across columns.
+//   Blocks of columns run in parallel.
+// * The row pass builds, for every row, the lower envelope of the parabolas (x - q)^2 + dy(q)^2 of the columns q
+//   that have a site, and evaluates it. An envelope segment has a single site, so its squared distances are a
+//   constant plus (x - q)^2 and are evaluated four pixels at a time with SSE2. Rows run in parallel.
+//
+// Both passes are linear in the pixel count. Squared distances are exact integers, so the 16u output is the exact
+// truncated distance. Ties between equidistant sites are broken deterministically but need not match NPP.
+//
+// Outputs match the sample's layouts: the Voronoi image holds the (x, y) site coordinates of every pixel as two
+// 16-bit values, so its rows are twice the image width; the transform is 32f and the truncated transform 16u.
+// Without any site every distance is FLT_MAX (65535 when truncated) and every Voronoi site is (-1, -1).
+
+#include <utils/thread_pool.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DISTANCE_TRANSFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace DistanceTransformHost
+{
+
+namespace Kernel
+{
+
+static const int32_t kNoSite = -1;
+static const int kColumnBlock = 256;
+
+template <typename T>
+T * row(T * pImage, size_t nPitch, int y)
+{
+    return reinterpret_cast<T *>(reinterpret_cast<unsigned char *>(pImage) + y * nPitch);
+}
+
+template <typename T>
+const T * row(const T * pImage, size_t nPitch, int y)
+{
+    return reinterpret_cast<const T *>(reinterpret_cast<const unsigned char *>(pImage) + y * nPitch);
+}
+
+// Nearest site row of columns [nBeginX, nEndX) of every row, or kNoSite; pLast holds nEndX - nBeginX entries
+inline void columnPass(const uint8_t * pSrc, size_t nSrcPitch, int nWidth, int nHeight, uint8_t nMinSiteValue,
+                       uint8_t nMaxSiteValue, int nBeginX, int nEndX, int32_t * pSiteY, int32_t * pLast)
+{
+    int nCount = nEndX - nBeginX;
+    std::fill(pLast, pLast + nCount, kNoSite);
+    for (int y = 0; y < nHeight; y++)
+    {
+        const uint8_t * pRow = row(pSrc, nSrcPitch, y) + nBeginX;
+        int32_t * pSiteRow = pSiteY + static_cast<size_t>(y) * nWidth + nBeginX;
+        for (int i = 0; i < nCount; i++)
+        {
+            pLast[i] = pRow[i] >= nMinSiteValue && pRow[i] <= nMaxSiteValue ? y : pLast[i];
+            pSiteRow[i] = pLast[i];
+        }
+    }
+    std::fill(pLast, pLast + nCount, kNoSite);
+    for (int y = nHeight - 1; y >= 0; y--)
+    {
+        const uint8_t * pRow = row(pSrc, nSrcPitch, y) + nBeginX;
+        int32_t * pSiteRow = pSiteY + static_cast<size_t>(y) * nWidth + nBeginX;
+        for (int i = 0; i < nCount; i++)
+        {
+            pLast[i] = pRow[i] >= nMinSiteValue && pRow[i] <= nMaxSiteValue ? y : pLast[i];
+            int32_t nAbove = pSiteRow[i];
+            bool bBelow = pLast[i] != kNoSite && (nAbove == kNoSite || pLast[i] - y < y - nAbove);
+            pSiteRow[i] = bBelow ? pLast[i] : nAbove;
+        }
+    }
+}
+
+// pD2[x] = (x - q)^2 + nF for x in [nBeginX, nEndX); |x - q| < 32768
+inline void evaluateSegment(int32_t * pD2, int nBeginX, int nEndX, int q, int32_t nF)
+{
+    int x = nBeginX;
+#ifdef DISTANCE_TRANSFORM_SSE2
+    // |x - q| fits in the low 16 bits of each lane, so _mm_madd_epi16 squares it exactly
+    __m128i vX = _mm_setr_epi32(x - q, x - q + 1, x - q + 2, x - q + 3);
+    __m128i vF = _mm_set1_epi32(nF);
+    __m128i vStep = _mm_set1_epi32(4);
+    for (; x + 4 <= nEndX; x += 4)
+    {
+        __m128i vSign = _mm_srai_epi32(vX, 31);
+        __m128i vAbs = _mm_sub_epi32(_mm_xor_si128(vX, vSign), vSign);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pD2 + x), _mm_add_epi32(_mm_madd_epi16(vAbs, vAbs), vF));
+        vX = _mm_add_epi32(vX, vStep);
+    }
+#endif
+    for (; x < nEndX; x++)
+        pD2[x] = (x - q) * (x - q) + nF;
+}
+
+// Distances of one row from its squared distances; either output may be null
+inline void convertRow(const int32_t * pD2, int nWidth, float * pTransform, uint16_t * pTruncated)
+{
+    int x = 0;
+#ifdef DISTANCE_TRANSFORM_SSE2
+    __m128i vBias = _mm_set1_epi32(32768);
+    for (; x + 4 <= nWidth; x += 4)
+    {
+        __m128i vD2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pD2 + x));
+        __m128d vLow = _mm_sqrt_pd(_mm_cvtepi32_pd(vD2));
+        __m128d vHigh = _mm_sqrt_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(vD2, _MM_SHUFFLE(1, 0, 3, 2))));
+        if (pTransform != nullptr)
+            _mm_storeu_ps(pTransform + x, _mm_movelh_ps(_mm_cvtpd_ps(vLow), _mm_cvtpd_ps(vHigh)));
+        if (pTruncated != nullptr)
+        {
+            // Distances are below 46341; bias them into the signed range for the saturating pack
+            __m128i vDistance = _mm_unpacklo_epi64(_mm_cvttpd_epi32(vLow), _mm_cvttpd_epi32(vHigh));
+            __m128i vPacked = _mm_packs_epi32(_mm_sub_epi32(vDistance, vBias), vBias);
+            vPacked = _mm_xor_si128(vPacked, _mm_set1_epi16(static_cast<short>(0x8000)));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(pTruncated + x), vPacked);
+        }
+    }
+#endif
+    for (; x < nWidth; x++)
+    {
+        double nDistance = std::sqrt(static_cast<double>(pD2[x]));
+        if (pTransform != nullptr)
+            pTransform[x] = static_cast<float>(nDistance);
+        if (pTruncated != nullptr)
+            pTruncated[x] = static_cast<uint16_t>(nDistance);
+    }
+}
+
+} // namespace Kernel
+
+// Runs transforms on a shared thread pool, keeping the scratch buffers between calls so that transforming many
+// small masks does not allocate every time
+class Engine
+{
+public:
+    // nThreads = 0 uses every hardware thread
+    explicit Engine(unsigned int nThreads = 0)
+        : oPool_(nThreads != 0 ? nThreads : std::max(1u, std::thread::hardware_concurrency()))
+        , aWorkers_(oPool_.size())
+    {
+    }
+
+    size_t threadCount() const
+    {
+        return oPool_.size();
+    }
+
+    // Transforms the nWidth x nHeight 8u image pSrc. Every output may be null; pVoronoi rows hold 2 * nWidth values.
+    // Pitches are in bytes.
+    void transform(const uint8_t * pSrc, size_t nSrcPitch, int nWidth, int nHeight,
+                   uint8_t nMinSiteValue, uint8_t nMaxSiteValue,
+                   int16_t * pVoronoi, size_t nVoronoiPitch,
+                   float * pTransform, size_t nTransformPitch,
+                   uint16_t * pTruncated, size_t nTruncatedPitch)
+    {
+        if (nWidth <= 0 || nHeight <= 0 || nWidth > 32767 || nHeight > 32767 ||
+            nSrcPitch < static_cast<size_t>(nWidth) ||
+            (pVoronoi != nullptr && nVoronoiPitch < 2 * nWidth * sizeof(int16_t)) ||
+            (pTransform != nullptr && nTransformPitch < nWidth * sizeof(float)) ||
+            (pTruncated != nullptr && nTruncatedPitch < nWidth * sizeof(uint16_t)))
+            throw std::invalid_argument("DistanceTransformHost::transform: invalid image");
+
+        aSiteY_.resize(static_cast<size_t>(nWidth) * nHeight);
+        for (Worker & oWorker : aWorkers_)
+        {
+            oWorker.aColumns.resize(std::min(nWidth, Kernel::kColumnBlock));
+            oWorker.aSites.resize(nWidth);
+            oWorker.aOffsets.resize(nWidth);
+            oWorker.aBoundaries.resize(nWidth + 1);
+            oWorker.aD2.resize(nWidth);
+        }
+
+        size_t nBlockCount = (nWidth + Kernel::kColumnBlock - 1) / Kernel::kColumnBlock;
+        oPool_.enqueue_batch(nBlockCount, [&](int nWorker, size_t nBlock)
+        {
+            int nBeginX = static_cast<int>(nBlock) * Kernel::kColumnBlock;
+            int nEndX = std::min(nWidth, nBeginX + Kernel::kColumnBlock);
+            Kernel::columnPass(pSrc, nSrcPitch, nWidth, nHeight, nMinSiteValue, nMaxSiteValue, nBeginX, nEndX,
+                               aSiteY_.data(), aWorkers_[nWorker].aColumns.data());
+        });
+        oPool_.wait();
+
+        size_t nBandCount = std::min<size_t>(nHeight, 4 * oPool_.size());
+        oPool_.enqueue_batch(nBandCount, [&](int nWorker, size_t nBand)
+        {
+            int nBeginY = static_cast<int>(nHeight * nBand / nBandCount);
+            int nEndY = static_cast<int>(nHeight * (nBand + 1) / nBandCount);
+            for (int y = nBeginY; y < nEndY; y++)
+                transformRow(aWorkers_[nWorker], y, nWidth,
+                             pVoronoi != nullptr ? Kernel::row(pVoronoi, nVoronoiPitch, y) : nullptr,
+                             pTransform != nullptr ? Kernel::row(pTransform, nTransformPitch, y) : nullptr,
+                             pTruncated != nullptr ? Kernel::row(pTruncated, nTruncatedPitch, y) : nullptr);
+        });
+        oPool_.wait();
+    }
+
+private:
+    struct Worker
+    {
+        std::vector<int32_t> aColumns;      // column pass state
+        std::vector<int32_t> aSites;        // columns of the envelope parabolas
+        std::vector<double> aOffsets;       // f(q) + q^2 of each envelope parabola
+        std::vector<double> aBoundaries;    // parabola k is lowest on (aBoundaries[k], aBoundaries[k + 1]]
+        std::vector<int32_t> aD2;           // squared distances of the row
+    };
+
+    void transformRow(Worker & oWorker, int y, int nWidth, int16_t * pVoronoi, float * pTransform,
+                      uint16_t * pTruncated)
+    {
+        const int32_t * pSiteY = aSiteY_.data() + static_cast<size_t>(y) * nWidth;
+        int32_t * pSites = oWorker.aSites.data();
+        double * pOffsets = oWorker.aOffsets.data();
+        double * pBoundaries = oWorker.aBoundaries.data();
+
+        // Lower envelope of the parabolas (x - q)^2 + (y - site row of q)^2
+        int k = -1;
+        for (int q = 0; q < nWidth; q++)
+        {
+            if (pSiteY[q] == Kernel::kNoSite)
+                continue;
+            double nDy = y - pSiteY[q];
+            double nOffset = nDy * nDy + static_cast<double>(q) * q;
+            double nS = 0.0;
+            while (k >= 0)
+            {
+                nS = (nOffset - pOffsets[k]) / (2.0 * (q - pSites[k]));
+                if (nS > pBoundaries[k])
+                    break;
+                k--;
+            }
+            k++;
+            pSites[k] = q;
+            pOffsets[k] = nOffset;
+            pBoundaries[k] = k == 0 ? -std::numeric_limits<double>::infinity() : nS;
+        }
+
+        if (k < 0)
+        {
+            // No site in the image
+            for (int x = 0; x < nWidth; x++)
+            {
+                if (pVoronoi != nullptr)
+                    pVoronoi[2 * x] = pVoronoi[2 * x + 1] = -1;
+                if (pTransform != nullptr)
+                    pTransform[x] = FLT_MAX;
+                if (pTruncated != nullptr)
+                    pTruncated[x] = 65535;
+            }
+            return;
+        }
+
+        int nSegmentCount = k + 1;
+        int nBeginX = 0;
+        for (int nSegment = 0; nSegment < nSegmentCount && nBeginX < nWidth; nSegment++)
+        {
+            int nEndX = nWidth;
+            if (nSegment + 1 < nSegmentCount)
+                nEndX = static_cast<int>(std::min<double>(nWidth, std::floor(pBoundaries[nSegment + 1]) + 1.0));
+            if (nEndX <= nBeginX)
+                continue;
+            int q = pSites[nSegment];
+            int32_t nDy = y - pSiteY[q];
+            Kernel::evaluateSegment(oWorker.aD2.data(), nBeginX, nEndX, q, nDy * nDy);
+            if (pVoronoi != nullptr)
+            {
+                int16_t nSiteX = static_cast<int16_t>(q);
+                int16_t nSiteY = static_cast<int16_t>(pSiteY[q]);
+                for (int x = nBeginX; x < nEndX; x++)
+                {
+                    pVoronoi[2 * x] = nSiteX;
+                    pVoronoi[2 * x + 1] = nSiteY;
+                }
+            }
+            nBeginX = nEndX;
+        }
+        Kernel::convertRow(oWorker.aD2.data(), nWidth, pTransform, pTruncated);
+    }
+
+    ThreadPool oPool_;
+    std::vector<Worker> aWorkers_;
+    std::vector<int32_t> aSiteY_;   // nearest site row within the column of every pixel, or kNoSite
+};
+
+} // namespace DistanceTransformHost
@@ -0,0 +1,390 @@
+// Checks the host distance transform engine against brute force: every pixel's Voronoi site is a site at the least
+// squared distance, the 32f transform is the square root of that distance and the 16u transform its truncation, for
+// hand-built and random images, several thread counts, site ranges and pitches, with any output omitted. Without a
+// site every distance is FLT_MAX or 65535 and every site (-1, -1).
+
+#include "distance_transform_host.h"
+#include "test_check.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+using DistanceTransformHost::Engine;
+
+const uint8_t kPadSource = 0xAB;
+const int16_t kPadVoronoi = 0x5A5A;
+const float kPadTransform = -7.0f;
+const uint16_t kPadTruncated = 0xA5A5;
+
+// Source image and the three outputs, each with nPad unused elements at the end of every row
+struct Images
+{
+    int nWidth;
+    int nHeight;
+    int nPad;
+    std::vector<uint8_t> aSource;
+    std::vector<int16_t> aVoronoi;
+    std::vector<float> aTransform;
+    std::vector<uint16_t> aTruncated;
+
+    Images(int nW, int nH, int nP)
+        : nWidth(nW)
+        , nHeight(nH)
+        , nPad(nP)
+        , aSource((nW + nP) * nH, kPadSource)
+        , aVoronoi((2 * nW + nP) * nH, kPadVoronoi)
+        , aTransform((nW + nP) * nH, kPadTransform)
+        , aTruncated((nW + nP) * nH, kPadTruncated)
+    {
+    }
+
+    uint8_t & source(int x, int y) { return aSource[y * (nWidth + nPad) + x]; }
+    int16_t voronoiX(int x, int y) const { return aVoronoi[y * (2 * nWidth + nPad) + 2 * x]; }
+    int16_t voronoiY(int x, int y) const { return aVoronoi[y * (2 * nWidth + nPad) + 2 * x + 1]; }
+    float transform(int x, int y) const { return aTransform[y * (nWidth + nPad) + x]; }
+    uint16_t truncated(int x, int y) const { return aTruncated[y * (nWidth + nPad) + x]; }
+
+    void run(Engine & oEngine, uint8_t nMin, uint8_t nMax, bool bVoronoi = true, bool bTransform = true,
+             bool bTruncated = true)
+    {
+        oEngine.transform(aSource.data(), (nWidth + nPad) * sizeof(uint8_t), nWidth, nHeight, nMin, nMax,
+                          bVoronoi ? aVoronoi.data() : nullptr, (2 * nWidth + nPad) * sizeof(int16_t),
+                          bTransform ? aTransform.data() : nullptr, (nWidth + nPad) * sizeof(float),
+                          bTruncated ? aTruncated.data() : nullptr, (nWidth + nPad) * sizeof(uint16_t));
+    }
+
+    bool padsIntact() const
+    {
+        bool bIntact = true;
+        for (int y = 0; y < nHeight; y++)
+            for (int i = 0; i < nPad; i++)
+            {
+                bIntact &= aVoronoi[y * (2 * nWidth + nPad) + 2 * nWidth + i] == kPadVoronoi;
+                bIntact &= aTransform[y * (nWidth + nPad) + nWidth + i] == kPadTransform;
+                bIntact &= aTruncated[y * (nWidth + nPad) + nWidth + i] == kPadTruncated;
+            }
+        return bIntact;
+    }
+};
+
+bool isSite(uint8_t nValue, uint8_t nMin, uint8_t nMax)
+{
+    return nValue >= nMin && nValue <= nMax;
+}
+
+// Least squared distance from every pixel to a site, or -1 without any site
+std::vector<int64_t> bruteForce(Images & oImages, uint8_t nMin, uint8_t nMax)
+{
+    std::vector<int> aSitesX, aSitesY;
+    for (int y = 0; y < oImages.nHeight; y++)
+        for (int x = 0; x < oImages.nWidth; x++)
+            if (isSite(oImages.source(x, y), nMin, nMax))
+            {
+                aSitesX.push_back(x);
+                aSitesY.push_back(y);
+            }
+    std::vector<int64_t> aD2(static_cast<size_t>(oImages.nWidth) * oImages.nHeight, -1);
+    for (int y = 0; y < oImages.nHeight; y++)
+        for (int x = 0; x < oImages.nWidth; x++)
+        {
+            int64_t nBest = -1;
+            for (size_t i = 0; i < aSitesX.size(); i++)
+            {
+                int64_t nDx = x - aSitesX[i];
+                int64_t nDy = y - aSitesY[i];
+                if (nBest < 0 || nDx * nDx + nDy * nDy < nBest)
+                    nBest = nDx * nDx + nDy * nDy;
+            }
+            aD2[static_cast<size_t>(y) * oImages.nWidth + x] = nBest;
+        }
+    return aD2;
+}
+
+// Compares the outputs that were requested with brute force; ties between sites may go either way
+bool matchesBruteForce(Images & oImages, uint8_t nMin, uint8_t nMax, bool bVoronoi = true, bool bTransform = true,
+                       bool bTruncated = true)
+{
+    std::vector<int64_t> aD2 = bruteForce(oImages, nMin, nMax);
+    bool bMatch = true;
+    for (int y = 0; y < oImages.nHeight; y++)
+        for (int x = 0; x < oImages.nWidth; x++)
+        {
+            int64_t nD2 = aD2[static_cast<size_t>(y) * oImages.nWidth + x];
+            if (nD2 < 0)
+            {
+                bMatch &= !bVoronoi || (oImages.voronoiX(x, y) == -1 && oImages.voronoiY(x, y) == -1);
+                bMatch &= !bTransform || oImages.transform(x, y) == FLT_MAX;
+                bMatch &= !bTruncated || oImages.truncated(x, y) == 65535;
+                continue;
+            }
+            double nDistance = std::sqrt(static_cast<double>(nD2));
+            if (bVoronoi)
+            {
+                int nSiteX = oImages.voronoiX(x, y);
+                int nSiteY = oImages.voronoiY(x, y);
+                bool bInside = nSiteX >= 0 && nSiteX < oImages.nWidth && nSiteY >= 0 && nSiteY < oImages.nHeight;
+                bMatch &= bInside && isSite(oImages.source(nSiteX, nSiteY), nMin, nMax);
+                int64_t nDx = x - nSiteX;
+                int64_t nDy = y - nSiteY;
+                bMatch &= nDx * nDx + nDy * nDy == nD2;
+            }
+            bMatch &= !bTransform || oImages.transform(x, y) == static_cast<float>(nDistance);
+            bMatch &= !bTruncated || oImages.truncated(x, y) == static_cast<uint16_t>(nDistance);
+        }
+    return bMatch;
+}
+
+void fillRandom(Images & oImages, std::mt19937 & oRandom, double nSiteFraction)
+{
+    std::uniform_real_distribution<double> oUniform(0.0, 1.0);
+    std::uniform_int_distribution<int> oOther(1, 255);
+    for (int y = 0; y < oImages.nHeight; y++)
+        for (int x = 0; x < oImages.nWidth; x++)
+            oImages.source(x, y) = oUniform(oRandom) < nSiteFraction ? 0 : static_cast<uint8_t>(oOther(oRandom));
+}
+
+void testSingleSite()
+{
+    // One site at (2, 1) of a 7x4 image: every distance is exact and every pixel maps to it
+    Images oImages(7, 4, 0);
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 7; x++)
+            oImages.source(x, y) = 200;
+    oImages.source(2, 1) = 0;
+    Engine oEngine(1);
+    oImages.run(oEngine, 0, 0);
+    bool bExact = true;
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 7; x++)
+        {
+            int nD2 = (x - 2) * (x - 2) + (y - 1) * (y - 1);
+            bExact &= oImages.voronoiX(x, y) == 2 && oImages.voronoiY(x, y) == 1;
+            bExact &= oImages.transform(x, y) == static_cast<float>(std::sqrt(static_cast<double>(nD2)));
+            bExact &= oImages.truncated(x, y) == static_cast<uint16_t>(std::sqrt(static_cast<double>(nD2)));
+        }
+    CHECK(bExact);
+    CHECK(oImages.truncated(6, 3) == 4);    // sqrt(20)
+    CHECK(oImages.truncated(0, 0) == 2);    // sqrt(5)
+    CHECK(oImages.transform(2, 1) == 0.0f);
+}
+
+void testNoSite()
+{
+    for (int nThreads : {1, 3})
+    {
+        Engine oEngine(nThreads);
+        // Wider than a column block, and widths that do and do not fill the SIMD lanes
+        for (int nWidth : {1, 5, 8, 300})
+        {
+            Images oImages(nWidth, 9, 3);
+            for (int y = 0; y < 9; y++)
+                for (int x = 0; x < nWidth; x++)
+                    oImages.source(x, y) = static_cast<uint8_t>(1 + (x + y) % 200);
+            oImages.run(oEngine, 0, 0);
+            bool bEmpty = true;
+            for (int y = 0; y < 9; y++)
+                for (int x = 0; x < nWidth; x++)
+                {
+                    bEmpty &= oImages.voronoiX(x, y) == -1 && oImages.voronoiY(x, y) == -1;
+                    bEmpty &= oImages.transform(x, y) == FLT_MAX;
+                    bEmpty &= oImages.truncated(x, y) == 65535;
+                }
+            CHECK(bEmpty);
+            CHECK(oImages.padsIntact());
+        }
+    }
+}
+
+void testSiteRange()
+{
+    // Sites are the values in [nMin, nMax], both ends included
+    Images oImages(40, 30, 0);
+    for (int y = 0; y < 30; y++)
+        for (int x = 0; x < 40; x++)
+            oImages.source(x, y) = static_cast<uint8_t>((x * 37 + y * 11) % 256);
+    Engine oEngine(2);
+    for (int nMin : {0, 10, 250})
+        for (int nMax : {nMin, nMin + 2, 255})
+        {
+            oImages.run(oEngine, static_cast<uint8_t>(nMin), static_cast<uint8_t>(nMax));
+            CHECK(matchesBruteForce(oImages, static_cast<uint8_t>(nMin), static_cast<uint8_t>(nMax)));
+        }
+}
+
+void testRandom()
+{
+    std::mt19937 oRandom(20191);
+    // Single rows and columns, widths around the SIMD and column block sizes, and sparse to dense sites
+    const int aSizes[][2] = {{1, 1}, {1, 37}, {37, 1}, {3, 5}, {4, 4}, {13, 17}, {64, 33},
+                             {255, 9}, {257, 12}, {300, 7}, {100, 100}, {31, 200}};
+    for (unsigned int nThreads : {1u, 3u, 8u})
+    {
+        Engine oEngine(nThreads);
+        CHECK(oEngine.threadCount() == nThreads);
+        for (const auto & aSize : aSizes)
+            for (double nFraction : {0.0005, 0.01, 0.2, 0.9})
+            {
+                int nPad = static_cast<int>(oRandom() % 5);
+                Images oImages(aSize[0], aSize[1], nPad);
+                fillRandom(oImages, oRandom, nFraction);
+                oImages.run(oEngine, 0, 0);
+                CHECK(matchesBruteForce(oImages, 0, 0));
+                CHECK(oImages.padsIntact());
+            }
+    }
+}
+
+void testFarSites()
+{
+    // Squared distances far beyond 16 bits along a long row, and a few sites that leave most rows and columns empty
+    Engine oEngine(4);
+    Images oRow(4000, 2, 1);
+    for (int y = 0; y < 2; y++)
+        for (int x = 0; x < 4000; x++)
+            oRow.source(x, y) = 9;
+    oRow.source(0, 0) = 0;
+    oRow.run(oEngine, 0, 0);
+    CHECK(matchesBruteForce(oRow, 0, 0));
+    CHECK(oRow.truncated(3999, 1) == 3999);
+
+    Images oSparse(150, 120, 2);
+    for (int y = 0; y < 120; y++)
+        for (int x = 0; x < 150; x++)
+            oSparse.source(x, y) = 9;
+    oSparse.source(149, 0) = 0;
+    oSparse.source(0, 119) = 0;
+    oSparse.source(75, 60) = 0;
+    oSparse.run(oEngine, 0, 0);
+    CHECK(matchesBruteForce(oSparse, 0, 0));
+}
+
+void testOptionalOutputs()
+{
+    // Any output may be omitted; the others are unchanged and the omitted ones untouched
+    std::mt19937 oRandom(7);
+    Engine oEngine(3);
+    for (int nMask = 0; nMask < 8; nMask++)
+    {
+        bool bVoronoi = (nMask & 1) != 0;
+        bool bTransform = (nMask & 2) != 0;
+        bool bTruncated = (nMask & 4) != 0;
+        Images oImages(71, 23, 1);
+        fillRandom(oImages, oRandom, 0.02);
+        oImages.run(oEngine, 0, 0, bVoronoi, bTransform, bTruncated);
+        CHECK(matchesBruteForce(oImages, 0, 0, bVoronoi, bTransform, bTruncated));
+        bool bUntouched = true;
+        for (int16_t nValue : oImages.aVoronoi)
+            bUntouched &= bVoronoi || nValue == kPadVoronoi;
+        for (float nValue : oImages.aTransform)
+            bUntouched &= bTransform || nValue == kPadTransform;
+        for (uint16_t nValue : oImages.aTruncated)
+            bUntouched &= bTruncated || nValue == kPadTruncated;
+        CHECK(bUntouched);
+    }
+}
+
+void testReuse()
+{
+    // One engine transforms images of changing sizes, its scratch buffers growing and shrinking
+    std::mt19937 oRandom(11);
+    Engine oEngine(2);
+    const int aSizes[][2] = {{50, 40}, {7, 3}, {400, 20}, {9, 90}, {50, 40}};
+    for (const auto & aSize : aSizes)
+    {
+        Images oImages(aSize[0], aSize[1], 0);
+        fillRandom(oImages, oRandom, 0.05);
+        oImages.run(oEngine, 0, 0);
+        CHECK(matchesBruteForce(oImages, 0, 0));
+    }
+}
+
+void testInvalid()
+{
+    // Buffers large enough for the oversized images, so each case fails on its own check alone
+    const int kMaxExtent = 32768;
+    Engine oEngine(1);
+    std::vector<uint8_t> aSource(8 * kMaxExtent, 0);
+    std::vector<int16_t> aVoronoi(2 * 8 * kMaxExtent);
+    std::vector<float> aTransform(8 * kMaxExtent);
+    std::vector<uint16_t> aTruncated(8 * kMaxExtent);
+    int nThrown = 0;
+    for (int nCase = 0; nCase < 8; nCase++)
+    {
+        int nWidth = 8;
+        int nHeight = 8;
+        if (nCase == 0)
+            nWidth = 0;
+        if (nCase == 1)
+            nHeight = -1;
+        if (nCase == 2)
+        {
+            nWidth = kMaxExtent;
+            nHeight = 1;
+        }
+        if (nCase == 3)
+            nHeight = kMaxExtent;
+        size_t nSrcPitch = nWidth > 0 ? nWidth : 8;
+        size_t nVoronoiPitch = 2 * nSrcPitch * sizeof(int16_t);
+        size_t nTransformPitch = nSrcPitch * sizeof(float);
+        size_t nTruncatedPitch = nSrcPitch * sizeof(uint16_t);
+        if (nCase == 4)
+            nSrcPitch -= 1;
+        if (nCase == 5)
+            nVoronoiPitch -= 1;
+        if (nCase == 6)
+            nTransformPitch -= 1;
+        if (nCase == 7)
+            nTruncatedPitch -= 1;
+        try
+        {
+            oEngine.transform(aSource.data(), nSrcPitch, nWidth, nHeight, 0, 0, aVoronoi.data(), nVoronoiPitch,
+                              aTransform.data(), nTransformPitch, aTruncated.data(), nTruncatedPitch);
+        }
+        catch (const std::invalid_argument &)
+        {
+            nThrown++;
+        }
+    }
+    CHECK(nThrown == 8);
+
+    // The pitch of an omitted output is not checked
+    for (int nOmitted = 0; nOmitted < 3; nOmitted++)
+    {
+        bool bThrown = false;
+        try
+        {
+            oEngine.transform(aSource.data(), 8, 8, 8, 0, 0,
+                              nOmitted == 0 ? nullptr : aVoronoi.data(), nOmitted == 0 ? 0 : 2 * 8 * sizeof(int16_t),
+                              nOmitted == 1 ? nullptr : aTransform.data(), nOmitted == 1 ? 0 : 8 * sizeof(float),
+                              nOmitted == 2 ? nullptr : aTruncated.data(), nOmitted == 2 ? 0 : 8 * sizeof(uint16_t));
+        }
+        catch (const std::invalid_argument &)
+        {
+            bThrown = true;
+        }
+        CHECK(!bThrown);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    testSingleSite();
+    testNoSite();
+    testSiteRange();
+    testRandom();
+    testFarSites();
+    testOptionalOutputs();
+    testReuse();
+    testInvalid();
+    return test_result("distance_transform_host_test");
+}
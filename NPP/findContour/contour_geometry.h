@@ -0,0 +1,267 @@
+#pragma once
+
+// Host contour geometry engine for the findContour sample.
+//
+// Builds the ordered contour geometry of every label of a (compressed) marker label image read back from the device.
+// A pixel belongs to the contour of its label when one of its 4 neighbours has another label or lies outside the
+// image. The contour pixels of each label are walked with Moore neighbour tracing (8-way connectivity, clockwise
+// in image coordinates), starting a new closed trace at every contour pixel no previous trace reached, and each
+// pixel is emitted once. A label therefore costs time linear in its contour pixel count, and labels are traced in
+// parallel, largest first, so that no contour has to be bypassed because of its size.
+//
+// The output is a compact CSR list: the points of label n are aPoints[aOffsets[n]] .. aPoints[aOffsets[n + 1] - 1]
+// and aTraceStarts flags the points that begin a new closed trace.
+
+#include <utils/thread_pool.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace ContourGeometry
+{
+
+struct Point
+{
+    int x;
+    int y;
+};
+
+struct BoundingBox
+{
+    int nMinX;
+    int nMinY;
+    int nMaxX;
+    int nMaxY;
+};
+
+struct Geometry
+{
+    unsigned int nLabelCount;
+    std::vector<unsigned int> aOffsets;         // nLabelCount + 1 entries
+    std::vector<Point> aPoints;
+    std::vector<unsigned char> aTraceStarts;    // one per point
+    std::vector<BoundingBox> aBoundingBoxes;    // one per label, empty labels have nMinX > nMaxX
+};
+
+// Moore neighbourhood, clockwise with y pointing down, starting east
+static const int aDirectionX[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+static const int aDirectionY[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+// Direction from the neighbour found in direction d to the neighbour scanned just before it, which is the
+// backtrack pixel of the next step
+static const int aBacktrackDirection[8] = {6, 6, 0, 0, 2, 2, 4, 4};
+
+static const unsigned char kContourPixel = 1;
+static const unsigned char kEmittedPixel = 2;
+
+class Tracer
+{
+public:
+    Tracer(const uint32_t * pLabels, int nWidth, int nHeight, size_t nLabelPitch, unsigned char * pMask)
+        : pLabels_(pLabels), nWidth_(nWidth), nHeight_(nHeight), nLabelPitch_(nLabelPitch), pMask_(pMask)
+    {
+    }
+
+    uint32_t label(int x, int y) const
+    {
+        return pLabels_[y * nLabelPitch_ + x];
+    }
+
+    bool isInside(int x, int y, uint32_t nLabel) const
+    {
+        return x >= 0 && y >= 0 && x < nWidth_ && y < nHeight_ && label(x, y) == nLabel;
+    }
+
+    bool isContour(int x, int y) const
+    {
+        uint32_t nLabel = label(x, y);
+        return !isInside(x + 1, y, nLabel) || !isInside(x - 1, y, nLabel) ||
+               !isInside(x, y + 1, nLabel) || !isInside(x, y - 1, nLabel);
+    }
+
+    // Traces the label of the contour pixel indices [pBegin, pEnd), in raster order, into pPoints
+    void traceLabel(const uint32_t * pBegin, const uint32_t * pEnd, Point * pPoints, unsigned char * pTraceStarts)
+    {
+        size_t nCount = pEnd - pBegin;
+        size_t nEmitted = 0;
+        for (const uint32_t * pStart = pBegin; pStart != pEnd && nEmitted < nCount; pStart++)
+        {
+            if (pMask_[*pStart] == kEmittedPixel)
+                continue;
+            int nStartX = static_cast<int>(*pStart % nWidth_);
+            int nStartY = static_cast<int>(*pStart / nWidth_);
+            uint32_t nLabel = label(nStartX, nStartY);
+            // A 4-neighbour outside the label exists for every contour pixel
+            int nStartBacktrack = 0;
+            while (isInside(nStartX + aDirectionX[nStartBacktrack], nStartY + aDirectionY[nStartBacktrack], nLabel))
+                nStartBacktrack += 2;
+
+            pTraceStarts[nEmitted] = 1;
+            emit(nStartX, nStartY, pPoints, nEmitted);
+            int nX = nStartX;
+            int nY = nStartY;
+            int nBacktrack = nStartBacktrack;
+            // Jacob's stopping criterion: back at the start, entered from the same side. The step limit only
+            // guards against malformed input; a closed trace passes each pixel at most 4 times.
+            for (size_t nStep = 0; nStep < 4 * nCount + 4; nStep++)
+            {
+                int nDirection = -1;
+                for (int k = 1; k <= 8; k++)
+                {
+                    int d = (nBacktrack + k) & 7;
+                    if (isInside(nX + aDirectionX[d], nY + aDirectionY[d], nLabel))
+                    {
+                        nDirection = d;
+                        break;
+                    }
+                }
+                if (nDirection < 0)
+                    break;  // isolated pixel
+                nX += aDirectionX[nDirection];
+                nY += aDirectionY[nDirection];
+                nBacktrack = aBacktrackDirection[nDirection];
+                if (nX == nStartX && nY == nStartY && nBacktrack == nStartBacktrack)
+                    break;
+                emit(nX, nY, pPoints, nEmitted);
+            }
+        }
+    }
+
+private:
+    void emit(int nX, int nY, Point * pPoints, size_t & nEmitted)
+    {
+        unsigned char & nMask = pMask_[static_cast<size_t>(nY) * nWidth_ + nX];
+        if (nMask == kEmittedPixel)
+            return;
+        nMask = kEmittedPixel;
+        pPoints[nEmitted].x = nX;
+        pPoints[nEmitted].y = nY;
+        nEmitted++;
+    }
+
+    const uint32_t * pLabels_;
+    int nWidth_;
+    int nHeight_;
+    size_t nLabelPitch_;
+    unsigned char * pMask_;
+};
+
+// Traces every label of pLabels, an nWidth x nHeight image with a line pitch of nLabelPitch bytes whose labels are
+// all below nLabelCount. nThreads = 0 uses every hardware thread.
+Geometry traceContours(const uint32_t * pLabels, int nWidth, int nHeight, size_t nLabelPitch,
+                       unsigned int nLabelCount, unsigned int nThreads = 0)
+{
+    if (nWidth <= 0 || nHeight <= 0 || nLabelPitch < nWidth * sizeof(uint32_t) || nLabelCount == 0)
+        throw std::invalid_argument("ContourGeometry::traceContours: invalid image");
+    if (nThreads == 0)
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    size_t nPixelCount = static_cast<size_t>(nWidth) * nHeight;
+    std::vector<unsigned char> aMask(nPixelCount);
+    Tracer oTracer(pLabels, nWidth, nHeight, nLabelPitch / sizeof(uint32_t), aMask.data());
+    ThreadPool oPool(nThreads);
+
+    // Contour pixels, in parallel over row bands
+    size_t nBandCount = std::min<size_t>(nHeight, 4 * static_cast<size_t>(nThreads));
+    oPool.enqueue_batch(nBandCount, [&](int, size_t nBand)
+    {
+        int nBeginY = static_cast<int>(nHeight * nBand / nBandCount);
+        int nEndY = static_cast<int>(nHeight * (nBand + 1) / nBandCount);
+        for (int y = nBeginY; y < nEndY; y++)
+            for (int x = 0; x < nWidth; x++)
+                if (oTracer.isContour(x, y))
+                    aMask[static_cast<size_t>(y) * nWidth + x] = kContourPixel;
+    });
+    oPool.wait();
+
+    // Per-label contour pixel counts, bounding boxes and raster ordered contour pixel lists
+    Geometry oGeometry;
+    oGeometry.nLabelCount = nLabelCount;
+    oGeometry.aOffsets.assign(nLabelCount + 1, 0);
+    BoundingBox oEmptyBox = {nWidth, nHeight, -1, -1};
+    oGeometry.aBoundingBoxes.assign(nLabelCount, oEmptyBox);
+    for (int y = 0; y < nHeight; y++)
+    {
+        for (int x = 0; x < nWidth; x++)
+        {
+            if (aMask[static_cast<size_t>(y) * nWidth + x] == 0)
+                continue;
+            uint32_t nLabel = oTracer.label(x, y);
+            if (nLabel >= nLabelCount)
+                throw std::invalid_argument("ContourGeometry::traceContours: label out of range");
+            oGeometry.aOffsets[nLabel + 1]++;
+            BoundingBox & oBox = oGeometry.aBoundingBoxes[nLabel];
+            oBox.nMinX = std::min(oBox.nMinX, x);
+            oBox.nMinY = std::min(oBox.nMinY, y);
+            oBox.nMaxX = std::max(oBox.nMaxX, x);
+            oBox.nMaxY = std::max(oBox.nMaxY, y);
+        }
+    }
+    for (unsigned int nLabel = 0; nLabel < nLabelCount; nLabel++)
+        oGeometry.aOffsets[nLabel + 1] += oGeometry.aOffsets[nLabel];
+    unsigned int nTotal = oGeometry.aOffsets[nLabelCount];
+    std::vector<uint32_t> aContourPixels(nTotal);
+    std::vector<unsigned int> aCursor(oGeometry.aOffsets.begin(), oGeometry.aOffsets.end() - 1);
+    for (size_t nPixel = 0; nPixel < nPixelCount; nPixel++)
+    {
+        if (aMask[nPixel] != 0)
+        {
+            int y = static_cast<int>(nPixel / nWidth);
+            int x = static_cast<int>(nPixel % nWidth);
+            aContourPixels[aCursor[oTracer.label(x, y)]++] = static_cast<uint32_t>(nPixel);
+        }
+    }
+
+    // Ordered traces, one task per label, largest contours first so they do not end up last on one thread
+    oGeometry.aPoints.resize(nTotal);
+    oGeometry.aTraceStarts.assign(nTotal, 0);
+    std::vector<unsigned int> aOrder;
+    for (unsigned int nLabel = 0; nLabel < nLabelCount; nLabel++)
+        if (oGeometry.aOffsets[nLabel + 1] > oGeometry.aOffsets[nLabel])
+            aOrder.push_back(nLabel);
+    const std::vector<unsigned int> & aOffsets = oGeometry.aOffsets;
+    std::stable_sort(aOrder.begin(), aOrder.end(), [&](unsigned int a, unsigned int b)
+    {
+        return aOffsets[a + 1] - aOffsets[a] > aOffsets[b + 1] - aOffsets[b];
+    });
+    oPool.enqueue_batch(aOrder.size(), [&](int, size_t nTask)
+    {
+        unsigned int nLabel = aOrder[nTask];
+        unsigned int nBegin = aOffsets[nLabel];
+        oTracer.traceLabel(&aContourPixels[nBegin], &aContourPixels[0] + aOffsets[nLabel + 1],
+                           &oGeometry.aPoints[nBegin], &oGeometry.aTraceStarts[nBegin]);
+    });
+    oPool.wait();
+    return oGeometry;
+}
+
+// Draws the labels [nStartID, nStopID) of oGeometry into an 8-bit image with a line pitch of nPitch bytes; the gray
+// level starts at 240 for the first point of each label and decreases along the contour
+void rasterizeContours(const Geometry & oGeometry, unsigned int nStartID, unsigned int nStopID,
+                       unsigned char * pImage, size_t nPitch, unsigned int nThreads = 0)
+{
+    nStopID = std::min(nStopID, oGeometry.nLabelCount);
+    if (nStartID >= nStopID)
+        return;
+    if (nThreads == 0)
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+    auto draw = [&](int, size_t nTask)
+    {
+        unsigned int nID = nStartID + static_cast<unsigned int>(nTask);
+        unsigned char nGrayLevel = 240;
+        for (unsigned int i = oGeometry.aOffsets[nID]; i < oGeometry.aOffsets[nID + 1]; i++)
+        {
+            const Point & oPoint = oGeometry.aPoints[i];
+            pImage[oPoint.y * nPitch + oPoint.x] = nGrayLevel;
+            nGrayLevel = nGrayLevel > 0 ? nGrayLevel - 1 : 240;
+        }
+    };
+    ThreadPool oPool(nThreads);
+    oPool.enqueue_batch(nStopID - nStartID, draw);
+    oPool.wait();
+}
+
+} // namespace ContourGeometry
@@ -55,10 +55,14 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <chrono>
 #include <fstream>
+#include <stdexcept>
 
 #include <npp.h>
 
+#include "contour_geometry.h"
+
 // Remove this if compiling on a pre-NPP 11.5 release
 #define USE_NPP_11_5
 
@@ -169,6 +173,8 @@ const std::string & ContoursDirectionOutputFile0 = Path + std::string("CircuitBo
 
 const std::string & ContoursReconstructedFile0 = Path + std::string("CircuitBoard_ContoursReconstructed_8Way_2048x1024_8u.raw");
 
+const std::string & ContoursOrderedGeometryFile0 = Path + std::string("CircuitBoard_ContoursOrderedGeometry_8Way_2048x1024_8u.raw");
+
 int 
 loadRaw8BitImage(Npp8u * pImage, int nWidth, int nHeight, int nImage)
 {
@@ -632,52 +638,47 @@ main( int argc, char** argv )
                                                                                 oSizeROI);
 
 #endif
-        unsigned int nContourPixelCountLimit = 262144;
+        // Ordered geometry of every contour, traced on the host from the compressed labels read back above. Unlike the
+        // device geometry lists no contour is bypassed, whatever its pixel count.
+        ContourGeometry::Geometry oContourGeometry;
+        try
+        {
+            auto oTraceStart = std::chrono::steady_clock::now();
+            oContourGeometry = ContourGeometry::traceContours(pUFLabelHost, oSizeROI.width, oSizeROI.height,
+                                                              oSizeROI.width * sizeof(Npp32u), nCompressedLabelCount + 1);
+            std::chrono::duration<double, std::milli> oTraceTime = std::chrono::steady_clock::now() - oTraceStart;
+            printf("Host contour geometry: %u contour pixels traced in %.1f ms.\n",
+                   oContourGeometry.aOffsets[oContourGeometry.nLabelCount], oTraceTime.count());
+        }
+        catch (const std::exception & oError)
+        {
+            printf("Host contour geometry failed: %s\n", oError.what());
+            tearDown();
+            return -1;
+        }
 
         for (unsigned int nID = nStartID; nID < nStopID; nID++)
         {
-            NppiContourPixelGeometryInfo * pCurContoursPixelGeometryListHost = &pContoursPixelGeometryListsHost[pContoursPixelStartingOffsetHost[nID]]; 
-            unsigned int nMaxContourPixelCount = pContoursPixelsFoundListHost[nID];
-            int nCurPixelX;
-            int nCurPixelY;
-            unsigned int nContourPixelCount = 0;
-            unsigned char nGrayLevel;
-
+            const ContourGeometry::BoundingBox & oBox = oContourGeometry.aBoundingBoxes[nID];
             printf("nID %d Cnt %d BB %d %d %d %d  \n", nID, 
-                                                       nMaxContourPixelCount, 
-                                                       pCurContoursPixelGeometryListHost[0].oContourPrevPixelLocation.x, 
-                                                       pCurContoursPixelGeometryListHost[0].oContourPrevPixelLocation.y, 
-                                                       pCurContoursPixelGeometryListHost[0].oContourNextPixelLocation.x, 
-                                                       pCurContoursPixelGeometryListHost[0].oContourNextPixelLocation.y);
-
-            unsigned int bOKToOutput = 0;
-            if (nMaxContourPixelCount < nContourPixelCountLimit)
-                bOKToOutput = 1;
-            if (nStopID - nStartID <= 1)
-                bOKToOutput = 1;
-
-            if (bOKToOutput)
-            {
-                nGrayLevel = 240;
-                while (nContourPixelCount < static_cast<int>(nMaxContourPixelCount - 1))
-                {
-                    nCurPixelX = pCurContoursPixelGeometryListHost[nContourPixelCount].oContourOrderedGeometryLocation.x;
-                    nCurPixelY = pCurContoursPixelGeometryListHost[nContourPixelCount].oContourOrderedGeometryLocation.y;
-//                    if (nCurPixelX >= 0)
-                        printf("ID %d Cnt %d %d %d  \n", nID, nContourPixelCount, nCurPixelX, nCurPixelY);
-                    if (nCurPixelX >= 0 && nCurPixelY >= 0)
-                    {
-                        pContoursOrderedGeometryImageHost[oSizeROI.width * nCurPixelY + nCurPixelX] = nGrayLevel;
-                        if (nGrayLevel > 0)
-                            nGrayLevel -= 1;
-                        else
-                            nGrayLevel = 240;
-                    }
-                    nContourPixelCount += 1;
-                }
-            }
+                                                       oContourGeometry.aOffsets[nID + 1] - oContourGeometry.aOffsets[nID], 
+                                                       oBox.nMinX, oBox.nMinY, oBox.nMaxX, oBox.nMaxY);
         }
 
+        ContourGeometry::rasterizeContours(oContourGeometry, nStartID, nStopID, 
+                                           pContoursOrderedGeometryImageHost, oSizeROI.width * sizeof(Npp8u));
+
+        bmpFile = fopen(ContoursOrderedGeometryFile0.c_str(), "wb");
+
+        if (bmpFile == NULL) 
+            return -1;
+        nSize = 0;
+        for (int j = 0; j < oSizeROI.height; j++)
+        {
+            nSize += fwrite(&pContoursOrderedGeometryImageHost[j * oSizeROI.width], sizeof(Npp8u), oSizeROI.width, bmpFile);
+        }
+        fclose(bmpFile);
+
 #if 0
         bmpFile = fopen(ContoursDirectionOutputFile0.c_str(), "wb");
 
@@ -0,0 +1,333 @@
+// Checks the host contour geometry engine on small hand-built label images: the ordered trace of a rectangle, a
+// single pixel and a ring with a hole, the per-label contour pixels and bounding boxes against a brute-force scan
+// of random label images for several thread counts, and the rasterisation of an ID range.
+
+#include "contour_geometry.h"
+#include "test_check.h"
+
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+using ContourGeometry::BoundingBox;
+using ContourGeometry::Geometry;
+using ContourGeometry::Point;
+
+struct LabelImage
+{
+    int nWidth;
+    int nHeight;
+    std::vector<uint32_t> aLabels;
+
+    LabelImage(int nW, int nH, uint32_t nLabel = 0) : nWidth(nW), nHeight(nH), aLabels(nW * nH, nLabel) {}
+
+    void fill(int nX0, int nY0, int nX1, int nY1, uint32_t nLabel)
+    {
+        for (int y = nY0; y < nY1; y++)
+            for (int x = nX0; x < nX1; x++)
+                aLabels[y * nWidth + x] = nLabel;
+    }
+
+    uint32_t at(int x, int y) const { return aLabels[y * nWidth + x]; }
+
+    Geometry trace(unsigned int nLabelCount, unsigned int nThreads = 1) const
+    {
+        return ContourGeometry::traceContours(aLabels.data(), nWidth, nHeight, nWidth * sizeof(uint32_t),
+                                              nLabelCount, nThreads);
+    }
+};
+
+// A pixel is on the contour of its label when a 4-neighbour has another label or is outside the image
+bool isContourPixel(const LabelImage & oImage, int x, int y)
+{
+    const int aDX[4] = {1, -1, 0, 0};
+    const int aDY[4] = {0, 0, 1, -1};
+    for (int d = 0; d < 4; d++)
+    {
+        int nX = x + aDX[d];
+        int nY = y + aDY[d];
+        if (nX < 0 || nY < 0 || nX >= oImage.nWidth || nY >= oImage.nHeight || oImage.at(nX, nY) != oImage.at(x, y))
+            return true;
+    }
+    return false;
+}
+
+bool isAdjacent(const Point & a, const Point & b)
+{
+    int nDX = a.x - b.x;
+    int nDY = a.y - b.y;
+    return (nDX != 0 || nDY != 0) && nDX >= -1 && nDX <= 1 && nDY >= -1 && nDY <= 1;
+}
+
+size_t countOf(const Geometry & oGeometry, unsigned int nLabel)
+{
+    return oGeometry.aOffsets[nLabel + 1] - oGeometry.aOffsets[nLabel];
+}
+
+size_t traceStartsOf(const Geometry & oGeometry, unsigned int nLabel)
+{
+    size_t nStarts = 0;
+    for (unsigned int i = oGeometry.aOffsets[nLabel]; i < oGeometry.aOffsets[nLabel + 1]; i++)
+        nStarts += oGeometry.aTraceStarts[i];
+    return nStarts;
+}
+
+bool sameBox(const BoundingBox & a, int nMinX, int nMinY, int nMaxX, int nMaxY)
+{
+    return a.nMinX == nMinX && a.nMinY == nMinY && a.nMaxX == nMaxX && a.nMaxY == nMaxY;
+}
+
+// Every label holds exactly its contour pixels, each once, starts with a trace, and has the bounding box of them
+void checkAgainstBruteForce(const LabelImage & oImage, const Geometry & oGeometry, unsigned int nLabelCount)
+{
+    CHECK(oGeometry.nLabelCount == nLabelCount);
+    CHECK(oGeometry.aOffsets.size() == nLabelCount + 1);
+    CHECK(oGeometry.aBoundingBoxes.size() == nLabelCount);
+    CHECK(oGeometry.aPoints.size() == oGeometry.aOffsets[nLabelCount]);
+    CHECK(oGeometry.aTraceStarts.size() == oGeometry.aPoints.size());
+    std::vector<int> aSeen(oImage.aLabels.size(), 0);
+    for (unsigned int nLabel = 0; nLabel < nLabelCount; nLabel++)
+    {
+        unsigned int nBegin = oGeometry.aOffsets[nLabel];
+        unsigned int nEnd = oGeometry.aOffsets[nLabel + 1];
+        CHECK(nBegin <= nEnd);
+        CHECK(nBegin == nEnd || oGeometry.aTraceStarts[nBegin] == 1);
+        for (unsigned int i = nBegin; i < nEnd; i++)
+        {
+            const Point & oPoint = oGeometry.aPoints[i];
+            CHECK(oImage.at(oPoint.x, oPoint.y) == nLabel);
+            aSeen[oPoint.y * oImage.nWidth + oPoint.x]++;
+        }
+    }
+    std::vector<BoundingBox> aBoxes(nLabelCount, BoundingBox{oImage.nWidth, oImage.nHeight, -1, -1});
+    for (int y = 0; y < oImage.nHeight; y++)
+    {
+        for (int x = 0; x < oImage.nWidth; x++)
+        {
+            bool bContour = isContourPixel(oImage, x, y);
+            CHECK(aSeen[y * oImage.nWidth + x] == (bContour ? 1 : 0));
+            if (!bContour)
+                continue;
+            BoundingBox & oBox = aBoxes[oImage.at(x, y)];
+            oBox.nMinX = std::min(oBox.nMinX, x);
+            oBox.nMinY = std::min(oBox.nMinY, y);
+            oBox.nMaxX = std::max(oBox.nMaxX, x);
+            oBox.nMaxY = std::max(oBox.nMaxY, y);
+        }
+    }
+    for (unsigned int nLabel = 0; nLabel < nLabelCount; nLabel++)
+    {
+        const BoundingBox & oBox = aBoxes[nLabel];
+        CHECK(sameBox(oGeometry.aBoundingBoxes[nLabel], oBox.nMinX, oBox.nMinY, oBox.nMaxX, oBox.nMaxY));
+    }
+}
+
+void testRectangle()
+{
+    // A 4 x 3 rectangle of label 1 at (2, 2) in a 8 x 7 image of label 0
+    LabelImage oImage(8, 7);
+    oImage.fill(2, 2, 6, 5, 1);
+    Geometry oGeometry = oImage.trace(3);
+    checkAgainstBruteForce(oImage, oGeometry, 3);
+
+    // Clockwise from the top left corner: top row, right column, bottom row, left column
+    const Point aExpected[] = {{2, 2}, {3, 2}, {4, 2}, {5, 2}, {5, 3}, {5, 4},
+                               {4, 4}, {3, 4}, {2, 4}, {2, 3}};
+    const size_t nExpected = sizeof(aExpected) / sizeof(aExpected[0]);
+    CHECK(countOf(oGeometry, 1) == nExpected);
+    CHECK(traceStartsOf(oGeometry, 1) == 1);
+    for (size_t i = 0; i < nExpected && i < countOf(oGeometry, 1); i++)
+    {
+        const Point & oPoint = oGeometry.aPoints[oGeometry.aOffsets[1] + i];
+        CHECK(oPoint.x == aExpected[i].x && oPoint.y == aExpected[i].y);
+    }
+    CHECK(sameBox(oGeometry.aBoundingBoxes[1], 2, 2, 5, 4));
+
+    // The background has the image border and the ring around the rectangle: 26 + 14 pixels, two traces, and the
+    // outer one, which starts at the origin, closes on itself
+    CHECK(countOf(oGeometry, 0) == 26 + 14);
+    CHECK(traceStartsOf(oGeometry, 0) == 2);
+    CHECK(oGeometry.aPoints[0].x == 0 && oGeometry.aPoints[0].y == 0);
+    for (unsigned int i = 1; i < 26; i++)
+        CHECK(isAdjacent(oGeometry.aPoints[i - 1], oGeometry.aPoints[i]));
+    CHECK(isAdjacent(oGeometry.aPoints[25], oGeometry.aPoints[0]));
+    CHECK(oGeometry.aTraceStarts[26] == 1);
+    CHECK(sameBox(oGeometry.aBoundingBoxes[0], 0, 0, 7, 6));
+
+    // Label 2 has no pixel
+    CHECK(countOf(oGeometry, 2) == 0);
+    CHECK(oGeometry.aBoundingBoxes[2].nMinX > oGeometry.aBoundingBoxes[2].nMaxX);
+}
+
+void testSinglePixel()
+{
+    LabelImage oImage(5, 5);
+    oImage.fill(2, 2, 3, 3, 1);
+    Geometry oGeometry = oImage.trace(2);
+    checkAgainstBruteForce(oImage, oGeometry, 2);
+    CHECK(countOf(oGeometry, 1) == 1);
+    CHECK(traceStartsOf(oGeometry, 1) == 1);
+    CHECK(oGeometry.aPoints[oGeometry.aOffsets[1]].x == 2 && oGeometry.aPoints[oGeometry.aOffsets[1]].y == 2);
+    CHECK(sameBox(oGeometry.aBoundingBoxes[1], 2, 2, 2, 2));
+
+    // A one-pixel image is its own contour
+    LabelImage oTiny(1, 1);
+    Geometry oTinyGeometry = oTiny.trace(1);
+    CHECK(countOf(oTinyGeometry, 0) == 1);
+    CHECK(sameBox(oTinyGeometry.aBoundingBoxes[0], 0, 0, 0, 0));
+}
+
+void testRing()
+{
+    // A 7 x 7 square of label 1 with a 3 x 3 hole of label 2, in a 11 x 11 image of label 0. Label 1 has an outer
+    // trace of 24 pixels and an inner one of 12: the corners of the 5 x 5 ring around the hole only touch it
+    // diagonally.
+    LabelImage oImage(11, 11);
+    oImage.fill(2, 2, 9, 9, 1);
+    oImage.fill(4, 4, 7, 7, 2);
+    Geometry oGeometry = oImage.trace(3, 2);
+    checkAgainstBruteForce(oImage, oGeometry, 3);
+    CHECK(countOf(oGeometry, 1) == 24 + 12);
+    CHECK(traceStartsOf(oGeometry, 1) == 2);
+    unsigned int nBegin = oGeometry.aOffsets[1];
+    CHECK(oGeometry.aPoints[nBegin].x == 2 && oGeometry.aPoints[nBegin].y == 2);
+    CHECK(oGeometry.aTraceStarts[nBegin + 24] == 1);
+    CHECK(oGeometry.aPoints[nBegin + 24].x == 4 && oGeometry.aPoints[nBegin + 24].y == 3);
+    for (unsigned int i = nBegin + 1; i < nBegin + 24; i++)
+        CHECK(isAdjacent(oGeometry.aPoints[i - 1], oGeometry.aPoints[i]));
+    for (unsigned int i = nBegin + 25; i < nBegin + 36; i++)
+        CHECK(isAdjacent(oGeometry.aPoints[i - 1], oGeometry.aPoints[i]));
+    CHECK(sameBox(oGeometry.aBoundingBoxes[1], 2, 2, 8, 8));
+
+    // The whole hole is contour
+    CHECK(countOf(oGeometry, 2) == 8);
+    CHECK(traceStartsOf(oGeometry, 2) == 1);
+    CHECK(sameBox(oGeometry.aBoundingBoxes[2], 4, 4, 6, 6));
+}
+
+void testRandomImages()
+{
+    std::mt19937 oRng(14);
+    for (int nTrial = 0; nTrial < 40; nTrial++)
+    {
+        int nWidth = 1 + nTrial % 23;
+        int nHeight = 1 + (nTrial * 7) % 19;
+        unsigned int nLabelCount = 1 + nTrial % 6;
+        // Random rectangles over a background, so that labels have both blobs and thin pieces
+        LabelImage oImage(nWidth, nHeight);
+        for (int nRect = 0; nRect < 8; nRect++)
+        {
+            int nX0 = std::uniform_int_distribution<int>(0, nWidth - 1)(oRng);
+            int nY0 = std::uniform_int_distribution<int>(0, nHeight - 1)(oRng);
+            int nX1 = std::uniform_int_distribution<int>(nX0 + 1, nWidth)(oRng);
+            int nY1 = std::uniform_int_distribution<int>(nY0 + 1, nHeight)(oRng);
+            oImage.fill(nX0, nY0, nX1, nY1, std::uniform_int_distribution<unsigned int>(0, nLabelCount - 1)(oRng));
+        }
+        // And noise
+        for (int nPixel = 0; nPixel < nWidth * nHeight / 10; nPixel++)
+        {
+            int x = std::uniform_int_distribution<int>(0, nWidth - 1)(oRng);
+            int y = std::uniform_int_distribution<int>(0, nHeight - 1)(oRng);
+            oImage.aLabels[y * nWidth + x] = std::uniform_int_distribution<unsigned int>(0, nLabelCount - 1)(oRng);
+        }
+
+        Geometry oGeometry = oImage.trace(nLabelCount, 1);
+        checkAgainstBruteForce(oImage, oGeometry, nLabelCount);
+
+        // Same output with several threads
+        Geometry oParallel = oImage.trace(nLabelCount, 4);
+        CHECK(oParallel.aOffsets == oGeometry.aOffsets);
+        CHECK(oParallel.aTraceStarts == oGeometry.aTraceStarts);
+        CHECK(oParallel.aPoints.size() == oGeometry.aPoints.size());
+        for (size_t i = 0; i < oParallel.aPoints.size() && i < oGeometry.aPoints.size(); i++)
+            CHECK(oParallel.aPoints[i].x == oGeometry.aPoints[i].x && oParallel.aPoints[i].y == oGeometry.aPoints[i].y);
+    }
+}
+
+void testPitchAndErrors()
+{
+    // A line pitch wider than the image; the padding holds labels that must be ignored
+    LabelImage oImage(6, 4);
+    oImage.fill(1, 1, 4, 3, 1);
+    const size_t nPitch = 9;
+    std::vector<uint32_t> aPadded(nPitch * 4, 99);
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 6; x++)
+            aPadded[y * nPitch + x] = oImage.at(x, y);
+    Geometry oGeometry = ContourGeometry::traceContours(aPadded.data(), 6, 4, nPitch * sizeof(uint32_t), 2, 2);
+    Geometry oExpected = oImage.trace(2);
+    CHECK(oGeometry.aOffsets == oExpected.aOffsets);
+    CHECK(oGeometry.aPoints.size() == oExpected.aPoints.size());
+    for (size_t i = 0; i < oGeometry.aPoints.size() && i < oExpected.aPoints.size(); i++)
+        CHECK(oGeometry.aPoints[i].x == oExpected.aPoints[i].x && oGeometry.aPoints[i].y == oExpected.aPoints[i].y);
+
+    bool bThrown = false;
+    try
+    {
+        oImage.trace(1);  // label 1 out of range
+    }
+    catch (const std::invalid_argument &)
+    {
+        bThrown = true;
+    }
+    CHECK(bThrown);
+    bThrown = false;
+    try
+    {
+        ContourGeometry::traceContours(aPadded.data(), 6, 4, 5 * sizeof(uint32_t), 2);
+    }
+    catch (const std::invalid_argument &)
+    {
+        bThrown = true;
+    }
+    CHECK(bThrown);
+}
+
+void testRasterize()
+{
+    LabelImage oImage(8, 7);
+    oImage.fill(2, 3, 6, 6, 1);
+    oImage.fill(0, 0, 2, 2, 2);
+    Geometry oGeometry = oImage.trace(3);
+
+    // Only labels [1, 2) are drawn, from 240 down along the trace; a pitch of 10 leaves 2 padding bytes per line
+    const size_t nPitch = 10;
+    std::vector<unsigned char> aImage(nPitch * 7, 7);
+    ContourGeometry::rasterizeContours(oGeometry, 1, 2, aImage.data(), nPitch, 2);
+    std::vector<unsigned char> aExpected(nPitch * 7, 7);
+    for (unsigned int i = oGeometry.aOffsets[1]; i < oGeometry.aOffsets[2]; i++)
+    {
+        const Point & oPoint = oGeometry.aPoints[i];
+        aExpected[oPoint.y * nPitch + oPoint.x] = static_cast<unsigned char>(240 - (i - oGeometry.aOffsets[1]));
+    }
+    CHECK(aImage == aExpected);
+    CHECK(aImage[3 * nPitch + 2] == 240);
+
+    // A stop ID past the label count is clamped, and an empty range draws nothing
+    std::vector<unsigned char> aAll(nPitch * 7, 0);
+    ContourGeometry::rasterizeContours(oGeometry, 0, 100, aAll.data(), nPitch);
+    for (int y = 0; y < 7; y++)
+        for (int x = 0; x < 8; x++)
+            CHECK((aAll[y * nPitch + x] != 0) == isContourPixel(oImage, x, y));
+    std::vector<unsigned char> aNone(nPitch * 7, 0);
+    ContourGeometry::rasterizeContours(oGeometry, 2, 2, aNone.data(), nPitch);
+    ContourGeometry::rasterizeContours(oGeometry, 3, 5, aNone.data(), nPitch);
+    CHECK(aNone == std::vector<unsigned char>(nPitch * 7, 0));
+}
+
+} // namespace
+
+int main()
+{
+    testRectangle();
+    testSinglePixel();
+    testRing();
+    testRandomImages();
+    testPitchAndErrors();
+    testRasterize();
+    return test_result("contour_geometry_test");
+}
@@ -0,0 +1,362 @@
+/* Copyright 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+  * 
+  * NOTICE TO LICENSEE: 
+  * 
+  * The source code and/or documentation ("Licensed Deliverables") are 
+  * subject to NVIDIA intellectual property rights under U.S. and 
+  * international Copyright laws. 
+  * 
+  * The Licensed Deliverables contained herein are PROPRIETARY and 
+  * CONFIDENTIAL to NVIDIA and are being provided under the terms and 
+  * conditions of a form of NVIDIA software license agreement by and 
+  * between NVIDIA and Licensee ("License Agreement") or electronically 
+  * accepted by Licensee.  Notwithstanding any terms or conditions to 
+  * the contrary in the License Agreement, reproduction or disclosure 
+  * of the Licensed Deliverables to any third party without the express 
+  * written consent of NVIDIA is prohibited. 
+  * 
+  * NOTWITHSTANDING ANY TERMS OR CONDITIONS TO THE CONTRARY IN THE 
+  * LICENSE AGREEMENT, NVIDIA MAKES NO REPRESENTATION ABOUT THE 
+  * SUITABILITY OF THESE LICENSED DELIVERABLES FOR ANY PURPOSE.  THEY ARE 
+  * PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY OF ANY KIND. 
+  * NVIDIA DISCLAIMS ALL WARRANTIES WITH REGARD TO THESE LICENSED 
+  * DELIVERABLES, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY, 
+  * NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE. 
+  * NOTWITHSTANDING ANY TERMS OR CONDITIONS TO THE CONTRARY IN THE 
+  * LICENSE AGREEMENT, IN NO EVENT SHALL NVIDIA BE LIABLE FOR ANY 
+  * SPECIAL, INDIRECT, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, OR ANY 
+  * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, 
+  * WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS 
+  * ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE 
+  * OF THESE LICENSED DELIVERABLES. 
+  * 
+  * U.S. Government End Users.  These Licensed Deliverables are a 
+  * "commercial item" as that term is defined at 48 C.F.R. 2.101 (OCT 
+  * 1995), consisting of "commercial computer software" and "commercial 
+  * computer software documentation" as such terms are used in 48 
+  * C.F.R. 12.212 (SEPT 1995) and are provided to the U.S. Government 
+  * only as a commercial end item.  Consistent with 48 C.F.R.12.212 and 
+  * 48 C.F.R. 227.7202-1 through 227.7202-4 (JUNE 1995), all 
+  * U.S. Government End Users acquire the Licensed Deliverables with 
+  * only those rights set forth herein. 
+  * 
+  * Any use of the Licensed Deliverables in individual and commercial 
+  * software must include, in the user documentation and internal 
+  * comments to the code, the above Disclaimer and U.S. Government End 
+  * Users Notice. 
+  */
+
+// Host-only check of the batchedLabelMarkersAndCompression and findContour outputs.
+//
+// Labels the samples' input images on the CPU with label_markers_host.h, compares the label images the sample
+// wrote with them up to a renumbering of the labels, and times host labelling and compression per image and for
+// the whole batch. No GPU or CUDA toolkit is needed, so the check can run on CPU-only machines.
+
+#include "label_markers_host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#define NUMBER_OF_IMAGES 5
+
+struct SampleImage
+{
+    const char * szName;
+    const char * szInputFile;
+    int nWidth;
+    int nHeight;
+};
+
+// The inputs of batchedLabelMarkersAndCompression, in the same order
+static const SampleImage aSampleImages[NUMBER_OF_IMAGES] =
+{
+    {"Lena", "lena_512x512_8u.raw", 512, 512},
+    {"CT_skull", "CT_skull_512x512_8u.raw", 512, 512},
+    {"PCB_METAL", "PCB_METAL_509x335_8u.raw", 509, 335},
+    {"PCB2", "PCB2_1024x683_8u.raw", 1024, 683},
+    {"PCB", "PCB_1280x720_8u.raw", 1280, 720}
+};
+
+// The input of findContour
+static const SampleImage oCircuitBoard = {"CircuitBoard", "CircuitBoard_2048x1024_8u.raw", 2048, 1024};
+
+typedef std::chrono::steady_clock Clock;
+
+int findParamIndex(const char ** argv, int argc, const char * parm)
+{
+    int index = -1;
+    for (int i = 0; i < argc; i++)
+        if (strncmp(argv[i], parm, 100) == 0)
+            index = i;
+    return index;
+}
+
+bool loadRaw(const std::string & sFile, void * pData, size_t nSize)
+{
+    FILE * pFile = fopen(sFile.c_str(), "rb");
+    if (pFile == NULL)
+        return false;
+    size_t nRead = fread(pData, 1, nSize, pFile);
+    fclose(pFile);
+    return nRead == nSize;
+}
+
+// Path of a 32u output the sample writes for oImage, e.g. Lena_LabelMarkersUF_8Way_512x512_32u.raw
+std::string outputFile(const std::string & sPath, const SampleImage & oImage, const char * szKind)
+{
+    return sPath + oImage.szName + "_" + szKind + "_8Way_" + std::to_string(oImage.nWidth) + "x" +
+           std::to_string(oImage.nHeight) + "_32u.raw";
+}
+
+double milliseconds(Clock::duration oDuration)
+{
+    return std::chrono::duration<double, std::milli>(oDuration).count();
+}
+
+// Runs f nRepetitions times and returns the fastest run in milliseconds
+template <typename F>
+double bestTime(int nRepetitions, F f)
+{
+    double nBest = 0.0;
+    for (int i = 0; i < nRepetitions; i++)
+    {
+        Clock::time_point oStart = Clock::now();
+        f();
+        double nTime = milliseconds(Clock::now() - oStart);
+        if (i == 0 || nTime < nBest)
+            nBest = nTime;
+    }
+    return nBest;
+}
+
+// Prints the comparison of a device label image with the host labels; returns false when bStrict is set and they
+// are not equivalent. Without bStrict only labels that join pixels of different values fail, since the UF
+// functions of some NPP releases split or join a few components of equal-valued pixels.
+bool reportComparison(const char * szReference, const LabelMarkersHost::Comparison & oComparison,
+                      size_t nMixedLabels, bool bStrict)
+{
+    if (nMixedLabels != 0)
+    {
+        printf("    %-36s MISMATCH: %zu labels join pixels of different values\n", szReference, nMixedLabels);
+        return false;
+    }
+    if (oComparison.isEquivalent())
+    {
+        printf("    %-36s equivalent (%u labels)\n", szReference, oComparison.nActualLabels);
+        return true;
+    }
+    printf("    %-36s %s: %u labels, %u splits, %u merges, %zu mismatched pixels\n", szReference,
+           bStrict ? "MISMATCH" : "differs", oComparison.nActualLabels, oComparison.nSplits, oComparison.nMerges,
+           oComparison.nMismatchedPixels);
+    return !bStrict;
+}
+
+// Number of UF labels whose pixels do not all have the value of the label's pixel
+size_t countMixedLabels(const std::vector<uint8_t> & aInput, const std::vector<uint32_t> & aLabels)
+{
+    std::vector<unsigned char> aMixed(aInput.size(), 0);
+    size_t nMixedLabels = 0;
+    for (size_t i = 0; i < aLabels.size(); i++)
+    {
+        uint32_t nLabel = aLabels[i];
+        if (nLabel >= aInput.size())
+            aMixed[i] = 1;
+        else if (aInput[nLabel] != aInput[i] && !aMixed[nLabel])
+            aMixed[nLabel] = 1;
+        else
+            continue;
+        nMixedLabels++;
+    }
+    return nMixedLabels;
+}
+
+// Checks that szCompressedKind is the compression of the UF labels in aUFLabels
+bool reportCompression(const std::string & sPath, const SampleImage & oImage, const char * szCompressedKind,
+                       std::vector<uint32_t> aUFLabels, LabelMarkersHost::Labeler & oLabeler)
+{
+    std::string sFile = outputFile(sPath, oImage, szCompressedKind);
+    std::vector<uint32_t> aCompressed(aUFLabels.size());
+    if (!loadRaw(sFile, aCompressed.data(), aCompressed.size() * sizeof(uint32_t)))
+        return true;
+
+    std::string sReference = std::string(szCompressedKind) + " reference:";
+    LabelMarkersHost::LabelImage oLabels = {aUFLabels.data(), oImage.nWidth * sizeof(uint32_t), oImage.nWidth,
+                                            oImage.nHeight};
+    unsigned int nLabelCount = 0;
+    try
+    {
+        nLabelCount = oLabeler.compressMarkerLabels(oLabels);
+    }
+    catch (const std::invalid_argument &)
+    {
+        printf("    %-36s MISMATCH: its UF labels are not UF labels\n", sReference.c_str());
+        return false;
+    }
+    size_t nMismatches = 0;
+    for (size_t i = 0; i < aCompressed.size(); i++)
+        nMismatches += aCompressed[i] != aUFLabels[i];
+    if (nMismatches != 0)
+    {
+        printf("    %-36s MISMATCH: %zu pixels differ from the compressed UF labels\n", sReference.c_str(),
+               nMismatches);
+        return false;
+    }
+    printf("    %-36s matches its compressed UF labels (%u labels)\n", sReference.c_str(), nLabelCount);
+    return true;
+}
+
+int main(int argc, const char * argv[])
+{
+    if (findParamIndex(argv, argc, "-h") != -1 || findParamIndex(argv, argc, "--help") != -1)
+    {
+        printf("Usage: %s [-b number-of-batch] [-c 4|8] [-t threads] [-r repetitions] [-d image-directory]\n"
+               "       [-f findContour-image-directory] [-s]\n", argv[0]);
+        printf("Parameters: \n");
+        printf("\tnumber-of-batch\t:\tUse number of batch to process [default 5]\n");
+        printf("\t4|8\t\t:\tConnectivity; the sample outputs are only checked for 8 [default 8]\n");
+        printf("\tthreads\t\t:\tHost threads, 0 for all hardware threads [default 0]\n");
+        printf("\trepetitions\t:\tTimed runs, the fastest is reported [default 10]\n");
+        printf("\timage-directory\t:\tInputs and sample outputs [default ../../batchedLabelMarkersAndCompression/images/]\n");
+        printf("\tfindContour-image-directory\t:\tAlso check the findContour image there [default none]\n");
+        printf("\t-s\t\t:\tFail unless the sample outputs are equivalent to the host labels\n");
+        return EXIT_SUCCESS;
+    }
+
+    int pidx;
+    int nBatch = NUMBER_OF_IMAGES;
+    int nConnectivity = 8;
+    unsigned int nThreads = 0;
+    int nRepetitions = 10;
+    std::string sPath = "../../batchedLabelMarkersAndCompression/images/";
+    bool bStrict = findParamIndex(argv, argc, "-s") != -1;
+    if ((pidx = findParamIndex(argv, argc, "-b")) != -1 && pidx + 1 < argc)
+        nBatch = atoi(argv[pidx + 1]);
+    if ((pidx = findParamIndex(argv, argc, "-c")) != -1 && pidx + 1 < argc)
+        nConnectivity = atoi(argv[pidx + 1]);
+    if ((pidx = findParamIndex(argv, argc, "-t")) != -1 && pidx + 1 < argc)
+        nThreads = static_cast<unsigned int>(atoi(argv[pidx + 1]));
+    if ((pidx = findParamIndex(argv, argc, "-r")) != -1 && pidx + 1 < argc)
+        nRepetitions = atoi(argv[pidx + 1]);
+    if ((pidx = findParamIndex(argv, argc, "-d")) != -1 && pidx + 1 < argc)
+        sPath = std::string(argv[pidx + 1]) + "/";
+    if (nBatch < 1 || nBatch > NUMBER_OF_IMAGES || (nConnectivity != 4 && nConnectivity != 8) || nRepetitions < 1)
+    {
+        printf("Invalid parameters, see %s -h\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::vector<SampleImage> aImages(aSampleImages, aSampleImages + nBatch);
+    std::vector<std::string> aPaths(aImages.size(), sPath);
+    if ((pidx = findParamIndex(argv, argc, "-f")) != -1 && pidx + 1 < argc)
+    {
+        aImages.push_back(oCircuitBoard);
+        aPaths.push_back(std::string(argv[pidx + 1]) + "/");
+    }
+    LabelMarkersHost::Connectivity eConnectivity =
+        nConnectivity == 8 ? LabelMarkersHost::Connectivity8Way : LabelMarkersHost::Connectivity4Way;
+
+    size_t nImages = aImages.size();
+    std::vector<std::vector<uint8_t>> aInputs(nImages);
+    std::vector<std::vector<uint32_t>> aLabels(nImages);
+    std::vector<LabelMarkersHost::SourceImage<uint8_t>> aSources(nImages);
+    std::vector<LabelMarkersHost::LabelImage> aLabelImages(nImages);
+    size_t nBatchPixels = 0;
+    for (size_t j = 0; j < nImages; j++)
+    {
+        const SampleImage & oImage = aImages[j];
+        size_t nPixels = static_cast<size_t>(oImage.nWidth) * oImage.nHeight;
+        aInputs[j].resize(nPixels);
+        aLabels[j].resize(nPixels);
+        if (!loadRaw(aPaths[j] + oImage.szInputFile, aInputs[j].data(), nPixels))
+        {
+            printf("Input file load failed: %s%s\n", aPaths[j].c_str(), oImage.szInputFile);
+            return EXIT_FAILURE;
+        }
+        LabelMarkersHost::SourceImage<uint8_t> oSource = {aInputs[j].data(), static_cast<size_t>(oImage.nWidth),
+                                                          oImage.nWidth, oImage.nHeight};
+        LabelMarkersHost::LabelImage oLabels = {aLabels[j].data(), oImage.nWidth * sizeof(uint32_t),
+                                                oImage.nWidth, oImage.nHeight};
+        aSources[j] = oSource;
+        aLabelImages[j] = oLabels;
+        nBatchPixels += nPixels;
+    }
+
+    LabelMarkersHost::Labeler oLabeler(nThreads);
+    printf("Host threads: %zu, connectivity: %d-way, repetitions: %d\n\n", oLabeler.threadCount(), nConnectivity,
+           nRepetitions);
+
+    bool bPassed = true;
+    for (size_t j = 0; j < nImages; j++)
+    {
+        const SampleImage & oImage = aImages[j];
+        size_t nPixels = aLabels[j].size();
+        double nLabelTime = bestTime(nRepetitions, [&]()
+        {
+            oLabeler.labelMarkers(aSources[j], aLabelImages[j], eConnectivity);
+        });
+
+        std::vector<uint32_t> aCompressed(nPixels);
+        LabelMarkersHost::LabelImage oCompressed = {aCompressed.data(), oImage.nWidth * sizeof(uint32_t),
+                                                    oImage.nWidth, oImage.nHeight};
+        unsigned int nLabelCount = 0;
+        double nCompressTime = 0.0;
+        for (int i = 0; i < nRepetitions; i++)
+        {
+            aCompressed = aLabels[j];
+            Clock::time_point oStart = Clock::now();
+            nLabelCount = oLabeler.compressMarkerLabels(oCompressed);
+            double nTime = milliseconds(Clock::now() - oStart);
+            if (i == 0 || nTime < nCompressTime)
+                nCompressTime = nTime;
+        }
+        printf("%s_%dx%d: %u labels, label %.3f ms (%.1f Mpixel/s), compress %.3f ms\n", oImage.szName,
+               oImage.nWidth, oImage.nHeight, nLabelCount, nLabelTime, nPixels / nLabelTime * 1e-3, nCompressTime);
+        if (eConnectivity != LabelMarkersHost::Connectivity8Way)
+            continue;
+
+        const char * aKinds[] = {"LabelMarkersUF", "LabelMarkersUFBatch"};
+        const char * aCompressedKinds[] = {"CompressedMarkerLabelsUF", "CompressedMarkerLabelsUFBatch"};
+        for (int k = 0; k < 2; k++)
+        {
+            std::vector<uint32_t> aReference(nPixels);
+            std::string sReference = std::string(aKinds[k]) + " reference:";
+            if (!loadRaw(outputFile(aPaths[j], oImage, aKinds[k]), aReference.data(), nPixels * sizeof(uint32_t)))
+            {
+                printf("    %-36s not found\n", sReference.c_str());
+                continue;
+            }
+            LabelMarkersHost::LabelImage oReference = {aReference.data(), oImage.nWidth * sizeof(uint32_t),
+                                                       oImage.nWidth, oImage.nHeight};
+            bPassed &= reportComparison(sReference.c_str(),
+                                        LabelMarkersHost::compareLabels(aLabelImages[j], oReference),
+                                        countMixedLabels(aInputs[j], aReference), bStrict);
+            bPassed &= reportCompression(aPaths[j], oImage, aCompressedKinds[k], aReference, oLabeler);
+        }
+    }
+
+    double nBatchLabelTime = bestTime(nRepetitions, [&]()
+    {
+        oLabeler.labelMarkersBatch(aSources.data(), aLabelImages.data(), aSources.size(), eConnectivity);
+    });
+    std::vector<std::vector<uint32_t>> aUFLabels = aLabels;
+    std::vector<unsigned int> aLabelCounts(nImages);
+    double nBatchCompressTime = 0.0;
+    for (int i = 0; i < nRepetitions; i++)
+    {
+        for (size_t j = 0; j < nImages; j++)
+            aLabels[j] = aUFLabels[j];
+        Clock::time_point oStart = Clock::now();
+        oLabeler.compressMarkerLabelsBatch(aLabelImages.data(), aLabelImages.size(), aLabelCounts.data());
+        double nTime = milliseconds(Clock::now() - oStart);
+        if (i == 0 || nTime < nBatchCompressTime)
+            nBatchCompressTime = nTime;
+    }
+    printf("\nBatch of %zu images (%.2f Mpixel): label %.3f ms (%.1f Mpixel/s), compress %.3f ms\n", nImages,
+           nBatchPixels * 1e-6, nBatchLabelTime, nBatchPixels / nBatchLabelTime * 1e-3, nBatchCompressTime);
+
+    printf("\n%s\n", bPassed ? "PASSED" : "FAILED");
+    return bPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
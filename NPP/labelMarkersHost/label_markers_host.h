@@ -0,0 +1,485 @@
+#pragma once
+
+// Host connected-component labelling engine matching nppiLabelMarkersUF and nppiCompressMarkerLabelsUF.
+//
+// Two pixels are connected when they have the same value and are 4-way (nppiNormL1) or 8-way (nppiNormInf)
+// neighbours. Every pixel of a component is labelled with the linear index y * nWidth + x of the component's first
+// pixel in raster order, which is what the NPP UF functions write. Compression then renumbers the labels densely
+// from 0 in the raster order of their first pixel, as nppiCompressMarkerLabelsUF does.
+//
+// Labelling is union-find over row strips. Each strip is labelled on its own thread, linking the larger root under
+// the smaller one so that every root is the smallest index of its set; the strip borders of an image are then
+// merged on one thread and the strips resolve their final labels in parallel again. Images of a batch share the
+// same three passes, so a batch of small images keeps every thread busy and a large image is split across them.
+//
+// compareLabels() checks two labellings of one image up to a renumbering of the labels and reports how far they
+// are from it, so that device results can be checked without requiring bit-identical labels.
+
+#include <utils/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace LabelMarkersHost
+{
+
+enum Connectivity
+{
+    Connectivity4Way,   // nppiNormL1
+    Connectivity8Way    // nppiNormInf
+};
+
+// Image with a line pitch of nPitch bytes
+template <typename T>
+struct SourceImage
+{
+    const T * pData;
+    size_t nPitch;
+    int nWidth;
+    int nHeight;
+};
+
+struct LabelImage
+{
+    uint32_t * pData;
+    size_t nPitch;
+    int nWidth;
+    int nHeight;
+};
+
+struct Comparison
+{
+    unsigned int nExpectedLabels;
+    unsigned int nActualLabels;
+    unsigned int nSplits;           // extra actual labels inside expected components
+    unsigned int nMerges;           // expected components that share an actual label, counted like nSplits
+    size_t nMismatchedPixels;       // pixels outside the best one-to-one pairing of expected and actual labels
+
+    bool isEquivalent() const
+    {
+        return nSplits == 0 && nMerges == 0;
+    }
+};
+
+namespace Kernel
+{
+
+// Strips aim at this many pixels, so that small images are one task and large ones give every thread work
+static const size_t kStripPixels = 32768;
+static const int kMinStripRows = 8;
+
+struct Strip
+{
+    size_t nImage;
+    int nBeginY;
+    int nEndY;
+};
+
+// Root of nIndex, halving the path on the way; parents never point to a larger index
+inline uint32_t find(uint32_t * pParents, uint32_t nIndex)
+{
+    while (pParents[nIndex] != nIndex)
+    {
+        pParents[nIndex] = pParents[pParents[nIndex]];
+        nIndex = pParents[nIndex];
+    }
+    return nIndex;
+}
+
+inline uint32_t findReadOnly(const uint32_t * pParents, uint32_t nIndex)
+{
+    while (pParents[nIndex] != nIndex)
+        nIndex = pParents[nIndex];
+    return nIndex;
+}
+
+inline void unite(uint32_t * pParents, uint32_t nA, uint32_t nB)
+{
+    nA = find(pParents, nA);
+    nB = find(pParents, nB);
+    if (nA < nB)
+        pParents[nB] = nA;
+    else if (nB < nA)
+        pParents[nA] = nB;
+}
+
+template <typename T>
+const T * row(const SourceImage<T> & oImage, int y)
+{
+    return reinterpret_cast<const T *>(reinterpret_cast<const unsigned char *>(oImage.pData) + y * oImage.nPitch);
+}
+
+inline uint32_t * row(const LabelImage & oImage, int y)
+{
+    return reinterpret_cast<uint32_t *>(reinterpret_cast<unsigned char *>(oImage.pData) + y * oImage.nPitch);
+}
+
+// Links pixel x of row y to its matching neighbours in row y - 1. With 8-way connectivity the diagonal
+// neighbours are already connected to the one straight above when that one matches.
+template <typename T>
+inline void uniteAbove(uint32_t * pParents, const T * pRow, const T * pAbove, uint32_t nIndex, int x, int nWidth,
+                       Connectivity eConnectivity)
+{
+    T nValue = pRow[x];
+    if (pAbove[x] == nValue)
+    {
+        unite(pParents, nIndex, nIndex - nWidth);
+        return;
+    }
+    if (eConnectivity == Connectivity8Way)
+    {
+        if (x > 0 && pAbove[x - 1] == nValue)
+            unite(pParents, nIndex, nIndex - nWidth - 1);
+        if (x + 1 < nWidth && pAbove[x + 1] == nValue)
+            unite(pParents, nIndex, nIndex - nWidth + 1);
+    }
+}
+
+template <typename T>
+void labelStrip(const SourceImage<T> & oImage, uint32_t * pParents, int nBeginY, int nEndY,
+                Connectivity eConnectivity)
+{
+    int nWidth = oImage.nWidth;
+    for (int y = nBeginY; y < nEndY; y++)
+    {
+        const T * pRow = row(oImage, y);
+        const T * pAbove = y > nBeginY ? row(oImage, y - 1) : nullptr;
+        uint32_t nIndex = static_cast<uint32_t>(y) * nWidth;
+        for (int x = 0; x < nWidth; x++, nIndex++)
+        {
+            pParents[nIndex] = nIndex;
+            // West and north-west are vertical neighbours, so with 8-way connectivity a matching west pixel
+            // already covers a matching north-west one
+            bool bWest = x > 0 && pRow[x - 1] == pRow[x];
+            if (bWest)
+                unite(pParents, nIndex, nIndex - 1);
+            if (pAbove == nullptr)
+                continue;
+            if (bWest && eConnectivity == Connectivity8Way && pAbove[x] != pRow[x])
+            {
+                if (x + 1 < nWidth && pAbove[x + 1] == pRow[x])
+                    unite(pParents, nIndex, nIndex - nWidth + 1);
+                continue;
+            }
+            uniteAbove(pParents, pRow, pAbove, nIndex, x, nWidth, eConnectivity);
+        }
+    }
+}
+
+// Writes the root of every pixel of the strip. Parents are only read here; roots inside the strip come from the
+// labels already written, since a parent never has a larger index.
+inline void resolveStrip(const LabelImage & oLabels, const uint32_t * pParents, int nBeginY, int nEndY)
+{
+    int nWidth = oLabels.nWidth;
+    uint32_t nStripBegin = static_cast<uint32_t>(nBeginY) * nWidth;
+    for (int y = nBeginY; y < nEndY; y++)
+    {
+        uint32_t * pRow = row(oLabels, y);
+        const uint32_t * pAbove = y > nBeginY ? row(oLabels, y - 1) : nullptr;
+        uint32_t nRowBegin = static_cast<uint32_t>(y) * nWidth;
+        for (int x = 0; x < nWidth; x++)
+        {
+            uint32_t nIndex = nRowBegin + x;
+            uint32_t nParent = pParents[nIndex];
+            if (nParent == nIndex)
+                pRow[x] = nIndex;
+            else if (nParent >= nRowBegin)
+                pRow[x] = pRow[nParent - nRowBegin];
+            else if (pAbove != nullptr && nParent >= nRowBegin - nWidth)
+                pRow[x] = pAbove[nParent - (nRowBegin - nWidth)];
+            else if (nParent >= nStripBegin)
+                pRow[x] = row(oLabels, static_cast<int>(nParent / nWidth))[nParent % nWidth];
+            else
+                pRow[x] = findReadOnly(pParents, nParent);
+        }
+    }
+}
+
+} // namespace Kernel
+
+// Labels and compresses images on a shared thread pool. The scratch buffers are kept between calls, so that
+// labelling many small images does not allocate every time.
+class Labeler
+{
+public:
+    // nThreads = 0 uses every hardware thread
+    explicit Labeler(unsigned int nThreads = 0)
+        : oPool_(nThreads != 0 ? nThreads : std::max(1u, std::thread::hardware_concurrency()))
+    {
+    }
+
+    size_t threadCount() const
+    {
+        return oPool_.size();
+    }
+
+    // Labels aSources[i] into aLabels[i], which must have the same size, for i < nCount
+    template <typename T>
+    void labelMarkersBatch(const SourceImage<T> * aSources, const LabelImage * aLabels, size_t nCount,
+                           Connectivity eConnectivity)
+    {
+        for (size_t i = 0; i < nCount; i++)
+            validate(aLabels[i], aSources[i].nWidth, aSources[i].nHeight, aSources[i].nPitch, sizeof(T));
+        buildStrips(aLabels, nCount);
+        if (aParents_.size() < nCount)
+            aParents_.resize(nCount);
+        for (size_t i = 0; i < nCount; i++)
+            aParents_[i].resize(static_cast<size_t>(aLabels[i].nWidth) * aLabels[i].nHeight);
+
+        oPool_.enqueue_batch(aStrips_.size(), [&](int, size_t nStrip)
+        {
+            const Kernel::Strip & oStrip = aStrips_[nStrip];
+            Kernel::labelStrip(aSources[oStrip.nImage], aParents_[oStrip.nImage].data(), oStrip.nBeginY,
+                               oStrip.nEndY, eConnectivity);
+        });
+        oPool_.wait();
+
+        // Strip borders, one task per image; the strips of an image are consecutive in aStrips_
+        oPool_.enqueue_batch(nCount, [&](int, size_t nImage)
+        {
+            const SourceImage<T> & oImage = aSources[nImage];
+            uint32_t * pParents = aParents_[nImage].data();
+            for (size_t nStrip = aFirstStrips_[nImage] + 1; nStrip < aFirstStrips_[nImage + 1]; nStrip++)
+            {
+                int y = aStrips_[nStrip].nBeginY;
+                const T * pRow = Kernel::row(oImage, y);
+                const T * pAbove = Kernel::row(oImage, y - 1);
+                uint32_t nIndex = static_cast<uint32_t>(y) * oImage.nWidth;
+                for (int x = 0; x < oImage.nWidth; x++)
+                    Kernel::uniteAbove(pParents, pRow, pAbove, nIndex + x, x, oImage.nWidth, eConnectivity);
+            }
+        });
+        oPool_.wait();
+
+        oPool_.enqueue_batch(aStrips_.size(), [&](int, size_t nStrip)
+        {
+            const Kernel::Strip & oStrip = aStrips_[nStrip];
+            Kernel::resolveStrip(aLabels[oStrip.nImage], aParents_[oStrip.nImage].data(), oStrip.nBeginY,
+                                 oStrip.nEndY);
+        });
+        oPool_.wait();
+    }
+
+    template <typename T>
+    void labelMarkers(const SourceImage<T> & oSource, const LabelImage & oLabels, Connectivity eConnectivity)
+    {
+        labelMarkersBatch(&oSource, &oLabels, 1, eConnectivity);
+    }
+
+    // Renumbers labelMarkers() output in place and stores the label count of image i in aLabelCounts[i]. Throws
+    // std::invalid_argument, leaving the labels untouched, when an image does not hold UF labels.
+    void compressMarkerLabelsBatch(const LabelImage * aLabels, size_t nCount, unsigned int * aLabelCounts)
+    {
+        for (size_t i = 0; i < nCount; i++)
+            validate(aLabels[i], aLabels[i].nWidth, aLabels[i].nHeight, 0, 0);
+        buildStrips(aLabels, nCount);
+        if (aParents_.size() < nCount)
+            aParents_.resize(nCount);
+        for (size_t i = 0; i < nCount; i++)
+            aParents_[i].resize(static_cast<size_t>(aLabels[i].nWidth) * aLabels[i].nHeight);
+        aStripCounts_.assign(aStrips_.size(), 0);
+
+        // Roots per strip. A pixel is a root when its label is its own index; every other label must name a root
+        // that comes before it.
+        std::atomic<bool> bInvalid(false);
+        oPool_.enqueue_batch(aStrips_.size(), [&](int, size_t nStrip)
+        {
+            const Kernel::Strip & oStrip = aStrips_[nStrip];
+            const LabelImage & oImage = aLabels[oStrip.nImage];
+            uint32_t nCount = 0;
+            bool bValid = true;
+            for (int y = oStrip.nBeginY; y < oStrip.nEndY; y++)
+            {
+                const uint32_t * pRow = Kernel::row(oImage, y);
+                uint32_t nIndex = static_cast<uint32_t>(y) * oImage.nWidth;
+                for (int x = 0; x < oImage.nWidth; x++, nIndex++)
+                {
+                    uint32_t nLabel = pRow[x];
+                    if (nLabel == nIndex)
+                        nCount++;
+                    else if (x > 0 && nLabel == pRow[x - 1])
+                        continue;
+                    else if (nLabel > nIndex ||
+                             Kernel::row(oImage, static_cast<int>(nLabel / oImage.nWidth))[nLabel % oImage.nWidth] !=
+                                 nLabel)
+                        bValid = false;
+                }
+            }
+            aStripCounts_[nStrip] = nCount;
+            if (!bValid)
+                bInvalid = true;
+        });
+        oPool_.wait();
+        if (bInvalid)
+            throw std::invalid_argument("LabelMarkersHost::compressMarkerLabels: labels are not UF labels");
+
+        // The compressed label of a root is the number of roots before it
+        for (size_t nImage = 0; nImage < nCount; nImage++)
+        {
+            uint32_t nTotal = 0;
+            for (size_t nStrip = aFirstStrips_[nImage]; nStrip < aFirstStrips_[nImage + 1]; nStrip++)
+            {
+                uint32_t nStripCount = aStripCounts_[nStrip];
+                aStripCounts_[nStrip] = nTotal;
+                nTotal += nStripCount;
+            }
+            aLabelCounts[nImage] = nTotal;
+        }
+        oPool_.enqueue_batch(aStrips_.size(), [&](int, size_t nStrip)
+        {
+            const Kernel::Strip & oStrip = aStrips_[nStrip];
+            const LabelImage & oImage = aLabels[oStrip.nImage];
+            uint32_t * pIds = aParents_[oStrip.nImage].data();
+            uint32_t nNext = aStripCounts_[nStrip];
+            for (int y = oStrip.nBeginY; y < oStrip.nEndY; y++)
+            {
+                const uint32_t * pRow = Kernel::row(oImage, y);
+                uint32_t nIndex = static_cast<uint32_t>(y) * oImage.nWidth;
+                for (int x = 0; x < oImage.nWidth; x++, nIndex++)
+                    if (pRow[x] == nIndex)
+                        pIds[nIndex] = nNext++;
+            }
+        });
+        oPool_.wait();
+
+        oPool_.enqueue_batch(aStrips_.size(), [&](int, size_t nStrip)
+        {
+            const Kernel::Strip & oStrip = aStrips_[nStrip];
+            const LabelImage & oImage = aLabels[oStrip.nImage];
+            const uint32_t * pIds = aParents_[oStrip.nImage].data();
+            for (int y = oStrip.nBeginY; y < oStrip.nEndY; y++)
+            {
+                uint32_t * pRow = Kernel::row(oImage, y);
+                for (int x = 0; x < oImage.nWidth; x++)
+                    pRow[x] = pIds[pRow[x]];
+            }
+        });
+        oPool_.wait();
+    }
+
+    unsigned int compressMarkerLabels(const LabelImage & oLabels)
+    {
+        unsigned int nLabelCount = 0;
+        compressMarkerLabelsBatch(&oLabels, 1, &nLabelCount);
+        return nLabelCount;
+    }
+
+private:
+    static void validate(const LabelImage & oLabels, int nWidth, int nHeight, size_t nSourcePitch,
+                         size_t nSourcePixelSize)
+    {
+        if (nWidth <= 0 || nHeight <= 0 || oLabels.nWidth != nWidth || oLabels.nHeight != nHeight ||
+            oLabels.nPitch < nWidth * sizeof(uint32_t) || nSourcePitch < nWidth * nSourcePixelSize)
+            throw std::invalid_argument("LabelMarkersHost: invalid image");
+        if (static_cast<uint64_t>(nWidth) * nHeight > UINT32_MAX)
+            throw std::invalid_argument("LabelMarkersHost: image has too many pixels for 32-bit labels");
+    }
+
+    void buildStrips(const LabelImage * aLabels, size_t nCount)
+    {
+        aStrips_.clear();
+        aFirstStrips_.assign(1, 0);
+        for (size_t nImage = 0; nImage < nCount; nImage++)
+        {
+            int nHeight = aLabels[nImage].nHeight;
+            size_t nPixels = static_cast<size_t>(aLabels[nImage].nWidth) * nHeight;
+            size_t nStripCount = (nPixels + Kernel::kStripPixels - 1) / Kernel::kStripPixels;
+            nStripCount = std::min(nStripCount, 4 * oPool_.size());
+            nStripCount = std::min<size_t>(nStripCount, (nHeight + Kernel::kMinStripRows - 1) / Kernel::kMinStripRows);
+            nStripCount = std::max<size_t>(nStripCount, 1);
+            for (size_t nStrip = 0; nStrip < nStripCount; nStrip++)
+            {
+                Kernel::Strip oStrip = {nImage, static_cast<int>(nHeight * nStrip / nStripCount),
+                                        static_cast<int>(nHeight * (nStrip + 1) / nStripCount)};
+                aStrips_.push_back(oStrip);
+            }
+            aFirstStrips_.push_back(aStrips_.size());
+        }
+    }
+
+    ThreadPool oPool_;
+    std::vector<Kernel::Strip> aStrips_;
+    std::vector<size_t> aFirstStrips_;          // strips of image i are [aFirstStrips_[i], aFirstStrips_[i + 1])
+    std::vector<uint32_t> aStripCounts_;
+    std::vector<std::vector<uint32_t>> aParents_;
+};
+
+// Compares two labellings of the same image up to a renumbering of the labels
+inline Comparison compareLabels(const LabelImage & oExpected, const LabelImage & oActual)
+{
+    if (oExpected.nWidth != oActual.nWidth || oExpected.nHeight != oActual.nHeight)
+        throw std::invalid_argument("LabelMarkersHost::compareLabels: image sizes differ");
+
+    // (expected, actual) label pairs, sorted so that equal pairs and equal expected labels are adjacent
+    std::vector<uint64_t> aPairs;
+    aPairs.reserve(static_cast<size_t>(oExpected.nWidth) * oExpected.nHeight);
+    std::vector<uint32_t> aActualLabels;
+    aActualLabels.reserve(aPairs.capacity());
+    for (int y = 0; y < oExpected.nHeight; y++)
+    {
+        const uint32_t * pExpected = Kernel::row(oExpected, y);
+        const uint32_t * pActual = Kernel::row(oActual, y);
+        for (int x = 0; x < oExpected.nWidth; x++)
+        {
+            aPairs.push_back(static_cast<uint64_t>(pExpected[x]) << 32 | pActual[x]);
+            aActualLabels.push_back(pActual[x]);
+        }
+    }
+    std::sort(aPairs.begin(), aPairs.end());
+    std::sort(aActualLabels.begin(), aActualLabels.end());
+    aActualLabels.erase(std::unique(aActualLabels.begin(), aActualLabels.end()), aActualLabels.end());
+
+    struct Pair
+    {
+        size_t nPixels;
+        uint32_t nExpected;     // dense expected label
+        uint32_t nActual;       // index into aActualLabels
+    };
+    std::vector<Pair> aDistinctPairs;
+    uint32_t nExpectedLabels = 0;
+    for (size_t nBegin = 0; nBegin < aPairs.size();)
+    {
+        size_t nEnd = nBegin + 1;
+        while (nEnd < aPairs.size() && aPairs[nEnd] == aPairs[nBegin])
+            nEnd++;
+        if (nBegin == 0 || aPairs[nBegin] >> 32 != aPairs[nBegin - 1] >> 32)
+            nExpectedLabels++;
+        uint32_t nActual = static_cast<uint32_t>(aPairs[nBegin]);
+        Pair oPair = {nEnd - nBegin, nExpectedLabels - 1,
+                      static_cast<uint32_t>(std::lower_bound(aActualLabels.begin(), aActualLabels.end(), nActual) -
+                                            aActualLabels.begin())};
+        aDistinctPairs.push_back(oPair);
+        nBegin = nEnd;
+    }
+
+    Comparison oComparison;
+    oComparison.nExpectedLabels = nExpectedLabels;
+    oComparison.nActualLabels = static_cast<unsigned int>(aActualLabels.size());
+    oComparison.nSplits = static_cast<unsigned int>(aDistinctPairs.size()) - oComparison.nExpectedLabels;
+    oComparison.nMerges = static_cast<unsigned int>(aDistinctPairs.size()) - oComparison.nActualLabels;
+
+    // Pair labels greedily by overlap; every pixel outside the pairing mismatches
+    std::stable_sort(aDistinctPairs.begin(), aDistinctPairs.end(), [](const Pair & a, const Pair & b)
+    {
+        return a.nPixels > b.nPixels;
+    });
+    std::vector<unsigned char> aExpectedPaired(oComparison.nExpectedLabels, 0);
+    std::vector<unsigned char> aActualPaired(oComparison.nActualLabels, 0);
+    size_t nPairedPixels = 0;
+    for (const Pair & oPair : aDistinctPairs)
+    {
+        if (aExpectedPaired[oPair.nExpected] || aActualPaired[oPair.nActual])
+            continue;
+        aExpectedPaired[oPair.nExpected] = 1;
+        aActualPaired[oPair.nActual] = 1;
+        nPairedPixels += oPair.nPixels;
+    }
+    oComparison.nMismatchedPixels = aPairs.size() - nPairedPixels;
+    return oComparison;
+}
+
+} // namespace LabelMarkersHost
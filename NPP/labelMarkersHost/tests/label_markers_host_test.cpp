@@ -0,0 +1,412 @@
+// Checks the host labelling engine: 4-way and 8-way UF labels of hand-built masks, labels of random images against
+// a breadth-first reference for several thread counts, pixel types, pitches and batches, the compression to dense
+// IDs, and the permutation-invariant comparison of two labellings.
+
+#include "label_markers_host.h"
+#include "test_check.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+using LabelMarkersHost::Comparison;
+using LabelMarkersHost::Connectivity;
+using LabelMarkersHost::Connectivity4Way;
+using LabelMarkersHost::Connectivity8Way;
+using LabelMarkersHost::LabelImage;
+using LabelMarkersHost::Labeler;
+using LabelMarkersHost::SourceImage;
+
+// Image with nPad unused elements at the end of every row
+template <typename T>
+struct PaddedImage
+{
+    int nWidth;
+    int nHeight;
+    int nPad;
+    std::vector<T> aData;
+
+    PaddedImage(int nW, int nH, int nP = 0) : nWidth(nW), nHeight(nH), nPad(nP), aData((nW + nP) * nH, T(0xAB)) {}
+
+    T & at(int x, int y) { return aData[y * (nWidth + nPad) + x]; }
+    T at(int x, int y) const { return aData[y * (nWidth + nPad) + x]; }
+    size_t pitch() const { return (nWidth + nPad) * sizeof(T); }
+};
+
+template <typename T>
+SourceImage<T> sourceOf(const PaddedImage<T> & oImage)
+{
+    SourceImage<T> oSource = {oImage.aData.data(), oImage.pitch(), oImage.nWidth, oImage.nHeight};
+    return oSource;
+}
+
+LabelImage labelsOf(PaddedImage<uint32_t> & oImage)
+{
+    LabelImage oLabels = {oImage.aData.data(), oImage.pitch(), oImage.nWidth, oImage.nHeight};
+    return oLabels;
+}
+
+template <typename T>
+PaddedImage<T> fromRows(int nWidth, int nHeight, const std::vector<T> & aValues, int nPad = 0)
+{
+    PaddedImage<T> oImage(nWidth, nHeight, nPad);
+    for (int y = 0; y < nHeight; y++)
+        for (int x = 0; x < nWidth; x++)
+            oImage.at(x, y) = aValues[y * nWidth + x];
+    return oImage;
+}
+
+// Breadth-first labelling: every component gets the raster index of its first pixel
+template <typename T>
+std::vector<uint32_t> referenceLabels(const PaddedImage<T> & oImage, Connectivity eConnectivity)
+{
+    const int nWidth = oImage.nWidth;
+    const int nHeight = oImage.nHeight;
+    const uint32_t nUnset = UINT32_MAX;
+    std::vector<uint32_t> aLabels(nWidth * nHeight, nUnset);
+    std::deque<int> aQueue;
+    for (int nStart = 0; nStart < nWidth * nHeight; nStart++)
+    {
+        if (aLabels[nStart] != nUnset)
+            continue;
+        aLabels[nStart] = nStart;
+        aQueue.push_back(nStart);
+        while (!aQueue.empty())
+        {
+            int nIndex = aQueue.front();
+            aQueue.pop_front();
+            int x = nIndex % nWidth;
+            int y = nIndex / nWidth;
+            for (int nDY = -1; nDY <= 1; nDY++)
+                for (int nDX = -1; nDX <= 1; nDX++)
+                {
+                    if ((nDX == 0 && nDY == 0) || (eConnectivity == Connectivity4Way && nDX != 0 && nDY != 0))
+                        continue;
+                    int nX = x + nDX;
+                    int nY = y + nDY;
+                    if (nX < 0 || nY < 0 || nX >= nWidth || nY >= nHeight)
+                        continue;
+                    int nNext = nY * nWidth + nX;
+                    if (aLabels[nNext] == nUnset && oImage.at(nX, nY) == oImage.at(x, y))
+                    {
+                        aLabels[nNext] = nStart;
+                        aQueue.push_back(nNext);
+                    }
+                }
+        }
+    }
+    return aLabels;
+}
+
+// Dense renumbering in the raster order of the first pixel of every label
+std::vector<uint32_t> referenceCompressed(const std::vector<uint32_t> & aLabels, unsigned int & nCount)
+{
+    std::vector<uint32_t> aIds(aLabels.size(), UINT32_MAX);
+    std::vector<uint32_t> aResult(aLabels.size());
+    nCount = 0;
+    for (size_t i = 0; i < aLabels.size(); i++)
+    {
+        if (aIds[aLabels[i]] == UINT32_MAX)
+            aIds[aLabels[i]] = nCount++;
+        aResult[i] = aIds[aLabels[i]];
+    }
+    return aResult;
+}
+
+std::vector<uint32_t> unpadded(const PaddedImage<uint32_t> & oImage)
+{
+    std::vector<uint32_t> aResult;
+    for (int y = 0; y < oImage.nHeight; y++)
+        for (int x = 0; x < oImage.nWidth; x++)
+            aResult.push_back(oImage.at(x, y));
+    return aResult;
+}
+
+bool paddingIntact(const PaddedImage<uint32_t> & oImage)
+{
+    for (int y = 0; y < oImage.nHeight; y++)
+        for (int x = oImage.nWidth; x < oImage.nWidth + oImage.nPad; x++)
+            if (oImage.aData[y * (oImage.nWidth + oImage.nPad) + x] != 0xAB)
+                return false;
+    return true;
+}
+
+template <typename T>
+std::vector<uint32_t> label(Labeler & oLabeler, const PaddedImage<T> & oImage, Connectivity eConnectivity,
+                            int nPad = 0)
+{
+    PaddedImage<uint32_t> oLabels(oImage.nWidth, oImage.nHeight, nPad);
+    oLabeler.labelMarkers(sourceOf(oImage), labelsOf(oLabels), eConnectivity);
+    CHECK(paddingIntact(oLabels));
+    return unpadded(oLabels);
+}
+
+void testHandBuilt()
+{
+    Labeler oLabeler(2);
+    // Ones that touch only diagonally are separate 4-way components and one 8-way component; the zeros are one
+    // component either way
+    const std::vector<uint8_t> aMask = {1, 0, 0, 1, 1,
+                                        0, 1, 0, 0, 1,
+                                        0, 0, 0, 1, 0,
+                                        1, 1, 0, 0, 0};
+    PaddedImage<uint8_t> oMask = fromRows(5, 4, aMask, 3);
+    const std::vector<uint32_t> a4Way = {0,  1,  1, 3,  3,
+                                         1,  6,  1, 1,  3,
+                                         1,  1,  1, 13, 1,
+                                         15, 15, 1, 1,  1};
+    const std::vector<uint32_t> a8Way = {0,  1,  1, 3, 3,
+                                         1,  0,  1, 1, 3,
+                                         1,  1,  1, 3, 1,
+                                         15, 15, 1, 1, 1};
+    CHECK(label(oLabeler, oMask, Connectivity4Way, 2) == a4Way);
+    CHECK(label(oLabeler, oMask, Connectivity8Way, 2) == a8Way);
+
+    // Compression numbers the labels by their first pixel
+    PaddedImage<uint32_t> oLabels = fromRows<uint32_t>(5, 4, a4Way, 1);
+    CHECK(oLabeler.compressMarkerLabels(labelsOf(oLabels)) == 6);
+    CHECK(unpadded(oLabels) == std::vector<uint32_t>({0, 1, 1, 2, 2,
+                                                      1, 3, 1, 1, 2,
+                                                      1, 1, 1, 4, 1,
+                                                      5, 5, 1, 1, 1}));
+    oLabels = fromRows<uint32_t>(5, 4, a8Way, 1);
+    CHECK(oLabeler.compressMarkerLabels(labelsOf(oLabels)) == 4);
+    CHECK(unpadded(oLabels) == std::vector<uint32_t>({0, 1, 1, 2, 2,
+                                                      1, 0, 1, 1, 2,
+                                                      1, 1, 1, 2, 1,
+                                                      3, 3, 1, 1, 1}));
+
+    // Checkerboard: every pixel on its own with 4 neighbours, two components with 8
+    PaddedImage<uint8_t> oBoard(6, 5);
+    for (int y = 0; y < 5; y++)
+        for (int x = 0; x < 6; x++)
+            oBoard.at(x, y) = (x + y) % 2;
+    std::vector<uint32_t> aIdentity(30);
+    std::iota(aIdentity.begin(), aIdentity.end(), 0);
+    CHECK(label(oLabeler, oBoard, Connectivity4Way) == aIdentity);
+    std::vector<uint32_t> aTwo(30);
+    for (int i = 0; i < 30; i++)
+        aTwo[i] = (i % 6 + i / 6) % 2;
+    CHECK(label(oLabeler, oBoard, Connectivity8Way) == aTwo);
+
+    // A U shape whose arms only meet at the bottom: the right arm takes the label of the left one
+    const std::vector<uint16_t> aU = {7, 0, 7,
+                                      7, 0, 7,
+                                      7, 7, 7};
+    CHECK(label(oLabeler, fromRows<uint16_t>(3, 3, aU), Connectivity4Way) ==
+          std::vector<uint32_t>({0, 1, 0, 0, 1, 0, 0, 0, 0}));
+}
+
+template <typename T>
+PaddedImage<T> randomImage(int nWidth, int nHeight, int nPad, int nValues, std::mt19937 & oRng)
+{
+    std::uniform_int_distribution<int> oValue(0, nValues - 1);
+    PaddedImage<T> oImage(nWidth, nHeight, nPad);
+    for (int y = 0; y < nHeight; y++)
+        for (int x = 0; x < nWidth; x++)
+            oImage.at(x, y) = static_cast<T>(oValue(oRng) * 1000);
+    return oImage;
+}
+
+void testRandomImages()
+{
+    std::mt19937 oRng(24);
+    // Single rows and columns, and images tall enough for several strips, which meet at strip borders
+    const int aSizes[][2] = {{1, 1}, {17, 1}, {1, 23}, {9, 7}, {64, 40}, {130, 300}, {301, 257}};
+    for (unsigned int nThreads : {1u, 3u, 8u})
+    {
+        Labeler oLabeler(nThreads);
+        CHECK(oLabeler.threadCount() == nThreads);
+        for (const auto & aSize : aSizes)
+            for (int nValues : {2, 3})
+                for (Connectivity eConnectivity : {Connectivity4Way, Connectivity8Way})
+                {
+                    PaddedImage<uint8_t> oImage = randomImage<uint8_t>(aSize[0], aSize[1], 5, nValues, oRng);
+                    std::vector<uint32_t> aExpected = referenceLabels(oImage, eConnectivity);
+                    std::vector<uint32_t> aLabels = label(oLabeler, oImage, eConnectivity, 3);
+                    CHECK(aLabels == aExpected);
+
+                    PaddedImage<uint16_t> oWide = randomImage<uint16_t>(aSize[0], aSize[1], 2, nValues, oRng);
+                    CHECK(label(oLabeler, oWide, eConnectivity) == referenceLabels(oWide, eConnectivity));
+
+                    // Compression in place, against the reference renumbering
+                    unsigned int nExpectedCount = 0;
+                    std::vector<uint32_t> aCompressed = referenceCompressed(aExpected, nExpectedCount);
+                    PaddedImage<uint32_t> oLabels = fromRows(aSize[0], aSize[1], aLabels, 4);
+                    CHECK(oLabeler.compressMarkerLabels(labelsOf(oLabels)) == nExpectedCount);
+                    CHECK(unpadded(oLabels) == aCompressed);
+                    CHECK(paddingIntact(oLabels));
+                }
+    }
+}
+
+void testBatch()
+{
+    // Images of different sizes in one batch give the labels of one call per image
+    std::mt19937 oRng(7);
+    Labeler oLabeler(4);
+    std::vector<PaddedImage<uint8_t>> aImages;
+    std::vector<PaddedImage<uint32_t>> aOutputs;
+    const int aSizes[][2] = {{5, 5}, {200, 180}, {1, 40}, {33, 2}, {90, 300}};
+    for (const auto & aSize : aSizes)
+    {
+        aImages.push_back(randomImage<uint8_t>(aSize[0], aSize[1], 1, 2, oRng));
+        aOutputs.push_back(PaddedImage<uint32_t>(aSize[0], aSize[1], 2));
+    }
+    std::vector<SourceImage<uint8_t>> aSources;
+    std::vector<LabelImage> aLabels;
+    for (size_t i = 0; i < aImages.size(); i++)
+    {
+        aSources.push_back(sourceOf(aImages[i]));
+        aLabels.push_back(labelsOf(aOutputs[i]));
+    }
+    for (Connectivity eConnectivity : {Connectivity4Way, Connectivity8Way})
+    {
+        oLabeler.labelMarkersBatch(aSources.data(), aLabels.data(), aImages.size(), eConnectivity);
+        std::vector<std::vector<uint32_t>> aExpected;
+        for (size_t i = 0; i < aImages.size(); i++)
+        {
+            aExpected.push_back(referenceLabels(aImages[i], eConnectivity));
+            CHECK(unpadded(aOutputs[i]) == aExpected[i]);
+        }
+
+        std::vector<unsigned int> aCounts(aImages.size(), 0);
+        oLabeler.compressMarkerLabelsBatch(aLabels.data(), aLabels.size(), aCounts.data());
+        for (size_t i = 0; i < aImages.size(); i++)
+        {
+            unsigned int nCount = 0;
+            CHECK(unpadded(aOutputs[i]) == referenceCompressed(aExpected[i], nCount));
+            CHECK(aCounts[i] == nCount);
+        }
+    }
+}
+
+void testInvalid()
+{
+    Labeler oLabeler(2);
+    // Labels that are not UF labels are rejected and left untouched: a label after its pixel, and a label whose
+    // pixel is not a root
+    const std::vector<std::vector<uint32_t>> aInvalid = {{0, 3, 3, 3}, {0, 0, 0, 2}};
+    for (const std::vector<uint32_t> & aValues : aInvalid)
+    {
+        PaddedImage<uint32_t> oLabels = fromRows<uint32_t>(2, 2, aValues);
+        bool bThrown = false;
+        try
+        {
+            oLabeler.compressMarkerLabels(labelsOf(oLabels));
+        }
+        catch (const std::invalid_argument &)
+        {
+            bThrown = true;
+        }
+        CHECK(bThrown);
+        CHECK(unpadded(oLabels) == aValues);
+    }
+
+    // Size mismatches, empty images and short pitches
+    PaddedImage<uint8_t> oImage(4, 4);
+    PaddedImage<uint32_t> oLabels(4, 3);
+    SourceImage<uint8_t> oShortPitch = sourceOf(oImage);
+    oShortPitch.nPitch = 3;
+    PaddedImage<uint8_t> oEmpty(0, 4);
+    PaddedImage<uint32_t> oEmptyLabels(0, 4);
+    PaddedImage<uint32_t> oSquare(4, 4);
+    for (int nCase = 0; nCase < 3; nCase++)
+    {
+        bool bThrown = false;
+        try
+        {
+            if (nCase == 0)
+                oLabeler.labelMarkers(sourceOf(oImage), labelsOf(oLabels), Connectivity4Way);
+            else if (nCase == 1)
+                oLabeler.labelMarkers(oShortPitch, labelsOf(oSquare), Connectivity4Way);
+            else
+                oLabeler.labelMarkers(sourceOf(oEmpty), labelsOf(oEmptyLabels), Connectivity4Way);
+        }
+        catch (const std::invalid_argument &)
+        {
+            bThrown = true;
+        }
+        CHECK(bThrown);
+    }
+}
+
+Comparison compare(std::vector<uint32_t> aExpected, std::vector<uint32_t> aActual, int nWidth)
+{
+    int nHeight = static_cast<int>(aExpected.size()) / nWidth;
+    LabelImage oExpected = {aExpected.data(), nWidth * sizeof(uint32_t), nWidth, nHeight};
+    LabelImage oActual = {aActual.data(), nWidth * sizeof(uint32_t), nWidth, nHeight};
+    return LabelMarkersHost::compareLabels(oExpected, oActual);
+}
+
+void testCompare()
+{
+    std::mt19937 oRng(3);
+    Labeler oLabeler(2);
+    PaddedImage<uint8_t> oImage = randomImage<uint8_t>(40, 30, 0, 3, oRng);
+    unsigned int nCount = 0;
+    std::vector<uint32_t> aLabels = referenceCompressed(label(oLabeler, oImage, Connectivity8Way), nCount);
+
+    // Any renumbering of the labels is equivalent
+    std::vector<uint32_t> aPermutation(nCount);
+    std::iota(aPermutation.begin(), aPermutation.end(), 1000);
+    std::shuffle(aPermutation.begin(), aPermutation.end(), oRng);
+    std::vector<uint32_t> aRenumbered(aLabels.size());
+    for (size_t i = 0; i < aLabels.size(); i++)
+        aRenumbered[i] = aPermutation[aLabels[i]];
+    Comparison oComparison = compare(aLabels, aRenumbered, 40);
+    CHECK(oComparison.isEquivalent());
+    CHECK(oComparison.nExpectedLabels == nCount && oComparison.nActualLabels == nCount);
+    CHECK(oComparison.nMismatchedPixels == 0);
+
+    // Hand-built split and merge: expected labels 0 (4 pixels), 1 (3 pixels) and 2 (1 pixel)
+    const std::vector<uint32_t> aExpected = {0, 0, 1, 1,
+                                             0, 0, 1, 2};
+    // One pixel of label 0 split off
+    oComparison = compare(aExpected, {5, 5, 6, 6, 5, 9, 6, 7}, 4);
+    CHECK(!oComparison.isEquivalent());
+    CHECK(oComparison.nSplits == 1 && oComparison.nMerges == 0);
+    CHECK(oComparison.nActualLabels == 4 && oComparison.nMismatchedPixels == 1);
+    // Labels 1 and 2 merged: the smaller one mismatches
+    oComparison = compare(aExpected, {5, 5, 6, 6, 5, 5, 6, 6}, 4);
+    CHECK(oComparison.nSplits == 0 && oComparison.nMerges == 1);
+    CHECK(oComparison.nActualLabels == 2 && oComparison.nMismatchedPixels == 1);
+    // Both at once: (0, 5) x 3, (0, 6), (1, 5), (1, 6) x 2 and (2, 6) are five pairs for three expected and two
+    // actual labels
+    oComparison = compare(aExpected, {5, 5, 6, 6, 6, 5, 5, 6}, 4);
+    CHECK(oComparison.nSplits == 2 && oComparison.nMerges == 3);
+    CHECK(oComparison.nMismatchedPixels == 3);
+
+    bool bThrown = false;
+    try
+    {
+        std::vector<uint32_t> aOther(aExpected);
+        LabelImage oExpected = {aOther.data(), 4 * sizeof(uint32_t), 4, 2};
+        LabelImage oActual = {aOther.data(), 2 * sizeof(uint32_t), 2, 4};
+        LabelMarkersHost::compareLabels(oExpected, oActual);
+    }
+    catch (const std::invalid_argument &)
+    {
+        bThrown = true;
+    }
+    CHECK(bThrown);
+}
+
+} // namespace
+
+int main()
+{
+    testHandBuilt();
+    testRandomImages();
+    testBatch();
+    testInvalid();
+    testCompare();
+    return test_result("label_markers_host_test");
+}
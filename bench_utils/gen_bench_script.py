@@ -44,6 +44,8 @@ if __name__ == "__main__":
             fd.write(get_header(workload))
             for m, n, k in workload_info["mnk"]:
                 for extra_flag in workload_info["extra_flags"]:
+                    # The text log is kept for debugging, while results are
+                    # collected from the JSON Lines record file
                     fd.write(
-                        f"{workload_info['path']} --m={m} --n={n} --k={k} {extra_flag} > $OUTPUT_DIR/{workload}_{m}_{n}_{k}_{extra_flag}.txt\n"
+                        f"{workload_info['path']} --m={m} --n={n} --k={k} {extra_flag} --output=jsonl --record_path=$OUTPUT_DIR/{workload}.jsonl > $OUTPUT_DIR/{workload}_{m}_{n}_{k}_{extra_flag}.txt\n"
                     )
@@ -2,6 +2,7 @@ from .nsight_utils.upload_benchmark_results import (
     open_worksheet,
     update_gspread,
 )
+import json
 import os
 
 
@@ -107,6 +108,64 @@ def extract_results_from_folder(path, file_extraction_func):
     return all_names_and_info
 
 
+def extract_results_from_jsonl(path, keys):
+    """Read records emitted by the bench_* drivers with --output=jsonl.
+
+    Every line of every *.jsonl file under path is one run. keys selects and
+    orders the columns; missing fields (e.g., timing disabled) become None."""
+    all_results = []
+    for filename in sorted(os.listdir(path)):
+        if not filename.endswith(".jsonl"):
+            continue
+        with open(os.path.join(path, filename)) as fd:
+            for line in fd:
+                line = line.strip()
+                if not line.startswith("{"):
+                    continue
+                record = json.loads(line)
+                all_results.append([record.get(key) for key in keys])
+    return all_results
+
+
+# (sheet column, record key) pairs uploaded from the JSON Lines records
+CUSPARSELT_COLUMNS = [
+    ("m", "m"),
+    ("n", "n"),
+    ("k", "k"),
+    ("tune_flag", "tune"),
+    ("create handle(ms)", "phase_ms.handle_creation"),
+    ("prune(ms)", "phase_ms.pruning"),
+    ("verify(ms)", "phase_ms.verification"),
+    ("compress(ms)", "phase_ms.compression"),
+    ("tune(ms)", "phase_ms.tuning"),
+    ("workspace alloc(ms)", "phase_ms.workspace_allocation"),
+    ("execute median(ms)", "time_ms.median"),
+    ("destroy handle(ms)", "phase_ms.destruction"),
+    ("status", "status"),
+]
+
+GEMM_COLUMNS = [
+    ("m", "m"),
+    ("n", "n"),
+    ("k", "k"),
+    ("transa", "transa"),
+    ("transb", "transb"),
+    ("median time(ms)", "time_ms.median"),
+    ("gflops", "gflops"),
+]
+
+
+def extract_results(path, columns, text_header, file_extraction_func):
+    """Header and rows of the runs in path. The JSON Lines records are used
+    when the drivers wrote them (see gen_bench_script.py); the text logs of
+    older runs are scraped otherwise."""
+    if any(filename.endswith(".jsonl") for filename in os.listdir(path)):
+        return [[column for column, _ in columns]] + extract_results_from_jsonl(
+            path, [key for _, key in columns]
+        )
+    return [text_header] + extract_results_from_folder(path, file_extraction_func)
+
+
 # TODO: remove the following code as they are now provided by nsight_utils
 
 # def open_worksheet(target_sheet_url: str, target_gid: str):
@@ -164,7 +223,11 @@ if __name__ == "__main__":
     # Upload cuspoarseLt results to google sheet
     ws = open_worksheet(url, "300213523")
     update_gspread(
-        [
+        extract_results(
+            find_latest_subdirectory(
+                "./artifacts", "benchmark_cusparseLt_spmm"
+            ),
+            CUSPARSELT_COLUMNS,
             [
                 "m",
                 "n",
@@ -180,12 +243,7 @@ if __name__ == "__main__":
                 "destroy handle(ms)",
                 "total time(ms)",
                 "status",
-            ]
-        ]
-        + extract_results_from_folder(
-            find_latest_subdirectory(
-                "./artifacts", "benchmark_cusparseLt_spmm"
-            ),
+            ],
             extract_cusparselt_result,
         ),
         ws,
@@ -194,9 +252,10 @@ if __name__ == "__main__":
     # Upload cublas results to google sheet
     ws2 = open_worksheet(url, "1193553658")
     update_gspread(
-        [["m", "n", "k", "NO_OTHER_FLAG", "total time(ms)"]]
-        + extract_results_from_folder(
+        extract_results(
             find_latest_subdirectory("./artifacts", "benchmark_gemm"),
+            GEMM_COLUMNS,
+            ["m", "n", "k", "NO_OTHER_FLAG", "total time(ms)"],
             extract_gemm_result,
         ),
         ws2,
@@ -1,5 +1,9 @@
 #include "cublas_bench_gemm_example.cu.h"
+#include "cublas_bench_gemm_sweep.cu.h"
 
 int main(const int argc, const char **argv) {
+  if (BenchSweep::is_sweep(argc, argv)) {
+    return BenchGEMMSweep::main_bench_gemm_sweep(argc, argv);
+  }
   return main_bench_gemm(argc, argv);
 }
\ No newline at end of file
@@ -49,6 +49,9 @@
 #pragma once
 #include <cublas_v2.h>
 #include <cuda_runtime.h>
+#include <utils/bench_record.h>
+#include <utils/bench_sweep.h>
+#include <utils/bench_timing.h>
 #include <utils/generate_random_data.h>
 #include <utils/helper_string.h>
 
@@ -76,6 +79,8 @@ struct BenchGEMMProblemSpec {
   bool enable_debug_timing;
   char *cli_result_path_and_prefix;
   bool flag_specify_result_path_and_prefix;
+  BenchTiming::Config timing_config;
+  BenchRecord::OutputOptions output_options;
 };
 
 struct BenchGEMMRuntimeData {
@@ -101,6 +106,9 @@ void print_gemm_usage() {
       "Usage: bench_gemm --m=## --n=## --k=## [--enable_dump] "
       "[--result_path_and_prefix=...] [--enable_timing] "
       "[--enable_debug_timing]\n");
+  BenchTiming::print_timing_usage();
+  BenchRecord::print_output_usage();
+  BenchSweep::print_sweep_usage();
   // TODO: print the meaning of each argument
 }
 
@@ -122,6 +130,9 @@ generate_data_and_prepare_bench_gemm(
   char *cli_result_path_and_prefix;
   bool flag_specify_result_path_and_prefix = getCmdLineArgumentString(
       argc, argv, "result_path_and_prefix", &cli_result_path_and_prefix);
+  BenchTiming::Config timing_config = BenchTiming::parse_config(argc, argv);
+  BenchRecord::OutputOptions output_options =
+      BenchRecord::parse_output_options(argc, argv);
   if (m == 0 || n == 0 || k == 0) {
     print_gemm_usage();
     exit(EXIT_FAILURE);
@@ -208,7 +219,9 @@ generate_data_and_prepare_bench_gemm(
       .enable_debug_timing = enable_debug_timing,
       .cli_result_path_and_prefix = cli_result_path_and_prefix,
       .flag_specify_result_path_and_prefix =
-          flag_specify_result_path_and_prefix};
+          flag_specify_result_path_and_prefix,
+      .timing_config = timing_config,
+      .output_options = output_options};
   BenchGEMMRuntimeData runtime_data = {.lda = lda,
                                        .ldb = ldb,
                                        .ldc = ldc,
@@ -230,7 +243,7 @@ generate_data_and_prepare_bench_gemm(
   return bench_gemm_tuple;
 }
 
-std::tuple<cudaEvent_t, cudaEvent_t> compute_bench_gemm(
+BenchTiming::Summary compute_bench_gemm(
     BenchGEMMProblemSpec &bench_spec, BenchGEMMRuntimeData &bench_data,
     std::map<std::string, std::tuple<cudaEvent_t, cudaEvent_t>>
         &utility_timestamps) {
@@ -243,43 +256,65 @@ std::tuple<cudaEvent_t, cudaEvent_t> compute_bench_gemm(
   CUDA_CHECK(cudaEventCreate(&start));
   CUDA_CHECK(cudaEventCreate(&stop));
 
+  auto run_sgemm = [&]() {
+    CUBLAS_CHECK(cublasSgemm(
+        bench_data.cublasH, bench_data.transa, bench_data.transb, bench_spec.m,
+        bench_spec.n, bench_spec.k, &(bench_data.alpha), bench_data.d_A,
+        bench_data.lda, bench_data.d_B, bench_data.ldb, &(bench_data.beta),
+        bench_data.d_C, bench_data.ldc));
+  };
+
   if (bench_spec.enable_debug_timing) {
     CUDA_CHECK(cudaStreamSynchronize(bench_data.stream));
     CUDA_CHECK(cudaDeviceSynchronize());
     beg = std::chrono::system_clock::now();
   }
-  if (bench_spec.enable_timing)
-    CUDA_CHECK(cudaEventRecord(start, bench_data.stream));
-
-  CUBLAS_CHECK(cublasSgemm(bench_data.cublasH, bench_data.transa,
-                           bench_data.transb, bench_spec.m, bench_spec.n,
-                           bench_spec.k, &(bench_data.alpha), bench_data.d_A,
-                           bench_data.lda, bench_data.d_B, bench_data.ldb,
-                           &(bench_data.beta), bench_data.d_C, bench_data.ldc));
-  if (bench_spec.enable_timing)
-    CUDA_CHECK(cudaEventRecord(stop, bench_data.stream));
+
+  // Every sample is bracketed by its own event pair and synchronized so that
+  // the samples are independent of each other
+  BenchTiming::Summary summary{};
+  if (bench_spec.enable_timing) {
+    summary = BenchTiming::measure(bench_spec.timing_config, [&]() {
+      CUDA_CHECK(cudaEventRecord(start, bench_data.stream));
+      run_sgemm();
+      CUDA_CHECK(cudaEventRecord(stop, bench_data.stream));
+      CUDA_CHECK(cudaEventSynchronize(stop));
+      float elapsed_time = 0.0f;
+      CUDA_CHECK(cudaEventElapsedTime(&elapsed_time, start, stop));
+      return static_cast<double>(elapsed_time);
+    });
+  } else {
+    run_sgemm();
+  }
+
   if (bench_spec.enable_debug_timing) {
     CUDA_CHECK(cudaStreamSynchronize(bench_data.stream));
     CUDA_CHECK(cudaDeviceSynchronize());
     end = std::chrono::system_clock::now();
-    printf("[DEBUG] cublasSgemm chrono time (microseconds): %ld\n",
-           std::chrono::duration_cast<std::chrono::microseconds>(end - beg)
-               .count());
+    int num_iters = bench_spec.enable_timing
+                        ? summary.num_warmup + summary.num_samples
+                        : 1;
+    printf(
+        "[DEBUG] cublasSgemm chrono time per iteration (microseconds): %ld\n",
+        std::chrono::duration_cast<std::chrono::microseconds>(end - beg)
+                .count() /
+            num_iters);
   }
-  return std::make_tuple(start, stop);
+  CUDA_CHECK(cudaEventDestroy(start));
+  CUDA_CHECK(cudaEventDestroy(stop));
+  return summary;
 }
 
-void consume_and_print_timing_bench_gemm(
-    cudaEvent_t start, cudaEvent_t stop, BenchGEMMProblemSpec &bench_spec,
+// Returns the elapsed time of each utility so that it can be added to the
+// result record after the events are destroyed
+std::map<std::string, float> consume_and_print_timing_bench_gemm(
+    const BenchTiming::Summary &summary, BenchGEMMProblemSpec &bench_spec,
     std::map<std::string, std::tuple<cudaEvent_t, cudaEvent_t>>
         &utility_timestamps) {
-  CUDA_CHECK(cudaEventSynchronize(stop));
-  float elapsed_time = 0.0f;
-  CUDA_CHECK(cudaEventElapsedTime(&elapsed_time, start, stop));
-  printf("cublasSgemm elapsed time (ms): %f\n", elapsed_time);
-  printf("cublasSgemm throughput (GFLOPS): %f\n",
-         (2.0 * bench_spec.m * bench_spec.n * bench_spec.k) /
-             (elapsed_time / 1000.0) / 1e9);
+  std::map<std::string, float> utility_elapsed_ms;
+  BenchTiming::print_summary(
+      "cublasSgemm", summary,
+      2.0 * bench_spec.m * bench_spec.n * bench_spec.k);
   // Print elapsed time of utilities. Keyword "elapsed time(util) (ms):"
   for (const auto &keyval : utility_timestamps) {
     const auto &key = keyval.first;
@@ -289,11 +324,39 @@ void consume_and_print_timing_bench_gemm(
                                     std::get<1>(value)));
     printf("cublasSgemm %s elapsed time(util) (ms): %f\n", key.c_str(),
            elapsed_time_util);
+    utility_elapsed_ms[key] = elapsed_time_util;
     CUDA_CHECK(cudaEventDestroy(std::get<0>(value)));
     CUDA_CHECK(cudaEventDestroy(std::get<1>(value)));
   }
-  CUDA_CHECK(cudaEventDestroy(start));
-  CUDA_CHECK(cudaEventDestroy(stop));
+  return utility_elapsed_ms;
+}
+
+void emit_record_bench_gemm(
+    const BenchTiming::Summary &summary, BenchGEMMProblemSpec &bench_spec,
+    BenchGEMMRuntimeData &bench_data,
+    const std::map<std::string, float> &utility_elapsed_ms) {
+  if (bench_spec.output_options.format == BenchRecord::OutputFormat::kText) {
+    return;
+  }
+  BenchRecord::Record record;
+  record.add("bench", "bench_gemm");
+  record.add("routine", "cublasSgemm");
+  record.add("m", bench_spec.m);
+  record.add("n", bench_spec.n);
+  record.add("k", bench_spec.k);
+  record.add("transa", bench_data.transa == CUBLAS_OP_N ? "N" : "T");
+  record.add("transb", bench_data.transb == CUBLAS_OP_N ? "N" : "T");
+  record.add("dtype", "float32");
+  record.add("nstreams", 1);
+  if (bench_spec.enable_timing) {
+    record.add_timing_summary(summary);
+    record.add("gflops", (2.0 * bench_spec.m * bench_spec.n * bench_spec.k) /
+                             (summary.median / 1000.0) / 1e9);
+    record.add_phase_times(utility_elapsed_ms);
+  }
+  record.add_host_info();
+  record.add_device_info();
+  BenchRecord::emit(bench_spec.output_options, record);
 }
 
 void cleanup_bench_gemm(BenchGEMMProblemSpec &bench_spec,
@@ -354,14 +417,13 @@ int main_bench_gemm(const int argc, const char **argv) {
       generate_data_and_prepare_bench_gemm(argc, argv, utility_timestamps);
   auto bench_spec = std::get<0>(bench_tuple);
   auto bench_data = std::get<1>(bench_tuple);
-  auto start_end_events =
-      compute_bench_gemm(bench_spec, bench_data, utility_timestamps);
-  auto start = std::get<0>(start_end_events);
-  auto stop = std::get<1>(start_end_events);
+  auto summary = compute_bench_gemm(bench_spec, bench_data, utility_timestamps);
+  std::map<std::string, float> utility_elapsed_ms;
   if (bench_spec.enable_timing) {
-    consume_and_print_timing_bench_gemm(start, stop, bench_spec,
-                                        utility_timestamps);
+    utility_elapsed_ms = consume_and_print_timing_bench_gemm(
+        summary, bench_spec, utility_timestamps);
   }
+  emit_record_bench_gemm(summary, bench_spec, bench_data, utility_elapsed_ms);
   cleanup_bench_gemm(bench_spec, bench_data);
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,225 @@
+#pragma once
+// Single-process sweep mode of bench_gemm. All points share one cuBLAS handle,
+// one stream and one device arena sized to the high-water mark of the sweep,
+// so that the per-point cost is the GEMM itself instead of process launch,
+// context creation, cublasCreate and cudaDeviceReset.
+#include <cuda_bf16.h>
+#include <cuda_fp16.h>
+#include <utils/bench_sweep.h>
+
+#include "cublas_bench_gemm_example.cu.h"
+
+namespace BenchGEMMSweep {
+struct DtypeInfo {
+  cudaDataType_t data_type;
+  cublasComputeType_t compute_type;
+  size_t elem_size;
+};
+
+DtypeInfo get_dtype_info(const std::string &dtype) {
+  if (dtype == "fp32") return {CUDA_R_32F, CUBLAS_COMPUTE_32F, sizeof(float)};
+  if (dtype == "tf32")
+    return {CUDA_R_32F, CUBLAS_COMPUTE_32F_FAST_TF32, sizeof(float)};
+  if (dtype == "fp16") return {CUDA_R_16F, CUBLAS_COMPUTE_32F, sizeof(__half)};
+  if (dtype == "bf16")
+    return {CUDA_R_16BF, CUBLAS_COMPUTE_32F, sizeof(__nv_bfloat16)};
+  if (dtype == "fp64") return {CUDA_R_64F, CUBLAS_COMPUTE_64F, sizeof(double)};
+  throw std::invalid_argument("unsupported dtype \"" + dtype + "\"");
+}
+
+size_t align_bytes(size_t bytes) { return (bytes + 255) / 256 * 256; }
+
+// Bytes of A, B and C for one point, each aligned to 256 bytes
+size_t get_point_bytes(const BenchSweep::GemmPoint &point) {
+  size_t elem_size = get_dtype_info(point.dtype).elem_size;
+  return align_bytes(elem_size * point.m * point.k) +
+         align_bytes(elem_size * point.k * point.n) +
+         align_bytes(elem_size * point.m * point.n);
+}
+
+// Device buffer that only grows. Reserving the high-water mark of the sweep
+// up front means the sweep performs a single cudaMalloc.
+class DeviceArena {
+ public:
+  ~DeviceArena() {
+    if (d_buffer_ != nullptr) cudaFree(d_buffer_);
+  }
+
+  // Returns true if the buffer was reallocated, which invalidates its content
+  bool reserve(size_t bytes) {
+    if (bytes <= capacity_) return false;
+    if (d_buffer_ != nullptr) CUDA_CHECK(cudaFree(d_buffer_));
+    CUDA_CHECK(cudaMalloc(&d_buffer_, bytes));
+    capacity_ = bytes;
+    return true;
+  }
+
+  char *data() const { return reinterpret_cast<char *>(d_buffer_); }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  void *d_buffer_ = nullptr;
+  size_t capacity_ = 0;
+};
+
+// Fills the whole arena with random values of the given dtype. Operands are
+// carved from the front of the arena so this only needs to run when the dtype
+// changes or the arena grows.
+void fill_arena(DeviceArena &arena, const std::string &dtype,
+                cudaStream_t stream) {
+  DtypeInfo info = get_dtype_info(dtype);
+  size_t num_elems = arena.capacity() / info.elem_size;
+  std::vector<char> host(num_elems * info.elem_size);
+  for (size_t idx = 0; idx < num_elems; idx++) {
+    float value = (std::rand() + 0.0f) / RAND_MAX;
+    if (info.data_type == CUDA_R_32F) {
+      reinterpret_cast<float *>(host.data())[idx] = value;
+    } else if (info.data_type == CUDA_R_16F) {
+      reinterpret_cast<__half *>(host.data())[idx] = __float2half(value);
+    } else if (info.data_type == CUDA_R_16BF) {
+      reinterpret_cast<__nv_bfloat16 *>(host.data())[idx] =
+          __float2bfloat16(value);
+    } else {
+      reinterpret_cast<double *>(host.data())[idx] = value;
+    }
+  }
+  CUDA_CHECK(cudaMemcpyAsync(arena.data(), host.data(), host.size(),
+                             cudaMemcpyHostToDevice, stream));
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+}
+
+BenchTiming::Summary run_point(const BenchSweep::GemmPoint &point,
+                               DeviceArena &arena, cublasHandle_t cublasH,
+                               cudaStream_t stream, cudaEvent_t start,
+                               cudaEvent_t stop,
+                               const BenchTiming::Config &timing_config) {
+  DtypeInfo info = get_dtype_info(point.dtype);
+  cublasOperation_t transa = point.transa == 'T' ? CUBLAS_OP_T : CUBLAS_OP_N;
+  cublasOperation_t transb = point.transb == 'T' ? CUBLAS_OP_T : CUBLAS_OP_N;
+  int lda = transa == CUBLAS_OP_N ? point.m : point.k;
+  int ldb = transb == CUBLAS_OP_N ? point.k : point.n;
+  int ldc = point.m;
+  char *d_A = arena.data();
+  char *d_B = d_A + align_bytes(info.elem_size * point.m * point.k);
+  char *d_C = d_B + align_bytes(info.elem_size * point.k * point.n);
+  // alpha and beta follow the compute type
+  const float alpha_f = 1.0f, beta_f = 0.0f;
+  const double alpha_d = 1.0, beta_d = 0.0;
+  const void *alpha = info.compute_type == CUBLAS_COMPUTE_64F
+                          ? static_cast<const void *>(&alpha_d)
+                          : static_cast<const void *>(&alpha_f);
+  const void *beta = info.compute_type == CUBLAS_COMPUTE_64F
+                         ? static_cast<const void *>(&beta_d)
+                         : static_cast<const void *>(&beta_f);
+
+  return BenchTiming::measure(timing_config, [&]() {
+    CUDA_CHECK(cudaEventRecord(start, stream));
+    CUBLAS_CHECK(cublasGemmEx(cublasH, transa, transb, point.m, point.n,
+                              point.k, alpha, d_A, info.data_type, lda, d_B,
+                              info.data_type, ldb, beta, d_C, info.data_type,
+                              ldc, info.compute_type, CUBLAS_GEMM_DEFAULT));
+    CUDA_CHECK(cudaEventRecord(stop, stream));
+    CUDA_CHECK(cudaEventSynchronize(stop));
+    float elapsed_time = 0.0f;
+    CUDA_CHECK(cudaEventElapsedTime(&elapsed_time, start, stop));
+    return static_cast<double>(elapsed_time);
+  });
+}
+
+int main_bench_gemm_sweep(const int argc, const char **argv) {
+  std::vector<BenchSweep::GemmPoint> points;
+  try {
+    points = BenchSweep::parse_gemm_sweep(argc, argv);
+    for (const auto &point : points) get_dtype_info(point.dtype);
+  } catch (const std::exception &e) {
+    printf("Invalid sweep specification: %s\n", e.what());
+    BenchSweep::print_sweep_usage();
+    exit(EXIT_FAILURE);
+  }
+  if (points.empty()) {
+    BenchSweep::print_sweep_usage();
+    exit(EXIT_FAILURE);
+  }
+  BenchTiming::Config timing_config = BenchTiming::parse_config(argc, argv);
+  BenchRecord::OutputOptions output_options =
+      BenchRecord::parse_output_options(argc, argv);
+  // The sweep always emits records; JSON Lines unless asked otherwise
+  if (output_options.format == BenchRecord::OutputFormat::kText) {
+    output_options.format = BenchRecord::OutputFormat::kJsonl;
+  }
+  printf("bench_gemm sweep: %zu points\n", points.size());
+
+  std::chrono::time_point<std::chrono::system_clock> beg, end;
+  beg = std::chrono::system_clock::now();
+  cublasHandle_t cublasH = NULL;
+  cudaStream_t stream = NULL;
+  cudaEvent_t start, stop;
+  CUDA_CHECK(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
+  CUDA_CHECK(cudaEventCreate(&start));
+  CUDA_CHECK(cudaEventCreate(&stop));
+  CUBLAS_CHECK(cublasCreate(&cublasH));
+  CUBLAS_CHECK(cublasSetStream(cublasH, stream));
+  end = std::chrono::system_clock::now();
+  float setup_ms =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - beg).count() /
+      1000.0f;
+
+  size_t high_water_mark = 0;
+  for (const auto &point : points) {
+    high_water_mark = std::max(high_water_mark, get_point_bytes(point));
+  }
+  std::srand(unsigned(std::time(nullptr)));
+  {
+    DeviceArena arena;
+    std::string filled_dtype;
+    for (size_t idx = 0; idx < points.size(); idx++) {
+      const auto &point = points[idx];
+      std::map<std::string, float> phase_ms;
+      if (idx == 0) phase_ms["setup_chrono"] = setup_ms;
+      beg = std::chrono::system_clock::now();
+      bool reallocated = arena.reserve(high_water_mark);
+      if (reallocated || point.dtype != filled_dtype) {
+        fill_arena(arena, point.dtype, stream);
+        filled_dtype = point.dtype;
+        end = std::chrono::system_clock::now();
+        phase_ms["data_copy_chrono"] =
+            std::chrono::duration_cast<std::chrono::microseconds>(end - beg)
+                .count() /
+            1000.0f;
+      }
+
+      BenchTiming::Summary summary = run_point(point, arena, cublasH, stream,
+                                               start, stop, timing_config);
+      double flop = 2.0 * point.m * point.n * point.k;
+      printf("m(%ld) n(%ld) k(%ld) trans(%c%c) dtype(%s)\n", point.m, point.n,
+             point.k, point.transa, point.transb, point.dtype.c_str());
+      BenchTiming::print_summary("cublasGemmEx", summary, flop);
+
+      BenchRecord::Record record;
+      record.add("bench", "bench_gemm");
+      record.add("routine", "cublasGemmEx");
+      record.add("sweep_index", static_cast<long>(idx));
+      record.add("m", point.m);
+      record.add("n", point.n);
+      record.add("k", point.k);
+      record.add("transa", std::string(1, point.transa));
+      record.add("transb", std::string(1, point.transb));
+      record.add("dtype", point.dtype);
+      record.add("nstreams", 1);
+      record.add_timing_summary(summary);
+      record.add("gflops", flop / (summary.median / 1000.0) / 1e9);
+      record.add("arena_bytes", arena.capacity());
+      record.add_phase_times(phase_ms);
+      record.add_host_info();
+      record.add_device_info();
+      BenchRecord::emit(output_options, record);
+    }
+  }
+
+  CUDA_CHECK(cudaEventDestroy(start));
+  CUDA_CHECK(cudaEventDestroy(stop));
+  CUBLAS_CHECK(cublasDestroy(cublasH));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+  return 0;
+}
+}  // namespace BenchGEMMSweep
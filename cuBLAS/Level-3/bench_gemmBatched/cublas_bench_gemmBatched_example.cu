@@ -49,6 +49,8 @@
 
 #include <cublas_v2.h>
 #include <cuda_runtime.h>
+#include <utils/bench_record.h>
+#include <utils/bench_timing.h>
 #include <utils/generate_random_data.h>
 #include <utils/helper_string.h>
 
@@ -80,8 +82,13 @@ int main(const int argc, const char *argv[]) {
   int n = getCmdLineArgumentInt(argc, argv, "n");
   int k = getCmdLineArgumentInt(argc, argv, "k");
   int batch_count = getCmdLineArgumentInt(argc, argv, "batch_count");
-  if (argc != 5) {
+  BenchTiming::Config timing_config = BenchTiming::parse_config(argc, argv);
+  BenchRecord::OutputOptions output_options =
+      BenchRecord::parse_output_options(argc, argv);
+  if (m == 0 || n == 0 || k == 0 || batch_count == 0) {
     printf("Usage: %s --m=## --n=## --k=## --batch_count=##\n", argv[0]);
+    BenchTiming::print_timing_usage();
+    BenchRecord::print_output_usage();
     return EXIT_FAILURE;
   }
   int lda = m;
@@ -198,23 +205,47 @@ int main(const int argc, const char *argv[]) {
   CUDA_CHECK(cudaDeviceSynchronize());
 
   beg = std::chrono::system_clock::now();
-  CUDA_CHECK(cudaEventRecord(start, stream));
-  CUBLAS_CHECK(cublasSgemmBatched(cublasH, transa, transb, m, n, k, &alpha,
-                                  d_A_array, lda, d_B_array, ldb, &beta,
-                                  d_C_array, ldc, batch_count));
-  CUDA_CHECK(cudaEventRecord(stop, stream));
-  CUDA_CHECK(cudaStreamSynchronize(stream));
+  BenchTiming::Summary summary =
+      BenchTiming::measure(timing_config, [&]() {
+        CUDA_CHECK(cudaEventRecord(start, stream));
+        CUBLAS_CHECK(cublasSgemmBatched(cublasH, transa, transb, m, n, k,
+                                        &alpha, d_A_array, lda, d_B_array, ldb,
+                                        &beta, d_C_array, ldc, batch_count));
+        CUDA_CHECK(cudaEventRecord(stop, stream));
+        CUDA_CHECK(cudaEventSynchronize(stop));
+        float elapsed_time = 0.0f;
+        CUDA_CHECK(cudaEventElapsedTime(&elapsed_time, start, stop));
+        return static_cast<double>(elapsed_time);
+      });
   CUDA_CHECK(cudaDeviceSynchronize());
   end = std::chrono::system_clock::now();
-  float elapsed_time = 0.0f;
-  CUDA_CHECK(cudaEventElapsedTime(&elapsed_time, start, stop));
+  CUDA_CHECK(cudaEventDestroy(start));
+  CUDA_CHECK(cudaEventDestroy(stop));
 
-  printf("cublasSgemmBatched elapsed time (ms): %f\n", elapsed_time);
-  printf("cublasSgemmBatched throughput (GFLOPS): %f\n",
-         (2.0 * m * n * k * batch_count) / (elapsed_time / 1000.0) / 1e9);
+  double flop = 2.0 * m * n * k * batch_count;
+  BenchTiming::print_summary("cublasSgemmBatched", summary, flop);
   printf(
-      "[DEBUG] cublas<X>gemmBatched chrono time (microseconds): %ld\n",
-      std::chrono::duration_cast<std::chrono::microseconds>(end - beg).count());
+      "[DEBUG] cublas<X>gemmBatched chrono time per iteration (microseconds): "
+      "%ld\n",
+      std::chrono::duration_cast<std::chrono::microseconds>(end - beg).count() /
+          (summary.num_warmup + summary.num_samples));
+
+  BenchRecord::Record record;
+  record.add("bench", "bench_gemmBatched");
+  record.add("routine", "cublasSgemmBatched");
+  record.add("m", m);
+  record.add("n", n);
+  record.add("k", k);
+  record.add("batch_count", batch_count);
+  record.add("transa", transa == CUBLAS_OP_N ? "N" : "T");
+  record.add("transb", transb == CUBLAS_OP_N ? "N" : "T");
+  record.add("dtype", "float32");
+  record.add("nstreams", 1);
+  record.add_timing_summary(summary);
+  record.add("gflops", flop / (summary.median / 1000.0) / 1e9);
+  record.add_host_info();
+  record.add_device_info();
+  BenchRecord::emit(output_options, record);
 
   /* step 4: copy data to host */
   for (int i = 0; i < batch_count; i++) {
@@ -49,8 +49,10 @@
 #pragma once
 #include <cublas_v2.h>
 #include <cuda_runtime.h>
+#include <utils/bench_record.h>
 #include <utils/generate_random_data.h>
 #include <utils/helper_string.h>
+#include <utils/tile_scheduler.h>
 
 #include <algorithm>
 #include <chrono>
@@ -75,6 +77,10 @@ struct TimingResults {
   std::vector<cudaEvent_t> stop_events;
   std::map<std::string, std::tuple<cudaEvent_t, cudaEvent_t>>
       utility_timestamps;
+  // Filled by consume_and_print_timing() and used by the result record, as
+  // the events are destroyed after being printed
+  std::map<std::string, float> elapsed_ms;
+  std::map<std::string, float> utility_elapsed_ms;
 };
 
 struct ProblemSpec {
@@ -92,6 +98,9 @@ struct ProblemSpec {
   char *cli_result_path_and_prefix;
   bool flag_specify_result_path_and_prefix;
   int nstreams;
+  TileScheduler::Policy schedule_policy;
+  bool print_schedule;
+  BenchRecord::OutputOptions output_options;
 };
 
 struct RuntimeData {
@@ -112,6 +121,12 @@ struct RuntimeData {
   // One handle per stream to conserve reproducibility
   // https://docs.nvidia.com/cuda/cublas/index.html#results-reproducibility
   std::vector<cublasHandle_t> cublasHs;
+  // One task per (i, j, l) tile product in loop order, and the stream each
+  // of them is issued on
+  std::vector<TileScheduler::Task> tasks;
+  TileScheduler::Assignment assignment;
+  // Recorded after a task whose successor runs on another stream
+  std::vector<cudaEvent_t> task_events;
   std::vector<cudaGraph_t> graphs;
   std::vector<cudaGraphExec_t> graphExecs;
 };
@@ -138,6 +153,8 @@ void print_usage() {
       "time of the complete computation function:\n"
       "It waits all events on the first stream and print the elapsed time of\n"
       "the.\n");
+  TileScheduler::print_schedule_usage();
+  BenchRecord::print_output_usage();
 }
 
 bool report_elapsed_time_per_stream(bool enable_per_stream_timing,
@@ -173,6 +190,17 @@ std::tuple<ProblemSpec, RuntimeData> generate_data_and_prepare(
   char *cli_result_path_and_prefix;
   bool flag_specify_result_path_and_prefix = getCmdLineArgumentString(
       argc, argv, "result_path_and_prefix", &cli_result_path_and_prefix);
+  BenchRecord::OutputOptions output_options =
+      BenchRecord::parse_output_options(argc, argv);
+  bool print_schedule = checkCmdLineFlag(argc, argv, "print_schedule");
+  TileScheduler::Policy schedule_policy;
+  try {
+    schedule_policy = TileScheduler::parse_policy(argc, argv);
+  } catch (const std::invalid_argument &e) {
+    printf("%s\n", e.what());
+    print_usage();
+    exit(EXIT_FAILURE);
+  }
   printf("m(%d) n(%d) k(%d) mm(%d) nn(%d) kk(%d) nstreams(%d)\n", m, n, k, mm,
          nn, kk, nstreams);
   if (m == 0 || n == 0 || k == 0 || mm == 0 || nn == 0 || kk == 0) {
@@ -212,6 +240,31 @@ std::tuple<ProblemSpec, RuntimeData> generate_data_and_prepare(
   std::generate(A.begin(), A.end(), std::rand);
   std::generate(B.begin(), B.end(), std::rand);
 
+  // All tiles have the same flop count. Partial products of the same (i, j)
+  // are written to separate slices of d_C and summed by reduce_segments, so
+  // they do not accumulate in place and have no dependencies; the output
+  // block only groups them for the affinity policy.
+  std::vector<TileScheduler::Task> tasks;
+  for (int i = 0; i < m / mm; i++) {
+    for (int j = 0; j < n / nn; j++) {
+      for (int l = 0; l < k / kk; l++) {
+        tasks.push_back(TileScheduler::Task{.idx = {i, j, l},
+                                            .cost = 2.0 * mm * nn * kk,
+                                            .output_block = i + j * (m / mm),
+                                            .accumulates = false});
+      }
+    }
+  }
+  TileScheduler::Assignment assignment =
+      TileScheduler::schedule(tasks, nstreams, schedule_policy);
+  if (print_schedule) {
+    TileScheduler::print_assignment(tasks, assignment);
+  }
+  std::vector<cudaEvent_t> task_events(tasks.size());
+  for (auto &event : task_events) {
+    CUDA_CHECK(cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+  }
+
   for (int idx = 0; idx < nstreams; idx++) {
     cudaStream_t stream;
     CUDA_CHECK(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
@@ -297,7 +350,10 @@ std::tuple<ProblemSpec, RuntimeData> generate_data_and_prepare(
       .cli_result_path_and_prefix = cli_result_path_and_prefix,
       .flag_specify_result_path_and_prefix =
           flag_specify_result_path_and_prefix,
-      .nstreams = nstreams};
+      .nstreams = nstreams,
+      .schedule_policy = schedule_policy,
+      .print_schedule = print_schedule,
+      .output_options = output_options};
   RuntimeData runtime_data = {//.lda not set
                               //.ldb not set
                               //.ldc not set
@@ -312,7 +368,10 @@ std::tuple<ProblemSpec, RuntimeData> generate_data_and_prepare(
                               .d_B = d_B,
                               .d_C = d_C,
                               .streams = streams,
-                              .cublasHs = cublasHs};
+                              .cublasHs = cublasHs,
+                              .tasks = tasks,
+                              .assignment = assignment,
+                              .task_events = task_events};
 
   std::tuple<ProblemSpec, RuntimeData> bench_gemm_partitioned_tuple =
       std::make_tuple(problem_spec, runtime_data);
@@ -389,14 +448,14 @@ void compute(ProblemSpec &bench_spec, RuntimeData &bench_data,
           cudaEventRecord(starts_per_stream[idx], bench_data.streams[idx]));
     }
   }
-  for (int i = 0; i < bench_spec.m / bench_spec.mm; i++) {
-    for (int j = 0; j < bench_spec.n / bench_spec.nn; j++) {
-      for (int l = 0; l < bench_spec.k / bench_spec.kk; l++) {
-        int curr_stream_idx = getCurrStream(
-            {i, j, l},
-            {bench_spec.m / bench_spec.mm, bench_spec.n / bench_spec.nn,
-             bench_spec.k / bench_spec.kk},
-            bench_data.streams.size());
+  // Tiles are issued in schedule order; a tile whose predecessor ran on
+  // another stream waits on the event recorded after it
+  TileScheduler::issue_tasks(
+      bench_data.assignment,
+      [&](int task, int curr_stream_idx) {
+        int i = bench_data.tasks[task].idx[0];
+        int j = bench_data.tasks[task].idx[1];
+        int l = bench_data.tasks[task].idx[2];
         CUBLAS_CHECK(cublasSgemm(
             bench_data.cublasHs[curr_stream_idx], bench_data.transa,
             bench_data.transb, bench_spec.mm, bench_spec.nn, bench_spec.kk,
@@ -407,9 +466,15 @@ void compute(ProblemSpec &bench_spec, RuntimeData &bench_data,
             bench_data.d_C + l * bench_spec.m * bench_spec.n +
                 i * bench_spec.mm + j * bench_spec.nn * ldc,
             ldc));
-      }
-    }
-  }
+      },
+      [&](int task, int stream) {
+        CUDA_CHECK(cudaEventRecord(bench_data.task_events[task],
+                                   bench_data.streams[stream]));
+      },
+      [&](int stream, int task) {
+        CUDA_CHECK(cudaStreamWaitEvent(bench_data.streams[stream],
+                                       bench_data.task_events[task]));
+      });
 
   // Stream idx 0 waits for all other streams to finish before executing the
   // reduction kernel
@@ -500,6 +565,7 @@ void consume_and_print_timing(ProblemSpec &bench_spec,
     CUDA_CHECK(cudaEventSynchronize(stop));
     float elapsed_time = 0.0f;
     CUDA_CHECK(cudaEventElapsedTime(&elapsed_time, start, stop));
+    timing_results.elapsed_ms["total"] = elapsed_time;
     printf("cublasSgemmPartitioned elapsed time (ms): %f\n", elapsed_time);
     printf("cublasSgemmPartitioned throughput (GFLOPS): %f\n",
            (2.0 * bench_spec.m * bench_spec.n * bench_spec.k) /
@@ -526,6 +592,8 @@ void consume_and_print_timing(ProblemSpec &bench_spec,
                                       timing_results.stop_events[idx]));
       printf("cublasSgemmPartitioned elapsed time(streamIdx%d) (ms): %f\n", idx,
              elapsed_time);
+      timing_results.elapsed_ms["stream" + std::to_string(idx)] =
+          elapsed_time;
       // TODO: enable throughput print
       // printf("cublasSgemmPartitioned stream %d throughput (GFLOPS): %f\n",
       // idx,
@@ -545,11 +613,49 @@ void consume_and_print_timing(ProblemSpec &bench_spec,
                                     std::get<1>(value)));
     printf("cublasSgemmPartitioned %s elapsed time(util) (ms): %f\n",
            key.c_str(), elapsed_time_util);
+    timing_results.utility_elapsed_ms[key] = elapsed_time_util;
     CUDA_CHECK(cudaEventDestroy(std::get<0>(value)));
     CUDA_CHECK(cudaEventDestroy(std::get<1>(value)));
   }
 }
 
+void emit_record(ProblemSpec &bench_spec, RuntimeData &bench_data,
+                 TimingResults &timing_results) {
+  if (bench_spec.output_options.format == BenchRecord::OutputFormat::kText) {
+    return;
+  }
+  BenchRecord::Record record;
+  record.add("bench", "bench_gemm_partitioned");
+  record.add("routine", "cublasSgemmPartitioned");
+  record.add("m", bench_spec.m);
+  record.add("n", bench_spec.n);
+  record.add("k", bench_spec.k);
+  record.add("mm", bench_spec.mm);
+  record.add("nn", bench_spec.nn);
+  record.add("kk", bench_spec.kk);
+  record.add("dtype", "float32");
+  record.add("nstreams", bench_spec.nstreams);
+  record.add("enable_graph", bench_spec.enable_graph);
+  record.add("schedule",
+             TileScheduler::get_policy_name(bench_spec.schedule_policy));
+  record.add("schedule.imbalance",
+             TileScheduler::get_imbalance(bench_data.assignment));
+  record.add("schedule.cross_stream_edges",
+             bench_data.assignment.cross_stream_edges);
+  for (const auto &keyval : timing_results.elapsed_ms) {
+    record.add("time_ms." + keyval.first, keyval.second);
+  }
+  if (timing_results.elapsed_ms.count("total") > 0) {
+    record.add("gflops", (2.0 * bench_spec.m * bench_spec.n * bench_spec.k) /
+                             (timing_results.elapsed_ms["total"] / 1000.0) /
+                             1e9);
+  }
+  record.add_phase_times(timing_results.utility_elapsed_ms);
+  record.add_host_info();
+  record.add_device_info();
+  BenchRecord::emit(bench_spec.output_options, record);
+}
+
 void cleanup(ProblemSpec &bench_spec, RuntimeData &bench_data) {
   int lda = bench_spec.m;
   int ldb = bench_spec.k;
@@ -597,6 +703,9 @@ void cleanup(ProblemSpec &bench_spec, RuntimeData &bench_data) {
   CUDA_CHECK(cudaFree(bench_data.d_B));
   CUDA_CHECK(cudaFree(bench_data.d_C));
 
+  for (auto &event : bench_data.task_events) {
+    CUDA_CHECK(cudaEventDestroy(event));
+  }
   for (int idx = 0; idx < bench_spec.nstreams; idx++) {
     CUBLAS_CHECK(cublasDestroy(bench_data.cublasHs[idx]));
     CUDA_CHECK(cudaStreamDestroy(bench_data.streams[idx]));
@@ -662,6 +771,11 @@ int main(const int argc, const char **argv) {
     graph_initialization_end = std::chrono::system_clock::now();
     launch_graph_and_wait(bench_data);
     graph_execution_end = std::chrono::system_clock::now();
+    timing_results.elapsed_ms["graph_execution_chrono"] =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            graph_execution_end - graph_initialization_end)
+            .count() /
+        1000.0f;
     printf(
         "[DEBUG] cublasSgemmPartitioned graph creation chrono time "
         "(microseconds): "
@@ -697,6 +811,7 @@ int main(const int argc, const char **argv) {
     CUDA_CHECK(cudaGraphExecDestroy(bench_data.graphExecs[0]));
     CUDA_CHECK(cudaGraphDestroy(bench_data.graphs[0]));
   }
+  emit_record(bench_spec, bench_data, timing_results);
   cleanup(bench_spec, bench_data);
   return 0;
 }
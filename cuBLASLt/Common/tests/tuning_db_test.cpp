@@ -0,0 +1,352 @@
+/*
+ * Checks the tuning database on the host: insert and replace, exact and
+ * nearest-shape lookup, merge, save/load and mmap round trips, and the
+ * rejection of truncated, corrupt and unsorted files.
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test_check.h"
+#include "tuning_db.h"
+
+namespace {
+
+using namespace TuningDb;
+
+std::string getTempPath(const char *name) {
+    const char *tmpdir = std::getenv("TMPDIR");
+    return std::string(tmpdir ? tmpdir : "/tmp") + "/" + name + "." + std::to_string(getpid());
+}
+
+ProblemKey makeKey(const char *gpu, int32_t transa, int32_t m, int32_t n, int32_t k) {
+    ProblemKey key = makeEmptyKey();
+    setGpuName(key, gpu);
+    key.libraryVersion = 110000;
+    key.computeType = 68;
+    key.transa = transa;
+    key.m = m;
+    key.n = n;
+    key.k = k;
+    key.lda = m;
+    key.ldb = k;
+    key.ldc = m;
+    return key;
+}
+
+Entry makeEntry(const ProblemKey &key, int32_t algoId, float time) {
+    Entry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.key = key;
+    entry.config.algoId = algoId;
+    entry.config.tile = 15;
+    entry.time = time;
+    entry.workspaceSize = 1 << 20;
+    return entry;
+}
+
+bool sameEntries(const std::vector<Entry> &a, const Entry *b, size_t count) {
+    return a.size() == count && (count == 0 || memcmp(a.data(), b, count * sizeof(Entry)) == 0);
+}
+
+std::vector<char> readFile(const std::string &path) {
+    std::vector<char> bytes;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return bytes;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + n);
+    fclose(file);
+    return bytes;
+}
+
+void writeFile(const std::string &path, const std::vector<char> &bytes) {
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) return;
+    if (!bytes.empty()) fwrite(bytes.data(), 1, bytes.size(), file);
+    fclose(file);
+}
+
+void testInsert() {
+    Database db;
+    ProblemKey key = makeKey("A100", 0, 256, 256, 256);
+    CHECK(db.insert(makeEntry(key, 1, 2.0f)));
+    CHECK(db.size() == 1);
+
+    // A slower or equally fast entry of the same key is not stored
+    CHECK(!db.insert(makeEntry(key, 2, 3.0f)));
+    CHECK(!db.insert(makeEntry(key, 2, 2.0f)));
+    CHECK(db.find(key) && db.find(key)->config.algoId == 1);
+
+    // A faster one replaces it
+    CHECK(db.insert(makeEntry(key, 3, 1.0f)));
+    CHECK(db.size() == 1);
+    CHECK(db.find(key) && db.find(key)->config.algoId == 3 && db.find(key)->time == 1.0f);
+
+    // Entries stay sorted whatever the insertion order
+    std::mt19937 rng(12);
+    std::uniform_int_distribution<int> shape(1, 8);
+    const char *gpus[] = {"A100", "H100", "V100"};
+    for (int idx = 0; idx < 300; idx++) {
+        ProblemKey other = makeKey(gpus[idx % 3], idx % 2, 64 * shape(rng), 64 * shape(rng), 64 * shape(rng));
+        db.insert(makeEntry(other, idx, (float)shape(rng)));
+    }
+    CHECK(isSorted(db.getEntries().data(), db.size()));
+    for (size_t idx = 0; idx < db.size(); idx++) {
+        const Entry &entry = db.getEntries()[idx];
+        CHECK(db.find(entry.key) == &db.getEntries()[idx]);
+    }
+
+    // erase removes exactly its key
+    size_t size = db.size();
+    CHECK(db.erase(key));
+    CHECK(!db.erase(key));
+    CHECK(db.size() == size - 1);
+    CHECK(!db.find(key));
+    CHECK(isSorted(db.getEntries().data(), db.size()));
+}
+
+void testLookup() {
+    Database db;
+    db.insert(makeEntry(makeKey("A100", 0, 1024, 1024, 1024), 1, 1.0f));
+    db.insert(makeEntry(makeKey("A100", 0, 128, 128, 128), 2, 1.0f));
+    db.insert(makeEntry(makeKey("A100", 0, 4096, 64, 512), 3, 1.0f));
+    db.insert(makeEntry(makeKey("A100", 1, 1000, 1000, 1000), 4, 1.0f));
+    db.insert(makeEntry(makeKey("H100", 0, 1000, 1000, 1000), 5, 1.0f));
+
+    // findExact compares the leading dimensions too
+    ProblemKey key = makeKey("A100", 0, 1024, 1024, 1024);
+    CHECK(db.find(key) && db.find(key)->config.algoId == 1);
+    key.lda = 2048;
+    CHECK(!db.find(key));
+
+    // Nearest by log2 distance of m, n and k, within the class only
+    bool exact = true;
+    const Entry *entry = db.lookup(makeKey("A100", 0, 1000, 1000, 1000), exact);
+    CHECK(entry && entry->config.algoId == 1 && !exact);
+    entry = db.lookup(makeKey("A100", 0, 200, 100, 150), exact);
+    CHECK(entry && entry->config.algoId == 2 && !exact);
+    entry = db.lookup(makeKey("A100", 0, 2048, 64, 512), exact);
+    CHECK(entry && entry->config.algoId == 3 && !exact);
+    entry = db.lookup(makeKey("A100", 1, 8, 8, 8), exact);
+    CHECK(entry && entry->config.algoId == 4 && !exact);
+    entry = db.lookup(makeKey("A100", 0, 128, 128, 128), exact);
+    CHECK(entry && entry->config.algoId == 2 && exact);
+
+    // No entry of the class: another GPU, version or type does not match
+    CHECK(!db.lookup(makeKey("V100", 0, 1024, 1024, 1024), exact));
+    key = makeKey("A100", 0, 1024, 1024, 1024);
+    key.libraryVersion++;
+    CHECK(!db.lookup(key, exact));
+    key = makeKey("A100", 0, 1024, 1024, 1024);
+    key.Atype = 2;
+    CHECK(!db.lookup(key, exact));
+    key = makeKey("A100", 0, 1024, 1024, 1024);
+    key.transb = 1;
+    CHECK(!db.lookup(key, exact));
+    CHECK(!Database().lookup(key, exact));
+
+    // Same as a linear scan over random databases
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> log2Shape(4, 12);
+    for (int trial = 0; trial < 50; trial++) {
+        Database random;
+        for (int idx = 0; idx < 40; idx++) {
+            random.insert(makeEntry(
+                makeKey(idx % 2 ? "A100" : "H100", idx % 3 == 0, 1 << log2Shape(rng), 1 << log2Shape(rng),
+                        1 << log2Shape(rng)),
+                idx, 1.0f));
+        }
+        ProblemKey probe = makeKey("A100", trial % 2, 1 << log2Shape(rng), 1 << log2Shape(rng), 1 << log2Shape(rng));
+        const std::vector<Entry> &entries = random.getEntries();
+        double bestDistance = -1.0;
+        for (size_t idx = 0; idx < entries.size(); idx++) {
+            if (compareClass(entries[idx].key, probe) != 0) continue;
+            double distance = shapeDistance(entries[idx].key, probe);
+            if (bestDistance < 0.0 || distance < bestDistance) bestDistance = distance;
+        }
+        entry = findNearest(entries.data(), entries.size(), probe);
+        CHECK((entry != NULL) == (bestDistance >= 0.0));
+        CHECK(!entry || shapeDistance(entry->key, probe) == bestDistance);
+    }
+}
+
+void testMerge() {
+    Database a, b;
+    ProblemKey shared = makeKey("A100", 0, 512, 512, 512);
+    ProblemKey onlyA = makeKey("A100", 0, 64, 64, 64);
+    ProblemKey onlyB = makeKey("H100", 0, 64, 64, 64);
+    ProblemKey fasterInA = makeKey("A100", 1, 512, 512, 512);
+    a.insert(makeEntry(shared, 1, 3.0f));
+    a.insert(makeEntry(onlyA, 2, 1.0f));
+    a.insert(makeEntry(fasterInA, 3, 1.0f));
+    b.insert(makeEntry(shared, 4, 2.0f));
+    b.insert(makeEntry(onlyB, 5, 1.0f));
+    b.insert(makeEntry(fasterInA, 6, 5.0f));
+    a.merge(b);
+    CHECK(a.size() == 4);
+    CHECK(a.find(shared) && a.find(shared)->config.algoId == 4);
+    CHECK(a.find(onlyA) && a.find(onlyA)->config.algoId == 2);
+    CHECK(a.find(onlyB) && a.find(onlyB)->config.algoId == 5);
+    CHECK(a.find(fasterInA) && a.find(fasterInA)->config.algoId == 3);
+    CHECK(isSorted(a.getEntries().data(), a.size()));
+    CHECK(b.size() == 3);
+}
+
+Database makeDatabase(int count) {
+    Database db;
+    for (int idx = 0; idx < count; idx++) {
+        db.insert(makeEntry(makeKey(idx % 2 ? "A100" : "H100", idx % 3, 64 * (idx + 1), 128, 32 * (idx % 5 + 1)),
+                            idx, 0.5f * idx));
+    }
+    return db;
+}
+
+void testRoundTrip() {
+    std::string path = getTempPath("tuning_db_test.bin");
+    Database db = makeDatabase(20);
+    CHECK(db.size() == 20);
+    CHECK(db.save(path));
+    CHECK(access((path + ".tmp." + std::to_string(getpid())).c_str(), F_OK) != 0);
+    CHECK(readFile(path).size() == sizeof(FileHeader) + 20 * sizeof(Entry));
+
+    Database loaded;
+    CHECK(loaded.load(path));
+    CHECK(sameEntries(loaded.getEntries(), db.getEntries().data(), db.size()));
+
+    MappedDatabase mapped;
+    CHECK(mapped.open(path));
+    CHECK(mapped.size() == 20);
+    for (size_t idx = 0; idx < db.size(); idx++) {
+        const Entry &entry = db.getEntries()[idx];
+        const Entry *found = mapped.find(entry.key);
+        CHECK(found && memcmp(found, &entry, sizeof(Entry)) == 0);
+        bool exact = false;
+        CHECK(mapped.lookup(entry.key, exact) == found && exact);
+    }
+    bool exact = true;
+    const Entry *nearest = mapped.lookup(makeKey("A100", 1, 60, 128, 32), exact);
+    const Entry *expected = db.lookup(makeKey("A100", 1, 60, 128, 32), exact);
+    CHECK(nearest && expected && !exact && memcmp(nearest, expected, sizeof(Entry)) == 0);
+    mapped.close();
+    CHECK(mapped.size() == 0);
+    CHECK(!mapped.find(db.getEntries()[0].key));
+
+    // Saving replaces the file, and an empty database round trips
+    Database empty;
+    CHECK(empty.save(path));
+    CHECK(readFile(path).size() == sizeof(FileHeader));
+    CHECK(loaded.load(path));
+    CHECK(loaded.size() == 0);
+    CHECK(mapped.open(path));
+    CHECK(mapped.size() == 0);
+    CHECK(!mapped.find(db.getEntries()[0].key));
+    mapped.close();
+    remove(path.c_str());
+}
+
+/* Both readers reject the file at path, and a failed load keeps the previous entries */
+void checkRejected(const std::string &path, const Database &previous) {
+    Database db = previous;
+    CHECK(!db.load(path));
+    CHECK(sameEntries(db.getEntries(), previous.getEntries().data(), previous.size()));
+    MappedDatabase mapped;
+    CHECK(!mapped.open(path));
+    CHECK(mapped.size() == 0);
+}
+
+void testRejected() {
+    std::string path = getTempPath("tuning_db_test_bad.bin");
+    Database db = makeDatabase(6);
+    Database previous = makeDatabase(2);
+    CHECK(db.save(path));
+    const std::vector<char> good = readFile(path);
+    CHECK(good.size() == sizeof(FileHeader) + 6 * sizeof(Entry));
+
+    // Missing file
+    remove(path.c_str());
+    checkRejected(path, previous);
+
+    // Truncated: inside an entry, by a whole entry, inside the header, empty
+    std::vector<char> bytes(good.begin(), good.end() - 1);
+    writeFile(path, bytes);
+    checkRejected(path, previous);
+    bytes.assign(good.begin(), good.end() - sizeof(Entry));
+    writeFile(path, bytes);
+    checkRejected(path, previous);
+    bytes.assign(good.begin(), good.begin() + sizeof(FileHeader) / 2);
+    writeFile(path, bytes);
+    checkRejected(path, previous);
+    writeFile(path, std::vector<char>());
+    checkRejected(path, previous);
+
+    // Trailing bytes
+    bytes = good;
+    bytes.push_back(0);
+    writeFile(path, bytes);
+    checkRejected(path, previous);
+
+    // Corrupt magic, version and entry size
+    const size_t fields[] = {offsetof(FileHeader, magic), offsetof(FileHeader, version),
+                             offsetof(FileHeader, entrySize)};
+    for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+        bytes = good;
+        bytes[fields[f]] ^= 1;
+        writeFile(path, bytes);
+        checkRejected(path, previous);
+    }
+
+    // A count that disagrees with the file size, below or above
+    for (uint64_t count = 5; count <= 7; count += 2) {
+        FileHeader header;
+        memcpy(&header, good.data(), sizeof(header));
+        CHECK(header.count == 6);
+        header.count = count;
+        bytes = good;
+        memcpy(bytes.data(), &header, sizeof(header));
+        writeFile(path, bytes);
+        checkRejected(path, previous);
+    }
+
+    // Unsorted entries, and duplicate keys
+    bytes = good;
+    std::swap_ranges(bytes.begin() + sizeof(FileHeader), bytes.begin() + sizeof(FileHeader) + sizeof(Entry),
+                     bytes.begin() + sizeof(FileHeader) + 3 * sizeof(Entry));
+    writeFile(path, bytes);
+    checkRejected(path, previous);
+    bytes = good;
+    std::copy(bytes.begin() + sizeof(FileHeader), bytes.begin() + sizeof(FileHeader) + sizeof(Entry),
+              bytes.begin() + sizeof(FileHeader) + sizeof(Entry));
+    writeFile(path, bytes);
+    checkRejected(path, previous);
+
+    // The intact file still loads
+    writeFile(path, good);
+    Database loaded;
+    CHECK(loaded.load(path));
+    CHECK(sameEntries(loaded.getEntries(), db.getEntries().data(), db.size()));
+    MappedDatabase mapped;
+    CHECK(mapped.open(path));
+    CHECK(mapped.size() == 6);
+    mapped.close();
+    remove(path.c_str());
+}
+
+}  // namespace
+
+int main() {
+    testInsert();
+    testLookup();
+    testMerge();
+    testRoundTrip();
+    testRejected();
+    return test_result("tuning_db_test");
+}
@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * Persistent store of matmul tuning results, so that the algo found by a
+ * search is reused by later processes instead of searched again.
+ *
+ * Entries are keyed by the problem signature (GPU, library version, types,
+ * epilogue, transposes, shape and leading dimensions) and hold the algo
+ * config attributes with the measured time per run. The file is a header
+ * followed by fixed size entries sorted by key, in host byte order, so
+ * that MappedDatabase can binary search it in place. Problems of the same
+ * class (everything but the shape) are contiguous, which makes the
+ * nearest-shape fallback a scan of one range. On Windows, MappedDatabase
+ * reads the file instead of mapping it.
+ *
+ * Host-only; tuning_db_cublaslt.h converts from and to cublasLt types.
+ */
+namespace TuningDb {
+
+struct ProblemKey {
+    char gpuName[64];
+    int64_t libraryVersion;
+    int32_t computeType;
+    int32_t scaleType;
+    int32_t Atype;
+    int32_t Btype;
+    int32_t Ctype;
+    int32_t Dtype;
+    int32_t epilogue;
+    int32_t transa;
+    int32_t transb;
+    int32_t m;
+    int32_t n;
+    int32_t k;
+    int32_t lda;
+    int32_t ldb;
+    int32_t ldc;
+    int32_t reserved;
+};
+
+/* cublasLtMatmulAlgo_t config attributes */
+struct AlgoConfig {
+    int32_t algoId;
+    int32_t tile;
+    int32_t stages;
+    int32_t splitK;
+    int32_t reductionScheme;
+    int32_t swizzle;
+    int32_t customOption;
+    int32_t reserved;
+};
+
+struct Entry {
+    ProblemKey key;
+    AlgoConfig config;
+    float time;  // per run, in ms
+    uint32_t reserved;
+    uint64_t workspaceSize;
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint64_t count;
+};
+
+static_assert(sizeof(ProblemKey) == 136, "ProblemKey is part of the file format");
+static_assert(sizeof(Entry) == 184, "Entry is part of the file format");
+
+const char kMagic[8] = {'C', 'U', 'B', 'L', 'T', 'D', 'B', '\0'};
+const uint32_t kFormatVersion = 1;
+
+/* Zeroed key, so that padding and unused bytes compare equal */
+inline ProblemKey makeEmptyKey() {
+    ProblemKey key;
+    memset(&key, 0, sizeof(key));
+    return key;
+}
+
+inline void setGpuName(ProblemKey &key, const char *name) {
+    memset(key.gpuName, 0, sizeof(key.gpuName));
+    strncpy(key.gpuName, name, sizeof(key.gpuName) - 1);
+}
+
+/* Orders by problem class first, then by shape */
+inline int compareClass(const ProblemKey &a, const ProblemKey &b) {
+    int c = strncmp(a.gpuName, b.gpuName, sizeof(a.gpuName));
+    if (c) return c < 0 ? -1 : 1;
+    if (a.libraryVersion != b.libraryVersion) return a.libraryVersion < b.libraryVersion ? -1 : 1;
+    const int32_t *fa = &a.computeType, *fb = &b.computeType;
+    for (int f = 0; f < 9; f++) {  // computeType .. transb
+        if (fa[f] != fb[f]) return fa[f] < fb[f] ? -1 : 1;
+    }
+    return 0;
+}
+
+inline int compareKey(const ProblemKey &a, const ProblemKey &b) {
+    int c = compareClass(a, b);
+    if (c) return c;
+    const int32_t *fa = &a.m, *fb = &b.m;
+    for (int f = 0; f < 6; f++) {  // m .. ldc
+        if (fa[f] != fb[f]) return fa[f] < fb[f] ? -1 : 1;
+    }
+    return 0;
+}
+
+inline bool entryLess(const Entry &a, const Entry &b) { return compareKey(a.key, b.key) < 0; }
+
+/* Distance between the shapes of two problems of the same class, in log2 units */
+inline double shapeDistance(const ProblemKey &a, const ProblemKey &b) {
+    return std::fabs(std::log2(double(a.m) / b.m)) + std::fabs(std::log2(double(a.n) / b.n)) +
+           std::fabs(std::log2(double(a.k) / b.k));
+}
+
+/* Entry of key in sorted entries, or NULL */
+inline const Entry *findExact(const Entry *entries, size_t count, const ProblemKey &key) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (compareKey(entries[mid].key, key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < count && compareKey(entries[lo].key, key) == 0 ? &entries[lo] : NULL;
+}
+
+/* Entry of the same class as key with the closest shape, or NULL */
+inline const Entry *findNearest(const Entry *entries, size_t count, const ProblemKey &key) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (compareClass(entries[mid].key, key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    const Entry *best = NULL;
+    double bestDistance = 0.0;
+    for (size_t idx = lo; idx < count && compareClass(entries[idx].key, key) == 0; idx++) {
+        double distance = shapeDistance(entries[idx].key, key);
+        if (!best || distance < bestDistance) {
+            best = &entries[idx];
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+/* Exact entry if any, else the nearest shape of the same class; exact tells which */
+inline const Entry *lookup(const Entry *entries, size_t count, const ProblemKey &key, bool &exact) {
+    const Entry *entry = findExact(entries, count, key);
+    exact = entry != NULL;
+    return entry ? entry : findNearest(entries, count, key);
+}
+
+/* Checks the header of a file of size bytes and returns its entry count, or -1 */
+inline long long checkHeader(const FileHeader &header, size_t size) {
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kFormatVersion ||
+        header.entrySize != sizeof(Entry)) {
+        return -1;
+    }
+    if (size < sizeof(header) || (size - sizeof(header)) / sizeof(Entry) != header.count ||
+        (size - sizeof(header)) % sizeof(Entry) != 0) {
+        return -1;
+    }
+    return (long long)header.count;
+}
+
+inline bool isSorted(const Entry *entries, size_t count) {
+    for (size_t idx = 1; idx < count; idx++) {
+        if (compareKey(entries[idx - 1].key, entries[idx].key) >= 0) return false;
+    }
+    return true;
+}
+
+inline void writeJsonString(FILE *file, const char *text, size_t maxLength) {
+    fputc('"', file);
+    for (size_t idx = 0; idx < maxLength && text[idx]; idx++) {
+        unsigned char c = text[idx];
+        if (c == '"' || c == '\\') fprintf(file, "\\%c", c);
+        else if (c < 0x20) fprintf(file, "\\u%04x", c);
+        else fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+inline void writeJsonEntry(FILE *file, const Entry &entry) {
+    const ProblemKey &key = entry.key;
+    const AlgoConfig &config = entry.config;
+    fprintf(file, "{\"gpu\": ");
+    writeJsonString(file, key.gpuName, sizeof(key.gpuName));
+    fprintf(file, ", \"libraryVersion\": %lld, \"computeType\": %d, \"scaleType\": %d, "
+                  "\"Atype\": %d, \"Btype\": %d, \"Ctype\": %d, \"Dtype\": %d, \"epilogue\": %d, "
+                  "\"transa\": %d, \"transb\": %d, \"m\": %d, \"n\": %d, \"k\": %d, "
+                  "\"lda\": %d, \"ldb\": %d, \"ldc\": %d, "
+                  "\"algo\": {\"id\": %d, \"tile\": %d, \"stages\": %d, \"splitK\": %d, "
+                  "\"reductionScheme\": %d, \"swizzle\": %d, \"customOption\": %d}, "
+                  "\"time\": %g, \"workspaceSize\": %llu}",
+            (long long)key.libraryVersion, key.computeType, key.scaleType, key.Atype, key.Btype, key.Ctype,
+            key.Dtype, key.epilogue, key.transa, key.transb, key.m, key.n, key.k, key.lda, key.ldb, key.ldc,
+            config.algoId, config.tile, config.stages, config.splitK, config.reductionScheme, config.swizzle,
+            config.customOption, entry.time, (unsigned long long)entry.workspaceSize);
+}
+
+/* In-memory database, used to record, merge and save results */
+class Database {
+  public:
+    size_t size() const { return entries.size(); }
+    const std::vector<Entry> &getEntries() const { return entries; }
+
+    /* Adds entry, or replaces the entry of the same key if entry is faster. Returns true if stored */
+    bool insert(const Entry &entry) {
+        std::vector<Entry>::iterator it = std::lower_bound(entries.begin(), entries.end(), entry, entryLess);
+        if (it != entries.end() && compareKey(it->key, entry.key) == 0) {
+            if (!(entry.time < it->time)) return false;
+            *it = entry;
+            return true;
+        }
+        entries.insert(it, entry);
+        return true;
+    }
+
+    /* Returns false if key has no entry */
+    bool erase(const ProblemKey &key) {
+        Entry probe;
+        memset(&probe, 0, sizeof(probe));
+        probe.key = key;
+        std::vector<Entry>::iterator it = std::lower_bound(entries.begin(), entries.end(), probe, entryLess);
+        if (it == entries.end() || compareKey(it->key, key) != 0) return false;
+        entries.erase(it);
+        return true;
+    }
+
+    /* Keeps the faster entry of every key present in both */
+    void merge(const Database &other) {
+        for (size_t idx = 0; idx < other.entries.size(); idx++) insert(other.entries[idx]);
+    }
+
+    const Entry *find(const ProblemKey &key) const { return findExact(entries.data(), entries.size(), key); }
+
+    const Entry *lookup(const ProblemKey &key, bool &exact) const {
+        return TuningDb::lookup(entries.data(), entries.size(), key, exact);
+    }
+
+    /* Returns false if the file cannot be read or is not a valid database */
+    bool load(const std::string &path) {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file) return false;
+        FileHeader header;
+        bool ok = fseek(file, 0, SEEK_END) == 0;
+        long size = ok ? ftell(file) : -1;
+        ok = size >= 0 && fseek(file, 0, SEEK_SET) == 0 && fread(&header, sizeof(header), 1, file) == 1;
+        long long count = ok ? checkHeader(header, size) : -1;
+        std::vector<Entry> loaded(count > 0 ? count : 0);
+        ok = count >= 0 && (count == 0 || fread(loaded.data(), sizeof(Entry), count, file) == size_t(count)) &&
+             isSorted(loaded.data(), loaded.size());
+        fclose(file);
+        if (ok) entries.swap(loaded);
+        return ok;
+    }
+
+    /* Writes a temporary file renamed over path, so that readers never see a partial database */
+    bool save(const std::string &path) const {
+#ifdef _WIN32
+        std::string tmpPath = path + ".tmp." + std::to_string(_getpid());
+#else
+        std::string tmpPath = path + ".tmp." + std::to_string(getpid());
+#endif
+        FILE *file = fopen(tmpPath.c_str(), "wb");
+        if (!file) return false;
+        FileHeader header;
+        memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kFormatVersion;
+        header.entrySize = sizeof(Entry);
+        header.count = entries.size();
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  (entries.empty() || fwrite(entries.data(), sizeof(Entry), entries.size(), file) == entries.size());
+        ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+        // rename does not replace existing files on Windows
+        if (ok) remove(path.c_str());
+#endif
+        ok = ok && rename(tmpPath.c_str(), path.c_str()) == 0;
+        if (!ok) remove(tmpPath.c_str());
+        return ok;
+    }
+
+    void exportJson(FILE *file) const {
+        fprintf(file, "[\n");
+        for (size_t idx = 0; idx < entries.size(); idx++) {
+            fprintf(file, "  ");
+            writeJsonEntry(file, entries[idx]);
+            fprintf(file, idx + 1 < entries.size() ? ",\n" : "\n");
+        }
+        fprintf(file, "]\n");
+    }
+
+  private:
+    // Sorted by key
+    std::vector<Entry> entries;
+};
+
+/* Read-only database searched in place in a memory mapping of the file */
+class MappedDatabase {
+  public:
+    MappedDatabase() : mapping(NULL), mappingSize(0), entries(NULL), count(0) {}
+    ~MappedDatabase() { close(); }
+
+    /* Returns false if the file cannot be mapped or is not a valid database */
+    bool open(const std::string &path) {
+        close();
+#ifdef _WIN32
+        if (!fallback.load(path)) return false;
+        entries = fallback.getEntries().data();
+        count = fallback.size();
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(FileHeader)) {
+            ::close(fd);
+            return false;
+        }
+        void *address = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) return false;
+        mapping = address;
+        mappingSize = info.st_size;
+        long long entryCount = checkHeader(*static_cast<const FileHeader *>(mapping), mappingSize);
+        const Entry *first = reinterpret_cast<const Entry *>(static_cast<const char *>(mapping) + sizeof(FileHeader));
+        if (entryCount < 0 || !isSorted(first, entryCount)) {
+            close();
+            return false;
+        }
+        entries = first;
+        count = entryCount;
+        return true;
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        fallback = Database();
+#else
+        if (mapping) munmap(mapping, mappingSize);
+#endif
+        mapping = NULL;
+        mappingSize = 0;
+        entries = NULL;
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    const Entry *find(const ProblemKey &key) const { return findExact(entries, count, key); }
+    const Entry *lookup(const ProblemKey &key, bool &exact) const {
+        return TuningDb::lookup(entries, count, key, exact);
+    }
+
+  private:
+    MappedDatabase(const MappedDatabase &);
+    MappedDatabase &operator=(const MappedDatabase &);
+
+    void *mapping;
+    size_t mappingSize;
+    const Entry *entries;
+    size_t count;
+#ifdef _WIN32
+    Database fallback;
+#endif
+};
+
+}  // namespace TuningDb
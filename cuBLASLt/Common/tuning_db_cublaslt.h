@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdlib>
+
+#include <cublasLt.h>
+#include <cuda_runtime_api.h>
+
+#include "tuning_db.h"
+
+/* cublasLt adapters of tuning_db.h */
+namespace TuningDb {
+
+/* Database file named by CUBLASLT_TUNING_DB, or NULL when the database is disabled */
+inline const char *getDatabasePath() {
+    const char *path = getenv("CUBLASLT_TUNING_DB");
+    return path && *path ? path : NULL;
+}
+
+/* Key of a matmul on the current device with the loaded cublasLt */
+inline ProblemKey makeProblemKey(cublasOperation_t transa,
+                                 cublasOperation_t transb,
+                                 int m,
+                                 int n,
+                                 int k,
+                                 int lda,
+                                 int ldb,
+                                 int ldc,
+                                 cudaDataType_t Atype,
+                                 cudaDataType_t Btype,
+                                 cudaDataType_t Ctype,
+                                 cudaDataType_t Dtype,
+                                 cudaDataType_t scaleType,
+                                 cublasComputeType_t computeType,
+                                 cublasLtEpilogue_t epilogue) {
+    ProblemKey key = makeEmptyKey();
+    int device = 0;
+    cudaDeviceProp properties;
+    if (cudaGetDevice(&device) == cudaSuccess && cudaGetDeviceProperties(&properties, device) == cudaSuccess) {
+        setGpuName(key, properties.name);
+    }
+    key.libraryVersion = (int64_t)cublasLtGetVersion();
+    key.computeType = computeType;
+    key.scaleType = scaleType;
+    key.Atype = Atype;
+    key.Btype = Btype;
+    key.Ctype = Ctype;
+    key.Dtype = Dtype;
+    key.epilogue = epilogue;
+    key.transa = transa;
+    key.transb = transb;
+    key.m = m;
+    key.n = n;
+    key.k = k;
+    key.lda = lda;
+    key.ldb = ldb;
+    key.ldc = ldc;
+    return key;
+}
+
+inline AlgoConfig getAlgoConfig(const cublasLtMatmulAlgo_t &algo) {
+    AlgoConfig config;
+    memset(&config, 0, sizeof(config));
+    cublasLtMatmulAlgoConfigGetAttribute(&algo, CUBLASLT_ALGO_CONFIG_ID, &config.algoId, sizeof(config.algoId), NULL);
+    cublasLtMatmulAlgoConfigGetAttribute(&algo, CUBLASLT_ALGO_CONFIG_TILE_ID, &config.tile, sizeof(config.tile), NULL);
+    cublasLtMatmulAlgoConfigGetAttribute(&algo, CUBLASLT_ALGO_CONFIG_STAGES_ID, &config.stages, sizeof(config.stages), NULL);
+    cublasLtMatmulAlgoConfigGetAttribute(&algo, CUBLASLT_ALGO_CONFIG_SPLITK_NUM, &config.splitK, sizeof(config.splitK), NULL);
+    cublasLtMatmulAlgoConfigGetAttribute(&algo, CUBLASLT_ALGO_CONFIG_REDUCTION_SCHEME, &config.reductionScheme, sizeof(config.reductionScheme), NULL);
+    cublasLtMatmulAlgoConfigGetAttribute(&algo, CUBLASLT_ALGO_CONFIG_CTA_SWIZZLING, &config.swizzle, sizeof(config.swizzle), NULL);
+    cublasLtMatmulAlgoConfigGetAttribute(&algo, CUBLASLT_ALGO_CONFIG_CUSTOM_OPTION, &config.customOption, sizeof(config.customOption), NULL);
+    return config;
+}
+
+/* Rebuilds the algo of a stored config for the types of key. Check it with cublasLtMatmulAlgoCheck before use */
+inline cublasStatus_t initAlgo(cublasLtHandle_t ltHandle, const ProblemKey &key, const AlgoConfig &config,
+                               cublasLtMatmulAlgo_t &algo) {
+    cublasStatus_t status = cublasLtMatmulAlgoInit(ltHandle, (cublasComputeType_t)key.computeType,
+        (cudaDataType_t)key.scaleType, (cudaDataType_t)key.Atype, (cudaDataType_t)key.Btype,
+        (cudaDataType_t)key.Ctype, (cudaDataType_t)key.Dtype, config.algoId, &algo);
+    if (status != CUBLAS_STATUS_SUCCESS) return status;
+    const int32_t *values[] = {&config.tile, &config.stages, &config.splitK, &config.reductionScheme,
+                               &config.swizzle, &config.customOption};
+    const cublasLtMatmulAlgoConfigAttributes_t attributes[] = {CUBLASLT_ALGO_CONFIG_TILE_ID,
+        CUBLASLT_ALGO_CONFIG_STAGES_ID, CUBLASLT_ALGO_CONFIG_SPLITK_NUM, CUBLASLT_ALGO_CONFIG_REDUCTION_SCHEME,
+        CUBLASLT_ALGO_CONFIG_CTA_SWIZZLING, CUBLASLT_ALGO_CONFIG_CUSTOM_OPTION};
+    for (int idx = 0; idx < 6 && status == CUBLAS_STATUS_SUCCESS; idx++) {
+        status = cublasLtMatmulAlgoConfigSetAttribute(&algo, attributes[idx], values[idx], sizeof(int32_t));
+    }
+    return status;
+}
+
+/*
+ * Adds a result to the database at path, keeping the faster entry of the key unless replace is set, e.g., when the
+ * stored algo no longer passes cublasLtMatmulAlgoCheck. Returns false on I/O errors.
+ * Concurrent writers to the same file may drop each other's results; use one file per process and merge them.
+ */
+inline bool recordResult(const char *path, const ProblemKey &key, const cublasLtMatmulAlgo_t &algo, float time,
+                         size_t workspaceSize, bool replace = false) {
+    Database database;
+    // A missing or invalid file starts a new database
+    database.load(path);
+    if (replace) database.erase(key);
+    Entry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.key = key;
+    entry.config = getAlgoConfig(algo);
+    entry.time = time;
+    entry.workspaceSize = workspaceSize;
+    database.insert(entry);
+    return database.save(path);
+}
+
+}  // namespace TuningDb
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/*
+ * Host-only search engine for matmul algo configurations, independent of
+ * cublasLt so that it can be driven by a mocked cost function:
+ *  - enumerateCandidates expands the capabilities of each algo ID into the
+ *    list of configurations to try, interleaving the algo IDs so that a
+ *    truncated search still covers all of them;
+ *  - search runs successive halving: every candidate is timed with a few
+ *    repeats, the best 1/eta are kept and timed again with eta times more
+ *    repeats, until one candidate is left or maxRepeats is reached;
+ *  - the search stops early once the trial or wall time budget is spent.
+ */
+namespace AlgoSearch {
+
+/* Capabilities of one algo ID, as reported by cublasLtMatmulAlgoCapGetAttribute */
+struct AlgoCaps {
+    int algoId;
+    std::vector<int> tiles;
+    std::vector<int> stages;
+    bool splitkSupport;
+    int reductionMask;  // reduction schemes usable with split-K
+    int swizzlingMax;
+    int customOptionMax;
+};
+
+/* One configuration of an algo */
+struct Candidate {
+    int algoId;
+    int tile;
+    int stages;
+    int customOption;
+    int swizzle;
+    int splitK;           // 0 when split-K is disabled
+    int reductionScheme;  // 0 when split-K is disabled
+};
+
+/* Budget and elimination schedule of the search */
+struct Options {
+    int initialRepeats;    // kernel runs per candidate in the first round
+    int maxRepeats;        // no round runs a candidate more often than this
+    int eta;               // 1/eta of the candidates survive each round
+    long long maxTrials;   // total kernel runs, 0 for no limit
+    double maxTimeMs;      // wall time of the search, 0 for no limit
+    size_t maxCandidates;  // enumerated candidates, 0 for no limit
+};
+
+inline Options getDefaultOptions() {
+    Options options;
+    options.initialRepeats = 2;
+    options.maxRepeats = 32;
+    options.eta = 2;
+    options.maxTrials = 0;
+    options.maxTimeMs = 10000.0;
+    options.maxCandidates = 0;
+    return options;
+}
+
+/* Time of a candidate, averaged over all its kernel runs */
+struct Measurement {
+    size_t index;  // into the candidate list
+    float time;    // per kernel run
+    int repeats;   // kernel runs so far
+    int rounds;    // rounds the candidate took part in
+};
+
+struct Result {
+    // Successfully timed candidates, best first: those which went through
+    // more rounds come first, then by time
+    std::vector<Measurement> ranked;
+    size_t numCandidates;
+    size_t numEvaluated;
+    size_t numFailed;
+    long long trials;
+    double elapsedMs;
+    bool budgetExhausted;
+};
+
+/*
+ * Runs the candidate at index repeats times and sets time to the time per
+ * run. Returns false if the candidate cannot run (not supported, not
+ * enough workspace, ...); it is then dropped from the search.
+ */
+typedef std::function<bool(size_t index, int repeats, float &time)> CostFunction;
+
+inline std::vector<Candidate> enumerateCandidates(const std::vector<AlgoCaps> &algos,
+                                                  const std::vector<int> &splitKSequence,
+                                                  size_t maxCandidates) {
+    // Same order as the nested loops of the original sample, per algo ID
+    std::vector<std::vector<Candidate>> perAlgo(algos.size());
+    for (size_t a = 0; a < algos.size(); a++) {
+        const AlgoCaps &caps = algos[a];
+        for (size_t t = 0; t < caps.tiles.size(); t++) {
+            for (size_t s = 0; s < caps.stages.size(); s++) {
+                for (int customOption = 0; customOption <= caps.customOptionMax; customOption++) {
+                    for (int swizzle = 0; swizzle <= caps.swizzlingMax; swizzle++) {
+                        Candidate candidate = {caps.algoId, caps.tiles[t], caps.stages[s], customOption, swizzle, 0, 0};
+                        perAlgo[a].push_back(candidate);
+                        if (!caps.splitkSupport) continue;
+                        for (size_t l = 0; l < splitKSequence.size(); l++) {
+                            for (int scheme = 1; scheme <= caps.reductionMask; scheme <<= 1) {
+                                if (!(scheme & caps.reductionMask)) continue;
+                                candidate.splitK = splitKSequence[l];
+                                candidate.reductionScheme = scheme;
+                                perAlgo[a].push_back(candidate);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    // Round-robin over the algo IDs
+    std::vector<Candidate> candidates;
+    for (size_t rank = 0;; rank++) {
+        bool any = false;
+        for (size_t a = 0; a < perAlgo.size(); a++) {
+            if (rank >= perAlgo[a].size()) continue;
+            any = true;
+            if (maxCandidates && candidates.size() == maxCandidates) return candidates;
+            candidates.push_back(perAlgo[a][rank]);
+        }
+        if (!any) return candidates;
+    }
+}
+
+inline bool isFaster(const Measurement &a, const Measurement &b) {
+    return a.time < b.time;
+}
+
+inline bool isBetterRanked(const Measurement &a, const Measurement &b) {
+    if (a.rounds != b.rounds) return a.rounds > b.rounds;
+    return a.time < b.time;
+}
+
+inline Result search(size_t numCandidates, const CostFunction &cost, const Options &options) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    Result result;
+    result.numCandidates = numCandidates;
+    result.numEvaluated = 0;
+    result.numFailed = 0;
+    result.trials = 0;
+    result.budgetExhausted = false;
+
+    std::vector<Measurement> measured(numCandidates);
+    std::vector<bool> evaluated(numCandidates, false), failed(numCandidates, false);
+    std::vector<size_t> alive(numCandidates);
+    for (size_t idx = 0; idx < numCandidates; idx++) {
+        Measurement m = {idx, 0.0f, 0, 0};
+        measured[idx] = m;
+        alive[idx] = idx;
+    }
+
+    int eta = std::max(options.eta, 2);
+    int repeats = std::max(options.initialRepeats, 1);
+    for (int round = 0; !alive.empty(); round++) {
+        std::vector<size_t> survivors;
+        for (size_t a = 0; a < alive.size() && !result.budgetExhausted; a++) {
+            double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            if ((options.maxTrials && result.trials + repeats > options.maxTrials) ||
+                (options.maxTimeMs > 0.0 && elapsedMs >= options.maxTimeMs)) {
+                result.budgetExhausted = true;
+                break;
+            }
+            size_t idx = alive[a];
+            float time = 0.0f;
+            bool ok = cost(idx, repeats, time);
+            result.trials += repeats;
+            if (!evaluated[idx]) {
+                evaluated[idx] = true;
+                result.numEvaluated++;
+            }
+            if (!ok) {
+                failed[idx] = true;
+                result.numFailed++;
+                continue;
+            }
+            Measurement &m = measured[idx];
+            m.time = (m.time * m.repeats + time * repeats) / (m.repeats + repeats);
+            m.repeats += repeats;
+            m.rounds = round + 1;
+            survivors.push_back(idx);
+        }
+        if (result.budgetExhausted || survivors.size() <= 1 || repeats * eta > options.maxRepeats) break;
+
+        std::vector<Measurement> roundResults;
+        for (size_t s = 0; s < survivors.size(); s++) roundResults.push_back(measured[survivors[s]]);
+        size_t keep = (roundResults.size() + eta - 1) / eta;
+        std::partial_sort(roundResults.begin(), roundResults.begin() + keep, roundResults.end(), isFaster);
+        alive.clear();
+        for (size_t s = 0; s < keep; s++) alive.push_back(roundResults[s].index);
+        repeats *= eta;
+    }
+
+    for (size_t idx = 0; idx < numCandidates; idx++) {
+        if (evaluated[idx] && !failed[idx] && measured[idx].repeats > 0) result.ranked.push_back(measured[idx]);
+    }
+    std::sort(result.ranked.begin(), result.ranked.end(), isBetterRanked);
+    result.elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return result;
+}
+
+}  // namespace AlgoSearch
@@ -28,12 +28,14 @@
 
 #include <stdio.h>
 #include <algorithm>
+#include <vector>
 
 #include <cuda_runtime.h>
 #include <cublasLt.h>
 
 #include "sample_cublasLt_LtSgemmCustomFind.h"
 #include "helpers.h"
+#include "tuning_db_cublaslt.h"
 
 /* Structure to store information about different run trials */
 typedef struct {
@@ -102,10 +104,6 @@ static void printPerfStructure(const customMatmulPerf_t &perf) {
         perf.wavesCount);
 }
 
-static inline bool time_compare(const customMatmulPerf_t &perf_a, const customMatmulPerf_t &perf_b) {
-    return ((perf_a.status == CUBLAS_STATUS_SUCCESS) && (perf_a.time < perf_b.time));
-}
-
 static cublasStatus_t customMatmulRun(cublasLtHandle_t ltHandle,  // to get the capabilities (required a GPU)
                  cublasLtMatmulDesc_t operationDesc,
                  const void *alpha, /* host or device pointer */
@@ -184,7 +182,32 @@ static cublasStatus_t customMatmulRun(cublasLtHandle_t ltHandle,  // to get the
     return algoStatus;
 }
 
-/// Sample wrapper running through multiple algo and config attributes combination for single precision gemm using cublasLt low-level API
+/// Sets up algo with the configuration of candidate
+static cublasStatus_t initCandidateAlgo(cublasLtHandle_t ltHandle,
+                                        cublasComputeType_t computeType,
+                                        cudaDataType_t scaleType,
+                                        cudaDataType_t Atype,
+                                        cudaDataType_t Btype,
+                                        cudaDataType_t Ctype,
+                                        const AlgoSearch::Candidate &candidate,
+                                        cublasLtMatmulAlgo_t &algo) {
+    cublasStatus_t status = cublasLtMatmulAlgoInit(ltHandle, computeType, scaleType, Atype, Btype, Ctype, Ctype, candidate.algoId, &algo);
+    if (status != CUBLAS_STATUS_SUCCESS) {
+        return status;
+    }
+    checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_TILE_ID, &candidate.tile, sizeof(candidate.tile)));
+    checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_STAGES_ID, &candidate.stages, sizeof(candidate.stages)));
+    checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_CUSTOM_OPTION, &candidate.customOption, sizeof(candidate.customOption)));
+    checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_CTA_SWIZZLING, &candidate.swizzle, sizeof(candidate.swizzle)));
+    checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_SPLITK_NUM, &candidate.splitK, sizeof(candidate.splitK)));
+    checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_REDUCTION_SCHEME, &candidate.reductionScheme, sizeof(candidate.reductionScheme)));
+    return CUBLAS_STATUS_SUCCESS;
+}
+
+/// Sample wrapper searching through the algo and config attributes combinations for single precision gemm using cublasLt low-level API.
+/// Candidates are raced by successive halving within the budget of searchOptions.
+/// When CUBLASLT_TUNING_DB names a tuning database, the search is skipped for problems already in it whose stored algo
+/// still passes cublasLtMatmulAlgoCheck, and the best result is recorded otherwise.
 void LtSgemmCustomFind(cublasLtHandle_t ltHandle,
                       cublasOperation_t transa,
                       cublasOperation_t transb,
@@ -200,7 +223,8 @@ void LtSgemmCustomFind(cublasLtHandle_t ltHandle,
                       float *C,
                       int ldc,
                       void *workSpace,
-                      size_t workSpaceSize) {
+                      size_t workSpaceSize,
+                      const AlgoSearch::Options &searchOptions) {
     cublasStatus_t status = CUBLAS_STATUS_SUCCESS;
     cublasLtMatmulDesc_t operationDesc = NULL;
     cublasLtMatrixLayout_t Adesc = NULL, Bdesc = NULL, Cdesc = NULL;
@@ -209,17 +233,18 @@ void LtSgemmCustomFind(cublasLtHandle_t ltHandle,
     cudaStream_t stream = NULL;
     // SplitK value that we are going to try when SplitK is supported for a given algo
     const int splitKSequenceA[] = {2, 3, 4, 5, 6, 8, 12, 16, 32};
-     // Let try a fixed number of combinations
-    #define ALGO_COMBINATIONS 100
-    int AlgoCombinations = ALGO_COMBINATIONS;
-    int AlgoCount = 0;
-    int kernelRepeats = 10; //number of time the CUDA kernels will be run back to back
-    customMatmulPerf_t perfResults[ALGO_COMBINATIONS];
+    // Number of best results printed
+    const size_t printedResults = 20;
     int nbAlgoIds = 0;
-    #define ALGO_IDS 4
+    #define ALGO_IDS 100
     int algoIdA[ALGO_IDS];
     cudaDataType_t scaleType = CUDA_R_32F, Atype = CUDA_R_32F, Btype = CUDA_R_32F, Ctype = CUDA_R_32F;
     cublasComputeType_t computeType = CUBLAS_COMPUTE_32F;
+
+    const char *databasePath = TuningDb::getDatabasePath();
+    bool staleEntry = false;
+    TuningDb::ProblemKey problemKey = TuningDb::makeProblemKey(transa, transb, m, n, k, lda, ldb, ldc, Atype, Btype,
+        Ctype, Ctype, scaleType, computeType, CUBLASLT_EPILOGUE_DEFAULT);
     // create operation desciriptor; see cublasLtMatmulDescAttributes_t for details about defaults; here we just need to
     // set the transforms for A and B
     checkCublasStatus(cublasLtMatmulDescCreate(&operationDesc, CUBLAS_COMPUTE_32F, CUDA_R_32F));
@@ -230,16 +255,44 @@ void LtSgemmCustomFind(cublasLtHandle_t ltHandle,
     checkCublasStatus(cublasLtMatrixLayoutCreate(&Adesc, CUDA_R_32F, transa == CUBLAS_OP_N ? m : k, transa == CUBLAS_OP_N ? k : m, lda));
     checkCublasStatus(cublasLtMatrixLayoutCreate(&Bdesc, CUDA_R_32F, transb == CUBLAS_OP_N ? k : n, transb == CUBLAS_OP_N ? n : k, ldb));
     checkCublasStatus(cublasLtMatrixLayoutCreate(&Cdesc, CUDA_R_32F, m, n, ldc));
+
+    // A stored algo is reused only if it still passes cublasLtMatmulAlgoCheck for this handle, these layouts and the
+    // workspace at hand; otherwise the search runs and its result replaces the entry
+    if (databasePath) {
+        TuningDb::MappedDatabase database;
+        const TuningDb::Entry *entry = database.open(databasePath) ? database.find(problemKey) : NULL;
+        customMatmulPerf_t storedPerf = customMatmulPerf_t();
+        cublasLtMatmulHeuristicResult_t storedResult;
+        if (entry && TuningDb::initAlgo(ltHandle, problemKey, entry->config, storedPerf.algo) == CUBLAS_STATUS_SUCCESS &&
+            cublasLtMatmulAlgoCheck(ltHandle, operationDesc, Adesc, Bdesc, Cdesc, Cdesc, &storedPerf.algo, &storedResult) == CUBLAS_STATUS_SUCCESS &&
+            storedResult.workspaceSize <= workSpaceSize) {
+            storedPerf.time = entry->time;
+            storedPerf.workspaceSize = storedResult.workspaceSize;
+            storedPerf.wavesCount = storedResult.wavesCount;
+            printf("found in tuning database %s, skipping the search : ", databasePath);
+            printPerfStructure(storedPerf);
+            checkCublasStatus(cublasLtMatrixLayoutDestroy(Cdesc));
+            checkCublasStatus(cublasLtMatrixLayoutDestroy(Bdesc));
+            checkCublasStatus(cublasLtMatrixLayoutDestroy(Adesc));
+            checkCublasStatus(cublasLtMatmulDescDestroy(operationDesc));
+            return;
+        }
+        if (entry) {
+            printf("tuning database entry of %s is not usable for this problem, searching\n", databasePath);
+            staleEntry = true;
+        }
+    }
     
-    // Request the 4 first AlgoId available for SGEMM ( computeType = scaleType = Atype = Btype = Ctype = Dtype = CUDA_R_32F)
+    // Request the AlgoIds available for SGEMM ( computeType = scaleType = Atype = Btype = Ctype = Dtype = CUDA_R_32F)
     checkCublasStatus(cublasLtMatmulAlgoGetIds(ltHandle, computeType, scaleType, Atype, Btype, Ctype, Ctype, ALGO_IDS, algoIdA, &nbAlgoIds));
     
     // Create CUDA event to time the execution time of each algo    
     checkCudaStatus(cudaEventCreate(&startEvent, cudaEventBlockingSync));
     checkCudaStatus(cudaEventCreate(&stopEvent, cudaEventBlockingSync));
 
-    // Loop over the Algo IDs
-    for (int idx = 0; (idx < nbAlgoIds) && (AlgoCount < AlgoCombinations); idx++) {   
+    // Query the capabilities of each Algo ID
+    std::vector<AlgoSearch::AlgoCaps> algoCaps;
+    for (int idx = 0; idx < nbAlgoIds; idx++) {   
         cublasLtMatmulAlgo_t algo;
         size_t sizeWritten = 0;
         /* Initialize algo structure with given Algp ID */
@@ -247,121 +300,88 @@ void LtSgemmCustomFind(cublasLtHandle_t ltHandle,
         if (status != CUBLAS_STATUS_SUCCESS) {
             continue;
         }
+        AlgoSearch::AlgoCaps caps;
+        caps.algoId = algoIdA[idx];
         // Query the tiles enums supported by that algo
         checkCublasStatus(cublasLtMatmulAlgoCapGetAttribute(&algo, CUBLASLT_ALGO_CAP_TILE_IDS, NULL, 0, &sizeWritten));
         int nbTiles = int(sizeWritten/sizeof(int));
-        int *tileA = new int[ nbTiles == 0 ? 1:nbTiles];
-        if(nbTiles == 0){
-            tileA[0] = CUBLASLT_MATMUL_TILE_UNDEFINED;
-            nbTiles = 1;
+        if (nbTiles == 0) {
+            caps.tiles.assign(1, CUBLASLT_MATMUL_TILE_UNDEFINED);
+        } else {
+            caps.tiles.resize(nbTiles);
+            checkCublasStatus(cublasLtMatmulAlgoCapGetAttribute(&algo, CUBLASLT_ALGO_CAP_TILE_IDS, caps.tiles.data(), sizeof(int)*nbTiles, &sizeWritten));
         }
         
         checkCublasStatus(cublasLtMatmulAlgoCapGetAttribute(&algo, CUBLASLT_ALGO_CAP_STAGES_IDS, NULL, 0, &sizeWritten));
         int nbStages = int(sizeWritten/sizeof(int));
-        std::vector<int> stagesA(nbStages == 0 ? 1 : nbStages);
         if (nbStages == 0) {
-            stagesA[0] = CUBLASLT_MATMUL_STAGES_UNDEFINED;
-            nbStages = 1;
+            caps.stages.assign(1, CUBLASLT_MATMUL_STAGES_UNDEFINED);
         } else {
-            checkCublasStatus(cublasLtMatmulAlgoCapGetAttribute(&algo, CUBLASLT_ALGO_CAP_STAGES_IDS, stagesA.data(), sizeof(int)*nbStages, &sizeWritten));
+            caps.stages.resize(nbStages);
+            checkCublasStatus(cublasLtMatmulAlgoCapGetAttribute(&algo, CUBLASLT_ALGO_CAP_STAGES_IDS, caps.stages.data(), sizeof(int)*nbStages, &sizeWritten));
         }
 
-        int splitkSupport, redMask, swizzlingMax, customOptionMax;
-        // Retrieve Algo Capabilities attributes to be able to setup loop over the different combinations
-        cublasLtMatmulAlgoCapGetAttribute(&algo, CUBLASLT_ALGO_CAP_TILE_IDS, tileA, sizeof(int)*nbTiles, &sizeWritten);
+        int splitkSupport, redMask;
+        // Retrieve Algo Capabilities attributes to be able to enumerate the different combinations
         cublasLtMatmulAlgoCapGetAttribute(&algo, CUBLASLT_ALGO_CAP_SPLITK_SUPPORT, &splitkSupport, sizeof(splitkSupport), &sizeWritten);
         cublasLtMatmulAlgoCapGetAttribute(&algo, CUBLASLT_ALGO_CAP_REDUCTION_SCHEME_MASK, &redMask, sizeof(redMask), &sizeWritten);
-        cublasLtMatmulAlgoCapGetAttribute(&algo, CUBLASLT_ALGO_CAP_CTA_SWIZZLING_SUPPORT, &swizzlingMax, sizeof(swizzlingMax), &sizeWritten);        
-        cublasLtMatmulAlgoCapGetAttribute(&algo, CUBLASLT_ALGO_CAP_CUSTOM_OPTION_MAX, &customOptionMax, sizeof(customOptionMax), &sizeWritten);
-        
-        /* Loop over the different tiles */
-        for (int tileIdx = 0; tileIdx < nbTiles; tileIdx++) {
-            /* Loop over different stages count */
-            for (int stagesIdx = 0; stagesIdx < nbStages; stagesIdx++) {
-                checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_STAGES_ID, &stagesA[stagesIdx], sizeof(stagesA[stagesIdx])));
-                /* loop over the different custom option if any */
-                for (int customOption = 0; customOption <= customOptionMax; customOption++) {
-                    checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_CUSTOM_OPTION, &customOption, sizeof(customOption)));
-                    /* loop over the CTAs swizzling support */
-                    for (int k = 0; k <= swizzlingMax; k++) {
-                        int splitK_trial = 0;
-                        if (splitkSupport) {
-                            splitK_trial += sizeof(splitKSequenceA) / sizeof(splitKSequenceA[0]);
-                        }
-                        // Loop over the splitK value over a fixed sequence splitKSequenceA in addtion to the case where splitK is not enabled
-                        for (int l = 0; (l < (1 + splitK_trial)) && (AlgoCount < AlgoCombinations); l++) {
-                            /* Setup attribute of the algo to run */
-                            checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_TILE_ID, &tileA[tileIdx], sizeof(tileA[tileIdx])));
-                            int splitK_val = 0;
-                            int redScheme = CUBLASLT_REDUCTION_SCHEME_NONE;
-                            checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_SPLITK_NUM, &splitK_val, sizeof(splitK_val)));
-                            checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_CTA_SWIZZLING, &k, sizeof(k)));
-                            checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_REDUCTION_SCHEME, &redScheme, sizeof(int)));
-                                                                            
-                            if (l > 0) { // Split-K case
-                                splitK_val = splitKSequenceA[l - 1];
-                                checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_SPLITK_NUM, &splitKSequenceA[l - 1], sizeof(splitKSequenceA[l - 1])));
-                                /* Going over all the reduction scheme  */
-                                for (redScheme = 1 ; redScheme < (int)CUBLASLT_REDUCTION_SCHEME_MASK && (AlgoCount < AlgoCombinations); redScheme = redScheme << 1) {
-                                    if (redScheme & redMask) {
-                                        checkCublasStatus(cublasLtMatmulAlgoConfigSetAttribute(&algo, CUBLASLT_ALGO_CONFIG_REDUCTION_SCHEME, &redScheme, sizeof(redScheme)));
-                                        
-                                        status = customMatmulRun( ltHandle,
-                                                                operationDesc,
-                                                                alpha, /* host or device pointer */
-                                                                A, Adesc,
-                                                                B, Bdesc,
-                                                                beta, /* host or device pointer */
-                                                                C, Cdesc,
-                                                                C, Cdesc,
-                                                                algo,
-                                                                kernelRepeats,  
-                                                                workSpace,
-                                                                workSpaceSize,                 
-                                                                perfResults[AlgoCount],
-                                                                stream,
-                                                                startEvent, stopEvent);
-                                        perfResults[AlgoCount].status = status;
-                                        if (status == CUBLAS_STATUS_SUCCESS) AlgoCount++;
-                                                                    
-                                    } // end if
-                                } // end for
-                            } else { // Non-splitK case
-                                /* if user preference is ok with workspace */
-                                if (AlgoCount < AlgoCombinations) {       
-                                    status = customMatmulRun( ltHandle,
-                                                            operationDesc,
-                                                            alpha, /* host or device pointer */
-                                                            A, Adesc,
-                                                            B, Bdesc,
-                                                            beta, /* host or device pointer */
-                                                            C, Cdesc,
-                                                            C, Cdesc,
-                                                            algo,
-                                                            kernelRepeats,  
-                                                            workSpace,
-                                                            workSpaceSize,                 
-                                                            perfResults[AlgoCount],
-                                                            stream,
-                                                            startEvent, stopEvent);
-                                    perfResults[AlgoCount].status = status;
-                                    if (status == CUBLAS_STATUS_SUCCESS) AlgoCount++;
-                                }
-                            }
-                        }  // end l
-                    }  // end k
-                } //end customOption
-            } // end stagesIdx
-        } // end tileIdx
-        delete [] tileA;
-    } // end idx
-    
-    // Sort the results per run duration 
-    std::sort(perfResults, perfResults + AlgoCount, time_compare);
-    // Print timing and perf details 
-    for (int i = 0; i < AlgoCount; i++) {                
-        printf( "result %03d : ", i);
-        printPerfStructure(perfResults[i]);                          
+        cublasLtMatmulAlgoCapGetAttribute(&algo, CUBLASLT_ALGO_CAP_CTA_SWIZZLING_SUPPORT, &caps.swizzlingMax, sizeof(caps.swizzlingMax), &sizeWritten);        
+        cublasLtMatmulAlgoCapGetAttribute(&algo, CUBLASLT_ALGO_CAP_CUSTOM_OPTION_MAX, &caps.customOptionMax, sizeof(caps.customOptionMax), &sizeWritten);
+        caps.splitkSupport = splitkSupport != 0;
+        caps.reductionMask = redMask & CUBLASLT_REDUCTION_SCHEME_MASK;
+        algoCaps.push_back(caps);
+    }
+
+    std::vector<AlgoSearch::Candidate> candidates = AlgoSearch::enumerateCandidates(
+        algoCaps,
+        std::vector<int>(splitKSequenceA, splitKSequenceA + sizeof(splitKSequenceA) / sizeof(splitKSequenceA[0])),
+        searchOptions.maxCandidates);
+    std::vector<customMatmulPerf_t> perfResults(candidates.size(), customMatmulPerf_t());
+
+    // Time repeats back to back runs of a candidate
+    AlgoSearch::CostFunction cost = [&](size_t index, int repeats, float &time) {
+        cublasLtMatmulAlgo_t algo;
+        cublasStatus_t runStatus = initCandidateAlgo(ltHandle, computeType, scaleType, Atype, Btype, Ctype, candidates[index], algo);
+        if (runStatus == CUBLAS_STATUS_SUCCESS) {
+            runStatus = customMatmulRun( ltHandle,
+                                         operationDesc,
+                                         alpha, /* host or device pointer */
+                                         A, Adesc,
+                                         B, Bdesc,
+                                         beta, /* host or device pointer */
+                                         C, Cdesc,
+                                         C, Cdesc,
+                                         algo,
+                                         repeats,
+                                         workSpace,
+                                         workSpaceSize,
+                                         perfResults[index],
+                                         stream,
+                                         startEvent, stopEvent);
+        }
+        perfResults[index].status = runStatus;
+        time = perfResults[index].time / repeats;
+        return runStatus == CUBLAS_STATUS_SUCCESS;
+    };
+    AlgoSearch::Result result = AlgoSearch::search(candidates.size(), cost, searchOptions);
+
+    printf("searched %d algo ids: %zu candidates, %zu timed (%zu failed), %lld kernel runs, %.1f ms%s\n",
+        (int)algoCaps.size(), result.numCandidates, result.numEvaluated, result.numFailed,
+        result.trials, result.elapsedMs, result.budgetExhausted ? " (budget exhausted)" : "");
+    // Print timing (per run) and perf details of the best candidates
+    for (size_t i = 0; i < result.ranked.size() && i < printedResults; i++) {
+        customMatmulPerf_t &perf = perfResults[result.ranked[i].index];
+        perf.time = result.ranked[i].time;
+        printf( "result %03d : runs=%d ", (int)i, result.ranked[i].repeats);
+        printPerfStructure(perf);
+    }
+
+    if (databasePath && !result.ranked.empty()) {
+        const customMatmulPerf_t &best = perfResults[result.ranked[0].index];
+        if (!TuningDb::recordResult(databasePath, problemKey, best.algo, result.ranked[0].time, best.workspaceSize,
+                                    staleEntry)) {
+            printf("unable to write tuning database %s\n", databasePath);
+        }
     }
 
     // descriptors are no longer needed as all GPU work was already enqueued
@@ -373,3 +393,23 @@ void LtSgemmCustomFind(cublasLtHandle_t ltHandle,
     if (startEvent) checkCudaStatus(cudaEventDestroy(startEvent));
     if (stopEvent) checkCudaStatus(cudaEventDestroy(stopEvent));
 }
+
+void LtSgemmCustomFind(cublasLtHandle_t ltHandle,
+                      cublasOperation_t transa,
+                      cublasOperation_t transb,
+                      int m,
+                      int n,
+                      int k,
+                      const float *alpha, /* host pointer */
+                      const float *A,
+                      int lda,
+                      const float *B,
+                      int ldb,
+                      const float *beta, /* host pointer */
+                      float *C,
+                      int ldc,
+                      void *workSpace,
+                      size_t workSpaceSize) {
+    LtSgemmCustomFind(ltHandle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, workSpace, workSpaceSize,
+                      AlgoSearch::getDefaultOptions());
+}
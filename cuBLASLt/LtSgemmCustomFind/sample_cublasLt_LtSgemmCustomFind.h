@@ -28,6 +28,8 @@
 
 #include <cublasLt.h>
 
+#include "algo_search.h"
+
 void LtSgemmCustomFind(cublasLtHandle_t ltHandle,
                        cublasOperation_t transa,
                        cublasOperation_t transb,
@@ -44,3 +46,22 @@ void LtSgemmCustomFind(cublasLtHandle_t ltHandle,
                        int ldc,
                        void *workSpace,
                        size_t workSpaceSize);
+
+/// Same as above, with the search budget and elimination schedule of searchOptions
+void LtSgemmCustomFind(cublasLtHandle_t ltHandle,
+                       cublasOperation_t transa,
+                       cublasOperation_t transb,
+                       int m,
+                       int n,
+                       int k,
+                       const float *alpha, /* host pointer */
+                       const float *A,
+                       int lda,
+                       const float *B,
+                       int ldb,
+                       const float *beta, /* host pointer */
+                       float *C,
+                       int ldc,
+                       void *workSpace,
+                       size_t workSpaceSize,
+                       const AlgoSearch::Options &searchOptions);
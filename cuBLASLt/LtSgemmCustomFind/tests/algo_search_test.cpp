@@ -0,0 +1,295 @@
+/*
+ * Checks the algo search on the host with a mocked cost function: the
+ * round-robin order of enumerateCandidates, the successive halving schedule
+ * of search, the dropping of failed candidates and the trial and wall time
+ * budgets.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "algo_search.h"
+#include "test_check.h"
+
+namespace {
+
+using namespace AlgoSearch;
+
+/* Mock whose candidate idx runs in times[idx] per kernel run, and fails on
+ * the calls listed in failAt (index, number of the call to that index) */
+struct MockCost {
+    std::vector<float> times;
+    std::vector<std::pair<size_t, int> > failAt;
+    std::vector<std::pair<size_t, int> > calls;  // index, repeats
+
+    bool operator()(size_t idx, int repeats, float &time) {
+        int previous = 0;
+        for (size_t c = 0; c < calls.size(); c++) previous += calls[c].first == idx;
+        calls.push_back(std::make_pair(idx, repeats));
+        for (size_t f = 0; f < failAt.size(); f++) {
+            if (failAt[f].first == idx && failAt[f].second == previous) return false;
+        }
+        time = times[idx];
+        return true;
+    }
+};
+
+Options noBudget() {
+    Options options = getDefaultOptions();
+    options.maxTimeMs = 0.0;
+    return options;
+}
+
+AlgoCaps makeCaps(int algoId, int numTiles, int numStages, bool splitk, int reductionMask, int swizzlingMax,
+                  int customOptionMax) {
+    AlgoCaps caps;
+    caps.algoId = algoId;
+    for (int t = 0; t < numTiles; t++) caps.tiles.push_back(10 + t);
+    for (int s = 0; s < numStages; s++) caps.stages.push_back(20 + s);
+    caps.splitkSupport = splitk;
+    caps.reductionMask = reductionMask;
+    caps.swizzlingMax = swizzlingMax;
+    caps.customOptionMax = customOptionMax;
+    return caps;
+}
+
+bool sameCandidate(const Candidate &a, const Candidate &b) {
+    return a.algoId == b.algoId && a.tile == b.tile && a.stages == b.stages && a.customOption == b.customOption &&
+           a.swizzle == b.swizzle && a.splitK == b.splitK && a.reductionScheme == b.reductionScheme;
+}
+
+void testEnumerateCandidates() {
+    std::vector<AlgoCaps> algos;
+    algos.push_back(makeCaps(7, 2, 1, false, 0, 0, 0));  // 2 configurations
+    algos.push_back(makeCaps(3, 1, 2, true, 5, 0, 0));   // 2 * (1 + 2 split-K * 2 schemes) = 10
+    algos.push_back(makeCaps(5, 1, 1, false, 0, 1, 1));  // 2 custom options * 2 swizzles = 4
+    std::vector<int> splitKSequence;
+    splitKSequence.push_back(2);
+    splitKSequence.push_back(4);
+
+    std::vector<Candidate> candidates = enumerateCandidates(algos, splitKSequence, 0);
+    CHECK(candidates.size() == 16);
+
+    // Round-robin: rank 0 of every algo ID, then rank 1, ... skipping the
+    // algo IDs which ran out of configurations
+    const int expectedIds[] = {7, 3, 5, 7, 3, 5, 3, 5, 3, 5, 3, 3, 3, 3, 3, 3};
+    for (size_t c = 0; c < candidates.size() && c < 16; c++) CHECK(candidates[c].algoId == expectedIds[c]);
+
+    // Within an algo ID, the order of the nested loops of the sample
+    std::vector<Candidate> algo3;
+    for (size_t c = 0; c < candidates.size(); c++) {
+        if (candidates[c].algoId == 3) algo3.push_back(candidates[c]);
+    }
+    CHECK(algo3.size() == 10);
+    const int expected3[10][3] = {{20, 0, 0}, {20, 2, 1}, {20, 2, 4}, {20, 4, 1}, {20, 4, 4},
+                                  {21, 0, 0}, {21, 2, 1}, {21, 2, 4}, {21, 4, 1}, {21, 4, 4}};
+    for (size_t c = 0; c < algo3.size() && c < 10; c++) {
+        CHECK(algo3[c].tile == 10);
+        CHECK(algo3[c].stages == expected3[c][0]);
+        CHECK(algo3[c].splitK == expected3[c][1]);
+        CHECK(algo3[c].reductionScheme == expected3[c][2]);
+    }
+    std::vector<Candidate> algo5;
+    for (size_t c = 0; c < candidates.size(); c++) {
+        if (candidates[c].algoId == 5) algo5.push_back(candidates[c]);
+    }
+    CHECK(algo5.size() == 4);
+    for (size_t c = 0; c < algo5.size() && c < 4; c++) {
+        CHECK(algo5[c].customOption == (int)c / 2);
+        CHECK(algo5[c].swizzle == (int)c % 2);
+        CHECK(algo5[c].splitK == 0 && algo5[c].reductionScheme == 0);
+    }
+
+    // A truncated list is a prefix of the full one, and covers every algo
+    // ID as soon as it has room for them
+    std::vector<Candidate> truncated = enumerateCandidates(algos, splitKSequence, 5);
+    CHECK(truncated.size() == 5);
+    for (size_t c = 0; c < truncated.size(); c++) CHECK(sameCandidate(truncated[c], candidates[c]));
+    truncated = enumerateCandidates(algos, splitKSequence, 3);
+    CHECK(truncated.size() == 3);
+    CHECK(truncated.size() == 3 && truncated[0].algoId == 7 && truncated[1].algoId == 3 && truncated[2].algoId == 5);
+    CHECK(enumerateCandidates(algos, splitKSequence, 100).size() == 16);
+    CHECK(enumerateCandidates(std::vector<AlgoCaps>(), splitKSequence, 0).empty());
+}
+
+void testSuccessiveHalving() {
+    // Candidate idx runs in (idx * 7) % 10 + 1 units: 1, 8, 5, 2, 9, 6, 3, 10, 7, 4
+    MockCost mock;
+    for (size_t idx = 0; idx < 10; idx++) mock.times.push_back((float)((idx * 7) % 10 + 1));
+    Options options = noBudget();
+    options.initialRepeats = 2;
+    options.maxRepeats = 32;
+    options.eta = 2;
+    Result result = search(10, std::ref(mock), options);
+
+    // Rounds of 10, 5, 3, 2 and 1 candidates with 2, 4, 8, 16 and 32 repeats,
+    // each round keeping the fastest ceil(n / eta)
+    const int roundSizes[] = {10, 5, 3, 2, 1};
+    const float roundSlowest[] = {10, 5, 3, 2, 1};
+    CHECK(mock.calls.size() == 21);
+    size_t call = 0;
+    long long trials = 0;
+    for (int round = 0; round < 5; round++) {
+        for (int c = 0; c < roundSizes[round] && call < mock.calls.size(); c++, call++) {
+            CHECK(mock.calls[call].second == 2 << round);
+            CHECK(mock.times[mock.calls[call].first] <= roundSlowest[round]);
+            trials += mock.calls[call].second;
+        }
+    }
+    CHECK(result.trials == trials);
+    CHECK(result.numCandidates == 10);
+    CHECK(result.numEvaluated == 10);
+    CHECK(result.numFailed == 0);
+    CHECK(!result.budgetExhausted);
+
+    // Ranked by rounds survived, then by time
+    CHECK(result.ranked.size() == 10);
+    const int expectedRounds[] = {5, 4, 3, 2, 2, 1, 1, 1, 1, 1};
+    for (size_t r = 0; r < result.ranked.size() && r < 10; r++) {
+        CHECK(result.ranked[r].time == (float)(r + 1));
+        CHECK(result.ranked[r].rounds == expectedRounds[r]);
+        CHECK(result.ranked[r].repeats == (2 << expectedRounds[r]) - 2);
+    }
+
+    // No round may exceed maxRepeats: with 20, the 16-repeat round is the last
+    mock.calls.clear();
+    options.maxRepeats = 20;
+    result = search(10, std::ref(mock), options);
+    CHECK(mock.calls.size() == 20);
+    CHECK(result.ranked.size() == 10 && result.ranked[0].rounds == 4);
+
+    // eta = 3 keeps ceil(n / 3): 10, 4, 2 candidates at 1, 3, 9 repeats
+    mock.calls.clear();
+    options.initialRepeats = 1;
+    options.maxRepeats = 9;
+    options.eta = 3;
+    result = search(10, std::ref(mock), options);
+    CHECK(mock.calls.size() == 16);
+    CHECK(result.trials == 10 * 1 + 4 * 3 + 2 * 9);
+    CHECK(result.ranked.size() == 10 && result.ranked[0].time == 1.0f && result.ranked[1].time == 2.0f);
+    CHECK(result.ranked.size() == 10 && result.ranked[0].rounds == 3 && result.ranked[1].rounds == 3);
+}
+
+void testAveraging() {
+    // The time of a candidate is the average over all its kernel runs; it
+    // still ranks first for surviving more rounds though it ends up slower
+    struct {
+        bool operator()(size_t idx, int repeats, float &time) const {
+            time = idx == 0 ? (repeats == 2 ? 1.0f : 4.0f) : 2.0f;
+            return true;
+        }
+    } cost;
+    Options options = noBudget();
+    options.initialRepeats = 2;
+    options.maxRepeats = 4;
+    options.eta = 2;
+    Result result = search(2, cost, options);
+    CHECK(result.ranked.size() == 2);
+    CHECK(result.ranked[0].index == 0);
+    CHECK(result.ranked[0].repeats == 6);
+    CHECK(std::fabs(result.ranked[0].time - (2 * 1.0f + 4 * 4.0f) / 6) < 1e-6f);
+}
+
+void testFailedCandidates() {
+    MockCost mock;
+    for (size_t idx = 0; idx < 8; idx++) mock.times.push_back((float)(idx + 1));
+    mock.failAt.push_back(std::make_pair((size_t)0, 0));  // the fastest cannot run
+    mock.failAt.push_back(std::make_pair((size_t)1, 1));  // fails in the second round
+    Options options = noBudget();
+    options.initialRepeats = 1;
+    options.maxRepeats = 64;
+    options.eta = 2;
+    Result result = search(8, std::ref(mock), options);
+
+    CHECK(result.numEvaluated == 8);
+    CHECK(result.numFailed == 2);
+    for (size_t r = 0; r < result.ranked.size(); r++) {
+        CHECK(result.ranked[r].index != 0 && result.ranked[r].index != 1);
+    }
+    CHECK(result.ranked.size() == 6);
+    // Round 0 keeps 1, 2, 3 and 4 of the 7 that ran; 1 fails in round 1,
+    // which keeps 2 and 3, and round 2 picks 2
+    CHECK(!result.ranked.empty() && result.ranked[0].index == 2);
+    int callsTo0 = 0, callsTo1 = 0;
+    for (size_t c = 0; c < mock.calls.size(); c++) {
+        callsTo0 += mock.calls[c].first == 0;
+        callsTo1 += mock.calls[c].first == 1;
+    }
+    CHECK(callsTo0 == 1);
+    CHECK(callsTo1 == 2);
+
+    // All candidates failing leaves nothing ranked
+    MockCost failing;
+    failing.times.assign(4, 1.0f);
+    for (size_t idx = 0; idx < 4; idx++) failing.failAt.push_back(std::make_pair(idx, 0));
+    result = search(4, std::ref(failing), options);
+    CHECK(result.ranked.empty());
+    CHECK(result.numFailed == 4);
+    CHECK(failing.calls.size() == 4);
+}
+
+void testTrialBudget() {
+    MockCost mock;
+    for (size_t idx = 0; idx < 10; idx++) mock.times.push_back((float)(10 - idx));
+    Options options = noBudget();
+    options.initialRepeats = 2;
+    options.maxRepeats = 32;
+    options.eta = 2;
+    options.maxTrials = 25;
+    Result result = search(10, std::ref(mock), options);
+
+    // 10 * 2 trials, then one 4-repeat run fits, a second would need 28
+    CHECK(result.trials == 24);
+    CHECK(mock.calls.size() == 11);
+    CHECK(result.budgetExhausted);
+    CHECK(result.numEvaluated == 10);
+    CHECK(result.ranked.size() == 10);
+    CHECK(!result.ranked.empty() && result.ranked[0].rounds == 2 && result.ranked[0].index == 9);
+
+    // A budget smaller than the first round stops in the middle of it
+    mock.calls.clear();
+    options.maxTrials = 7;
+    result = search(10, std::ref(mock), options);
+    CHECK(result.trials == 6);
+    CHECK(mock.calls.size() == 3);
+    CHECK(result.numEvaluated == 3);
+    CHECK(result.budgetExhausted);
+}
+
+void testTimeBudget() {
+    // Every kernel run takes 5 ms of wall time
+    struct {
+        int calls;
+        bool operator()(size_t, int, float &time) {
+            calls++;
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(5);
+            while (std::chrono::steady_clock::now() < end) {
+            }
+            time = 1.0f;
+            return true;
+        }
+    } cost;
+    cost.calls = 0;
+    Options options = getDefaultOptions();
+    options.maxTimeMs = 20.0;
+    Result result = search(100, std::ref(cost), options);
+    CHECK(result.budgetExhausted);
+    CHECK(cost.calls >= 4);
+    CHECK(cost.calls < 100);
+    CHECK(result.numEvaluated == (size_t)cost.calls);
+    CHECK(result.elapsedMs >= 20.0);
+}
+
+}  // namespace
+
+int main() {
+    testEnumerateCandidates();
+    testSuccessiveHalving();
+    testAveraging();
+    testFailedCandidates();
+    testTrialBudget();
+    testTimeBudget();
+    return test_result("algo_search_test");
+}
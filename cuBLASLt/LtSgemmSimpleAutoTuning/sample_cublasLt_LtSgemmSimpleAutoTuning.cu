@@ -35,6 +35,7 @@
 
 #include "sample_cublasLt_LtSgemmSimpleAutoTuning.h"
 #include "helpers.h"
+#include "tuning_db_cublaslt.h"
 
 float median(std::vector<float>& times) {
     const size_t size = times.size();
@@ -59,6 +60,9 @@ float median(std::vector<float>& times) {
 /// pointer mode is always host, to change it configure the appropriate matmul descriptor attribute
 /// matmul is not using cublas handle's configuration of math mode, here tensor ops are implicitly allowed; to change
 /// this configure appropriate attribute in the preference handle
+///
+/// when CUBLASLT_TUNING_DB names a tuning database, a result stored for the same problem is reused instead of the
+/// heuristics, the result for the closest shape is timed along with them, and the best algo is recorded
 void LtSgemmSimpleAutoTuning(cublasLtHandle_t ltHandle,
                              cublasOperation_t transa,
                              cublasOperation_t transb,
@@ -116,6 +120,39 @@ void LtSgemmSimpleAutoTuning(cublasLtHandle_t ltHandle,
         checkCublasStatus(CUBLAS_STATUS_NOT_SUPPORTED);
     }
 
+    std::vector<cublasLtMatmulAlgo_t> candidateAlgos;
+    std::vector<size_t> candidateWorkspaceSizes;
+    for (int algoIdx = 0; algoIdx < returnedResults; algoIdx++) {
+        candidateAlgos.push_back(heuristicResult[algoIdx].algo);
+        candidateWorkspaceSizes.push_back(heuristicResult[algoIdx].workspaceSize);
+    }
+
+    const char *databasePath = TuningDb::getDatabasePath();
+    bool staleEntry = false;
+    TuningDb::ProblemKey problemKey = TuningDb::makeProblemKey(transa, transb, m, n, k, lda, ldb, ldc, CUDA_R_32F,
+        CUDA_R_32F, CUDA_R_32F, CUDA_R_32F, CUDA_R_32F, CUBLAS_COMPUTE_32F, CUBLASLT_EPILOGUE_DEFAULT);
+    if (databasePath) {
+        TuningDb::MappedDatabase database;
+        bool exact = false;
+        const TuningDb::Entry *entry = database.open(databasePath) ? database.lookup(problemKey, exact) : NULL;
+        cublasLtMatmulAlgo_t storedAlgo;
+        cublasLtMatmulHeuristicResult_t storedResult;
+        if (entry && TuningDb::initAlgo(ltHandle, problemKey, entry->config, storedAlgo) == CUBLAS_STATUS_SUCCESS &&
+            cublasLtMatmulAlgoCheck(ltHandle, operationDesc, Adesc, Bdesc, Cdesc, Cdesc, &storedAlgo, &storedResult) == CUBLAS_STATUS_SUCCESS &&
+            storedResult.workspaceSize <= workspaceSize) {
+            printf("%s tuning database entry for %dx%dx%d\n", exact ? "using" : "also timing the nearest", entry->key.m, entry->key.n, entry->key.k);
+            if (exact) {
+                candidateAlgos.clear();
+                candidateWorkspaceSizes.clear();
+            }
+            candidateAlgos.push_back(storedAlgo);
+            candidateWorkspaceSizes.push_back(storedResult.workspaceSize);
+        } else if (entry && exact) {
+            // the stored algo fails the check for this handle or workspace, let the heuristics replace it
+            staleEntry = true;
+        }
+    }
+
     checkCudaStatus(cudaStreamCreate(&stream));
     checkCudaStatus(cudaEventCreate(&startEvent));
     checkCudaStatus(cudaEventCreate(&stopEvent));
@@ -123,7 +160,7 @@ void LtSgemmSimpleAutoTuning(cublasLtHandle_t ltHandle,
     constexpr int repeatAlgoCheck = 5;
     std::vector<float> algoTimes(repeatAlgoCheck);
 
-    for (int algoIdx = 0; algoIdx < returnedResults; algoIdx++) {
+    for (int algoIdx = 0; algoIdx < (int)candidateAlgos.size(); algoIdx++) {
         for (int checkIdx = 0; checkIdx < repeatAlgoCheck; checkIdx++) {
             checkCudaStatus(cudaEventRecord(startEvent, stream));
 
@@ -139,7 +176,7 @@ void LtSgemmSimpleAutoTuning(cublasLtHandle_t ltHandle,
                                             Cdesc,
                                             C,
                                             Cdesc,
-                                            &heuristicResult[algoIdx].algo,
+                                            &candidateAlgos[algoIdx],
                                             workspace,
                                             workspaceSize,
                                             stream));
@@ -158,7 +195,12 @@ void LtSgemmSimpleAutoTuning(cublasLtHandle_t ltHandle,
         }
     }
 
-    memcpy(&algo, &heuristicResult[bestAlgoIdx].algo, sizeof(algo));
+    memcpy(&algo, &candidateAlgos[bestAlgoIdx], sizeof(algo));
+
+    if (databasePath && !TuningDb::recordResult(databasePath, problemKey, algo, bestAlgoTime, candidateWorkspaceSizes[bestAlgoIdx],
+                                                staleEntry)) {
+        printf("unable to write tuning database %s\n", databasePath);
+    }
 
     // descriptors are no longer needed as all GPU work was already enqueued
     if (preference) checkCublasStatus(cublasLtMatmulPreferenceDestroy(preference));
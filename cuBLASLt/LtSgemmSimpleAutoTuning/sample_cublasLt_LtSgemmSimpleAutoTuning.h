@@ -34,6 +34,9 @@
 /// pointer mode is always host, to change it configure the appropriate matmul descriptor attribute
 /// matmul is not using cublas handle's configuration of math mode, here tensor ops are implicitly allowed; to change
 /// this configure appropriate attribute in the preference handle
+///
+/// when CUBLASLT_TUNING_DB names a tuning database, a result stored for the same problem is reused instead of the
+/// heuristics, the result for the closest shape is timed along with them, and the best algo is recorded
 void LtSgemmSimpleAutoTuning(cublasLtHandle_t ltHandle,
                              cublasOperation_t transa,
                              cublasOperation_t transb,
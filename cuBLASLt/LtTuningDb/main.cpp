@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "tuning_db.h"
+
+/// Host-only tool to merge the tuning databases recorded by the samples on several hosts, and to export them to JSON
+static void printUsage() {
+    printf("Usage: cublasLt_tuning_db merge <output> <input>...\n"
+           "       cublasLt_tuning_db export <database>\n"
+           "merge keeps the fastest result of every problem, output may be one of the inputs\n"
+           "export prints the database as JSON\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 4 && strcmp(argv[1], "merge") == 0) {
+        TuningDb::Database merged;
+        for (int idx = 3; idx < argc; idx++) {
+            TuningDb::Database input;
+            if (!input.load(argv[idx])) {
+                printf("unable to read tuning database %s\n", argv[idx]);
+                return 1;
+            }
+            merged.merge(input);
+            printf("%s: %zu entries\n", argv[idx], input.size());
+        }
+        if (!merged.save(argv[2])) {
+            printf("unable to write tuning database %s\n", argv[2]);
+            return 1;
+        }
+        printf("%s: %zu entries\n", argv[2], merged.size());
+        return 0;
+    }
+    if (argc == 3 && strcmp(argv[1], "export") == 0) {
+        TuningDb::Database database;
+        if (!database.load(argv[2])) {
+            fprintf(stderr, "unable to read tuning database %s\n", argv[2]);
+            return 1;
+        }
+        database.exportJson(stdout);
+        return 0;
+    }
+    printUsage();
+    return 1;
+}
@@ -0,0 +1,302 @@
+/* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* On-disk cache of LTO-IR blobs produced by NVRTC, so that the callback
+ * is compiled once per source, options, architecture and NVRTC version
+ * rather than at every start. Host-only: the cache does not depend on
+ * CUDA and can be used for any blob keyed by a compilation.
+ *
+ * Entries are content addressed: the file name is a 128-bit hash of the
+ * key material, and the full key material is stored in the entry and
+ * compared on load, together with a checksum of the blob. Truncated or
+ * corrupted entries are deleted and reported as misses. Entries are
+ * written to a temporary file and renamed into place, so concurrent
+ * processes never observe partial entries. Once the cache grows past
+ * max_bytes, the least recently used entries are evicted.
+ *
+ * Only the source file itself is hashed, not the headers it includes.
+ * Clear the cache directory after replacing the CUDA Toolkit headers.
+ */
+
+#ifndef COMMON_LTO_CACHE_H_
+#define COMMON_LTO_CACHE_H_
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace LtoCache {
+
+struct Options {
+  // Empty disables the cache
+  std::string dir;
+  size_t max_bytes;
+};
+
+// Reads CUFFT_LTO_CACHE_DIR (default $XDG_CACHE_HOME/cufft_lto, then
+// $HOME/.cache/cufft_lto) and CUFFT_LTO_CACHE_MAX_MB (default 256).
+// CUFFT_LTO_CACHE=0 disables the cache.
+Options get_default_options() {
+  Options options;
+  options.max_bytes = size_t(256) << 20;
+  const char *enabled = getenv("CUFFT_LTO_CACHE");
+  if (enabled && strcmp(enabled, "0") == 0) return options;
+  const char *dir = getenv("CUFFT_LTO_CACHE_DIR");
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  if (dir && *dir) {
+    options.dir = dir;
+  } else if (xdg && *xdg) {
+    options.dir = std::string(xdg) + "/cufft_lto";
+  } else if (home && *home) {
+    options.dir = std::string(home) + "/.cache/cufft_lto";
+  }
+  const char *max_mb = getenv("CUFFT_LTO_CACHE_MAX_MB");
+  if (max_mb && *max_mb) {
+    options.max_bytes = size_t(strtoull(max_mb, NULL, 10)) << 20;
+  }
+  return options;
+}
+
+// FNV-1a with a seed, followed by the splitmix64 finalizer
+uint64_t hash64(const void *data, size_t len, uint64_t seed) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  uint64_t h = 0xcbf29ce484222325ull ^ seed;
+  for (size_t i = 0; i < len; i++) {
+    h ^= bytes[i];
+    h *= 0x100000001b3ull;
+  }
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ull;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebull;
+  h ^= h >> 31;
+  return h;
+}
+
+std::string to_hex(uint64_t value) {
+  char text[17];
+  snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+  return text;
+}
+
+struct Key {
+  // Everything the blob depends on, stored in the entry and compared on load
+  std::string material;
+  // Entry file name derived from the material
+  std::string name;
+};
+
+Key make_key(const std::string &source, const std::vector<std::string> &compile_options,
+             const std::string &arch, const std::string &compiler_version) {
+  Key key;
+  key.material = "source=" + to_hex(hash64(source.data(), source.size(), 0)) +
+                 to_hex(hash64(source.data(), source.size(), 0x9e3779b97f4a7c15ull)) +
+                 ":" + std::to_string(source.size()) + "\n";
+  key.material += "arch=" + arch + "\n";
+  key.material += "compiler=" + compiler_version + "\n";
+  for (size_t i = 0; i < compile_options.size(); i++) {
+    key.material += "option=" + compile_options[i] + "\n";
+  }
+  key.name = to_hex(hash64(key.material.data(), key.material.size(), 0)) +
+             to_hex(hash64(key.material.data(), key.material.size(), 0x9e3779b97f4a7c15ull)) +
+             ".lto";
+  return key;
+}
+
+// Entry layout, in host byte order: header, key material, blob
+struct EntryHeader {
+  char magic[8];
+  uint32_t format_version;
+  uint32_t material_size;
+  uint64_t blob_size;
+  uint64_t blob_hash;
+};
+
+const char kMagic[8] = {'C', 'U', 'F', 'F', 'T', 'L', 'T', 'O'};
+const uint32_t kFormatVersion = 1;
+const char kEntrySuffix[] = ".lto";
+// Temporary files older than this are left over by crashed writers
+const time_t kStaleTmpSeconds = 3600;
+
+std::string get_entry_path(const Options &options, const Key &key) {
+  return options.dir + "/" + key.name;
+}
+
+bool has_suffix(const std::string &name, const char *suffix) {
+  size_t len = strlen(suffix);
+  return name.size() >= len && name.compare(name.size() - len, len, suffix) == 0;
+}
+
+// mkdir -p
+bool make_dirs(const std::string &dir) {
+  for (size_t pos = 1; pos <= dir.size(); pos++) {
+    if (pos != dir.size() && dir[pos] != '/') continue;
+    std::string prefix = dir.substr(0, pos);
+    if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) return false;
+  }
+  struct stat info;
+  return stat(dir.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+bool read_whole_file(const std::string &path, std::vector<char> &contents) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) return false;
+  bool ok = fseek(file, 0, SEEK_END) == 0;
+  long size = ok ? ftell(file) : -1;
+  ok = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+  if (ok) {
+    contents.resize(size);
+    ok = size == 0 || fread(contents.data(), 1, size, file) == size_t(size);
+  }
+  fclose(file);
+  return ok;
+}
+
+// Returns true and fills blob on a hit. Entries that do not match the key
+// or fail the checksum are removed.
+bool load(const Options &options, const Key &key, std::vector<char> &blob) {
+  if (options.dir.empty()) return false;
+  std::string path = get_entry_path(options, key);
+  std::vector<char> contents;
+  if (!read_whole_file(path, contents)) return false;
+  EntryHeader header;
+  bool valid = contents.size() >= sizeof(header);
+  if (valid) {
+    memcpy(&header, contents.data(), sizeof(header));
+    valid = memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+            header.format_version == kFormatVersion &&
+            header.material_size == key.material.size() &&
+            contents.size() == sizeof(header) + header.material_size + header.blob_size;
+  }
+  const char *material = contents.data() + sizeof(header);
+  const char *data = material + (valid ? header.material_size : 0);
+  valid = valid && memcmp(material, key.material.data(), header.material_size) == 0 &&
+          hash64(data, header.blob_size, 0) == header.blob_hash;
+  if (!valid) {
+    fprintf(stderr, "LTO cache: removing invalid entry %s\n", path.c_str());
+    unlink(path.c_str());
+    return false;
+  }
+  blob.assign(data, data + header.blob_size);
+  // Refresh the access time used for eviction
+  utime(path.c_str(), NULL);
+  return true;
+}
+
+struct EntryInfo {
+  std::string path;
+  off_t size;
+  time_t mtime;
+};
+
+bool is_older(const EntryInfo &a, const EntryInfo &b) { return a.mtime < b.mtime; }
+
+// Removes the least recently used entries until the cache fits in
+// max_bytes, and temporary files of crashed writers
+void evict(const Options &options) {
+  if (options.dir.empty()) return;
+  DIR *dir = opendir(options.dir.c_str());
+  if (!dir) return;
+  std::vector<EntryInfo> entries;
+  size_t total = 0;
+  time_t now = time(NULL);
+  while (struct dirent *item = readdir(dir)) {
+    std::string name = item->d_name;
+    std::string path = options.dir + "/" + name;
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) continue;
+    if (has_suffix(name, kEntrySuffix)) {
+      EntryInfo entry = {path, info.st_size, info.st_mtime};
+      entries.push_back(entry);
+      total += info.st_size;
+    } else if (name.find(".tmp.") != std::string::npos &&
+               now - info.st_mtime > kStaleTmpSeconds) {
+      unlink(path.c_str());
+    }
+  }
+  closedir(dir);
+  std::sort(entries.begin(), entries.end(), is_older);
+  for (size_t i = 0; i < entries.size() && total > options.max_bytes; i++) {
+    if (unlink(entries[i].path.c_str()) == 0) total -= entries[i].size;
+  }
+}
+
+// Writes the entry atomically, then evicts. Returns false if the entry
+// could not be written; the cache is then simply bypassed.
+bool store(const Options &options, const Key &key, const std::vector<char> &blob) {
+  if (options.dir.empty()) return false;
+  if (!make_dirs(options.dir)) {
+    fprintf(stderr, "LTO cache: unable to create %s\n", options.dir.c_str());
+    return false;
+  }
+  EntryHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.format_version = kFormatVersion;
+  header.material_size = static_cast<uint32_t>(key.material.size());
+  header.blob_size = blob.size();
+  header.blob_hash = hash64(blob.data(), blob.size(), 0);
+
+  static unsigned counter = 0;
+  std::string path = get_entry_path(options, key);
+  std::string tmp_path = path + ".tmp." + std::to_string(getpid()) + "." +
+                         std::to_string(counter++);
+  FILE *file = fopen(tmp_path.c_str(), "wb");
+  if (!file) {
+    fprintf(stderr, "LTO cache: unable to write %s\n", tmp_path.c_str());
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(key.material.data(), 1, key.material.size(), file) == key.material.size() &&
+            (blob.empty() || fwrite(blob.data(), 1, blob.size(), file) == blob.size()) &&
+            fflush(file) == 0 && fsync(fileno(file)) == 0;
+  ok = fclose(file) == 0 && ok;
+  ok = ok && rename(tmp_path.c_str(), path.c_str()) == 0;
+  if (!ok) {
+    fprintf(stderr, "LTO cache: unable to write %s\n", path.c_str());
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  evict(options);
+  return true;
+}
+
+}  // namespace LtoCache
+
+#endif  // COMMON_LTO_CACHE_H_
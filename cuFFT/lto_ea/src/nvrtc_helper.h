@@ -40,6 +40,8 @@
 #include <string>
 #include <vector>
 
+#include "lto_cache.h"
+
 #define NVRTC_SAFE_CALL(Name, x)                                \
   do {                                                          \
     nvrtcResult result = x;                                     \
@@ -56,21 +58,19 @@
 #define CUDA_ARCH_FLAG "-arch=compute_" STRINGIZE(CUDA_ARCH)
 #define CALLBACK_CODE_PATH(name) STRINGIZE(SOURCE_PATH) "/" name
 
-void compile_file_to_lto(std::vector<char>& cubin_result, const char *filename) {
-  std::ifstream inputFile(filename, std::ios::in | std::ios::binary | std::ios::ate);
+// Compiles the callback source to LTO-IR, or loads the result of a previous
+// compilation from the cache
+void compile_file_to_lto(std::vector<char>& cubin_result, const char *filename,
+                         const LtoCache::Options& cache_options) {
+  std::ifstream inputFile(filename, std::ios::in | std::ios::binary);
   if (!inputFile.is_open()) {
     std::cerr << "\nerror: unable to open " << filename << " for reading!\n";
     exit(1);
   }
-
-  std::streampos pos = inputFile.tellg();
-  size_t inputSize = (size_t)pos;
-  std::vector<char> memBlock(inputSize + 1);
-
-  inputFile.seekg(0, std::ios::beg);
-  inputFile.read(memBlock.data(), inputSize);
+  std::stringstream source;
+  source << inputFile.rdbuf();
   inputFile.close();
-  memBlock[inputSize] = '\x0';
+  std::string memBlock = source.str();
 
   const int   num_params       = 6;
   const char *compile_params[] = {INCLUDE_CUDA_PATH,
@@ -80,9 +80,19 @@ void compile_file_to_lto(std::vector<char>& cubin_result, const char *filename)
                                   "-default-device",
                                   "-dlto"};
 
+  int nvrtc_major, nvrtc_minor;
+  NVRTC_SAFE_CALL("nvrtcVersion", nvrtcVersion(&nvrtc_major, &nvrtc_minor));
+  LtoCache::Key cache_key = LtoCache::make_key(
+      memBlock, std::vector<std::string>(compile_params, compile_params + num_params),
+      STRINGIZE(CUDA_ARCH), "nvrtc " + std::to_string(nvrtc_major) + "." + std::to_string(nvrtc_minor));
+  if (LtoCache::load(cache_options, cache_key, cubin_result)) {
+    std::cout << "Loaded LTO callback from cache " << cache_options.dir << "/" << cache_key.name << std::endl;
+    return;
+  }
+
   // Compile
   nvrtcProgram prog;
-  NVRTC_SAFE_CALL("nvrtcCreateProgram", nvrtcCreateProgram(&prog, memBlock.data(), filename, 0, NULL, NULL));
+  NVRTC_SAFE_CALL("nvrtcCreateProgram", nvrtcCreateProgram(&prog, memBlock.c_str(), filename, 0, NULL, NULL));
   nvrtcResult res = nvrtcCompileProgram(prog, num_params, compile_params);
 
   // Print log
@@ -105,7 +115,14 @@ void compile_file_to_lto(std::vector<char>& cubin_result, const char *filename)
   NVRTC_SAFE_CALL("nvrtcGetLTOIRSize", nvrtcGetLTOIRSize(prog, &codeSize));
   std::vector<char> buffer(codeSize);
   NVRTC_SAFE_CALL("nvrtcGetNVVM", nvrtcGetLTOIR(prog, buffer.data()));
+  NVRTC_SAFE_CALL("nvrtcDestroyProgram", nvrtcDestroyProgram(&prog));
   cubin_result = buffer;
+
+  LtoCache::store(cache_options, cache_key, cubin_result);
+}
+
+void compile_file_to_lto(std::vector<char>& cubin_result, const char *filename) {
+  compile_file_to_lto(cubin_result, filename, LtoCache::get_default_options());
 }
 
 #endif  // COMMON_NVRTC_HELPER_H_
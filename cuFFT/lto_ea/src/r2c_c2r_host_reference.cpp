@@ -0,0 +1,80 @@
+/* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+/* 
+ * Host reference for the example of LTO callbacks,
+ * the same transforms and window computed in double
+ * precision on the CPU, independently of cuFFT.
+ * 
+*/
+
+#include <stdio.h>
+#include <complex>
+#include <exception>
+#include <vector>
+#include <utils/host_fft.h>
+#include "r2c_c2r_reference.h"
+
+int host_reference_r2c_window_c2r(unsigned batches, unsigned signal_size, unsigned window_size, const float* input_signals, float* output_signals) {
+	const unsigned complex_signal_size = signal_size / 2 + 1;
+	const size_t   batch_offset        = 2 * complex_signal_size;
+	const std::vector<size_t> dims(1, signal_size);
+
+	std::vector<double> signals(batches * batch_offset, 0.);
+	std::vector<std::complex<double>> spectrum(batches * complex_signal_size);
+	for(size_t i = 0; i < signals.size(); ++i) {
+		signals[i] = input_signals[i];
+	}
+
+	// Transform signal forward
+	printf("Transforming host reference r2c\n");
+	try {
+		HostFFT::r2c(dims, batches, signals.data(), spectrum.data(), batch_offset);
+
+		// Apply window
+		for(unsigned batch = 0; batch < batches; ++batch) {
+			for(unsigned sample = window_size; sample < complex_signal_size; ++sample) {
+				spectrum[batch * complex_signal_size + sample] = 0.;
+			}
+		}
+
+		// Inverse-transform the signal
+		printf("Transforming host reference c2r\n");
+		HostFFT::c2r(dims, batches, spectrum.data(), signals.data(), batch_offset);
+	} catch(const std::exception& e) {
+		printf("Host reference failed: %s\n", e.what());
+		return ERROR_VALUE;
+	}
+
+	for(size_t i = 0; i < signals.size(); ++i) {
+		output_signals[i] = static_cast<float>(signals[i]);
+	}
+
+	return PASS_VALUE;
+}
@@ -34,6 +34,7 @@
 
 #include <cuda_runtime_api.h>
 #include <cufftXt.h>
+#include <vector>
 #include "r2c_c2r_reference.h"
 #include "common.h"
 
@@ -52,8 +53,9 @@ constexpr unsigned signal_size          = 328;
 constexpr unsigned window_size          =  32;
 constexpr unsigned complex_signal_size  = signal_size / 2 + 1;
 
-// Precision threshold
-constexpr float threshold = 1e-6;
+// Precision thresholds, against the cuFFT reference and the double precision host reference
+constexpr float threshold      = 1e-6;
+constexpr float host_threshold = 1e-5;
 
 static_assert(window_size < (signal_size/2 + 1), "The window size must be smaller than the signal size in complex space");
 
@@ -125,7 +127,17 @@ int test_r2c_window_c2r() {
 	double l2_error = compute_error<float>(&reference[0][0], &output_signals[0][0], batches, signal_size);
 	printf("L2 error: %e\n", l2_error);
 
-	return (l2_error < threshold) ? PASS_VALUE : ERROR_VALUE;
+	// Compute the host reference, independent of cuFFT
+	std::vector<float> host_reference(batches * 2 * complex_signal_size);
+	if(host_reference_r2c_window_c2r(batches, signal_size, window_size, &input_signals[0][0], host_reference.data()) != PASS_VALUE) {
+		printf("Failed to compute the host reference");
+		return ERROR_VALUE;
+	};
+
+	double host_l2_error = compute_error<float>(host_reference.data(), &output_signals[0][0], batches, signal_size);
+	printf("L2 error against the host reference: %e\n", host_l2_error);
+
+	return (l2_error < threshold && host_l2_error < host_threshold) ? PASS_VALUE : ERROR_VALUE;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -32,5 +32,8 @@
 
 int reference_r2c_window_c2r(unsigned batches, unsigned signal_size, unsigned window_size, float* input_signals, float* output_signals);
 
+// Same transforms computed on the host in double precision, without cuFFT
+int host_reference_r2c_window_c2r(unsigned batches, unsigned signal_size, unsigned window_size, const float* input_signals, float* output_signals);
+
 #endif // R2C_C2R_REFERENCE__H_
 
@@ -0,0 +1,285 @@
+/* Checks the LTO-IR cache on the host in a temporary directory: hits and
+ * misses, key mismatches, truncated and corrupt entries, LRU eviction by
+ * size and the cleanup of stale temporary files.
+ */
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "lto_cache.h"
+#include "test_check.h"
+
+namespace {
+
+std::string make_temp_dir() {
+  const char *tmpdir = getenv("TMPDIR");
+  std::string pattern = std::string(tmpdir ? tmpdir : "/tmp") + "/lto_cache_test.XXXXXX";
+  std::vector<char> buffer(pattern.begin(), pattern.end());
+  buffer.push_back('\0');
+  return mkdtemp(buffer.data()) ? std::string(buffer.data()) : std::string();
+}
+
+bool exists(const std::string &path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0;
+}
+
+void set_mtime(const std::string &path, time_t mtime) {
+  struct utimbuf times;
+  times.actime = mtime;
+  times.modtime = mtime;
+  utime(path.c_str(), &times);
+}
+
+void write_file(const std::string &path, const std::vector<char> &contents) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file) return;
+  if (!contents.empty()) fwrite(contents.data(), 1, contents.size(), file);
+  fclose(file);
+}
+
+std::vector<char> make_blob(size_t size, char seed) {
+  std::vector<char> blob(size);
+  for (size_t i = 0; i < size; i++) blob[i] = static_cast<char>(seed + i * 7);
+  return blob;
+}
+
+LtoCache::Key make_test_key(const std::string &source) {
+  std::vector<std::string> options;
+  options.push_back("-dlto");
+  options.push_back("-rdc=true");
+  return LtoCache::make_key(source, options, "compute_80", "12.3");
+}
+
+void test_hit_and_miss(const LtoCache::Options &options) {
+  LtoCache::Key key = make_test_key("__device__ void callback() {}");
+  std::vector<char> blob;
+  CHECK(!LtoCache::load(options, key, blob));
+
+  std::vector<char> stored = make_blob(1000, 3);
+  CHECK(LtoCache::store(options, key, stored));
+  CHECK(exists(LtoCache::get_entry_path(options, key)));
+  CHECK(LtoCache::load(options, key, blob));
+  CHECK(blob == stored);
+
+  // Any part of the key gives another entry
+  std::vector<std::string> compile_options;
+  compile_options.push_back("-dlto");
+  compile_options.push_back("-rdc=true");
+  std::vector<std::string> fewer_options(1, "-dlto");
+  LtoCache::Key others[] = {
+      make_test_key("__device__ void callback() { }"),
+      LtoCache::make_key("__device__ void callback() {}", fewer_options, "compute_80", "12.3"),
+      LtoCache::make_key("__device__ void callback() {}", compile_options, "compute_90", "12.3"),
+      LtoCache::make_key("__device__ void callback() {}", compile_options, "compute_80", "12.4")};
+  for (size_t i = 0; i < sizeof(others) / sizeof(others[0]); i++) {
+    CHECK(others[i].name != key.name);
+    CHECK(others[i].material != key.material);
+    CHECK(!LtoCache::load(options, others[i], blob));
+  }
+  CHECK(make_test_key("__device__ void callback() {}").name == key.name);
+
+  // Replacing an entry, and an empty blob
+  stored = make_blob(10, 5);
+  CHECK(LtoCache::store(options, key, stored));
+  CHECK(LtoCache::load(options, key, blob) && blob == stored);
+  stored.clear();
+  CHECK(LtoCache::store(options, key, stored));
+  blob.push_back(1);
+  CHECK(LtoCache::load(options, key, blob) && blob.empty());
+
+  // An empty directory disables the cache
+  LtoCache::Options disabled = options;
+  disabled.dir.clear();
+  CHECK(!LtoCache::store(disabled, key, stored));
+  CHECK(!LtoCache::load(disabled, key, blob));
+}
+
+void test_key_mismatch(const LtoCache::Options &options) {
+  // Another key whose name collides: the stored material tells them apart
+  LtoCache::Key key = make_test_key("__device__ void a() {}");
+  LtoCache::Key collision = make_test_key("__device__ void b() {}");
+  collision.name = key.name;
+  CHECK(LtoCache::store(options, key, make_blob(100, 1)));
+  std::vector<char> blob;
+  CHECK(!LtoCache::load(options, collision, blob));
+  CHECK(!exists(LtoCache::get_entry_path(options, key)));
+
+  // Same name, material of another length
+  CHECK(LtoCache::store(options, key, make_blob(100, 1)));
+  collision.material += "option=-G\n";
+  CHECK(!LtoCache::load(options, collision, blob));
+  CHECK(!exists(LtoCache::get_entry_path(options, key)));
+}
+
+void test_invalid_entries(const LtoCache::Options &options) {
+  LtoCache::Key key = make_test_key("__device__ void corrupt() {}");
+  std::string path = LtoCache::get_entry_path(options, key);
+  std::vector<char> stored = make_blob(256, 9);
+  CHECK(LtoCache::store(options, key, stored));
+  std::vector<char> good;
+  CHECK(LtoCache::read_whole_file(path, good));
+  size_t blob_offset = sizeof(LtoCache::EntryHeader) + key.material.size();
+  CHECK(good.size() == blob_offset + stored.size());
+
+  // Truncated in the blob, in the material, in the header, empty; a
+  // trailing byte; a flipped byte in the blob, the material and the magic
+  std::vector<std::vector<char> > invalid;
+  invalid.push_back(std::vector<char>(good.begin(), good.end() - 1));
+  invalid.push_back(std::vector<char>(good.begin(), good.begin() + blob_offset - 1));
+  invalid.push_back(std::vector<char>(good.begin(), good.begin() + sizeof(LtoCache::EntryHeader) / 2));
+  invalid.push_back(std::vector<char>());
+  invalid.push_back(good);
+  invalid.back().push_back(0);
+  size_t flipped[] = {blob_offset + 100, sizeof(LtoCache::EntryHeader) + 3, 0};
+  for (size_t i = 0; i < sizeof(flipped) / sizeof(flipped[0]); i++) {
+    invalid.push_back(good);
+    invalid.back()[flipped[i]] ^= 0x10;
+  }
+  for (size_t i = 0; i < invalid.size(); i++) {
+    write_file(path, invalid[i]);
+    std::vector<char> blob;
+    CHECK(!LtoCache::load(options, key, blob));
+    CHECK(!exists(path));
+  }
+
+  // The intact entry still loads
+  write_file(path, good);
+  std::vector<char> blob;
+  CHECK(LtoCache::load(options, key, blob) && blob == stored);
+}
+
+void test_eviction(LtoCache::Options options) {
+  // A directory of its own, so that only these entries count
+  options.dir += "/eviction";
+  options.max_bytes = size_t(1) << 30;
+  LtoCache::Key keys[3] = {make_test_key("__device__ void k0() {}"),
+                           make_test_key("__device__ void k1() {}"),
+                           make_test_key("__device__ void k2() {}")};
+  for (int i = 0; i < 3; i++) CHECK(LtoCache::store(options, keys[i], make_blob(4000, i)));
+  struct stat info;
+  CHECK(stat(LtoCache::get_entry_path(options, keys[0]).c_str(), &info) == 0);
+  size_t entry_size = info.st_size;
+
+  // k0 is the oldest entry but is loaded, which makes k1 the least
+  // recently used
+  time_t now = time(NULL);
+  for (int i = 0; i < 3; i++) set_mtime(LtoCache::get_entry_path(options, keys[i]), now - 300 + 100 * i);
+  std::vector<char> blob;
+  CHECK(LtoCache::load(options, keys[0], blob));
+
+  // Fits in two entries: k1 goes
+  options.max_bytes = 2 * entry_size + entry_size / 2;
+  LtoCache::evict(options);
+  CHECK(exists(LtoCache::get_entry_path(options, keys[0])));
+  CHECK(!exists(LtoCache::get_entry_path(options, keys[1])));
+  CHECK(exists(LtoCache::get_entry_path(options, keys[2])));
+
+  // Storing past the limit evicts on the way: k2 is now the oldest
+  set_mtime(LtoCache::get_entry_path(options, keys[2]), now - 200);
+  CHECK(LtoCache::store(options, keys[1], make_blob(4000, 1)));
+  CHECK(exists(LtoCache::get_entry_path(options, keys[0])));
+  CHECK(exists(LtoCache::get_entry_path(options, keys[1])));
+  CHECK(!exists(LtoCache::get_entry_path(options, keys[2])));
+
+  // Exactly at the limit nothing goes; one byte under, the oldest goes
+  options.max_bytes = 2 * entry_size;
+  set_mtime(LtoCache::get_entry_path(options, keys[0]), now - 100);
+  LtoCache::evict(options);
+  CHECK(exists(LtoCache::get_entry_path(options, keys[0])));
+  CHECK(exists(LtoCache::get_entry_path(options, keys[1])));
+  options.max_bytes = 2 * entry_size - 1;
+  LtoCache::evict(options);
+  CHECK(!exists(LtoCache::get_entry_path(options, keys[0])));
+  CHECK(exists(LtoCache::get_entry_path(options, keys[1])));
+
+  // Files other than entries count for nothing and are kept
+  std::string other = options.dir + "/notes.txt";
+  write_file(other, make_blob(100000, 0));
+  options.max_bytes = entry_size;
+  LtoCache::evict(options);
+  CHECK(exists(other));
+  CHECK(exists(LtoCache::get_entry_path(options, keys[1])));
+  unlink(other.c_str());
+}
+
+void test_stale_tmp(const LtoCache::Options &options) {
+  LtoCache::Key key = make_test_key("__device__ void tmp() {}");
+  std::string entry = LtoCache::get_entry_path(options, key);
+  std::string stale = entry + ".tmp.12345.0";
+  std::string fresh = entry + ".tmp.12345.1";
+  write_file(stale, make_blob(10, 0));
+  write_file(fresh, make_blob(10, 0));
+  set_mtime(stale, time(NULL) - LtoCache::kStaleTmpSeconds - 60);
+
+  // A store cleans up after crashed writers, but not after live ones
+  CHECK(LtoCache::store(options, key, make_blob(10, 0)));
+  CHECK(!exists(stale));
+  CHECK(exists(fresh));
+  CHECK(exists(entry));
+  unlink(fresh.c_str());
+
+  // No temporary file of its own is left behind
+  DIR *dir = opendir(options.dir.c_str());
+  CHECK(dir != NULL);
+  while (dir) {
+    struct dirent *item = readdir(dir);
+    if (!item) break;
+    CHECK(std::string(item->d_name).find(".tmp.") == std::string::npos);
+  }
+  if (dir) closedir(dir);
+}
+
+void test_default_options() {
+  setenv("CUFFT_LTO_CACHE_DIR", "/some/dir", 1);
+  setenv("CUFFT_LTO_CACHE_MAX_MB", "3", 1);
+  unsetenv("CUFFT_LTO_CACHE");
+  LtoCache::Options options = LtoCache::get_default_options();
+  CHECK(options.dir == "/some/dir");
+  CHECK(options.max_bytes == size_t(3) << 20);
+
+  unsetenv("CUFFT_LTO_CACHE_DIR");
+  unsetenv("CUFFT_LTO_CACHE_MAX_MB");
+  setenv("XDG_CACHE_HOME", "/xdg", 1);
+  options = LtoCache::get_default_options();
+  CHECK(options.dir == "/xdg/cufft_lto");
+  CHECK(options.max_bytes == size_t(256) << 20);
+
+  unsetenv("XDG_CACHE_HOME");
+  setenv("HOME", "/home/user", 1);
+  CHECK(LtoCache::get_default_options().dir == "/home/user/.cache/cufft_lto");
+
+  setenv("CUFFT_LTO_CACHE", "0", 1);
+  CHECK(LtoCache::get_default_options().dir.empty());
+}
+
+}  // namespace
+
+int main() {
+  std::string root = make_temp_dir();
+  CHECK(!root.empty());
+  if (root.empty()) return test_result("lto_cache_test");
+
+  // store creates missing directories
+  LtoCache::Options options;
+  options.dir = root + "/a/b";
+  options.max_bytes = size_t(1) << 30;
+  test_hit_and_miss(options);
+  test_key_mismatch(options);
+  test_invalid_entries(options);
+  test_eviction(options);
+  test_stale_tmp(options);
+  test_default_options();
+
+  std::string command = "rm -rf '" + root + "'";
+  CHECK(system(command.c_str()) == 0);
+  return test_result("lto_cache_test");
+}
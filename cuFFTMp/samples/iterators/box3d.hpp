@@ -0,0 +1,30 @@
+#ifndef __CUFFTMP_BOX3D_HPP__
+#define __CUFFTMP_BOX3D_HPP__
+
+/**
+ * A (lower, upper, strides) box describes the part [lower, upper) of
+ * a global 3D array held by one process, and the strides of its local
+ * buffer: global (x, y, z) is at local index
+ * (x - lower[0]) * strides[0] + (y - lower[1]) * strides[1] + (z - lower[2]) * strides[2]
+ *
+ * This header has no CUDA dependency, so host-only code can use it.
+ */
+
+using int64 = long long int;
+
+struct Box3D {
+    int64 lower[3];
+    int64 upper[3];
+    int64 strides[3];
+};
+
+/**
+ * Start of the part of [0, length) owned by rank out of size ranks,
+ * when the first length % size ranks get one extra element
+ */
+inline int64 slabs_displacement(int64 length, int rank, int size) {
+    int ranks_cutoff = length % size;
+    return (rank < ranks_cutoff ? rank * (length / size + 1) : ranks_cutoff * (length / size + 1) + (rank - ranks_cutoff) * (length / size));
+}
+
+#endif // __CUFFTMP_BOX3D_HPP__
@@ -5,6 +5,7 @@
 #include <cstddef> 
 #include <cufftXt.h>
 #include <tuple>
+#include "box3d.hpp"
 
 /**
  * This iterator lets one iterate through the underlying data
@@ -15,14 +16,6 @@
  * This iterator can be used in __host__ or __device__ code
  */
 
-using int64 = long long int;
-
-struct Box3D {
-    int64 lower[3];
-    int64 upper[3];
-    int64 strides[3];
-};
-
 template<typename T>
 struct BoxIterator 
 {
@@ -165,11 +158,18 @@ private:
         *z += box_.lower[2];
     }
 
-    // Increment/decrement by n
+    // Increment/decrement by n. Single steps carry through the
+    // coordinates instead of dividing, other steps recompute them.
     __host__ __device__ __forceinline__
     void increment(difference_type n) {
         i_ += n;
-        linear_to_box3d(i_, &x_, &y_, &z_);
+        if(n == 1 && z_ + 1 < box_.upper[2]) {
+            z_++;
+        } else if(n == -1 && z_ > box_.lower[2] && i_ >= 0) {
+            z_--;
+        } else {
+            linear_to_box3d(i_, &x_, &y_, &z_);
+        }
     }
 
 };
@@ -189,11 +189,6 @@ std::pair<BoxIterator<T>,BoxIterator<T>> BoxIterators(Box3D box, T* ptr) {
     return {BoxIteratorBegin<T>(box, ptr),BoxIteratorEnd<T>(box, ptr)};
 }
 
-int64 slabs_displacement(int64 length, int rank, int size) {
-    int ranks_cutoff = length % size;
-    return (rank < ranks_cutoff ? rank * (length / size + 1) : ranks_cutoff * (length / size + 1) + (rank - ranks_cutoff) * (length / size));
-}
-
 Box3D buildBox3D(cufftXtSubFormat format, cufftType type, int rank, int size, int64 nx, int64 ny, int64 nz) {
     if(format == CUFFT_XT_FORMAT_INPLACE) {
         int64 x_start      = slabs_displacement(nx, rank,   size);
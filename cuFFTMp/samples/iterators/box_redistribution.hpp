@@ -0,0 +1,424 @@
+#ifndef __CUFFTMP_BOX_REDISTRIBUTION_HPP__
+#define __CUFFTMP_BOX_REDISTRIBUTION_HPP__
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <utils/thread_pool.h>
+#include "box3d.hpp"
+
+/**
+ * Box-to-box redistribution of a global 3D array between two
+ * decompositions over the same P ranks: rank r holds src_boxes[r]
+ * before, and dst_boxes[r] after.
+ *
+ * The plan intersects every source box with every destination box once
+ * and describes each non-empty intersection with two strided block
+ * copies: source buffer to a packed piece, and packed piece to
+ * destination buffer. A block copy is a 3D loop of memcpy calls of
+ * contiguous runs, with runs merged across dimensions wherever both
+ * sides are contiguous, so executing the plan never maps a linear index
+ * back to 3D coordinates.
+ *
+ * The packed pieces of a rank are laid out like the send buffer of an
+ * MPI_Alltoallv: pieces sent to ranks 0, 1, ... follow each other, and
+ * the counts and displacements are available per rank. Pieces a rank
+ * keeps are copied directly instead.
+ *
+ * HostBoxRedistribution executes a plan in shared memory, each rank being
+ * a buffer on the host.
+ */
+
+/**
+ * count[0] x count[1] x count[2] runs of run contiguous elements, copied
+ * between element offsets src_offset + sum(k[j] * src_strides[j]) and
+ * dst_offset + sum(k[j] * dst_strides[j])
+ */
+struct BoxCopy {
+    int64 src_offset;
+    int64 dst_offset;
+    int64 run;
+    int64 count[3];
+    int64 src_strides[3];
+    int64 dst_strides[3];
+};
+
+/**
+ * Intersection of the source box of src_rank and the destination box of
+ * dst_rank
+ */
+struct BoxTransfer {
+    int src_rank;
+    int dst_rank;
+    // Global coordinates of the piece, and strides of the packed piece
+    Box3D box;
+    // Offsets of the piece in the send buffer of src_rank and in the
+    // receive buffer of dst_rank, unused if src_rank == dst_rank
+    int64 send_offset;
+    int64 recv_offset;
+    // Source buffer to send buffer, and receive buffer to destination
+    // buffer; source buffer to destination buffer if src_rank == dst_rank
+    BoxCopy pack;
+    BoxCopy unpack;
+};
+
+inline int64 box_volume(const Box3D& box) {
+    int64 volume = 1;
+    for(int d = 0; d < 3; d++) {
+        volume *= std::max<int64>(box.upper[d] - box.lower[d], 0);
+    }
+    return volume;
+}
+
+/**
+ * Box with the given corners and contiguous, row-major (Z fastest) strides
+ */
+inline Box3D make_box3d(const int64 lower[3], const int64 upper[3]) {
+    Box3D box;
+    int64 stride = 1;
+    for(int d = 2; d >= 0; d--) {
+        box.lower[d] = lower[d];
+        box.upper[d] = upper[d];
+        box.strides[d] = stride;
+        stride *= std::max<int64>(upper[d] - lower[d], 0);
+    }
+    return box;
+}
+
+/**
+ * nx x ny x nz array split along axis (0 for X, 1 for Y, 2 for Z) into
+ * size slabs
+ */
+inline std::vector<Box3D> build_slab_boxes(int64 nx, int64 ny, int64 nz, int axis, int size) {
+    std::vector<Box3D> boxes(size);
+    for(int rank = 0; rank < size; rank++) {
+        int64 lower[3] = {0, 0, 0};
+        int64 upper[3] = {nx, ny, nz};
+        lower[axis] = slabs_displacement(upper[axis], rank,     size);
+        upper[axis] = slabs_displacement(upper[axis], rank + 1, size);
+        boxes[rank] = make_box3d(lower, upper);
+    }
+    return boxes;
+}
+
+/**
+ * nx x ny x nz array split into size0 x size1 pencils, along axis0 and
+ * axis1; rank r holds part r / size1 along axis0 and r % size1 along axis1
+ */
+inline std::vector<Box3D> build_pencil_boxes(int64 nx, int64 ny, int64 nz, int axis0, int size0, int axis1, int size1) {
+    std::vector<Box3D> boxes(size0 * size1);
+    for(int rank = 0; rank < size0 * size1; rank++) {
+        int64 lower[3] = {0, 0, 0};
+        int64 upper[3] = {nx, ny, nz};
+        int64 n0 = upper[axis0], n1 = upper[axis1];
+        lower[axis0] = slabs_displacement(n0, rank / size1,     size0);
+        upper[axis0] = slabs_displacement(n0, rank / size1 + 1, size0);
+        lower[axis1] = slabs_displacement(n1, rank % size1,     size1);
+        upper[axis1] = slabs_displacement(n1, rank % size1 + 1, size1);
+        boxes[rank] = make_box3d(lower, upper);
+    }
+    return boxes;
+}
+
+class BoxRedistribution {
+public:
+    /**
+     * Source boxes must not overlap each other. Elements of a destination
+     * box that no source box holds are left untouched.
+     */
+    BoxRedistribution(const std::vector<Box3D>& src_boxes, const std::vector<Box3D>& dst_boxes)
+        : size_(static_cast<int>(src_boxes.size())),
+          send_count_(src_boxes.size(), 0), recv_count_(src_boxes.size(), 0),
+          sends_(src_boxes.size()), recvs_(src_boxes.size()) {
+        if(src_boxes.size() != dst_boxes.size() || src_boxes.empty()) {
+            throw std::invalid_argument("BoxRedistribution: source and destination need one box per rank");
+        }
+        for(int src = 0; src < size_; src++) {
+            for(int dst = 0; dst < size_; dst++) {
+                add_transfer(src_boxes[src], src, dst_boxes[dst], dst);
+            }
+        }
+    }
+
+    int size() const { return size_; }
+
+    const std::vector<BoxTransfer>& transfers() const { return transfers_; }
+
+    /**
+     * Elements in the send and receive buffers of rank
+     */
+    int64 send_count(int rank) const { return send_count_[rank]; }
+    int64 recv_count(int rank) const { return recv_count_[rank]; }
+
+    /**
+     * Per peer element counts and displacements of the send and receive
+     * buffers of rank, as passed to MPI_Alltoallv
+     */
+    std::vector<int64> send_counts(int rank) const { return peer_counts(sends_[rank], false, false); }
+    std::vector<int64> send_displacements(int rank) const { return peer_counts(sends_[rank], false, true); }
+    std::vector<int64> recv_counts(int rank) const { return peer_counts(recvs_[rank], true, false); }
+    std::vector<int64> recv_displacements(int rank) const { return peer_counts(recvs_[rank], true, true); }
+
+    /**
+     * Packs the pieces rank sends from its source buffer src into send
+     */
+    template<typename T>
+    void pack(int rank, const T* src, T* send) const {
+        for(int t : sends_[rank]) {
+            if(transfers_[t].dst_rank != rank) {
+                copy(transfers_[t].pack, src, send + transfers_[t].send_offset);
+            }
+        }
+    }
+
+    /**
+     * Unpacks the pieces rank received in recv into its destination
+     * buffer dst
+     */
+    template<typename T>
+    void unpack(int rank, const T* recv, T* dst) const {
+        for(int t : recvs_[rank]) {
+            if(transfers_[t].src_rank != rank) {
+                copy(transfers_[t].unpack, recv + transfers_[t].recv_offset, dst);
+            }
+        }
+    }
+
+    /**
+     * Copies the piece rank keeps from src to dst
+     */
+    template<typename T>
+    void copy_local(int rank, const T* src, T* dst) const {
+        for(int t : sends_[rank]) {
+            if(transfers_[t].dst_rank == rank) {
+                copy(transfers_[t].pack, src, dst);
+            }
+        }
+    }
+
+    /**
+     * Runs [first_run, last_run) of c, in loop order, from src to dst
+     */
+    template<typename T>
+    static void copy(const BoxCopy& c, const T* src, T* dst, int64 first_run = 0, int64 last_run = -1) {
+        if(last_run < 0) {
+            last_run = c.count[0] * c.count[1] * c.count[2];
+        }
+        if(first_run >= last_run) {
+            return;
+        }
+        int64 k[3];
+        k[0] = first_run / (c.count[1] * c.count[2]);
+        k[1] = first_run / c.count[2] % c.count[1];
+        k[2] = first_run % c.count[2];
+        const T* s = src + c.src_offset + k[0] * c.src_strides[0] + k[1] * c.src_strides[1] + k[2] * c.src_strides[2];
+        T* d = dst + c.dst_offset + k[0] * c.dst_strides[0] + k[1] * c.dst_strides[1] + k[2] * c.dst_strides[2];
+        size_t bytes = c.run * sizeof(T);
+        for(int64 r = first_run; r < last_run; r++) {
+            std::memcpy(d, s, bytes);
+            // Carry through the loop counters, innermost first
+            s += c.src_strides[2];
+            d += c.dst_strides[2];
+            if(++k[2] == c.count[2]) {
+                k[2] = 0;
+                s += c.src_strides[1] - c.count[2] * c.src_strides[2];
+                d += c.dst_strides[1] - c.count[2] * c.dst_strides[2];
+                if(++k[1] == c.count[1]) {
+                    k[1] = 0;
+                    s += c.src_strides[0] - c.count[1] * c.src_strides[1];
+                    d += c.dst_strides[0] - c.count[1] * c.dst_strides[1];
+                }
+            }
+        }
+    }
+
+private:
+    int size_;
+    std::vector<BoxTransfer> transfers_;
+    std::vector<int64> send_count_, recv_count_;
+    // Indices in transfers_ of the pieces each rank sends and receives, by
+    // increasing peer rank
+    std::vector<std::vector<int>> sends_, recvs_;
+
+    void add_transfer(const Box3D& src_box, int src, const Box3D& dst_box, int dst) {
+        BoxTransfer t;
+        t.src_rank = src;
+        t.dst_rank = dst;
+        int64 extent[3];
+        for(int d = 0; d < 3; d++) {
+            t.box.lower[d] = std::max(src_box.lower[d], dst_box.lower[d]);
+            t.box.upper[d] = std::min(src_box.upper[d], dst_box.upper[d]);
+            extent[d] = t.box.upper[d] - t.box.lower[d];
+            if(extent[d] <= 0) {
+                return;
+            }
+        }
+        // The packed piece follows the memory order of the source box, so
+        // packing reads whole source runs
+        int order[3] = {0, 1, 2};
+        std::stable_sort(order, order + 3, [&](int a, int b) { return src_box.strides[a] > src_box.strides[b]; });
+        int64 stride = 1;
+        for(int j = 2; j >= 0; j--) {
+            t.box.strides[order[j]] = stride;
+            stride *= extent[order[j]];
+        }
+        if(src == dst) {
+            t.send_offset = t.recv_offset = -1;
+            t.pack = make_copy(t.box, src_box, dst_box);
+            t.unpack = t.pack;
+        } else {
+            Box3D packed = t.box;
+            t.send_offset = send_count_[src];
+            t.recv_offset = recv_count_[dst];
+            t.pack = make_copy(t.box, src_box, packed);
+            t.unpack = make_copy(t.box, packed, dst_box);
+            send_count_[src] += box_volume(t.box);
+            recv_count_[dst] += box_volume(t.box);
+        }
+        sends_[src].push_back(static_cast<int>(transfers_.size()));
+        recvs_[dst].push_back(static_cast<int>(transfers_.size()));
+        transfers_.push_back(t);
+    }
+
+    // Copy of the elements of box, which lies in both from and to
+    static BoxCopy make_copy(const Box3D& box, const Box3D& from, const Box3D& to) {
+        BoxCopy c;
+        c.src_offset = 0;
+        c.dst_offset = 0;
+        for(int d = 0; d < 3; d++) {
+            c.src_offset += (box.lower[d] - from.lower[d]) * from.strides[d];
+            c.dst_offset += (box.lower[d] - to.lower[d]) * to.strides[d];
+        }
+        // Loop over the destination in memory order, so that runs are
+        // contiguous writes whenever the source allows it
+        int order[3] = {0, 1, 2};
+        std::stable_sort(order, order + 3, [&](int a, int b) {
+            return to.strides[a] != to.strides[b] ? to.strides[a] > to.strides[b] : from.strides[a] > from.strides[b];
+        });
+        // Merge the innermost dimensions into one run while both sides
+        // stay contiguous
+        int inner = 3;
+        c.run = 1;
+        while(inner > 0) {
+            int d = order[inner - 1];
+            int64 extent = box.upper[d] - box.lower[d];
+            if(extent > 1 && (from.strides[d] != c.run || to.strides[d] != c.run)) {
+                break;
+            }
+            c.run *= extent;
+            inner--;
+        }
+        for(int j = 0; j < 3; j++) {
+            c.count[j] = 1;
+            c.src_strides[j] = 0;
+            c.dst_strides[j] = 0;
+        }
+        for(int j = 0; j < inner; j++) {
+            int d = order[j];
+            c.count[3 - inner + j] = box.upper[d] - box.lower[d];
+            c.src_strides[3 - inner + j] = from.strides[d];
+            c.dst_strides[3 - inner + j] = to.strides[d];
+        }
+        return c;
+    }
+
+    std::vector<int64> peer_counts(const std::vector<int>& pieces, bool by_src, bool displacements) const {
+        std::vector<int64> counts(size_, 0);
+        for(int t : pieces) {
+            const BoxTransfer& transfer = transfers_[t];
+            if(transfer.src_rank == transfer.dst_rank) {
+                continue;
+            }
+            int peer = by_src ? transfer.src_rank : transfer.dst_rank;
+            if(displacements) {
+                counts[peer] = by_src ? transfer.recv_offset : transfer.send_offset;
+            } else {
+                counts[peer] = box_volume(transfer.box);
+            }
+        }
+        return counts;
+    }
+};
+
+/**
+ * Executes a BoxRedistribution in shared memory: rank r is the host
+ * buffer src[r] before, and dst[r] after. All ranks pack their pieces in
+ * parallel, then every rank unpacks the pieces it receives straight from
+ * the send buffers of its peers. Large pieces are split into chunks of
+ * runs so that a few ranks still keep every thread busy.
+ */
+template<typename T>
+class HostBoxRedistribution {
+public:
+    HostBoxRedistribution(const BoxRedistribution& plan, size_t num_threads = 0)
+        : plan_(plan), pool_(num_threads > 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency())),
+          send_(plan.size()) {
+        for(int rank = 0; rank < plan.size(); rank++) {
+            send_[rank].resize(plan.send_count(rank));
+        }
+        // Pack and local copies first, unpacks second
+        for(int phase = 0; phase < 2; phase++) {
+            for(int t = 0; t < static_cast<int>(plan.transfers().size()); t++) {
+                const BoxTransfer& transfer = plan.transfers()[t];
+                bool local = transfer.src_rank == transfer.dst_rank;
+                if(phase == 1 && local) {
+                    continue;
+                }
+                const BoxCopy& c = phase == 0 ? transfer.pack : transfer.unpack;
+                int64 runs = c.count[0] * c.count[1] * c.count[2];
+                int64 runs_per_chunk = std::max<int64>(1, kChunkElements / c.run);
+                for(int64 first = 0; first < runs; first += runs_per_chunk) {
+                    tasks_[phase].push_back({t, first, std::min(runs, first + runs_per_chunk)});
+                }
+            }
+        }
+    }
+
+    /**
+     * Send buffer of rank, valid after execute()
+     */
+    const std::vector<T>& send_buffer(int rank) const { return send_[rank]; }
+
+    void execute(const std::vector<const T*>& src, const std::vector<T*>& dst) {
+        if(static_cast<int>(src.size()) != plan_.size() || static_cast<int>(dst.size()) != plan_.size()) {
+            throw std::invalid_argument("HostBoxRedistribution: one source and one destination buffer per rank needed");
+        }
+        pool_.enqueue_batch(tasks_[0].size(), [&](int, size_t idx) {
+            const Task& task = tasks_[0][idx];
+            const BoxTransfer& transfer = plan_.transfers()[task.transfer];
+            if(transfer.src_rank == transfer.dst_rank) {
+                BoxRedistribution::copy(transfer.pack, src[transfer.src_rank], dst[transfer.dst_rank], task.first_run, task.last_run);
+            } else {
+                BoxRedistribution::copy(transfer.pack, src[transfer.src_rank], send_[transfer.src_rank].data() + transfer.send_offset,
+                                        task.first_run, task.last_run);
+            }
+        });
+        pool_.wait();
+        pool_.enqueue_batch(tasks_[1].size(), [&](int, size_t idx) {
+            const Task& task = tasks_[1][idx];
+            const BoxTransfer& transfer = plan_.transfers()[task.transfer];
+            BoxRedistribution::copy(transfer.unpack, send_[transfer.src_rank].data() + transfer.send_offset, dst[transfer.dst_rank],
+                                    task.first_run, task.last_run);
+        });
+        pool_.wait();
+    }
+
+private:
+    // Elements copied by one task at most, unless a single run is larger
+    static constexpr int64 kChunkElements = int64(1) << 18;
+
+    struct Task {
+        int transfer;
+        int64 first_run;
+        int64 last_run;
+    };
+
+    const BoxRedistribution& plan_;
+    ThreadPool pool_;
+    std::vector<std::vector<T>> send_;
+    std::vector<Task> tasks_[2];
+};
+
+#endif // __CUFFTMP_BOX_REDISTRIBUTION_HPP__
@@ -0,0 +1,527 @@
+/**
+ * Checks the box-to-box redistribution planner against an element-wise
+ * reference, for slabs, pencils and random box decompositions with padded
+ * and permuted strides, including boxes that leave parts of the
+ * destination uncovered. Plans are executed by HostBoxRedistribution with
+ * several thread counts, and by packing, exchanging through the
+ * MPI_Alltoallv counts and displacements, and unpacking rank by rank.
+ */
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "box_redistribution.hpp"
+#include "test_check.h"
+
+namespace {
+
+using value_type = int64;
+
+// Elements of a destination buffer the redistribution must not write,
+// and padding of the source buffers, which must never be read
+const value_type untouched = -1;
+const value_type src_padding = -2;
+
+value_type value(int64 x, int64 y, int64 z) {
+    return (x * 1000 + y) * 1000 + z + 1;
+}
+
+int64 offset(const Box3D& box, int64 x, int64 y, int64 z) {
+    return (x - box.lower[0]) * box.strides[0] + (y - box.lower[1]) * box.strides[1] + (z - box.lower[2]) * box.strides[2];
+}
+
+bool contains(const Box3D& box, int64 x, int64 y, int64 z) {
+    return x >= box.lower[0] && x < box.upper[0] && y >= box.lower[1] && y < box.upper[1] && z >= box.lower[2] && z < box.upper[2];
+}
+
+/**
+ * Elements spanned by the local buffer of box
+ */
+int64 buffer_size(const Box3D& box) {
+    if(box_volume(box) == 0) {
+        return 0;
+    }
+    int64 size = 1;
+    for(int d = 0; d < 3; d++) {
+        size += (box.upper[d] - box.lower[d] - 1) * box.strides[d];
+    }
+    return size;
+}
+
+template<typename F>
+void for_each_element(const Box3D& box, F f) {
+    for(int64 x = box.lower[0]; x < box.upper[0]; x++) {
+        for(int64 y = box.lower[1]; y < box.upper[1]; y++) {
+            for(int64 z = box.lower[2]; z < box.upper[2]; z++) {
+                f(x, y, z);
+            }
+        }
+    }
+}
+
+/**
+ * Box with the given corners whose axes are laid out slowest first in
+ * order, with pad[j] unused elements after each line of axis order[j] and
+ * an innermost stride of inner
+ */
+Box3D make_strided_box(const int64 lower[3], const int64 upper[3], const int order[3], const int64 pad[3], int64 inner) {
+    Box3D box;
+    int64 stride = inner;
+    for(int j = 2; j >= 0; j--) {
+        int d = order[j];
+        box.lower[d] = lower[d];
+        box.upper[d] = upper[d];
+        box.strides[d] = stride;
+        stride = stride * std::max<int64>(upper[d] - lower[d], 0) + pad[j];
+    }
+    return box;
+}
+
+std::vector<std::vector<value_type>> make_sources(const std::vector<Box3D>& boxes) {
+    std::vector<std::vector<value_type>> src(boxes.size());
+    for(size_t rank = 0; rank < boxes.size(); rank++) {
+        const Box3D& box = boxes[rank];
+        src[rank].assign(buffer_size(box), src_padding);
+        for_each_element(box, [&](int64 x, int64 y, int64 z) { src[rank][offset(box, x, y, z)] = value(x, y, z); });
+    }
+    return src;
+}
+
+/**
+ * Destination buffers as an element-wise redistribution leaves them
+ */
+std::vector<std::vector<value_type>> reference(const std::vector<Box3D>& src_boxes, const std::vector<Box3D>& dst_boxes) {
+    std::vector<std::vector<value_type>> dst(dst_boxes.size());
+    for(size_t rank = 0; rank < dst_boxes.size(); rank++) {
+        const Box3D& box = dst_boxes[rank];
+        dst[rank].assign(buffer_size(box), untouched);
+        for_each_element(box, [&](int64 x, int64 y, int64 z) {
+            for(const Box3D& src_box : src_boxes) {
+                if(contains(src_box, x, y, z)) {
+                    dst[rank][offset(box, x, y, z)] = value(x, y, z);
+                }
+            }
+        });
+    }
+    return dst;
+}
+
+std::vector<std::vector<value_type>> make_destinations(const std::vector<Box3D>& boxes) {
+    std::vector<std::vector<value_type>> dst(boxes.size());
+    for(size_t rank = 0; rank < boxes.size(); rank++) {
+        dst[rank].assign(buffer_size(boxes[rank]), untouched);
+    }
+    return dst;
+}
+
+template<typename V>
+std::vector<const value_type*> const_pointers(const V& buffers) {
+    std::vector<const value_type*> pointers;
+    for(const auto& buffer : buffers) {
+        pointers.push_back(buffer.data());
+    }
+    return pointers;
+}
+
+template<typename V>
+std::vector<value_type*> pointers(V& buffers) {
+    std::vector<value_type*> result;
+    for(auto& buffer : buffers) {
+        result.push_back(buffer.data());
+    }
+    return result;
+}
+
+/**
+ * Counts and displacements of every rank follow the MPI_Alltoallv layout
+ * and agree between the two sides of every exchange, and every copy
+ * covers its piece
+ */
+bool plan_consistent(const BoxRedistribution& plan) {
+    bool ok = true;
+    int size = plan.size();
+    for(int rank = 0; rank < size; rank++) {
+        std::vector<int64> send_counts = plan.send_counts(rank);
+        std::vector<int64> send_displs = plan.send_displacements(rank);
+        std::vector<int64> recv_counts = plan.recv_counts(rank);
+        std::vector<int64> recv_displs = plan.recv_displacements(rank);
+        ok &= send_counts[rank] == 0 && recv_counts[rank] == 0;
+        int64 send_total = 0, recv_total = 0;
+        for(int peer = 0; peer < size; peer++) {
+            if(send_counts[peer] > 0) {
+                ok &= send_displs[peer] == send_total;
+            }
+            if(recv_counts[peer] > 0) {
+                ok &= recv_displs[peer] == recv_total;
+            }
+            send_total += send_counts[peer];
+            recv_total += recv_counts[peer];
+            ok &= send_counts[peer] == plan.recv_counts(peer)[rank];
+        }
+        ok &= send_total == plan.send_count(rank) && recv_total == plan.recv_count(rank);
+    }
+    for(const BoxTransfer& t : plan.transfers()) {
+        int64 volume = box_volume(t.box);
+        ok &= volume > 0;
+        for(const BoxCopy* c : {&t.pack, &t.unpack}) {
+            ok &= c->run * c->count[0] * c->count[1] * c->count[2] == volume;
+        }
+    }
+    return ok;
+}
+
+/**
+ * Redistributes src through the plan as MPI ranks would: every rank packs
+ * its send buffer, the buffers are exchanged with the counts and
+ * displacements of the plan, and every rank unpacks and copies its local
+ * piece
+ */
+std::vector<std::vector<value_type>> exchange(const BoxRedistribution& plan, const std::vector<std::vector<value_type>>& src,
+                                              const std::vector<Box3D>& dst_boxes, std::vector<std::vector<value_type>>& send) {
+    int size = plan.size();
+    send.assign(size, std::vector<value_type>());
+    for(int rank = 0; rank < size; rank++) {
+        send[rank].assign(plan.send_count(rank), untouched);
+        plan.pack(rank, src[rank].data(), send[rank].data());
+    }
+    std::vector<std::vector<value_type>> dst = make_destinations(dst_boxes);
+    for(int rank = 0; rank < size; rank++) {
+        std::vector<value_type> recv(plan.recv_count(rank), untouched);
+        std::vector<int64> recv_displs = plan.recv_displacements(rank);
+        for(int peer = 0; peer < size; peer++) {
+            int64 count = plan.send_counts(peer)[rank];
+            int64 displ = plan.send_displacements(peer)[rank];
+            std::copy(send[peer].begin() + displ, send[peer].begin() + displ + count, recv.begin() + recv_displs[peer]);
+        }
+        plan.unpack(rank, recv.data(), dst[rank].data());
+        plan.copy_local(rank, src[rank].data(), dst[rank].data());
+    }
+    return dst;
+}
+
+/**
+ * Redistributes src_boxes to dst_boxes both ways and compares with the
+ * reference
+ */
+void check_redistribution(const std::vector<Box3D>& src_boxes, const std::vector<Box3D>& dst_boxes, size_t num_threads) {
+    BoxRedistribution plan(src_boxes, dst_boxes);
+    CHECK(plan.size() == static_cast<int>(src_boxes.size()));
+    CHECK(plan_consistent(plan));
+
+    std::vector<std::vector<value_type>> src = make_sources(src_boxes);
+    std::vector<std::vector<value_type>> expected = reference(src_boxes, dst_boxes);
+
+    std::vector<std::vector<value_type>> send;
+    CHECK(exchange(plan, src, dst_boxes, send) == expected);
+
+    HostBoxRedistribution<value_type> host(plan, num_threads);
+    std::vector<std::vector<value_type>> dst = make_destinations(dst_boxes);
+    host.execute(const_pointers(src), pointers(dst));
+    CHECK(dst == expected);
+    bool same_send = true;
+    for(int rank = 0; rank < plan.size(); rank++) {
+        same_send &= host.send_buffer(rank) == send[rank];
+    }
+    CHECK(same_send);
+
+    // A plan runs any number of times
+    dst = make_destinations(dst_boxes);
+    host.execute(const_pointers(src), pointers(dst));
+    CHECK(dst == expected);
+}
+
+/**
+ * Random split of nx x ny x nz into size boxes: a grid of random cuts,
+ * some of which may coincide and give empty boxes, assigned to ranks in
+ * random order, with random axis orders and padding. With shrink, some
+ * boxes lose their last plane along an axis, leaving elements uncovered.
+ */
+std::vector<Box3D> random_boxes(std::mt19937& rng, const int64 n[3], int size, bool shrink) {
+    auto uniform = [&](int64 lo, int64 hi) { return std::uniform_int_distribution<int64>(lo, hi)(rng); };
+    std::vector<int> divisors;
+    for(int p = 1; p <= size; p++) {
+        if(size % p == 0) {
+            divisors.push_back(p);
+        }
+    }
+    int parts[3];
+    parts[0] = divisors[uniform(0, divisors.size() - 1)];
+    divisors.clear();
+    for(int p = 1; p <= size / parts[0]; p++) {
+        if(size / parts[0] % p == 0) {
+            divisors.push_back(p);
+        }
+    }
+    parts[1] = divisors[uniform(0, divisors.size() - 1)];
+    parts[2] = size / parts[0] / parts[1];
+
+    std::vector<int64> cuts[3];
+    for(int d = 0; d < 3; d++) {
+        cuts[d].push_back(0);
+        for(int p = 1; p < parts[d]; p++) {
+            cuts[d].push_back(uniform(0, n[d]));
+        }
+        cuts[d].push_back(n[d]);
+        std::sort(cuts[d].begin(), cuts[d].end());
+    }
+
+    std::vector<int> ranks(size);
+    std::iota(ranks.begin(), ranks.end(), 0);
+    std::shuffle(ranks.begin(), ranks.end(), rng);
+    std::vector<Box3D> boxes(size);
+    int idx = 0;
+    for(int i = 0; i < parts[0]; i++) {
+        for(int j = 0; j < parts[1]; j++) {
+            for(int k = 0; k < parts[2]; k++) {
+                int64 lower[3] = {cuts[0][i], cuts[1][j], cuts[2][k]};
+                int64 upper[3] = {cuts[0][i + 1], cuts[1][j + 1], cuts[2][k + 1]};
+                if(shrink && uniform(0, 3) == 0) {
+                    int d = uniform(0, 2);
+                    upper[d] = std::max(lower[d], upper[d] - 1);
+                }
+                int order[3] = {0, 1, 2};
+                std::shuffle(order, order + 3, rng);
+                const int64 pads[4] = {0, 0, 1, 3};
+                int64 pad[3] = {pads[uniform(0, 3)], pads[uniform(0, 3)], pads[uniform(0, 3)]};
+                int64 inner = uniform(0, 4) == 0 ? 2 : 1;
+                boxes[ranks[idx++]] = make_strided_box(lower, upper, order, pad, inner);
+            }
+        }
+    }
+    return boxes;
+}
+
+void test_builders() {
+    // Slabs and pencils cover the array once, the first ranks holding one
+    // extra element when the split is uneven
+    const int64 origin[3] = {0, 0, 0};
+    const int64 n[3] = {10, 7, 5};
+    for(int axis = 0; axis < 3; axis++) {
+        std::vector<Box3D> slabs = build_slab_boxes(n[0], n[1], n[2], axis, 3);
+        CHECK(slabs.size() == 3);
+        bool covered = true;
+        for_each_element(make_box3d(origin, n), [&](int64 x, int64 y, int64 z) {
+            int owners = 0;
+            for(const Box3D& box : slabs) {
+                owners += contains(box, x, y, z);
+            }
+            covered &= owners == 1;
+        });
+        CHECK(covered);
+        int64 expected[3] = {n[axis] / 3 + (n[axis] % 3 > 0), n[axis] / 3 + (n[axis] % 3 > 1), n[axis] / 3};
+        for(int rank = 0; rank < 3; rank++) {
+            CHECK(slabs[rank].upper[axis] - slabs[rank].lower[axis] == expected[rank]);
+            CHECK(slabs[rank].strides[2] == 1);
+            CHECK(slabs[rank].strides[1] == slabs[rank].upper[2] - slabs[rank].lower[2]);
+        }
+    }
+
+    std::vector<Box3D> pencils = build_pencil_boxes(n[0], n[1], n[2], 0, 3, 2, 2);
+    CHECK(pencils.size() == 6);
+    bool covered = true;
+    for_each_element(make_box3d(origin, n), [&](int64 x, int64 y, int64 z) {
+        int owners = 0;
+        for(const Box3D& box : pencils) {
+            owners += contains(box, x, y, z);
+        }
+        covered &= owners == 1;
+    });
+    CHECK(covered);
+    // Rank 3 holds part 1 of 3 along X and part 1 of 2 along Z
+    CHECK(pencils[3].lower[0] == 4 && pencils[3].upper[0] == 7);
+    CHECK(pencils[3].lower[2] == 3 && pencils[3].upper[2] == 5);
+    CHECK(pencils[3].lower[1] == 0 && pencils[3].upper[1] == 7);
+}
+
+void test_slabs_and_pencils() {
+    const int64 nx = 13, ny = 9, nz = 11;
+    for(int size : {1, 2, 4, 6}) {
+        for(int from = 0; from < 3; from++) {
+            for(int to = 0; to < 3; to++) {
+                check_redistribution(build_slab_boxes(nx, ny, nz, from, size), build_slab_boxes(nx, ny, nz, to, size), 3);
+            }
+        }
+    }
+    // Pencils to slabs and back, as in the sample, and pencils to pencils
+    check_redistribution(build_pencil_boxes(nx, ny, nz, 0, 2, 1, 3), build_slab_boxes(nx, ny, nz, 2, 6), 4);
+    check_redistribution(build_slab_boxes(nx, ny, nz, 2, 6), build_pencil_boxes(nx, ny, nz, 0, 2, 1, 3), 4);
+    check_redistribution(build_pencil_boxes(nx, ny, nz, 0, 2, 1, 3), build_pencil_boxes(nx, ny, nz, 1, 3, 2, 2), 2);
+}
+
+void test_runs() {
+    // Identical contiguous decompositions keep every piece local and copy
+    // it as a single run
+    std::vector<Box3D> slabs = build_slab_boxes(8, 6, 5, 0, 4);
+    BoxRedistribution same(slabs, slabs);
+    CHECK(same.transfers().size() == 4);
+    bool single_runs = true;
+    for(int rank = 0; rank < 4; rank++) {
+        CHECK(same.send_count(rank) == 0 && same.recv_count(rank) == 0);
+    }
+    for(const BoxTransfer& t : same.transfers()) {
+        single_runs &= t.src_rank == t.dst_rank && t.pack.run == box_volume(t.box);
+        single_runs &= t.pack.count[0] == 1 && t.pack.count[1] == 1 && t.pack.count[2] == 1;
+    }
+    CHECK(single_runs);
+
+    // X-slabs to Z-slabs: copies out of a source slab read runs of the Z
+    // extent of a destination slab, while a packed piece already has the
+    // layout of its destination and is unpacked as a single run
+    BoxRedistribution x_to_z(build_slab_boxes(8, 6, 10, 0, 2), build_slab_boxes(8, 6, 10, 2, 2));
+    CHECK(plan_consistent(x_to_z));
+    bool runs = true;
+    for(const BoxTransfer& t : x_to_z.transfers()) {
+        runs &= t.pack.run == 5 && t.pack.count[0] == 1 && t.pack.count[1] == 4 && t.pack.count[2] == 6;
+        if(t.src_rank != t.dst_rank) {
+            runs &= t.unpack.run == 120;
+        }
+    }
+    CHECK(runs);
+
+    // Packed pieces follow the memory order of their source box, so
+    // packing a transposed source reads its X runs
+    const int transposed[3] = {2, 1, 0};
+    const int64 no_pad[3] = {0, 0, 0};
+    std::vector<Box3D> transposed_slabs = build_slab_boxes(4, 6, 5, 1, 2);
+    for(Box3D& box : transposed_slabs) {
+        box = make_strided_box(box.lower, box.upper, transposed, no_pad, 1);
+    }
+    BoxRedistribution from_transposed(transposed_slabs, build_slab_boxes(4, 6, 5, 0, 2));
+    CHECK(plan_consistent(from_transposed));
+    bool source_order = true;
+    for(const BoxTransfer& t : from_transposed.transfers()) {
+        source_order &= t.box.strides[0] == 1 && t.box.strides[1] == 2 && t.box.strides[2] == 6;
+        source_order &= t.pack.run == 2 || t.src_rank == t.dst_rank;
+    }
+    CHECK(source_order);
+
+    // Axes of extent 1 never end a run, whatever their strides
+    const int64 origin[3] = {0, 0, 0};
+    const int64 upper[3] = {3, 1, 5};
+    Box3D flat_src = make_box3d(origin, upper);
+    Box3D flat_dst = flat_src;
+    flat_dst.strides[1] = 3;
+    BoxRedistribution flat({flat_src}, {flat_dst});
+    CHECK(flat.transfers().size() == 1 && flat.transfers()[0].pack.run == 15);
+    check_redistribution({flat_src}, {flat_dst}, 1);
+
+    // A copy split into any ranges of runs copies the same elements
+    std::mt19937 rng(5);
+    int64 n[3] = {7, 9, 6};
+    std::vector<Box3D> src_boxes = random_boxes(rng, n, 4, false);
+    std::vector<Box3D> dst_boxes = random_boxes(rng, n, 4, false);
+    BoxRedistribution plan(src_boxes, dst_boxes);
+    std::vector<std::vector<value_type>> src = make_sources(src_boxes);
+    bool split_same = true;
+    for(const BoxTransfer& t : plan.transfers()) {
+        const BoxCopy& c = t.pack;
+        int64 runs_total = c.count[0] * c.count[1] * c.count[2];
+        int64 extent = t.src_rank == t.dst_rank ? buffer_size(dst_boxes[t.dst_rank]) : box_volume(t.box);
+        std::vector<value_type> whole(extent, untouched), split(extent, untouched);
+        BoxRedistribution::copy(c, src[t.src_rank].data(), whole.data());
+        int64 first = 0;
+        while(first < runs_total) {
+            int64 last = std::min(runs_total, first + std::uniform_int_distribution<int64>(1, 7)(rng));
+            BoxRedistribution::copy(c, src[t.src_rank].data(), split.data(), first, last);
+            first = last;
+        }
+        // Empty and inverted ranges copy nothing
+        BoxRedistribution::copy(c, src[t.src_rank].data(), split.data(), runs_total, runs_total);
+        BoxRedistribution::copy(c, src[t.src_rank].data(), split.data(), 1, 0);
+        split_same &= whole == split;
+    }
+    CHECK(split_same);
+}
+
+void test_random() {
+    std::mt19937 rng(2022);
+    for(int iteration = 0; iteration < 300; iteration++) {
+        int64 n[3];
+        for(int d = 0; d < 3; d++) {
+            n[d] = std::uniform_int_distribution<int64>(1, 12)(rng);
+        }
+        int size = std::uniform_int_distribution<int>(1, 8)(rng);
+        bool shrink = iteration % 3 == 0;
+        std::vector<Box3D> src_boxes = random_boxes(rng, n, size, shrink);
+        std::vector<Box3D> dst_boxes = random_boxes(rng, n, size, false);
+        check_redistribution(src_boxes, dst_boxes, 1 + iteration % 4);
+    }
+}
+
+void test_uncovered() {
+    // Destination boxes reaching past the source array, and a rank with an
+    // empty source box: elements no source holds stay untouched
+    const int64 n[3] = {6, 5, 4};
+    std::vector<Box3D> src_boxes = build_slab_boxes(n[0], n[1], n[2], 1, 3);
+    int64 lower[3] = {0, 0, 0};
+    src_boxes[1] = make_box3d(lower, lower);
+    std::vector<Box3D> dst_boxes = build_slab_boxes(n[0] + 2, n[1], n[2] + 3, 0, 3);
+    check_redistribution(src_boxes, dst_boxes, 2);
+}
+
+void test_chunks() {
+    // Pieces of more than kChunkElements runs are split into several tasks:
+    // one rank transposing its box, and two ranks swapping halves of
+    // transposed boxes
+    const int64 n[3] = {72, 64, 64};
+    int64 lower[3] = {0, 0, 0};
+    const int row_major[3] = {0, 1, 2};
+    const int transposed[3] = {2, 1, 0};
+    const int64 no_pad[3] = {0, 0, 0};
+    std::vector<Box3D> src_boxes = {make_strided_box(lower, n, row_major, no_pad, 1)};
+    std::vector<Box3D> dst_boxes = {make_strided_box(lower, n, transposed, no_pad, 1)};
+    check_redistribution(src_boxes, dst_boxes, 4);
+
+    src_boxes = build_slab_boxes(2 * n[0], 2 * n[1], n[2], 0, 2);
+    dst_boxes = build_slab_boxes(2 * n[0], 2 * n[1], n[2], 1, 2);
+    for(Box3D& box : dst_boxes) {
+        box = make_strided_box(box.lower, box.upper, transposed, no_pad, 1);
+    }
+    check_redistribution(src_boxes, dst_boxes, 3);
+}
+
+void test_invalid() {
+    std::vector<Box3D> two = build_slab_boxes(4, 4, 4, 0, 2);
+    std::vector<Box3D> three = build_slab_boxes(4, 4, 4, 0, 3);
+    int thrown = 0;
+    try {
+        BoxRedistribution plan(two, three);
+    } catch(const std::invalid_argument&) {
+        thrown++;
+    }
+    try {
+        BoxRedistribution plan({}, {});
+    } catch(const std::invalid_argument&) {
+        thrown++;
+    }
+    CHECK(thrown == 2);
+
+    BoxRedistribution plan(two, two);
+    HostBoxRedistribution<value_type> host(plan, 1);
+    std::vector<std::vector<value_type>> src = make_sources(two);
+    std::vector<std::vector<value_type>> dst = make_destinations(two);
+    std::vector<value_type*> one_dst = {dst[0].data()};
+    bool rejected = false;
+    try {
+        host.execute(const_pointers(src), one_dst);
+    } catch(const std::invalid_argument&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+}
+
+}  // namespace
+
+int main() {
+    test_builders();
+    test_slabs_and_pencils();
+    test_runs();
+    test_random();
+    test_uncovered();
+    test_chunks();
+    test_invalid();
+    return test_result("box_redistribution_test");
+}
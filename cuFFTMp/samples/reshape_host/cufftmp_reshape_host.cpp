@@ -0,0 +1,136 @@
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <complex>
+#include <iostream>
+
+#include "../iterators/box_redistribution.hpp"
+
+/**
+ * Host-only pencil to slab redistribution of an nx x ny x nz complex
+ * array over P simulated ranks, with the BoxRedistribution planner.
+ *
+ * Usage: cufftmp_reshape_host [nx ny nz P0 P1 threads iterations]
+ * The source is split in P0 x P1 pencils along X and Y, the destination
+ * in P0 * P1 slabs along Z.
+ */
+
+using data_type = std::complex<float>;
+
+data_type value(int64 x, int64 y, int64 z) {
+    return data_type(float(x * 1000 + y), float(z));
+}
+
+// Element-wise redistribution, mapping every linear index of each
+// intersection back to 3D coordinates as BoxIterator does
+void redistribute_elementwise(const std::vector<Box3D>& src_boxes, const std::vector<Box3D>& dst_boxes,
+                              const std::vector<const data_type*>& src, const std::vector<data_type*>& dst) {
+    int size = src_boxes.size();
+    for(int s = 0; s < size; s++) {
+        for(int d = 0; d < size; d++) {
+            const Box3D& a = src_boxes[s];
+            const Box3D& b = dst_boxes[d];
+            int64 lower[3], upper[3];
+            for(int k = 0; k < 3; k++) {
+                lower[k] = std::max(a.lower[k], b.lower[k]);
+                upper[k] = std::min(a.upper[k], b.upper[k]);
+            }
+            int64 ly = upper[1] - lower[1], lz = upper[2] - lower[2];
+            int64 n = std::max<int64>(upper[0] - lower[0], 0) * std::max<int64>(ly, 0) * std::max<int64>(lz, 0);
+            for(int64 i = 0; i < n; i++) {
+                int64 x = lower[0] + i / (ly * lz);
+                int64 y = lower[1] + i / lz % ly;
+                int64 z = lower[2] + i % lz;
+                dst[d][(x - b.lower[0]) * b.strides[0] + (y - b.lower[1]) * b.strides[1] + (z - b.lower[2]) * b.strides[2]] =
+                    src[s][(x - a.lower[0]) * a.strides[0] + (y - a.lower[1]) * a.strides[1] + (z - a.lower[2]) * a.strides[2]];
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+
+    int64 nx = argc > 1 ? atoll(argv[1]) : 256;
+    int64 ny = argc > 2 ? atoll(argv[2]) : 256;
+    int64 nz = argc > 3 ? atoll(argv[3]) : 256;
+    int p0 = argc > 4 ? atoi(argv[4]) : 2;
+    int p1 = argc > 5 ? atoi(argv[5]) : 4;
+    int threads = argc > 6 ? atoi(argv[6]) : 0;
+    int iterations = argc > 7 ? atoi(argv[7]) : 10;
+    int size = p0 * p1;
+    if(nx <= 0 || ny <= 0 || nz <= 0 || p0 <= 0 || p1 <= 0 || threads < 0 || iterations <= 0) {
+        printf("Usage: %s [nx ny nz P0 P1 threads iterations]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<Box3D> src_boxes = build_pencil_boxes(nx, ny, nz, 0, p0, 1, p1);
+    std::vector<Box3D> dst_boxes = build_slab_boxes(nx, ny, nz, 2, size);
+
+    auto start = std::chrono::steady_clock::now();
+    BoxRedistribution plan(src_boxes, dst_boxes);
+    double plan_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    HostBoxRedistribution<data_type> host(plan, threads);
+
+    int64 runs = 0, elements = 0;
+    for(const BoxTransfer& t : plan.transfers()) {
+        const BoxCopy& c = t.src_rank == t.dst_rank ? t.pack : t.unpack;
+        runs += c.count[0] * c.count[1] * c.count[2];
+        elements += box_volume(t.box);
+    }
+    printf("Redistributing %lld x %lld x %lld from %d x %d pencils to %d Z-slabs\n", nx, ny, nz, p0, p1, size);
+    printf("Plan: %zu pieces, %lld unpack runs of %.1f elements on average, built in %.3f ms\n",
+           plan.transfers().size(), runs, double(elements) / std::max<int64>(runs, 1), plan_ms);
+
+    std::vector<std::vector<data_type>> src(size), dst(size), dst_expected(size);
+    std::vector<const data_type*> src_ptr(size);
+    std::vector<data_type*> dst_ptr(size), dst_expected_ptr(size);
+    for(int rank = 0; rank < size; rank++) {
+        const Box3D& box = src_boxes[rank];
+        src[rank].resize(box_volume(box));
+        for(int64 x = box.lower[0]; x < box.upper[0]; x++)
+            for(int64 y = box.lower[1]; y < box.upper[1]; y++)
+                for(int64 z = box.lower[2]; z < box.upper[2]; z++)
+                    src[rank][(x - box.lower[0]) * box.strides[0] + (y - box.lower[1]) * box.strides[1] + (z - box.lower[2]) * box.strides[2]] = value(x, y, z);
+        dst[rank].resize(box_volume(dst_boxes[rank]));
+        dst_expected[rank].resize(box_volume(dst_boxes[rank]));
+        src_ptr[rank] = src[rank].data();
+        dst_ptr[rank] = dst[rank].data();
+        dst_expected_ptr[rank] = dst_expected[rank].data();
+    }
+
+    start = std::chrono::steady_clock::now();
+    redistribute_elementwise(src_boxes, dst_boxes, src_ptr, dst_expected_ptr);
+    double elementwise_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    host.execute(src_ptr, dst_ptr);
+    start = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; i++) {
+        host.execute(src_ptr, dst_ptr);
+    }
+    double plan_exec_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+    // Read and written once
+    double gb = 2.0 * elements * sizeof(data_type) * 1e-9;
+    printf("Element-wise: %.3f ms, %.2f GB/s\n", elementwise_ms, gb / (elementwise_ms * 1e-3));
+    printf("Planned, pack + unpack: %.3f ms, %.2f GB/s\n", plan_exec_ms, gb / (plan_exec_ms * 1e-3));
+
+    int errors = 0;
+    for(int rank = 0; rank < size; rank++) {
+        const Box3D& box = dst_boxes[rank];
+        for(int64 x = box.lower[0]; x < box.upper[0]; x++)
+            for(int64 y = box.lower[1]; y < box.upper[1]; y++)
+                for(int64 z = box.lower[2]; z < box.upper[2]; z++) {
+                    int64 i = (x - box.lower[0]) * box.strides[0] + (y - box.lower[1]) * box.strides[1] + (z - box.lower[2]) * box.strides[2];
+                    if(dst[rank][i] != value(x, y, z) || dst_expected[rank][i] != value(x, y, z)) errors++;
+                }
+    }
+
+    if(errors == 0) {
+        std::cout << "PASSED\n";
+        return 0;
+    } else {
+        std::cout << "FAILED with " << errors << " errors\n";
+        return 1;
+    }
+}
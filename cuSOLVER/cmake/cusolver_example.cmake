@@ -27,6 +27,8 @@
 # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 # 
 
+find_package(Threads REQUIRED)
+
 function(add_cusolver_example GROUP_TARGET EXAMPLE_NAME EXAMPLE_SOURCES)
 add_executable(${EXAMPLE_NAME} ${EXAMPLE_SOURCES})
 set_property(TARGET ${EXAMPLE_NAME} PROPERTY CUDA_ARCHITECTURES OFF)
@@ -41,6 +43,7 @@ target_link_libraries(${EXAMPLE_NAME}
         cublasLt
         cusparse
         cusolverMg
+        Threads::Threads
 )
 set_target_properties(${EXAMPLE_NAME} PROPERTIES
     POSITION_INDEPENDENT_CODE ON
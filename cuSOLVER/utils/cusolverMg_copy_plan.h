@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+/*
+ * Host-only plan of the copies between a host matrix B and the region
+ * A(IA:IA+M-1, JA:JA+N-1) of a matrix A distributed 1D block-cyclic over
+ * column tiles of T_A columns: tile k lives on device k % num_devices, as
+ * local tile k / num_devices of that device (see mat_pack2unpack).
+ *
+ * The plan only holds element offsets and needs no CUDA, so it can be
+ * checked on the host for any N_A, T_A and device count (see tests/).
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+/* staging buffer size per buffer and device for pageable host matrices */
+#ifndef MG_STAGING_BYTES
+#define MG_STAGING_BYTES (static_cast<size_t>(32) << 20)
+#endif /* MG_STAGING_BYTES */
+
+/* copies up to this size are issued directly from the calling thread */
+#ifndef MG_DIRECT_BYTES
+#define MG_DIRECT_BYTES (static_cast<size_t>(1) << 20)
+#endif /* MG_DIRECT_BYTES */
+
+/* pointers to the column tiles of the distributed A, by global tile index */
+template <typename T_ELEM>
+static void
+mat_pack2unpack(int num_devices, int N_A,   /* number of columns of global A */
+                int T_A,                    /* number of columns per column tile */
+                int LLD_A,                  /* leading dimension of local A */
+                T_ELEM **array_d_A_packed,  /* host pointer array of dimension num_devices */
+                                            /* output */
+                T_ELEM **array_d_A_unpacked /* host pointer array of dimension num_blks */
+) {
+    const int num_blks = (N_A + T_A - 1) / T_A;
+
+    for (int p_a = 0; p_a < num_devices; p_a++) {
+        T_ELEM *d_A = array_d_A_packed[p_a];
+        int nz_blks = 0;
+        for (int JA_blk_id = p_a; JA_blk_id < num_blks; JA_blk_id += num_devices) {
+            array_d_A_unpacked[JA_blk_id] = d_A + static_cast<size_t>(LLD_A) * T_A * nz_blks;
+            nz_blks++;
+        }
+    }
+}
+
+/* rows x cols elements between B(host_offset), pitch ldb, and A_p(device_offset), pitch LLD_A */
+struct MgTileCopy {
+    int device;           /* index in deviceIdA and array_d_A_packed */
+    size_t host_offset;   /* element offset in h_B */
+    size_t device_offset; /* element offset in array_d_A_packed[device] */
+    int rows;
+    int cols;
+};
+
+struct MgCopyPlan {
+    int num_devices;
+    int host_pitch;   /* ldb */
+    int device_pitch; /* LLD_A */
+    /* copies[p]: the copies of device p by increasing column, consecutive */
+    /* tiles merged whenever they are contiguous on both sides */
+    std::vector<std::vector<MgTileCopy>> copies;
+};
+
+/* cols columns of B(host_offset), staged at staging_offset with pitch rows */
+struct MgStagedCopy {
+    size_t host_offset;
+    size_t staging_offset;
+    int cols;
+};
+
+/* rows x cols elements of A_p(device_offset), staged contiguously with pitch rows */
+struct MgStagingBatch {
+    size_t device_offset;
+    int rows;
+    int cols;
+    std::vector<MgStagedCopy> pieces;
+};
+
+inline MgCopyPlan makeMgCopyPlan(int num_devices, int M, /* number of rows in local A, B */
+                                 int N,                  /* number of columns in local A, B */
+                                 int ldb,                /* leading dimension of B */
+                                 int N_A,                /* number of columns of global A */
+                                 int T_A,                /* number of columns per column tile */
+                                 int LLD_A,              /* leading dimension of local A */
+                                 int IA,                 /* base-1 */
+                                 int JA                  /* base-1 */
+) {
+    MgCopyPlan plan;
+    plan.num_devices = num_devices;
+    plan.host_pitch = ldb;
+    plan.device_pitch = LLD_A;
+    plan.copies.resize(std::max(num_devices, 0));
+
+    /*  Quick return if possible */
+    if ((0 >= M) || (0 >= N)) {
+        return plan;
+    }
+
+    /* consistent checking */
+    if (num_devices <= 0 || T_A <= 0 || ldb < M || LLD_A < IA - 1 + M || N_A < JA - 1 + N) {
+        throw std::runtime_error("Consistency Error.");
+    }
+
+    /* region of interest is A(IA:IA+M-1, JA:JA+N-1) */
+    const int N_hat = (JA - 1) + N; /* JA is base-1 */
+    const int JA_start_blk_id = (JA - 1) / T_A;
+    const int JA_end_blk_id = (N_hat - 1) / T_A;
+
+    for (int JA_blk_id = JA_start_blk_id; JA_blk_id <= JA_end_blk_id; JA_blk_id++) {
+        const int p_a = JA_blk_id % num_devices;
+        const int IBX_A = (1 + JA_blk_id * T_A);     /* base-1 */
+        const int A_start_col = std::max(JA, IBX_A); /* base-1 */
+        const int bdd = std::min(N_hat, (IBX_A + T_A - 1));
+        const int IT_A = bdd - A_start_col + 1;
+        const int loc_A_start_col = (A_start_col - IBX_A) + 1; /* base-1 */
+
+        MgTileCopy copy;
+        copy.device = p_a;
+        copy.host_offset = static_cast<size_t>(A_start_col - JA) * ldb;
+        copy.device_offset = static_cast<size_t>(LLD_A) * T_A * (JA_blk_id / num_devices) +
+                             static_cast<size_t>(loc_A_start_col - 1) * LLD_A + (IA - 1);
+        copy.rows = M;
+        copy.cols = IT_A;
+
+        std::vector<MgTileCopy> &copies = plan.copies[p_a];
+        if (!copies.empty()) {
+            MgTileCopy &last = copies.back();
+            if (last.host_offset + static_cast<size_t>(last.cols) * ldb == copy.host_offset &&
+                last.device_offset + static_cast<size_t>(last.cols) * LLD_A == copy.device_offset) {
+                last.cols += copy.cols;
+                continue;
+            }
+        }
+        copies.push_back(copy);
+    }
+    return plan;
+}
+
+inline size_t mgCopyPlanElements(const MgCopyPlan &plan) {
+    size_t elements = 0;
+    for (const std::vector<MgTileCopy> &copies : plan.copies) {
+        for (const MgTileCopy &copy : copies) {
+            elements += static_cast<size_t>(copy.rows) * copy.cols;
+        }
+    }
+    return elements;
+}
+
+/*
+ * Columns per staging batch of device, for elements of element_size bytes: a batch fits in
+ * MG_STAGING_BYTES, unless a single column is larger
+ */
+inline int mgStagingBatchCols(const MgCopyPlan &plan, int device, size_t element_size) {
+    if (plan.copies[device].empty()) {
+        return 1;
+    }
+    const size_t column_bytes = static_cast<size_t>(plan.copies[device].front().rows) * element_size;
+    return static_cast<int>(std::min<size_t>(std::max<size_t>(1, MG_STAGING_BYTES / column_bytes),
+                                             std::numeric_limits<int>::max()));
+}
+
+/*
+ * Splits the copies of one device into batches of at most batch_cols columns whose device
+ * columns are contiguous, so that each batch moves with a single 2D copy from or to a staging
+ * buffer holding the batch with pitch rows.
+ */
+inline std::vector<MgStagingBatch> makeMgStagingBatches(const MgCopyPlan &plan, int device,
+                                                        int batch_cols) {
+    std::vector<MgStagingBatch> batches;
+    batch_cols = std::max(batch_cols, 1);
+    const size_t ldb = plan.host_pitch;
+    const size_t LLD_A = plan.device_pitch;
+    for (const MgTileCopy &copy : plan.copies[device]) {
+        for (int col = 0; col < copy.cols;) {
+            const size_t device_offset = copy.device_offset + col * LLD_A;
+            bool extend = false;
+            if (!batches.empty()) {
+                const MgStagingBatch &last = batches.back();
+                extend = last.cols < batch_cols && last.rows == copy.rows &&
+                         last.device_offset + last.cols * LLD_A == device_offset;
+            }
+            if (!extend) {
+                MgStagingBatch batch;
+                batch.device_offset = device_offset;
+                batch.rows = copy.rows;
+                batch.cols = 0;
+                batches.push_back(batch);
+            }
+            MgStagingBatch &batch = batches.back();
+            const int cols = std::min(copy.cols - col, batch_cols - batch.cols);
+            MgStagedCopy piece;
+            piece.host_offset = copy.host_offset + col * ldb;
+            piece.staging_offset = static_cast<size_t>(batch.cols) * batch.rows;
+            piece.cols = cols;
+            batch.pieces.push_back(piece);
+            batch.cols += cols;
+            col += cols;
+        }
+    }
+    return batches;
+}
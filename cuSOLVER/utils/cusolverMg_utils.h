@@ -30,8 +30,13 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <exception>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
+#include "cusolverMg_copy_plan.h"
 #include "cusolver_utils.h"
 
 #ifndef IDX2F
@@ -156,23 +161,176 @@ static void destroyMat(int num_devices, const int *deviceIdA, /* <int> dimension
     CUDA_CHECK(cudaSetDevice(currentDev));
 }
 
+/*
+ * Copies between h_B and the distributed A following plan, with one host thread and one stream
+ * per device so that the copies of all devices overlap. A pinned h_B is copied directly, tile
+ * run by tile run. A pageable h_B goes through two pinned staging buffers per device: the host
+ * thread gathers (H2D) or scatters (D2H) one buffer while the other is in flight. Copies of at
+ * most MG_DIRECT_BYTES are issued synchronously from the calling thread.
+ */
 template <typename T_ELEM>
-static void
-mat_pack2unpack(int num_devices, int N_A,   /* number of columns of global A */
-                int T_A,                    /* number of columns per column tile */
-                int LLD_A,                  /* leading dimension of local A */
-                T_ELEM **array_d_A_packed,  /* host pointer array of dimension num_devices */
-                                            /* output */
-                T_ELEM **array_d_A_unpacked /* host pointer array of dimension num_blks */
-) {
-    const int num_blks = (N_A + T_A - 1) / T_A;
+static void memcpyTiles(const MgCopyPlan &plan,
+                        const int *deviceIdA,      /* <int> dimension num_devices */
+                        T_ELEM **array_d_A_packed, /* host pointer array of dimension num_devices */
+                        T_ELEM *h_B,               /* host array, leading dimension host_pitch */
+                        cudaMemcpyKind kind) {
+    const bool to_device = (kind == cudaMemcpyHostToDevice);
+    const size_t ldb_bytes = static_cast<size_t>(plan.host_pitch) * sizeof(T_ELEM);
+    const size_t lld_bytes = static_cast<size_t>(plan.device_pitch) * sizeof(T_ELEM);
+
+    if (mgCopyPlanElements(plan) * sizeof(T_ELEM) <= MG_DIRECT_BYTES) {
+        CUDA_CHECK(cudaDeviceSynchronize());
+        for (int p = 0; p < plan.num_devices; p++) {
+            for (const MgTileCopy &copy : plan.copies[p]) {
+                T_ELEM *h_A = h_B + copy.host_offset;
+                T_ELEM *d_tile = array_d_A_packed[p] + copy.device_offset;
+                const size_t width = static_cast<size_t>(copy.rows) * sizeof(T_ELEM);
+                if (to_device) {
+                    CUDA_CHECK(cudaMemcpy2D(d_tile, lld_bytes, h_A, ldb_bytes, width, copy.cols,
+                                            kind));
+                } else {
+                    CUDA_CHECK(cudaMemcpy2D(h_A, ldb_bytes, d_tile, lld_bytes, width, copy.cols,
+                                            kind));
+                }
+            }
+        }
+        CUDA_CHECK(cudaDeviceSynchronize());
+        return;
+    }
+
+    /* pageable memory makes cudaPointerGetAttributes fail before CUDA 11 */
+    cudaPointerAttributes attributes;
+    bool pinned = false;
+    if (cudaPointerGetAttributes(&attributes, h_B) == cudaSuccess) {
+        pinned = (attributes.type == cudaMemoryTypeHost);
+    } else {
+        (void)cudaGetLastError();
+    }
 
-    for (int p_a = 0; p_a < num_devices; p_a++) {
-        T_ELEM *d_A = array_d_A_packed[p_a];
-        int nz_blks = 0;
-        for (int JA_blk_id = p_a; JA_blk_id < num_blks; JA_blk_id += num_devices) {
-            array_d_A_unpacked[JA_blk_id] = d_A + static_cast<size_t>(LLD_A) * T_A * nz_blks;
-            nz_blks++;
+    std::vector<std::exception_ptr> errors(plan.num_devices);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < plan.num_devices; p++) {
+        if (plan.copies[p].empty()) {
+            continue;
+        }
+        threads.emplace_back([&, p]() {
+            cudaStream_t stream = NULL;
+            T_ELEM *staging[2] = {NULL, NULL};
+            cudaEvent_t done[2] = {NULL, NULL};
+            try {
+                CUDA_CHECK(cudaSetDevice(deviceIdA[p]));
+                CUDA_CHECK(cudaDeviceSynchronize());
+                CUDA_CHECK(cudaStreamCreate(&stream));
+                T_ELEM *d_A = array_d_A_packed[p];
+                if (pinned) {
+                    for (const MgTileCopy &copy : plan.copies[p]) {
+                        T_ELEM *h_A = h_B + copy.host_offset;
+                        const size_t width = static_cast<size_t>(copy.rows) * sizeof(T_ELEM);
+                        T_ELEM *d_tile = d_A + copy.device_offset;
+                        if (to_device) {
+                            CUDA_CHECK(cudaMemcpy2DAsync(d_tile, lld_bytes, h_A, ldb_bytes, width,
+                                                         copy.cols, kind, stream));
+                        } else {
+                            CUDA_CHECK(cudaMemcpy2DAsync(h_A, ldb_bytes, d_tile, lld_bytes, width,
+                                                         copy.cols, kind, stream));
+                        }
+                    }
+                } else {
+                    const size_t column_bytes =
+                        static_cast<size_t>(plan.copies[p].front().rows) * sizeof(T_ELEM);
+                    const int batch_cols = mgStagingBatchCols(plan, p, sizeof(T_ELEM));
+                    const std::vector<MgStagingBatch> batches =
+                        makeMgStagingBatches(plan, p, batch_cols);
+                    int staging_cols = 0;
+                    for (const MgStagingBatch &batch : batches) {
+                        staging_cols = std::max(staging_cols, batch.cols);
+                    }
+                    const size_t staging_bytes = column_bytes * staging_cols;
+                    for (int b = 0; b < 2; b++) {
+                        CUDA_CHECK(cudaMallocHost(&staging[b], staging_bytes));
+                        CUDA_CHECK(cudaEventCreateWithFlags(&done[b], cudaEventDisableTiming));
+                    }
+                    /* staging[b] <-> A_p */
+                    auto issue = [&](size_t i) {
+                        const MgStagingBatch &batch = batches[i];
+                        const size_t pitch = static_cast<size_t>(batch.rows) * sizeof(T_ELEM);
+                        T_ELEM *buffer = staging[i % 2];
+                        T_ELEM *d_batch = d_A + batch.device_offset;
+                        if (to_device) {
+                            CUDA_CHECK(cudaMemcpy2DAsync(d_batch, lld_bytes, buffer, pitch, pitch,
+                                                         batch.cols, kind, stream));
+                        } else {
+                            CUDA_CHECK(cudaMemcpy2DAsync(buffer, pitch, d_batch, lld_bytes, pitch,
+                                                         batch.cols, kind, stream));
+                        }
+                        CUDA_CHECK(cudaEventRecord(done[i % 2], stream));
+                    };
+                    /* h_B <-> staging[b] */
+                    auto stage = [&](size_t i) {
+                        const MgStagingBatch &batch = batches[i];
+                        T_ELEM *buffer = staging[i % 2];
+                        const size_t column_elems = batch.rows;
+                        for (const MgStagedCopy &piece : batch.pieces) {
+                            T_ELEM *h_col = h_B + piece.host_offset;
+                            T_ELEM *s_col = buffer + piece.staging_offset;
+                            for (int col = 0; col < piece.cols; col++) {
+                                if (to_device) {
+                                    std::memcpy(s_col, h_col, column_bytes);
+                                } else {
+                                    std::memcpy(h_col, s_col, column_bytes);
+                                }
+                                h_col += plan.host_pitch;
+                                s_col += column_elems;
+                            }
+                        }
+                    };
+                    if (to_device) {
+                        for (size_t i = 0; i < batches.size(); i++) {
+                            if (i >= 2) {
+                                CUDA_CHECK(cudaEventSynchronize(done[i % 2]));
+                            }
+                            stage(i);
+                            issue(i);
+                        }
+                    } else {
+                        for (size_t i = 0; i < batches.size() && i < 2; i++) {
+                            issue(i);
+                        }
+                        for (size_t i = 0; i < batches.size(); i++) {
+                            CUDA_CHECK(cudaEventSynchronize(done[i % 2]));
+                            stage(i);
+                            if (i + 2 < batches.size()) {
+                                issue(i + 2);
+                            }
+                        }
+                    }
+                }
+                CUDA_CHECK(cudaStreamSynchronize(stream));
+            } catch (...) {
+                errors[p] = std::current_exception();
+                if (stream != NULL) {
+                    (void)cudaStreamSynchronize(stream);
+                }
+            }
+            for (int b = 0; b < 2; b++) {
+                if (staging[b] != NULL) {
+                    (void)cudaFreeHost(staging[b]);
+                }
+                if (done[b] != NULL) {
+                    (void)cudaEventDestroy(done[b]);
+                }
+            }
+            if (stream != NULL) {
+                (void)cudaStreamDestroy(stream);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (const std::exception_ptr &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
         }
     }
 }
@@ -195,72 +353,16 @@ static void memcpyH2D(int num_devices, const int *deviceIdA, /* <int> dimension
                       int IA,                    /* base-1 */
                       int JA                     /* base-1 */
 ) {
-    int currentDev = 0; /* record current device id */
-
     /*  Quick return if possible */
     if ((0 >= M) || (0 >= N)) {
         return;
     }
 
-    /* consistent checking */
-    if (ldb < M) {
-        throw std::runtime_error("Consistency Error.");
-    }
-
-    CUDA_CHECK(cudaGetDevice(&currentDev));
-    CUDA_CHECK(cudaDeviceSynchronize());
-
-    const int num_blks = (N_A + T_A - 1) / T_A;
-
-    std::vector<T_ELEM *> array_d_A_unpacked(num_blks);
-
-    mat_pack2unpack<T_ELEM>(num_devices, N_A,         /* number of columns of global A */
-                            T_A,                      /* number of columns per column tile */
-                            LLD_A,                    /* leading dimension of local A */
-                            array_d_A_packed,         /* host pointer array of size num_devices */
-                                                      /* output */
-                            array_d_A_unpacked.data() /* host pointer arrya of size num_blks */
-    );
-
-    /* region of interest is A(IA:IA+N-1, JA:JA+N-1) */
-    const int N_hat = (JA - 1) + N; /* JA is base-1 */
-
-    const int JA_start_blk_id = (JA - 1) / T_A;
-    const int JA_end_blk_id = (N_hat - 1) / T_A;
-
-    for (int p_a = 0; p_a < num_devices; p_a++) {
-        /* region of interest: JA_start_blk_id:1:JA_end_blk_id */
-        for (int JA_blk_id = p_a; JA_blk_id <= JA_end_blk_id; JA_blk_id += num_devices) {
-            if (JA_blk_id < JA_start_blk_id) {
-                continue;
-            }
-            /*
-             * process column block of A
-             *       A(A_start_row:M_A, A_start_col : (A_start_col + IT_A-1) )
-             */
-            const int IBX_A = (1 + JA_blk_id * T_A);     /* base-1 */
-            const int A_start_col = std::max(JA, IBX_A); /* base-1 */
-            const int A_start_row = IA;                  /* base-1 */
-
-            const int bdd = std::min(N_hat, (IBX_A + T_A - 1));
-            const int IT_A = std::min(T_A, (bdd - A_start_col + 1));
-
-            const int loc_A_start_row = A_start_row;               /* base-1 */
-            const int loc_A_start_col = (A_start_col - IBX_A) + 1; /* base-1 */
-
-            T_ELEM *d_A =
-                array_d_A_unpacked[JA_blk_id] + IDX2F(loc_A_start_row, loc_A_start_col, LLD_A);
-            const T_ELEM *h_A = h_B + IDX2F(A_start_row - IA + 1, A_start_col - JA + 1, ldb);
+    const MgCopyPlan plan = makeMgCopyPlan(num_devices, M, N, ldb, N_A, T_A, LLD_A, IA, JA);
 
-            CUDA_CHECK(cudaMemcpy2D(d_A,                                              /* dst */
-                                    static_cast<size_t>(LLD_A) * sizeof(T_ELEM), h_A, /* src */
-                                    static_cast<size_t>(ldb) * sizeof(T_ELEM),
-                                    static_cast<size_t>(M) * sizeof(T_ELEM),
-                                    static_cast<size_t>(IT_A), cudaMemcpyHostToDevice));
-        } /* for each tile per device */
-    }     /* for each device */
-    CUDA_CHECK(cudaDeviceSynchronize());
-    CUDA_CHECK(cudaSetDevice(currentDev));
+    /* h_B is only read */
+    memcpyTiles<T_ELEM>(plan, deviceIdA, array_d_A_packed, const_cast<T_ELEM *>(h_B),
+                        cudaMemcpyHostToDevice);
 }
 
 /*
@@ -280,58 +382,12 @@ static void memcpyD2H(int num_devices, const int *deviceIdA, /* <int> dimension
                                                  /* output */
                       T_ELEM *h_B, /* host array, h_B is M-by-N with leading dimension ldb  */
                       int ldb) {
-    int currentDev = 0; /* record current device id */
-
     /*  Quick return if possible */
     if ((0 >= M) || (0 >= N)) {
         return;
     }
 
-    /* consistent checking */
-    if (ldb < M) {
-        throw std::runtime_error("Consistency Error.");
-    }
-
-    CUDA_CHECK(cudaGetDevice(&currentDev));
-    CUDA_CHECK(cudaDeviceSynchronize());
-
-    const int num_blks = (N_A + T_A - 1) / T_A;
-    std::vector<T_ELEM *> array_d_A_unpacked(num_blks);
+    const MgCopyPlan plan = makeMgCopyPlan(num_devices, M, N, ldb, N_A, T_A, LLD_A, IA, JA);
 
-    mat_pack2unpack<T_ELEM>(num_devices, N_A,         /* number of columns of global A */
-                            T_A,                      /* number of columns per column tile */
-                            LLD_A,                    /* leading dimension of local A */
-                            array_d_A_packed,         /* host pointer array of size num_devices */
-                            array_d_A_unpacked.data() /* host pointer arrya of size num_blks */
-    );
-    /* region of interest is A(IA:IA+N-1, JA:JA+N-1) */
-    const int N_hat = (JA - 1) + N; /* JA is base-1 */
-    const int JA_start_blk_id = (JA - 1) / T_A;
-    const int JA_end_blk_id = (N_hat - 1) / T_A;
-    for (int p_a = 0; p_a < num_devices; p_a++) {
-        /* region of interest: JA_start_blk_id:1:JA_end_blk_id */
-        for (int JA_blk_id = p_a; JA_blk_id <= JA_end_blk_id; JA_blk_id += num_devices) {
-            if (JA_blk_id < JA_start_blk_id) {
-                continue;
-            }
-            /* process column block, A(A_start_row:M_A, A_start_col : (A_start_col + IT_A-1) ) */
-            const int IBX_A = (1 + JA_blk_id * T_A);     /* base-1 */
-            const int A_start_col = std::max(JA, IBX_A); /* base-1 */
-            const int A_start_row = IA;                  /* base-1 */
-            const int bdd = std::min(N_hat, (IBX_A + T_A - 1));
-            const int IT_A = std::min(T_A, (bdd - A_start_col + 1));
-            const int loc_A_start_row = A_start_row;               /* base-1 */
-            const int loc_A_start_col = (A_start_col - IBX_A) + 1; /* base-1 */
-            const T_ELEM *d_A =
-                array_d_A_unpacked[JA_blk_id] + IDX2F(loc_A_start_row, loc_A_start_col, LLD_A);
-            T_ELEM *h_A = h_B + IDX2F(A_start_row - IA + 1, A_start_col - JA + 1, ldb);
-            CUDA_CHECK(cudaMemcpy2D(h_A,                                            /* dst */
-                                    static_cast<size_t>(ldb) * sizeof(T_ELEM), d_A, /* src */
-                                    static_cast<size_t>(LLD_A) * sizeof(T_ELEM),
-                                    static_cast<size_t>(M) * sizeof(T_ELEM),
-                                    static_cast<size_t>(IT_A), cudaMemcpyDeviceToHost));
-        } /* for each tile per device */
-    }     /* for each device */
-    CUDA_CHECK(cudaDeviceSynchronize());
-    CUDA_CHECK(cudaSetDevice(currentDev));
+    memcpyTiles<T_ELEM>(plan, deviceIdA, array_d_A_packed, h_B, cudaMemcpyDeviceToHost);
 }
@@ -0,0 +1,244 @@
+/*
+ * Checks the cusolverMg copy plan on the host against the per-tile copies of
+ * mat_pack2unpack, for random N_A, T_A, device counts, IA/JA offsets and
+ * pitches. The distributed A lives in host vectors, one per device, and the
+ * plan is executed both directly and through staging batches.
+ */
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "cusolverMg_copy_plan.h"
+#include "test_check.h"
+
+namespace {
+
+struct Problem {
+    int num_devices;
+    int M;
+    int N;
+    int ldb;
+    int N_A;
+    int T_A;
+    int LLD_A;
+    int IA;
+    int JA;
+};
+
+Problem makeProblem(std::mt19937 &rng) {
+    auto uniform = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+    Problem pb;
+    pb.num_devices = uniform(1, 4);
+    pb.T_A = uniform(1, 6);
+    pb.M = uniform(1, 5);
+    pb.N = uniform(1, 20);
+    pb.IA = uniform(1, 3);
+    pb.JA = uniform(1, 9);
+    pb.ldb = pb.M + uniform(0, 2);
+    pb.LLD_A = pb.IA - 1 + pb.M + uniform(0, 2);
+    pb.N_A = pb.JA - 1 + pb.N + uniform(0, 7);
+    return pb;
+}
+
+/* local tiles of every device, filled with -1 */
+std::vector<std::vector<double>> makeDevices(const Problem &pb) {
+    const int num_blks = (pb.N_A + pb.T_A - 1) / pb.T_A;
+    std::vector<std::vector<double>> devices(pb.num_devices);
+    for (int p = 0; p < pb.num_devices; p++) {
+        const int local_blks = (num_blks - p + pb.num_devices - 1) / pb.num_devices;
+        devices[p].assign(static_cast<size_t>(pb.LLD_A) * pb.T_A * std::max(local_blks, 0), -1.0);
+    }
+    return devices;
+}
+
+/* A(IA:IA+M-1, JA:JA+N-1) <-> B, one tile at a time through mat_pack2unpack */
+void referenceCopy(const Problem &pb, std::vector<std::vector<double>> &devices,
+                   std::vector<double> &h_B, bool to_device) {
+    const int num_blks = (pb.N_A + pb.T_A - 1) / pb.T_A;
+    std::vector<double *> packed(pb.num_devices);
+    for (int p = 0; p < pb.num_devices; p++) {
+        packed[p] = devices[p].data();
+    }
+    std::vector<double *> unpacked(num_blks);
+    mat_pack2unpack<double>(pb.num_devices, pb.N_A, pb.T_A, pb.LLD_A, packed.data(),
+                            unpacked.data());
+    for (int col = pb.JA; col < pb.JA + pb.N; col++) { /* base-1 */
+        const int blk = (col - 1) / pb.T_A;
+        const int loc_col = (col - 1) % pb.T_A;
+        for (int row = 0; row < pb.M; row++) {
+            double &a = unpacked[blk][static_cast<size_t>(loc_col) * pb.LLD_A + (pb.IA - 1) + row];
+            double &b = h_B[static_cast<size_t>(col - pb.JA) * pb.ldb + row];
+            if (to_device) {
+                a = b;
+            } else {
+                b = a;
+            }
+        }
+    }
+}
+
+/* rows x cols elements, column by column, between two pitched arrays */
+void copy2D(double *dst, int dst_pitch, const double *src, int src_pitch, int rows, int cols) {
+    for (int col = 0; col < cols; col++) {
+        std::copy(src + static_cast<size_t>(col) * src_pitch,
+                  src + static_cast<size_t>(col) * src_pitch + rows,
+                  dst + static_cast<size_t>(col) * dst_pitch);
+    }
+}
+
+/* the direct path of memcpyTiles */
+void planCopy(const MgCopyPlan &plan, std::vector<std::vector<double>> &devices,
+              std::vector<double> &h_B, bool to_device) {
+    for (int p = 0; p < plan.num_devices; p++) {
+        for (const MgTileCopy &copy : plan.copies[p]) {
+            CHECK(copy.device == p);
+            double *d_tile = devices[p].data() + copy.device_offset;
+            double *h_A = h_B.data() + copy.host_offset;
+            if (to_device) {
+                copy2D(d_tile, plan.device_pitch, h_A, plan.host_pitch, copy.rows, copy.cols);
+            } else {
+                copy2D(h_A, plan.host_pitch, d_tile, plan.device_pitch, copy.rows, copy.cols);
+            }
+        }
+    }
+}
+
+/* the staged path of memcpyTiles, one batch at a time */
+void stagedCopy(const MgCopyPlan &plan, int batch_cols, std::vector<std::vector<double>> &devices,
+                std::vector<double> &h_B, bool to_device) {
+    for (int p = 0; p < plan.num_devices; p++) {
+        for (const MgStagingBatch &batch : makeMgStagingBatches(plan, p, batch_cols)) {
+            CHECK(batch.cols <= batch_cols);
+            std::vector<double> staging(static_cast<size_t>(batch.rows) * batch.cols);
+            double *d_batch = devices[p].data() + batch.device_offset;
+            if (!to_device) {
+                copy2D(staging.data(), batch.rows, d_batch, plan.device_pitch, batch.rows,
+                       batch.cols);
+            }
+            int staged_cols = 0;
+            for (const MgStagedCopy &piece : batch.pieces) {
+                CHECK(piece.staging_offset == static_cast<size_t>(staged_cols) * batch.rows);
+                double *h_col = h_B.data() + piece.host_offset;
+                double *s_col = staging.data() + piece.staging_offset;
+                if (to_device) {
+                    copy2D(s_col, batch.rows, h_col, plan.host_pitch, batch.rows, piece.cols);
+                } else {
+                    copy2D(h_col, plan.host_pitch, s_col, batch.rows, batch.rows, piece.cols);
+                }
+                staged_cols += piece.cols;
+            }
+            CHECK(staged_cols == batch.cols);
+            if (to_device) {
+                copy2D(d_batch, plan.device_pitch, staging.data(), batch.rows, batch.rows,
+                       batch.cols);
+            }
+        }
+    }
+}
+
+void testRandomProblems() {
+    std::mt19937 rng(2024);
+    for (int trial = 0; trial < 2000; trial++) {
+        const Problem pb = makeProblem(rng);
+        const MgCopyPlan plan = makeMgCopyPlan(pb.num_devices, pb.M, pb.N, pb.ldb, pb.N_A, pb.T_A,
+                                               pb.LLD_A, pb.IA, pb.JA);
+        CHECK(mgCopyPlanElements(plan) == static_cast<size_t>(pb.M) * pb.N);
+
+        std::vector<double> h_B(static_cast<size_t>(pb.ldb) * pb.N);
+        for (size_t idx = 0; idx < h_B.size(); idx++) {
+            h_B[idx] = static_cast<double>(idx);
+        }
+        const int batch_cols = std::uniform_int_distribution<int>(1, 5)(rng);
+
+        /* H2D */
+        std::vector<std::vector<double>> expected = makeDevices(pb);
+        referenceCopy(pb, expected, h_B, true);
+        std::vector<std::vector<double>> direct = makeDevices(pb);
+        planCopy(plan, direct, h_B, true);
+        CHECK(direct == expected);
+        std::vector<std::vector<double>> staged = makeDevices(pb);
+        stagedCopy(plan, batch_cols, staged, h_B, true);
+        CHECK(staged == expected);
+
+        /* D2H, from distinct values everywhere in the local tiles */
+        for (int p = 0; p < pb.num_devices; p++) {
+            for (size_t idx = 0; idx < expected[p].size(); idx++) {
+                expected[p][idx] = 1000.0 * (p + 1) + idx;
+            }
+        }
+        std::vector<double> expected_B(h_B.size(), -1.0);
+        referenceCopy(pb, expected, expected_B, false);
+        std::vector<double> direct_B(h_B.size(), -1.0);
+        planCopy(plan, expected, direct_B, false);
+        CHECK(direct_B == expected_B);
+        std::vector<double> staged_B(h_B.size(), -1.0);
+        stagedCopy(plan, batch_cols, expected, staged_B, false);
+        CHECK(staged_B == expected_B);
+    }
+}
+
+void testMergedTiles() {
+    /* a single device holds the whole region, so the tiles merge into one copy */
+    MgCopyPlan plan = makeMgCopyPlan(1, 4, 10, 4, 12, 3, 4, 1, 2);
+    CHECK(plan.copies[0].size() == 1);
+    CHECK(plan.copies[0][0].cols == 10);
+    /* LLD_A > M breaks the host contiguity, so nothing merges */
+    plan = makeMgCopyPlan(2, 4, 10, 4, 12, 3, 5, 1, 2);
+    CHECK(plan.copies[0].size() + plan.copies[1].size() == 4);
+    /* empty regions give an empty plan */
+    plan = makeMgCopyPlan(3, 0, 10, 4, 12, 3, 5, 1, 2);
+    CHECK(plan.copies.size() == 3 && mgCopyPlanElements(plan) == 0);
+}
+
+void testStagingBatches() {
+    /* a batch holds as many whole columns as fit in MG_STAGING_BYTES */
+    MgCopyPlan plan = makeMgCopyPlan(2, 1000, 10, 1000, 12, 3, 1000, 1, 2);
+    const int batch_cols = mgStagingBatchCols(plan, 0, sizeof(double));
+    CHECK(static_cast<size_t>(batch_cols) * 1000 * sizeof(double) <= MG_STAGING_BYTES);
+    CHECK(static_cast<size_t>(batch_cols + 1) * 1000 * sizeof(double) > MG_STAGING_BYTES);
+    /* a column larger than the staging buffer still moves, one column per batch */
+    const int huge_rows = static_cast<int>(MG_STAGING_BYTES / sizeof(double)) + 1;
+    plan = makeMgCopyPlan(1, huge_rows, 4, huge_rows, 4, 2, huge_rows, 1, 1);
+    CHECK(mgStagingBatchCols(plan, 0, sizeof(double)) == 1);
+    CHECK(makeMgStagingBatches(plan, 0, 1).size() == 4);
+    /* a device without copies */
+    plan = makeMgCopyPlan(3, 4, 2, 4, 12, 3, 4, 1, 1);
+    CHECK(plan.copies[2].empty() && mgStagingBatchCols(plan, 2, sizeof(double)) == 1);
+
+    /*
+     * full tiles 0 and 2 of device 0 are not contiguous in B but follow each other on the
+     * device, so they share a batch, in two pieces
+     */
+    plan = makeMgCopyPlan(2, 4, 12, 6, 12, 3, 4, 1, 1);
+    CHECK(plan.copies[0].size() == 2);
+    std::vector<MgStagingBatch> batches = makeMgStagingBatches(plan, 0, 100);
+    CHECK(batches.size() == 1);
+    if (batches.size() == 1) {
+        CHECK(batches[0].cols == 6 && batches[0].pieces.size() == 2);
+        CHECK(batches[0].pieces[1].host_offset == 6 * 6 && batches[0].pieces[1].staging_offset == 3 * 4);
+    }
+    /* ... and split at batch_cols, across and within tiles */
+    batches = makeMgStagingBatches(plan, 0, 4);
+    CHECK(batches.size() == 2);
+    if (batches.size() == 2) {
+        CHECK(batches[0].cols == 4 && batches[1].cols == 2);
+        CHECK(batches[1].device_offset == 4 * 4 && batches[1].pieces.size() == 1);
+    }
+    /* an IA offset and LLD_A > M keep the device columns LLD_A apart, so the tiles still share a batch */
+    plan = makeMgCopyPlan(2, 3, 12, 6, 12, 3, 5, 2, 1);
+    batches = makeMgStagingBatches(plan, 0, 100);
+    CHECK(batches.size() == 1);
+    if (batches.size() == 1) {
+        CHECK(batches[0].device_offset == 1 && batches[0].rows == 3 && batches[0].cols == 6);
+    }
+}
+
+}  // namespace
+
+int main() {
+    testRandomProblems();
+    testMergedTiles();
+    testStagingBatches();
+    return test_result("copy_plan_test");
+}
@@ -4,5 +4,5 @@
 
 
 int main(const int argc, const char **argv) {
-  main_bench_sddmm_csr(argc, argv);
+  return main_bench_sddmm_csr(argc, argv);
 }
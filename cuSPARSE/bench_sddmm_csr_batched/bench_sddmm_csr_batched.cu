@@ -51,6 +51,8 @@
 #include <cusparse.h>          // cusparseSpMM
 #include <stdio.h>             // printf
 #include <stdlib.h>            // EXIT_FAILURE
+#include <utils/bench_record.h>
+#include <utils/bench_timing.h>
 #include <utils/generate_random_data.h>
 #include <utils/helper_string.h>
 
@@ -91,6 +93,9 @@ int main(const int argc, const char **argv) {
   int num_batches = getCmdLineArgumentInt(argc, argv, "num_batches");
   bool enable_preprocess =
       getCmdLineArgumentInt(argc, argv, "enable_preprocess");
+  BenchRecord::OutputOptions output_options =
+      BenchRecord::parse_output_options(argc, argv);
+  BenchTiming::Config timing_config = BenchTiming::parse_config(argc, argv);
 
   if (A_num_rows == 0 || A_num_cols == 0 || B_num_cols == 0 ||
       C_sparsity == 0 || num_batches == 0) {
@@ -98,6 +103,8 @@ int main(const int argc, const char **argv) {
         "Usage: %s --A_num_rows=## --A_num_cols=## --B_num_cols=## "
         "--C_sparsity=0.## --num_batches=## [--enable_preprocess]\n",
         argv[0]);
+    BenchTiming::print_timing_usage();
+    BenchRecord::print_output_usage();
     return EXIT_FAILURE;
   }
   printf("A_num_rows: %d\n", A_num_rows);
@@ -238,7 +245,8 @@ int main(const int argc, const char **argv) {
   // execute SpMM
   // We nest the cuda event timing with std::chrono to make sure the cuda event
   // is getting correct results, we will use the cuda event timing results and
-  // ignore the std::chrono results
+  // ignore the std::chrono results. The warmup iterations are untimed and each
+  // sample is timed with the event pair on its own.
   std::chrono::time_point<std::chrono::system_clock> beg, end;
   cudaEvent_t start, stop;
   CHECK_CUDA(cudaEventCreate(&start));
@@ -246,24 +254,53 @@ int main(const int argc, const char **argv) {
   CHECK_CUDA(cudaDeviceSynchronize());
 
   beg = std::chrono::system_clock::now();
-  CHECK_CUDA(cudaEventRecord(start));
-
-  CHECK_CUSPARSE(cusparseSDDMM(handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
-                               CUSPARSE_OPERATION_NON_TRANSPOSE, &alpha, matA,
-                               matB, &beta, matC, CUDA_R_32F,
-                               CUSPARSE_SDDMM_ALG_DEFAULT, dBuffer))
-  CHECK_CUDA(cudaEventRecord(stop));
-  CHECK_CUDA(cudaDeviceSynchronize());
+  for (int idx = 0; idx < timing_config.warmup_iters; idx++) {
+    CHECK_CUSPARSE(cusparseSDDMM(handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
+                                 CUSPARSE_OPERATION_NON_TRANSPOSE, &alpha, matA,
+                                 matB, &beta, matC, CUDA_R_32F,
+                                 CUSPARSE_SDDMM_ALG_DEFAULT, dBuffer))
+  }
+  BenchTiming::Sampler sampler(timing_config);
+  while (!sampler.done()) {
+    CHECK_CUDA(cudaEventRecord(start));
+    CHECK_CUSPARSE(cusparseSDDMM(handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
+                                 CUSPARSE_OPERATION_NON_TRANSPOSE, &alpha, matA,
+                                 matB, &beta, matC, CUDA_R_32F,
+                                 CUSPARSE_SDDMM_ALG_DEFAULT, dBuffer))
+    CHECK_CUDA(cudaEventRecord(stop));
+    CHECK_CUDA(cudaEventSynchronize(stop));
+    float elapsed_time = 0.0f;
+    CHECK_CUDA(cudaEventElapsedTime(&elapsed_time, start, stop));
+    sampler.add(elapsed_time);
+  }
   end = std::chrono::system_clock::now();
-  float elapsed_time = 0.0f;
-  CHECK_CUDA(cudaEventElapsedTime(&elapsed_time, start, stop));
-  printf("cusparseSDDMBatched+CSR elapsed time (ms): %f\n", elapsed_time);
-  printf("cusparseSDDMBatched+CSR throughput (GFLOPS): %f\n",
-         (2.0 * A_num_rows * B_num_cols * A_num_cols * num_batches) /
-             (elapsed_time / 1000.0) / 1e9);
+  CHECK_CUDA(cudaEventDestroy(start));
+  CHECK_CUDA(cudaEventDestroy(stop));
+
+  BenchTiming::Summary summary = sampler.get_summary();
+  double flop = 2.0 * A_num_rows * B_num_cols * A_num_cols * num_batches;
+  BenchTiming::print_summary("cusparseSDDMBatched+CSR", summary, flop);
   printf(
-      "[DEBUG] cusparseSDDMM chrono time (microseconds): %ld\n",
-      std::chrono::duration_cast<std::chrono::microseconds>(end - beg).count());
+      "[DEBUG] cusparseSDDMM chrono time per iteration (microseconds): %ld\n",
+      std::chrono::duration_cast<std::chrono::microseconds>(end - beg).count() /
+          (summary.num_warmup + summary.num_samples));
+
+  BenchRecord::Record record;
+  record.add("bench", "bench_sddmm_csr_batched");
+  record.add("routine", "cusparseSDDMMBatched+CSR");
+  record.add("A_num_rows", A_num_rows);
+  record.add("A_num_cols", A_num_cols);
+  record.add("B_num_cols", B_num_cols);
+  record.add("C_sparsity", C_sparsity);
+  record.add("num_batches", num_batches);
+  record.add("enable_preprocess", enable_preprocess);
+  record.add("dtype", "float32");
+  record.add("nstreams", 1);
+  record.add_timing_summary(summary);
+  record.add("gflops", flop / (summary.median / 1000.0) / 1e9);
+  record.add_host_info();
+  record.add_device_info();
+  BenchRecord::emit(output_options, record);
 
   // destroy matrix/vector descriptors
   CHECK_CUSPARSE(cusparseDestroyDnMat(matA))
@@ -51,6 +51,8 @@
 #include <stdio.h>            // printf
 #include <stdlib.h>           // EXIT_FAILURE
 #include <cusp/coo_matrix.h>  // cusp::csr_matrix
+#include <utils/bench_record.h>
+#include <utils/bench_timing.h>
 #include <utils/generate_random_data.h>
 #include <utils/helper_string.h>
 #include <chrono>
@@ -84,8 +86,14 @@ int main(const int argc, const char** argv)
     int A_num_cols = getCmdLineArgumentInt(argc, argv, "A_num_cols");
     int B_num_cols = getCmdLineArgumentInt(argc, argv, "B_num_cols");
     float A_sparsity = getCmdLineArgumentFloat(argc, argv, "A_sparsity");
-    if (argc != 5){
+    BenchRecord::OutputOptions output_options =
+        BenchRecord::parse_output_options(argc, argv);
+    BenchTiming::Config timing_config = BenchTiming::parse_config(argc, argv);
+    if (A_num_rows == 0 || A_num_cols == 0 || B_num_cols == 0 ||
+        A_sparsity == 0.0f){
         printf("Usage: %s --A_num_rows=## --A_num_cols=## --B_num_cols=## --A_sparsity=0.##\n", argv[0]);
+        BenchTiming::print_timing_usage();
+        BenchRecord::print_output_usage();
         return EXIT_FAILURE;
     }
     printf("A_num_rows: %d\n", A_num_rows);
@@ -166,19 +174,63 @@ int main(const int argc, const char** argv)
     CHECK_CUDA(cudaMalloc(&dBuffer, bufferSize))
 
     // execute SpMM
-    std::chrono::time_point<std::chrono::system_clock> start, end;
-    cudaDeviceSynchronize();
-    start = std::chrono::system_clock::now();
-    CHECK_CUSPARSE(cusparseSpMM(handle,
-                                CUSPARSE_OPERATION_NON_TRANSPOSE,
-                                CUSPARSE_OPERATION_NON_TRANSPOSE,
-                                &alpha, matA, matB, &beta, matC, CUDA_R_32F,
-                                CUSPARSE_SPMM_ALG_DEFAULT, dBuffer))
-    cudaDeviceSynchronize();
+    // We nest the cuda event timing with std::chrono to make sure the cuda
+    // event is getting correct results, we will use the cuda event timing
+    // results and ignore the std::chrono results
+    std::chrono::time_point<std::chrono::system_clock> beg, end;
+    cudaEvent_t start, stop;
+    CHECK_CUDA(cudaEventCreate(&start))
+    CHECK_CUDA(cudaEventCreate(&stop))
+    CHECK_CUDA(cudaDeviceSynchronize())
+    beg = std::chrono::system_clock::now();
+    for (int idx = 0; idx < timing_config.warmup_iters; idx++) {
+        CHECK_CUSPARSE(cusparseSpMM(handle,
+                                    CUSPARSE_OPERATION_NON_TRANSPOSE,
+                                    CUSPARSE_OPERATION_NON_TRANSPOSE,
+                                    &alpha, matA, matB, &beta, matC, CUDA_R_32F,
+                                    CUSPARSE_SPMM_ALG_DEFAULT, dBuffer))
+    }
+    BenchTiming::Sampler sampler(timing_config);
+    while (!sampler.done()) {
+        CHECK_CUDA(cudaEventRecord(start))
+        CHECK_CUSPARSE(cusparseSpMM(handle,
+                                    CUSPARSE_OPERATION_NON_TRANSPOSE,
+                                    CUSPARSE_OPERATION_NON_TRANSPOSE,
+                                    &alpha, matA, matB, &beta, matC, CUDA_R_32F,
+                                    CUSPARSE_SPMM_ALG_DEFAULT, dBuffer))
+        CHECK_CUDA(cudaEventRecord(stop))
+        CHECK_CUDA(cudaEventSynchronize(stop))
+        float elapsed_time = 0.0f;
+        CHECK_CUDA(cudaEventElapsedTime(&elapsed_time, start, stop))
+        sampler.add(elapsed_time);
+    }
     end = std::chrono::system_clock::now();
-    printf("cusparseSpMM time (microseconds): %ld\n",
-           std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
-   
+    CHECK_CUDA(cudaEventDestroy(start))
+    CHECK_CUDA(cudaEventDestroy(stop))
+
+    BenchTiming::Summary summary = sampler.get_summary();
+    double flop = 2.0 * A_nnz * B_num_cols;
+    BenchTiming::print_summary("cusparseSpMM+COO", summary, flop);
+    printf("[DEBUG] cusparseSpMM+COO chrono time per iteration (microseconds): %ld\n",
+           std::chrono::duration_cast<std::chrono::microseconds>(end - beg).count() /
+               (summary.num_warmup + summary.num_samples));
+
+    BenchRecord::Record record;
+    record.add("bench", "bench_spmm_coo");
+    record.add("routine", "cusparseSpMM+COO");
+    record.add("A_num_rows", A_num_rows);
+    record.add("A_num_cols", A_num_cols);
+    record.add("B_num_cols", B_num_cols);
+    record.add("A_sparsity", A_sparsity);
+    record.add("A_nnz", A_nnz);
+    record.add("dtype", "float32");
+    record.add("nstreams", 1);
+    record.add_timing_summary(summary);
+    record.add("gflops", flop / (summary.median / 1000.0) / 1e9);
+    record.add_host_info();
+    record.add_device_info();
+    BenchRecord::emit(output_options, record);
+
     // destroy matrix/vector descriptors
     CHECK_CUSPARSE(cusparseDestroySpMat(matA))
     CHECK_CUSPARSE(cusparseDestroyDnMat(matB))
@@ -53,6 +53,8 @@
 #include <cusparse.h>  // cusparseSpMM
 #include <stdio.h>     // printf
 #include <stdlib.h>    // EXIT_FAILURE
+#include <utils/bench_record.h>
+#include <utils/bench_timing.h>
 #include <utils/generate_random_data.h>
 // renamed this source file to .cpp to allow cstddef. Source:
 // https://talk.pokitto.com/t/sudden-error-cstddef-no-such-file-or-directory/711/4
@@ -98,6 +100,9 @@ struct BenchSpmmCSRProblemSpec {
   bool enable_debug_timing;
   char *cli_result_path_and_prefix;
   bool flag_specify_result_path_and_prefix;
+  BenchTiming::Config timing_config;
+  BenchRecord::OutputOptions output_options;
+  RandomCSR::Options A_pattern_options;
 };
 
 struct BenchSpmmCSRRuntimeData {
@@ -126,6 +131,9 @@ void print_spmm_csr_usage() {
       "Usage: bench_spmm_csr --A_num_rows=## --A_num_cols=## --B_num_cols=## "
       "--A_sparsity=0.## [--enable_dump] [--result_path_and_prefix=...] "
       "[--enable_timing] [--enable_debug_timing]\n");
+  BenchTiming::print_timing_usage();
+  BenchRecord::print_output_usage();
+  RandomCSR::print_pattern_usage();
   // TODO: print the meaning of each argument
 }
 
@@ -146,6 +154,17 @@ generate_data_and_prepare_bench_spmm_csr(
   char *cli_result_path_and_prefix;
   bool flag_specify_result_path_and_prefix = getCmdLineArgumentString(
       argc, argv, "result_path_and_prefix", &cli_result_path_and_prefix);
+  BenchTiming::Config timing_config = BenchTiming::parse_config(argc, argv);
+  BenchRecord::OutputOptions output_options =
+      BenchRecord::parse_output_options(argc, argv);
+  RandomCSR::Options A_pattern_options;
+  try {
+    A_pattern_options = RandomCSR::parse_options(argc, argv);
+  } catch (const std::invalid_argument &e) {
+    printf("%s\n", e.what());
+    print_spmm_csr_usage();
+    exit(EXIT_FAILURE);
+  }
   if (A_num_rows == 0 || A_num_cols == 0 || B_num_cols == 0 ||
       A_sparsity == 0.0f) {
     print_spmm_csr_usage();
@@ -155,9 +174,19 @@ generate_data_and_prepare_bench_spmm_csr(
   printf("A_num_cols: %d\n", A_num_cols);
   printf("B_num_cols: %d\n", B_num_cols);
   printf("A_sparsity: %f\n", A_sparsity);
+  printf("A_pattern: %s\n",
+         RandomCSR::get_pattern_name(A_pattern_options.pattern));
 
   // ***** END OF HOST PROBLEM DEFINITION *****
   int A_nnz = A_num_rows * A_num_cols * A_sparsity;
+  // The banded pattern only has the cells within the band
+  if (A_nnz >
+      RandomCSR::get_max_nnz(A_num_rows, A_num_cols, A_pattern_options)) {
+    printf("A_sparsity gives %d nonzeros, more than the %s pattern fits in A\n",
+           A_nnz, RandomCSR::get_pattern_name(A_pattern_options.pattern));
+    print_spmm_csr_usage();
+    exit(EXIT_FAILURE);
+  }
   int B_num_rows = A_num_cols;
   int ldb = B_num_rows;
   int ldc = A_num_rows;
@@ -177,8 +206,8 @@ generate_data_and_prepare_bench_spmm_csr(
   generate_random_matrix(hB, B_size);
   cusp::csr_matrix<int, float, cusp::host_memory> hA =
       generate_random_sparse_matrix_nodup<
-          cusp::csr_matrix<int, float, cusp::host_memory>>(A_num_rows,
-                                                           A_num_cols, A_nnz);
+          cusp::csr_matrix<int, float, cusp::host_memory>>(
+          A_num_rows, A_num_cols, A_nnz, A_pattern_options);
   cusp::csr_matrix<int, float, cusp::device_memory> dA(hA);
   A_nnz = hA.values.size();
   printf("actual A_nnz using non-dup random data generation: %d\n", A_nnz);
@@ -310,6 +339,9 @@ generate_data_and_prepare_bench_spmm_csr(
       .cli_result_path_and_prefix = cli_result_path_and_prefix,
       .flag_specify_result_path_and_prefix =
           flag_specify_result_path_and_prefix,
+      .timing_config = timing_config,
+      .output_options = output_options,
+      .A_pattern_options = A_pattern_options,
   };
 
   auto bench_tuple = std::make_tuple(
@@ -318,7 +350,7 @@ generate_data_and_prepare_bench_spmm_csr(
   return bench_tuple;
 }
 
-std::tuple<cudaEvent_t, cudaEvent_t> compute_bench_spmm_csr(
+BenchTiming::Summary compute_bench_spmm_csr(
     BenchSpmmCSRProblemSpec &problem_spec,
     BenchSpmmCSRRuntimeData &runtime_data,
     std::map<std::string, std::tuple<cudaEvent_t, cudaEvent_t>>
@@ -334,43 +366,65 @@ std::tuple<cudaEvent_t, cudaEvent_t> compute_bench_spmm_csr(
     CHECK_CUDA(cudaEventCreate(&stop));
   }
 
+  auto run_spmm = [&]() {
+    CHECK_CUSPARSE(
+        cusparseSpMM(runtime_data.handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
+                     CUSPARSE_OPERATION_NON_TRANSPOSE, &(runtime_data.alpha),
+                     runtime_data.matA, runtime_data.matB, &(runtime_data.beta),
+                     runtime_data.matC, CUDA_R_32F, CUSPARSE_SPMM_ALG_DEFAULT,
+                     runtime_data.dBuffer))
+  };
+
   if (problem_spec.enable_debug_timing) {
     CHECK_CUDA(cudaDeviceSynchronize());
     beg = std::chrono::system_clock::now();
   }
-  if (problem_spec.enable_timing)
-    CHECK_CUDA(cudaEventRecord(start, runtime_data.stream));
-  CHECK_CUSPARSE(
-      cusparseSpMM(runtime_data.handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
-                   CUSPARSE_OPERATION_NON_TRANSPOSE, &(runtime_data.alpha),
-                   runtime_data.matA, runtime_data.matB, &(runtime_data.beta),
-                   runtime_data.matC, CUDA_R_32F, CUSPARSE_SPMM_ALG_DEFAULT,
-                   runtime_data.dBuffer))
-  if (problem_spec.enable_timing)
-    CHECK_CUDA(cudaEventRecord(stop, runtime_data.stream));
+  BenchTiming::Summary summary{};
+  if (problem_spec.enable_timing) {
+    summary = BenchTiming::measure(problem_spec.timing_config, [&]() {
+      CHECK_CUDA(cudaEventRecord(start, runtime_data.stream));
+      run_spmm();
+      CHECK_CUDA(cudaEventRecord(stop, runtime_data.stream));
+      CHECK_CUDA(cudaEventSynchronize(stop));
+      float elapsed_time = 0.0f;
+      CHECK_CUDA(cudaEventElapsedTime(&elapsed_time, start, stop));
+      return static_cast<double>(elapsed_time);
+    });
+  } else {
+    run_spmm();
+  }
   if (problem_spec.enable_debug_timing) {
     CHECK_CUDA(cudaDeviceSynchronize());
     end = std::chrono::system_clock::now();
-    printf("[DEBUG] cusparseSpMM+CSR chrono time (microseconds): %ld\n",
-           std::chrono::duration_cast<std::chrono::microseconds>(end - beg)
-               .count());
+    int num_iters = problem_spec.enable_timing
+                        ? summary.num_warmup + summary.num_samples
+                        : 1;
+    printf(
+        "[DEBUG] cusparseSpMM+CSR chrono time per iteration (microseconds): "
+        "%ld\n",
+        std::chrono::duration_cast<std::chrono::microseconds>(end - beg)
+                .count() /
+            num_iters);
+  }
+  if (problem_spec.enable_timing) {
+    CHECK_CUDA(cudaEventDestroy(start));
+    CHECK_CUDA(cudaEventDestroy(stop));
   }
 
-  return std::make_tuple(start, stop);
+  return summary;
 }
 
-void consume_and_print_timing_bench_spmm_csr(
-    cudaEvent_t start, cudaEvent_t stop, BenchSpmmCSRProblemSpec &problem_spec,
+// Returns the elapsed time of each utility so that it can be added to the
+// result record after the events are destroyed
+std::map<std::string, float> consume_and_print_timing_bench_spmm_csr(
+    const BenchTiming::Summary &summary, BenchSpmmCSRProblemSpec &problem_spec,
     BenchSpmmCSRRuntimeData &runtime_data,
     std::map<std::string, std::tuple<cudaEvent_t, cudaEvent_t>>
         &utility_timestamps) {
-  CHECK_CUDA(cudaEventSynchronize(stop));
-  float elapsed_time = 0.0f;
-  CHECK_CUDA(cudaEventElapsedTime(&elapsed_time, start, stop));
-  printf("cusparseSpMM+CSR elapsed time (ms): %f\n", elapsed_time);
-  printf("cusparseSpMM+CSR throughput (GFLOPS): %f\n",
-         (2.0 * runtime_data.A_nnz * problem_spec.B_num_cols) /
-             (elapsed_time / 1000.0) / 1e9);
+  std::map<std::string, float> utility_elapsed_ms;
+  BenchTiming::print_summary(
+      "cusparseSpMM+CSR", summary,
+      2.0 * runtime_data.A_nnz * problem_spec.B_num_cols);
   // Print elapsed time of utilities. Keyword "elapsed time(util) (ms):"
   for (const auto &keyval : utility_timestamps) {
     const auto &key = keyval.first;
@@ -380,11 +434,42 @@ void consume_and_print_timing_bench_spmm_csr(
                                     std::get<1>(value)));
     printf("cusparseSpMM+CSR %s elapsed time(util) (ms): %f\n", key.c_str(),
            elapsed_time_util);
+    utility_elapsed_ms[key] = elapsed_time_util;
     CHECK_CUDA(cudaEventDestroy(std::get<0>(value)));
     CHECK_CUDA(cudaEventDestroy(std::get<1>(value)));
   }
-  CHECK_CUDA(cudaEventDestroy(start));
-  CHECK_CUDA(cudaEventDestroy(stop));
+  return utility_elapsed_ms;
+}
+
+void emit_record_bench_spmm_csr(
+    const BenchTiming::Summary &summary, BenchSpmmCSRProblemSpec &problem_spec,
+    BenchSpmmCSRRuntimeData &runtime_data,
+    const std::map<std::string, float> &utility_elapsed_ms) {
+  if (problem_spec.output_options.format == BenchRecord::OutputFormat::kText) {
+    return;
+  }
+  BenchRecord::Record record;
+  record.add("bench", "bench_spmm_csr");
+  record.add("routine", "cusparseSpMM+CSR");
+  record.add("A_num_rows", problem_spec.A_num_rows);
+  record.add("A_num_cols", problem_spec.A_num_cols);
+  record.add("B_num_cols", problem_spec.B_num_cols);
+  record.add("A_sparsity", problem_spec.A_sparsity);
+  record.add("A_nnz", runtime_data.A_nnz);
+  record.add(
+      "A_pattern",
+      RandomCSR::get_pattern_name(problem_spec.A_pattern_options.pattern));
+  record.add("dtype", "float32");
+  record.add("nstreams", 1);
+  if (problem_spec.enable_timing) {
+    record.add_timing_summary(summary);
+    record.add("gflops", (2.0 * runtime_data.A_nnz * problem_spec.B_num_cols) /
+                             (summary.median / 1000.0) / 1e9);
+    record.add_phase_times(utility_elapsed_ms);
+  }
+  record.add_host_info();
+  record.add_device_info();
+  BenchRecord::emit(problem_spec.output_options, record);
 }
 
 void cleanup_bench_spmm_csr(BenchSpmmCSRProblemSpec &problem_spec,
@@ -447,14 +532,15 @@ int main_bench_spmm_csr(const int argc, const char **argv) {
       generate_data_and_prepare_bench_spmm_csr(argc, argv, utility_timestamps);
   auto bench_spec = std::get<0>(bench_tuple);
   auto bench_data = std::get<1>(bench_tuple);
-  auto start_end_events = compute_bench_spmm_csr(
-      bench_spec, *(bench_data.get()), utility_timestamps);
-  auto start = std::get<0>(start_end_events);
-  auto stop = std::get<1>(start_end_events);
+  auto summary = compute_bench_spmm_csr(bench_spec, *(bench_data.get()),
+                                        utility_timestamps);
+  std::map<std::string, float> utility_elapsed_ms;
   if (bench_spec.enable_timing) {
-    consume_and_print_timing_bench_spmm_csr(
-        start, stop, bench_spec, *(bench_data.get()), utility_timestamps);
+    utility_elapsed_ms = consume_and_print_timing_bench_spmm_csr(
+        summary, bench_spec, *(bench_data.get()), utility_timestamps);
   }
+  emit_record_bench_spmm_csr(summary, bench_spec, *(bench_data.get()),
+                             utility_elapsed_ms);
   cleanup_bench_spmm_csr(bench_spec, *(bench_data.get()));
   return 0;
 }
\ No newline at end of file
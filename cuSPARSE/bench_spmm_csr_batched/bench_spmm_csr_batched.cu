@@ -52,6 +52,8 @@
 #include <stdlib.h>            // EXIT_FAILURE
 // #include <math.h>             // fabs
 #include <cusp/csr_matrix.h>  // cusp::csr_matrix
+#include <utils/bench_record.h>
+#include <utils/bench_timing.h>
 #include <utils/generate_random_data.h>
 #include <utils/helper_string.h>
 
@@ -90,12 +92,18 @@ int main(const int argc, const char **argv) {
   int B_num_cols = getCmdLineArgumentInt(argc, argv, "B_num_cols");
   float A_sparsity = getCmdLineArgumentFloat(argc, argv, "A_sparsity");
   int num_batches = getCmdLineArgumentInt(argc, argv, "num_batches");
+  BenchRecord::OutputOptions output_options =
+      BenchRecord::parse_output_options(argc, argv);
+  BenchTiming::Config timing_config = BenchTiming::parse_config(argc, argv);
 
-  if (argc != 6) {
+  if (A_num_rows == 0 || A_num_cols == 0 || B_num_cols == 0 ||
+      A_sparsity == 0 || num_batches == 0) {
     printf(
         "Usage: %s --A_num_rows=## --A_num_cols=## --B_num_cols=## "
         "--A_sparsity=0.## --num_batches=##\n",
         argv[0]);
+    BenchTiming::print_timing_usage();
+    BenchRecord::print_output_usage();
     return EXIT_FAILURE;
   }
   printf("A_num_rows: %d\n", A_num_rows);
@@ -238,7 +246,8 @@ int main(const int argc, const char **argv) {
   // execute SpMM
   // We nest the cuda event timing with std::chrono to make sure the cuda event
   // is getting correct results, we will use the cuda event timing results and
-  // ignore the std::chrono results
+  // ignore the std::chrono results. The warmup iterations are untimed and each
+  // sample is timed with the event pair on its own.
   std::chrono::time_point<std::chrono::system_clock> beg, end;
   cudaEvent_t start, stop;
   CHECK_CUDA(cudaEventCreate(&start));
@@ -246,24 +255,53 @@ int main(const int argc, const char **argv) {
   CHECK_CUDA(cudaDeviceSynchronize());
 
   beg = std::chrono::system_clock::now();
-  CHECK_CUDA(cudaEventRecord(start));
-  CHECK_CUSPARSE(cusparseSpMM(handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
-                              CUSPARSE_OPERATION_NON_TRANSPOSE, &alpha, matA,
-                              matB, &beta, matC, CUDA_R_32F,
-                              CUSPARSE_SPMM_CSR_ALG2, dBuffer))
-  CHECK_CUDA(cudaEventRecord(stop));
-  CHECK_CUDA(cudaEventSynchronize(stop));
+  for (int idx = 0; idx < timing_config.warmup_iters; idx++) {
+    CHECK_CUSPARSE(cusparseSpMM(handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
+                                CUSPARSE_OPERATION_NON_TRANSPOSE, &alpha, matA,
+                                matB, &beta, matC, CUDA_R_32F,
+                                CUSPARSE_SPMM_CSR_ALG2, dBuffer))
+  }
+  BenchTiming::Sampler sampler(timing_config);
+  while (!sampler.done()) {
+    CHECK_CUDA(cudaEventRecord(start));
+    CHECK_CUSPARSE(cusparseSpMM(handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
+                                CUSPARSE_OPERATION_NON_TRANSPOSE, &alpha, matA,
+                                matB, &beta, matC, CUDA_R_32F,
+                                CUSPARSE_SPMM_CSR_ALG2, dBuffer))
+    CHECK_CUDA(cudaEventRecord(stop));
+    CHECK_CUDA(cudaEventSynchronize(stop));
+    float elapsed_time = 0.0f;
+    CHECK_CUDA(cudaEventElapsedTime(&elapsed_time, start, stop));
+    sampler.add(elapsed_time);
+  }
   end = std::chrono::system_clock::now();
+  CHECK_CUDA(cudaEventDestroy(start));
+  CHECK_CUDA(cudaEventDestroy(stop));
 
-  float elapsed_time = 0.0f;
-  CHECK_CUDA(cudaEventElapsedTime(&elapsed_time, start, stop));
-  printf("cusparseSpMMBatched+CSR elapsed time (ms): %f\n", elapsed_time);
-  float throughput =
-      2.0 * A_nnz * B_num_cols * num_batches / (elapsed_time / 1000.0) / 1e9;
-  printf("cusparseSpMMBatched+CSR throughput (GFLOPS): %f\n", throughput);
+  BenchTiming::Summary summary = sampler.get_summary();
+  double flop = 2.0 * A_nnz * B_num_cols * num_batches;
+  BenchTiming::print_summary("cusparseSpMMBatched+CSR", summary, flop);
   printf(
-      "[DEBUG] chrono time (microseconds): %ld\n",
-      std::chrono::duration_cast<std::chrono::microseconds>(end - beg).count());
+      "[DEBUG] chrono time per iteration (microseconds): %ld\n",
+      std::chrono::duration_cast<std::chrono::microseconds>(end - beg).count() /
+          (summary.num_warmup + summary.num_samples));
+
+  BenchRecord::Record record;
+  record.add("bench", "bench_spmm_csr_batched");
+  record.add("routine", "cusparseSpMMBatched+CSR");
+  record.add("A_num_rows", A_num_rows);
+  record.add("A_num_cols", A_num_cols);
+  record.add("B_num_cols", B_num_cols);
+  record.add("A_sparsity", A_sparsity);
+  record.add("A_nnz", A_nnz);
+  record.add("num_batches", num_batches);
+  record.add("dtype", "float32");
+  record.add("nstreams", 1);
+  record.add_timing_summary(summary);
+  record.add("gflops", flop / (summary.median / 1000.0) / 1e9);
+  record.add_host_info();
+  record.add_device_info();
+  BenchRecord::emit(output_options, record);
 
   // destroy matrix/vector descriptors
   CHECK_CUSPARSE(cusparseDestroySpMat(matA))
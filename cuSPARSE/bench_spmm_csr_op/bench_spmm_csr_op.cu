@@ -52,6 +52,8 @@
 #include <stdio.h>            // printf
 #include <stdlib.h>           // EXIT_FAILURE
 #include <cusp/csr_matrix.h>
+#include <utils/bench_record.h>
+#include <utils/bench_timing.h>
 #include <utils/generate_random_data.h>
 #include <utils/helper_string.h>
 
@@ -169,8 +171,14 @@ int main(const int argc, const char** argv)
     int A_num_cols = getCmdLineArgumentInt(argc, argv, "A_num_cols");
     int B_num_cols = getCmdLineArgumentInt(argc, argv, "B_num_cols");
     float A_sparsity = getCmdLineArgumentFloat(argc, argv, "A_sparsity");
-    if (argc != 5){
+    BenchRecord::OutputOptions output_options =
+        BenchRecord::parse_output_options(argc, argv);
+    BenchTiming::Config timing_config = BenchTiming::parse_config(argc, argv);
+    if (A_num_rows == 0 || A_num_cols == 0 || B_num_cols == 0 ||
+        A_sparsity == 0.0f){
         printf("Usage: %s --A_num_rows=## --A_num_cols=## --B_num_cols=## --A_sparsity=0.##\n", argv[0]);
+        BenchTiming::print_timing_usage();
+        BenchRecord::print_output_usage();
         return EXIT_FAILURE;
     }
     printf("A_num_rows: %d\n", A_num_rows);
@@ -295,7 +303,47 @@ int main(const int argc, const char** argv)
     CHECK_CUDA(cudaMalloc(&dBuffer, bufferSize))
 
     // execute SpMM
-    CHECK_CUSPARSE(cusparseSpMMOp(plan, dBuffer))
+    // The epilogue reads the old C, so every iteration runs the same work on
+    // different C values
+    cudaEvent_t start, stop;
+    CHECK_CUDA(cudaEventCreate(&start))
+    CHECK_CUDA(cudaEventCreate(&stop))
+    for (int idx = 0; idx < timing_config.warmup_iters; idx++) {
+        CHECK_CUSPARSE(cusparseSpMMOp(plan, dBuffer))
+    }
+    BenchTiming::Sampler sampler(timing_config);
+    while (!sampler.done()) {
+        CHECK_CUDA(cudaEventRecord(start))
+        CHECK_CUSPARSE(cusparseSpMMOp(plan, dBuffer))
+        CHECK_CUDA(cudaEventRecord(stop))
+        CHECK_CUDA(cudaEventSynchronize(stop))
+        float elapsed_time = 0.0f;
+        CHECK_CUDA(cudaEventElapsedTime(&elapsed_time, start, stop))
+        sampler.add(elapsed_time);
+    }
+    CHECK_CUDA(cudaEventDestroy(start))
+    CHECK_CUDA(cudaEventDestroy(stop))
+
+    BenchTiming::Summary summary = sampler.get_summary();
+    double flop = 2.0 * A_nnz * B_num_cols;
+    BenchTiming::print_summary("cusparseSpMMOp+CSR", summary, flop);
+
+    BenchRecord::Record record;
+    record.add("bench", "bench_spmm_csr_op");
+    record.add("routine", "cusparseSpMMOp+CSR");
+    record.add("A_num_rows", A_num_rows);
+    record.add("A_num_cols", A_num_cols);
+    record.add("B_num_cols", B_num_cols);
+    record.add("A_sparsity", A_sparsity);
+    record.add("A_nnz", A_nnz);
+    record.add("dtype", "float32");
+    record.add("nstreams", 1);
+    record.add_timing_summary(summary);
+    record.add("gflops", flop / (summary.median / 1000.0) / 1e9);
+    record.add_host_info();
+    record.add_device_info();
+    BenchRecord::emit(output_options, record);
+    CHECK_CUSPARSE(cusparseSpMMOp_destroyPlan(plan))
 
     // destroy matrix/vector descriptors
     CHECK_CUSPARSE(cusparseDestroySpMat(matA))
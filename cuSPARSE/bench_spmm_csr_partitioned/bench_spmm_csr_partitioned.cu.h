@@ -53,6 +53,7 @@
 #include <cusparse.h>  // cusparseSpMM
 #include <stdio.h>     // printf
 #include <stdlib.h>    // EXIT_FAILURE
+#include <utils/bench_record.h>
 #include <utils/generate_random_data.h>
 // renamed this source file to .cpp to allow cstddef. Source:
 // https://talk.pokitto.com/t/sudden-error-cstddef-no-such-file-or-directory/711/4
@@ -60,15 +61,19 @@
 // elaborated here:
 // https://talk.pokitto.com/t/sudden-error-cstddef-no-such-file-or-directory/711/4
 #include <utils/helper_string.h>
+#include <utils/tile_scheduler.h>
 
 #include <chrono>
 #include <map>
 #include <string>
 #include <tuple>
 
+// Tiling and the tile-to-stream mapping come from utils/partition_csr.h (via
+// helper_cusp.cu.h) and utils/tile_scheduler.h. helper_kernels.cu.h and
+// helper_loops.cu.h, found on the external include path of the Makefile, are
+// not part of this tree and nothing here uses them any more, so they are not
+// included.
 #include "helper_cusp.cu.h"
-#include "helper_kernels.cu.h"
-#include "helper_loops.cu.h"
 #include "npy.hpp"
 
 #define CHECK_CUDA(func)                                                   \
@@ -97,6 +102,10 @@ struct TimingResults {
   std::vector<cudaEvent_t> stop_events;
   std::map<std::string, std::tuple<cudaEvent_t, cudaEvent_t>>
       utility_timestamps;
+  // Filled by consume_and_print_timing() and used by the result record, as
+  // the events are destroyed after being printed
+  std::map<std::string, float> elapsed_ms;
+  std::map<std::string, float> utility_elapsed_ms;
 };
 
 struct ProblemSpec {
@@ -116,6 +125,11 @@ struct ProblemSpec {
   bool flag_specify_result_path_and_prefix;
   bool test_API_on_stream;
   int nstreams;
+  bool balanced_tiles;
+  TileScheduler::Policy schedule_policy;
+  bool print_schedule;
+  BenchRecord::OutputOptions output_options;
+  RandomCSR::Options A_pattern_options;
 };
 
 struct RuntimeData {
@@ -139,6 +153,15 @@ struct RuntimeData {
   cusp::csr_matrix<int, float, cusp::host_memory> hA;
   std::vector<cusp::csr_matrix<int, float, cusp::host_memory>> hAA;
   std::vector<cusp::csr_matrix<int, float, cusp::device_memory>> dAA;
+  // Row and column cut points of the AA tiles. Uniform unless
+  // --balanced_tiles is specified.
+  PartitionCSR::Cuts AA_cuts;
+  // One task per (BB_col_idx, AA_col_idx, AA_row_idx) SpMM in loop order, and
+  // the stream each of them is issued on
+  std::vector<TileScheduler::Task> tasks;
+  TileScheduler::Assignment assignment;
+  // Recorded after an SpMM whose successor runs on another stream
+  std::vector<cudaEvent_t> task_events;
   // TODO: support multiple stream
   // The recommended way is to switch stream before CUSPARSE compute APIs by
   // cusparseSetStream() And in practice concurrent kernels won't be larger than
@@ -155,7 +178,7 @@ void print_usage() {
       "--AA_num_rows=## --AA_num_cols=## --BB_num_cols=## "
       "--A_sparsity=0.## [--enable_dump] [--result_path_and_prefix=...] "
       "[--enable_timing] [--enable_per_stream_timing] [--enable_debug_timing] "
-      "[--test_API_on_stream]\n");
+      "[--test_API_on_stream] [--balanced_tiles]\n");
   // Print the meaning of each argument
   printf(
       "--enable_timing records the elapsed time of the computation function\n"
@@ -170,7 +193,12 @@ void print_usage() {
       "When there are multiple streams, --enable_timing prints the elapsed\n"
       "time of the complete computation function:\n"
       "It waits all events on the first stream and print the elapsed time of\n"
-      "the.\n");
+      "the.\n"
+      "--balanced_tiles keeps the number of AA tiles but moves the row and\n"
+      "column cut points so that every tile gets roughly the same nnz\n");
+  TileScheduler::print_schedule_usage();
+  BenchRecord::print_output_usage();
+  RandomCSR::print_pattern_usage();
 }
 
 bool report_elapsed_time_per_stream(bool enable_per_stream_timing,
@@ -201,14 +229,28 @@ std::tuple<ProblemSpec, std::shared_ptr<RuntimeData>> generate_data_and_prepare(
   bool enable_per_stream_timing =
       checkCmdLineFlag(argc, argv, "enable_per_stream_timing");
   bool test_API_on_stream = checkCmdLineFlag(argc, argv, "test_API_on_stream");
+  bool balanced_tiles = checkCmdLineFlag(argc, argv, "balanced_tiles");
   bool enable_debug_timing =
       checkCmdLineFlag(argc, argv, "enable_debug_timing");
   char *cli_result_path_and_prefix;
   bool flag_specify_result_path_and_prefix = getCmdLineArgumentString(
       argc, argv, "result_path_and_prefix", &cli_result_path_and_prefix);
-  if (A_num_rows == 0 || A_num_cols == 0 || B_num_cols == 0 ||
-      AA_num_rows == 0 || AA_num_cols == 0 || BB_num_cols == 0 ||
-      A_sparsity == 0.0f) {
+  BenchRecord::OutputOptions output_options =
+      BenchRecord::parse_output_options(argc, argv);
+  bool print_schedule = checkCmdLineFlag(argc, argv, "print_schedule");
+  RandomCSR::Options A_pattern_options;
+  TileScheduler::Policy schedule_policy;
+  try {
+    A_pattern_options = RandomCSR::parse_options(argc, argv);
+    schedule_policy = TileScheduler::parse_policy(argc, argv);
+  } catch (const std::invalid_argument &e) {
+    printf("%s\n", e.what());
+    print_usage();
+    exit(EXIT_FAILURE);
+  }
+  if (A_num_rows <= 0 || A_num_cols <= 0 || B_num_cols <= 0 ||
+      AA_num_rows <= 0 || AA_num_cols <= 0 || BB_num_cols <= 0 ||
+      A_sparsity <= 0.0f) {
     print_usage();
     // Example: ./bench_spmm_csr_partitioned --A_num_rows=1024 --A_num_cols=512
     // --B_num_cols=512 --AA_num_rows=128 --AA_num_cols=64 --BB_num_cols=64
@@ -250,9 +292,19 @@ std::tuple<ProblemSpec, std::shared_ptr<RuntimeData>> generate_data_and_prepare(
   printf("AA_num_cols: %d\n", AA_num_cols);
   printf("BB_num_cols: %d\n", BB_num_cols);
   printf("A_sparsity: %f\n", A_sparsity);
+  printf("A_pattern: %s\n",
+         RandomCSR::get_pattern_name(A_pattern_options.pattern));
 
   // ***** END OF HOST PROBLEM DEFINITION *****
   int A_nnz = A_num_rows * A_num_cols * A_sparsity;
+  // The banded pattern only has the cells within the band
+  if (A_nnz >
+      RandomCSR::get_max_nnz(A_num_rows, A_num_cols, A_pattern_options)) {
+    printf("A_sparsity gives %d nonzeros, more than the %s pattern fits in A\n",
+           A_nnz, RandomCSR::get_pattern_name(A_pattern_options.pattern));
+    print_usage();
+    exit(EXIT_FAILURE);
+  }
   int B_num_rows = A_num_cols;
   int ldb = B_num_rows;
   int ldc = A_num_rows;
@@ -275,9 +327,19 @@ std::tuple<ProblemSpec, std::shared_ptr<RuntimeData>> generate_data_and_prepare(
   generate_random_matrix(hB, B_size);
   cusp::csr_matrix<int, float, cusp::host_memory> hA =
       generate_random_sparse_matrix_nodup<
-          cusp::csr_matrix<int, float, cusp::host_memory>>(A_num_rows,
-                                                           A_num_cols, A_nnz);
-  auto hAA = partitionMatrix(hA, AA_num_rows, AA_num_cols);
+          cusp::csr_matrix<int, float, cusp::host_memory>>(
+          A_num_rows, A_num_cols, A_nnz, A_pattern_options);
+  PartitionCSR::Cuts AA_cuts;
+  if (balanced_tiles) {
+    AA_cuts = getBalancedCuts(hA, A_num_rows / AA_num_rows,
+                              A_num_cols / AA_num_cols);
+  } else {
+    AA_cuts.row_cuts =
+        PartitionCSR::get_uniform_cuts(A_num_rows, A_num_rows / AA_num_rows);
+    AA_cuts.col_cuts =
+        PartitionCSR::get_uniform_cuts(A_num_cols, A_num_cols / AA_num_cols);
+  }
+  auto hAA = partitionMatrix(hA, AA_cuts);
   std::vector<cusp::csr_matrix<int, float, cusp::device_memory>> dAA;
   std::vector<int> AA_nnz;
   for (auto &AA : hAA) {
@@ -286,6 +348,36 @@ std::tuple<ProblemSpec, std::shared_ptr<RuntimeData>> generate_data_and_prepare(
   }
   A_nnz = hA.values.size();
   printf("actual A_nnz using non-dup random data generation: %d\n", A_nnz);
+  printf("AA_nnz max/mean: %f\n", PartitionCSR::get_imbalance(AA_nnz));
+
+  // The cost of each SpMM is its flop count. All AA tiles of one AA row
+  // accumulate into the same CC block, so they run one after the other in
+  // canonical order, with an event wait when they are on different streams.
+  std::vector<TileScheduler::Task> tasks;
+  for (int BB_col_idx = 0; BB_col_idx < B_num_cols / BB_num_cols;
+       BB_col_idx++) {
+    for (int AA_col_idx = 0; AA_col_idx < A_num_cols / AA_num_cols;
+         AA_col_idx++) {
+      for (int AA_row_idx = 0; AA_row_idx < A_num_rows / AA_num_rows;
+           AA_row_idx++) {
+        int idx_AA = AA_row_idx + AA_col_idx * A_num_rows / AA_num_rows;
+        int idx_CC = AA_row_idx + BB_col_idx * A_num_rows / AA_num_rows;
+        tasks.push_back(TileScheduler::Task{
+            .idx = {BB_col_idx, AA_col_idx, AA_row_idx},
+            .cost = 2.0 * AA_nnz[idx_AA] * BB_num_cols,
+            .output_block = idx_CC});
+      }
+    }
+  }
+  TileScheduler::Assignment assignment =
+      TileScheduler::schedule(tasks, nstreams, schedule_policy);
+  if (print_schedule) {
+    TileScheduler::print_assignment(tasks, assignment);
+  }
+  std::vector<cudaEvent_t> task_events(tasks.size());
+  for (auto &event : task_events) {
+    CHECK_CUDA(cudaEventCreateWithFlags(&event, cudaEventDisableTiming))
+  }
 
   cudaEvent_t handle_creation_start, handle_creation_stop;
   cudaEvent_t test_API_0_handle_creation_start, test_API_0_handle_creation_stop;
@@ -414,6 +506,10 @@ std::tuple<ProblemSpec, std::shared_ptr<RuntimeData>> generate_data_and_prepare(
                            .hA = hA,
                            .hAA = hAA,
                            .dAA = dAA,
+                           .AA_cuts = AA_cuts,
+                           .tasks = tasks,
+                           .assignment = assignment,
+                           .task_events = task_events,
                            .streams = streams};
 
   std::chrono::time_point<std::chrono::system_clock>
@@ -448,7 +544,10 @@ std::tuple<ProblemSpec, std::shared_ptr<RuntimeData>> generate_data_and_prepare(
                   .dAA[AA_row_idx + AA_col_idx * A_num_rows / AA_num_rows]
                   .num_entries;
           CHECK_CUSPARSE(cusparseCreateCsr(
-              &curr_matAA, AA_num_rows, AA_num_cols, curr_AA_nnz,
+              &curr_matAA,
+              AA_cuts.row_cuts[AA_row_idx + 1] - AA_cuts.row_cuts[AA_row_idx],
+              AA_cuts.col_cuts[AA_col_idx + 1] - AA_cuts.col_cuts[AA_col_idx],
+              curr_AA_nnz,
               // dA_csrOffsets, dA_columns, dA_values,
               (void *)thrust::raw_pointer_cast(
                   runtime_data
@@ -470,8 +569,10 @@ std::tuple<ProblemSpec, std::shared_ptr<RuntimeData>> generate_data_and_prepare(
           // Create dense matrix B
           cusparseDnMatDescr_t curr_matBB;
           CHECK_CUSPARSE(cusparseCreateDnMat(
-              &curr_matBB, AA_num_cols, BB_num_cols, ldb,
-              dB + /*row*/ (AA_col_idx * AA_num_cols) +
+              &curr_matBB,
+              AA_cuts.col_cuts[AA_col_idx + 1] - AA_cuts.col_cuts[AA_col_idx],
+              BB_num_cols, ldb,
+              dB + /*row*/ AA_cuts.col_cuts[AA_col_idx] +
                   /*col*/ (BB_col_idx * BB_num_cols) * A_num_cols,
               CUDA_R_32F, CUSPARSE_ORDER_COL))
           runtime_data.matBB.push_back(curr_matBB);
@@ -479,11 +580,13 @@ std::tuple<ProblemSpec, std::shared_ptr<RuntimeData>> generate_data_and_prepare(
         if (AA_col_idx == 0) {
           // Create dense matrix C
           cusparseDnMatDescr_t curr_matCC;
-          CHECK_CUSPARSE(
-              cusparseCreateDnMat(&curr_matCC, AA_num_rows, BB_num_cols, ldc,
-                                  dC + AA_row_idx * AA_num_rows +
-                                      BB_col_idx * BB_num_cols * A_num_rows,
-                                  CUDA_R_32F, CUSPARSE_ORDER_COL))
+          CHECK_CUSPARSE(cusparseCreateDnMat(
+              &curr_matCC,
+              AA_cuts.row_cuts[AA_row_idx + 1] - AA_cuts.row_cuts[AA_row_idx],
+              BB_num_cols, ldc,
+              dC + AA_cuts.row_cuts[AA_row_idx] +
+                  BB_col_idx * BB_num_cols * A_num_rows,
+              CUDA_R_32F, CUSPARSE_ORDER_COL))
           runtime_data.matCC.push_back(curr_matCC);
         }
       }
@@ -500,11 +603,9 @@ std::tuple<ProblemSpec, std::shared_ptr<RuntimeData>> generate_data_and_prepare(
         int idx_CC = AA_row_idx + BB_col_idx * A_num_rows / AA_num_rows;
         size_t curr_bufferSize;
         void *curr_dBuffer;
+        // The buffers are allocated in task order
         int idx_stream =
-            getCurrStream({BB_col_idx, AA_col_idx, AA_row_idx},
-                          {B_num_cols / BB_num_cols, A_num_cols / AA_num_cols,
-                           A_num_rows / AA_num_rows},
-                          nstreams);
+            assignment.stream_of_task[runtime_data.dBuffers.size()];
         // Allocate an external buffer if needed
         CHECK_CUSPARSE(cusparseSpMM_bufferSize(
             handles[idx_stream], CUSPARSE_OPERATION_NON_TRANSPOSE,
@@ -572,7 +673,12 @@ std::tuple<ProblemSpec, std::shared_ptr<RuntimeData>> generate_data_and_prepare(
       .flag_specify_result_path_and_prefix =
           flag_specify_result_path_and_prefix,
       .test_API_on_stream = test_API_on_stream,
-      .nstreams = nstreams};
+      .nstreams = nstreams,
+      .balanced_tiles = balanced_tiles,
+      .schedule_policy = schedule_policy,
+      .print_schedule = print_schedule,
+      .output_options = output_options,
+      .A_pattern_options = A_pattern_options};
   printf("dAA[0].values %p\n", runtime_data.dAA[0].values.data());
   auto bench_tuple = std::make_tuple(
       problem_spec, std::make_shared<RuntimeData>(std::move(runtime_data)));
@@ -653,48 +759,45 @@ void compute(ProblemSpec &problem_spec, RuntimeData &runtime_data,
     }
   }
 
+  // SpMMs are issued in schedule order. The first SpMM of a CC block applies
+  // beta and the following ones add to it, each after its predecessor, on
+  // another stream through the event recorded after the predecessor.
+  const float accumulate_beta = 1.0f;
   // TODO: skip if the sparse matrix size is 0
-  for (int BB_col_idx = 0;
-       BB_col_idx < problem_spec.B_num_cols / problem_spec.BB_num_cols;
-       BB_col_idx++) {
-    for (int AA_col_idx = 0;
-         AA_col_idx < problem_spec.A_num_cols / problem_spec.AA_num_cols;
-         AA_col_idx++) {
-      for (int AA_row_idx = 0;
-           AA_row_idx < problem_spec.A_num_rows / problem_spec.AA_num_rows;
-           AA_row_idx++) {
-        auto [idx_spmm, num_spmms] = get_canonical_loop_index_and_bound(
-            {BB_col_idx, AA_col_idx, AA_row_idx},
-            {problem_spec.B_num_cols / problem_spec.BB_num_cols,
-             problem_spec.A_num_cols / problem_spec.AA_num_cols,
-             problem_spec.A_num_rows / problem_spec.AA_num_rows});
-        int idx_stream =
-            getCurrStream({BB_col_idx, AA_col_idx, AA_row_idx},
-                          {problem_spec.B_num_cols / problem_spec.BB_num_cols,
-                           problem_spec.A_num_cols / problem_spec.AA_num_cols,
-                           problem_spec.A_num_rows / problem_spec.AA_num_rows},
-                          problem_spec.nstreams);
+  TileScheduler::issue_tasks(
+      runtime_data.assignment,
+      [&](int idx_spmm, int idx_stream) {
+        int BB_col_idx = runtime_data.tasks[idx_spmm].idx[0];
+        int AA_col_idx = runtime_data.tasks[idx_spmm].idx[1];
+        int AA_row_idx = runtime_data.tasks[idx_spmm].idx[2];
         int idx_AA = AA_row_idx + AA_col_idx * problem_spec.A_num_rows /
                                       problem_spec.AA_num_rows;
         int idx_BB = AA_col_idx + BB_col_idx * problem_spec.A_num_cols /
                                       problem_spec.AA_num_cols;
         int idx_CC = AA_row_idx + BB_col_idx * problem_spec.A_num_rows /
                                       problem_spec.AA_num_rows;
+        const float *beta = runtime_data.assignment.predecessor[idx_spmm] < 0
+                                ? &(runtime_data.beta)
+                                : &accumulate_beta;
 
         CHECK_CUSPARSE(cusparseSpMM(
             runtime_data.handles[idx_stream], CUSPARSE_OPERATION_NON_TRANSPOSE,
             CUSPARSE_OPERATION_NON_TRANSPOSE, &(runtime_data.alpha),
-            runtime_data.matAA[idx_AA], runtime_data.matBB[idx_BB],
-            &(runtime_data.beta), runtime_data.matCC[idx_CC], CUDA_R_32F,
-            CUSPARSE_SPMM_ALG_DEFAULT, runtime_data.dBuffers[idx_spmm]))
-
-        // idx_spmm++;
-      }
-    }
-  }
-
-  // Stream idx 0 waits for all other streams to finish before executing the
-  // reduction kernel
+            runtime_data.matAA[idx_AA], runtime_data.matBB[idx_BB], beta,
+            runtime_data.matCC[idx_CC], CUDA_R_32F, CUSPARSE_SPMM_ALG_DEFAULT,
+            runtime_data.dBuffers[idx_spmm]))
+      },
+      [&](int idx_spmm, int idx_stream) {
+        CHECK_CUDA(cudaEventRecord(runtime_data.task_events[idx_spmm],
+                                   runtime_data.streams[idx_stream]))
+      },
+      [&](int idx_stream, int idx_spmm) {
+        CHECK_CUDA(cudaStreamWaitEvent(runtime_data.streams[idx_stream],
+                                       runtime_data.task_events[idx_spmm]))
+      });
+
+  // Stream idx 0 waits for all other streams to finish. The CC blocks are
+  // accumulated in place, so no reduction kernel is needed.
   for (int idx = 1; idx < problem_spec.nstreams; idx++) {
     CHECK_CUDA(
         cudaEventRecord(stops_per_stream[idx], runtime_data.streams[idx]));
@@ -702,8 +805,6 @@ void compute(ProblemSpec &problem_spec, RuntimeData &runtime_data,
                                    stops_per_stream[idx]));
   }
 
-  // TODO: need to add reduce_segements
-
   if (problem_spec.enable_timing)
     CHECK_CUDA(cudaEventRecord(stops_per_stream.front(),
                                runtime_data.streams.front()));
@@ -772,6 +873,7 @@ void consume_and_print_timing(ProblemSpec &problem_spec,
     CHECK_CUDA(cudaEventSynchronize(stop));
     float elapsed_time = 0.0f;
     CHECK_CUDA(cudaEventElapsedTime(&elapsed_time, start, stop));
+    timing_results.elapsed_ms["total"] = elapsed_time;
     printf("cusparseSpMM+CSR+Partitioned elapsed time (ms): %f\n",
            elapsed_time);
     printf("cusparseSpMM+CSR+Partitioned throughput (GFLOPS): %f\n",
@@ -800,6 +902,8 @@ void consume_and_print_timing(ProblemSpec &problem_spec,
       printf(
           "cusparseSpMM+CSR+Partitioned elapsed time(streamIdx%d) (ms): %f\n",
           idx, elapsed_time);
+      timing_results.elapsed_ms["stream" + std::to_string(idx)] =
+          elapsed_time;
       // TODO: enable throughput print
       CHECK_CUDA(cudaEventDestroy(timing_results.start_events[idx]));
       CHECK_CUDA(cudaEventDestroy(timing_results.stop_events[idx]));
@@ -815,11 +919,57 @@ void consume_and_print_timing(ProblemSpec &problem_spec,
                                     std::get<1>(value)));
     printf("cusparseSpMM+CSR+Partitioned %s elapsed time(util) (ms): %f\n",
            key.c_str(), elapsed_time_util);
+    timing_results.utility_elapsed_ms[key] = elapsed_time_util;
     CHECK_CUDA(cudaEventDestroy(std::get<0>(value)));
     CHECK_CUDA(cudaEventDestroy(std::get<1>(value)));
   }
 }
 
+void emit_record(ProblemSpec &problem_spec, RuntimeData &runtime_data,
+                 TimingResults &timing_results) {
+  if (problem_spec.output_options.format == BenchRecord::OutputFormat::kText) {
+    return;
+  }
+  BenchRecord::Record record;
+  record.add("bench", "bench_spmm_csr_partitioned");
+  record.add("routine", "cusparseSpMM+CSR+Partitioned");
+  record.add("A_num_rows", problem_spec.A_num_rows);
+  record.add("A_num_cols", problem_spec.A_num_cols);
+  record.add("B_num_cols", problem_spec.B_num_cols);
+  record.add("AA_num_rows", problem_spec.AA_num_rows);
+  record.add("AA_num_cols", problem_spec.AA_num_cols);
+  record.add("BB_num_cols", problem_spec.BB_num_cols);
+  record.add("A_sparsity", problem_spec.A_sparsity);
+  record.add("A_nnz", runtime_data.A_nnz);
+  record.add(
+      "A_pattern",
+      RandomCSR::get_pattern_name(problem_spec.A_pattern_options.pattern));
+  record.add("dtype", "float32");
+  record.add("nstreams", problem_spec.nstreams);
+  record.add("balanced_tiles", problem_spec.balanced_tiles);
+  record.add("schedule",
+             TileScheduler::get_policy_name(problem_spec.schedule_policy));
+  record.add("schedule.imbalance",
+             TileScheduler::get_imbalance(runtime_data.assignment));
+  record.add("schedule.cross_stream_edges",
+             runtime_data.assignment.cross_stream_edges);
+  record.add("AA_nnz_imbalance",
+             PartitionCSR::get_imbalance(runtime_data.AA_nnz));
+  record.add("enable_graph", problem_spec.enable_graph);
+  for (const auto &keyval : timing_results.elapsed_ms) {
+    record.add("time_ms." + keyval.first, keyval.second);
+  }
+  if (timing_results.elapsed_ms.count("total") > 0) {
+    record.add("gflops", (2.0 * runtime_data.A_nnz * problem_spec.B_num_cols) /
+                             (timing_results.elapsed_ms["total"] / 1000.0) /
+                             1e9);
+  }
+  record.add_phase_times(timing_results.utility_elapsed_ms);
+  record.add_host_info();
+  record.add_device_info();
+  BenchRecord::emit(problem_spec.output_options, record);
+}
+
 void cleanup(ProblemSpec &problem_spec, RuntimeData &runtime_data) {
   // Destroy matrix/vector descriptors
   int idx_spmm = 0;
@@ -897,6 +1047,9 @@ void cleanup(ProblemSpec &problem_spec, RuntimeData &runtime_data) {
     free(hC);
   }
 
+  for (auto &event : runtime_data.task_events) {
+    CHECK_CUDA(cudaEventDestroy(event))
+  }
   for (int idx = 0; idx < problem_spec.nstreams; idx++) {
     CHECK_CUSPARSE(cusparseDestroy(runtime_data.handles[idx]))
     CHECK_CUDA(cudaStreamDestroy(runtime_data.streams[idx]))
@@ -966,6 +1119,11 @@ int main(const int argc, const char **argv) {
     graph_initialization_end = std::chrono::system_clock::now();
     launch_graph_and_wait(*(bench_data.get()));
     graph_execution_end = std::chrono::system_clock::now();
+    timing_results.elapsed_ms["graph_execution_chrono"] =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            graph_execution_end - graph_initialization_end)
+            .count() /
+        1000.0f;
     printf(
         "[DEBUG] cusparseSpMM+CSR+Partitioned graph creation chrono time "
         "(microseconds): "
@@ -1001,6 +1159,7 @@ int main(const int argc, const char **argv) {
     CHECK_CUDA(cudaGraphExecDestroy(bench_data.get()->graphExecs[0]));
     CHECK_CUDA(cudaGraphDestroy(bench_data.get()->graphs[0]));
   }
+  emit_record(bench_spec, *(bench_data.get()), timing_results);
   cleanup(bench_spec, *(bench_data.get()));
   return 0;
 }
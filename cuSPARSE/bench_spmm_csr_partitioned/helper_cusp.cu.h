@@ -0,0 +1,59 @@
+#pragma once
+// cusp adapters of the host-side CSR tiler in utils/partition_csr.h
+#include <cusp/csr_matrix.h>
+#include <utils/partition_csr.h>
+
+#include <algorithm>
+#include <vector>
+
+template <typename IndexType, typename ValueType>
+PartitionCSR::Cuts getBalancedCuts(
+    const cusp::csr_matrix<IndexType, ValueType, cusp::host_memory> &A,
+    int num_row_tiles, int num_col_tiles) {
+  return PartitionCSR::get_balanced_cuts(
+      A.num_rows, A.num_cols, thrust::raw_pointer_cast(A.row_offsets.data()),
+      thrust::raw_pointer_cast(A.column_indices.data()), num_row_tiles,
+      num_col_tiles);
+}
+
+// Splits A along the given cuts. The tiles are returned in column-major tile
+// order, i.e., tile (i, j) is at index i + j * (cuts.row_cuts.size() - 1).
+template <typename IndexType, typename ValueType>
+std::vector<cusp::csr_matrix<IndexType, ValueType, cusp::host_memory>>
+partitionMatrix(
+    const cusp::csr_matrix<IndexType, ValueType, cusp::host_memory> &A,
+    const PartitionCSR::Cuts &cuts) {
+  auto tiles = PartitionCSR::partition(
+      A.num_rows, A.num_cols, thrust::raw_pointer_cast(A.row_offsets.data()),
+      thrust::raw_pointer_cast(A.column_indices.data()),
+      thrust::raw_pointer_cast(A.values.data()), cuts);
+  std::vector<cusp::csr_matrix<IndexType, ValueType, cusp::host_memory>>
+      result;
+  result.reserve(tiles.size());
+  for (const auto &tile : tiles) {
+    result.emplace_back(tile.row_end - tile.row_begin,
+                        tile.col_end - tile.col_begin, tile.values.size());
+    auto &AA = result.back();
+    std::copy(tile.row_offsets.begin(), tile.row_offsets.end(),
+              AA.row_offsets.begin());
+    std::copy(tile.column_indices.begin(), tile.column_indices.end(),
+              AA.column_indices.begin());
+    std::copy(tile.values.begin(), tile.values.end(), AA.values.begin());
+  }
+  return result;
+}
+
+// Splits A into uniform AA_num_rows x AA_num_cols tiles. The matrix
+// dimensions must be multiples of the tile dimensions.
+template <typename IndexType, typename ValueType>
+std::vector<cusp::csr_matrix<IndexType, ValueType, cusp::host_memory>>
+partitionMatrix(
+    const cusp::csr_matrix<IndexType, ValueType, cusp::host_memory> &A,
+    int AA_num_rows, int AA_num_cols) {
+  PartitionCSR::Cuts cuts{
+      .row_cuts =
+          PartitionCSR::get_uniform_cuts(A.num_rows, A.num_rows / AA_num_rows),
+      .col_cuts =
+          PartitionCSR::get_uniform_cuts(A.num_cols, A.num_cols / AA_num_cols)};
+  return partitionMatrix(A, cuts);
+}
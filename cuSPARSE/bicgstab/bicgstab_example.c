@@ -49,9 +49,13 @@
 #include <cublas_v2.h>
 #include <cuda_runtime.h>
 #include <cusparse.h>
+#include <math.h>   // fabs
 #include <stdio.h>  // fopen
 #include <stdlib.h> // EXIT_FAILURE
-#include <string.h> // strtok
+#include <string.h> // strcmp
+
+#include "csr_reorder.h" // csr_reorder
+#include "mtx_loader.h"  // mtx_load_csr
 
 #define CHECK_CUDA(func)                                                       \
 {                                                                              \
@@ -96,95 +100,6 @@ typedef struct VecStruct {
 
 //==============================================================================
 
-void mtx_header(const char* file_path,
-                int*        num_lines,
-                int*        num_rows,
-                int*        num_cols,
-                int*        nnz,
-                int*        is_symmetric) {
-    char buffer[256];
-    FILE* file = fopen(file_path, "r");
-    if (file == NULL) {
-        printf("Error: unable to open the file %s\n", file_path);
-        exit(EXIT_FAILURE);
-    }
-    fgets(buffer, 256, file); // skip comments
-    char *token = strtok(buffer, " ");
-    if (strcmp(token, "%%MatrixMarket") != 0) {
-        printf("Unsupported file format. Only MTX format is supported");
-        exit(EXIT_FAILURE);
-    }
-    strtok(NULL, " "); // skip word
-    strtok(NULL, " "); // skip word
-    token = strtok(NULL, " "); // check data type
-    if (strcmp(token, "real") != 0) {
-        printf("Only real (double) matrices are supported");
-        exit(EXIT_FAILURE);
-    }
-    token = strtok(NULL, " \n"); // symmetric, unsymmetric
-    *is_symmetric = (strcmp(token, "symmetric") == 0);
-    while (fgetc(file) == '%')
-        fgets(buffer, 256, file); // skip % comments
-    fseek(file, -1, SEEK_CUR);
-    fscanf(file, "%d %d %d", num_rows, num_cols, num_lines);
-    *nnz = (*is_symmetric) ? *num_lines * 2 : *num_lines;
-    fclose(file);
-}
-
-void mtx_parsing(const char* file_path,
-                 int         num_lines,
-                 int         num_rows,
-                 int         nnz,
-                 int*        rows_offsets,
-                 int*        columns,
-                 double*     values,
-                 int         base) {
-    typedef struct IdxType {
-        int    row, col;
-        double val;
-    } Idx;
-    int sort_by_row(const void *a, const void *b) {
-        return ((Idx*) a)->row - ((Idx*) b)->row;
-    }
-    char buffer[256];
-    FILE* file = fopen(file_path, "r");
-    while (fgetc(file) == '%')
-        fgets(buffer, 256, file); // skip comments
-    fgets(buffer, 256, file);     // skip num row, cols, nnz
-
-    Idx* idx_tmp = (Idx*) malloc(nnz * sizeof(Idx));
-    for (int i = 0; i < num_lines; i++) {
-        int    row, column;
-        double value;
-        fscanf(file, "%d %d %lf ", &row, &column, &value);
-        row         -= (1 - base);
-        column      -= (1 - base);
-        idx_tmp[i].row = row;
-        idx_tmp[i].col = column;
-        idx_tmp[i].val = value;
-        if (nnz != num_lines) { // is stored symmetric
-            idx_tmp[i + num_lines].row = column;
-            idx_tmp[i + num_lines].col = row;
-            idx_tmp[i + num_lines].val = value;
-        }
-    }
-    qsort(idx_tmp, nnz, sizeof(Idx), sort_by_row); // sort by row
-    memset(rows_offsets, 0x0, (num_rows + 1) * sizeof(int));
-    for (int i = 0; i < nnz; i++)
-        rows_offsets[idx_tmp[i].row + 1]++;
-    // prefix-scan
-    for (int i = 1; i <= num_rows; i++)
-        rows_offsets[i] = rows_offsets[i] + rows_offsets[i - 1];
-    for (int i = 0; i < nnz; i++) {
-        columns[i] = idx_tmp[i].col;
-        values[i]  = idx_tmp[i].val;
-    }
-    fclose(file);
-    free(idx_tmp);
-}
-
-//==============================================================================
-
 int gpu_BiCGStab(cublasHandle_t       cublasHandle,
                  cusparseHandle_t     cusparseHandle,
                  int                  m,
@@ -431,41 +346,69 @@ int gpu_BiCGStab(cublasHandle_t       cublasHandle,
 int main(int argc, char** argv) {
     const int    maxIterations = 20;
     const double tolerance     = 0.0000000001;
-    printf("Usage: bicgstab_example <matrix.mtx>\n");
-    if (argc != 2) {
-        printf("Wrong parameter: bicgstab_example <matrix.mtx>\n");
+    printf("Usage: bicgstab_example <matrix.mtx> [none|rcm|amd|color]\n");
+    CsrOrdering ordering = CSR_ORDERING_NONE;
+    if (argc < 2 || argc > 3 ||
+        (argc == 3 && csr_parse_ordering(argv[2], &ordering) != 0)) {
+        printf("Wrong parameter: bicgstab_example <matrix.mtx> "
+               "[none|rcm|amd|color]\n");
         return EXIT_FAILURE;
     }
-    int base = 0;
-    int num_rows, num_cols, nnz, num_lines, is_symmetric;
-    mtx_header(argv[1], &num_lines, &num_rows, &num_cols, &nnz, &is_symmetric);
+    int    base = 0;
+    MtxCsr A;
+    printf("Matrix parsing...\n");
+    if (mtx_load_csr(argv[1], base, &A) != 0)
+        return EXIT_FAILURE;
+    int num_rows = A.num_rows, num_cols = A.num_cols, nnz = A.nnz;
     printf("\nmatrix name: %s\n"
            "num. rows:   %d\n"
            "num. cols:   %d\n"
            "nnz:         %d\n"
-           "structure:   %s\n\n",
-           argv[1], num_rows, num_cols, nnz,
-           (is_symmetric) ? "symmetric" : "unsymmetric");
+           "structure:   %s %s%s\n\n",
+           argv[1], num_rows, num_cols, nnz, A.field, A.symmetry,
+           (A.from_cache) ? " (cached CSR)" : "");
     if (num_rows != num_cols) {
         printf("the input matrix must be square\n");
         return EXIT_FAILURE;
     }
-    if (!is_symmetric) {
+    if (A.is_complex) {
+        printf("the input matrix must be real\n");
+        return EXIT_FAILURE;
+    }
+    if (!A.is_symmetric || strcmp(A.symmetry, "skew-symmetric") == 0) {
         printf("the input matrix must be symmetric\n");
         return EXIT_FAILURE;
     }
-    int     m           = num_rows;
-    int     num_offsets = m + 1;
-    int*    h_A_rows    = (int*)    malloc(num_offsets * sizeof(int));
-    int*    h_A_columns = (int*)    malloc(nnz * sizeof(int));
-    double* h_A_values  = (double*) malloc(nnz * sizeof(double));
-    double* h_X         = (double*) malloc(m * sizeof(double));
-    printf("Matrix parsing...\n");
-    mtx_parsing(argv[1], num_lines, num_rows, nnz, h_A_rows,
-                h_A_columns, h_A_values, base);
+    // Reorder A -> A(P, P) to shorten the triangular solves of the
+    // preconditioner; the system is solved for P * x and unpermuted at the end
+    CsrReordered R;
+    if (csr_reorder(num_rows, A.rows_offsets, A.columns, A.values, ordering,
+                    &R) != 0)
+        return EXIT_FAILURE;
+    if (ordering != CSR_ORDERING_NONE) {
+        printf("ordering:    %s (%.3f s)\n"
+               "             %12s %12s\n"
+               "L levels:    %12lld %12lld\n"
+               "U levels:    %12lld %12lld\n"
+               "bandwidth:   %12lld %12lld\n"
+               "fill of L:   %12lld %12lld\n\n",
+               csr_ordering_name(ordering), R.order_time, "before", "after",
+               R.before.lower_levels, R.after.lower_levels,
+               R.before.upper_levels, R.after.upper_levels,
+               R.before.bandwidth, R.after.bandwidth,
+               R.before.fill, R.after.fill);
+    }
+    int           m           = num_rows;
+    int           num_offsets = m + 1;
+    const int*    h_A_rows    = R.rows_offsets;
+    const int*    h_A_columns = R.columns;
+    const double* h_A_values  = R.values;
+    double*       h_X         = (double*) malloc(m * sizeof(double));
+    double*       h_X_perm    = (double*) malloc(m * sizeof(double));
     printf("Testing BiCGStab\n");
     for (int i = 0; i < num_rows; i++)
         h_X[i] = 1.0;
+    csr_permute_vector(&R, h_X, h_X_perm);
     //--------------------------------------------------------------------------
     // ### Device memory management ###
     int*    d_A_rows, *d_A_columns;
@@ -499,7 +442,7 @@ int main(int argc, char** argv) {
                            cudaMemcpyHostToDevice) )
     CHECK_CUDA( cudaMemcpy(d_M_values, h_A_values, nnz * sizeof(double),
                            cudaMemcpyHostToDevice) )
-    CHECK_CUDA( cudaMemcpy(d_X.ptr, h_X, m * sizeof(double),
+    CHECK_CUDA( cudaMemcpy(d_X.ptr, h_X_perm, m * sizeof(double),
                            cudaMemcpyHostToDevice) )
     //--------------------------------------------------------------------------
     // ### cuSPARSE Handle and descriptors initialization ###
@@ -621,6 +564,19 @@ int main(int argc, char** argv) {
                  matA, matM_lower, matM_upper,
                  d_B, d_X, d_R0, d_R, d_P, d_P_aux, d_S, d_S_aux, d_V, d_T,
                  d_tmp, d_bufferMV, maxIterations, tolerance);
+    // X = P^T * X_perm, compared with the exact solution 0.75 * ones
+    CHECK_CUDA( cudaMemcpy(h_X_perm, d_X.ptr, m * sizeof(double),
+                           cudaMemcpyDeviceToHost) )
+    csr_unpermute_vector(&R, h_X_perm, h_X);
+    if (ordering != CSR_ORDERING_NONE) {
+        double max_error = 0.0;
+        for (int i = 0; i < m; i++) {
+            double error = fabs(h_X[i] - alpha);
+            if (error > max_error)
+                max_error = error;
+        }
+        printf("Max error of the unpermuted solution = %e\n", max_error);
+    }
     //--------------------------------------------------------------------------
     // ### Free resources ###
     CHECK_CUSPARSE( cusparseDestroyDnVec(d_B.vec) )
@@ -640,10 +596,10 @@ int main(int argc, char** argv) {
     CHECK_CUSPARSE( cusparseDestroy(cusparseHandle) )
     CHECK_CUBLAS( cublasDestroy(cublasHandle) )
 
-    free(h_A_rows);
-    free(h_A_columns);
-    free(h_A_values);
+    csr_free_reordered(&R);
+    mtx_free_csr(&A);
     free(h_X);
+    free(h_X_perm);
 
     CHECK_CUDA( cudaFree(d_X.ptr) )
     CHECK_CUDA( cudaFree(d_B.ptr) )
@@ -0,0 +1,207 @@
+/*
+ * Copyright 1993-2022 NVIDIA Corporation.  All rights reserved.
+ *
+ * NOTICE TO LICENSEE:
+ *
+ * This source code and/or documentation ("Licensed Deliverables") are
+ * subject to NVIDIA intellectual property rights under U.S. and
+ * international Copyright laws.
+ *
+ * These Licensed Deliverables contained herein is PROPRIETARY and
+ * CONFIDENTIAL to NVIDIA and is being provided under the terms and
+ * conditions of a form of NVIDIA software license agreement by and
+ * between NVIDIA and Licensee ("License Agreement") or electronically
+ * accepted by Licensee.  Notwithstanding any terms or conditions to
+ * the contrary in the License Agreement, reproduction or disclosure
+ * of the Licensed Deliverables to any third party without the express
+ * written consent of NVIDIA is prohibited.
+ *
+ * NOTWITHSTANDING ANY TERMS OR CONDITIONS TO THE CONTRARY IN THE
+ * LICENSE AGREEMENT, NVIDIA MAKES NO REPRESENTATION ABOUT THE
+ * SUITABILITY OF THESE LICENSED DELIVERABLES FOR ANY PURPOSE.  IT IS
+ * PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY OF ANY KIND.
+ * NVIDIA DISCLAIMS ALL WARRANTIES WITH REGARD TO THESE LICENSED
+ * DELIVERABLES, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY,
+ * NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE.
+ * NOTWITHSTANDING ANY TERMS OR CONDITIONS TO THE CONTRARY IN THE
+ * LICENSE AGREEMENT, IN NO EVENT SHALL NVIDIA BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+ * ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THESE LICENSED DELIVERABLES.
+ *
+ * U.S. Government End Users.  These Licensed Deliverables are a
+ * "commercial item" as that term is defined at 48 C.F.R. 2.101 (OCT
+ * 1995), consisting of "commercial computer software" and "commercial
+ * computer software documentation" as such terms are used in 48
+ * C.F.R. 12.212 (SEPT 1995) and is provided to the U.S. Government
+ * only as a commercial end item.  Consistent with 48 C.F.R.12.212 and
+ * 48 C.F.R. 227.7202-1 through 227.7202-4 (JUNE 1995), all
+ * U.S. Government End Users acquire the Licensed Deliverables with
+ * only those rights set forth herein.
+ *
+ * Any use of the Licensed Deliverables in individual and commercial
+ * software must include, in the user documentation and internal
+ * comments to the code, the above Disclaimer and U.S. Government End
+ * Users Notice.
+ */
+#include <algorithm> // std::fill
+#include <chrono>    // std::chrono
+#include <cmath>     // std::fabs
+#include <cstdio>    // printf
+#include <cstdlib>   // EXIT_FAILURE
+#include <cstring>   // strcmp
+#include <thread>    // std::thread
+#include <vector>    // std::vector
+
+#include <utils/host_krylov.h> // HostKrylov
+#include <utils/thread_pool.h> // ThreadPool
+
+#include "csr_reorder.h" // csr_reorder
+#include "mtx_loader.h"  // mtx_load_csr
+
+// Host reference runs of cg_example and bicgstab_example: same input
+// handling, right-hand side, solver settings and output, on the CPU only
+
+int main(int argc, char** argv) {
+    printf("Usage: host_solvers_example <cg|bicgstab> <matrix.mtx> "
+           "[none|rcm|amd|color]\n");
+    CsrOrdering ordering = CSR_ORDERING_NONE;
+    if (argc < 3 || argc > 4 ||
+        (strcmp(argv[1], "cg") != 0 && strcmp(argv[1], "bicgstab") != 0) ||
+        (argc == 4 && csr_parse_ordering(argv[3], &ordering) != 0)) {
+        printf("Wrong parameter: host_solvers_example <cg|bicgstab> "
+               "<matrix.mtx> [none|rcm|amd|color]\n");
+        return EXIT_FAILURE;
+    }
+    // settings of cg_example.c and bicgstab_example.c
+    const bool   is_cg         = strcmp(argv[1], "cg") == 0;
+    const char*  method        = is_cg ? "CG" : "BiCGStab";
+    const int    maxIterations = is_cg ? 10000 : 20;
+    const double tolerance     = is_cg ? 1e-8f : 0.0000000001;
+    size_t       num_threads   = std::thread::hardware_concurrency();
+    const char*  threads       = getenv("HOST_SOLVER_THREADS");
+    if (threads != NULL)
+        num_threads = static_cast<size_t>(atoi(threads));
+    if (num_threads == 0)
+        num_threads = 1;
+
+    int    base = 0;
+    MtxCsr A;
+    printf("Matrix parsing...\n");
+    if (mtx_load_csr(argv[2], base, &A) != 0)
+        return EXIT_FAILURE;
+    int num_rows = A.num_rows, num_cols = A.num_cols, nnz = A.nnz;
+    printf("\nmatrix name: %s\n"
+           "num. rows:   %d\n"
+           "num. cols:   %d\n"
+           "nnz:         %d\n"
+           "structure:   %s %s%s\n\n",
+           argv[2], num_rows, num_cols, nnz, A.field, A.symmetry,
+           (A.from_cache) ? " (cached CSR)" : "");
+    if (num_rows != num_cols) {
+        printf("the input matrix must be square\n");
+        return EXIT_FAILURE;
+    }
+    if (A.is_complex) {
+        printf("the input matrix must be real\n");
+        return EXIT_FAILURE;
+    }
+    if (!A.is_symmetric || strcmp(A.symmetry, "skew-symmetric") == 0) {
+        printf("the input matrix must be symmetric\n");
+        return EXIT_FAILURE;
+    }
+    CsrReordered R;
+    if (csr_reorder(num_rows, A.rows_offsets, A.columns, A.values, ordering,
+                    &R) != 0)
+        return EXIT_FAILURE;
+    if (ordering != CSR_ORDERING_NONE) {
+        printf("ordering:    %s (%.3f s)\n"
+               "             %12s %12s\n"
+               "L levels:    %12lld %12lld\n"
+               "U levels:    %12lld %12lld\n"
+               "bandwidth:   %12lld %12lld\n"
+               "fill of L:   %12lld %12lld\n\n",
+               csr_ordering_name(ordering), R.order_time, "before", "after",
+               R.before.lower_levels, R.after.lower_levels,
+               R.before.upper_levels, R.after.upper_levels,
+               R.before.bandwidth, R.after.bandwidth,
+               R.before.fill, R.after.fill);
+    }
+    int                  m = num_rows;
+    HostKrylov::CsrView  matA = { m, R.rows_offsets, R.columns, R.values };
+    std::vector<double>  h_X(m, 1.0), h_X_perm(m), h_B(m);
+    printf("Testing %s\n", method);
+    csr_permute_vector(&R, h_X.data(), h_X_perm.data());
+    //--------------------------------------------------------------------------
+    ThreadPool pool(num_threads);
+    // b = A * X
+    const double alpha = 0.75;
+    HostKrylov::spmv(matA, alpha, h_X_perm.data(), 0.0, h_B.data(), &pool);
+    // X0 = 0
+    std::fill(h_X_perm.begin(), h_X_perm.end(), 0.0);
+    //--------------------------------------------------------------------------
+    // IC0 (CG) or ILU0 (BiCGStab) factorization and level analysis
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point   start = Clock::now();
+    HostKrylov::Factors factors;
+    try {
+        factors = is_cg ? HostKrylov::ic0(matA, &pool)
+                        : HostKrylov::ilu0(matA, &pool);
+    }
+    catch (const std::exception& error) {
+        printf("Error: %s\n", error.what());
+        return EXIT_FAILURE;
+    }
+    double setup_time =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    if (factors.zero_pivot >= 0)
+        printf("zero pivot in row %d\n", factors.zero_pivot);
+    //--------------------------------------------------------------------------
+    printf("%s loop:\n", method);
+    start = Clock::now();
+    HostKrylov::History history =
+        is_cg ? HostKrylov::cg(matA, factors, h_B.data(), h_X_perm.data(),
+                               maxIterations, tolerance, &pool)
+              : HostKrylov::bicgstab(matA, factors, h_B.data(),
+                                     h_X_perm.data(), maxIterations,
+                                     tolerance, &pool);
+    double solve_time =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    HostKrylov::print_history(history);
+    //--------------------------------------------------------------------------
+    // X = P^T * X_perm, compared with the exact solution 0.75 * ones
+    csr_unpermute_vector(&R, h_X_perm.data(), h_X.data());
+    if (ordering != CSR_ORDERING_NONE) {
+        double max_error = 0.0;
+        for (int i = 0; i < m; i++) {
+            double error = std::fabs(h_X[i] - alpha);
+            if (error > max_error)
+                max_error = error;
+        }
+        printf("Max error of the unpermuted solution = %e\n", max_error);
+    }
+    // SpMV alone, as a throughput baseline
+    const int spmv_runs = 10;
+    start = Clock::now();
+    for (int i = 0; i < spmv_runs; i++)
+        HostKrylov::spmv(matA, 1.0, h_X_perm.data(), 0.0, h_B.data(), &pool);
+    double spmv_time =
+        std::chrono::duration<double>(Clock::now() - start).count() /
+        spmv_runs;
+    size_t iterations = history.norms.size();
+    printf("\nhost threads:  %zu\n"
+           "factor levels: %d (lower) %d (upper)\n"
+           "setup time:    %.3f s\n"
+           "solve time:    %.3f s (%.3f ms per iteration)\n"
+           "SpMV:          %.2f GFLOP/s\n",
+           pool.size(), factors.lower.num_levels(),
+           factors.upper.num_levels(), setup_time, solve_time,
+           iterations ? 1e3 * solve_time / iterations : 0.0,
+           spmv_time > 0.0 ? 2.0 * nnz / spmv_time * 1e-9 : 0.0);
+    //--------------------------------------------------------------------------
+    csr_free_reordered(&R);
+    mtx_free_csr(&A);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright 1993-2022 NVIDIA Corporation.  All rights reserved.
+ *
+ * NOTICE TO LICENSEE:
+ *
+ * This source code and/or documentation ("Licensed Deliverables") are
+ * subject to NVIDIA intellectual property rights under U.S. and
+ * international Copyright laws.
+ *
+ * These Licensed Deliverables contained herein is PROPRIETARY and
+ * CONFIDENTIAL to NVIDIA and is being provided under the terms and
+ * conditions of a form of NVIDIA software license agreement by and
+ * between NVIDIA and Licensee ("License Agreement") or electronically
+ * accepted by Licensee.  Notwithstanding any terms or conditions to
+ * the contrary in the License Agreement, reproduction or disclosure
+ * of the Licensed Deliverables to any third party without the express
+ * written consent of NVIDIA is prohibited.
+ *
+ * NOTWITHSTANDING ANY TERMS OR CONDITIONS TO THE CONTRARY IN THE
+ * LICENSE AGREEMENT, NVIDIA MAKES NO REPRESENTATION ABOUT THE
+ * SUITABILITY OF THESE LICENSED DELIVERABLES FOR ANY PURPOSE.  IT IS
+ * PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY OF ANY KIND.
+ * NVIDIA DISCLAIMS ALL WARRANTIES WITH REGARD TO THESE LICENSED
+ * DELIVERABLES, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY,
+ * NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE.
+ * NOTWITHSTANDING ANY TERMS OR CONDITIONS TO THE CONTRARY IN THE
+ * LICENSE AGREEMENT, IN NO EVENT SHALL NVIDIA BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+ * ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THESE LICENSED DELIVERABLES.
+ *
+ * U.S. Government End Users.  These Licensed Deliverables are a
+ * "commercial item" as that term is defined at 48 C.F.R. 2.101 (OCT
+ * 1995), consisting of "commercial computer software" and "commercial
+ * computer software documentation" as such terms are used in 48
+ * C.F.R. 12.212 (SEPT 1995) and is provided to the U.S. Government
+ * only as a commercial end item.  Consistent with 48 C.F.R.12.212 and
+ * 48 C.F.R. 227.7202-1 through 227.7202-4 (JUNE 1995), all
+ * U.S. Government End Users acquire the Licensed Deliverables with
+ * only those rights set forth herein.
+ *
+ * Any use of the Licensed Deliverables in individual and commercial
+ * software must include, in the user documentation and internal
+ * comments to the code, the above Disclaimer and U.S. Government End
+ * Users Notice.
+ */
+#include "csr_reorder.h"
+
+#include <utils/sparse_reorder.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace {
+struct ReorderHandle {
+    SparseReorder::Csr   matrix;
+    std::vector<int32_t> perm;
+};
+
+CsrOrderStats to_stats(const SparseReorder::Stats& stats) {
+    CsrOrderStats result;
+    result.lower_levels = stats.lower_levels;
+    result.upper_levels = stats.upper_levels;
+    result.bandwidth    = stats.bandwidth;
+    result.fill         = stats.fill;
+    return result;
+}
+
+SparseReorder::Ordering to_ordering(CsrOrdering ordering) {
+    switch (ordering) {
+        case CSR_ORDERING_RCM:   return SparseReorder::Ordering::kRcm;
+        case CSR_ORDERING_AMD:   return SparseReorder::Ordering::kAmd;
+        case CSR_ORDERING_COLOR: return SparseReorder::Ordering::kColor;
+        default:                 return SparseReorder::Ordering::kNone;
+    }
+}
+} // namespace
+
+extern "C" int csr_parse_ordering(const char* name, CsrOrdering* ordering) {
+    const CsrOrdering orderings[] = { CSR_ORDERING_NONE, CSR_ORDERING_RCM,
+                                      CSR_ORDERING_AMD, CSR_ORDERING_COLOR };
+    for (CsrOrdering candidate : orderings) {
+        if (strcmp(name, csr_ordering_name(candidate)) == 0) {
+            *ordering = candidate;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+extern "C" const char* csr_ordering_name(CsrOrdering ordering) {
+    return SparseReorder::ordering_name(to_ordering(ordering));
+}
+
+extern "C" int csr_reorder(int           num_rows,
+                           const int*    rows_offsets,
+                           const int*    columns,
+                           const double* values,
+                           CsrOrdering   ordering,
+                           CsrReordered* reordered) {
+    memset(reordered, 0, sizeof(*reordered));
+    ReorderHandle* handle = NULL;
+    try {
+        handle = new ReorderHandle();
+        reordered->before = to_stats(
+            SparseReorder::analyze(num_rows, rows_offsets, columns));
+        auto start   = std::chrono::steady_clock::now();
+        handle->perm = SparseReorder::order(to_ordering(ordering), num_rows,
+                                            rows_offsets, columns);
+        reordered->order_time = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        handle->matrix = SparseReorder::permute(num_rows, rows_offsets,
+                                                columns, values,
+                                                handle->perm, &pool);
+        reordered->after = to_stats(SparseReorder::analyze(
+            num_rows, handle->matrix.row_offsets.data(),
+            handle->matrix.columns.data()));
+    }
+    catch (const std::exception& error) {
+        printf("Error: %s\n", error.what());
+        delete handle;
+        memset(reordered, 0, sizeof(*reordered));
+        return 1;
+    }
+    reordered->num_rows     = num_rows;
+    reordered->nnz          = handle->matrix.row_offsets[num_rows];
+    reordered->rows_offsets = handle->matrix.row_offsets.data();
+    reordered->columns      = handle->matrix.columns.data();
+    reordered->values       = handle->matrix.values.data();
+    reordered->perm         = handle->perm.data();
+    reordered->handle       = handle;
+    return 0;
+}
+
+extern "C" void csr_permute_vector(const CsrReordered* reordered,
+                                   const double*       x,
+                                   double*             x_new) {
+    const ReorderHandle* handle =
+        static_cast<const ReorderHandle*>(reordered->handle);
+    SparseReorder::permute_vector(handle->perm, x, x_new);
+}
+
+extern "C" void csr_unpermute_vector(const CsrReordered* reordered,
+                                     const double*       x_new,
+                                     double*             x) {
+    const ReorderHandle* handle =
+        static_cast<const ReorderHandle*>(reordered->handle);
+    SparseReorder::unpermute_vector(handle->perm, x_new, x);
+}
+
+extern "C" void csr_free_reordered(CsrReordered* reordered) {
+    delete static_cast<ReorderHandle*>(reordered->handle);
+    memset(reordered, 0, sizeof(*reordered));
+}
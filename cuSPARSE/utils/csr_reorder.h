@@ -0,0 +1,115 @@
+/*
+ * Copyright 1993-2022 NVIDIA Corporation.  All rights reserved.
+ *
+ * NOTICE TO LICENSEE:
+ *
+ * This source code and/or documentation ("Licensed Deliverables") are
+ * subject to NVIDIA intellectual property rights under U.S. and
+ * international Copyright laws.
+ *
+ * These Licensed Deliverables contained herein is PROPRIETARY and
+ * CONFIDENTIAL to NVIDIA and is being provided under the terms and
+ * conditions of a form of NVIDIA software license agreement by and
+ * between NVIDIA and Licensee ("License Agreement") or electronically
+ * accepted by Licensee.  Notwithstanding any terms or conditions to
+ * the contrary in the License Agreement, reproduction or disclosure
+ * of the Licensed Deliverables to any third party without the express
+ * written consent of NVIDIA is prohibited.
+ *
+ * NOTWITHSTANDING ANY TERMS OR CONDITIONS TO THE CONTRARY IN THE
+ * LICENSE AGREEMENT, NVIDIA MAKES NO REPRESENTATION ABOUT THE
+ * SUITABILITY OF THESE LICENSED DELIVERABLES FOR ANY PURPOSE.  IT IS
+ * PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY OF ANY KIND.
+ * NVIDIA DISCLAIMS ALL WARRANTIES WITH REGARD TO THESE LICENSED
+ * DELIVERABLES, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY,
+ * NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE.
+ * NOTWITHSTANDING ANY TERMS OR CONDITIONS TO THE CONTRARY IN THE
+ * LICENSE AGREEMENT, IN NO EVENT SHALL NVIDIA BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+ * ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THESE LICENSED DELIVERABLES.
+ *
+ * U.S. Government End Users.  These Licensed Deliverables are a
+ * "commercial item" as that term is defined at 48 C.F.R. 2.101 (OCT
+ * 1995), consisting of "commercial computer software" and "commercial
+ * computer software documentation" as such terms are used in 48
+ * C.F.R. 12.212 (SEPT 1995) and is provided to the U.S. Government
+ * only as a commercial end item.  Consistent with 48 C.F.R.12.212 and
+ * 48 C.F.R. 227.7202-1 through 227.7202-4 (JUNE 1995), all
+ * U.S. Government End Users acquire the Licensed Deliverables with
+ * only those rights set forth herein.
+ *
+ * Any use of the Licensed Deliverables in individual and commercial
+ * software must include, in the user documentation and internal
+ * comments to the code, the above Disclaimer and U.S. Government End
+ * Users Notice.
+ */
+#pragma once
+
+/*
+ * C interface of the reorderings of 3rdparty/utils/sparse_reorder.h for the
+ * C samples, implemented in csr_reorder.cpp.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CSR_ORDERING_NONE,
+    CSR_ORDERING_RCM,   /* reverse Cuthill-McKee: bandwidth */
+    CSR_ORDERING_AMD,   /* approximate minimum degree: fill */
+    CSR_ORDERING_COLOR  /* greedy colouring: triangular solve levels */
+} CsrOrdering;
+
+typedef struct CsrOrderStatsStruct {
+    long long lower_levels; /* levels of the lower triangular solve */
+    long long upper_levels; /* levels of the upper triangular solve */
+    long long bandwidth;
+    long long fill;         /* nnz of the complete Cholesky factor */
+} CsrOrderStats;
+
+/* A(perm, perm) of a square 0-based CSR matrix with sorted columns */
+typedef struct CsrReorderedStruct {
+    int           num_rows;
+    int           nnz;
+    const int*    rows_offsets;
+    const int*    columns;
+    const double* values;
+    const int*    perm;      /* perm[new] = old */
+    CsrOrderStats before;
+    CsrOrderStats after;
+    double        order_time; /* seconds spent computing the ordering */
+    void*         handle;
+} CsrReordered;
+
+/* Returns 0 and sets ordering for none, rcm, amd or color, 1 otherwise */
+int csr_parse_ordering(const char* name, CsrOrdering* ordering);
+
+const char* csr_ordering_name(CsrOrdering ordering);
+
+/* Returns 0 on success; prints the reason and returns 1 on failure */
+int csr_reorder(int           num_rows,
+                const int*    rows_offsets,
+                const int*    columns,
+                const double* values,
+                CsrOrdering   ordering,
+                CsrReordered* reordered);
+
+/* x_new[i] = x[perm[i]] */
+void csr_permute_vector(const CsrReordered* reordered,
+                        const double*       x,
+                        double*             x_new);
+
+/* x[perm[i]] = x_new[i] */
+void csr_unpermute_vector(const CsrReordered* reordered,
+                          const double*       x_new,
+                          double*             x);
+
+void csr_free_reordered(CsrReordered* reordered);
+
+#ifdef __cplusplus
+}
+#endif
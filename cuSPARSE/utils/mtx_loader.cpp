@@ -0,0 +1,118 @@
+/*
+ * Copyright 1993-2022 NVIDIA Corporation.  All rights reserved.
+ *
+ * NOTICE TO LICENSEE:
+ *
+ * This source code and/or documentation ("Licensed Deliverables") are
+ * subject to NVIDIA intellectual property rights under U.S. and
+ * international Copyright laws.
+ *
+ * These Licensed Deliverables contained herein is PROPRIETARY and
+ * CONFIDENTIAL to NVIDIA and is being provided under the terms and
+ * conditions of a form of NVIDIA software license agreement by and
+ * between NVIDIA and Licensee ("License Agreement") or electronically
+ * accepted by Licensee.  Notwithstanding any terms or conditions to
+ * the contrary in the License Agreement, reproduction or disclosure
+ * of the Licensed Deliverables to any third party without the express
+ * written consent of NVIDIA is prohibited.
+ *
+ * NOTWITHSTANDING ANY TERMS OR CONDITIONS TO THE CONTRARY IN THE
+ * LICENSE AGREEMENT, NVIDIA MAKES NO REPRESENTATION ABOUT THE
+ * SUITABILITY OF THESE LICENSED DELIVERABLES FOR ANY PURPOSE.  IT IS
+ * PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY OF ANY KIND.
+ * NVIDIA DISCLAIMS ALL WARRANTIES WITH REGARD TO THESE LICENSED
+ * DELIVERABLES, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY,
+ * NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE.
+ * NOTWITHSTANDING ANY TERMS OR CONDITIONS TO THE CONTRARY IN THE
+ * LICENSE AGREEMENT, IN NO EVENT SHALL NVIDIA BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+ * ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THESE LICENSED DELIVERABLES.
+ *
+ * U.S. Government End Users.  These Licensed Deliverables are a
+ * "commercial item" as that term is defined at 48 C.F.R. 2.101 (OCT
+ * 1995), consisting of "commercial computer software" and "commercial
+ * computer software documentation" as such terms are used in 48
+ * C.F.R. 12.212 (SEPT 1995) and is provided to the U.S. Government
+ * only as a commercial end item.  Consistent with 48 C.F.R.12.212 and
+ * 48 C.F.R. 227.7202-1 through 227.7202-4 (JUNE 1995), all
+ * U.S. Government End Users acquire the Licensed Deliverables with
+ * only those rights set forth herein.
+ *
+ * Any use of the Licensed Deliverables in individual and commercial
+ * software must include, in the user documentation and internal
+ * comments to the code, the above Disclaimer and U.S. Government End
+ * Users Notice.
+ */
+#include "mtx_loader.h"
+
+#include <utils/mtx_reader.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <vector>
+
+namespace {
+struct MtxHandle {
+    MtxReader::Matrix   matrix;
+    // copies with a base other than 0
+    std::vector<int>    rows_offsets;
+    std::vector<int>    columns;
+};
+} // namespace
+
+extern "C" int mtx_load_csr(const char* file_path, int base, MtxCsr* csr) {
+    memset(csr, 0, sizeof(*csr));
+    MtxReader::Options options;
+    const char* cache = getenv("MTX_CSR_CACHE");
+    options.use_cache = (cache == NULL || strcmp(cache, "0") != 0);
+    const char* threads = getenv("MTX_READER_THREADS");
+    if (threads != NULL)
+        options.num_threads = static_cast<size_t>(atoi(threads));
+    MtxHandle* handle = NULL;
+    try {
+        handle         = new MtxHandle();
+        handle->matrix = MtxReader::load(file_path, options);
+    }
+    catch (const std::exception& error) {
+        printf("Error: %s\n", error.what());
+        delete handle;
+        return 1;
+    }
+    const MtxReader::Matrix& matrix = handle->matrix;
+    csr->num_rows     = matrix.num_rows();
+    csr->num_cols     = matrix.num_cols();
+    csr->nnz          = matrix.nnz();
+    csr->is_complex   = matrix.value_size() == 2;
+    csr->is_symmetric = matrix.symmetry() != MtxReader::Symmetry::kGeneral;
+    csr->field        = MtxReader::field_name(matrix.field());
+    csr->symmetry     = MtxReader::symmetry_name(matrix.symmetry());
+    csr->rows_offsets = matrix.row_offsets();
+    csr->columns      = matrix.columns();
+    csr->values       = matrix.values();
+    csr->from_cache   = matrix.from_cache();
+    csr->handle       = handle;
+    if (base != 0) {
+        handle->rows_offsets.assign(matrix.row_offsets(),
+                                    matrix.row_offsets() + csr->num_rows + 1);
+        handle->columns.assign(matrix.columns(),
+                               matrix.columns() + csr->nnz);
+        for (int& offset : handle->rows_offsets)
+            offset += base;
+        for (int& column : handle->columns)
+            column += base;
+        csr->rows_offsets = handle->rows_offsets.data();
+        csr->columns      = handle->columns.data();
+    }
+    return 0;
+}
+
+extern "C" void mtx_free_csr(MtxCsr* csr) {
+    delete static_cast<MtxHandle*>(csr->handle);
+    memset(csr, 0, sizeof(*csr));
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 1993-2022 NVIDIA Corporation.  All rights reserved.
+ *
+ * NOTICE TO LICENSEE:
+ *
+ * This source code and/or documentation ("Licensed Deliverables") are
+ * subject to NVIDIA intellectual property rights under U.S. and
+ * international Copyright laws.
+ *
+ * These Licensed Deliverables contained herein is PROPRIETARY and
+ * CONFIDENTIAL to NVIDIA and is being provided under the terms and
+ * conditions of a form of NVIDIA software license agreement by and
+ * between NVIDIA and Licensee ("License Agreement") or electronically
+ * accepted by Licensee.  Notwithstanding any terms or conditions to
+ * the contrary in the License Agreement, reproduction or disclosure
+ * of the Licensed Deliverables to any third party without the express
+ * written consent of NVIDIA is prohibited.
+ *
+ * NOTWITHSTANDING ANY TERMS OR CONDITIONS TO THE CONTRARY IN THE
+ * LICENSE AGREEMENT, NVIDIA MAKES NO REPRESENTATION ABOUT THE
+ * SUITABILITY OF THESE LICENSED DELIVERABLES FOR ANY PURPOSE.  IT IS
+ * PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY OF ANY KIND.
+ * NVIDIA DISCLAIMS ALL WARRANTIES WITH REGARD TO THESE LICENSED
+ * DELIVERABLES, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY,
+ * NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE.
+ * NOTWITHSTANDING ANY TERMS OR CONDITIONS TO THE CONTRARY IN THE
+ * LICENSE AGREEMENT, IN NO EVENT SHALL NVIDIA BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+ * WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+ * ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THESE LICENSED DELIVERABLES.
+ *
+ * U.S. Government End Users.  These Licensed Deliverables are a
+ * "commercial item" as that term is defined at 48 C.F.R. 2.101 (OCT
+ * 1995), consisting of "commercial computer software" and "commercial
+ * computer software documentation" as such terms are used in 48
+ * C.F.R. 12.212 (SEPT 1995) and is provided to the U.S. Government
+ * only as a commercial end item.  Consistent with 48 C.F.R.12.212 and
+ * 48 C.F.R. 227.7202-1 through 227.7202-4 (JUNE 1995), all
+ * U.S. Government End Users acquire the Licensed Deliverables with
+ * only those rights set forth herein.
+ *
+ * Any use of the Licensed Deliverables in individual and commercial
+ * software must include, in the user documentation and internal
+ * comments to the code, the above Disclaimer and U.S. Government End
+ * Users Notice.
+ */
+#pragma once
+
+/*
+ * C interface of the Matrix Market reader of 3rdparty/utils/mtx_reader.h for
+ * the C samples, implemented in mtx_loader.cpp.
+ *
+ * The sidecar cache (<file>.csr) is enabled unless the environment variable
+ * MTX_CSR_CACHE is 0; MTX_READER_THREADS sets the number of parsing threads
+ * (default: one per hardware thread).
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MtxCsrStruct {
+    int           num_rows;
+    int           num_cols;
+    int           nnz;          /* after expansion of symmetric storage */
+    int           is_complex;   /* 2 doubles (real, imaginary) per value */
+    int           is_symmetric; /* stored as one triangle */
+    const char*   field;        /* real, integer, complex or pattern */
+    const char*   symmetry;     /* general, symmetric, skew-symmetric, hermitian */
+    const int*    rows_offsets; /* num_rows + 1, sorted columns within rows */
+    const int*    columns;      /* nnz */
+    const double* values;       /* nnz, or 2 * nnz if is_complex */
+    int           from_cache;
+    void*         handle;
+} MtxCsr;
+
+/* Returns 0 on success; prints the reason and returns 1 on failure */
+int mtx_load_csr(const char* file_path,
+                 int         base,
+                 MtxCsr*     csr);
+
+void mtx_free_csr(MtxCsr* csr);
+
+#ifdef __cplusplus
+}
+#endif
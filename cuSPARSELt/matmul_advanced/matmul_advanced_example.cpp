@@ -51,6 +51,8 @@
 #include <cstdlib>            // std::rand
 #include <cuda_runtime_api.h> // cudaMalloc, cudaMemcpy, etc.
 #include <cusparseLt.h>       // cusparseLt header
+#include <vector>             // std::vector
+#include <utils/host_matmul_cusparse.h> // HostMatmul
 
 #define CHECK_CUDA(func)                                                       \
 {                                                                              \
@@ -358,49 +360,45 @@ int main(void) {
 
     if (print_sparse_matrix)
         print_matrix(hA, A_height, A_width, lda, num_batches, batch_strideA);
-    bool A_std_layout = (is_rowmajor != isA_transposed);
-    bool B_std_layout = (is_rowmajor != isB_transposed);
-    auto ReLU         = [=](float value) {
+    auto ReLU = [=](float value) {
         if (value <= relu_threshold)
             return 0.0f;
         return std::min(value, relu_upper_bound);
     };
     // host computation
-    auto hC_result = new float[C_size];
+    auto host_order = HostMatmul::get_order(order);
+    auto descA      = HostMatmul::make_desc(hA, type, order, opA, lda,
+                                            batch_strideA);
+    auto descB      = HostMatmul::make_desc(hB, type, order, opB, ldb,
+                                            batch_strideB);
+    HostMatmul::Options host_options;
+    host_options.batch_count = num_batches;
+    std::vector<float> hC_result(C_size);
+    HostMatmul::matmul(m, n, k, descA, descB, hC_result.data(), host_order,
+                       ldc, batch_strideC, host_options);
     for (int b = 0; b < num_batches; b++) {
         for (int i = 0; i < m; i++) {
             for (int j = 0; j < n; j++) {
-                float sum = 0.0f;
-                for (int k1 = 0; k1 < k; k1++) {
-                    auto posA = (A_std_layout) ? i * lda + k1 : i + k1 * lda;
-                    auto posB = (B_std_layout) ? k1 * ldb + j : k1 + j * ldb;
-                    posA     += b * batch_strideA;
-                    posB     += b * batch_strideB;
-                    sum      += static_cast<float>(hA[posA]) *  // [i][k]
-                                static_cast<float>(hB[posB]);   // [k][j]
-                }
-                auto posC       = (is_rowmajor) ? i * ldc + j : i + j * ldc;
-                posC           += b * batch_strideC;
-                hC_result[posC] = ReLU(sum + 1.0f /*bias*/);  // [i][j]
+                auto pos        = (is_rowmajor) ? i * ldc + j : i + j * ldc;
+                pos            += b * batch_strideC;
+                hC_result[pos]  = ReLU(hC_result[pos] + hBias[i]);  // [i][j]
             }
         }
     }
     // host-device comparison
-    int correct = 1;
-    for (int b = 0; b < num_batches; b++) {
-        for (int i = 0; i < m; i++) {
-            for (int j = 0; j < n; j++) {
-                auto pos          = (is_rowmajor) ? i * ldc + j : i + j * ldc;
-                pos              += b * batch_strideC;
-                auto device_value = static_cast<float>(hC[pos]);
-                auto host_value   = hC_result[pos];
-                if (device_value != host_value) {
-                    // direct floating point comparison is not reliable
-                    correct = 0;
-                    break;
-                }
-            }
-        }
+    auto output_type = HostMatmul::get_element_type(type);
+    auto tolerance   = HostMatmul::get_default_tolerance(output_type);
+    auto comparison  = HostMatmul::compare(m, n, hC, output_type,
+                                           hC_result.data(), host_order, ldc,
+                                           batch_strideC, num_batches,
+                                           tolerance);
+    int correct = (comparison.num_mismatches == 0);
+    if (!correct) {
+        std::printf("batch %d (%d, %d):\t%f vs. %f\n",
+                    comparison.first_batch,
+                    static_cast<int>(comparison.first_row),
+                    static_cast<int>(comparison.first_col),
+                    comparison.first_expected, comparison.first_actual);
     }
     if (correct)
         std::printf("matmul_advanced_example test PASSED\n");
@@ -411,7 +409,6 @@ int main(void) {
     delete[] hA;
     delete[] hB;
     delete[] hC;
-    delete[] hC_result;
     delete[] hBias;
     //--------------------------------------------------------------------------
     // device memory deallocation
@@ -48,10 +48,14 @@
  */
 #include <cuda_runtime_api.h> // cudaMalloc, cudaMemcpy, etc.
 #include <cusparseLt.h>       // cusparseLt header
+#include <utils/bench_record.h>
+#include <utils/bench_timing.h>
 #include <utils/helper_string.h>
+#include <utils/host_matmul_cusparse.h>
 
 #include <cstdio>  // printf
 #include <cstdlib> // std::rand
+#include <vector>  // std::vector
 
 #define CHECK_CUDA(func)                                                       \
   {                                                                            \
@@ -93,8 +97,13 @@ int main(const int argc, const char **argv) {
   int n = getCmdLineArgumentInt(argc, argv, "n");
   int k = getCmdLineArgumentInt(argc, argv, "k");
   bool tune_flag = checkCmdLineFlag(argc, argv, "tune");
+  BenchRecord::OutputOptions output_options =
+      BenchRecord::parse_output_options(argc, argv);
+  BenchTiming::Config timing_config = BenchTiming::parse_config(argc, argv);
   if (argc < 4) {
     printf("Usage: %s --m=## --n=## --k=## [--tune]\n", argv[0]);
+    BenchTiming::print_timing_usage();
+    BenchRecord::print_output_usage();
     return EXIT_FAILURE;
   }
   printf("m: %d\n", m);
@@ -254,10 +263,31 @@ int main(const int argc, const char **argv) {
 
   CHECK_CUDA(cudaEventRecord(after_workspace_alloc))
 
-  // Perform the matrix multiplication
-  CHECK_CUSPARSE(cusparseLtMatmul(&handle, &plan, &alpha, dA_compressed, dB,
-                                  &beta, dC, dD, d_workspace, streams,
-                                  num_streams))
+  // Perform the matrix multiplication: untimed warmup iterations, then one
+  // event pair per sample. beta is 0, so every iteration writes the same D.
+  for (int idx = 0; idx < timing_config.warmup_iters; idx++) {
+    CHECK_CUSPARSE(cusparseLtMatmul(&handle, &plan, &alpha, dA_compressed, dB,
+                                    &beta, dC, dD, d_workspace, streams,
+                                    num_streams))
+  }
+  cudaEvent_t sample_start, sample_stop;
+  CHECK_CUDA(cudaEventCreate(&sample_start))
+  CHECK_CUDA(cudaEventCreate(&sample_stop))
+  BenchTiming::Sampler sampler(timing_config);
+  while (!sampler.done()) {
+    CHECK_CUDA(cudaEventRecord(sample_start))
+    CHECK_CUSPARSE(cusparseLtMatmul(&handle, &plan, &alpha, dA_compressed, dB,
+                                    &beta, dC, dD, d_workspace, streams,
+                                    num_streams))
+    CHECK_CUDA(cudaEventRecord(sample_stop))
+    CHECK_CUDA(cudaEventSynchronize(sample_stop))
+    float sample_ms = 0.0f;
+    CHECK_CUDA(cudaEventElapsedTime(&sample_ms, sample_start, sample_stop))
+    sampler.add(sample_ms);
+  }
+  CHECK_CUDA(cudaEventDestroy(sample_start))
+  CHECK_CUDA(cudaEventDestroy(sample_stop))
+  BenchTiming::Summary summary = sampler.get_summary();
 
   CHECK_CUDA(cudaEventRecord(after_execution))
   //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -288,8 +318,9 @@ int main(const int argc, const char **argv) {
       cudaEventElapsedTime(&time_tuning, after_compression, after_tuning))
   CHECK_CUDA(cudaEventElapsedTime(&time_workspace_alloc, after_tuning,
                                   after_workspace_alloc))
-  CHECK_CUDA(cudaEventElapsedTime(&time_execution, after_workspace_alloc,
-                                  after_execution))
+  // The span between the two events covers all iterations; the execution
+  // phase is the median sample
+  time_execution = summary.median;
   CHECK_CUDA(cudaEventElapsedTime(&time_destruction, after_execution,
                                   after_destruction))
 
@@ -308,48 +339,60 @@ int main(const int argc, const char **argv) {
                                  time_verification + time_compression +
                                  time_tuning + time_execution +
                                  time_destruction);
+  BenchTiming::print_summary("cusparseLtMatmul", summary, 2.0 * m * n * k);
   //--------------------------------------------------------------------------
   // device result check
   // matrix A has been pruned
   CHECK_CUDA(cudaMemcpy(hA, dA, A_size, cudaMemcpyDeviceToHost))
   CHECK_CUDA(cudaMemcpy(hC, dC, C_size, cudaMemcpyDeviceToHost))
 
-  bool A_std_layout = (is_rowmajor != isA_transposed);
-  bool B_std_layout = (is_rowmajor != isB_transposed);
   // host computation
-  float hC_result[m * n];
-  for (int i = 0; i < m; i++) {
-    for (int j = 0; j < n; j++) {
-      float sum = 0.0f;
-      for (int k1 = 0; k1 < k; k1++) {
-        auto posA = (A_std_layout) ? i * lda + k1 : i + k1 * lda;
-        auto posB = (B_std_layout) ? k1 * ldb + j : k1 + j * ldb;
-        sum += static_cast<float>(hA[posA]) * // [i][k]
-               static_cast<float>(hB[posB]);  // [k][j]
-      }
-      auto posC = (is_rowmajor) ? i * ldc + j : i + j * ldc;
-      hC_result[posC] = sum; // [i][j]
-    }
-  }
+  auto host_order = HostMatmul::get_order(order);
+  auto descA = HostMatmul::make_desc(hA, type, order, opA, lda);
+  auto descB = HostMatmul::make_desc(hB, type, order, opB, ldb);
+  std::vector<float> hC_result =
+      HostMatmul::matmul(m, n, k, descA, descB, host_order, ldc);
   // host-device comparison
-  int correct = 1;
-  for (int i = 0; i < m; i++) {
-    for (int j = 0; j < n; j++) {
-      auto pos = (is_rowmajor) ? i * ldc + j : i + j * ldc;
-      auto device_value = static_cast<float>(hC[pos]);
-      auto host_value = hC_result[pos];
-      if (device_value != host_value) {
-        // direct floating point comparison is not reliable
-        std::printf("(%d, %d):\t%f vs. %f\n", i, j, host_value, device_value);
-        correct = 0;
-        break;
-      }
-    }
+  auto output_type = HostMatmul::get_element_type(type);
+  auto comparison = HostMatmul::compare(
+      m, n, hC, output_type, hC_result.data(), host_order, ldc, 0, 1,
+      HostMatmul::get_default_tolerance(output_type));
+  int correct = (comparison.num_mismatches == 0);
+  if (!correct) {
+    std::printf("(%d, %d):\t%f vs. %f\n",
+                static_cast<int>(comparison.first_row),
+                static_cast<int>(comparison.first_col),
+                comparison.first_expected, comparison.first_actual);
   }
   if (correct)
     std::printf("matmul_example test PASSED\n");
   else
     std::printf("matmul_example test FAILED: wrong result\n");
+
+  BenchRecord::Record record;
+  record.add("bench", "matmul_bench");
+  record.add("routine", "cusparseLtMatmul");
+  record.add("m", m);
+  record.add("n", n);
+  record.add("k", k);
+  record.add("tune", tune_flag);
+  record.add("dtype", "float16");
+  record.add("nstreams", num_streams);
+  record.add_timing_summary(summary);
+  record.add("gflops", (2.0 * m * n * k) / (time_execution / 1000.0) / 1e9);
+  record.add("phase_ms.handle_creation", time_handle_creation);
+  record.add("phase_ms.pruning", time_pruning);
+  record.add("phase_ms.verification", time_verification);
+  record.add("phase_ms.compression", time_compression);
+  record.add("phase_ms.tuning", time_tuning);
+  record.add("phase_ms.workspace_allocation", time_workspace_alloc);
+  record.add("phase_ms.destruction", time_destruction);
+  record.add("max_abs_error", comparison.max_abs_error);
+  record.add("max_rel_error", comparison.max_rel_error);
+  record.add("status", correct ? "PASSED" : "FAILED");
+  record.add_host_info();
+  record.add_device_info();
+  BenchRecord::emit(output_options, record);
   //--------------------------------------------------------------------------
   // device memory deallocation
   CHECK_CUDA(cudaFree(dA_compressed))
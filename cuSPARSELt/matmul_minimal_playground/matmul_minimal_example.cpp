@@ -48,9 +48,11 @@
  */
 #include <cuda_runtime_api.h> // cudaMalloc, cudaMemcpy, etc.
 #include <cusparseLt.h>       // cusparseLt header
+#include <utils/host_matmul_cusparse.h>
 
 #include <cstdio>  // printf
 #include <cstdlib> // std::rand
+#include <vector>  // std::vector
 
 struct cusparseLtSpMatHandleAndData {
   cusparseLtMatDescriptor_t mat;
@@ -271,37 +273,23 @@ int main(void) {
   CHECK_CUDA(cudaMemcpy(hA, dA, A_size, cudaMemcpyDeviceToHost))
   CHECK_CUDA(cudaMemcpy(hC, dC, C_size, cudaMemcpyDeviceToHost))
 
-  bool A_std_layout = (is_rowmajor != isA_transposed);
-  bool B_std_layout = (is_rowmajor != isB_transposed);
   // host computation
-  float hC_result[m * n];
-  for (int i = 0; i < m; i++) {
-    for (int j = 0; j < n; j++) {
-      float sum = 0.0f;
-      for (int k1 = 0; k1 < k; k1++) {
-        auto posA = (A_std_layout) ? i * lda + k1 : i + k1 * lda;
-        auto posB = (B_std_layout) ? k1 * ldb + j : k1 + j * ldb;
-        sum += static_cast<float>(hA[posA]) * // [i][k]
-               static_cast<float>(hB[posB]);  // [k][j]
-      }
-      auto posC = (is_rowmajor) ? i * ldc + j : i + j * ldc;
-      hC_result[posC] = sum; // [i][j]
-    }
-  }
+  auto host_order = HostMatmul::get_order(order);
+  auto descA = HostMatmul::make_desc(hA, type, order, opA, lda);
+  auto descB = HostMatmul::make_desc(hB, type, order, opB, ldb);
+  std::vector<float> hC_result =
+      HostMatmul::matmul(m, n, k, descA, descB, host_order, ldc);
   // host-device comparison
-  int correct = 1;
-  for (int i = 0; i < m; i++) {
-    for (int j = 0; j < n; j++) {
-      auto pos = (is_rowmajor) ? i * ldc + j : i + j * ldc;
-      auto device_value = static_cast<float>(hC[pos]);
-      auto host_value = hC_result[pos];
-      if (device_value != host_value) {
-        // direct floating point comparison is not reliable
-        std::printf("(%d, %d):\t%f vs. %f\n", i, j, host_value, device_value);
-        correct = 0;
-        break;
-      }
-    }
+  auto output_type = HostMatmul::get_element_type(type);
+  auto comparison = HostMatmul::compare(
+      m, n, hC, output_type, hC_result.data(), host_order, ldc, 0, 1,
+      HostMatmul::get_default_tolerance(output_type));
+  int correct = (comparison.num_mismatches == 0);
+  if (!correct) {
+    std::printf("(%d, %d):\t%f vs. %f\n",
+                static_cast<int>(comparison.first_row),
+                static_cast<int>(comparison.first_col),
+                comparison.first_expected, comparison.first_actual);
   }
   if (correct)
     std::printf("matmul_example test PASSED\n");
@@ -38,6 +38,7 @@
 #include <cuda_runtime.h>
 #include <cuda_fp16.h>
 #include "cutensor.h"
+#include "python/einsum_path.h"
 
 #define HANDLE_ERROR(x) { const auto err = x;\
     if (err == CUTENSOR_STATUS_NOT_SUPPORTED) { return false; }\
@@ -87,8 +88,23 @@ struct Einsum
         const auto dots = equation.find("...");
         const bool isBroadcast = (dots != std::string::npos);
         const bool isImplicit = (arrow_pos == std::string::npos);
-        if (isBroadcast) // TODO
+        if (isBroadcast)
         {
+            // expand the ellipsis into explicit modes; broadcast dimensions of extent 1 are dropped
+            std::vector<std::vector<int64_t>> shapes = {std::vector<int64_t>(A_shape.begin(), A_shape.end())};
+            if (comma_pos != std::string::npos)
+            {
+                shapes.emplace_back(B_shape.begin(), B_shape.end());
+            }
+            EinsumEquation parsed;
+            if (!ParseEinsumEquation(equation, shapes, parsed))
+            {
+                return;
+            }
+            const std::vector<IntType> A(parsed.shapes[0].begin(), parsed.shapes[0].end());
+            const std::vector<IntType> B = (shapes.size() == 2) ?
+                std::vector<IntType>(parsed.shapes[1].begin(), parsed.shapes[1].end()) : std::vector<IntType>();
+            *this = Einsum(parsed.str(), A, B);
             return;
         }
         const bool usesB = (comma_pos != std::string::npos);
@@ -413,6 +429,88 @@ void einsum(cutensorHandle_t *handle,
     }
 }
 
+/**
+ * Contracts any number of operands pairwise, in the order chosen by ComputeEinsumPath
+ */
+void einsumNetwork(cutensorHandle_t *handle,
+                   const std::vector<std::vector<int>> &shapes,
+                   const std::string &subscripts)
+{
+    constexpr int kMaxNumModes_ = 40; // maximal number of modes supported by cuTENSOR
+    typedef float Compute;
+
+    std::vector<std::vector<int64_t>> inputShapes;
+    for (const auto &shape : shapes) {
+        inputShapes.emplace_back(shape.begin(), shape.end());
+    }
+    EinsumPath path;
+    if (!ComputeEinsumPath(subscripts, inputShapes, EinsumPathOptions(), path)) {
+        printf("%s: not supported\n", subscripts.c_str());
+        return;
+    }
+
+    struct Operand
+    {
+        void* raw;
+        std::vector<int> shape;
+    };
+    auto allocate = [](const std::vector<int64_t> &shape) {
+        Operand operand;
+        operand.shape.assign(shape.begin(), shape.end());
+        size_t totalElements = 1;
+        for (const auto e : shape) {
+            totalElements *= e;
+        }
+        HANDLE_CUDA_ERROR(cudaMalloc(&operand.raw, sizeof(Compute) * totalElements));
+        return operand;
+    };
+    std::vector<Operand> operands;
+    for (const auto &shape : path.equation.shapes) {
+        operands.push_back(allocate(shape));
+    }
+
+    void* workspace_raw = nullptr;
+    size_t worksize = 0;
+
+    // each step consumes its operands and appends its result
+    bool ret = true;
+    for (size_t i = 0; i < path.steps.size() && ret; ++i) {
+        const auto &step = path.steps[i];
+        const Operand A = operands[step.operands[0]];
+        const Operand B = (step.operands.size() == 2) ? operands[step.operands[1]] : Operand{nullptr, {}};
+        Einsum<Compute, int, kMaxNumModes_> myEinsum(step.equation, A.shape, B.shape);
+        Operand C = allocate(step.shape);
+        if (myEinsum.getWorksize() > worksize) {
+            cudaFree(workspace_raw);
+            worksize = myEinsum.getWorksize();
+            HANDLE_CUDA_ERROR(cudaMalloc(&workspace_raw, worksize));
+        }
+        ret = myEinsum.isInitialized() &&
+              myEinsum.execute(handle, A.raw, B.raw, C.raw, workspace_raw, 0);
+        printf("  step %zu: %s, %.3e flops\n", i, step.equation.c_str(), step.flops);
+
+        std::vector<int> consumed = step.operands;
+        std::sort(consumed.rbegin(), consumed.rend());
+        for (const auto j : consumed) {
+            cudaFree(operands[j].raw);
+            operands.erase(operands.begin() + j);
+        }
+        operands.push_back(C);
+    }
+
+    for (const auto &operand : operands) {
+        cudaFree(operand.raw);
+    }
+    cudaFree(workspace_raw);
+
+    if (!ret) {
+        printf("%s: not supported\n", subscripts.c_str());
+    }else{
+        printf("%s: succeeded (%.3e flops, %.3e elements of intermediates)\n",
+               subscripts.c_str(), path.flops, path.peakElements);
+    }
+}
+
 int main()
 {
     cutensorHandle_t handle;
@@ -431,6 +529,11 @@ int main()
     einsum(&handle, {2, 4, 5}, {}, "nij");  // permutation (implicit)
     einsum(&handle, {2, 4, 5}, {}, "nij->ijn");  // permutation (same as previous example, but explicit)
     einsum(&handle, {2, 4, 5}, {}, "nij->ji"); // reduction
+    einsum(&handle, {3, 2, 4, 5}, {5, 6}, "...ij,jk->...ik"); // batched contraction (broadcast)
+    einsumNetwork(&handle, {{8, 64}, {64, 64, 2}, {64, 64, 2}, {64, 64, 2}, {64, 8}},
+                  "ab,bcx,cdy,dez,ef->afxyz"); // tensor network (chain)
+    einsumNetwork(&handle, {{32, 7, 16}, {16, 16}, {16, 32}},
+                  "...ij,jk,k...->...i"); // tensor network (broadcast)
 
     // Detach cache and free-up resources
     HANDLE_ERROR( cutensorHandleDetachPlanCachelines(&handle) );
@@ -92,14 +92,21 @@ class EinsumCuTensorOp : public OpKernel {
     OP_REQUIRES_OK(context, context->allocate_output(0, output_shape,
                                                      &output_tensor));
 
-    size_t worksize = myEinsum.getWorksize();
+    EinsumPlan plan;
+    OP_REQUIRES(context, myEinsum.getPlan(GetCuTensorHandle(),
+                                          input_0_tensor.flat<T>().data(),
+                                          input_1_tensor.flat<T>().data(),
+                                          output_tensor->flat<T>().data(),
+                                          plan),
+                errors::Internal("cutensor: Planning failed."));
     Tensor work_tensor;
-    int64 work_tensor_size = worksize / sizeof(float);
+    int64 work_tensor_size = (plan.worksize + sizeof(float) - 1) / sizeof(float);
     TensorShape work_shape = { work_tensor_size };
     OP_REQUIRES_OK(context, context->allocate_temp(DT_FLOAT, work_shape, &work_tensor));
 
     auto device = context->eigen_device<Device>();
     auto ret = myEinsum.execute(GetCuTensorHandle(),
+                                plan,
                                 input_0_tensor.flat<T>().data(),
                                 input_1_tensor.flat<T>().data(),
                                 output_tensor->flat<T>().data(),
@@ -30,3 +30,4 @@
 #
 
 from .einsum import einsum, EinsumFunction, EinsumGeneral, Einsum
+from .einsum import plan_cache_info, plan_cache_clear, plan_cache_set_capacity
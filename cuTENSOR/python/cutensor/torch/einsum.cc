@@ -83,11 +83,19 @@ torch::Tensor einsum(
 
     output_tensor = torch::empty(myEinsum.getOutputShape(), input_0.options());
 
-    size_t worksize = myEinsum.getWorksize();
-    at::Tensor workspace = at::empty({static_cast<int>(worksize)}, at::CUDA(at::kByte));
+    EinsumPlan plan;
+    if (!myEinsum.getPlan(GetCuTensorHandle(),
+                          input_0.data_ptr<scalar_t>(),
+                          input_1.data_ptr<scalar_t>(),
+                          output_tensor.data_ptr<scalar_t>(),
+                          plan)) {
+      throw std::runtime_error("cutensor: Planning failed.");
+    }
+    at::Tensor workspace = at::empty({static_cast<int64_t>(plan.worksize)}, at::CUDA(at::kByte));
 
     auto stream = at::cuda::getCurrentCUDAStream().stream();
     auto ret = myEinsum.execute(GetCuTensorHandle(),
+                                plan,
                                 input_0.data_ptr<scalar_t>(),
                                 input_1.data_ptr<scalar_t>(),
                                 output_tensor.data_ptr<scalar_t>(),
@@ -99,6 +107,67 @@ torch::Tensor einsum(
   return output_tensor;
 }
 
+/**
+ * Contraction path of subscripts for operands of the given shapes: returns the
+ * operand shapes without broadcast dimensions of extent 1, the steps as
+ * (operand indices, equation) pairs, the output shape, the flops and the peak
+ * elements of live intermediates
+ */
+py::tuple einsum_path(
+    std::string subscripts,
+    std::vector<std::vector<int64_t>> shapes,
+    std::string algorithm = "auto",
+    double workspace_limit = 0
+) {
+  EinsumPathOptions options;
+  if (algorithm == "greedy") {
+    options.algorithm = EinsumPathAlgorithm::kGreedy;
+  } else if (algorithm == "optimal") {
+    options.algorithm = EinsumPathAlgorithm::kOptimal;
+  } else if (algorithm != "auto") {
+    throw std::runtime_error("cutensor: Unknown path algorithm " + algorithm);
+  }
+  options.workspaceLimit = workspace_limit;
+
+  EinsumPath path;
+  if (!ComputeEinsumPath(subscripts, shapes, options, path)) {
+    throw std::runtime_error("cutensor: No contraction path for " + subscripts);
+  }
+  py::list steps;
+  for (const auto &step : path.steps) {
+    for (const char c : step.equation) {
+      if (static_cast<unsigned char>(c) >= 128) {
+        throw std::runtime_error("cutensor: Too many modes in " + subscripts);
+      }
+    }
+    steps.append(py::make_tuple(step.operands, step.equation));
+  }
+  return py::make_tuple(path.equation.shapes, steps, path.equation.outputShape,
+                        path.flops, path.peakElements);
+}
+
+/**
+ * Counters of the Einsum plan cache
+ */
+py::dict plan_cache_info() {
+  const auto stats = GetEinsumPlanCache().stats();
+  py::dict info;
+  info["hits"] = stats.hits;
+  info["misses"] = stats.misses;
+  info["evictions"] = stats.evictions;
+  info["entries"] = stats.entries;
+  info["bytes"] = stats.bytes;
+  info["capacity"] = stats.capacity;
+  return info;
+}
+
 PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
   m.def("einsum", &einsum, "Einsum");
+  m.def("einsum_path", &einsum_path, "Einsum contraction path",
+        py::arg("subscripts"), py::arg("shapes"),
+        py::arg("algorithm") = "auto", py::arg("workspace_limit") = 0.0);
+  m.def("plan_cache_info", &plan_cache_info, "Einsum plan cache counters");
+  m.def("plan_cache_clear", [] { GetEinsumPlanCache().clear(); }, "Clears the Einsum plan cache");
+  m.def("plan_cache_set_capacity", [](size_t bytes) { GetEinsumPlanCache().setCapacity(bytes); },
+        "Bounds the Einsum plan cache in bytes", py::arg("bytes"));
 }
@@ -31,8 +31,7 @@
 
 import torch
 import torch.autograd
-import numpy as np
-from .binding import einsum
+from .binding import einsum, einsum_path, plan_cache_info, plan_cache_clear, plan_cache_set_capacity
 from ..common import normalize_subscript
 
 class EinsumFunction(torch.autograd.Function):
@@ -54,6 +53,7 @@ class EinsumFunction(torch.autograd.Function):
 
         ctx.equation = equation
         ctx.isBinary = isBinary
+        ctx.shape = input_0.shape
 
         return output
 
@@ -72,10 +72,17 @@ class EinsumFunction(torch.autograd.Function):
             d_input_1 = einsum(modeA + ',' + modeC + '->' + modeB, input_0,
                                grad_output, conjugate, False)
             return None, d_input_0, d_input_1
-        else:
+        elif len(modeC) == len(lhs):
             dummy = grad_output.new_empty((1,))
             d_input = einsum(modeC + '->' + lhs, grad_output, dummy, False, False)
             return None, d_input
+        else:
+            # reduction: broadcast the gradient over the summed modes
+            kept = [m for m in lhs if m in modeC]
+            shape = [e if m in modeC else 1 for m, e in zip(lhs, ctx.shape)]
+            d_input = grad_output.permute([modeC.index(m) for m in kept])
+            d_input = d_input.reshape(shape).expand(ctx.shape)
+            return None, d_input
 
 
 class Einsum(torch.nn.Module):
@@ -92,50 +99,27 @@ class Einsum(torch.nn.Module):
         return EinsumFunction.apply(self.equation, input_0, input_1)
 
 
-def _compute_target_tensor(in0, in1, target, eqs):
-    remaining = target + ''.join(eqs)
-    result = ""
-    for m in in0[:-1] + in1[:-1] + in1[-1] + in0[-1]:
-        if m in remaining and m not in result:
-            result += m
-    # reorder target modes like target
-    result = list(result)
-    for i in range(len(result)):
-        if result[i] not in target: continue
-        for j in range(i):
-            if result[j] not in target: continue
-            if target.index(result[j]) > target.index(result[i]):
-                result[i], result[j] = result[j], result[i]
-    return ''.join(result)
-
-
 def EinsumGeneral(equation, *tensors, **kwargs):
-    tensors = list(tensors)
-    equation, isBinary = normalize_subscript(equation)
-    path = np.einsum_path(equation,
-                          *[np.broadcast_to(np.nan, t.shape) for t in tensors],
-                          **kwargs)
-    path = path[0][1:]
-    equation = equation.split('->')
-    eqs = equation[0].split(',')
-    target = equation[1]
-    for step in path:
-        if len(step) == 1:
-            result = EinsumFunction.apply(eqs[0] + '->' + target, tensors[0])
-            continue
-        assert step[0] < step[1]
-        in0 = tensors[step[0]]
-        in1 = tensors[step[1]]
-        tensors.pop(step[1])
-        tensors.pop(step[0])
-        eq0 = eqs[step[0]]
-        eq1 = eqs[step[1]]
-        eqs.pop(step[1])
-        eqs.pop(step[0])
-        tgt = _compute_target_tensor(eq0, eq1, target, eqs)
-        assert tgt != ""
-        eq = eq0 + ',' + eq1 + '->' + tgt
-        eqs.append(tgt)
-        result = EinsumFunction.apply(eq, in0, in1)
-        tensors.append(result)
-    return result
+    """
+    Einsum of any number of tensors, computed as a sequence of unary and
+    binary einsums in the order that minimises flops and then the memory of
+    intermediates; supports ellipsis broadcast.
+
+    kwargs: optimize ('auto', 'greedy' or 'optimal') selects the path search,
+    any other value raises ValueError; memory_limit caps the elements of all
+    live intermediates.
+    """
+    optimize = kwargs.get('optimize', 'auto')
+    if optimize not in ('auto', 'greedy', 'optimal'):
+        raise ValueError(
+            "cutensor: Unknown path algorithm {!r}".format(optimize))
+    shapes, steps, output_shape, _, _ = einsum_path(
+        equation, [list(t.shape) for t in tensors], optimize,
+        float(kwargs.get('memory_limit', 0)))
+    tensors = [t.reshape(shape) for t, shape in zip(tensors, shapes)]
+    for operands, eq in steps:
+        inputs = [tensors[i] for i in operands]
+        for i in sorted(operands, reverse=True):
+            tensors.pop(i)
+        tensors.append(EinsumFunction.apply(eq, *inputs))
+    return tensors[0].reshape(output_shape)
@@ -203,6 +203,24 @@ class EinsumTest(unittest.TestCase):
                 equation="ij->ji",
                 dtype=torch.float32,
             ),
+            param(
+                "test 5",
+                sizes=[(8, 30), (30, 30, 2), (30, 30, 2), (30, 30, 2), (30, 30, 2), (30, 8)],
+                equation="ab,bcu,cdv,dew,efx,fg->agx",
+                dtype=torch.float32,
+            ),
+            param(
+                "test 6",
+                sizes=[(4, 3, 20, 30), (30, 10), (1, 3, 10, 5)],
+                equation="...ij,jk,...kl->...il",
+                dtype=torch.float32,
+            ),
+            param(
+                "test 7",
+                sizes=[(6, 20, 30), (30, 10), (10, 6)],
+                equation="bij,jk,kb",
+                dtype=torch.complex64,
+            ),
         ]
         # yapf: enable
     )
@@ -242,6 +260,14 @@ class EinsumTest(unittest.TestCase):
         for ct, tt in zip(cutensor_grads, torch_grads):
             torch.testing.assert_allclose(ct, tt, rtol=5e-3, atol=5e-3)
 
+    def test_einsum_general_unknown_optimize(self):
+        tensors = [
+            torch.randn(4, 5, device=torch.device("cuda")),
+            torch.randn(5, 6, device=torch.device("cuda")),
+        ]
+        with self.assertRaises(ValueError):
+            cutensor.EinsumGeneral("ij,jk->ik", *tensors, optimize='fastest')
+
 
 if __name__ == '__main__':
     unittest.main()
@@ -30,7 +30,11 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
 #include <functional>
+#include <list>
+#include <map>
+#include <mutex>
 #include <vector>
 #include <array>
 
@@ -38,6 +42,7 @@
 #include <cuda_fp16.h>
 #include <cuComplex.h>
 #include "cutensor.h"
+#include "einsum_path.h"
 
 #define HANDLE_ERROR(x) { const auto err = x;\
     if (err == CUTENSOR_STATUS_NOT_SUPPORTED) { return false; }\
@@ -81,6 +86,135 @@ struct CuTensorTypeTraits<__half> {
   typedef float ScalarType;
 };
 
+/**
+ * cuTENSOR objects built for one Einsum call
+ */
+struct EinsumPlan
+{
+    cutensorTensorDescriptor_t descA;
+    cutensorTensorDescriptor_t descB;
+    cutensorTensorDescriptor_t descC;
+    cutensorContractionPlan_t plan; // contractions only
+    uint64_t worksize;
+};
+
+/**
+ * Thread-safe LRU cache of EinsumPlans, bounded by the bytes of its entries
+ */
+class EinsumPlanCache
+{
+    public:
+    typedef std::vector<int64_t> Key;
+
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t entries;
+        size_t bytes;
+        size_t capacity;
+    };
+
+    explicit EinsumPlanCache(size_t capacity) : capacity_(capacity) {}
+
+    /**
+     * Copies the plan of key into plan and marks it as most recently used
+     */
+    bool find(const Key &key, EinsumPlan &plan)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto it = index_.find(key);
+        if (it == index_.end())
+        {
+            misses_++;
+            return false;
+        }
+        entries_.splice(entries_.begin(), entries_, it->second);
+        plan = it->second->second;
+        hits_++;
+        return true;
+    }
+
+    /**
+     * Inserts plan, evicting the least recently used entries beyond the capacity
+     */
+    void insert(const Key &key, const EinsumPlan &plan)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (index_.count(key) > 0 || entryBytes(key) > capacity_)
+        {
+            return;
+        }
+        entries_.emplace_front(key, plan);
+        index_[key] = entries_.begin();
+        bytes_ += entryBytes(key);
+        shrink();
+    }
+
+    void setCapacity(size_t capacity)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = capacity;
+        shrink();
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        index_.clear();
+        bytes_ = 0;
+        hits_ = misses_ = evictions_ = 0;
+    }
+
+    Stats stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return {hits_, misses_, evictions_, index_.size(), bytes_, capacity_};
+    }
+
+    private:
+    typedef std::list<std::pair<Key, EinsumPlan>> Entries;
+
+    // the key is held by both the list and the index
+    static size_t entryBytes(const Key &key)
+    {
+        return sizeof(EinsumPlan) + 2 * key.size() * sizeof(int64_t) + 128;
+    }
+
+    void shrink()
+    {
+        while (bytes_ > capacity_)
+        {
+            const Key &key = entries_.back().first;
+            bytes_ -= entryBytes(key);
+            index_.erase(key);
+            entries_.pop_back();
+            evictions_++;
+        }
+    }
+
+    mutable std::mutex mutex_;
+    Entries entries_;
+    std::map<Key, Entries::iterator> index_;
+    size_t capacity_;
+    size_t bytes_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t evictions_ = 0;
+};
+
+/**
+ * Process-wide plan cache of Einsum, 16 MiB unless CUTENSOR_PLAN_CACHE_BYTES
+ * says otherwise (0 disables caching)
+ */
+inline EinsumPlanCache& GetEinsumPlanCache() {
+  static EinsumPlanCache cache(getenv("CUTENSOR_PLAN_CACHE_BYTES") ?
+                               strtoull(getenv("CUTENSOR_PLAN_CACHE_BYTES"), nullptr, 10) : 16ULL << 20);
+  return cache;
+}
+
 template<typename ComputeType,
          typename IntType, int kMaxNumModes_>
 struct Einsum
@@ -105,8 +239,23 @@ struct Einsum
         const auto dots = equation.find("...");
         const bool isBroadcast = (dots != std::string::npos);
         const bool isImplicit = (arrow_pos == std::string::npos);
-        if (isBroadcast) // TODO
+        if (isBroadcast)
         {
+            // expand the ellipsis into explicit modes; broadcast dimensions of extent 1 are dropped
+            std::vector<std::vector<int64_t>> shapes = {std::vector<int64_t>(A_shape.begin(), A_shape.end())};
+            if (comma_pos != std::string::npos)
+            {
+                shapes.emplace_back(B_shape.begin(), B_shape.end());
+            }
+            EinsumEquation parsed;
+            if (!ParseEinsumEquation(equation, shapes, parsed))
+            {
+                return;
+            }
+            const std::vector<IntType> A(parsed.shapes[0].begin(), parsed.shapes[0].end());
+            const std::vector<IntType> B = (shapes.size() == 2) ?
+                std::vector<IntType>(parsed.shapes[1].begin(), parsed.shapes[1].end()) : std::vector<IntType>();
+            *this = Einsum(parsed.str(), A, B, opA, opB);
             return;
         }
         const bool usesB = (comma_pos != std::string::npos);
@@ -258,8 +407,6 @@ struct Einsum
         isInitialized_ = true;
     }
 
-    size_t getWorksize() const { return kWorksize_; }
-
     std::vector<IntType> getOutputShape() const
     {
         if (!isInitialized_) return {};
@@ -273,36 +420,47 @@ struct Einsum
     }
 
     /**
-     * Computes the einsum call A,B->C
-     *
-     * \param[in] A_raw device pointer of A
-     * \param[in] B_raw device pointer of B
-     * \param[out] C_raw device pointer of C
-     * \param[out] wor_raw device pointer to the scratchpad memory
-     * Dispatch to contraction
+     * Looks up the plan of this einsum for these pointers in GetEinsumPlanCache,
+     * building and inserting it on a miss. The plan holds the workspace size in
+     * bytes that execute needs; pass it to execute so that each call looks the
+     * plan up only once.
      */
-    bool execute(const cutensorHandle_t *handle,
+    bool getPlan(const cutensorHandle_t *handle,
                  const void* A_raw,
                  const void* B_raw,
-                 void* C_raw,
-                 void *work_raw, cudaStream_t stream) const
+                 const void* C_raw,
+                 EinsumPlan &plan) const
     {
         if (!isInitialized_) return false;
 
         cudaDataType_t cudaType = CuTensorTypeTraits<ComputeType>::cudaType;
         cutensorComputeType_t computeType = CuTensorTypeTraits<ComputeType>::cutensorType;
 
-        cutensorTensorDescriptor_t descA;
+        EinsumPlanCache::Key key = {reinterpret_cast<intptr_t>(handle), cudaType, computeType, opA_, opB_,
+                                    getAlignment(A_raw), getAlignment(C_raw), numModesA_, numModesB_, numModesC_};
+        if (numModesB_ > 0)
+        {
+            key.push_back(getAlignment(B_raw));
+        }
+        key.insert(key.end(), modesA_.begin(), modesA_.begin() + numModesA_);
+        key.insert(key.end(), extentA_.begin(), extentA_.begin() + numModesA_);
+        key.insert(key.end(), modesB_.begin(), modesB_.begin() + numModesB_);
+        key.insert(key.end(), extentB_.begin(), extentB_.begin() + numModesB_);
+        key.insert(key.end(), modesC_.begin(), modesC_.begin() + numModesC_);
+        key.insert(key.end(), extentC_.begin(), extentC_.begin() + numModesC_);
+
+        EinsumPlanCache &cache = GetEinsumPlanCache();
+        if (cache.find(key, plan)) return true;
+
         HANDLE_ERROR(cutensorInitTensorDescriptor(handle,
-                    &descA,
+                    &plan.descA,
                     numModesA_,
                     extentA_.data(),
                     NULL /* = stride */,
                     cudaType, opA_));
 
-        cutensorTensorDescriptor_t descC;
         HANDLE_ERROR(cutensorInitTensorDescriptor(handle,
-                    &descC,
+                    &plan.descC,
                     numModesC_,
                     extentC_.data(),
                     NULL /* = stride*/,
@@ -310,34 +468,31 @@ struct Einsum
 
         uint32_t alignmentRequirementA;
         HANDLE_ERROR(cutensorGetAlignmentRequirement(handle,
-                    A_raw, &descA, &alignmentRequirementA));
+                    A_raw, &plan.descA, &alignmentRequirementA));
 
         uint32_t alignmentRequirementC;
         HANDLE_ERROR(cutensorGetAlignmentRequirement(handle,
-                    C_raw, &descC, &alignmentRequirementC));
-
+                    C_raw, &plan.descC, &alignmentRequirementC));
 
-        cutensorTensorDescriptor_t descB;
-        uint32_t alignmentRequirementB;
         if (numModesB_ > 0)
         {
-            // dispatch to contraction
             HANDLE_ERROR(cutensorInitTensorDescriptor(handle,
-                        &descB,
+                        &plan.descB,
                         numModesB_,
                         extentB_.data(),
                         NULL /* = stride*/,
                         cudaType, opB_));
 
+            uint32_t alignmentRequirementB;
             HANDLE_ERROR(cutensorGetAlignmentRequirement(handle,
-                        B_raw, &descB, &alignmentRequirementB));
+                        B_raw, &plan.descB, &alignmentRequirementB));
 
             cutensorContractionDescriptor_t desc;
             HANDLE_ERROR(cutensorInitContractionDescriptor(handle, &desc,
-                        &descA, modesA_.data(), alignmentRequirementA,
-                        &descB, modesB_.data(), alignmentRequirementB,
-                        &descC, modesC_.data(), alignmentRequirementC,
-                        &descC, modesC_.data(), alignmentRequirementC,
+                        &plan.descA, modesA_.data(), alignmentRequirementA,
+                        &plan.descB, modesB_.data(), alignmentRequirementB,
+                        &plan.descC, modesC_.data(), alignmentRequirementC,
+                        &plan.descC, modesC_.data(), alignmentRequirementC,
                         computeType));
 
             cutensorAlgo_t algo = CUTENSOR_ALGO_DEFAULT;
@@ -346,28 +501,64 @@ struct Einsum
                         handle, &find, 
                         algo));
 
-            cutensorContractionPlan_t plan;
+            HANDLE_ERROR(cutensorContractionGetWorkspaceSize(handle,
+                        &desc, &find,
+                        CUTENSOR_WORKSPACE_RECOMMENDED, &plan.worksize));
+
             HANDLE_ERROR(cutensorInitContractionPlan(handle,
-                        &plan, &desc, &find, kWorksize_));
+                        &plan.plan, &desc, &find, plan.worksize));
+        }
+        else
+        {
+            HANDLE_ERROR(cutensorReductionGetWorkspaceSize(handle,
+                        A_raw, &plan.descA, modesA_.data(),
+                        C_raw, &plan.descC, modesC_.data(),
+                        C_raw, &plan.descC, modesC_.data(),
+                        CUTENSOR_OP_ADD, computeType, &plan.worksize));
+        }
 
-            typename CuTensorTypeTraits<ComputeType>::ScalarType alpha = 1;
-            typename CuTensorTypeTraits<ComputeType>::ScalarType beta = 0;
+        cache.insert(key, plan);
+        return true;
+    }
+
+    /**
+     * Computes the einsum call A,B->C
+     *
+     * \param[in] plan result of getPlan for the same pointers
+     * \param[in] A_raw device pointer of A
+     * \param[in] B_raw device pointer of B
+     * \param[out] C_raw device pointer of C
+     * \param[out] wor_raw device pointer to the scratchpad memory of plan.worksize bytes
+     * Dispatch to contraction
+     */
+    bool execute(const cutensorHandle_t *handle,
+                 const EinsumPlan &plan,
+                 const void* A_raw,
+                 const void* B_raw,
+                 void* C_raw,
+                 void *work_raw, cudaStream_t stream) const
+    {
+        if (!isInitialized_) return false;
 
-            HANDLE_ERROR(cutensorContraction(handle, &plan,
+        cutensorComputeType_t computeType = CuTensorTypeTraits<ComputeType>::cutensorType;
+        typename CuTensorTypeTraits<ComputeType>::ScalarType alpha = 1;
+        typename CuTensorTypeTraits<ComputeType>::ScalarType beta = 0;
+        if (numModesB_ > 0)
+        {
+            // dispatch to contraction
+            HANDLE_ERROR(cutensorContraction(handle, &plan.plan,
                         (void*) &alpha, A_raw, B_raw,
                         (void*) &beta,  C_raw, C_raw,
-                        work_raw, kWorksize_, stream));
+                        work_raw, plan.worksize, stream));
         }
         else
         {
             // dispatch to reduction
-            typename CuTensorTypeTraits<ComputeType>::ScalarType alpha = 1;
-            typename CuTensorTypeTraits<ComputeType>::ScalarType beta = 0;
             HANDLE_ERROR(cutensorReduction(handle,
-                        (const void*)&alpha, A_raw, &descA, modesA_.data(),
-                        (const void*)&beta,  A_raw, &descC, modesC_.data(), // beta == 0 => will not be used
-                        C_raw, &descC, modesC_.data(),
-                        CUTENSOR_OP_ADD, computeType, work_raw, kWorksize_, stream));
+                        (const void*)&alpha, A_raw, &plan.descA, modesA_.data(),
+                        (const void*)&beta,  A_raw, &plan.descC, modesC_.data(), // beta == 0 => will not be used
+                        C_raw, &plan.descC, modesC_.data(),
+                        CUTENSOR_OP_ADD, computeType, work_raw, plan.worksize, stream));
         }
         return true;
     }
@@ -375,7 +566,13 @@ struct Einsum
     bool isInitialized() const { return isInitialized_; }
 
     private:
-    static const size_t kWorksize_ = 1024ULL * 1024ULL * 8ULL * 128ULL;
+    // largest alignment in bytes of ptr that cuTENSOR distinguishes
+    static int64_t getAlignment(const void* ptr)
+    {
+        const uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+        return (address == 0) ? 256 : std::min<uintptr_t>(address & (~address + 1), 256);
+    }
+
     uint32_t numModesA_;
     uint32_t numModesB_;
     uint32_t numModesC_;
@@ -0,0 +1,662 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION & AFFILIATES.  All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *  - Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  - Neither the name(s) of the copyright holder(s) nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+/**
+ * Host-only einsum equation parsing and contraction path search.
+ *
+ * ParseEinsumEquation resolves an equation with any number of operands,
+ * implicit output and ellipsis broadcast into explicit modes: ellipsis
+ * dimensions get mode labels unused by the equation, and broadcast
+ * dimensions of extent 1 are dropped from the operands that have them,
+ * which leaves their data layout unchanged.
+ *
+ * ComputeEinsumPath turns such an equation into a sequence of one- and
+ * two-operand einsums that Einsum can execute. Modes that only one operand
+ * carries are summed out of it first. Pairs are then chosen greedily, or
+ * by branch and bound for small operand counts, to minimise flops and then
+ * peak intermediate memory, with an optional cap on that memory.
+ */
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+struct EinsumEquation
+{
+    std::vector<std::string> inputs;
+    std::string output;
+    std::vector<std::vector<int64_t>> shapes; // one per input, without dropped broadcast dimensions
+    std::vector<int64_t> outputShape;
+
+    std::string str() const
+    {
+        std::string equation;
+        for (size_t i = 0; i < inputs.size(); ++i)
+        {
+            equation += (i > 0 ? "," : "") + inputs[i];
+        }
+        return equation + "->" + output;
+    }
+};
+
+/**
+ * Parses equation for operands of the given shapes; returns false if the
+ * equation is malformed, does not match the shapes or repeats a mode within
+ * one operand
+ */
+inline bool ParseEinsumEquation(const std::string &equation,
+                                const std::vector<std::vector<int64_t>> &shapes,
+                                EinsumEquation &parsed)
+{
+    std::string compact;
+    for (const char c : equation)
+    {
+        if (c != ' ') compact += c;
+    }
+    const auto arrow_pos = compact.find("->");
+    const bool isImplicit = (arrow_pos == std::string::npos);
+    const std::string lhs = isImplicit ? compact : compact.substr(0, arrow_pos);
+    const std::string rhs = isImplicit ? "" : compact.substr(arrow_pos + 2);
+
+    std::vector<std::string> terms(1);
+    for (const char c : lhs)
+    {
+        if (c == ',') terms.emplace_back();
+        else terms.back() += c;
+    }
+    if (terms.size() != shapes.size())
+    {
+        return false;
+    }
+
+    // Labels and ellipsis position of every term, and the largest ellipsis rank
+    auto isLabel = [](char c) { return c != '.' && c != ',' && c != '-' && c != '>'; };
+    std::bitset<256> used;
+    for (const char c : compact)
+    {
+        used[(unsigned char) c] = true;
+    }
+    std::vector<std::string> labels(terms.size());
+    std::vector<size_t> ellipsisPos(terms.size(), std::string::npos);
+    size_t ellipsisRank = 0;
+    for (size_t t = 0; t < terms.size(); ++t)
+    {
+        const auto dots = terms[t].find("...");
+        std::string term = terms[t];
+        if (dots != std::string::npos)
+        {
+            term.erase(dots, 3);
+            ellipsisPos[t] = dots;
+        }
+        if (!std::all_of(term.begin(), term.end(), isLabel))
+        {
+            return false;
+        }
+        if (term.size() > shapes[t].size() || (dots == std::string::npos && term.size() != shapes[t].size()))
+        {
+            return false;
+        }
+        labels[t] = term;
+        ellipsisRank = std::max(ellipsisRank, shapes[t].size() - term.size());
+    }
+
+    // Unused labels for the ellipsis dimensions, right-aligned across operands
+    std::string ellipsisModes;
+    const std::string pool = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    for (size_t i = 0; i < pool.size() && ellipsisModes.size() < ellipsisRank; ++i)
+    {
+        if (!used[(unsigned char) pool[i]]) ellipsisModes += pool[i];
+    }
+    for (int c = 128; c < 256 && ellipsisModes.size() < ellipsisRank; ++c)
+    {
+        if (!used[c]) ellipsisModes += (char) c;
+    }
+    if (ellipsisModes.size() < ellipsisRank)
+    {
+        return false;
+    }
+    std::bitset<256> isEllipsisMode;
+    for (const char c : ellipsisModes)
+    {
+        isEllipsisMode[(unsigned char) c] = true;
+    }
+
+    std::vector<std::string> modes(terms.size());
+    for (size_t t = 0; t < terms.size(); ++t)
+    {
+        modes[t] = labels[t];
+        if (ellipsisPos[t] != std::string::npos)
+        {
+            const size_t rank = shapes[t].size() - labels[t].size();
+            modes[t].insert(ellipsisPos[t], ellipsisModes.substr(ellipsisRank - rank));
+        }
+        for (size_t i = 0; i < modes[t].size(); ++i)
+        {
+            if (modes[t].find(modes[t][i], i + 1) != std::string::npos)
+            {
+                return false; // traces are not supported
+            }
+        }
+    }
+
+    std::string output;
+    if (isImplicit)
+    {
+        output = ellipsisModes;
+        std::string once;
+        for (const auto &term : labels)
+        {
+            for (const char c : term)
+            {
+                if (std::count(lhs.begin(), lhs.end(), c) == 1) once += c;
+            }
+        }
+        std::sort(once.begin(), once.end());
+        output += once;
+    }
+    else
+    {
+        output = rhs;
+        const auto dots = output.find("...");
+        if (dots != std::string::npos)
+        {
+            output.replace(dots, 3, ellipsisModes);
+        }
+        if (!std::all_of(output.begin(), output.end(), isLabel))
+        {
+            return false;
+        }
+    }
+
+    // Extents: labelled modes must agree, ellipsis modes broadcast from 1
+    std::vector<int64_t> extent(256, -1);
+    for (size_t t = 0; t < terms.size(); ++t)
+    {
+        for (size_t i = 0; i < modes[t].size(); ++i)
+        {
+            const unsigned char m = modes[t][i];
+            const int64_t e = shapes[t][i];
+            if (extent[m] < 0 || (isEllipsisMode[m] && extent[m] == 1))
+            {
+                extent[m] = e;
+            }
+            else if (e != extent[m] && !(isEllipsisMode[m] && e == 1))
+            {
+                return false;
+            }
+        }
+    }
+
+    parsed.inputs.assign(terms.size(), "");
+    parsed.shapes.assign(terms.size(), {});
+    for (size_t t = 0; t < terms.size(); ++t)
+    {
+        for (size_t i = 0; i < modes[t].size(); ++i)
+        {
+            const unsigned char m = modes[t][i];
+            if (shapes[t][i] == 1 && extent[m] != 1) continue; // broadcast
+            parsed.inputs[t] += modes[t][i];
+            parsed.shapes[t].push_back(shapes[t][i]);
+        }
+    }
+    parsed.output = output;
+    parsed.outputShape.clear();
+    for (size_t i = 0; i < output.size(); ++i)
+    {
+        const unsigned char m = output[i];
+        if (extent[m] < 0 || output.find(output[i], i + 1) != std::string::npos)
+        {
+            return false;
+        }
+        parsed.outputShape.push_back(extent[m]);
+    }
+    return true;
+}
+
+enum class EinsumPathAlgorithm
+{
+    kAuto,    // kOptimal up to maxOptimalOperands operands, kGreedy above
+    kGreedy,
+    kOptimal,
+};
+
+struct EinsumPathOptions
+{
+    EinsumPathAlgorithm algorithm = EinsumPathAlgorithm::kAuto;
+    double workspaceLimit = 0;  // cap on the elements of all live intermediates, 0 for none
+    int maxOptimalOperands = 8;
+};
+
+struct EinsumPathStep
+{
+    // One or two indices into the current operand list. These operands are
+    // removed and the result is appended, as in numpy.einsum_path.
+    std::vector<int> operands;
+    std::string equation;       // explicit, without ellipsis
+    std::vector<int64_t> shape; // of the result
+    double flops;
+};
+
+struct EinsumPath
+{
+    EinsumEquation equation;    // the steps use its modes and operand shapes
+    std::vector<EinsumPathStep> steps;
+    double flops = 0;
+    double peakElements = 0;    // largest total size of the live intermediates, output included
+};
+
+namespace einsum_path_detail
+{
+
+typedef std::bitset<256> ModeSet;
+
+struct Operand
+{
+    std::string modes;
+    ModeSet modeSet;
+    double size;
+    bool isIntermediate;
+    uint32_t inputs;            // bit mask of the original operands it holds
+};
+
+struct Search
+{
+    std::vector<int64_t> extent;
+    ModeSet outputModes;
+    std::string output;
+    double workspaceLimit;
+
+    // Result of contracting a and b while count[m] operands or the output still need mode m
+    Operand contract(const Operand &a, const Operand &b, const std::vector<int> &count, bool isLast,
+                     double &flops) const
+    {
+        Operand result;
+        result.isIntermediate = true;
+        result.inputs = a.inputs | b.inputs;
+        double all = 1;
+        const ModeSet both = a.modeSet | b.modeSet;
+        for (int m = 0; m < 256; ++m)
+        {
+            if (both[m]) all *= (double) extent[m];
+        }
+        flops = 2 * all;
+        if (isLast)
+        {
+            result.modes = output;
+        }
+        else
+        {
+            for (const std::string *modes : {&a.modes, &b.modes})
+            {
+                for (const char c : *modes)
+                {
+                    const unsigned char m = c;
+                    const int others = count[m] - a.modeSet[m] - b.modeSet[m];
+                    if (others > 0 && result.modes.find(c) == std::string::npos) result.modes += c;
+                }
+            }
+        }
+        result.size = 1;
+        for (const char c : result.modes)
+        {
+            result.modeSet[(unsigned char) c] = true;
+            result.size *= (double) extent[(unsigned char) c];
+        }
+        return result;
+    }
+
+    bool fits(double elements) const
+    {
+        return workspaceLimit <= 0 || elements <= workspaceLimit;
+    }
+};
+
+struct State
+{
+    std::vector<Operand> operands;
+    std::vector<int> count;     // operands plus output holding each mode
+    std::vector<EinsumPathStep> steps;
+    double flops = 0;
+    double live = 0;
+    double peak = 0;
+
+    void apply(const Search &search, int i, int j, const Operand &result, double stepFlops)
+    {
+        EinsumPathStep step;
+        step.operands = {i, j};
+        step.equation = operands[i].modes + "," + operands[j].modes + "->" + result.modes;
+        for (const char c : result.modes)
+        {
+            step.shape.push_back(search.extent[(unsigned char) c]);
+        }
+        step.flops = stepFlops;
+        steps.push_back(step);
+
+        flops += stepFlops;
+        peak = std::max(peak, live + result.size);
+        live += result.size;
+        for (const int k : {j, i})
+        {
+            live -= operands[k].isIntermediate ? operands[k].size : 0;
+            for (const char c : operands[k].modes) count[(unsigned char) c]--;
+            operands.erase(operands.begin() + k);
+        }
+        for (const char c : result.modes) count[(unsigned char) c]++;
+        operands.push_back(result);
+    }
+};
+
+// Lexicographic (flops, peak) order, with relative tolerance on flops
+inline bool IsBetter(double flops, double peak, double bestFlops, double bestPeak)
+{
+    const double tolerance = 1e-12 * std::max(flops, bestFlops);
+    if (flops < bestFlops - tolerance) return true;
+    if (flops > bestFlops + tolerance) return false;
+    return peak < bestPeak;
+}
+
+inline bool Shares(const Operand &a, const Operand &b)
+{
+    return (a.modeSet & b.modeSet).any();
+}
+
+inline bool Greedy(const Search &search, State &state)
+{
+    while (state.operands.size() > 1)
+    {
+        const int n = (int) state.operands.size();
+        int bestI = -1, bestJ = -1;
+        Operand best;
+        double bestFlops = 0;
+        bool bestShares = false;
+        double bestGain = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            for (int j = i + 1; j < n; ++j)
+            {
+                double flops;
+                const Operand result = search.contract(state.operands[i], state.operands[j], state.count, n == 2, flops);
+                if (!search.fits(state.live + result.size)) continue;
+                // Prefer pairs that share a mode over outer products, then the largest size reduction
+                const bool shares = Shares(state.operands[i], state.operands[j]);
+                const double gain = result.size - state.operands[i].size - state.operands[j].size;
+                if (bestI < 0 || (shares && !bestShares) ||
+                    (shares == bestShares && (gain < bestGain || (gain == bestGain && flops < bestFlops))))
+                {
+                    bestI = i; bestJ = j; best = result;
+                    bestFlops = flops; bestShares = shares; bestGain = gain;
+                }
+            }
+        }
+        if (bestI < 0)
+        {
+            return false; // nothing fits in the workspace
+        }
+        state.apply(search, bestI, bestJ, best, bestFlops);
+    }
+    return true;
+}
+
+class BranchAndBound
+{
+    public:
+    BranchAndBound(const Search &search, const State &bound, bool hasBound) :
+        search_(search), best_(bound), hasBest_(hasBound)
+    {
+    }
+
+    void run(State &state)
+    {
+        const int n = (int) state.operands.size();
+        if (n == 1)
+        {
+            if (!hasBest_ || IsBetter(state.flops, state.peak, best_.flops, best_.peak))
+            {
+                best_ = state;
+                hasBest_ = true;
+            }
+            return;
+        }
+        // Same partition of the inputs means same future, so a state is
+        // only worth expanding if no earlier visit was at least as cheap
+        std::vector<uint32_t> key;
+        for (const auto &operand : state.operands) key.push_back(operand.inputs);
+        std::sort(key.begin(), key.end());
+        const auto seen = seen_.find(key);
+        if (seen != seen_.end() && !IsBetter(state.flops, state.peak, seen->second.first, seen->second.second))
+        {
+            return;
+        }
+        seen_[key] = {state.flops, state.peak};
+
+        struct Candidate { int i, j; Operand result; double flops; };
+        std::vector<Candidate> candidates;
+        for (int i = 0; i < n; ++i)
+        {
+            for (int j = i + 1; j < n; ++j)
+            {
+                Candidate c;
+                c.i = i; c.j = j;
+                c.result = search_.contract(state.operands[i], state.operands[j], state.count, n == 2, c.flops);
+                if (!search_.fits(state.live + c.result.size)) continue;
+                if (hasBest_ && state.flops + c.flops > best_.flops * (1 + 1e-12)) continue;
+                candidates.push_back(c);
+            }
+        }
+        // Cheapest first, so that good bounds are found early
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+            return a.flops < b.flops;
+        });
+        for (const auto &c : candidates)
+        {
+            if (hasBest_ && state.flops + c.flops > best_.flops * (1 + 1e-12)) continue;
+            State next = state;
+            next.apply(search_, c.i, c.j, c.result, c.flops);
+            run(next);
+        }
+    }
+
+    bool found() const { return hasBest_; }
+    const State &best() const { return best_; }
+
+    private:
+    const Search &search_;
+    State best_;
+    bool hasBest_;
+    std::map<std::vector<uint32_t>, std::pair<double, double>> seen_;
+};
+
+} // namespace einsum_path_detail
+
+namespace einsum_path_detail
+{
+
+// Operands, mode counts and single-operand steps of parsed: modes that no
+// other operand nor the output needs are summed out, and a lone operand is
+// permuted into the output
+inline bool MakeInitialState(const EinsumEquation &parsed, double workspaceLimit, Search &search, State &state)
+{
+    const int numInputs = (int) parsed.inputs.size();
+    search.extent.assign(256, 1);
+    search.output = parsed.output;
+    search.workspaceLimit = workspaceLimit;
+    state = State();
+    state.count.assign(256, 0);
+    for (int t = 0; t < numInputs; ++t)
+    {
+        Operand operand;
+        operand.modes = parsed.inputs[t];
+        operand.size = 1;
+        operand.isIntermediate = false;
+        operand.inputs = 1u << t;
+        for (size_t i = 0; i < operand.modes.size(); ++i)
+        {
+            const unsigned char m = operand.modes[i];
+            search.extent[m] = parsed.shapes[t][i];
+            operand.modeSet[m] = true;
+            operand.size *= (double) parsed.shapes[t][i];
+            state.count[m]++;
+        }
+        state.operands.push_back(operand);
+    }
+    for (const char c : parsed.output)
+    {
+        search.outputModes[(unsigned char) c] = true;
+        state.count[(unsigned char) c]++;
+    }
+
+    for (int t = 0; t < numInputs; ++t)
+    {
+        Operand &operand = state.operands[t];
+        std::string kept;
+        for (const char c : operand.modes)
+        {
+            if (state.count[(unsigned char) c] > 1) kept += c;
+        }
+        if (numInputs == 1)
+        {
+            kept = parsed.output;
+        }
+        if (kept == operand.modes)
+        {
+            continue;
+        }
+        EinsumPathStep step;
+        step.operands = {t};
+        step.equation = operand.modes + "->" + kept;
+        step.flops = operand.size;
+        double size = 1;
+        for (const char c : kept)
+        {
+            step.shape.push_back(search.extent[(unsigned char) c]);
+            size *= (double) search.extent[(unsigned char) c];
+        }
+        if (!search.fits(state.live + size))
+        {
+            return false;
+        }
+        for (const char c : operand.modes)
+        {
+            state.count[(unsigned char) c]--;
+        }
+        operand.modes = kept;
+        operand.modeSet.reset();
+        for (const char c : kept)
+        {
+            operand.modeSet[(unsigned char) c] = true;
+            state.count[(unsigned char) c]++;
+        }
+        operand.size = size;
+        operand.isIntermediate = true;
+        state.flops += step.flops;
+        state.live += size;
+        state.peak = std::max(state.peak, state.live);
+        state.steps.push_back(step);
+    }
+
+    // Each single-operand step removes its operand and appends the result
+    std::vector<int> position(numInputs);
+    for (int t = 0; t < numInputs; ++t) position[t] = t;
+    for (auto &step : state.steps)
+    {
+        const int t = step.operands[0];
+        step.operands[0] = position[t];
+        for (int u = 0; u < numInputs; ++u)
+        {
+            if (position[u] > position[t]) position[u]--;
+        }
+        position[t] = numInputs - 1;
+    }
+    std::vector<Operand> reordered(numInputs);
+    for (int t = 0; t < numInputs; ++t) reordered[position[t]] = state.operands[t];
+    state.operands = reordered;
+    return true;
+}
+
+} // namespace einsum_path_detail
+
+/**
+ * Computes the contraction path of equation for operands of the given
+ * shapes; returns false if the equation cannot be parsed or no path fits in
+ * options.workspaceLimit
+ */
+inline bool ComputeEinsumPath(const std::string &equation,
+                              const std::vector<std::vector<int64_t>> &shapes,
+                              const EinsumPathOptions &options,
+                              EinsumPath &path)
+{
+    using namespace einsum_path_detail;
+    path = EinsumPath();
+    if (!ParseEinsumEquation(equation, shapes, path.equation))
+    {
+        return false;
+    }
+    const int numInputs = (int) path.equation.inputs.size();
+    if (numInputs == 0 || numInputs > 32)
+    {
+        return false;
+    }
+    Search search;
+    State state;
+    if (!MakeInitialState(path.equation, options.workspaceLimit, search, state))
+    {
+        return false;
+    }
+
+    bool useOptimal = options.algorithm == EinsumPathAlgorithm::kOptimal ||
+                      (options.algorithm == EinsumPathAlgorithm::kAuto && numInputs <= options.maxOptimalOperands);
+    State greedy = state;
+    const bool greedyFound = Greedy(search, greedy);
+    State best = greedy;
+    if (useOptimal)
+    {
+        BranchAndBound branchAndBound(search, greedy, greedyFound);
+        State start = state;
+        branchAndBound.run(start);
+        if (!branchAndBound.found())
+        {
+            return false;
+        }
+        best = branchAndBound.best();
+    }
+    else if (!greedyFound)
+    {
+        return false;
+    }
+    path.steps = best.steps;
+    path.flops = best.flops;
+    path.peakElements = best.peak;
+    return true;
+}
@@ -0,0 +1,411 @@
+// Checks ComputeEinsumPath: the optimal search against an exhaustive
+// enumeration of pairwise orders on random equations, with and without a
+// workspace limit; that greedy and optimal paths compute the einsum; and
+// that ellipsis dimensions broadcast.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "einsum_path.h"
+#include "test_check.h"
+
+namespace
+{
+
+struct Tensor
+{
+    std::string modes;
+    std::vector<double> data; // row-major in the order of modes
+};
+
+int64_t Extent(const std::vector<int64_t> &extent, char c)
+{
+    return extent[(unsigned char) c];
+}
+
+// Naive einsum of the inputs into output: loops over every assignment of the
+// modes of the inputs
+Tensor Contract(const std::vector<const Tensor *> &inputs, const std::string &output,
+                const std::vector<int64_t> &extent)
+{
+    std::string all = output;
+    for (const Tensor *input : inputs)
+    {
+        for (const char c : input->modes)
+        {
+            if (all.find(c) == std::string::npos) all += c;
+        }
+    }
+    Tensor result;
+    result.modes = output;
+    int64_t size = 1;
+    for (const char c : output) size *= Extent(extent, c);
+    result.data.assign(size, 0.0);
+
+    std::vector<int64_t> index(256, 0);
+    auto offset = [&](const std::string &modes)
+    {
+        int64_t value = 0;
+        for (const char c : modes) value = value * Extent(extent, c) + index[(unsigned char) c];
+        return value;
+    };
+    while (true)
+    {
+        double product = 1.0;
+        for (const Tensor *input : inputs) product *= input->data[offset(input->modes)];
+        result.data[offset(output)] += product;
+        // Odometer over all, last mode fastest
+        int k = (int) all.size() - 1;
+        for (; k >= 0; --k)
+        {
+            const unsigned char m = all[k];
+            if (++index[m] < extent[m]) break;
+            index[m] = 0;
+        }
+        if (k < 0) break;
+    }
+    return result;
+}
+
+Tensor RandomTensor(const std::string &modes, const std::vector<int64_t> &extent, std::mt19937 &rng)
+{
+    Tensor tensor;
+    tensor.modes = modes;
+    int64_t size = 1;
+    for (const char c : modes) size *= Extent(extent, c);
+    std::uniform_real_distribution<double> value(-1.0, 1.0);
+    for (int64_t i = 0; i < size; ++i) tensor.data.push_back(value(rng));
+    return tensor;
+}
+
+// Executes the steps of path on the parsed operands, checking that every step
+// names the modes of the operands it consumes, and compares the result with a
+// direct evaluation of the whole equation
+void CheckPathComputes(const EinsumPath &path, std::mt19937 &rng)
+{
+    const EinsumEquation &eq = path.equation;
+    std::vector<int64_t> extent(256, 1);
+    for (size_t t = 0; t < eq.inputs.size(); ++t)
+    {
+        for (size_t i = 0; i < eq.inputs[t].size(); ++i)
+        {
+            extent[(unsigned char) eq.inputs[t][i]] = eq.shapes[t][i];
+        }
+    }
+    std::vector<Tensor> inputs;
+    for (const auto &modes : eq.inputs) inputs.push_back(RandomTensor(modes, extent, rng));
+
+    std::vector<Tensor> operands = inputs;
+    for (const auto &step : path.steps)
+    {
+        const auto arrow = step.equation.find("->");
+        CHECK(arrow != std::string::npos);
+        const std::string lhs = step.equation.substr(0, arrow);
+        const std::string rhs = step.equation.substr(arrow + 2);
+        std::string expected;
+        std::vector<const Tensor *> consumed;
+        for (const int k : step.operands)
+        {
+            CHECK(k >= 0 && k < (int) operands.size());
+            expected += (consumed.empty() ? "" : ",") + operands[k].modes;
+            consumed.push_back(&operands[k]);
+        }
+        CHECK(lhs == expected);
+        CHECK(step.shape.size() == rhs.size());
+        for (size_t i = 0; i < rhs.size() && i < step.shape.size(); ++i)
+        {
+            CHECK(step.shape[i] == Extent(extent, rhs[i]));
+        }
+        const Tensor result = Contract(consumed, rhs, extent);
+        std::vector<int> order = step.operands;
+        std::sort(order.rbegin(), order.rend());
+        for (const int k : order) operands.erase(operands.begin() + k);
+        operands.push_back(result);
+    }
+    CHECK(operands.size() == 1);
+    CHECK(operands.back().modes == eq.output);
+
+    std::vector<const Tensor *> all;
+    for (const auto &input : inputs) all.push_back(&input);
+    const Tensor direct = Contract(all, eq.output, extent);
+    CHECK(direct.data.size() == operands.back().data.size());
+    for (size_t i = 0; i < direct.data.size() && i < operands.back().data.size(); ++i)
+    {
+        CHECK(std::fabs(direct.data[i] - operands.back().data[i]) <= 1e-9 * (1 + std::fabs(direct.data[i])));
+    }
+}
+
+// Exhaustive search over all pairwise contraction orders with the cost model
+// of einsum_path.h: a pair costs 2 * the product of the extents of all its
+// modes, the result keeps the modes that another operand or the output still
+// needs, and the peak counts the live intermediates, output included
+struct Exhaustive
+{
+    struct Operand
+    {
+        std::string modes;
+        double size;
+        bool isIntermediate;
+    };
+
+    std::vector<int64_t> extent;
+    std::string output;
+    double workspaceLimit;
+    bool found = false;
+    double bestFlops = 0;
+    double bestPeak = 0;
+
+    double Size(const std::string &modes) const
+    {
+        double size = 1;
+        for (const char c : modes) size *= (double) Extent(extent, c);
+        return size;
+    }
+
+    void Run(const std::vector<Operand> &operands, double flops, double live, double peak)
+    {
+        const int n = (int) operands.size();
+        if (n == 1)
+        {
+            const double tolerance = 1e-12 * std::max(flops, bestFlops);
+            if (!found || flops < bestFlops - tolerance || (flops <= bestFlops + tolerance && peak < bestPeak))
+            {
+                found = true;
+                bestFlops = flops;
+                bestPeak = peak;
+            }
+            return;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            for (int j = i + 1; j < n; ++j)
+            {
+                std::string both = operands[i].modes;
+                for (const char c : operands[j].modes)
+                {
+                    if (both.find(c) == std::string::npos) both += c;
+                }
+                std::string kept;
+                if (n == 2)
+                {
+                    kept = output;
+                }
+                else
+                {
+                    for (const char c : both)
+                    {
+                        bool needed = output.find(c) != std::string::npos;
+                        for (int k = 0; k < n; ++k)
+                        {
+                            if (k != i && k != j && operands[k].modes.find(c) != std::string::npos) needed = true;
+                        }
+                        if (needed) kept += c;
+                    }
+                }
+                Operand result{kept, Size(kept), true};
+                if (workspaceLimit > 0 && live + result.size > workspaceLimit) continue;
+                double nextLive = live + result.size;
+                const double nextPeak = std::max(peak, nextLive);
+                for (const int k : {i, j})
+                {
+                    if (operands[k].isIntermediate) nextLive -= operands[k].size;
+                }
+                std::vector<Operand> next;
+                for (int k = 0; k < n; ++k)
+                {
+                    if (k != i && k != j) next.push_back(operands[k]);
+                }
+                next.push_back(result);
+                Run(next, flops + 2 * Size(both), nextLive, nextPeak);
+            }
+        }
+    }
+};
+
+// Random equation whose every mode is carried by two operands or by one
+// operand and the output, so that no single-operand step is needed
+void MakeRandomEquation(std::mt19937 &rng, int numInputs, std::string &equation,
+                        std::vector<std::vector<int64_t>> &shapes, std::vector<int64_t> &extent)
+{
+    auto uniform = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+    const std::string pool = "abcdefgh";
+    extent.assign(256, 1);
+    for (const char c : pool) extent[(unsigned char) c] = uniform(2, 4);
+    std::vector<std::string> inputs(numInputs);
+    for (auto &modes : inputs)
+    {
+        const int rank = uniform(1, 3);
+        while ((int) modes.size() < rank)
+        {
+            const char c = pool[uniform(0, (int) pool.size() - 1)];
+            if (modes.find(c) == std::string::npos) modes += c;
+        }
+    }
+    std::string output;
+    for (const char c : pool)
+    {
+        int count = 0;
+        for (const auto &modes : inputs) count += modes.find(c) != std::string::npos;
+        if (count == 1 || (count > 1 && uniform(0, 3) == 0)) output += c;
+    }
+    std::shuffle(output.begin(), output.end(), rng);
+    equation.clear();
+    shapes.clear();
+    for (const auto &modes : inputs)
+    {
+        equation += (equation.empty() ? "" : ",") + modes;
+        shapes.emplace_back();
+        for (const char c : modes) shapes.back().push_back(Extent(extent, c));
+    }
+    equation += "->" + output;
+}
+
+void TestOptimalMatchesExhaustive()
+{
+    std::mt19937 rng(2021);
+    for (int trial = 0; trial < 200; ++trial)
+    {
+        std::string equation;
+        std::vector<std::vector<int64_t>> shapes;
+        std::vector<int64_t> extent;
+        MakeRandomEquation(rng, 2 + trial % 4, equation, shapes, extent);
+
+        Exhaustive exhaustive;
+        exhaustive.extent = extent;
+        exhaustive.output = equation.substr(equation.find("->") + 2);
+        exhaustive.workspaceLimit = 0;
+        std::vector<Exhaustive::Operand> operands;
+        EinsumEquation parsed;
+        CHECK(ParseEinsumEquation(equation, shapes, parsed));
+        for (const auto &modes : parsed.inputs) operands.push_back({modes, exhaustive.Size(modes), false});
+        exhaustive.Run(operands, 0, 0, 0);
+
+        EinsumPathOptions options;
+        options.algorithm = EinsumPathAlgorithm::kOptimal;
+        EinsumPath path;
+        CHECK(ComputeEinsumPath(equation, shapes, options, path));
+        CHECK(exhaustive.found);
+        CHECK(std::fabs(path.flops - exhaustive.bestFlops) <= 1e-9 * exhaustive.bestFlops);
+        CHECK(path.peakElements == exhaustive.bestPeak);
+        CheckPathComputes(path, rng);
+
+        // A limit below the optimal peak forces another path, or none
+        EinsumPathOptions limited = options;
+        limited.workspaceLimit = std::max(1.0, path.peakElements - 1);
+        Exhaustive bounded = exhaustive;
+        bounded.workspaceLimit = limited.workspaceLimit;
+        bounded.found = false;
+        bounded.Run(operands, 0, 0, 0);
+        EinsumPath limitedPath;
+        const bool ok = ComputeEinsumPath(equation, shapes, limited, limitedPath);
+        CHECK(ok == bounded.found);
+        if (ok && bounded.found)
+        {
+            CHECK(limitedPath.peakElements <= limited.workspaceLimit);
+            CHECK(std::fabs(limitedPath.flops - bounded.bestFlops) <= 1e-9 * bounded.bestFlops);
+            CheckPathComputes(limitedPath, rng);
+        }
+    }
+}
+
+void TestGreedyIsValid()
+{
+    std::mt19937 rng(7);
+    for (int trial = 0; trial < 100; ++trial)
+    {
+        std::string equation;
+        std::vector<std::vector<int64_t>> shapes;
+        std::vector<int64_t> extent;
+        MakeRandomEquation(rng, 2 + trial % 6, equation, shapes, extent);
+        EinsumPathOptions options;
+        options.algorithm = EinsumPathAlgorithm::kGreedy;
+        EinsumPath greedy;
+        CHECK(ComputeEinsumPath(equation, shapes, options, greedy));
+        CHECK(greedy.steps.size() == shapes.size() - 1);
+        CheckPathComputes(greedy, rng);
+
+        options.algorithm = EinsumPathAlgorithm::kOptimal;
+        EinsumPath optimal;
+        CHECK(ComputeEinsumPath(equation, shapes, options, optimal));
+        CHECK(optimal.flops <= greedy.flops * (1 + 1e-12));
+    }
+}
+
+void TestEllipsis()
+{
+    // The ellipsis of the first operand is (2, 1), of the second (5); the
+    // extent 1 broadcasts against 5 and is dropped from the first operand
+    const std::vector<std::vector<int64_t>> shapes = {{2, 1, 3, 4}, {5, 4, 6}};
+    EinsumPath path;
+    CHECK(ComputeEinsumPath("...ij,...jk->...ik", shapes, EinsumPathOptions(), path));
+    const EinsumEquation &eq = path.equation;
+    CHECK(eq.inputs.size() == 2);
+    CHECK(eq.output.size() == 4);
+    const std::string ellipsis = eq.output.substr(0, 2);
+    CHECK(eq.output.substr(2) == "ik");
+    CHECK(eq.inputs[0] == ellipsis.substr(0, 1) + "ij");
+    CHECK(eq.inputs[1] == ellipsis.substr(1, 1) + "jk");
+    CHECK(eq.shapes[0] == (std::vector<int64_t>{2, 3, 4}));
+    CHECK(eq.shapes[1] == (std::vector<int64_t>{5, 4, 6}));
+    CHECK(eq.outputShape == (std::vector<int64_t>{2, 5, 3, 6}));
+    CHECK(ellipsis.find_first_of("ijk") == std::string::npos);
+    std::mt19937 rng(1);
+    CheckPathComputes(path, rng);
+
+    // Implicit output: the ellipsis, then the labels used once, sorted
+    EinsumPath implicit;
+    CHECK(ComputeEinsumPath("...ij,...jk", shapes, EinsumPathOptions(), implicit));
+    CHECK(implicit.equation.output == eq.output);
+
+    // Extents other than 1 must agree
+    EinsumPath mismatch;
+    CHECK(!ComputeEinsumPath("...ij,...jk->...ik", {{2, 3, 3, 4}, {5, 4, 6}}, EinsumPathOptions(), mismatch));
+}
+
+void TestWorkspaceLimit()
+{
+    // ab,bc first keeps the 2 x 3 intermediate ac, then writes the 2 x 50
+    // output: peak 106. Starting with bc,cd needs 50 x 50 elements.
+    const std::vector<std::vector<int64_t>> shapes = {{2, 50}, {50, 3}, {3, 50}};
+    EinsumPath path;
+    CHECK(ComputeEinsumPath("ab,bc,cd->ad", shapes, EinsumPathOptions(), path));
+    CHECK(path.peakElements == 106);
+    CHECK(path.steps.size() == 2);
+    CHECK(path.steps[0].operands == (std::vector<int>{0, 1}));
+
+    for (const auto algorithm : {EinsumPathAlgorithm::kGreedy, EinsumPathAlgorithm::kOptimal})
+    {
+        EinsumPathOptions options;
+        options.algorithm = algorithm;
+        options.workspaceLimit = 106;
+        EinsumPath fits;
+        CHECK(ComputeEinsumPath("ab,bc,cd->ad", shapes, options, fits));
+        CHECK(fits.peakElements <= 106);
+        options.workspaceLimit = 105;
+        EinsumPath rejected;
+        CHECK(!ComputeEinsumPath("ab,bc,cd->ad", shapes, options, rejected));
+    }
+
+    // The limit also applies to single-operand steps: summing b out of ab
+    // needs 2 elements
+    EinsumPathOptions options;
+    options.workspaceLimit = 1;
+    EinsumPath summed;
+    CHECK(!ComputeEinsumPath("ab->a", {{2, 3}}, options, summed));
+    options.workspaceLimit = 2;
+    CHECK(ComputeEinsumPath("ab->a", {{2, 3}}, options, summed));
+}
+
+} // namespace
+
+int main()
+{
+    TestOptimalMatchesExhaustive();
+    TestGreedyIsValid();
+    TestEllipsis();
+    TestWorkspaceLimit();
+    return test_result("einsum_path_test");
+}
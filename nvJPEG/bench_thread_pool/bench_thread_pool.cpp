@@ -0,0 +1,159 @@
+// Host-only microbenchmark of the nvJPEG samples' thread pools: tasks per
+// second of the legacy single-queue pool against the work-stealing pool in
+// utils/thread_pool.h, with per-task enqueue and with enqueue_batch.
+#include <utils/bench_record.h>
+#include <utils/bench_timing.h>
+#include <utils/helper_string.h>
+#include <utils/thread_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "legacy_thread_pool.h"
+
+struct ProblemSpec {
+  int num_threads;
+  int num_tasks;
+  // Iterations of the dummy loop run by each task
+  int task_work;
+  bool pin_threads;
+  BenchTiming::Config timing_config;
+  BenchRecord::OutputOptions output_options;
+};
+
+void print_usage() {
+  printf(
+      "Usage: bench_thread_pool [--threads=##] [--tasks=##] [--task_work=##] "
+      "[--pin]\n"
+      "--threads sets the pool size (default: hardware concurrency)\n"
+      "--tasks sets the number of tasks per timed iteration (default 10000)\n"
+      "--task_work sets the dummy loop iterations per task (default 100)\n"
+      "--pin pins the work-stealing workers to CPUs\n");
+  BenchTiming::print_timing_usage();
+  BenchRecord::print_output_usage();
+}
+
+ProblemSpec parse_problem_spec(const int argc, const char **argv) {
+  if (checkCmdLineFlag(argc, argv, "help")) {
+    print_usage();
+    exit(EXIT_SUCCESS);
+  }
+  ProblemSpec problem_spec{
+      .num_threads = static_cast<int>(
+          std::max(1u, std::thread::hardware_concurrency())),
+      .num_tasks = 10000,
+      .task_work = 100,
+      .pin_threads = checkCmdLineFlag(argc, argv, "pin"),
+      .timing_config = BenchTiming::parse_config(argc, argv),
+      .output_options = BenchRecord::parse_output_options(argc, argv)};
+  if (checkCmdLineFlag(argc, argv, "threads")) {
+    problem_spec.num_threads = getCmdLineArgumentInt(argc, argv, "threads");
+  }
+  if (checkCmdLineFlag(argc, argv, "tasks")) {
+    problem_spec.num_tasks = getCmdLineArgumentInt(argc, argv, "tasks");
+  }
+  if (checkCmdLineFlag(argc, argv, "task_work")) {
+    problem_spec.task_work = getCmdLineArgumentInt(argc, argv, "task_work");
+  }
+  if (problem_spec.num_threads < 1 || problem_spec.num_tasks < 1 ||
+      problem_spec.task_work < 0) {
+    print_usage();
+    exit(EXIT_FAILURE);
+  }
+  return problem_spec;
+}
+
+// Dummy work whose result cannot be optimized away
+void run_task(int task_work, std::atomic<unsigned> &sink) {
+  unsigned value = 1;
+  for (int idx = 0; idx < task_work; idx++) value = value * 1664525u + 1013904223u;
+  sink.fetch_add(value & 1, std::memory_order_relaxed);
+}
+
+template <typename SubmitFunc, typename WaitFunc>
+BenchTiming::Summary measure_pool(const ProblemSpec &problem_spec,
+                                  SubmitFunc &&submit, WaitFunc &&wait) {
+  return BenchTiming::measure(problem_spec.timing_config, [&]() {
+    auto beg = std::chrono::steady_clock::now();
+    submit();
+    wait();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - beg).count();
+  });
+}
+
+void report(const ProblemSpec &problem_spec, const char *pool,
+            const BenchTiming::Summary &summary) {
+  double tasks_per_s = problem_spec.num_tasks / (summary.median / 1000.0);
+  BenchTiming::print_summary(pool, summary, 0.0);
+  printf("%s throughput (tasks/s): %f\n", pool, tasks_per_s);
+  if (problem_spec.output_options.format == BenchRecord::OutputFormat::kText) {
+    return;
+  }
+  BenchRecord::Record record;
+  record.add("bench", "bench_thread_pool");
+  record.add("routine", pool);
+  record.add("threads", problem_spec.num_threads);
+  record.add("tasks", problem_spec.num_tasks);
+  record.add("task_work", problem_spec.task_work);
+  record.add("pin", problem_spec.pin_threads);
+  record.add_timing_summary(summary);
+  record.add("tasks_per_s", tasks_per_s);
+  record.add_host_info();
+  BenchRecord::emit(problem_spec.output_options, record);
+}
+
+int main(const int argc, const char **argv) {
+  ProblemSpec problem_spec = parse_problem_spec(argc, argv);
+  printf("threads(%d) tasks(%d) task_work(%d) pin(%d)\n",
+         problem_spec.num_threads, problem_spec.num_tasks,
+         problem_spec.task_work, problem_spec.pin_threads);
+  std::atomic<unsigned> sink(0);
+  int task_work = problem_spec.task_work;
+
+  {
+    LegacyThreadPool pool(problem_spec.num_threads);
+    auto summary = measure_pool(
+        problem_spec,
+        [&]() {
+          for (int task = 0; task < problem_spec.num_tasks; task++) {
+            pool.enqueue([&](int) {
+              run_task(task_work, sink);
+              return 0;
+            });
+          }
+        },
+        [&]() { pool.wait(); });
+    report(problem_spec, "legacy_enqueue", summary);
+  }
+
+  {
+    ThreadPool pool(problem_spec.num_threads, problem_spec.pin_threads);
+    auto summary = measure_pool(
+        problem_spec,
+        [&]() {
+          for (int task = 0; task < problem_spec.num_tasks; task++) {
+            pool.enqueue([&](int) { run_task(task_work, sink); });
+          }
+        },
+        [&]() { pool.wait(); });
+    report(problem_spec, "work_stealing_enqueue", summary);
+
+    summary = measure_pool(
+        problem_spec,
+        [&]() {
+          pool.enqueue_batch(problem_spec.num_tasks, [&](int, size_t) {
+            run_task(task_work, sink);
+          });
+        },
+        [&]() { pool.wait(); });
+    report(problem_spec, "work_stealing_enqueue_batch", summary);
+  }
+  printf("checksum(%u)\n", sink.load());
+  return 0;
+}
@@ -1,4 +1,6 @@
 #pragma once 
+// Single-queue pool previously shipped with the nvJPEG samples, kept as the
+// baseline of bench_thread_pool.
 
 #include <vector>
 #include <queue>
@@ -10,9 +12,9 @@
 #include <functional>
 #include <stdexcept>
 
-class ThreadPool {
+class LegacyThreadPool {
 public:
-    ThreadPool(size_t);
+    LegacyThreadPool(size_t);
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args) 
         -> std::future<typename std::result_of<F(int, Args...)>::type>
@@ -29,7 +31,7 @@ public:
 
                 // don't allow enqueueing after stopping the pool
                 if(stop)
-                    throw std::runtime_error("enqueue on stopped ThreadPool");
+                    throw std::runtime_error("enqueue on stopped LegacyThreadPool");
 
                 tasks.emplace([task](int tid){ (*task)(tid); });
             }
@@ -41,7 +43,7 @@ public:
         std::unique_lock<std::mutex> lock(this->queue_mutex);
         completed.wait(lock, [this]{return this->in_flight == 0 && this->tasks.empty();});
     }
-    ~ThreadPool()
+    ~LegacyThreadPool()
     {
         {
             std::unique_lock<std::mutex> lock(queue_mutex);
@@ -66,8 +68,8 @@ private:
 };
  
 // the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads)
-    :   stop(false), in_flight(0), workers(threads)
+inline LegacyThreadPool::LegacyThreadPool(size_t threads)
+    :   workers(threads), in_flight(0), stop(false)
 {
     for(size_t i = 0;i<threads;++i)
         workers[i] = std::thread(
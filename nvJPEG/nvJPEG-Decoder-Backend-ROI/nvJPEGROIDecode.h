@@ -45,6 +45,7 @@
 
 #include <cuda_runtime_api.h>
 #include <nvjpeg.h>
+#include <utils/image_writer_nvjpeg.h>
 
 
 #define CHECK_CUDA(call)                                                        \
@@ -114,6 +115,8 @@ struct decode_params_t {
   nvjpegOutputFormat_t fmt;
   bool write_decoded;
   std::string output_dir;
+  ImageWriter::Format output_format;
+  int writer_threads;
 
 };
 
@@ -435,247 +438,6 @@ int getInputDir(std::string &input_dir, const char *executable_path) {
   return found;
 }
 
-// write bmp, input - RGB, device
-int writeBMP(const char *filename, const unsigned char *d_chanR, int pitchR,
-             const unsigned char *d_chanG, int pitchG,
-             const unsigned char *d_chanB, int pitchB, int width, int height) {
-  unsigned int headers[13];
-  FILE *outfile;
-  int extrabytes;
-  int paddedsize;
-  int x;
-  int y;
-  int n;
-  int red, green, blue;
-
-  std::vector<unsigned char> vchanR(height * width);
-  std::vector<unsigned char> vchanG(height * width);
-  std::vector<unsigned char> vchanB(height * width);
-  unsigned char *chanR = vchanR.data();
-  unsigned char *chanG = vchanG.data();
-  unsigned char *chanB = vchanB.data();
-  CHECK_CUDA(cudaMemcpy2D(chanR, (size_t)width, d_chanR, (size_t)pitchR,
-                               width, height, cudaMemcpyDeviceToHost));
-  CHECK_CUDA(cudaMemcpy2D(chanG, (size_t)width, d_chanG, (size_t)pitchR,
-                               width, height, cudaMemcpyDeviceToHost));
-  CHECK_CUDA(cudaMemcpy2D(chanB, (size_t)width, d_chanB, (size_t)pitchR,
-                               width, height, cudaMemcpyDeviceToHost));
-
-  extrabytes =
-      4 - ((width * 3) % 4);  // How many bytes of padding to add to each
-  // horizontal line - the size of which must
-  // be a multiple of 4 bytes.
-  if (extrabytes == 4) extrabytes = 0;
-
-  paddedsize = ((width * 3) + extrabytes) * height;
-
-  // Headers...
-  // Note that the "BM" identifier in bytes 0 and 1 is NOT included in these
-  // "headers".
-
-  headers[0] = paddedsize + 54;  // bfSize (whole file size)
-  headers[1] = 0;                // bfReserved (both)
-  headers[2] = 54;               // bfOffbits
-  headers[3] = 40;               // biSize
-  headers[4] = width;            // biWidth
-  headers[5] = height;           // biHeight
-
-  // Would have biPlanes and biBitCount in position 6, but they're shorts.
-  // It's easier to write them out separately (see below) than pretend
-  // they're a single int, especially with endian issues...
-
-  headers[7] = 0;           // biCompression
-  headers[8] = paddedsize;  // biSizeImage
-  headers[9] = 0;           // biXPelsPerMeter
-  headers[10] = 0;          // biYPelsPerMeter
-  headers[11] = 0;          // biClrUsed
-  headers[12] = 0;          // biClrImportant
-
-  if (!(outfile = fopen(filename, "wb"))) {
-    std::cerr << "Cannot open file: " << filename << std::endl;
-    return 1;
-  }
-
-  //
-  // Headers begin...
-  // When printing ints and shorts, we write out 1 character at a time to avoid
-  // endian issues.
-  //
-  fprintf(outfile, "BM");
-
-  for (n = 0; n <= 5; n++) {
-    fprintf(outfile, "%c", headers[n] & 0x000000FF);
-    fprintf(outfile, "%c", (headers[n] & 0x0000FF00) >> 8);
-    fprintf(outfile, "%c", (headers[n] & 0x00FF0000) >> 16);
-    fprintf(outfile, "%c", (headers[n] & (unsigned int)0xFF000000) >> 24);
-  }
-
-  // These next 4 characters are for the biPlanes and biBitCount fields.
-
-  fprintf(outfile, "%c", 1);
-  fprintf(outfile, "%c", 0);
-  fprintf(outfile, "%c", 24);
-  fprintf(outfile, "%c", 0);
-
-  for (n = 7; n <= 12; n++) {
-    fprintf(outfile, "%c", headers[n] & 0x000000FF);
-    fprintf(outfile, "%c", (headers[n] & 0x0000FF00) >> 8);
-    fprintf(outfile, "%c", (headers[n] & 0x00FF0000) >> 16);
-    fprintf(outfile, "%c", (headers[n] & (unsigned int)0xFF000000) >> 24);
-  }
-
-  //
-  // Headers done, now write the data...
-  //
-
-  for (y = height - 1; y >= 0;
-       y--)  // BMP image format is written from bottom to top...
-  {
-    for (x = 0; x <= width - 1; x++) {
-      red = chanR[y * width + x];
-      green = chanG[y * width + x];
-      blue = chanB[y * width + x];
-
-      if (red > 255) red = 255;
-      if (red < 0) red = 0;
-      if (green > 255) green = 255;
-      if (green < 0) green = 0;
-      if (blue > 255) blue = 255;
-      if (blue < 0) blue = 0;
-      // Also, it's written in (b,g,r) format...
-
-      fprintf(outfile, "%c", blue);
-      fprintf(outfile, "%c", green);
-      fprintf(outfile, "%c", red);
-    }
-    if (extrabytes)  // See above - BMP lines must be of lengths divisible by 4.
-    {
-      for (n = 1; n <= extrabytes; n++) {
-        fprintf(outfile, "%c", 0);
-      }
-    }
-  }
-
-  fclose(outfile);
-  return 0;
-}
-
-// write bmp, input - RGB, device
-int writeBMPi(const char *filename, const unsigned char *d_RGB, int pitch,
-              int width, int height) {
-  unsigned int headers[13];
-  FILE *outfile;
-  int extrabytes;
-  int paddedsize;
-  int x;
-  int y;
-  int n;
-  int red, green, blue;
-
-  std::vector<unsigned char> vchanRGB(height * width * 3);
-  unsigned char *chanRGB = vchanRGB.data();
-  CHECK_CUDA(cudaMemcpy2D(chanRGB, (size_t)width * 3, d_RGB, (size_t)pitch,
-                               width * 3, height, cudaMemcpyDeviceToHost));
-
-  extrabytes =
-      4 - ((width * 3) % 4);  // How many bytes of padding to add to each
-  // horizontal line - the size of which must
-  // be a multiple of 4 bytes.
-  if (extrabytes == 4) extrabytes = 0;
-
-  paddedsize = ((width * 3) + extrabytes) * height;
-
-  // Headers...
-  // Note that the "BM" identifier in bytes 0 and 1 is NOT included in these
-  // "headers".
-  headers[0] = paddedsize + 54;  // bfSize (whole file size)
-  headers[1] = 0;                // bfReserved (both)
-  headers[2] = 54;               // bfOffbits
-  headers[3] = 40;               // biSize
-  headers[4] = width;            // biWidth
-  headers[5] = height;           // biHeight
-
-  // Would have biPlanes and biBitCount in position 6, but they're shorts.
-  // It's easier to write them out separately (see below) than pretend
-  // they're a single int, especially with endian issues...
-
-  headers[7] = 0;           // biCompression
-  headers[8] = paddedsize;  // biSizeImage
-  headers[9] = 0;           // biXPelsPerMeter
-  headers[10] = 0;          // biYPelsPerMeter
-  headers[11] = 0;          // biClrUsed
-  headers[12] = 0;          // biClrImportant
-
-  if (!(outfile = fopen(filename, "wb"))) {
-    std::cerr << "Cannot open file: " << filename << std::endl;
-    return 1;
-  }
-
-  //
-  // Headers begin...
-  // When printing ints and shorts, we write out 1 character at a time to avoid
-  // endian issues.
-  //
-
-  fprintf(outfile, "BM");
-
-  for (n = 0; n <= 5; n++) {
-    fprintf(outfile, "%c", headers[n] & 0x000000FF);
-    fprintf(outfile, "%c", (headers[n] & 0x0000FF00) >> 8);
-    fprintf(outfile, "%c", (headers[n] & 0x00FF0000) >> 16);
-    fprintf(outfile, "%c", (headers[n] & (unsigned int)0xFF000000) >> 24);
-  }
-
-  // These next 4 characters are for the biPlanes and biBitCount fields.
-
-  fprintf(outfile, "%c", 1);
-  fprintf(outfile, "%c", 0);
-  fprintf(outfile, "%c", 24);
-  fprintf(outfile, "%c", 0);
-
-  for (n = 7; n <= 12; n++) {
-    fprintf(outfile, "%c", headers[n] & 0x000000FF);
-    fprintf(outfile, "%c", (headers[n] & 0x0000FF00) >> 8);
-    fprintf(outfile, "%c", (headers[n] & 0x00FF0000) >> 16);
-    fprintf(outfile, "%c", (headers[n] & (unsigned int)0xFF000000) >> 24);
-  }
-
-  //
-  // Headers done, now write the data...
-  //
-  for (y = height - 1; y >= 0;
-       y--)  // BMP image format is written from bottom to top...
-  {
-    for (x = 0; x <= width - 1; x++) {
-      red = chanRGB[(y * width + x) * 3];
-      green = chanRGB[(y * width + x) * 3 + 1];
-      blue = chanRGB[(y * width + x) * 3 + 2];
-
-      if (red > 255) red = 255;
-      if (red < 0) red = 0;
-      if (green > 255) green = 255;
-      if (green < 0) green = 0;
-      if (blue > 255) blue = 255;
-      if (blue < 0) blue = 0;
-      // Also, it's written in (b,g,r) format...
-
-      fprintf(outfile, "%c", blue);
-      fprintf(outfile, "%c", green);
-      fprintf(outfile, "%c", red);
-    }
-    if (extrabytes)  // See above - BMP lines must be of lengths divisible by 4.
-    {
-      for (n = 1; n <= extrabytes; n++) {
-        fprintf(outfile, "%c", 0);
-      }
-    }
-  }
-
-  fclose(outfile);
-  return 0;
-}
-
-
 // *****************************************************************************
 // parse parameters
 // -----------------------------------------------------------------------------
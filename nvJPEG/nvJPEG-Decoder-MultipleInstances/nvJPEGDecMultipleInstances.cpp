@@ -28,7 +28,7 @@
   
 
 #include "nvJPEGDecMultipleInstances.h"
-#include "threadpool.h"
+#include <utils/thread_pool.h>
 
 float get_scale_factor(nvjpegChromaSubsampling_t chroma_subsampling)
 {
@@ -118,9 +118,9 @@ int decode_images(const FileData &img_data, const std::vector<size_t> &img_len,
   {
     std::vector<int> buffer_indices(params.num_threads, 0);
     
-    for (int i = 0; i < params.batch_size; i++) {
-        workers.enqueue(std::bind(
-            [&params, &buffer_indices, &out, &img_data, &img_len](int iidx, int thread_idx)
+    // one task per image, pushed to the per-thread queues in a single call
+    workers.enqueue_batch(params.batch_size,
+            [&params, &buffer_indices, &out, &img_data, &img_len](int thread_idx, size_t iidx)
                 {
                   auto& per_thread_params = params.nvjpeg_per_thread_data[thread_idx];
                   
@@ -149,10 +149,7 @@ int decode_images(const FileData &img_data, const std::vector<size_t> &img_len,
                   // switch pinned buffer in pipeline mode to avoid an extra sync
                   buffer_indices[thread_idx] = (buffer_indices[thread_idx]+1)%pipeline_stages;
                   return EXIT_SUCCESS; // the CHECK_ statements returns 1 on failure, so we need to return a value here too.
-                }, i, std::placeholders::_1
-                )
-            );
-    }
+                });
     workers.wait();
     for ( auto& per_thread_params : params.nvjpeg_per_thread_data) {
         CHECK_CUDA(cudaStreamSynchronize(per_thread_params.stream))
@@ -172,38 +169,20 @@ int decode_images(const FileData &img_data, const std::vector<size_t> &img_len,
 
 int write_images(std::vector<nvjpegImage_t> &iout, std::vector<int> &widths,
                  std::vector<int> &heights, decode_params_t &params,
-                 FileNames &filenames) {
+                 const FileNames &filenames, ImageWriter::AsyncWriter &writer) {
   for (int i = 0; i < params.batch_size; i++) {
-    // Get the file name, without extension.
-    // This will be used to rename the output file.
-    size_t position = filenames[i].rfind("/");
-    std::string sFileName =
-        (std::string::npos == position)
-            ? filenames[i]
-            : filenames[i].substr(position + 1, filenames[i].size());
-    position = sFileName.rfind(".");
-    sFileName = (std::string::npos == position) ? sFileName
-                                                : sFileName.substr(0, position);
-    std::string fname(params.output_dir + "/" + sFileName + ".bmp");
-
-    int err;
-    if (params.fmt == NVJPEG_OUTPUT_RGB || params.fmt == NVJPEG_OUTPUT_BGR) {
-      err = writeBMP(fname.c_str(), iout[i].channel[0], iout[i].pitch[0],
-                     iout[i].channel[1], iout[i].pitch[1], iout[i].channel[2],
-                     iout[i].pitch[2], widths[i], heights[i]);
-    } else if (params.fmt == NVJPEG_OUTPUT_RGBI ||
-               params.fmt == NVJPEG_OUTPUT_BGRI) {
-      // Write BMP from interleaved data
-      err = writeBMPi(fname.c_str(), iout[i].channel[0], iout[i].pitch[0],
-                      widths[i], heights[i]);
-    }
-    if (err) {
-      std::cout << "Cannot write output file: " << fname << std::endl;
+    std::string fname = ImageWriter::get_output_name(
+        params.output_dir, filenames[i], params.output_format);
+    // Only the device-to-host copy happens here; the writer threads encode
+    // and write the file
+    if (ImageWriter::write_image(writer, fname, params.output_format, iout[i],
+                                 params.fmt, widths[i], heights[i])) {
+      std::cout << "Cannot copy decoded image for output file: " << fname
+                << std::endl;
       return EXIT_FAILURE;
     }
-    std::cout << "Done writing decoded image to file: " << fname << std::endl;
   }
-  return EXIT_SUCCESS;
+  return writer.get_num_failed() > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 double process_images(FileNames &image_names, decode_params_t &params,
@@ -235,6 +214,9 @@ double process_images(FileNames &image_names, decode_params_t &params,
   }
   ThreadPool workers(params.num_threads);
   
+  // Decoded images are written in the background, at most two batches behind
+  ImageWriter::AsyncWriter writer(params.writer_threads, 2 * params.batch_size);
+
   double test_time = 0;
   int warmup = 0;
   while (total_processed < params.total_images) {
@@ -256,9 +238,12 @@ double process_images(FileNames &image_names, decode_params_t &params,
       test_time += time;
     }
 
-    if (params.write_decoded)
-      write_images(iout, widths, heights, params, current_names);
+    if (params.write_decoded &&
+        write_images(iout, widths, heights, params, current_names, writer))
+      return EXIT_FAILURE;
   }
+  writer.wait();
+  if (writer.get_num_failed() > 0) return EXIT_FAILURE;
   total = test_time;
 
   release_buffers(iout);
@@ -276,7 +261,8 @@ int main(int argc, const char *argv[]) {
       (pidx = findParamIndex(argv, argc, "--help")) != -1) {
     std::cout << "Usage: " << argv[0]
               << " -i images_dir [-b batch_size] [-t total_images] "
-                 "[-w warmup_iterations] [-o output_dir] "
+                 "[-w warmup_iterations] [-o output_dir] [-out_fmt out_fmt] "
+                 "[-writer_threads writer_threads] "
                  "[-pipelined] [-batched] [-fmt output_format]\n";
     std::cout << "Parameters: " << std::endl;
     std::cout << "\timages_dir\t:\tPath to single image or directory of images"
@@ -293,8 +279,14 @@ int main(int argc, const char *argv[]) {
                  "without measuring performance"
               << std::endl;
     std::cout
-        << "\toutput_dir\t:\tWrite decoded images as BMPs to this directory"
+        << "\toutput_dir\t:\tWrite decoded images to this directory"
         << std::endl;
+    std::cout << "\tout_fmt\t\t:\tFile format of the decoded images. One of "
+                 "[bmp, ppm, png] (default bmp)"
+              << std::endl;
+    std::cout << "\twriter_threads\t:\tWrite decoded images with this many "
+                 "background threads, 0 writes them inline (default 4)"
+              << std::endl;
     std::cout << "\tpipelined\t:\tUse decoding in phases" << std::endl;
     std::cout << "\tbatched\t\t:\tUse batched interface" << std::endl;
     std::cout << "\toutput_format\t:\tnvJPEG output format for decoding. One "
@@ -361,12 +353,25 @@ int main(int argc, const char *argv[]) {
     }
   }
 
+  params.output_format = ImageWriter::Format::kBMP;
+  if ((pidx = findParamIndex(argv, argc, "-out_fmt")) != -1) {
+    std::string sfmt = argv[pidx + 1];
+    if (!ImageWriter::parse_format(sfmt, params.output_format)) {
+      std::cout << "Unknown output file format: " << sfmt << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  params.writer_threads = 4;
+  if ((pidx = findParamIndex(argv, argc, "-writer_threads")) != -1) {
+    params.writer_threads = std::atoi(argv[pidx + 1]);
+  }
+
   params.write_decoded = false;
   if ((pidx = findParamIndex(argv, argc, "-o")) != -1) {
     params.output_dir = argv[pidx + 1];
-    if (params.fmt != NVJPEG_OUTPUT_RGB && params.fmt != NVJPEG_OUTPUT_BGR &&
-        params.fmt != NVJPEG_OUTPUT_RGBI && params.fmt != NVJPEG_OUTPUT_BGRI) {
-      std::cout << "We can write ony BMPs, which require output format be "
+    if (!ImageWriter::is_writable(params.fmt)) {
+      std::cout << "Writing decoded images requires output format be "
                    "either RGB/BGR or RGBi/BGRi"
                 << std::endl;
       return EXIT_FAILURE;
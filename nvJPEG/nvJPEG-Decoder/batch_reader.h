@@ -0,0 +1,426 @@
+#pragma once
+// Prefetching file reader stage of the batch decoder. Host-only, no CUDA or
+// nvJPEG dependency.
+//
+// Batches live in a bounded ring of `depth` entries. Reader threads claim
+// (batch, slot) pairs in batch order and fill them, so that the next
+// depth - 1 batches are read while the caller decodes the current one. A
+// batch is handed out by acquire() once all of its slots are filled and goes
+// back to the ring with release(). Slot buffers are kept across batches and
+// only grow.
+//
+// The input list is walked cyclically, as the decoder loops over the input
+// when total_images exceeds the number of files. Every slot is claimed
+// together with its file, so batches hold the files in list order for any
+// number of reader threads. A file that cannot be read is marked bad and
+// skipped from then on; its slot takes the next file.
+//
+// Read modes
+//   read    open + read into the slot buffer
+//   mmap    map the file and touch every page in the reader thread; the
+//           batch points into the mapping until the slot is refilled
+//   direct  O_DIRECT reads into a block-aligned slot buffer, bypassing the
+//           page cache; falls back to buffered reads where the file system
+//           rejects O_DIRECT
+// mmap and direct are POSIX only.
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN64
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace BatchReader {
+enum class ReadMode { kRead, kMmap, kDirect };
+
+struct Options {
+  int num_threads;
+  // Number of batches in the ring, including the one being decoded
+  int depth;
+  ReadMode mode;
+};
+
+Options get_default_options() {
+  Options options;
+  options.num_threads = 4;
+  options.depth = 3;
+  options.mode = ReadMode::kRead;
+  return options;
+}
+
+const char *get_read_mode_name(ReadMode mode) {
+  switch (mode) {
+    case ReadMode::kMmap:
+      return "mmap";
+    case ReadMode::kDirect:
+      return "direct";
+    default:
+      return "read";
+  }
+}
+
+// Returns false for an unknown or, on Windows, unsupported mode
+bool parse_read_mode(const std::string &str, ReadMode &mode) {
+  if (str == "read") {
+    mode = ReadMode::kRead;
+    return true;
+  }
+#ifndef _WIN64
+  if (str == "mmap") {
+    mode = ReadMode::kMmap;
+    return true;
+  }
+  if (str == "direct") {
+    mode = ReadMode::kDirect;
+    return true;
+  }
+#endif
+  return false;
+}
+
+// Alignment of O_DIRECT buffers and transfer sizes
+const size_t kDirectAlignment = 4096;
+
+// Storage of one image of a batch: either an owned buffer or a file mapping
+class Slot {
+ public:
+  Slot() = default;
+  Slot(const Slot &) = delete;
+  Slot &operator=(const Slot &) = delete;
+  ~Slot() {
+    unmap();
+    free(buffer_);
+  }
+
+  char *reserve(size_t bytes) {
+    if (bytes > capacity_) {
+      free(buffer_);
+      buffer_ = nullptr;
+      capacity_ = 0;
+#ifdef _WIN64
+      buffer_ = static_cast<char *>(malloc(bytes));
+#else
+      void *ptr = nullptr;
+      if (posix_memalign(&ptr, kDirectAlignment, bytes) == 0) {
+        buffer_ = static_cast<char *>(ptr);
+      }
+#endif
+      if (buffer_ == nullptr) throw std::bad_alloc();
+      capacity_ = bytes;
+    }
+    return buffer_;
+  }
+
+  void map(void *mapping, size_t bytes) {
+    unmap();
+    mapping_ = mapping;
+    mapping_size_ = bytes;
+  }
+
+  void unmap() {
+#ifndef _WIN64
+    if (mapping_ != nullptr) munmap(mapping_, mapping_size_);
+#endif
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+  }
+
+ private:
+  char *buffer_ = nullptr;
+  size_t capacity_ = 0;
+  void *mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+};
+
+struct Batch {
+  // Position of the batch in the sequence handed out by acquire()
+  long index;
+  // Encoded bitstream, its length and its file name for every image
+  std::vector<const unsigned char *> data;
+  std::vector<size_t> len;
+  std::vector<std::string> names;
+
+  std::vector<Slot> slots;
+  int filled;
+};
+
+class Reader {
+ public:
+  // Reads num_batches batches of batch_size images from file_names
+  Reader(const std::vector<std::string> &file_names, int batch_size,
+         long num_batches, const Options &options)
+      : file_names_(file_names),
+        batch_size_(batch_size),
+        num_batches_(num_batches),
+        options_(options),
+        ring_(std::max(1, options.depth)),
+        bad_(file_names.size(), 0) {
+    if (batch_size < 1 || options.num_threads < 1 || options.depth < 1) {
+      throw std::invalid_argument(
+          "batch size, reader threads and prefetch depth must be positive");
+    }
+    for (auto &batch : ring_) {
+      batch.index = -1;
+      batch.data.resize(batch_size);
+      batch.len.resize(batch_size);
+      batch.names.resize(batch_size);
+      batch.slots = std::vector<Slot>(batch_size);
+      batch.filled = 0;
+    }
+    for (int idx = 0; idx < options.num_threads; idx++) {
+      workers_.emplace_back(&Reader::worker, this);
+    }
+  }
+
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+
+  ~Reader() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    slot_free_.notify_all();
+    for (auto &worker : workers_) worker.join();
+  }
+
+  // Blocks until the next batch is read. Returns nullptr once num_batches
+  // batches were handed out or when no readable file is left.
+  Batch *acquire() {
+    if (next_acquire_ >= num_batches_) return nullptr;
+    Batch &batch = ring_[next_acquire_ % ring_.size()];
+    auto beg = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+    batch_ready_.wait(
+        lock, [&]() { return failed_ || batch.filled == batch_size_; });
+    wait_time_ += std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - beg)
+                      .count();
+    if (batch.filled != batch_size_) return nullptr;
+    batch.index = next_acquire_++;
+    return &batch;
+  }
+
+  // Returns a batch to the ring. Batches must be released in acquire order.
+  void release(Batch *batch) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (batch != &ring_[num_released_ % ring_.size()]) {
+        throw std::logic_error("batches must be released in order");
+      }
+      batch->filled = 0;
+      num_released_++;
+    }
+    slot_free_.notify_all();
+  }
+
+  // Seconds the caller spent blocked in acquire()
+  double get_wait_time() const { return wait_time_; }
+
+  size_t get_bytes_read() const { return bytes_read_; }
+
+ private:
+  // Next readable file in cyclic order; called with mutex_ held
+  bool next_file(size_t &file) {
+    if (num_bad_ == file_names_.size()) {
+      std::cerr << "No valid images left in the input list, exit" << std::endl;
+      return false;
+    }
+    for (;;) {
+      if (next_file_ == file_names_.size()) {
+        std::cerr << "Image list is too short to fill the batch, adding files "
+                     "from the beginning of the image list"
+                  << std::endl;
+        next_file_ = 0;
+      }
+      size_t idx = next_file_++;
+      if (!bad_[idx]) {
+        file = idx;
+        return true;
+      }
+    }
+  }
+
+#ifndef _WIN64
+  // Reads up to bytes from fd, retrying short reads. An O_DIRECT descriptor
+  // is switched to buffered mode if the kernel rejects an unaligned transfer.
+  static size_t read_fd(int fd, char *buffer, size_t bytes) {
+    size_t done = 0;
+    while (done < bytes) {
+      ssize_t ret = ::read(fd, buffer + done, bytes - done);
+      if (ret < 0 && errno == EINTR) continue;
+      if (ret < 0 && errno == EINVAL) {
+        int flags = fcntl(fd, F_GETFL);
+#ifdef O_DIRECT
+        if (flags != -1 && (flags & O_DIRECT) &&
+            fcntl(fd, F_SETFL, flags & ~O_DIRECT) == 0) {
+          continue;
+        }
+#endif
+      }
+      if (ret <= 0) break;
+      done += ret;
+    }
+    return done;
+  }
+#endif
+
+  bool read_file(const std::string &name, Slot &slot,
+                 const unsigned char *&data, size_t &len) {
+    slot.unmap();
+#ifdef _WIN64
+    std::ifstream input(name.c_str(),
+                        std::ios::in | std::ios::binary | std::ios::ate);
+    if (!input.is_open()) return false;
+    std::streamsize file_size = input.tellg();
+    if (file_size <= 0) return false;
+    input.seekg(0, std::ios::beg);
+    char *buffer = slot.reserve(file_size);
+    if (!input.read(buffer, file_size)) return false;
+    data = reinterpret_cast<const unsigned char *>(buffer);
+    len = file_size;
+    return true;
+#else
+    int flags = O_RDONLY;
+    bool direct = false;
+#ifdef O_DIRECT
+    if (options_.mode == ReadMode::kDirect) {
+      flags |= O_DIRECT;
+      direct = true;
+    }
+#endif
+    int fd = open(name.c_str(), flags);
+    if (fd < 0 && direct && errno == EINVAL) {
+      fd = open(name.c_str(), O_RDONLY);
+      direct = false;
+    }
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0) {
+      close(fd);
+      return false;
+    }
+    size_t file_size = info.st_size;
+
+    if (options_.mode == ReadMode::kMmap) {
+      void *mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (mapping == MAP_FAILED) return false;
+      slot.map(mapping, file_size);
+      // Fault the pages in here so that the decoding thread never waits on
+      // the file system
+      const volatile char *bytes = static_cast<const char *>(mapping);
+      for (size_t offset = 0; offset < file_size; offset += kDirectAlignment) {
+        (void)bytes[offset];
+      }
+      data = static_cast<const unsigned char *>(mapping);
+      len = file_size;
+      return true;
+    }
+
+    // O_DIRECT transfers whole blocks; the last one is a short read
+    size_t capacity =
+        direct ? (file_size + kDirectAlignment - 1) / kDirectAlignment *
+                     kDirectAlignment
+               : file_size;
+    char *buffer = slot.reserve(capacity);
+    size_t done = read_fd(fd, buffer, capacity);
+    close(fd);
+    if (done < file_size) return false;
+    data = reinterpret_cast<const unsigned char *>(buffer);
+    len = file_size;
+    return true;
+#endif
+  }
+
+  void worker() {
+    for (;;) {
+      long batch_index;
+      int slot;
+      size_t file = 0;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slot_free_.wait(lock, [&]() {
+          long claim_batch = next_claim_ / batch_size_;
+          return stop_ || failed_ || claim_batch >= num_batches_ ||
+                 claim_batch < num_released_ + static_cast<long>(ring_.size());
+        });
+        if (stop_ || failed_ || next_claim_ / batch_size_ >= num_batches_) {
+          return;
+        }
+        // The file is claimed with the slot, so that claim c always reads
+        // the c-th file of the list whatever the scheduling of the workers
+        if (!next_file(file)) {
+          failed_ = true;
+          batch_ready_.notify_all();
+          return;
+        }
+        batch_index = next_claim_ / batch_size_;
+        slot = next_claim_ % batch_size_;
+        next_claim_++;
+      }
+
+      Batch &batch = ring_[batch_index % ring_.size()];
+      const unsigned char *data = nullptr;
+      size_t len = 0;
+      while (!read_file(file_names_[file], batch.slots[slot], data, len)) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!bad_[file]) {
+          std::cerr << "Cannot read image: " << file_names_[file]
+                    << ", removing it from image list" << std::endl;
+          bad_[file] = 1;
+          num_bad_++;
+        }
+        if (!next_file(file)) {
+          failed_ = true;
+          batch_ready_.notify_all();
+          return;
+        }
+      }
+      batch.data[slot] = data;
+      batch.len[slot] = len;
+      batch.names[slot] = file_names_[file];
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      bytes_read_ += len;
+      if (++batch.filled == batch_size_) batch_ready_.notify_all();
+    }
+  }
+
+  const std::vector<std::string> file_names_;
+  const int batch_size_;
+  const long num_batches_;
+  const Options options_;
+  std::vector<Batch> ring_;
+  // Files that failed to read, skipped from then on
+  std::vector<char> bad_;
+  size_t num_bad_ = 0;
+  size_t next_file_ = 0;
+  // Slots are claimed in order; claim c fills slot c % batch_size of batch
+  // c / batch_size
+  long next_claim_ = 0;
+  long next_acquire_ = 0;
+  long num_released_ = 0;
+  bool stop_ = false;
+  bool failed_ = false;
+  double wait_time_ = 0.0;
+  size_t bytes_read_ = 0;
+  std::mutex mutex_;
+  std::condition_variable slot_free_;
+  std::condition_variable batch_ready_;
+  std::vector<std::thread> workers_;
+};
+}  // namespace BatchReader
@@ -30,7 +30,8 @@
 #include "nvjpegDecoder.h"
 
 
-int decode_images(const FileData &img_data, const std::vector<size_t> &img_len,
+int decode_images(const std::vector<const unsigned char *> &img_data,
+                  const std::vector<size_t> &img_len,
                   std::vector<nvjpegImage_t> &out, decode_params_t &params,
                   double &time) {
   CHECK_CUDA(cudaStreamSynchronize(params.stream));
@@ -53,23 +54,23 @@ int decode_images(const FileData &img_data, const std::vector<size_t> &img_len,
   if(params.hw_decode_available){
     for(int i = 0; i < params.batch_size; i++){
       // extract bitstream meta data to figure out whether a bit-stream can be decoded
-      nvjpegJpegStreamParseHeader(params.nvjpeg_handle, (const unsigned char *)img_data[i].data(), img_len[i], params.jpeg_streams[0]);
+      nvjpegJpegStreamParseHeader(params.nvjpeg_handle, img_data[i], img_len[i], params.jpeg_streams[0]);
       int isSupported = -1;
       nvjpegDecodeBatchedSupported(params.nvjpeg_handle, params.jpeg_streams[0], &isSupported);
 
       if(isSupported == 0){
-        batched_bitstreams.push_back((const unsigned char *)img_data[i].data());
+        batched_bitstreams.push_back(img_data[i]);
         batched_bitstreams_size.push_back(img_len[i]);
         batched_output.push_back(out[i]);
       } else {
-        otherdecode_bitstreams.push_back((const unsigned char *)img_data[i].data());
+        otherdecode_bitstreams.push_back(img_data[i]);
         otherdecode_bitstreams_size.push_back(img_len[i]);
         otherdecode_output.push_back(out[i]);
       }
     }
   } else {
     for(int i = 0; i < params.batch_size; i++) {
-      otherdecode_bitstreams.push_back((const unsigned char *)img_data[i].data());
+      otherdecode_bitstreams.push_back(img_data[i]);
       otherdecode_bitstreams_size.push_back(img_len[i]);
       otherdecode_output.push_back(out[i]);
     }
@@ -127,50 +128,33 @@ int decode_images(const FileData &img_data, const std::vector<size_t> &img_len,
 
 int write_images(std::vector<nvjpegImage_t> &iout, std::vector<int> &widths,
                  std::vector<int> &heights, decode_params_t &params,
-                 FileNames &filenames) {
+                 const FileNames &filenames, ImageWriter::AsyncWriter &writer) {
   for (int i = 0; i < params.batch_size; i++) {
-    // Get the file name, without extension.
-    // This will be used to rename the output file.
-    size_t position = filenames[i].rfind("/");
-    std::string sFileName =
-        (std::string::npos == position)
-            ? filenames[i]
-            : filenames[i].substr(position + 1, filenames[i].size());
-    position = sFileName.rfind(".");
-    sFileName = (std::string::npos == position) ? sFileName
-                                                : sFileName.substr(0, position);
-    std::string fname(params.output_dir + "/" + sFileName + ".bmp");
-
-    int err;
-    if (params.fmt == NVJPEG_OUTPUT_RGB || params.fmt == NVJPEG_OUTPUT_BGR) {
-      err = writeBMP(fname.c_str(), iout[i].channel[0], iout[i].pitch[0],
-                     iout[i].channel[1], iout[i].pitch[1], iout[i].channel[2],
-                     iout[i].pitch[2], widths[i], heights[i]);
-    } else if (params.fmt == NVJPEG_OUTPUT_RGBI ||
-               params.fmt == NVJPEG_OUTPUT_BGRI) {
-      // Write BMP from interleaved data
-      err = writeBMPi(fname.c_str(), iout[i].channel[0], iout[i].pitch[0],
-                      widths[i], heights[i]);
-    }
-    if (err) {
-      std::cout << "Cannot write output file: " << fname << std::endl;
+    std::string fname = ImageWriter::get_output_name(
+        params.output_dir, filenames[i], params.output_format);
+    // Only the device-to-host copy happens here; the writer threads encode
+    // and write the file
+    if (ImageWriter::write_image(writer, fname, params.output_format, iout[i],
+                                 params.fmt, widths[i], heights[i])) {
+      std::cout << "Cannot copy decoded image for output file: " << fname
+                << std::endl;
       return EXIT_FAILURE;
     }
-    std::cout << "Done writing decoded image to file: " << fname << std::endl;
   }
-  return EXIT_SUCCESS;
+  return writer.get_num_failed() > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 double process_images(FileNames &image_names, decode_params_t &params,
                       double &total) {
-  // vector for storing raw files and file lengths
-  FileData file_data(params.batch_size);
-  std::vector<size_t> file_len(params.batch_size);
-  FileNames current_names(params.batch_size);
   std::vector<int> widths(params.batch_size);
   std::vector<int> heights(params.batch_size);
-  // we wrap over image files to process total_images of files
-  FileNames::iterator file_iter = image_names.begin();
+  // Batch k + 1 is read while batch k decodes; the reader wraps over the
+  // image files to process total_images of files after the warmup batches.
+  // The last batch is padded with wrapped-around files, as before.
+  long num_batches = params.warmup + (params.total_images + params.batch_size - 1) /
+                                         params.batch_size;
+  BatchReader::Reader reader(image_names, params.batch_size, num_batches,
+                             params.reader_options);
 
   // stream for decoding
   CHECK_CUDA(
@@ -191,19 +175,21 @@ double process_images(FileNames &image_names, decode_params_t &params,
     }
   }
 
+  // Decoded images are written in the background, at most two batches behind
+  ImageWriter::AsyncWriter writer(params.writer_threads, 2 * params.batch_size);
+
   double test_time = 0;
   int warmup = 0;
   while (total_processed < params.total_images) {
-    if (read_next_batch(image_names, params.batch_size, file_iter, file_data,
-                        file_len, current_names))
-      return EXIT_FAILURE;
+    BatchReader::Batch *batch = reader.acquire();
+    if (batch == nullptr) return EXIT_FAILURE;
 
-    if (prepare_buffers(file_data, file_len, widths, heights, iout, isz,
-                        current_names, params))
+    if (prepare_buffers(batch->data, batch->len, widths, heights, iout, isz,
+                        batch->names, params))
       return EXIT_FAILURE;
 
     double time;
-    if (decode_images(file_data, file_len, iout, params, time))
+    if (decode_images(batch->data, batch->len, iout, params, time))
       return EXIT_FAILURE;
     if (warmup < params.warmup) {
       warmup++;
@@ -212,10 +198,19 @@ double process_images(FileNames &image_names, decode_params_t &params,
       test_time += time;
     }
 
-    if (params.write_decoded)
-      write_images(iout, widths, heights, params, current_names);
+    if (params.write_decoded &&
+        write_images(iout, widths, heights, params, batch->names, writer))
+      return EXIT_FAILURE;
+    reader.release(batch);
   }
+  writer.wait();
+  if (writer.get_num_failed() > 0) return EXIT_FAILURE;
   total = test_time;
+  std::cout << "Total time waiting for input: " << reader.get_wait_time()
+            << " (s), read " << reader.get_bytes_read() << " bytes with "
+            << params.reader_options.num_threads << " reader threads ("
+            << BatchReader::get_read_mode_name(params.reader_options.mode)
+            << ")" << std::endl;
 
   release_buffers(iout);
 
@@ -232,8 +227,11 @@ int main(int argc, const char *argv[]) {
       (pidx = findParamIndex(argv, argc, "--help")) != -1) {
     std::cout << "Usage: " << argv[0]
               << " -i images_dir [-b batch_size] [-t total_images] "
-                 "[-w warmup_iterations] [-o output_dir] "
-                 "[-pipelined] [-batched] [-fmt output_format]\n";
+                 "[-w warmup_iterations] [-o output_dir] [-out_fmt out_fmt] "
+                 "[-writer_threads writer_threads] "
+                 "[-pipelined] [-batched] [-fmt output_format] "
+                 "[-reader_threads reader_threads] "
+                 "[-prefetch_depth prefetch_depth] [-read_mode read_mode]\n";
     std::cout << "Parameters: " << std::endl;
     std::cout << "\timages_dir\t:\tPath to single image or directory of images"
               << std::endl;
@@ -249,13 +247,28 @@ int main(int argc, const char *argv[]) {
                  "without measuring performance"
               << std::endl;
     std::cout
-        << "\toutput_dir\t:\tWrite decoded images as BMPs to this directory"
+        << "\toutput_dir\t:\tWrite decoded images to this directory"
         << std::endl;
+    std::cout << "\tout_fmt\t\t:\tFile format of the decoded images. One of "
+                 "[bmp, ppm, png] (default bmp)"
+              << std::endl;
+    std::cout << "\twriter_threads\t:\tWrite decoded images with this many "
+                 "background threads, 0 writes them inline (default 4)"
+              << std::endl;
     std::cout << "\tpipelined\t:\tUse decoding in phases" << std::endl;
     std::cout << "\tbatched\t\t:\tUse batched interface" << std::endl;
     std::cout << "\toutput_format\t:\tnvJPEG output format for decoding. One "
                  "of [rgb, rgbi, bgr, bgri, yuv, y, unchanged]"
               << std::endl;
+    std::cout << "\treader_threads\t:\tRead input files with this many "
+                 "threads (default 4)"
+              << std::endl;
+    std::cout << "\tprefetch_depth\t:\tNumber of batches in flight, "
+                 "including the one being decoded (default 3)"
+              << std::endl;
+    std::cout << "\tread_mode\t:\tHow input files are read. One of [read, "
+                 "mmap, direct] (default read)"
+              << std::endl;
     return EXIT_SUCCESS;
   }
 
@@ -312,12 +325,25 @@ int main(int argc, const char *argv[]) {
     }
   }
 
+  params.output_format = ImageWriter::Format::kBMP;
+  if ((pidx = findParamIndex(argv, argc, "-out_fmt")) != -1) {
+    std::string sfmt = argv[pidx + 1];
+    if (!ImageWriter::parse_format(sfmt, params.output_format)) {
+      std::cout << "Unknown output file format: " << sfmt << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  params.writer_threads = 4;
+  if ((pidx = findParamIndex(argv, argc, "-writer_threads")) != -1) {
+    params.writer_threads = std::atoi(argv[pidx + 1]);
+  }
+
   params.write_decoded = false;
   if ((pidx = findParamIndex(argv, argc, "-o")) != -1) {
     params.output_dir = argv[pidx + 1];
-    if (params.fmt != NVJPEG_OUTPUT_RGB && params.fmt != NVJPEG_OUTPUT_BGR &&
-        params.fmt != NVJPEG_OUTPUT_RGBI && params.fmt != NVJPEG_OUTPUT_BGRI) {
-      std::cout << "We can write ony BMPs, which require output format be "
+    if (!ImageWriter::is_writable(params.fmt)) {
+      std::cout << "Writing decoded images requires output format be "
                    "either RGB/BGR or RGBi/BGRi"
                 << std::endl;
       return EXIT_FAILURE;
@@ -325,6 +351,27 @@ int main(int argc, const char *argv[]) {
     params.write_decoded = true;
   }
 
+  params.reader_options = BatchReader::get_default_options();
+  if ((pidx = findParamIndex(argv, argc, "-reader_threads")) != -1) {
+    params.reader_options.num_threads = std::atoi(argv[pidx + 1]);
+  }
+  if ((pidx = findParamIndex(argv, argc, "-prefetch_depth")) != -1) {
+    params.reader_options.depth = std::atoi(argv[pidx + 1]);
+  }
+  if (params.reader_options.num_threads < 1 ||
+      params.reader_options.depth < 1) {
+    std::cout << "reader_threads and prefetch_depth must be positive"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  if ((pidx = findParamIndex(argv, argc, "-read_mode")) != -1) {
+    std::string smode = argv[pidx + 1];
+    if (!BatchReader::parse_read_mode(smode, params.reader_options.mode)) {
+      std::cout << "Unknown read mode: " << smode << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
   nvjpegDevAllocator_t dev_allocator = {&dev_malloc, &dev_free};
   nvjpegPinnedAllocator_t pinned_allocator ={&host_malloc, &host_free};
 
@@ -0,0 +1,249 @@
+// Checks the prefetching reader of the batch decoder on files in a temporary
+// directory: batches come in list order through the ring for every read mode
+// and thread count, the input wraps around, the reader stops after the last
+// batch, and unreadable files are skipped.
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch_reader.h"
+#include "test_check.h"
+
+namespace {
+
+using BatchReader::ReadMode;
+
+std::string make_temp_dir() {
+  const char *tmpdir = getenv("TMPDIR");
+  std::string pattern =
+      std::string(tmpdir ? tmpdir : "/tmp") + "/batch_reader_test.XXXXXX";
+  std::vector<char> buffer(pattern.begin(), pattern.end());
+  buffer.push_back('\0');
+  return mkdtemp(buffer.data()) ? std::string(buffer.data()) : std::string();
+}
+
+void write_file(const std::string &path, const std::string &contents) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file) return;
+  if (!contents.empty()) fwrite(contents.data(), 1, contents.size(), file);
+  fclose(file);
+}
+
+// Files of a few bytes to a few pages, not multiples of the O_DIRECT block
+std::vector<std::string> make_files(const std::string &dir, int count,
+                                    std::map<std::string, std::string> &contents) {
+  std::vector<std::string> names;
+  for (int idx = 0; idx < count; idx++) {
+    std::string name = dir + "/image" + std::to_string(idx) + ".jpg";
+    std::string data = "image " + std::to_string(idx) + ":";
+    size_t size = 5 + idx * 3001;
+    for (size_t pos = data.size(); pos < size; pos++) {
+      data.push_back(static_cast<char>('a' + (pos * 7 + idx) % 26));
+    }
+    write_file(name, data);
+    contents[name] = data;
+    names.push_back(name);
+  }
+  return names;
+}
+
+bool batch_matches(const BatchReader::Batch &batch, int batch_size,
+                   const std::map<std::string, std::string> &contents) {
+  for (int slot = 0; slot < batch_size; slot++) {
+    auto it = contents.find(batch.names[slot]);
+    if (it == contents.end() || batch.len[slot] != it->second.size() ||
+        std::string(reinterpret_cast<const char *>(batch.data[slot]),
+                    batch.len[slot]) != it->second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void test_order(const std::vector<std::string> &names,
+                const std::map<std::string, std::string> &contents,
+                ReadMode mode, int num_threads, int depth, int batch_size,
+                long num_batches) {
+  BatchReader::Options options;
+  options.num_threads = num_threads;
+  options.depth = depth;
+  options.mode = mode;
+  BatchReader::Reader reader(names, batch_size, num_batches, options);
+  std::vector<BatchReader::Batch *> seen;
+  size_t bytes = 0;
+  for (long idx = 0; idx < num_batches; idx++) {
+    BatchReader::Batch *batch = reader.acquire();
+    CHECK(batch != nullptr);
+    if (!batch) return;
+    CHECK(batch->index == idx);
+    // Claim c reads file c of the cyclic list
+    bool in_order = true;
+    for (int slot = 0; slot < batch_size; slot++) {
+      size_t claim = size_t(idx) * batch_size + slot;
+      in_order &= batch->names[slot] == names[claim % names.size()];
+      bytes += batch->len[slot];
+    }
+    CHECK(in_order);
+    // The readers fill the rest of the ring meanwhile, but not this batch
+    if (idx % 3 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    CHECK(batch_matches(*batch, batch_size, contents));
+    seen.push_back(batch);
+    reader.release(batch);
+  }
+  // Batches go round the ring of depth entries
+  for (size_t idx = 0; idx < seen.size(); idx++) {
+    if (idx >= size_t(depth)) CHECK(seen[idx] == seen[idx - depth]);
+    for (size_t other = 1; other < size_t(depth) && other <= idx; other++) {
+      CHECK(seen[idx] != seen[idx - other]);
+    }
+  }
+  CHECK(reader.acquire() == nullptr);
+  CHECK(reader.acquire() == nullptr);
+  CHECK(reader.get_bytes_read() == bytes);
+  CHECK(reader.get_wait_time() >= 0.0);
+}
+
+void test_unreadable(const std::string &dir,
+                     std::map<std::string, std::string> contents) {
+  CHECK(mkdir(dir.c_str(), 0700) == 0);
+  std::vector<std::string> good = make_files(dir, 3, contents);
+  const std::string empty = dir + "/empty.jpg";
+  write_file(empty, "");
+  const std::string missing = dir + "/missing.jpg";
+  // Missing file, empty file and directory between the readable files
+  std::vector<std::string> names = {missing, good[0], empty, good[1],
+                                    dir,     good[2]};
+
+  for (ReadMode mode : {ReadMode::kRead, ReadMode::kMmap, ReadMode::kDirect}) {
+    for (int num_threads : {1, 4}) {
+      BatchReader::Options options = BatchReader::get_default_options();
+      options.mode = mode;
+      options.num_threads = num_threads;
+      const int batch_size = 4;
+      const long num_batches = 5;
+      BatchReader::Reader reader(names, batch_size, num_batches, options);
+      std::vector<std::string> order;
+      for (long idx = 0; idx < num_batches; idx++) {
+        BatchReader::Batch *batch = reader.acquire();
+        CHECK(batch != nullptr);
+        if (!batch) break;
+        CHECK(batch_matches(*batch, batch_size, contents));
+        order.insert(order.end(), batch->names.begin(), batch->names.end());
+        reader.release(batch);
+      }
+      CHECK(reader.acquire() == nullptr);
+      // Which slot takes the place of a bad file depends on the scheduling
+      // of the readers, but every slot holds a readable file
+      std::set<std::string> readable(good.begin(), good.end());
+      bool all_readable = order.size() == size_t(batch_size * num_batches);
+      for (const std::string &name : order) all_readable &= readable.count(name) > 0;
+      CHECK(all_readable);
+      if (num_threads == 1) {
+        bool cyclic = true;
+        for (size_t idx = 0; idx < order.size(); idx++) {
+          cyclic &= order[idx] == good[idx % good.size()];
+        }
+        CHECK(cyclic);
+      }
+    }
+  }
+
+  // Nothing readable: acquire gives up instead of blocking
+  std::vector<std::string> bad = {missing, empty, dir};
+  BatchReader::Reader reader(bad, 2, 10, BatchReader::get_default_options());
+  CHECK(reader.acquire() == nullptr);
+}
+
+void test_api(const std::vector<std::string> &names) {
+  // Releasing out of order is an error, and leaves the ring unchanged
+  BatchReader::Options options = BatchReader::get_default_options();
+  options.depth = 3;
+  BatchReader::Reader reader(names, 2, 4, options);
+  BatchReader::Batch *first = reader.acquire();
+  BatchReader::Batch *second = reader.acquire();
+  CHECK(first != nullptr && second != nullptr && first != second);
+  bool thrown = false;
+  try {
+    reader.release(second);
+  } catch (const std::logic_error &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  if (first) reader.release(first);
+  if (second) reader.release(second);
+  for (long idx = 2; idx < 4; idx++) {
+    BatchReader::Batch *batch = reader.acquire();
+    CHECK(batch != nullptr && batch->index == idx);
+    if (batch) reader.release(batch);
+  }
+  CHECK(reader.acquire() == nullptr);
+
+  // No batches at all
+  BatchReader::Reader none(names, 2, 0, options);
+  CHECK(none.acquire() == nullptr);
+
+  for (int bad_field = 0; bad_field < 3; bad_field++) {
+    BatchReader::Options invalid = BatchReader::get_default_options();
+    int batch_size = 2;
+    if (bad_field == 0) batch_size = 0;
+    if (bad_field == 1) invalid.num_threads = 0;
+    if (bad_field == 2) invalid.depth = 0;
+    thrown = false;
+    try {
+      BatchReader::Reader rejected(names, batch_size, 1, invalid);
+    } catch (const std::invalid_argument &) {
+      thrown = true;
+    }
+    CHECK(thrown);
+  }
+
+  for (ReadMode mode : {ReadMode::kRead, ReadMode::kMmap, ReadMode::kDirect}) {
+    ReadMode parsed = ReadMode::kRead;
+    CHECK(BatchReader::parse_read_mode(BatchReader::get_read_mode_name(mode),
+                                       parsed));
+    CHECK(parsed == mode);
+  }
+  ReadMode parsed = ReadMode::kMmap;
+  CHECK(!BatchReader::parse_read_mode("aio", parsed));
+  CHECK(parsed == ReadMode::kMmap);
+}
+
+}  // namespace
+
+int main() {
+  std::string dir = make_temp_dir();
+  CHECK(!dir.empty());
+  if (dir.empty()) return test_result("batch_reader_test");
+
+  std::map<std::string, std::string> contents;
+  std::vector<std::string> names = make_files(dir, 7, contents);
+  for (ReadMode mode : {ReadMode::kRead, ReadMode::kMmap, ReadMode::kDirect}) {
+    for (int num_threads : {1, 3, 8}) {
+      // Batches that do and do not divide the list, the ring shallower and
+      // deeper than the batch count, and a single-entry ring
+      test_order(names, contents, mode, num_threads, 3, 4, 20);
+      test_order(names, contents, mode, num_threads, 2, 7, 5);
+      test_order(names, contents, mode, num_threads, 1, 3, 6);
+      test_order(names, contents, mode, num_threads, 8, 5, 3);
+    }
+  }
+  // Many readers racing for the claims, repeatedly
+  for (int run = 0; run < 100; run++) {
+    test_order(names, contents, ReadMode::kRead, 8, 4, 2, 30);
+  }
+  test_unreadable(dir + "/unreadable", contents);
+  test_api(names);
+
+  std::string command = "rm -rf '" + dir + "'";
+  CHECK(system(command.c_str()) == 0);
+  return test_result("batch_reader_test");
+}
@@ -30,265 +30,107 @@
 #include <cmath>
 #include <sstream>
 
-struct bmpHeader
-{
-    char signature[2];
-    uint32_t file_size;
-    uint32_t reserved;
-    uint32_t dataOffset;
-};
-struct bmpInfoHeader
-{
-    uint32_t Size;
-    uint32_t Width;
-    uint32_t Height;
-    uint16_t Planes;
-    uint16_t BitsPerPixel;
-    uint32_t Compression;
-    uint32_t ImageSize;
-    uint32_t XPixelsPerM;
-    uint32_t YPixelsPerM;
-    uint32_t ColorsUsed;
-    uint32_t ImportantColors;
-};
-
-int read_bmp_info_header(std::ifstream& file_input, bmpInfoHeader& info_header)
+// Allocates image for the components of layout and de-interleaves them into its host buffers
+int read_interleaved(const Ingest::Interleaved& layout, nvjpeg2kColorSpace_t color_space, Image& image,
+    encode_params_t& params)
 {
-    file_input.read(reinterpret_cast<char*>(&info_header.Size), 4);
-    if( info_header.Size != 40 )
+    nvjpeg2kImageInfo_t nvjpeg2k_info;
+    std::vector<nvjpeg2kImageComponentInfo_t> nvjpeg2k_comp_info;
+
+    nvjpeg2k_info.num_components = layout.num_components;
+    nvjpeg2k_info.image_width = layout.width;
+    nvjpeg2k_info.image_height = layout.height;
+    nvjpeg2k_comp_info.resize(nvjpeg2k_info.num_components);
+
+    for(auto& comp : nvjpeg2k_comp_info)
     {
-        std::cout<<"bmp file not supported"<<std::endl;
-        return EXIT_FAILURE;
+        comp.component_width  = nvjpeg2k_info.image_width;
+        comp.component_height = nvjpeg2k_info.image_height;
+        comp.precision        = static_cast<uint8_t>(layout.precision);
+        comp.sgn              = 0;
     }
-    file_input.read(reinterpret_cast<char*>(&info_header.Width), 4);
-    file_input.read(reinterpret_cast<char*>(&info_header.Height), 4);
-    file_input.read(reinterpret_cast<char*>(&info_header.Planes), 2);
-    file_input.read(reinterpret_cast<char*>(&info_header.BitsPerPixel), 2);
-    file_input.read(reinterpret_cast<char*>(&info_header.Compression), 4);
 
-    if( info_header.Compression != 0 )
+    if(image.initialize(nvjpeg2k_info, nvjpeg2k_comp_info.data(), color_space))
     {
-        std::cout<<"only raw bmp files are supported"<<std::endl;
         return EXIT_FAILURE;
     }
-    file_input.read(reinterpret_cast<char*>(&info_header.ImageSize), 4);
-    file_input.read(reinterpret_cast<char*>(&info_header.XPixelsPerM), 4);
-    file_input.read(reinterpret_cast<char*>(&info_header.YPixelsPerM), 4);
-    file_input.read(reinterpret_cast<char*>(&info_header.ColorsUsed), 4);
-    file_input.read(reinterpret_cast<char*>(&info_header.ImportantColors), 4);
-
+    auto& img = image.getImageHost();
+    unsigned char* planes[MAX_COMPONENTS];
+    for(uint32_t c = 0; c < layout.num_components; c++)
+    {
+        planes[c] = reinterpret_cast<unsigned char*>(img.pixel_data[c]);
+    }
+    Ingest::deinterleave(layout, planes, img.pitch_in_bytes, params.ingest_pool.get());
     return EXIT_SUCCESS;
 }
 
-int read_bmp(std::ifstream& file_input, Image& image)
+int read_bmp(const Ingest::MappedFile& file, Image& image, encode_params_t& params)
 {
-    bmpHeader bmp_header;
-    bmpInfoHeader bmp_info_header;
-    nvjpeg2kImageInfo_t nvjpeg2k_info;
-    std::vector<nvjpeg2kImageComponentInfo_t> nvjpeg2k_comp_info;
-    
-    file_input.read(bmp_header.signature, 2);
-    if(bmp_header.signature[0] != 'B'|| bmp_header.signature[1]!= 'M')
+    Ingest::Interleaved layout;
+    std::string error;
+    if(!Ingest::parse_bmp(file.data(), file.size(), layout, error))
     {
-        std::cout<<"not a bmp file"<<std::endl;
+        std::cout<<error<<std::endl;
         return EXIT_FAILURE;
     }
-    file_input.read(reinterpret_cast<char*>(&bmp_header.file_size), 4);
-    file_input.read(reinterpret_cast<char*>(&bmp_header.reserved), 4);
-    file_input.read(reinterpret_cast<char*>(&bmp_header.dataOffset), 4);
-    if(read_bmp_info_header(file_input, bmp_info_header))
+    return read_interleaved(layout, NVJPEG2K_COLORSPACE_SRGB, image, params);
+}
+
+int read_yuv(const Ingest::MappedFile& file, Image& image, encode_params_t& params)
+{
+    if(params.img_info.num_components > MAX_COMPONENTS)
     {
+        std::cout<<"Max components cannot exceed "<<MAX_COMPONENTS<<std::endl;
         return EXIT_FAILURE;
     }
-    // bmp file data is 32 bit aligned
-    size_t stride = (bmp_info_header.Width * bmp_info_header.BitsPerPixel + 31)/32  * 4;
-
-    nvjpeg2kColorSpace_t color_space = NVJPEG2K_COLORSPACE_SRGB;
-    nvjpeg2k_info.num_components = 3;
-    nvjpeg2k_info.image_width = bmp_info_header.Width;
-    nvjpeg2k_info.image_height = bmp_info_header.Height;
-    nvjpeg2k_comp_info.resize(nvjpeg2k_info.num_components);
-    
-    for(auto& comp : nvjpeg2k_comp_info)
+    if(image.initialize(params.img_info, params.comp_info, NVJPEG2K_COLORSPACE_SYCC))
     {
-        comp.component_width  = nvjpeg2k_info.image_width;
-        comp.component_height = nvjpeg2k_info.image_height;
-        comp.precision        = 8;
-        comp.sgn              = 0;
-    } 
-    
-    image.initialize(nvjpeg2k_info, nvjpeg2k_comp_info.data(), color_space);
-    std::vector<uint8_t> raw_bmp;
-    raw_bmp.resize(stride * bmp_info_header.Height);
-    file_input.read(reinterpret_cast<char*>(raw_bmp.data()), stride * bmp_info_header.Height);
-    
-    auto& img = image.getImageHost();
-    unsigned char*  r = reinterpret_cast<unsigned char*>(img.pixel_data[0]);
-    unsigned char*  g = reinterpret_cast<unsigned char*>(img.pixel_data[1]);
-    unsigned char*  b = reinterpret_cast<unsigned char*>(img.pixel_data[2]);
-    
-    uint32_t y_bmp = nvjpeg2k_info.image_height;
-    for (uint32_t y = 0; y < nvjpeg2k_info.image_height; y++) 
-    {
-        y_bmp--; 
-        for (uint32_t x = 0; x < nvjpeg2k_info.image_width; x++) 
-        {
-            r[y * img.pitch_in_bytes[0] + x] = raw_bmp[y_bmp * stride + (3 * x + 2)];
-            g[y * img.pitch_in_bytes[1] + x] = raw_bmp[y_bmp * stride + (3 * x + 1)];
-            b[y * img.pitch_in_bytes[2] + x] = raw_bmp[y_bmp * stride + (3 * x + 0)];
-        }
+        return EXIT_FAILURE;
     }
-    return EXIT_SUCCESS;
-}
-
-int read_yuv(std::ifstream& file_input, Image& image, encode_params_t& params)
-{
-    image.initialize(params.img_info, params.comp_info, NVJPEG2K_COLORSPACE_SYCC);
 
     auto& nvjpeg2k_img = image.getImageHost();
+    unsigned char* planes[MAX_COMPONENTS];
+    size_t row_bytes[MAX_COMPONENTS];
+    uint32_t heights[MAX_COMPONENTS];
     size_t total_bytes = 0;
     for(uint32_t c = 0; c < nvjpeg2k_img.num_components;c++)
     {
-        char* buff = (char*)nvjpeg2k_img.pixel_data[c];
-        for(uint32_t y = 0; y < params.comp_info[c].component_height; y++)
-        {
-            uint32_t bytes_to_read =  params.comp_info[c].component_width * ((params.comp_info[c].precision +7)/8);
-            total_bytes += bytes_to_read;
-            if(nvjpeg2k_img.pitch_in_bytes[c] != bytes_to_read)
-            {
-                std::cout<<"\n fail";
-            }
-            if( !file_input.read(buff, bytes_to_read))
-            {
-                std::cout<<"failed to read image from file"<<std::endl;
-                return EXIT_FAILURE;
-            }
-            buff += nvjpeg2k_img.pitch_in_bytes[c];
-        }
+        planes[c] = reinterpret_cast<unsigned char*>(nvjpeg2k_img.pixel_data[c]);
+        row_bytes[c] = params.comp_info[c].component_width * ((params.comp_info[c].precision +7)/8);
+        heights[c] = params.comp_info[c].component_height;
+        total_bytes += row_bytes[c] * heights[c];
+    }
+    if(file.size() < total_bytes)
+    {
+        std::cout<<"failed to read image from file"<<std::endl;
+        return EXIT_FAILURE;
     }
-    char extra;
-    if(file_input.read(&extra,1))
+    Ingest::copy_planes(file.data(), nvjpeg2k_img.num_components, row_bytes, heights, planes,
+        nvjpeg2k_img.pitch_in_bytes, params.ingest_pool.get());
+    if(file.size() > total_bytes)
     {
         std::cout<<"WARNING - failed to read the entire file"<<std::endl;
     }
-    
+
     return EXIT_SUCCESS;
 }
 
-int read_pnm(std::ifstream&  file_input, Image& image)
+int read_pnm(const Ingest::MappedFile& file, Image& image, encode_params_t& params)
 {
-    nvjpeg2kColorSpace_t color_space;
-    std::string line;
-    std::getline(file_input, line, '\n');
-    
-    nvjpeg2kImageInfo_t info;
-    if( line == "P5")
-    {
-        info.num_components = 1;
-        color_space = NVJPEG2K_COLORSPACE_GRAY;
-    }
-    else if( line == "P6")
+    Ingest::Interleaved layout;
+    std::string error;
+    if(!Ingest::parse_pnm(file.data(), file.size(), layout, error))
     {
-        info.num_components = 3;
-        color_space = NVJPEG2K_COLORSPACE_SRGB;
-    }
-    else 
-    {
-        std::cout<<"pgm/ppm format not supported"<<std::endl;
+        std::cout<<error<<std::endl;
         return EXIT_FAILURE;
     }
-    
-    std::vector<nvjpeg2kImageComponentInfo_t> comp_info(info.num_components);
-    int idx = 0;
-    uint32_t max_val = 0;
-    while(std::getline(file_input, line, '\n'))
-    {
-        if(line[0] == '#')
-        {
-            continue;
-        }
-        else if(idx == 0)
-        {
-            size_t pos = line.find(" ");
-            if (pos != std::string::npos)
-            {
-                info.image_width =  stoi(line.substr(0, pos));
-                info.image_height = stoi(line.substr(pos, line.length()));
-            }
-            else
-            {
-                std::cout<<"\nInvalid pnm file"<<std::endl;
-                return EXIT_FAILURE;
-            }
-            idx++;
-        }
-        else if(idx == 1)
-        {
-            max_val = stoi(line);
-            if(max_val > ((1<<16) - 1))
-            {
-                std::cout<<"\nInvalid pgm prec value in pgm file"<<std::endl;
-                return EXIT_FAILURE;
-            }
-            break;
-        }
-        else
-        {
-            std::cout<<"failed to read pgm file"<<std::endl;
-            return EXIT_FAILURE;
-        }
-    }
-    for(auto& comp : comp_info)
-    {
-        comp.component_width  = info.image_width;
-        comp.component_height = info.image_height;
-        comp.precision =  static_cast<uint8_t>(log2(max_val + 1));
-        comp.sgn = 0;
-    }
-    
-    image.initialize(info, comp_info.data(), color_space);
-    auto& img = image.getImageHost();
-    {
-        if(img.pixel_type == NVJPEG2K_UINT16)
-        {
-            std::vector<uint16_t> temp_buffer(info.image_width * info.num_components);
-            for(uint32_t y = 0; y < info.image_height;y++)
-            {
-                file_input.read((char*)temp_buffer.data(), info.image_width * info.num_components * sizeof(uint16_t));
-                for(uint32_t x = 0; x < info.image_width; x++)
-                {
-                    for(uint32_t c = 0; c <info.num_components; c++)
-                    { 
-                        uint16_t* pix = reinterpret_cast<uint16_t*>(img.pixel_data[c]);
-                        uint16_t value = temp_buffer[info.num_components * x + c];
-                        pix[y * (img.pitch_in_bytes[0]/sizeof(uint16_t))+ x] = (value&0xff)<<8|value>>8;
-                    }
-                }
-            }
-        }
-        else
-        {
-            std::vector<uint8_t> temp_buffer(info.image_width * info.num_components);
-            for(uint32_t y = 0; y < info.image_height;y++)
-            {
-                file_input.read((char*)temp_buffer.data(), info.image_width * info.num_components);
-                for(uint32_t x = 0; x < info.image_width; x++)
-                {
-                    for(uint32_t c = 0; c <info.num_components; c++)
-                    {
-                        uint8_t* pix = reinterpret_cast<uint8_t*>(img.pixel_data[c]);
-                        pix[y * img.pitch_in_bytes[0]+ x] = temp_buffer[info.num_components*x + c];
-                    }
-                }
-            }
-        }
-    }   
-    char extra;
-    if(file_input.read(&extra,1))
+    if(layout.data + layout.stride * layout.height != file.data() + file.size())
     {
         std::cout<<"WARNING - failed to read the entire file"<<std::endl;
     }
-    return EXIT_SUCCESS;
+    nvjpeg2kColorSpace_t color_space =
+        layout.num_components == 1 ? NVJPEG2K_COLORSPACE_GRAY : NVJPEG2K_COLORSPACE_SRGB;
+    return read_interleaved(layout, color_space, image, params);
 }
 
 
@@ -314,9 +156,10 @@ int read_next_batch(FileNames &image_names, int batch_size,
             return EXIT_FAILURE;
         }
         std::string ext = cur_iter->substr(cur_iter->find_last_of(".") + 1);
-        std::ifstream image_file(cur_iter->c_str(), std::ios::in | std::ios::binary);
+        double start = Wtime();
+        Ingest::MappedFile image_file;
 
-        if (!(image_file.is_open()))
+        if (!image_file.open(*cur_iter))
         {
             std::cerr << "Cannot open image: " << *cur_iter
                       << ", removing it from image list" << std::endl;
@@ -324,16 +167,16 @@ int read_next_batch(FileNames &image_names, int batch_size,
             continue;
         }
 
-        if(ext == "pgm" || ext == "ppm")
+        if(ext == "pgm" || ext == "ppm" || ext == "pam")
         {
-            if(read_pnm(image_file, input_images[counter]))
+            if(read_pnm(image_file, input_images[counter], params))
             {
                 return EXIT_FAILURE;
             }
         }
         else if(ext == "bmp")
         {
-            if(read_bmp(image_file, input_images[counter]))
+            if(read_bmp(image_file, input_images[counter], params))
             {
                 return EXIT_FAILURE;
             }
@@ -345,23 +188,27 @@ int read_next_batch(FileNames &image_names, int batch_size,
                 std::cout << "For yuv files, pease provide -img_fmt width,height,num_comp,precision,chroma subsampling"<<std::endl;
                 return EXIT_FAILURE;
             }
-            read_yuv(image_file, input_images[counter], params);
+            if(read_yuv(image_file, input_images[counter], params))
+            {
+                return EXIT_FAILURE;
+            }
         }
         else
         {
             std::cerr << "Cannot encode image: " << *cur_iter
                       << ", removing it from image list" << std::endl;
-            image_file.close();
             image_names.erase(cur_iter);
             continue;
         }
+        image_file.close();
+        params.ingest_time += Wtime() - start;
+        params.ingest_images++;
         current_names[counter] = *cur_iter;
 
         input_images[counter].copyToDevice();
 
         counter++;
         cur_iter++;
-        image_file.close();
     }
     return EXIT_SUCCESS;
 }
@@ -643,7 +490,7 @@ int main(int argc, const char *argv[])
         std::cout << "Usage: " << argv[0]
                   << " -i images_dir [-b batch_size] [-t total_images] "
                   << "[-I] [-cblk cblk_w,cblk_h]"<<std::endl
-                  << "\t[-w warmup_iterations] [-o output_dir] "<<std::endl
+                  << "\t[-w warmup_iterations] [-o output_dir] [-ingest_threads num_threads]"<<std::endl
                   << "\t[-img_fmt img_w,img_h,num_comp,precision,chromaformat]"
                   << " (-img_fmt is mandatory for raw yuv files)"<<std::endl
                   << "\teg: for an 8 bit image of size 1920x1080 with 420 subsamling: "
@@ -669,6 +516,10 @@ int main(int argc, const char *argv[])
         std::cout
             << "\toutput_dir\t:\tWrite compressed jpeg 2000 files  to this directory"
             << std::endl;
+        std::cout << "\tnum_threads\t:\tThreads converting the input pixels to planar "
+                     "components,\n"
+                  << "\t\t\t\tall hardware threads by default"
+                  << std::endl;
         return EXIT_SUCCESS;
     }
 
@@ -745,6 +596,23 @@ int main(int argc, const char *argv[])
     }
 
 
+    int ingest_threads = std::max(1u, std::thread::hardware_concurrency());
+    if ((pidx = findParamIndex(argv, argc, "-ingest_threads")) != -1)
+    {
+        ingest_threads = std::atoi(argv[pidx + 1]);
+        if (ingest_threads <= 0)
+        {
+            std::cout<<"Invalid number of ingest threads"<<std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (ingest_threads > 1)
+    {
+        params.ingest_pool.reset(new ThreadPool(ingest_threads));
+    }
+    params.ingest_time = 0;
+    params.ingest_images = 0;
+
     CHECK_NVJPEG2K(nvjpeg2kEncoderCreateSimple(&params.enc_handle));
     CHECK_NVJPEG2K(nvjpeg2kEncodeStateCreate(params.enc_handle, &params.enc_state));
     CHECK_NVJPEG2K(nvjpeg2kEncodeParamsCreate(&params.enc_params));
@@ -783,6 +651,11 @@ int main(int argc, const char *argv[])
               << total / ((params.total_images + params.batch_size - 1) /
                           params.batch_size)
               << std::endl;
+    if (params.ingest_images > 0)
+    {
+        std::cout << "Avg ingest time per image (read and convert to planar): "
+                  << params.ingest_time / params.ingest_images << std::endl;
+    }
 
     CHECK_NVJPEG2K(nvjpeg2kEncodeParamsDestroy(params.enc_params));
     CHECK_NVJPEG2K(nvjpeg2kEncodeStateDestroy(params.enc_state));
@@ -52,6 +52,11 @@ namespace fs = std::experimental::filesystem::v1;
 #include <cuda_runtime_api.h>
 #include <nvjpeg2k.h>
 
+#include <memory>
+#include <thread>
+
+#include "nvjpeg2k_ingest.h"
+
 #define CHECK_CUDA(call)                                                                                          \
     {                                                                                                             \
         cudaError_t _e = (call);                                                                                  \
@@ -275,6 +280,9 @@ struct encode_params_t
     std::string output_dir;
     bool write_bitstream;
     bool img_fmt_init;
+    std::unique_ptr<ThreadPool> ingest_pool; // converts input rows in parallel, null for a single thread
+    double ingest_time;
+    int ingest_images;
 };
 
 double Wtime(void)
@@ -0,0 +1,554 @@
+#pragma once
+// Input file ingest of the JPEG 2000 encoder sample. Host-only, no CUDA or
+// nvJPEG2000 dependency.
+//
+// MappedFile maps an input file read-only (POSIX; a plain read into an owned
+// buffer elsewhere). parse_bmp() and parse_pnm() describe the pixels inside
+// the mapping as an Interleaved layout, and deinterleave() writes them
+// straight into the planar component buffers of the encoder, splitting the
+// rows across a ThreadPool.
+//
+// Each component of a block of 16 (8-bit) or 8 (16-bit) pixels is gathered
+// from the channels * 16 bytes of the block with byte shuffles: pshufb on
+// SSSE3, and two blocks per vpshufb on AVX2, picked at run time; other CPUs
+// and compilers take the scalar path. Bottom-up rows (BMP) are handled by the
+// row addressing and big-endian samples (16-bit PNM) by the shuffle masks, so
+// neither costs a separate pass.
+#include <utils/thread_pool.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN64
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INGEST_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace Ingest {
+constexpr uint32_t kMaxChannels = 4;
+
+// Read-only view of a whole input file
+class MappedFile {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() { close(); }
+
+  // Returns false if the file cannot be opened, is empty or is not regular
+  bool open(const std::string &name) {
+    close();
+#ifdef _WIN64
+    std::ifstream input(name, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!input.is_open()) return false;
+    std::streamsize file_size = input.tellg();
+    if (file_size <= 0) return false;
+    buffer_.resize(file_size);
+    input.seekg(0);
+    if (!input.read(reinterpret_cast<char *>(buffer_.data()), file_size)) {
+      return false;
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+#else
+    int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0) {
+      ::close(fd);
+      return false;
+    }
+    size_t file_size = info.st_size;
+    void *mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+    // The pixels are read once, front to back
+    madvise(mapping, file_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+    data_ = static_cast<const unsigned char *>(mapping);
+    size_ = file_size;
+    return true;
+#endif
+  }
+
+  void close() {
+#ifndef _WIN64
+    if (data_) munmap(const_cast<unsigned char *>(data_), size_);
+#endif
+    buffer_.clear();
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  const unsigned char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const unsigned char *data_ = nullptr;
+  size_t size_ = 0;
+  std::vector<unsigned char> buffer_;
+};
+
+// Interleaved pixels of a parsed file. Component c of the output is sample
+// channel_of[c] of every pixel.
+struct Interleaved {
+  const unsigned char *data;  // first stored row
+  uint32_t width;
+  uint32_t height;
+  uint32_t channels;          // samples per pixel, 1 to kMaxChannels
+  uint32_t bytes_per_sample;  // 1 or 2
+  size_t stride;              // bytes between stored rows
+  bool bottom_up;             // stored rows run from the last image row up
+  bool big_endian;            // byte order of 2-byte samples
+  uint32_t num_components;
+  uint32_t channel_of[kMaxChannels];
+  uint32_t precision;         // bits per sample, as encoded
+};
+
+namespace Kernel {
+inline uint32_t read_le32(const unsigned char *bytes) {
+  return bytes[0] | bytes[1] << 8 | bytes[2] << 16 |
+         static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+inline uint16_t read_le16(const unsigned char *bytes) {
+  return static_cast<uint16_t>(bytes[0] | bytes[1] << 8);
+}
+
+// Tokenizer of the PNM headers: whitespace separated, '#' comments to the
+// end of the line
+class PnmHeader {
+ public:
+  PnmHeader(const unsigned char *data, size_t size)
+      : data_(data), size_(size) {}
+
+  bool token(std::string &str) {
+    str.clear();
+    for (;;) {
+      while (pos_ < size_ && isspace(data_[pos_])) pos_++;
+      if (pos_ < size_ && data_[pos_] == '#') {
+        while (pos_ < size_ && data_[pos_] != '\n') pos_++;
+        continue;
+      }
+      break;
+    }
+    while (pos_ < size_ && !isspace(data_[pos_])) str += data_[pos_++];
+    return !str.empty();
+  }
+
+  bool number(uint32_t &value) {
+    std::string str;
+    if (!token(str) || str.size() > 9 ||
+        str.find_first_not_of("0123456789") != std::string::npos) {
+      return false;
+    }
+    value = static_cast<uint32_t>(std::stoul(str));
+    return true;
+  }
+
+  // Skips the single whitespace character that ends a header
+  bool end() {
+    if (pos_ >= size_ || !isspace(data_[pos_])) return false;
+    pos_++;
+    return true;
+  }
+
+  size_t pos() const { return pos_; }
+
+ private:
+  static bool isspace(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' ||
+           c == '\f';
+  }
+
+  const unsigned char *data_;
+  size_t size_;
+  size_t pos_ = 0;
+};
+
+inline uint32_t get_precision(uint32_t max_val) {
+  uint32_t precision = 0;
+  while (precision < 16 && (1u << precision) <= max_val) precision++;
+  return precision;
+}
+
+// Byte shuffles gathering component c of a block from load k of the block:
+// masks[c][k][j] is the offset in load k of byte j of the component, or 0x80
+// when that byte comes from another load
+struct Masks {
+  alignas(16) uint8_t bytes[kMaxChannels][kMaxChannels][16];
+};
+
+inline void make_masks(const Interleaved &layout, Masks &masks) {
+  const uint32_t channels = layout.channels, width = layout.bytes_per_sample;
+  for (uint32_t c = 0; c < layout.num_components; c++) {
+    for (uint32_t k = 0; k < channels; k++) {
+      for (uint32_t j = 0; j < 16; j++) {
+        uint32_t byte = j % width;
+        if (layout.big_endian && width == 2) byte = 1 - byte;
+        uint32_t offset =
+            (j / width * channels + layout.channel_of[c]) * width + byte;
+        masks.bytes[c][k][j] =
+            offset / 16 == k ? static_cast<uint8_t>(offset % 16) : 0x80;
+      }
+    }
+  }
+}
+
+// Pixels [first, width) of a row, one sample at a time
+inline void deinterleave_row_scalar(const Interleaved &layout,
+                                    const unsigned char *src,
+                                    unsigned char *const *dst, uint32_t first) {
+  const uint32_t channels = layout.channels;
+  if (layout.bytes_per_sample == 1) {
+    for (uint32_t c = 0; c < layout.num_components; c++) {
+      const unsigned char *in = src + layout.channel_of[c];
+      unsigned char *out = dst[c];
+      for (uint32_t x = first; x < layout.width; x++) {
+        out[x] = in[x * channels];
+      }
+    }
+    return;
+  }
+  for (uint32_t c = 0; c < layout.num_components; c++) {
+    const unsigned char *in = src + 2 * layout.channel_of[c];
+    unsigned char *out = dst[c];
+    const uint32_t hi = layout.big_endian ? 0 : 1;
+    for (uint32_t x = first; x < layout.width; x++) {
+      out[2 * x] = in[2 * x * channels + (1 - hi)];
+      out[2 * x + 1] = in[2 * x * channels + hi];
+    }
+  }
+}
+
+#if defined(INGEST_X86_SIMD)
+// Returns the number of pixels converted, a multiple of the block size
+template <uint32_t kChannels>
+__attribute__((target("ssse3"))) uint32_t deinterleave_row_ssse3(
+    const Interleaved &layout, const Masks &masks, const unsigned char *src,
+    unsigned char *const *dst) {
+  const uint32_t block_pixels = 16 / layout.bytes_per_sample;
+  const uint32_t blocks = layout.width / block_pixels;
+  for (uint32_t b = 0; b < blocks; b++) {
+    const unsigned char *in = src + static_cast<size_t>(b) * 16 * kChannels;
+    __m128i loads[kChannels];
+    for (uint32_t k = 0; k < kChannels; k++) {
+      loads[k] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 16 * k));
+    }
+    for (uint32_t c = 0; c < layout.num_components; c++) {
+      __m128i out = _mm_shuffle_epi8(
+          loads[0], _mm_load_si128(reinterpret_cast<const __m128i *>(
+                        masks.bytes[c][0])));
+      for (uint32_t k = 1; k < kChannels; k++) {
+        out = _mm_or_si128(
+            out, _mm_shuffle_epi8(
+                     loads[k], _mm_load_si128(reinterpret_cast<const __m128i *>(
+                                   masks.bytes[c][k]))));
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst[c] + 16 * b), out);
+    }
+  }
+  return blocks * block_pixels;
+}
+
+// Two blocks per iteration, one in each 128-bit lane, as vpshufb does not
+// cross lanes
+template <uint32_t kChannels>
+__attribute__((target("avx2"))) uint32_t deinterleave_row_avx2(
+    const Interleaved &layout, const Masks &masks, const unsigned char *src,
+    unsigned char *const *dst) {
+  const uint32_t block_pixels = 16 / layout.bytes_per_sample;
+  const uint32_t pairs = layout.width / block_pixels / 2;
+  __m256i lane_masks[kMaxChannels][kChannels];
+  for (uint32_t c = 0; c < layout.num_components; c++) {
+    for (uint32_t k = 0; k < kChannels; k++) {
+      lane_masks[c][k] = _mm256_broadcastsi128_si256(
+          _mm_load_si128(reinterpret_cast<const __m128i *>(masks.bytes[c][k])));
+    }
+  }
+  for (uint32_t b = 0; b < pairs; b++) {
+    const unsigned char *in = src + static_cast<size_t>(b) * 32 * kChannels;
+    __m256i loads[kChannels];
+    for (uint32_t k = 0; k < kChannels; k++) {
+      loads[k] = _mm256_inserti128_si256(
+          _mm256_castsi128_si256(
+              _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 16 * k))),
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(
+              in + 16 * kChannels + 16 * k)),
+          1);
+    }
+    for (uint32_t c = 0; c < layout.num_components; c++) {
+      __m256i out = _mm256_shuffle_epi8(loads[0], lane_masks[c][0]);
+      for (uint32_t k = 1; k < kChannels; k++) {
+        out = _mm256_or_si256(out,
+                              _mm256_shuffle_epi8(loads[k], lane_masks[c][k]));
+      }
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst[c] + 32 * b), out);
+    }
+  }
+  return pairs * 2 * block_pixels;
+}
+#endif
+
+enum class Isa { kScalar, kSsse3, kAvx2 };
+
+inline Isa get_isa() {
+#if defined(INGEST_X86_SIMD)
+  if (__builtin_cpu_supports("avx2")) return Isa::kAvx2;
+  if (__builtin_cpu_supports("ssse3")) return Isa::kSsse3;
+#endif
+  return Isa::kScalar;
+}
+
+template <uint32_t kChannels>
+void deinterleave_rows(const Interleaved &layout, unsigned char *const *planes,
+                       const size_t *pitches, uint32_t first_row,
+                       uint32_t last_row, Isa isa) {
+  Masks masks;
+  if (isa != Isa::kScalar) make_masks(layout, masks);
+  unsigned char *dst[kMaxChannels];
+  const size_t row_bytes = static_cast<size_t>(layout.width) *
+                           layout.bytes_per_sample;
+  for (uint32_t y = first_row; y < last_row; y++) {
+    uint32_t stored_row = layout.bottom_up ? layout.height - 1 - y : y;
+    const unsigned char *src = layout.data + stored_row * layout.stride;
+    for (uint32_t c = 0; c < layout.num_components; c++) {
+      dst[c] = planes[c] + y * pitches[c];
+    }
+    if (kChannels == 1 && (layout.bytes_per_sample == 1 || !layout.big_endian)) {
+      memcpy(dst[0], src, row_bytes);
+      continue;
+    }
+    uint32_t done = 0;
+#if defined(INGEST_X86_SIMD)
+    if (isa == Isa::kAvx2) {
+      done = deinterleave_row_avx2<kChannels>(layout, masks, src, dst);
+    }
+    if (isa != Isa::kScalar) {
+      const size_t offset = static_cast<size_t>(done) * layout.bytes_per_sample;
+      unsigned char *rest[kMaxChannels];
+      for (uint32_t c = 0; c < layout.num_components; c++) {
+        rest[c] = dst[c] + offset;
+      }
+      Interleaved tail = layout;
+      tail.width = layout.width - done;
+      done += deinterleave_row_ssse3<kChannels>(tail, masks,
+                                                src + offset * kChannels, rest);
+    }
+#endif
+    deinterleave_row_scalar(layout, src, dst, done);
+  }
+}
+}  // namespace Kernel
+
+// 24-bit (BGR) and 32-bit (BGRX) uncompressed BMP, bottom-up or top-down;
+// the output components are R, G and B
+inline bool parse_bmp(const unsigned char *data, size_t size,
+                      Interleaved &layout, std::string &error) {
+  if (size < 54 || data[0] != 'B' || data[1] != 'M') {
+    error = "not a bmp file";
+    return false;
+  }
+  const uint32_t data_offset = Kernel::read_le32(data + 10);
+  if (Kernel::read_le32(data + 14) != 40) {
+    error = "bmp file not supported";
+    return false;
+  }
+  const int32_t width = static_cast<int32_t>(Kernel::read_le32(data + 18));
+  const int32_t height = static_cast<int32_t>(Kernel::read_le32(data + 22));
+  const uint16_t bits_per_pixel = Kernel::read_le16(data + 28);
+  if (Kernel::read_le32(data + 30) != 0) {
+    error = "only raw bmp files are supported";
+    return false;
+  }
+  if (bits_per_pixel != 24 && bits_per_pixel != 32) {
+    error = "only 24 and 32 bit bmp files are supported";
+    return false;
+  }
+  if (width <= 0 || height == 0 || height == INT32_MIN) {
+    error = "invalid bmp dimensions";
+    return false;
+  }
+  layout.width = width;
+  layout.height = height < 0 ? -height : height;
+  layout.channels = bits_per_pixel / 8;
+  layout.bytes_per_sample = 1;
+  // bmp file data is 32 bit aligned
+  layout.stride = (static_cast<size_t>(layout.width) * bits_per_pixel + 31) / 32 * 4;
+  layout.bottom_up = height > 0;
+  layout.big_endian = false;
+  layout.num_components = 3;
+  layout.channel_of[0] = 2;
+  layout.channel_of[1] = 1;
+  layout.channel_of[2] = 0;
+  layout.precision = 8;
+  // the last row needs no padding
+  const size_t pixel_bytes =
+      (layout.height - 1) * layout.stride + layout.width * layout.channels;
+  if (data_offset > size || size - data_offset < pixel_bytes) {
+    error = "truncated bmp file";
+    return false;
+  }
+  layout.data = data + data_offset;
+  return true;
+}
+
+// Binary PGM (P5), PPM (P6) and PAM (P7, depth 1, 3 or 4) with 8 or 16-bit
+// big-endian samples; every sample channel is an output component
+inline bool parse_pnm(const unsigned char *data, size_t size,
+                      Interleaved &layout, std::string &error) {
+  Kernel::PnmHeader header(data, size);
+  std::string magic;
+  header.token(magic);
+  uint32_t width = 0, height = 0, channels = 0, max_val = 0;
+  if (magic == "P5" || magic == "P6") {
+    channels = magic == "P5" ? 1 : 3;
+    if (!header.number(width) || !header.number(height) ||
+        !header.number(max_val) || !header.end()) {
+      error = "invalid pnm header";
+      return false;
+    }
+  } else if (magic == "P7") {
+    std::string key;
+    while (header.token(key) && key != "ENDHDR") {
+      bool valid = true;
+      if (key == "WIDTH") {
+        valid = header.number(width);
+      } else if (key == "HEIGHT") {
+        valid = header.number(height);
+      } else if (key == "DEPTH") {
+        valid = header.number(channels);
+      } else if (key == "MAXVAL") {
+        valid = header.number(max_val);
+      } else if (key == "TUPLTYPE") {
+        std::string type;
+        valid = header.token(type);
+      } else {
+        valid = false;
+      }
+      if (!valid) {
+        error = "invalid pam header";
+        return false;
+      }
+    }
+    if (key != "ENDHDR" || !header.end()) {
+      error = "invalid pam header";
+      return false;
+    }
+    if (channels != 1 && channels != 3 && channels != 4) {
+      error = "pam depth not supported";
+      return false;
+    }
+  } else {
+    error = "pgm/ppm format not supported";
+    return false;
+  }
+  if (width == 0 || height == 0) {
+    error = "invalid pnm dimensions";
+    return false;
+  }
+  if (max_val == 0 || max_val > 0xffff) {
+    error = "invalid pgm prec value in pgm file";
+    return false;
+  }
+  layout.width = width;
+  layout.height = height;
+  layout.channels = channels;
+  layout.bytes_per_sample = max_val > 0xff ? 2 : 1;
+  layout.stride = static_cast<size_t>(width) * channels * layout.bytes_per_sample;
+  layout.bottom_up = false;
+  layout.big_endian = true;
+  layout.num_components = channels;
+  for (uint32_t c = 0; c < channels; c++) layout.channel_of[c] = c;
+  layout.precision = Kernel::get_precision(max_val);
+  if (size - header.pos() < layout.stride * height) {
+    error = "truncated pnm file";
+    return false;
+  }
+  layout.data = data + header.pos();
+  return true;
+}
+
+// Writes the components of layout into planes[c], rows pitches[c] bytes
+// apart, in row bands on pool (inline when pool is null)
+inline void deinterleave(const Interleaved &layout,
+                         unsigned char *const *planes, const size_t *pitches,
+                         ThreadPool *pool) {
+  static const Kernel::Isa isa = Kernel::get_isa();
+  auto run = [&](uint32_t first_row, uint32_t last_row) {
+    switch (layout.channels) {
+      case 1:
+        Kernel::deinterleave_rows<1>(layout, planes, pitches, first_row, last_row, isa);
+        break;
+      case 2:
+        Kernel::deinterleave_rows<2>(layout, planes, pitches, first_row, last_row, isa);
+        break;
+      case 3:
+        Kernel::deinterleave_rows<3>(layout, planes, pitches, first_row, last_row, isa);
+        break;
+      default:
+        Kernel::deinterleave_rows<4>(layout, planes, pitches, first_row, last_row, isa);
+        break;
+    }
+  };
+  const size_t bands =
+      pool ? std::min<size_t>(layout.height, 4 * pool->size()) : 1;
+  if (bands <= 1) {
+    run(0, layout.height);
+    return;
+  }
+  pool->enqueue_batch(bands, [&](int, size_t band) {
+    run(static_cast<uint32_t>(layout.height * band / bands),
+        static_cast<uint32_t>(layout.height * (band + 1) / bands));
+  });
+  pool->wait();
+}
+
+// Copies planar rows of row_bytes[c] bytes, stored back to back from data,
+// into planes[c]; returns the number of bytes read
+inline size_t copy_planes(const unsigned char *data, uint32_t num_components,
+                          const size_t *row_bytes, const uint32_t *heights,
+                          unsigned char *const *planes, const size_t *pitches,
+                          ThreadPool *pool) {
+  std::vector<size_t> offsets(num_components + 1, 0);
+  for (uint32_t c = 0; c < num_components; c++) {
+    offsets[c + 1] = offsets[c] + row_bytes[c] * heights[c];
+  }
+  auto run = [&](uint32_t c, uint32_t first_row, uint32_t last_row) {
+    const unsigned char *src = data + offsets[c];
+    if (pitches[c] == row_bytes[c]) {
+      memcpy(planes[c] + first_row * pitches[c], src + first_row * row_bytes[c],
+             (last_row - first_row) * row_bytes[c]);
+      return;
+    }
+    for (uint32_t y = first_row; y < last_row; y++) {
+      memcpy(planes[c] + y * pitches[c], src + y * row_bytes[c], row_bytes[c]);
+    }
+  };
+  const size_t bands = pool ? 4 * pool->size() : 1;
+  if (bands <= 1) {
+    for (uint32_t c = 0; c < num_components; c++) run(c, 0, heights[c]);
+    return offsets[num_components];
+  }
+  pool->enqueue_batch(num_components * bands, [&](int, size_t task) {
+    const uint32_t c = static_cast<uint32_t>(task / bands);
+    const size_t band = task % bands;
+    run(c, static_cast<uint32_t>(heights[c] * band / bands),
+        static_cast<uint32_t>(heights[c] * (band + 1) / bands));
+  });
+  pool->wait();
+  return offsets[num_components];
+}
+}  // namespace Ingest
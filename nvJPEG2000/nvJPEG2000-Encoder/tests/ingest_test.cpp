@@ -0,0 +1,230 @@
+// Byte-exact checks of the de-interleave kernels of nvjpeg2k_ingest.h: the
+// scalar, SSSE3 and AVX2 paths (the SIMD ones when the CPU has them) against
+// a per-sample reference, over all channel counts, sample widths, byte
+// orders, row orders and widths around the block sizes.
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "nvjpeg2k_ingest.h"
+#include "test_check.h"
+
+namespace {
+
+using Ingest::Interleaved;
+using Ingest::Kernel::Isa;
+
+const char *get_isa_name(Isa isa) {
+  switch (isa) {
+    case Isa::kAvx2:
+      return "avx2";
+    case Isa::kSsse3:
+      return "ssse3";
+    default:
+      return "scalar";
+  }
+}
+
+std::vector<Isa> get_isas() {
+  std::vector<Isa> isas = {Isa::kScalar};
+#if defined(INGEST_X86_SIMD)
+  if (__builtin_cpu_supports("ssse3")) isas.push_back(Isa::kSsse3);
+  if (__builtin_cpu_supports("avx2")) isas.push_back(Isa::kAvx2);
+#endif
+  return isas;
+}
+
+// Planar output with a padded pitch; the padding must stay untouched
+struct Planes {
+  std::vector<std::vector<unsigned char>> buffers;
+  unsigned char *ptrs[Ingest::kMaxChannels];
+  size_t pitches[Ingest::kMaxChannels];
+};
+
+constexpr unsigned char kPadding = 0xa5;
+
+Planes make_planes(const Interleaved &layout) {
+  Planes planes;
+  for (uint32_t c = 0; c < layout.num_components; c++) {
+    planes.pitches[c] = layout.width * layout.bytes_per_sample + 7;
+    planes.buffers.emplace_back(planes.pitches[c] * layout.height, kPadding);
+  }
+  for (uint32_t c = 0; c < layout.num_components; c++) {
+    planes.ptrs[c] = planes.buffers[c].data();
+  }
+  return planes;
+}
+
+// Sample by sample, native (little-endian) byte order
+Planes reference(const Interleaved &layout) {
+  Planes planes = make_planes(layout);
+  const uint32_t bytes = layout.bytes_per_sample;
+  for (uint32_t y = 0; y < layout.height; y++) {
+    uint32_t stored_row = layout.bottom_up ? layout.height - 1 - y : y;
+    const unsigned char *row = layout.data + stored_row * layout.stride;
+    for (uint32_t c = 0; c < layout.num_components; c++) {
+      unsigned char *out = planes.ptrs[c] + y * planes.pitches[c];
+      for (uint32_t x = 0; x < layout.width; x++) {
+        const unsigned char *in =
+            row + (x * layout.channels + layout.channel_of[c]) * bytes;
+        for (uint32_t b = 0; b < bytes; b++) {
+          bool swap = bytes == 2 && layout.big_endian;
+          out[x * bytes + b] = in[swap ? bytes - 1 - b : b];
+        }
+      }
+    }
+  }
+  return planes;
+}
+
+template <uint32_t kChannels>
+void run_rows(const Interleaved &layout, Planes &planes, Isa isa) {
+  Ingest::Kernel::deinterleave_rows<kChannels>(layout, planes.ptrs,
+                                               planes.pitches, 0,
+                                               layout.height, isa);
+}
+
+void run(const Interleaved &layout, Planes &planes, Isa isa) {
+  switch (layout.channels) {
+    case 1:
+      run_rows<1>(layout, planes, isa);
+      break;
+    case 2:
+      run_rows<2>(layout, planes, isa);
+      break;
+    case 3:
+      run_rows<3>(layout, planes, isa);
+      break;
+    default:
+      run_rows<4>(layout, planes, isa);
+      break;
+  }
+}
+
+bool same(const Planes &lhs, const Planes &rhs) {
+  return lhs.buffers == rhs.buffers;
+}
+
+void test_kernels(std::mt19937 &rng) {
+  const std::vector<Isa> isas = get_isas();
+  const uint32_t widths[] = {1, 7, 8, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65, 100};
+  for (uint32_t channels = 1; channels <= Ingest::kMaxChannels; channels++) {
+    for (uint32_t bytes = 1; bytes <= 2; bytes++) {
+      for (int variant = 0; variant < 4; variant++) {
+        for (uint32_t width : widths) {
+          Interleaved layout;
+          layout.width = width;
+          layout.height = 5;
+          layout.channels = channels;
+          layout.bytes_per_sample = bytes;
+          // Rows padded as in BMP files, plus a few bytes past the last row
+          layout.stride = (width * channels * bytes + 3) / 4 * 4 + 4;
+          layout.bottom_up = variant & 1;
+          layout.big_endian = variant & 2;
+          // Components in reverse channel order, as for BGR input
+          layout.num_components = channels;
+          for (uint32_t c = 0; c < channels; c++) {
+            layout.channel_of[c] = channels - 1 - c;
+          }
+          layout.precision = 8 * bytes;
+          std::vector<unsigned char> data(layout.stride * layout.height + 64);
+          for (auto &byte : data) byte = static_cast<unsigned char>(rng());
+          layout.data = data.data();
+
+          const Planes expected = reference(layout);
+          for (Isa isa : isas) {
+            Planes planes = make_planes(layout);
+            run(layout, planes, isa);
+            if (!same(planes, expected)) {
+              std::fprintf(stderr,
+                           "%s: channels(%u) bytes(%u) bottom_up(%d) "
+                           "big_endian(%d) width(%u) differs\n",
+                           get_isa_name(isa), channels, bytes,
+                           layout.bottom_up, layout.big_endian, width);
+            }
+            CHECK(same(planes, expected));
+          }
+        }
+      }
+    }
+  }
+}
+
+// Fewer components than channels, e.g., BGRX to RGB
+void test_dropped_channel(std::mt19937 &rng) {
+  Interleaved layout;
+  layout.width = 77;
+  layout.height = 3;
+  layout.channels = 4;
+  layout.bytes_per_sample = 1;
+  layout.stride = layout.width * 4;
+  layout.bottom_up = true;
+  layout.big_endian = false;
+  layout.num_components = 3;
+  layout.channel_of[0] = 2;
+  layout.channel_of[1] = 1;
+  layout.channel_of[2] = 0;
+  layout.precision = 8;
+  std::vector<unsigned char> data(layout.stride * layout.height);
+  for (auto &byte : data) byte = static_cast<unsigned char>(rng());
+  layout.data = data.data();
+  const Planes expected = reference(layout);
+  for (Isa isa : get_isas()) {
+    Planes planes = make_planes(layout);
+    run(layout, planes, isa);
+    CHECK(same(planes, expected));
+  }
+}
+
+// deinterleave() in row bands on a pool matches the reference
+void test_pool(std::mt19937 &rng) {
+  Interleaved layout;
+  layout.width = 131;
+  layout.height = 37;
+  layout.channels = 3;
+  layout.bytes_per_sample = 2;
+  layout.stride = layout.width * 6;
+  layout.bottom_up = false;
+  layout.big_endian = true;
+  layout.num_components = 3;
+  for (uint32_t c = 0; c < 3; c++) layout.channel_of[c] = c;
+  layout.precision = 16;
+  std::vector<unsigned char> data(layout.stride * layout.height);
+  for (auto &byte : data) byte = static_cast<unsigned char>(rng());
+  layout.data = data.data();
+  const Planes expected = reference(layout);
+  ThreadPool pool(3);
+  Planes planes = make_planes(layout);
+  Ingest::deinterleave(layout, planes.ptrs, planes.pitches, &pool);
+  CHECK(same(planes, expected));
+}
+
+void test_parse_pam() {
+  const std::string header =
+      "P7\nWIDTH 3\nHEIGHT 2\nDEPTH 4\nMAXVAL 255\n# comment\n"
+      "TUPLTYPE RGB_ALPHA\nENDHDR\n";
+  std::vector<unsigned char> file(header.begin(), header.end());
+  file.resize(header.size() + 3 * 2 * 4, 1);
+  Interleaved layout;
+  std::string error;
+  CHECK(Ingest::parse_pnm(file.data(), file.size(), layout, error));
+  CHECK(layout.width == 3 && layout.height == 2 && layout.channels == 4);
+  CHECK(layout.bytes_per_sample == 1 && layout.precision == 8);
+  CHECK(layout.data == file.data() + header.size());
+  file.pop_back();
+  CHECK(!Ingest::parse_pnm(file.data(), file.size(), layout, error));
+}
+
+}  // namespace
+
+int main() {
+  std::mt19937 rng(1234);
+  for (Isa isa : get_isas()) std::printf("testing %s\n", get_isa_name(isa));
+  test_kernels(rng);
+  test_dropped_channel(rng);
+  test_pool(rng);
+  test_parse_pam();
+  return test_result("ingest_test");
+}